@@ -0,0 +1,33 @@
+# The benchmark provides the codec hooks of the jitter buffer, the headers come with the libraries.
+set( WEBRTC_APPLICATION_JITTER_BUFFER_BENCHMARK_SOURCE_FILES
+     "examples/peer_connection/benchmark/jitter_buffer_benchmark.c"
+     "examples/peer_connection/peer_connection_jitter_buffer.c"
+     "examples/logging/logging.c" )
+
+add_executable(
+    JitterBufferBenchmark
+    ${WEBRTC_APPLICATION_JITTER_BUFFER_BENCHMARK_SOURCE_FILES} )
+
+target_include_directories( JitterBufferBenchmark PRIVATE
+                            ${WEBRTC_APPLICATION_COMMON_UTILS_INCLUDE_DIRS}
+                            ${WEBRTC_APPLICATION_NETWORKING_UTILS_INCLUDE_DIRS}
+                            ${WEBRTC_APPLICATION_SDP_CONTROLLER_INCLUDE_DIRS}
+                            ${WEBRTC_APPLICATION_ICE_CONTROLLER_INCLUDE_DIRS} )
+
+target_compile_definitions( JitterBufferBenchmark PRIVATE
+                            MBEDTLS_CONFIG_FILE="mbedtls_custom_config.h"
+                            ENABLE_SCTP_DATA_CHANNEL=0
+                            METRIC_PRINT_ENABLED=0 )
+
+target_link_libraries( JitterBufferBenchmark
+                       ice
+                       sdp
+                       rtcp
+                       rtp
+                       stun
+                       mbedtls
+                       libsrtp
+                       rt
+                       pthread )
+
+target_compile_options( JitterBufferBenchmark PRIVATE -Wall -Werror )
@@ -0,0 +1,41 @@
+file(
+  GLOB
+  WEBRTC_APPLICATION_MESSAGE_QUEUE_BENCHMARK_SOURCE_FILES
+  "examples/message_queue/benchmark/*.c"
+  "examples/message_queue/linux/*.c"
+  "examples/logging/*.c" )
+
+set( WEBRTC_APPLICATION_MESSAGE_QUEUE_BENCHMARK_INCLUDE_DIRS
+     "examples/message_queue/linux/"
+     "examples/logging/" )
+
+# The in-process ring backend, it's compiled out when USE_POSIX_MESSAGE_QUEUE is set.
+if( NOT USE_POSIX_MESSAGE_QUEUE )
+    add_executable(
+        MessageQueueBenchmark
+        ${WEBRTC_APPLICATION_MESSAGE_QUEUE_BENCHMARK_SOURCE_FILES} )
+
+    target_include_directories( MessageQueueBenchmark PRIVATE
+                                ${WEBRTC_APPLICATION_MESSAGE_QUEUE_BENCHMARK_INCLUDE_DIRS} )
+
+    target_link_libraries( MessageQueueBenchmark
+                           pthread )
+
+    target_compile_options( MessageQueueBenchmark PRIVATE -Wall -Werror )
+endif()
+
+# The POSIX message queue backend, note that rt is librt providing message queue's APIs
+add_executable(
+    MessageQueueBenchmarkMqueue
+    ${WEBRTC_APPLICATION_MESSAGE_QUEUE_BENCHMARK_SOURCE_FILES} )
+
+target_include_directories( MessageQueueBenchmarkMqueue PRIVATE
+                            ${WEBRTC_APPLICATION_MESSAGE_QUEUE_BENCHMARK_INCLUDE_DIRS} )
+
+target_compile_definitions( MessageQueueBenchmarkMqueue PRIVATE MESSAGE_QUEUE_USE_POSIX_MQUEUE=1 )
+
+target_link_libraries( MessageQueueBenchmarkMqueue
+                       rt
+                       pthread )
+
+target_compile_options( MessageQueueBenchmarkMqueue PRIVATE -Wall -Werror )
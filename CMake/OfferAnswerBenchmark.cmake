@@ -0,0 +1,68 @@
+# The benchmark replaces the signaling controller, so neither it nor libwebsockets is built in.
+set( WEBRTC_APPLICATION_OFFER_ANSWER_BENCHMARK_SOURCE_FILES
+     "examples/app_common/benchmark/offer_answer_benchmark.c"
+     "examples/app_common/app_common.c" )
+
+add_executable(
+    OfferAnswerBenchmark
+    ${WEBRTC_APPLICATION_OFFER_ANSWER_BENCHMARK_SOURCE_FILES}
+    ${WEBRTC_APPLICATION_NETWORKING_UTILS_SOURCE_FILES}
+    ${WEBRTC_APPLICATION_COMMON_UTILS_SOURCE_FILES}
+    ${WEBRTC_APPLICATION_MEDIA_SOURCE_FILES}
+    ${WEBRTC_APPLICATION_SDP_CONTROLLER_SOURCE_FILES}
+    ${WEBRTC_APPLICATION_ICE_CONTROLLER_SOURCE_FILES}
+    ${WEBRTC_APPLICATION_MBEDTLS_SOURCE_FILES}
+    ${WEBRTC_APPLICATION_LIBSRTP_SOURCE_FILES} )
+
+target_include_directories( OfferAnswerBenchmark PRIVATE
+                            "examples/app_common"
+                            ${WEBRTC_APPLICATION_NETWORKING_LIBWEBSOCKETS_INCLUDE_DIRS}
+                            ${WEBRTC_APPLICATION_NETWORKING_UTILS_INCLUDE_DIRS}
+                            ${WEBRTC_APPLICATION_SIGNALING_CONTROLLER_INCLUDE_DIRS}
+                            ${WEBRTC_APPLICATION_COMMON_UTILS_INCLUDE_DIRS}
+                            ${WEBRTC_APPLICATION_MEDIA_INCLUDE_FILES}
+                            ${WEBRTC_APPLICATION_SDP_CONTROLLER_INCLUDE_DIRS}
+                            ${WEBRTC_APPLICATION_ICE_CONTROLLER_INCLUDE_DIRS}
+                            ${WEBRTC_APPLICATION_MBEDTLS_INCLUDE_DIRS}
+                            ${WEBRTC_APPLICATION_COREHTTP_INCLUDE_DIRS}
+                            ${WEBRTC_APPLICATION_LIBSRTP_INCLUDE_DIRS}
+                            ${LIBWEBSOCKETS_INCLUDE_DIRS} )
+
+## The sessions are set up as the master sets them up
+target_compile_definitions( OfferAnswerBenchmark PRIVATE
+                            WEBRTC_APPLICATION_DEMO_MASTER
+                            MBEDTLS_CONFIG_FILE="mbedtls_custom_config.h" )
+
+if( BUILD_USRSCTP_LIBRARY )
+    target_compile_definitions( OfferAnswerBenchmark PRIVATE ENABLE_SCTP_DATA_CHANNEL=1 )
+else()
+    target_compile_definitions( OfferAnswerBenchmark PRIVATE ENABLE_SCTP_DATA_CHANNEL=0 )
+endif()
+
+if( METRIC_PRINT_ENABLED )
+    target_compile_definitions( OfferAnswerBenchmark PRIVATE METRIC_PRINT_ENABLED=1 )
+else()
+    target_compile_definitions( OfferAnswerBenchmark PRIVATE METRIC_PRINT_ENABLED=0 )
+endif()
+
+target_link_libraries( OfferAnswerBenchmark
+                       sigv4
+                       signaling
+                       corejson
+                       sdp
+                       ice
+                       rtcp
+                       rtp
+                       stun
+                       mbedtls
+                       libsrtp
+                       rt
+                       pthread )
+
+if( BUILD_USRSCTP_LIBRARY )
+    target_link_libraries( OfferAnswerBenchmark
+                           usrsctp
+                           dcep )
+endif()
+
+target_compile_options( OfferAnswerBenchmark PRIVATE -Wall -Werror )
@@ -0,0 +1,101 @@
+# Each test links the peer connection modules it covers with the logging, the headers come with the libraries.
+enable_testing()
+
+function( add_peer_connection_test TEST_NAME )
+    add_executable(
+        ${TEST_NAME}
+        ${ARGN}
+        "examples/logging/logging.c" )
+
+    target_include_directories( ${TEST_NAME} PRIVATE
+                                ${WEBRTC_APPLICATION_COMMON_UTILS_INCLUDE_DIRS}
+                                ${WEBRTC_APPLICATION_NETWORKING_UTILS_INCLUDE_DIRS}
+                                ${WEBRTC_APPLICATION_SDP_CONTROLLER_INCLUDE_DIRS}
+                                ${WEBRTC_APPLICATION_ICE_CONTROLLER_INCLUDE_DIRS} )
+
+    target_compile_definitions( ${TEST_NAME} PRIVATE
+                                MBEDTLS_CONFIG_FILE="mbedtls_custom_config.h"
+                                ENABLE_SCTP_DATA_CHANNEL=0
+                                METRIC_PRINT_ENABLED=0 )
+
+    target_link_libraries( ${TEST_NAME}
+                           ice
+                           sdp
+                           rtcp
+                           rtp
+                           stun
+                           mbedtls
+                           libsrtp
+                           rt
+                           pthread )
+
+    target_compile_options( ${TEST_NAME} PRIVATE -Wall -Werror )
+
+    add_test( NAME ${TEST_NAME} COMMAND ${TEST_NAME} )
+endfunction()
+
+# The test provides the stand-ins of the DNS resolver and the socket creation, and runs the pool whatever demo_config.h sets.
+add_peer_connection_test(
+    IceControllerWarmPoolTest
+    "examples/ice_controller/test/ice_controller_warm_pool_test.c"
+    "examples/ice_controller/ice_controller_warm_pool.c"
+    "examples/networking/networking_utils/networking_utils.c" )
+target_compile_definitions( IceControllerWarmPoolTest PRIVATE ENABLE_ICE_WARM_POOL=1 )
+
+add_peer_connection_test(
+    PeerConnectionBandwidthEstimatorTest
+    "examples/peer_connection/test/peer_connection_bandwidth_estimator_test.c"
+    "examples/peer_connection/peer_connection_bandwidth_estimator.c" )
+
+add_peer_connection_test(
+    PeerConnectionTwccHistoryTest
+    "examples/peer_connection/test/peer_connection_twcc_history_test.c"
+    "examples/peer_connection/peer_connection_twcc_history.c"
+    "examples/peer_connection/peer_connection_bandwidth_estimator.c" )
+
+# The test provides the codec hooks of the jitter buffer, the codec helpers pull in the whole send path.
+add_peer_connection_test(
+    PeerConnectionJitterBufferTest
+    "examples/peer_connection/test/peer_connection_jitter_buffer_test.c"
+    "examples/peer_connection/peer_connection_jitter_buffer.c" )
+
+add_peer_connection_test(
+    PeerConnectionNackGeneratorTest
+    "examples/peer_connection/test/peer_connection_nack_generator_test.c"
+    "examples/peer_connection/peer_connection_nack_generator.c" )
+
+add_peer_connection_test(
+    PeerConnectionPacerTest
+    "examples/peer_connection/test/peer_connection_pacer_test.c"
+    "examples/peer_connection/peer_connection_pacer.c"
+    "examples/networking/networking_utils/networking_utils.c" )
+
+# Skipped unless the loopback interface has the fq qdisc, which honors the SO_TXTIME departure times.
+add_peer_connection_test(
+    PeerConnectionPacerTxTimeTest
+    "examples/peer_connection/test/peer_connection_pacer_txtime_test.c"
+    "examples/peer_connection/peer_connection_pacer.c"
+    "examples/networking/networking_utils/networking_utils.c" )
+set_tests_properties( PeerConnectionPacerTxTimeTest PROPERTIES SKIP_RETURN_CODE 77 )
+
+add_peer_connection_test(
+    PeerConnectionTwccFeedbackTest
+    "examples/peer_connection/test/peer_connection_twcc_feedback_test.c"
+    "examples/peer_connection/peer_connection_twcc_feedback.c" )
+
+add_peer_connection_test(
+    PeerConnectionReceptionStatsTest
+    "examples/peer_connection/test/peer_connection_reception_stats_test.c"
+    "examples/peer_connection/peer_connection_reception_stats.c" )
+
+# A 500 ns wheel tick gets the timers through all levels of the wheel and beyond it in seconds.
+add_peer_connection_test(
+    TimerControllerTest
+    "examples/timer_controller/test/timer_controller_test.c"
+    "examples/timer_controller/timer_controller.c" )
+target_compile_definitions( TimerControllerTest PRIVATE TIMER_CONTROLLER_WHEEL_TICK_NS=500ULL )
+
+add_peer_connection_test(
+    MessageQueueTest
+    "examples/message_queue/test/message_queue_test.c"
+    "examples/message_queue/linux/message_queue.c" )
@@ -0,0 +1,22 @@
+file(
+  GLOB
+  WEBRTC_APPLICATION_TIMER_CONTROLLER_BENCHMARK_SOURCE_FILES
+  "examples/timer_controller/benchmark/*.c"
+  "examples/timer_controller/*.c"
+  "examples/logging/*.c" )
+
+set( WEBRTC_APPLICATION_TIMER_CONTROLLER_BENCHMARK_INCLUDE_DIRS
+     "examples/timer_controller/"
+     "examples/logging/" )
+
+add_executable(
+    TimerControllerBenchmark
+    ${WEBRTC_APPLICATION_TIMER_CONTROLLER_BENCHMARK_SOURCE_FILES} )
+
+target_include_directories( TimerControllerBenchmark PRIVATE
+                            ${WEBRTC_APPLICATION_TIMER_CONTROLLER_BENCHMARK_INCLUDE_DIRS} )
+
+target_link_libraries( TimerControllerBenchmark
+                       pthread )
+
+target_compile_options( TimerControllerBenchmark PRIVATE -Wall -Werror )
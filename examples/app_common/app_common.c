@@ -100,9 +100,7 @@
 #endif
 
 static int32_t StartPeerConnectionSession( AppContext_t * pAppContext,
-                                           AppSession_t * pAppSession,
-                                           const char * pRemoteClientId,
-                                           size_t remoteClientIdLength );
+                                           AppSession_t * pAppSession );
 static int32_t ParseIceServerUri( IceControllerIceServer_t * pIceServer,
                                   char * pUri,
                                   size_t uriLength );
@@ -110,15 +108,16 @@ static int32_t GetIceServerList( AppContext_t * pAppContext,
                                  IceControllerIceServer_t * pOutputIceServers,
                                  size_t * pOutputIceServersCount );
 #if ENABLE_TWCC_SUPPORT
-    /* Sample callback for TWCC. The average packet loss is tracked using an exponential moving average (EMA).
-       - If packet loss stays at or below 5%, the bitrate increases by 5%.
-       - If packet loss exceeds 5%, the bitrate decreases by the same percentage as the loss.
-       The bitrate is adjusted once per second, ensuring it stays within predefined limits. */
+    static PeerConnectionResult_t AdjustMediaBitrates( AppSession_t * pAppSession,
+                                                       uint64_t currentTimeUs );
     static void SampleSenderBandwidthEstimationHandler( void * pCustomContext,
                                                         TwccBandwidthInfo_t * pTwccBandwidthInfo );
+    static void SampleReceiverEstimatedMaximumBitrateHandler( void * pCustomContext,
+                                                              RtcpRembPacket_t * pRtcpRembPacket );
 #endif
 static int32_t InitializeAppSession( AppContext_t * pAppContext,
                                      AppSession_t * pAppSession );
+static void HandleAppSessionClosed( void * pCustomContext );
 #if defined( WEBRTC_APPLICATION_DEMO_MASTER )
 static PeerConnectionResult_t HandleRxVideoFrame( void * pCustomContext,
                                                   PeerConnectionFrame_t * pFrame );
@@ -228,21 +227,13 @@ static void * SignalingController_Task( void * pParameter )
 }
 
 static int32_t StartPeerConnectionSession( AppContext_t * pAppContext,
-                                           AppSession_t * pAppSession,
-                                           const char * pRemoteClientId,
-                                           size_t remoteClientIdLength )
+                                           AppSession_t * pAppSession )
 {
     int32_t ret = 0;
     PeerConnectionResult_t peerConnectionResult;
     PeerConnectionSessionConfiguration_t pcConfig;
     Transceiver_t * pTransceiver = NULL;
 
-    if( remoteClientIdLength > REMOTE_ID_MAX_LENGTH )
-    {
-        LogWarn( ( "The remote client ID length(%lu) is too long to store.", remoteClientIdLength ) );
-        ret = -1;
-    }
-
     if( ret == 0 )
     {
         memset( &pcConfig, 0, sizeof( PeerConnectionSessionConfiguration_t ) );
@@ -336,8 +327,6 @@ static int32_t StartPeerConnectionSession( AppContext_t * pAppContext,
 
     if( ret == 0 )
     {
-        pAppSession->remoteClientIdLength = remoteClientIdLength;
-        memcpy( pAppSession->remoteClientId, pRemoteClientId, remoteClientIdLength );
         peerConnectionResult = PeerConnection_Start( &pAppSession->peerConnectionSession );
         if( peerConnectionResult != PEER_CONNECTION_RESULT_OK )
         {
@@ -654,58 +643,47 @@ static int32_t GetIceServerList( AppContext_t * pAppContext,
 }
 
 #if ENABLE_TWCC_SUPPORT
-/* Sample callback for TWCC. The average packet loss is tracked using an exponential moving average (EMA).
-   - If packet loss stays at or below 5%, the bitrate increases by 5%.
-   - If packet loss exceeds 5%, the bitrate decreases by the same percentage as the loss.
-   The bitrate is adjusted once per second, ensuring it stays within predefined limits. */
-    static void SampleSenderBandwidthEstimationHandler( void * pCustomContext,
-                                                        TwccBandwidthInfo_t * pTwccBandwidthInfo )
+/* Sample rate controller fed by both TWCC and REMB feedback.
+   - If the average packet loss stays at or below 5%, the bitrate increases by 5%.
+   - If the average packet loss exceeds 5%, the bitrate decreases by the same percentage as the loss.
+   The loss-based bitrate is then capped by the delay-based estimates, the sender side one from TWCC and the receiver side one from REMB.
+   Audio is kept and video takes the rest.
+   The bitrate is adjusted once per second, or right away if the cap drops below the bitrates set last time, ensuring it stays within predefined limits. */
+    static PeerConnectionResult_t AdjustMediaBitrates( AppSession_t * pAppSession,
+                                                       uint64_t currentTimeUs )
     {
         PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
-        AppContext_t * pAppContext = NULL;
-        AppSession_t * pAppSession = NULL;
+        AppContext_t * pAppContext = pAppSession->pAppContext;
+        PeerConnectionTwccMetaData_t * pTwccMetaData = &pAppSession->peerConnectionSession.twccMetaData;
         uint64_t videoBitrateKbps = 0;
         uint64_t audioBitrateBps = 0;
-        uint64_t currentTimeUs = 0;
+        uint64_t capBitrateBps = 0;
+        uint64_t lastBitrateBps = 0;
         uint64_t timeDifference = 0;
-        uint32_t lostPacketCount = 0;
         uint8_t isBitrateModifiedLocked = 0;
         uint8_t isTwccLocked = 0;
-        double percentLost = 0.0;
         int i;
 
-        if( ( pCustomContext == NULL ) ||
-            ( pTwccBandwidthInfo == NULL ) )
+        timeDifference = currentTimeUs - pTwccMetaData->lastAdjustmentTimeUs;
+
+        capBitrateBps = pAppSession->peerConnectionSession.bandwidthEstimator.targetBitrateBps;
+        if( ( pTwccMetaData->remoteEstimatedBitrateBps != 0 ) &&
+            ( pTwccMetaData->remoteEstimatedBitrateBps < capBitrateBps ) )
         {
-            LogError( ( "Invalid input, pCustomContext: %p, pTwccBandwidthInfo: %p",
-                        pCustomContext, pTwccBandwidthInfo ) );
-            ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+            capBitrateBps = pTwccMetaData->remoteEstimatedBitrateBps;
         }
+        lastBitrateBps = ( uint64_t ) pTwccMetaData->modifiedVideoBitrateKbps * 1024 + pTwccMetaData->modifiedAudioBitrateBps;
 
-        // Calculate packet loss
-        if( ret == PEER_CONNECTION_RESULT_OK )
+        if( ( timeDifference < PEER_CONNECTION_TWCC_BITRATE_ADJUSTMENT_INTERVAL_US ) &&
+            ( ( lastBitrateBps <= capBitrateBps ) || ( pTwccMetaData->modifiedVideoBitrateKbps <= PEER_CONNECTION_MIN_VIDEO_BITRATE_KBPS ) ) )
         {
-            pAppSession = ( AppSession_t * ) pCustomContext;
-            pAppContext = pAppSession->pAppContext;
-
-            currentTimeUs = NetworkingUtils_GetCurrentTimeUs( NULL );
-            lostPacketCount = pTwccBandwidthInfo->sentPackets - pTwccBandwidthInfo->receivedPackets;
-            percentLost = ( double ) ( ( pTwccBandwidthInfo->sentPackets > 0 ) ? ( ( double ) ( lostPacketCount * 100 ) / ( double )pTwccBandwidthInfo->sentPackets ) : 0.0 );
-            timeDifference = currentTimeUs - pAppSession->peerConnectionSession.twccMetaData.lastAdjustmentTimeUs;
-
-            pAppSession->peerConnectionSession.twccMetaData.averagePacketLoss = EMA_ACCUMULATOR_GET_NEXT( pAppSession->peerConnectionSession.twccMetaData.averagePacketLoss,
-                                                                                                          ( ( double ) percentLost ) );
-
-            if( timeDifference < PEER_CONNECTION_TWCC_BITRATE_ADJUSTMENT_INTERVAL_US )
-            {
-                // Too soon for another adjustment
-                ret = PEER_CONNECTION_RESULT_FAIL_RTCP_TWCC_INIT;
-            }
+            // Too soon for another adjustment
+            ret = PEER_CONNECTION_RESULT_FAIL_RTCP_TWCC_INIT;
         }
 
         if( ret == PEER_CONNECTION_RESULT_OK )
         {
-            if( pthread_mutex_lock( &( pAppSession->peerConnectionSession.twccMetaData.twccBitrateMutex ) ) == 0 )
+            if( pthread_mutex_lock( &( pTwccMetaData->twccBitrateMutex ) ) == 0 )
             {
                 isTwccLocked = 1;
             }
@@ -747,7 +725,7 @@ static int32_t GetIceServerList( AppContext_t * pAppContext,
                 }
             }
 
-            if( pAppSession->peerConnectionSession.twccMetaData.averagePacketLoss <= 5 )
+            if( pTwccMetaData->averagePacketLoss <= 5 )
             {
                 // Increase encoder bitrates by 5 percent with cap at MAX_BITRATE
                 videoBitrateKbps = ( uint64_t ) MIN( videoBitrateKbps * 1.05,
@@ -758,15 +736,23 @@ static int32_t GetIceServerList( AppContext_t * pAppContext,
             else
             {
                 // Decrease encoder bitrate by average packet loss percent, with a cap at MIN_BITRATE
-                videoBitrateKbps = ( uint64_t ) MAX( videoBitrateKbps * ( 1.0 - ( pAppSession->peerConnectionSession.twccMetaData.averagePacketLoss / 100.0 ) ),
+                videoBitrateKbps = ( uint64_t ) MAX( videoBitrateKbps * ( 1.0 - ( pTwccMetaData->averagePacketLoss / 100.0 ) ),
                                                  PEER_CONNECTION_MIN_VIDEO_BITRATE_KBPS );
-                audioBitrateBps = ( uint64_t ) MAX( audioBitrateBps * ( 1.0 - ( pAppSession->peerConnectionSession.twccMetaData.averagePacketLoss / 100.0 ) ),
+                audioBitrateBps = ( uint64_t ) MAX( audioBitrateBps * ( 1.0 - ( pTwccMetaData->averagePacketLoss / 100.0 ) ),
                                                  PEER_CONNECTION_MIN_AUDIO_BITRATE_BPS );
             }
 
-            pAppSession->peerConnectionSession.twccMetaData.modifiedVideoBitrateKbps = videoBitrateKbps;
-            pAppSession->peerConnectionSession.twccMetaData.modifiedAudioBitrateBps = audioBitrateBps;
-            pAppContext->isMediaBitrateModified = 1;
+            // The loss-based bitrate is the upper bound, don't send more than the delay-based estimates either.
+            if( videoBitrateKbps * 1024 + audioBitrateBps > capBitrateBps )
+            {
+                videoBitrateKbps = ( capBitrateBps > audioBitrateBps ) ? ( capBitrateBps - audioBitrateBps ) / 1024 : 0;
+                videoBitrateKbps = MAX( videoBitrateKbps,
+                                        PEER_CONNECTION_MIN_VIDEO_BITRATE_KBPS );
+            }
+
+            pTwccMetaData->modifiedVideoBitrateKbps = videoBitrateKbps;
+            pTwccMetaData->modifiedAudioBitrateBps = audioBitrateBps;
+            pAppContext->isMediaBitrateModified = APP_COMMON_MEDIA_BITRATE_MODIFIED_VIDEO | APP_COMMON_MEDIA_BITRATE_MODIFIED_AUDIO;
         }
 
         if( isBitrateModifiedLocked )
@@ -776,18 +762,79 @@ static int32_t GetIceServerList( AppContext_t * pAppContext,
 
         if( isTwccLocked )
         {
-            pthread_mutex_unlock( &( pAppSession->peerConnectionSession.twccMetaData.twccBitrateMutex ) );
+            pthread_mutex_unlock( &( pTwccMetaData->twccBitrateMutex ) );
         }
-        
+
         if( ret == PEER_CONNECTION_RESULT_OK )
         {
-            pAppSession->peerConnectionSession.twccMetaData.lastAdjustmentTimeUs = currentTimeUs;
+            pTwccMetaData->lastAdjustmentTimeUs = currentTimeUs;
 
-            LogInfo( ( "Adjusted made : average packet loss = %.2f%%, timeDifference = %lu us", pAppSession->peerConnectionSession.twccMetaData.averagePacketLoss, timeDifference  ) );
-            LogInfo( ( "Suggested video bitrate: %lu kbps, suggested audio bitrate: %lu bps, sent: %lu bytes, %lu packets,   received: %lu bytes, %lu packets, in %llu msec ",
-                       videoBitrateKbps, audioBitrateBps, pTwccBandwidthInfo->sentBytes, pTwccBandwidthInfo->sentPackets, pTwccBandwidthInfo->receivedBytes, pTwccBandwidthInfo->receivedPackets, pTwccBandwidthInfo->duration / 10000ULL ) );
+            LogInfo( ( "Adjusted made : average packet loss = %.2f%%, delay-based cap = %lu bps, timeDifference = %lu us", pTwccMetaData->averagePacketLoss, capBitrateBps, timeDifference  ) );
+            LogInfo( ( "Suggested video bitrate: %lu kbps, suggested audio bitrate: %lu bps", videoBitrateKbps, audioBitrateBps ) );
         }
 
+        return ret;
+    }
+
+/* Sample callback for TWCC. The average packet loss is tracked using an exponential moving average (EMA), then the rate controller runs. */
+    static void SampleSenderBandwidthEstimationHandler( void * pCustomContext,
+                                                        TwccBandwidthInfo_t * pTwccBandwidthInfo )
+    {
+        PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+        AppSession_t * pAppSession = NULL;
+        uint32_t lostPacketCount = 0;
+        double percentLost = 0.0;
+
+        if( ( pCustomContext == NULL ) ||
+            ( pTwccBandwidthInfo == NULL ) )
+        {
+            LogError( ( "Invalid input, pCustomContext: %p, pTwccBandwidthInfo: %p",
+                        pCustomContext, pTwccBandwidthInfo ) );
+            ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+        }
+
+        // Calculate packet loss
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            pAppSession = ( AppSession_t * ) pCustomContext;
+
+            lostPacketCount = pTwccBandwidthInfo->sentPackets - pTwccBandwidthInfo->receivedPackets;
+            percentLost = ( double ) ( ( pTwccBandwidthInfo->sentPackets > 0 ) ? ( ( double ) ( lostPacketCount * 100 ) / ( double )pTwccBandwidthInfo->sentPackets ) : 0.0 );
+
+            pAppSession->peerConnectionSession.twccMetaData.averagePacketLoss = EMA_ACCUMULATOR_GET_NEXT( pAppSession->peerConnectionSession.twccMetaData.averagePacketLoss,
+                                                                                                          ( ( double ) percentLost ) );
+
+            ret = AdjustMediaBitrates( pAppSession,
+                                       NetworkingUtils_GetCurrentTimeUs( NULL ) );
+        }
+
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            LogInfo( ( "TWCC feedback: sent: %lu bytes, %lu packets,   received: %lu bytes, %lu packets, in %llu msec ",
+                       pTwccBandwidthInfo->sentBytes, pTwccBandwidthInfo->sentPackets, pTwccBandwidthInfo->receivedBytes, pTwccBandwidthInfo->receivedPackets, pTwccBandwidthInfo->duration / 10000ULL ) );
+        }
+    }
+
+/* Sample callback for REMB. The receiver's estimate caps the bitrates along with the TWCC one, so peers that only support goog-remb are adapted as well. */
+    static void SampleReceiverEstimatedMaximumBitrateHandler( void * pCustomContext,
+                                                              RtcpRembPacket_t * pRtcpRembPacket )
+    {
+        AppSession_t * pAppSession = NULL;
+
+        if( ( pCustomContext == NULL ) ||
+            ( pRtcpRembPacket == NULL ) )
+        {
+            LogError( ( "Invalid input, pCustomContext: %p, pRtcpRembPacket: %p",
+                        pCustomContext, pRtcpRembPacket ) );
+        }
+        else
+        {
+            pAppSession = ( AppSession_t * ) pCustomContext;
+            pAppSession->peerConnectionSession.twccMetaData.remoteEstimatedBitrateBps = pRtcpRembPacket->bitRate;
+
+            ( void ) AdjustMediaBitrates( pAppSession,
+                                          NetworkingUtils_GetCurrentTimeUs( NULL ) );
+        }
     }
 #endif
 
@@ -813,11 +860,280 @@ static int32_t InitializeAppSession( AppContext_t * pAppContext,
     {
         pAppSession->pSignalingControllerContext = &( pAppContext->signalingControllerContext );
         pAppSession->pAppContext = pAppContext;  /* Set the reverse pointer */
+
+        peerConnectionResult = PeerConnection_SetSessionClosedCallback( &pAppSession->peerConnectionSession,
+                                                                        HandleAppSessionClosed,
+                                                                        pAppSession );
+        if( peerConnectionResult != PEER_CONNECTION_RESULT_OK )
+        {
+            LogWarn( ( "PeerConnection_SetSessionClosedCallback fail, result: %d", peerConnectionResult ) );
+            ( void ) PeerConnection_Deinit( &pAppSession->peerConnectionSession );
+            ret = -1;
+        }
     }
 
     return ret;
 }
 
+static uint32_t HashRemoteClientId( const char * pRemoteClientId,
+                                    size_t remoteClientIdLength )
+{
+    /* 32-bit FNV-1a. */
+    uint32_t hash = 2166136261U;
+    size_t i;
+
+    for( i = 0; i < remoteClientIdLength; i++ )
+    {
+        hash ^= ( uint8_t ) pRemoteClientId[ i ];
+        hash *= 16777619U;
+    }
+
+    return hash;
+}
+
+static AppSession_t ** GetAppSessionBucket( AppContext_t * pAppContext,
+                                            const char * pRemoteClientId,
+                                            size_t remoteClientIdLength )
+{
+    return &pAppContext->ppAppSessionBuckets[ HashRemoteClientId( pRemoteClientId,
+                                                                  remoteClientIdLength ) & pAppContext->appSessionBucketMask ];
+}
+
+static AppSession_t * FindAppSession( AppContext_t * pAppContext,
+                                     const char * pRemoteClientId,
+                                     size_t remoteClientIdLength )
+{
+    AppSession_t * pAppSession = *GetAppSessionBucket( pAppContext,
+                                                       pRemoteClientId,
+                                                       remoteClientIdLength );
+
+    while( ( pAppSession != NULL ) &&
+           ( ( pAppSession->remoteClientIdLength != remoteClientIdLength ) ||
+             ( ( remoteClientIdLength > 0U ) &&
+               ( memcmp( pAppSession->remoteClientId, pRemoteClientId, remoteClientIdLength ) != 0 ) ) ) )
+    {
+        pAppSession = pAppSession->pNext;
+    }
+
+    return pAppSession;
+}
+
+static void HashAppSession( AppContext_t * pAppContext,
+                            AppSession_t * pAppSession )
+{
+    AppSession_t ** ppBucket = GetAppSessionBucket( pAppContext,
+                                                    pAppSession->remoteClientId,
+                                                    pAppSession->remoteClientIdLength );
+
+    pAppSession->pNext = *ppBucket;
+    *ppBucket = pAppSession;
+    pAppSession->isHashed = 1U;
+}
+
+static void PushFreeAppSession( AppContext_t * pAppContext,
+                                AppSession_t * pAppSession )
+{
+    pAppSession->pNext = pAppContext->pFreeAppSessions;
+    pAppContext->pFreeAppSessions = pAppSession;
+    pAppContext->freeAppSessionCount++;
+
+    /* Wake up the offer waiting for the session being pre-warmed. */
+    ( void ) pthread_cond_broadcast( &pAppContext->appSessionsCond );
+}
+
+/* Allocate and initialize a new session. It's slow, the peer connection creates its tasks, queue, timers and buffers,
+ * and the first session also generates the DTLS certificate. */
+static AppSession_t * CreateAppSession( AppContext_t * pAppContext )
+{
+    AppSession_t * pAppSession = ( AppSession_t * ) calloc( 1,
+                                                           sizeof( AppSession_t ) );
+
+    if( pAppSession == NULL )
+    {
+        LogError( ( "Fail to allocate peer connection session." ) );
+    }
+    else if( InitializeAppSession( pAppContext,
+                                   pAppSession ) != 0 )
+    {
+        /* A failed init releases what it created, the session task included, so the session can be freed. */
+        LogError( ( "Fail to initialize peer connection session." ) );
+        free( pAppSession );
+        pAppSession = NULL;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return pAppSession;
+}
+
+/* Add a new session to the pool, the lock must be held. */
+static void PublishAppSession( AppContext_t * pAppContext,
+                               AppSession_t * pAppSession )
+{
+    uint32_t appSessionCount = atomic_load( &pAppContext->appSessionCount );
+
+    /* Publish the session before the count, the media tasks iterate the pool without the lock. */
+    pAppContext->ppAppSessions[ appSessionCount ] = pAppSession;
+    atomic_store( &pAppContext->appSessionCount,
+                  appSessionCount + 1U );
+}
+
+/* Take the session out of the hash table and return it to the free list. */
+static void ReturnAppSession( AppContext_t * pAppContext,
+                              AppSession_t * pAppSession )
+{
+    AppSession_t ** ppCurrent = GetAppSessionBucket( pAppContext,
+                                                     pAppSession->remoteClientId,
+                                                     pAppSession->remoteClientIdLength );
+
+    while( ( *ppCurrent != NULL ) && ( *ppCurrent != pAppSession ) )
+    {
+        ppCurrent = &( *ppCurrent )->pNext;
+    }
+
+    if( *ppCurrent != NULL )
+    {
+        *ppCurrent = pAppSession->pNext;
+    }
+
+    pAppSession->isHashed = 0U;
+    pAppSession->remoteClientIdLength = 0U;
+    PushFreeAppSession( pAppContext,
+                        pAppSession );
+}
+
+/* Get a session for a new remote client from the free list, or initialize a new one while the pool isn't full. */
+static AppSession_t * AcquireAppSession( AppContext_t * pAppContext )
+{
+    AppSession_t * pAppSession = NULL;
+
+    /* A session being pre-warmed is ready sooner than a new one, wait for it. */
+    while( ( pAppContext->pFreeAppSessions == NULL ) &&
+           ( pAppContext->reservedAppSessionCount > atomic_load( &pAppContext->appSessionCount ) ) )
+    {
+        ( void ) pthread_cond_wait( &pAppContext->appSessionsCond,
+                                    &pAppContext->appSessionsMutex );
+    }
+
+    if( pAppContext->pFreeAppSessions != NULL )
+    {
+        pAppSession = pAppContext->pFreeAppSessions;
+        pAppContext->pFreeAppSessions = pAppSession->pNext;
+        pAppContext->freeAppSessionCount--;
+        pAppSession->pNext = NULL;
+
+        /* Let the refill task top the free list up again. */
+        ( void ) pthread_cond_broadcast( &pAppContext->appSessionsCond );
+    }
+    else if( pAppContext->reservedAppSessionCount < pAppContext->maxViewerNum )
+    {
+        /* Initialize the session without the lock like the refill task, the other offers and the closed sessions aren't blocked. */
+        pAppContext->reservedAppSessionCount++;
+        pthread_mutex_unlock( &pAppContext->appSessionsMutex );
+
+        pAppSession = CreateAppSession( pAppContext );
+
+        ( void ) pthread_mutex_lock( &pAppContext->appSessionsMutex );
+        if( pAppSession != NULL )
+        {
+            PublishAppSession( pAppContext,
+                               pAppSession );
+        }
+        else
+        {
+            /* Give the slot back, an offer waiting for it initializes its own session. */
+            pAppContext->reservedAppSessionCount--;
+            ( void ) pthread_cond_broadcast( &pAppContext->appSessionsCond );
+        }
+    }
+    else
+    {
+        LogWarn( ( "All %u peer connection sessions are in use.", pAppContext->maxViewerNum ) );
+    }
+
+    return pAppSession;
+}
+
+static void * AppSessionsRefill_Task( void * pParameter )
+{
+    AppContext_t * pAppContext = ( AppContext_t * ) pParameter;
+    AppSession_t * pAppSession = NULL;
+    uint8_t isRefilling = 1U;
+
+    if( pthread_mutex_lock( &pAppContext->appSessionsMutex ) != 0 )
+    {
+        LogError( ( "Fail to lock peer connection session pool." ) );
+        isRefilling = 0U;
+    }
+
+    while( isRefilling != 0U )
+    {
+        if( ( pAppContext->freeAppSessionCount >= pAppContext->prewarmedViewerNum ) ||
+            ( pAppContext->reservedAppSessionCount >= pAppContext->maxViewerNum ) )
+        {
+            ( void ) pthread_cond_wait( &pAppContext->appSessionsCond,
+                                        &pAppContext->appSessionsMutex );
+        }
+        else
+        {
+            /* Initialize the session without the lock, so offers claiming the idle sessions aren't blocked. */
+            pAppContext->reservedAppSessionCount++;
+            pthread_mutex_unlock( &pAppContext->appSessionsMutex );
+
+            pAppSession = CreateAppSession( pAppContext );
+
+            ( void ) pthread_mutex_lock( &pAppContext->appSessionsMutex );
+            if( pAppSession != NULL )
+            {
+                PublishAppSession( pAppContext,
+                                   pAppSession );
+                PushFreeAppSession( pAppContext,
+                                    pAppSession );
+            }
+            else
+            {
+                /* Stop pre-warming, the sessions are initialized on demand from now on. */
+                LogError( ( "Fail to pre-warm peer connection session, stop pre-warming." ) );
+                pAppContext->reservedAppSessionCount--;
+                ( void ) pthread_cond_broadcast( &pAppContext->appSessionsCond );
+                isRefilling = 0U;
+                pthread_mutex_unlock( &pAppContext->appSessionsMutex );
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void HandleAppSessionClosed( void * pCustomContext )
+{
+    AppSession_t * pAppSession = ( AppSession_t * ) pCustomContext;
+    AppContext_t * pAppContext = pAppSession->pAppContext;
+
+    if( pthread_mutex_lock( &pAppContext->appSessionsMutex ) == 0 )
+    {
+        /* A new offer from the same remote client might have restarted the session already. */
+        if( ( pAppSession->isHashed != 0U ) &&
+            ( pAppSession->peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_INITED ) )
+        {
+            LogDebug( ( "Return peer connection session of client ID(%lu): %.*s",
+                        pAppSession->remoteClientIdLength,
+                        ( int ) pAppSession->remoteClientIdLength,
+                        pAppSession->remoteClientId ) );
+            ReturnAppSession( pAppContext,
+                              pAppSession );
+        }
+
+        pthread_mutex_unlock( &pAppContext->appSessionsMutex );
+    }
+    else
+    {
+        LogError( ( "Fail to lock peer connection session pool." ) );
+    }
+}
+
 #if defined( WEBRTC_APPLICATION_DEMO_MASTER )
 static PeerConnectionResult_t HandleRxVideoFrame( void * pCustomContext,
                                                   PeerConnectionFrame_t * pFrame )
@@ -891,6 +1207,8 @@ static void HandleSdpOffer( AppContext_t * pAppContext,
     size_t sdpAnswerMessageLength = 0;
     AppSession_t * pAppSession = NULL;
     SignalingMessage_t signalingMessageSdpAnswer;
+    /* Measure the offer to answer latency, it includes the session initialization without pre-warmed sessions. */
+    uint64_t offerTimeUs = NetworkingUtils_GetCurrentMonotonicTimeUs( NULL );
 
     if( ( pAppContext == NULL ) ||
         ( pSignalingMessage == NULL ) )
@@ -1058,6 +1376,14 @@ static void HandleSdpOffer( AppContext_t * pAppContext,
             skipProcess = 1;
             LogError( ( "Send signaling message fail, result: %d", signalingControllerReturn ) );
         }
+        else
+        {
+            LogInfo( ( "Answered SDP offer from remote client ID: %.*s in %lu us, pre-warmed sessions: %u",
+                       ( int ) pSignalingMessage->remoteClientIdLength,
+                       pSignalingMessage->pRemoteClientId,
+                       NetworkingUtils_GetCurrentMonotonicTimeUs( NULL ) - offerTimeUs,
+                       pAppContext->prewarmedViewerNum ) );
+        }
     }
 
     #if ENABLE_TWCC_SUPPORT
@@ -1073,6 +1399,19 @@ static void HandleSdpOffer( AppContext_t * pAppContext,
                 skipProcess = 1;
             }
         }
+
+        if( skipProcess == 0 )
+        {
+            /* REMB feedback goes through the same rate controller as TWCC. */
+            peerConnectionResult = PeerConnection_SetReceiverEstimatedMaximumBitrateCallback( &pAppSession->peerConnectionSession,
+                                                                                              SampleReceiverEstimatedMaximumBitrateHandler,
+                                                                                              pAppSession );
+            if( peerConnectionResult != PEER_CONNECTION_RESULT_OK )
+            {
+                LogError( ( "Fail to set Receiver Estimated Maximum Bitrate Callback, result: %d", peerConnectionResult ) );
+                skipProcess = 1;
+            }
+        }
     #endif
 }
 
@@ -1509,7 +1848,6 @@ int AppCommon_Init( AppContext_t * pAppContext,
     int ret = 0;
     SignalingControllerResult_t signalingControllerReturn;
     SSLCredentials_t sslCreds;
-    int i;
 
     if( ( pAppContext == NULL ) ||
         ( pMediaContext == NULL ) ||
@@ -1602,15 +1940,24 @@ int AppCommon_Init( AppContext_t * pAppContext,
 
     if( ret == 0 )
     {
-        for( i = 0; i < AWS_MAX_VIEWER_NUM; i++ )
+        /* The sessions are allocated on demand, see AppCommon_GetPeerConnectionSession. */
+        pAppContext->maxViewerNum = AWS_MAX_VIEWER_NUM;
+        pAppContext->prewarmedViewerNum = AWS_PREWARMED_VIEWER_NUM;
+        if( pthread_mutex_init( &pAppContext->appSessionsMutex,
+                                NULL ) != 0 )
         {
-            ret = InitializeAppSession( pAppContext,
-                                        &( pAppContext->appSessions[ i ] ) );
-            if( ret != 0 )
-            {
-                LogError( ( "Fail to initialize peer connection sessions." ) );
-                break;
-            }
+            LogError( ( "Failed to create appSessionsMutex mutex" ) );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        if( pthread_cond_init( &pAppContext->appSessionsCond,
+                               NULL ) != 0 )
+        {
+            LogError( ( "Failed to create appSessionsCond condition variable" ) );
+            ret = -1;
         }
     }
 
@@ -1622,12 +1969,68 @@ int AppCommon_StartSignalingController( AppContext_t * pAppContext )
     int ret = 0;
     uint64_t barrierResult = 0;
     ssize_t retRead;
+    uint32_t bucketNum;
 
     if( pAppContext == NULL )
     {
         LogError( ( "Invalid parameter, pAppContext: %p", pAppContext ) );
         ret = -1;
     }
+    else if( ( pAppContext->maxViewerNum == 0U ) || ( pAppContext->maxViewerNum > APP_COMMON_MAX_VIEWER_NUM_LIMIT ) )
+    {
+        LogError( ( "Invalid max viewer number: %u, it must be 1 ~ %d", pAppContext->maxViewerNum, APP_COMMON_MAX_VIEWER_NUM_LIMIT ) );
+        ret = -1;
+    }
+    else if( pAppContext->prewarmedViewerNum > pAppContext->maxViewerNum )
+    {
+        LogError( ( "Invalid pre-warmed viewer number: %u, it must be 0 ~ %u", pAppContext->prewarmedViewerNum, pAppContext->maxViewerNum ) );
+        ret = -1;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( ret == 0 )
+    {
+        /* Keep the load factor of the hash table at 0.5 or lower. */
+        bucketNum = 1U;
+        while( bucketNum < ( pAppContext->maxViewerNum << 1 ) )
+        {
+            bucketNum <<= 1;
+        }
+
+        pAppContext->ppAppSessions = ( AppSession_t ** ) calloc( pAppContext->maxViewerNum,
+                                                                 sizeof( AppSession_t * ) );
+        pAppContext->ppAppSessionBuckets = ( AppSession_t ** ) calloc( bucketNum,
+                                                                       sizeof( AppSession_t * ) );
+        if( ( pAppContext->ppAppSessions == NULL ) || ( pAppContext->ppAppSessionBuckets == NULL ) )
+        {
+            LogError( ( "Fail to allocate peer connection session pool for %u viewers", pAppContext->maxViewerNum ) );
+            free( pAppContext->ppAppSessions );
+            free( pAppContext->ppAppSessionBuckets );
+            pAppContext->ppAppSessions = NULL;
+            pAppContext->ppAppSessionBuckets = NULL;
+            ret = -1;
+        }
+        else
+        {
+            pAppContext->appSessionBucketMask = bucketNum - 1U;
+        }
+    }
+
+    if( ( ret == 0 ) && ( pAppContext->prewarmedViewerNum > 0U ) )
+    {
+        /* Start pre-warming before connecting, so the first offer finds an idle session. */
+        if( pthread_create( &pAppContext->appSessionsRefillTid,
+                            NULL,
+                            AppSessionsRefill_Task,
+                            pAppContext ) != 0 )
+        {
+            LogError( ( "Fail to create peer connection session refill task." ) );
+            ret = -1;
+        }
+    }
 
     if( ret == 0 )
     {
@@ -1674,47 +2077,80 @@ AppSession_t * AppCommon_GetPeerConnectionSession( AppContext_t * pAppContext,
                                                    size_t remoteClientIdLength )
 {
     AppSession_t * pAppSession = NULL;
-    int i;
+    AppSession_t * pExistingAppSession;
     int32_t initResult;
 
-    for( i = 0; i < AWS_MAX_VIEWER_NUM; i++ )
+    if( remoteClientIdLength > REMOTE_ID_MAX_LENGTH )
     {
-        if( ( pAppContext->appSessions[i].remoteClientIdLength == remoteClientIdLength ) &&
-            ( strncmp( pAppContext->appSessions[i].remoteClientId, pRemoteClientId, remoteClientIdLength ) == 0 ) )
-        {
-            /* Found existing session. */
-            pAppSession = &pAppContext->appSessions[i];
-            break;
-        }
-        else if( ( pAppSession == NULL ) &&
-                 ( pAppContext->appSessions[i].peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_INITED ) )
-        {
-            /* Found free session, keep looping to find existing one. */
-            pAppSession = &pAppContext->appSessions[i];
-        }
-        else
+        LogWarn( ( "The remote client ID length(%lu) is too long to store.", remoteClientIdLength ) );
+    }
+    else if( pthread_mutex_lock( &pAppContext->appSessionsMutex ) != 0 )
+    {
+        LogError( ( "Fail to lock peer connection session pool." ) );
+    }
+    else
+    {
+        pAppSession = FindAppSession( pAppContext,
+                                      pRemoteClientId,
+                                      remoteClientIdLength );
+
+        if( pAppSession == NULL )
         {
-            /* Do nothing. */
+            /* New remote client, take a session from the pool. */
+            pAppSession = AcquireAppSession( pAppContext );
+
+            /* The lock is dropped while waiting for or initializing the session, the client might have one by now. */
+            pExistingAppSession = FindAppSession( pAppContext,
+                                                  pRemoteClientId,
+                                                  remoteClientIdLength );
+            if( pExistingAppSession != NULL )
+            {
+                if( pAppSession != NULL )
+                {
+                    PushFreeAppSession( pAppContext,
+                                        pAppSession );
+                }
+
+                pAppSession = pExistingAppSession;
+            }
+            else if( pAppSession != NULL )
+            {
+                pAppSession->remoteClientIdLength = remoteClientIdLength;
+                if( remoteClientIdLength > 0U )
+                {
+                    memcpy( pAppSession->remoteClientId, pRemoteClientId, remoteClientIdLength );
+                }
+                HashAppSession( pAppContext,
+                                pAppSession );
+            }
         }
-    }
 
-    if( ( pAppSession != NULL ) && ( pAppSession->peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_INITED ) )
-    {
-        /* Initialize Peer Connection. */
-        LogDebug( ( "Start peer connection on idx: %d for client ID(%lu): %.*s",
-                    i,
-                    remoteClientIdLength,
-                    ( int ) remoteClientIdLength,
-                    pRemoteClientId ) );
-        initResult = StartPeerConnectionSession( pAppContext,
-                                                 pAppSession,
-                                                 pRemoteClientId,
-                                                 remoteClientIdLength );
-        if( initResult != 0 )
+        /* Start it with the pool locked, so the session can't be returned while it's starting. */
+        if( ( pAppSession != NULL ) && ( pAppSession->peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_INITED ) )
         {
-            pAppSession = NULL;
+            /* Initialize Peer Connection. */
+            LogDebug( ( "Start peer connection session %p for client ID(%lu): %.*s",
+                        pAppSession,
+                        remoteClientIdLength,
+                        ( int ) remoteClientIdLength,
+                        pRemoteClientId ) );
+            initResult = StartPeerConnectionSession( pAppContext,
+                                                     pAppSession );
+            if( initResult != 0 )
+            {
+                ReturnAppSession( pAppContext,
+                                  pAppSession );
+                pAppSession = NULL;
+            }
         }
+
+        pthread_mutex_unlock( &pAppContext->appSessionsMutex );
     }
 
     return pAppSession;
 }
+
+uint32_t AppCommon_GetAppSessionCount( AppContext_t * pAppContext )
+{
+    return atomic_load( &pAppContext->appSessionCount );
+}
@@ -18,16 +18,34 @@
 #define APP_COMMON_H
 
 #include <stdio.h>
+#include <stdatomic.h>
 #include <pthread.h>
 #include "sdp_controller.h"
 #include "signaling_controller.h"
 #include "peer_connection.h"
+#include "demo_config.h"
 
 #define DEMO_SDP_BUFFER_MAX_LENGTH ( 10000 )
 #define DEMO_TRANSCEIVER_MEDIA_INDEX_VIDEO ( 0 )
 #define DEMO_TRANSCEIVER_MEDIA_INDEX_AUDIO ( 1 )
 #define REMOTE_ID_MAX_LENGTH    ( 256 )
 
+/* The upper bound of AppContext_t.maxViewerNum, the number of peer connection sessions in the pool. */
+#define APP_COMMON_MAX_VIEWER_NUM_LIMIT ( 500 )
+
+/* Defaults for the configs missing in demo_config.h, e.g. the one copied from an older template. */
+#ifndef AWS_MAX_VIEWER_NUM
+#define AWS_MAX_VIEWER_NUM ( 2 )
+#endif
+
+#ifndef AWS_PREWARMED_VIEWER_NUM
+#define AWS_PREWARMED_VIEWER_NUM ( 1 )
+#endif
+
+/* Bits of isMediaBitrateModified, each encoder consumes its own one. */
+#define APP_COMMON_MEDIA_BITRATE_MODIFIED_VIDEO ( 1U << 0 )
+#define APP_COMMON_MEDIA_BITRATE_MODIFIED_AUDIO ( 1U << 1 )
+
 struct AppMediaSourcesContext;
 typedef struct AppMediaSourcesContext AppMediaSourcesContext_t;
 
@@ -53,6 +71,10 @@ typedef struct AppSession
 
     /* Reverse pointer to AppContext */
     struct AppContext * pAppContext;
+
+    /* Next session in the same hash bucket, or in the free list once the session is returned. */
+    struct AppSession * pNext;
+    uint8_t isHashed;
 } AppSession_t;
 
 typedef struct AppContext
@@ -71,8 +93,26 @@ typedef struct AppContext
 
     char sdpBuffer[ PEER_CONNECTION_SDP_DESCRIPTION_BUFFER_MAX_LENGTH ];
 
-    /* Peer Connection. */
-    AppSession_t appSessions[ AWS_MAX_VIEWER_NUM ];
+    /* Peer Connection session pool. It holds up to maxViewerNum sessions, and the refill task keeps prewarmedViewerNum
+     * of them initialized and idle in the free list. Set them between AppCommon_Init and AppCommon_StartSignalingController
+     * to change the AWS_MAX_VIEWER_NUM and AWS_PREWARMED_VIEWER_NUM defaults.
+     * Sessions are allocated when needed and returned to the free list when closed, they're never freed,
+     * so ppAppSessions[ 0 ~ appSessionCount - 1 ] are always valid to iterate without the lock. */
+    uint32_t maxViewerNum;
+    uint32_t prewarmedViewerNum;
+    pthread_mutex_t appSessionsMutex;
+    /* Signaled when the free list needs a refill, or when a session is added to it. */
+    pthread_cond_t appSessionsCond;
+    pthread_t appSessionsRefillTid;
+    AppSession_t ** ppAppSessions;
+    atomic_uint appSessionCount;
+    /* The sessions allocated plus the ones being initialized. */
+    uint32_t reservedAppSessionCount;
+    AppSession_t * pFreeAppSessions;
+    uint32_t freeAppSessionCount;
+    /* Hash table of the sessions in use, keyed by remote client ID. */
+    AppSession_t ** ppAppSessionBuckets;
+    uint32_t appSessionBucketMask;
 
     /* Media context. */
     InitTransceiverFunc_t initTransceiverFunc;
@@ -92,5 +132,6 @@ void AppCommon_WaitSignalingControllerStop( AppContext_t * pAppContext );
 AppSession_t * AppCommon_GetPeerConnectionSession( AppContext_t * pAppContext,
                                                    const char * pRemoteClientId,
                                                    size_t remoteClientIdLength );
+uint32_t AppCommon_GetAppSessionCount( AppContext_t * pAppContext );
 
 #endif /* APP_COMMON_H */
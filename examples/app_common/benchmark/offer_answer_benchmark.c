@@ -0,0 +1,394 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Measure the SDP offer to answer latency of the master, with and without pre-warmed sessions.
+ * This file replaces the signaling controller: it delivers one offer per viewer to app_common and takes the time until
+ * the answer is sent. Before each offer it waits for the refill task, so every offer finds the pre-warmed sessions.
+ * The run fails if any offer is not answered.
+ * Usage: OfferAnswerBenchmark [offer num] [pre-warmed viewer num] */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "logging.h"
+#include "app_common.h"
+#include "app_media_source.h"
+#include "signaling_controller.h"
+
+#define OFFER_ANSWER_BENCHMARK_DEFAULT_OFFER_NUM ( 10 )
+#define OFFER_ANSWER_BENCHMARK_DEFAULT_PREWARMED_VIEWER_NUM ( 1 )
+#define OFFER_ANSWER_BENCHMARK_POLL_INTERVAL_US ( 1000 )
+
+/* An offer with one H264 video and one Opus audio track, as a browser viewer sends it. */
+#define OFFER_ANSWER_BENCHMARK_SDP_OFFER                                                                      \
+    "v=0\r\n"                                                                                                 \
+    "o=- 4327487954137960340 2 IN IP4 127.0.0.1\r\n"                                                          \
+    "s=-\r\n"                                                                                                 \
+    "t=0 0\r\n"                                                                                               \
+    "a=group:BUNDLE 0 1\r\n"                                                                                  \
+    "a=msid-semantic: WMS\r\n"                                                                                \
+    "m=video 9 UDP/TLS/RTP/SAVPF 102\r\n"                                                                     \
+    "c=IN IP4 0.0.0.0\r\n"                                                                                    \
+    "a=rtcp:9 IN IP4 0.0.0.0\r\n"                                                                             \
+    "a=ice-ufrag:Kx9Q\r\n"                                                                                    \
+    "a=ice-pwd:UzZ1qPJcmJ0z0ZlsHCKb7Qe4\r\n"                                                                  \
+    "a=ice-options:trickle\r\n"                                                                               \
+    "a=fingerprint:sha-256 5A:1B:87:2C:0E:6F:3A:91:BF:44:27:D0:8E:73:C2:19:6B:0F:A5:3D:E8:52:7C:14:99:D6:30:4B:E1:8A:F2:07\r\n" \
+    "a=setup:actpass\r\n"                                                                                     \
+    "a=mid:0\r\n"                                                                                             \
+    "a=recvonly\r\n"                                                                                          \
+    "a=rtcp-mux\r\n"                                                                                          \
+    "a=rtcp-rsize\r\n"                                                                                        \
+    "a=rtpmap:102 H264/90000\r\n"                                                                             \
+    "a=rtcp-fb:102 nack\r\n"                                                                                  \
+    "a=rtcp-fb:102 nack pli\r\n"                                                                              \
+    "a=fmtp:102 level-asymmetry-allowed=1;packetization-mode=1;profile-level-id=42e01f\r\n"                   \
+    "m=audio 9 UDP/TLS/RTP/SAVPF 111\r\n"                                                                     \
+    "c=IN IP4 0.0.0.0\r\n"                                                                                    \
+    "a=rtcp:9 IN IP4 0.0.0.0\r\n"                                                                             \
+    "a=ice-ufrag:Kx9Q\r\n"                                                                                    \
+    "a=ice-pwd:UzZ1qPJcmJ0z0ZlsHCKb7Qe4\r\n"                                                                  \
+    "a=ice-options:trickle\r\n"                                                                               \
+    "a=fingerprint:sha-256 5A:1B:87:2C:0E:6F:3A:91:BF:44:27:D0:8E:73:C2:19:6B:0F:A5:3D:E8:52:7C:14:99:D6:30:4B:E1:8A:F2:07\r\n" \
+    "a=setup:actpass\r\n"                                                                                     \
+    "a=mid:1\r\n"                                                                                             \
+    "a=recvonly\r\n"                                                                                          \
+    "a=rtcp-mux\r\n"                                                                                          \
+    "a=rtpmap:111 opus/48000/2\r\n"                                                                           \
+    "a=fmtp:111 minptime=10;useinbandfec=1\r\n"
+
+typedef struct OfferAnswerBenchmarkContext
+{
+    SignalingControllerConnectionStateCallback_t connectionStateCallback;
+    void * pConnectionStateCallbackContext;
+    uint32_t offerNum;
+    uint32_t answerNum;
+    uint64_t answerTimeUs;
+    uint64_t * pLatencyUs;
+} OfferAnswerBenchmarkContext_t;
+
+AppContext_t appContext;
+AppMediaSourcesContext_t appMediaSourceContext;
+
+static OfferAnswerBenchmarkContext_t benchmarkContext;
+
+static uint64_t GetMonotonicTimeUs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000ULL + ( uint64_t ) now.tv_nsec / 1000ULL;
+}
+
+static int CompareLatency( const void * pA,
+                           const void * pB )
+{
+    uint64_t a = *( const uint64_t * ) pA;
+    uint64_t b = *( const uint64_t * ) pB;
+
+    return ( a > b ) - ( a < b );
+}
+
+/* Wait until no session is being initialized, and the free list is full or the pool can't grow any more. */
+static void WaitForPrewarmedSessions( AppContext_t * pAppContext )
+{
+    uint8_t isReady = 0U;
+
+    while( isReady == 0U )
+    {
+        ( void ) pthread_mutex_lock( &pAppContext->appSessionsMutex );
+        if( ( pAppContext->reservedAppSessionCount == atomic_load( &pAppContext->appSessionCount ) ) &&
+            ( ( pAppContext->freeAppSessionCount >= pAppContext->prewarmedViewerNum ) ||
+              ( pAppContext->reservedAppSessionCount >= pAppContext->maxViewerNum ) ) )
+        {
+            isReady = 1U;
+        }
+        pthread_mutex_unlock( &pAppContext->appSessionsMutex );
+
+        if( isReady == 0U )
+        {
+            usleep( OFFER_ANSWER_BENCHMARK_POLL_INTERVAL_US );
+        }
+    }
+}
+
+static int32_t InitTransceiver( void * pMediaCtx,
+                                TransceiverTrackKind_t trackKind,
+                                Transceiver_t * pTranceiver )
+{
+    int32_t ret = 0;
+    AppMediaSourcesContext_t * pMediaSourceContext = ( AppMediaSourcesContext_t * ) pMediaCtx;
+
+    switch( trackKind )
+    {
+        case TRANSCEIVER_TRACK_KIND_VIDEO:
+            ret = AppMediaSource_InitVideoTransceiver( pMediaSourceContext,
+                                                       pTranceiver );
+            break;
+        case TRANSCEIVER_TRACK_KIND_AUDIO:
+            ret = AppMediaSource_InitAudioTransceiver( pMediaSourceContext,
+                                                       pTranceiver );
+            break;
+        default:
+            LogError( ( "Invalid track kind: %d", trackKind ) );
+            ret = -1;
+            break;
+    }
+
+    return ret;
+}
+
+SignalingControllerResult_t SignalingController_Init( SignalingControllerContext_t * pCtx,
+                                                      const SSLCredentials_t * pSslCreds )
+{
+    ( void ) pCtx;
+    ( void ) pSslCreds;
+
+    return SIGNALING_CONTROLLER_RESULT_OK;
+}
+
+SignalingControllerResult_t SignalingController_SetConnectionStateCallback( SignalingControllerContext_t * pCtx,
+                                                                            SignalingControllerConnectionStateCallback_t callback,
+                                                                            void * pCustomContext )
+{
+    ( void ) pCtx;
+
+    benchmarkContext.connectionStateCallback = callback;
+    benchmarkContext.pConnectionStateCallbackContext = pCustomContext;
+
+    return SIGNALING_CONTROLLER_RESULT_OK;
+}
+
+SignalingControllerResult_t SignalingController_StartListening( SignalingControllerContext_t * pCtx,
+                                                                const SignalingControllerConnectInfo_t * pConnectInfo )
+{
+    SignalingMessage_t signalingMessage;
+    char remoteClientId[ SIGNALING_CONTROLLER_REMOTE_CLIENT_ID_MAX_LENGTH ];
+    uint64_t offerTimeUs;
+    uint32_t i;
+
+    ( void ) pCtx;
+
+    benchmarkContext.connectionStateCallback( SIGNALING_CONTROLLER_STATE_CONNECTED,
+                                              benchmarkContext.pConnectionStateCallbackContext );
+
+    for( i = 0; i < benchmarkContext.offerNum; i++ )
+    {
+        WaitForPrewarmedSessions( ( AppContext_t * ) pConnectInfo->pMessageReceivedCallbackData );
+
+        memset( &signalingMessage, 0, sizeof( SignalingMessage_t ) );
+        signalingMessage.remoteClientIdLength = snprintf( remoteClientId,
+                                                          sizeof( remoteClientId ),
+                                                          "%s%u",
+                                                          SIGNALING_CONTROLLER_VIEWER_CLIENT_ID_PREFIX,
+                                                          i );
+        signalingMessage.pRemoteClientId = remoteClientId;
+        signalingMessage.messageType = SIGNALING_TYPE_MESSAGE_SDP_OFFER;
+        signalingMessage.pMessage = OFFER_ANSWER_BENCHMARK_SDP_OFFER;
+        signalingMessage.messageLength = strlen( OFFER_ANSWER_BENCHMARK_SDP_OFFER );
+
+        benchmarkContext.answerTimeUs = 0U;
+        offerTimeUs = GetMonotonicTimeUs();
+        ( void ) pConnectInfo->messageReceivedCallback( &signalingMessage,
+                                                        pConnectInfo->pMessageReceivedCallbackData );
+
+        if( benchmarkContext.answerTimeUs == 0U )
+        {
+            LogError( ( "Offer %u is not answered", i ) );
+            break;
+        }
+
+        benchmarkContext.pLatencyUs[ benchmarkContext.answerNum ] = benchmarkContext.answerTimeUs - offerTimeUs;
+        benchmarkContext.answerNum++;
+    }
+
+    return SIGNALING_CONTROLLER_RESULT_OK;
+}
+
+SignalingControllerResult_t SignalingController_SendMessage( SignalingControllerContext_t * pCtx,
+                                                             const SignalingMessage_t * pSignalingMessage )
+{
+    ( void ) pCtx;
+
+    /* The answer is sent from the thread delivering the offer, the candidates from the peer connection tasks. */
+    if( pSignalingMessage->messageType == SIGNALING_TYPE_MESSAGE_SDP_ANSWER )
+    {
+        benchmarkContext.answerTimeUs = GetMonotonicTimeUs();
+    }
+
+    return SIGNALING_CONTROLLER_RESULT_OK;
+}
+
+SignalingControllerResult_t SignalingController_QueryIceServerConfigs( SignalingControllerContext_t * pCtx,
+                                                                       IceServerConfig_t ** ppIceServerConfigs,
+                                                                       size_t * pIceServerConfigsCount )
+{
+    ( void ) pCtx;
+
+    /* Gather host candidates only, so the latency doesn't depend on the network. */
+    *ppIceServerConfigs = NULL;
+    *pIceServerConfigsCount = 0U;
+
+    return SIGNALING_CONTROLLER_RESULT_OK;
+}
+
+SignalingControllerResult_t SignalingController_RefreshIceServerConfigs( SignalingControllerContext_t * pCtx )
+{
+    ( void ) pCtx;
+
+    return SIGNALING_CONTROLLER_RESULT_OK;
+}
+
+SignalingControllerResult_t SignalingController_ExtractSdpMessageFromSignalingMessage( const char * pSignalingMessage,
+                                                                                       size_t signalingMessageLength,
+                                                                                       uint8_t isSdpOffer,
+                                                                                       const char ** ppSdpMessage,
+                                                                                       size_t * pSdpMessageLength )
+{
+    ( void ) isSdpOffer;
+
+    /* The offers are delivered as plain SDP. */
+    *ppSdpMessage = pSignalingMessage;
+    *pSdpMessageLength = signalingMessageLength;
+
+    return SIGNALING_CONTROLLER_RESULT_OK;
+}
+
+SignalingControllerResult_t SignalingController_DeserializeSdpContentNewline( const char * pSdpMessage,
+                                                                              size_t sdpMessageLength,
+                                                                              char * pFormalSdpMessage,
+                                                                              size_t * pFormalSdpMessageLength )
+{
+    SignalingControllerResult_t ret = SIGNALING_CONTROLLER_RESULT_OK;
+
+    if( sdpMessageLength > *pFormalSdpMessageLength )
+    {
+        ret = SIGNALING_CONTROLLER_RESULT_FAIL;
+    }
+    else
+    {
+        memcpy( pFormalSdpMessage,
+                pSdpMessage,
+                sdpMessageLength );
+        *pFormalSdpMessageLength = sdpMessageLength;
+    }
+
+    return ret;
+}
+
+SignalingControllerResult_t SignalingController_SerializeSdpContentNewline( const char * pSdpMessage,
+                                                                            size_t sdpMessageLength,
+                                                                            char * pEventSdpMessage,
+                                                                            size_t * pEventSdpMessageLength )
+{
+    return SignalingController_DeserializeSdpContentNewline( pSdpMessage,
+                                                             sdpMessageLength,
+                                                             pEventSdpMessage,
+                                                             pEventSdpMessageLength );
+}
+
+int main( int argc,
+          char * argv[] )
+{
+    int ret = 0;
+    uint32_t offerNum = OFFER_ANSWER_BENCHMARK_DEFAULT_OFFER_NUM;
+    uint32_t prewarmedViewerNum = OFFER_ANSWER_BENCHMARK_DEFAULT_PREWARMED_VIEWER_NUM;
+
+    if( argc > 1 )
+    {
+        offerNum = ( uint32_t ) strtoul( argv[ 1 ], NULL, 10 );
+    }
+    if( argc > 2 )
+    {
+        prewarmedViewerNum = ( uint32_t ) strtoul( argv[ 2 ], NULL, 10 );
+    }
+
+    /* Every offer comes from a new viewer, so the pool never reuses a session. */
+    if( ( offerNum == 0 ) ||
+        ( offerNum > APP_COMMON_MAX_VIEWER_NUM_LIMIT ) ||
+        ( prewarmedViewerNum > offerNum ) )
+    {
+        LogError( ( "Invalid input, offer num: %u, pre-warmed viewer num: %u", offerNum, prewarmedViewerNum ) );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        memset( &benchmarkContext, 0, sizeof( OfferAnswerBenchmarkContext_t ) );
+        benchmarkContext.offerNum = offerNum;
+        benchmarkContext.pLatencyUs = ( uint64_t * ) calloc( offerNum,
+                                                             sizeof( uint64_t ) );
+        if( benchmarkContext.pLatencyUs == NULL )
+        {
+            LogError( ( "Fail to allocate memory for %u offers", offerNum ) );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        ret = AppCommon_Init( &appContext, InitTransceiver, &appMediaSourceContext );
+    }
+
+    if( ret == 0 )
+    {
+        memcpy( &( appContext.signalingControllerClientId[ 0 ] ), SIGNALING_CONTROLLER_MASTER_CLIENT_ID, SIGNALING_CONTROLLER_MASTER_CLIENT_ID_LENGTH );
+        appContext.signalingControllerClientId[ SIGNALING_CONTROLLER_MASTER_CLIENT_ID_LENGTH ] = '\0';
+        appContext.signalingControllerClientIdLength = SIGNALING_CONTROLLER_MASTER_CLIENT_ID_LENGTH;
+        appContext.signalingControllerRole = SIGNALING_ROLE_MASTER;
+        appContext.maxViewerNum = offerNum;
+        appContext.prewarmedViewerNum = prewarmedViewerNum;
+
+        ret = AppCommon_StartSignalingController( &appContext );
+    }
+
+    if( ret == 0 )
+    {
+        AppCommon_WaitSignalingControllerStop( &appContext );
+
+        printf( "Offers: %u, answered: %u, pre-warmed sessions: %u\n",
+                offerNum,
+                benchmarkContext.answerNum,
+                prewarmedViewerNum );
+
+        if( benchmarkContext.answerNum != offerNum )
+        {
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        qsort( benchmarkContext.pLatencyUs,
+               offerNum,
+               sizeof( uint64_t ),
+               CompareLatency );
+
+        printf( "Offer to answer: min %lu us, p50 %lu us, max %lu us\n",
+                benchmarkContext.pLatencyUs[ 0 ],
+                benchmarkContext.pLatencyUs[ offerNum / 2U ],
+                benchmarkContext.pLatencyUs[ offerNum - 1U ] );
+    }
+
+    free( benchmarkContext.pLatencyUs );
+
+    return ret;
+}
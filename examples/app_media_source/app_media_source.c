@@ -23,6 +23,7 @@
 
 #include "demo_config.h"
 #include "app_media_source.h"
+#include "app_common.h"
 
 #define DEFAULT_TRANSCEIVER_ROLLING_BUFFER_DURACTION_SECOND ( 3 )
 
@@ -279,7 +280,7 @@ static int32_t OnPcEventRemotePeerReady( AppMediaSourceContext_t * pMediaSource
     {
         if( pthread_mutex_lock( &( pMediaSource->pSourcesContext->mediaMutex ) ) == 0 )
         {
-            if( pMediaSource->numReadyPeer < AWS_MAX_VIEWER_NUM )
+            if( pMediaSource->numReadyPeer < APP_COMMON_MAX_VIEWER_NUM_LIMIT )
             {
                 pMediaSource->numReadyPeer++;
             }
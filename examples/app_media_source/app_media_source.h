@@ -44,7 +44,7 @@ typedef int32_t (* AppMediaSourceOnMediaSinkHook)( void * pCustom,
 typedef struct AppMediaSourceContext
 {
     MessageQueueHandler_t dataQueue;
-    uint8_t numReadyPeer;
+    uint32_t numReadyPeer;
     TransceiverTrackKind_t trackKind;
     int32_t fileIndex;
 
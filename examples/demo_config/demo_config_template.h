@@ -33,6 +33,18 @@
 #define ENABLE_TWCC_SUPPORT 1U
 #endif
 
+/* Let the kernel pace the RTP packets by SO_TXTIME departure times instead of sleeping in the pacer task.
+ * It needs the fq qdisc on the egress interface, e.g. "tc qdisc replace dev eth0 root fq". */
+#ifndef ENABLE_KERNEL_PACING
+#define ENABLE_KERNEL_PACING 0U
+#endif
+
+/* Keep bound host sockets, the local interface addresses and the DNS results of the ICE servers ready in the background,
+ * so a new session gathers its candidates without waiting for them. Set it to 0 to gather them on demand. */
+#ifndef ENABLE_ICE_WARM_POOL
+#define ENABLE_ICE_WARM_POOL 1U
+#endif
+
 /* Uncomment to use fetching credentials by IoT Role-alias for Authentication */
 // #define AWS_CREDENTIALS_ENDPOINT ""
 // #define AWS_IOT_THING_NAME ""
@@ -49,7 +61,18 @@
 #error "Configuration Error: AWS_ACCESS_KEY_ID and AWS_IOT_THING_ROLE_ALIAS are mutually exclusive authentication methods. Please define only one of them."
 #endif /* #if defined( AWS_ACCESS_KEY_ID ) && defined( AWS_IOT_THING_ROLE_ALIAS ). */
 
+/* The default number of viewers served at the same time, 1 ~ 500. The peer connection sessions are allocated
+ * on demand up to this number, applications can change it at runtime through AppContext_t.maxViewerNum. */
+#ifndef AWS_MAX_VIEWER_NUM
 #define AWS_MAX_VIEWER_NUM ( 2 )
+#endif
+
+/* The number of idle peer connection sessions kept initialized in the background, so an SDP offer claims one
+ * without waiting for the session initialization. Set it to 0 to initialize the sessions on demand.
+ * Applications can change it through AppContext_t.prewarmedViewerNum before starting the signaling controller. */
+#ifndef AWS_PREWARMED_VIEWER_NUM
+#define AWS_PREWARMED_VIEWER_NUM ( 1 )
+#endif
 
 /* Audio codec setting. */
 #define AUDIO_OPUS         1
@@ -22,6 +22,10 @@
 AppContext_t appContext;
 GstMediaSourcesContext_t gstMediaSourceContext;
 
+/* Frames are packetized once and shared by all viewers. Video and audio are delivered by different threads. */
+static PeerConnectionPacketizedFrame_t packetizedVideoFrame;
+static PeerConnectionPacketizedFrame_t packetizedAudioFrame;
+
 static void SignalHandler( int signum );
 static int32_t InitTransceiver( void * pMediaCtx,
                                 TransceiverTrackKind_t trackKind,
@@ -108,6 +112,7 @@ static int32_t InitTransceiver( void * pMediaCtx,
         uint8_t isBitrateModifiedLocked = 0;
         uint8_t isTwccLocked = 0;
         uint8_t shouldModify = 0;
+        uint8_t modifiedFlag = 0;
         uint32_t tempBitrate;
         uint32_t minBitrate = UINT32_MAX;
         uint8_t isVideoEncoder = 0;
@@ -145,10 +150,11 @@ static int32_t InitTransceiver( void * pMediaCtx,
 
         if( ( ret == 0 ) && ( isBitrateModifiedLocked == 1 ) )
         {
-            shouldModify = pAppContext->isMediaBitrateModified;
-            if( shouldModify == 1 )
+            modifiedFlag = isVideoEncoder ? APP_COMMON_MEDIA_BITRATE_MODIFIED_VIDEO : APP_COMMON_MEDIA_BITRATE_MODIFIED_AUDIO;
+            if( ( pAppContext->isMediaBitrateModified & modifiedFlag ) != 0 )
             {
-                pAppContext->isMediaBitrateModified = 0; // Reset flag
+                shouldModify = 1;
+                pAppContext->isMediaBitrateModified &= ~modifiedFlag; // Reset own flag, the other encoder still needs its one
             }
         }
 
@@ -161,35 +167,39 @@ static int32_t InitTransceiver( void * pMediaCtx,
         if( shouldModify == 1 )
         {
 
-            for( int i = 0; i < AWS_MAX_VIEWER_NUM; i++ )
+            uint32_t appSessionCount = AppCommon_GetAppSessionCount( pAppContext );
+
+            for( uint32_t i = 0; i < appSessionCount; i++ )
             {
-                if( pAppContext->appSessions[i].peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
+                AppSession_t * pAppSession = pAppContext->ppAppSessions[ i ];
+
+                if( pAppSession->peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
                 {
                     uint32_t sessionBitrate = 0;
 
-                    if( pthread_mutex_lock( &( pAppContext->appSessions[i].peerConnectionSession.twccMetaData.twccBitrateMutex ) ) == 0 )
+                    if( pthread_mutex_lock( &( pAppSession->peerConnectionSession.twccMetaData.twccBitrateMutex ) ) == 0 )
                     {
                         isTwccLocked = 1;
                     }
                     else
                     {
-                        LogError( ( "Failed to lock Twcc mutex for session %d.", i ) );
+                        LogError( ( "Failed to lock Twcc mutex for session %u.", i ) );
                         ret = -1;
                     }
 
                     /* Assuming encoder is either video or audio encoder. */
                     if( isVideoEncoder )
                     {
-                        sessionBitrate = pAppContext->appSessions[i].peerConnectionSession.twccMetaData.modifiedVideoBitrateKbps;
+                        sessionBitrate = pAppSession->peerConnectionSession.twccMetaData.modifiedVideoBitrateKbps;
                     }
                     else
                     {
-                        sessionBitrate = pAppContext->appSessions[i].peerConnectionSession.twccMetaData.modifiedAudioBitrateBps;
+                        sessionBitrate = pAppSession->peerConnectionSession.twccMetaData.modifiedAudioBitrateBps;
                     }
 
                     if( isTwccLocked != 0 )
                     {
-                        pthread_mutex_unlock( &( pAppContext->appSessions[i].peerConnectionSession.twccMetaData.twccBitrateMutex ) );
+                        pthread_mutex_unlock( &( pAppSession->peerConnectionSession.twccMetaData.twccBitrateMutex ) );
                         isTwccLocked = 0;
                     }
 
@@ -208,16 +218,16 @@ static int32_t InitTransceiver( void * pMediaCtx,
                               &tempBitrate,
                               NULL );
 
-                LogInfo( ( "Current %s encoder bitrate: %u kbps", 
-                       isVideoEncoder ? "video" : "audio", tempBitrate ) );
+                LogInfo( ( "Current %s encoder bitrate: %u %s", 
+                       isVideoEncoder ? "video" : "audio", tempBitrate, isVideoEncoder ? "kbps" : "bps" ) );
 
                 g_object_set( G_OBJECT( pEncoder ),
                               "bitrate",
                               minBitrate,
                               NULL );
 
-                LogInfo( ( "Modified %s encoder bitrate to %u kbps", 
-                       isVideoEncoder ? "video" : "audio", minBitrate ) );
+                LogInfo( ( "Modified %s encoder bitrate to %u %s", 
+                       isVideoEncoder ? "video" : "audio", minBitrate, isVideoEncoder ? "kbps" : "bps" ) );
             }
         }
 
@@ -234,7 +244,12 @@ static int32_t OnMediaSinkHook( void * pCustom,
     PeerConnectionResult_t peerConnectionResult;
     Transceiver_t * pTransceiver = NULL;
     PeerConnectionFrame_t peerConnectionFrame;
-    int i;
+    PeerConnectionPacketizedFrame_t * pPacketizedFrame = NULL;
+    PeerConnectionResult_t packetizeResult = PEER_CONNECTION_RESULT_OK;
+    uint8_t isPacketized = 0U;
+    uint32_t i;
+    uint32_t appSessionCount;
+    AppSession_t * pAppSession;
 
     if( ( pAppContext == NULL ) || ( pFrame == NULL ) )
     {
@@ -249,15 +264,20 @@ static int32_t OnMediaSinkHook( void * pCustom,
         peerConnectionFrame.pData = pFrame->pData;
         peerConnectionFrame.dataLength = pFrame->size;
 
-        for( i = 0; i < AWS_MAX_VIEWER_NUM; i++ )
+        appSessionCount = AppCommon_GetAppSessionCount( pAppContext );
+        for( i = 0; i < appSessionCount; i++ )
         {
+            pAppSession = pAppContext->ppAppSessions[ i ];
+
             if( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO )
             {
-                pTransceiver = &pAppContext->appSessions[ i ].transceivers[ DEMO_TRANSCEIVER_MEDIA_INDEX_VIDEO ];
+                pTransceiver = &pAppSession->transceivers[ DEMO_TRANSCEIVER_MEDIA_INDEX_VIDEO ];
+                pPacketizedFrame = &packetizedVideoFrame;
             }
             else if( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_AUDIO )
             {
-                pTransceiver = &pAppContext->appSessions[ i ].transceivers[ DEMO_TRANSCEIVER_MEDIA_INDEX_AUDIO ];
+                pTransceiver = &pAppSession->transceivers[ DEMO_TRANSCEIVER_MEDIA_INDEX_AUDIO ];
+                pPacketizedFrame = &packetizedAudioFrame;
             }
             else
             {
@@ -266,11 +286,36 @@ static int32_t OnMediaSinkHook( void * pCustom,
                 break;
             }
 
-            if( pAppContext->appSessions[ i ].peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
+            if( pAppSession->peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
             {
-                peerConnectionResult = PeerConnection_WriteFrame( &pAppContext->appSessions[ i ].peerConnectionSession,
-                                                                  pTransceiver,
-                                                                  &peerConnectionFrame );
+                if( isPacketized == 0U )
+                {
+                    /* Packetize the frame at the first ready session, the rest of sessions only apply their own RTP headers and SRTP. */
+                    isPacketized = 1U;
+                    packetizeResult = PeerConnection_PacketizeFrame( pTransceiver,
+                                                                     &peerConnectionFrame,
+                                                                     pPacketizedFrame );
+                    if( packetizeResult != PEER_CONNECTION_RESULT_OK )
+                    {
+                        LogWarn( ( "Fail to packetize %s frame, write frame per session instead, result: %d", ( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO ) ? "video" : "audio",
+                                   packetizeResult ) );
+                    }
+                }
+
+                if( packetizeResult == PEER_CONNECTION_RESULT_OK )
+                {
+                    peerConnectionResult = PeerConnection_WritePacketizedFrame( &pAppSession->peerConnectionSession,
+                                                                                pTransceiver,
+                                                                                pPacketizedFrame );
+                }
+
+                if( ( packetizeResult != PEER_CONNECTION_RESULT_OK ) ||
+                    ( peerConnectionResult == PEER_CONNECTION_RESULT_PACKETIZED_FRAME_CODEC_MISMATCH ) )
+                {
+                    peerConnectionResult = PeerConnection_WriteFrame( &pAppSession->peerConnectionSession,
+                                                                      pTransceiver,
+                                                                      &peerConnectionFrame );
+                }
 
                 if( peerConnectionResult != PEER_CONNECTION_RESULT_OK )
                 {
@@ -44,6 +44,11 @@
 #define MAX_QUEUE_MSG_NUM ( 30 )
 #define REQUEST_QUEUE_POLL_ID ( 0 )
 
+/* IceController_AddToSendBatch() writes the TURN channel data header into the headroom in front of the packet,
+ * fail the build if the ICE library ever changes the header length. */
+_Static_assert( ICE_CONTROLLER_PACKET_HEADROOM == ICE_TURN_CHANNEL_DATA_MESSAGE_HEADER_LENGTH,
+                "ICE_CONTROLLER_PACKET_HEADROOM must match the TURN channel data header length." );
+
 static const uint32_t gCrc32Table[256] = {
     0x00000000, 0x77073096, 0xee0e612c, 0x990951ba, 0x076dc419, 0x706af48f, 0xe963a535, 0x9e6495a3, 0x0edb8832, 0x79dcb8a4, 0xe0d5e91e, 0x97d2d988,
     0x09b64c2b, 0x7eb17cbd, 0xe7b82d07, 0x90bf1d91, 0x1db71064, 0x6ab020f2, 0xf3b97148, 0x84be41de, 0x1adad47d, 0x6ddde4eb, 0xf4d4b551, 0x83d385c7,
@@ -732,6 +737,18 @@ static void ReleaseOtherSockets( IceControllerContext_t * pCtx,
     }
 }
 
+void IceController_HandleSocketEvents( IceControllerContext_t * pCtx )
+{
+    if( pCtx == NULL )
+    {
+        LogError( ( "Invalid input, pCtx: %p", pCtx ) );
+    }
+    else
+    {
+        IceControllerSocketListener_HandleSocketEvents( pCtx );
+    }
+}
+
 void IceController_HandleEvent( IceControllerContext_t * pCtx,
                                 IceControllerEvent_t event )
 {
@@ -1179,6 +1196,8 @@ IceControllerResult_t IceController_Init( IceControllerContext_t * pCtx,
 {
     IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
     TimerControllerResult_t retTimer;
+    uint8_t isSocketMutexInit = 0U;
+    uint8_t isSocketCondInit = 0U;
     int i;
 
     if( ( pCtx == NULL ) || ( pInitConfig == NULL ) )
@@ -1237,6 +1256,24 @@ IceControllerResult_t IceController_Init( IceControllerContext_t * pCtx,
             LogError( ( "Fail to create socket mutex for Ice controller." ) );
             ret = ICE_CONTROLLER_RESULT_FAIL_MUTEX_CREATE;
         }
+        else
+        {
+            isSocketMutexInit = 1U;
+        }
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        if( pthread_cond_init( &( pCtx->socketCond ),
+                               NULL ) != 0 )
+        {
+            LogError( ( "Fail to create socket condition variable for Ice controller." ) );
+            ret = ICE_CONTROLLER_RESULT_FAIL_MUTEX_CREATE;
+        }
+        else
+        {
+            isSocketCondInit = 1U;
+        }
     }
 
     if( ret == ICE_CONTROLLER_RESULT_OK )
@@ -1256,11 +1293,53 @@ IceControllerResult_t IceController_Init( IceControllerContext_t * pCtx,
         ret = IceControllerSocketListener_Init( pCtx,
                                                 pInitConfig->onRecvNonStunPacketFunc,
                                                 pInitConfig->pOnRecvNonStunPacketCallbackContext );
+        if( ret != ICE_CONTROLLER_RESULT_OK )
+        {
+            ( void ) pthread_mutex_destroy( &( pCtx->iceMutex ) );
+        }
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        /* Start warming up the sockets for the candidates before the first session starts gathering. */
+        IceControllerWarmPool_Init();
+    }
+    else if( ret != ICE_CONTROLLER_RESULT_BAD_PARAMETER )
+    {
+        /* Release what's created so far, the caller can free the context. */
+        TimerController_Delete( &pCtx->timerHandler );
+
+        if( isSocketCondInit != 0U )
+        {
+            ( void ) pthread_cond_destroy( &( pCtx->socketCond ) );
+        }
+
+        if( isSocketMutexInit != 0U )
+        {
+            ( void ) pthread_mutex_destroy( &( pCtx->socketMutex ) );
+        }
+    }
+    else
+    {
+        /* Empty else marker. */
     }
 
     return ret;
 }
 
+void IceController_Deinit( IceControllerContext_t * pCtx )
+{
+    if( pCtx != NULL )
+    {
+        /* The timer callback takes the mutexes, delete it first. */
+        TimerController_Delete( &pCtx->timerHandler );
+
+        ( void ) pthread_mutex_destroy( &( pCtx->iceMutex ) );
+        ( void ) pthread_cond_destroy( &( pCtx->socketCond ) );
+        ( void ) pthread_mutex_destroy( &( pCtx->socketMutex ) );
+    }
+}
+
 IceControllerResult_t IceController_DeserializeIceCandidate( const char * pDecodeMessage,
                                                              size_t decodeMessageLength,
                                                              IceControllerCandidate_t * pCandidate )
@@ -1573,52 +1652,49 @@ IceControllerResult_t IceController_Start( IceControllerContext_t * pCtx,
     return ret;
 }
 
-IceControllerResult_t IceController_SendToRemotePeer( IceControllerContext_t * pCtx,
-                                                      const uint8_t * pBuffer,
-                                                      size_t bufferLength )
+static IceControllerResult_t PrepareSendingBuffer( IceControllerContext_t * pCtx,
+                                                   const uint8_t * pBuffer,
+                                                   size_t bufferLength,
+                                                   uint8_t * pTurnSendBuffer,
+                                                   size_t turnSendBufferSize,
+                                                   const uint8_t ** ppSendingBuffer,
+                                                   size_t * pSendingBufferLength,
+                                                   IceEndpoint_t ** ppDestEndpoint )
 {
     IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
     IceResult_t iceResult;
-    const uint8_t * pSendingBuffer = pBuffer;
-    size_t sendingBufferLength = bufferLength;
     size_t turnBufferLength;
-    IceEndpoint_t * pDestEndpoint = NULL;
-    uint8_t turnSendBuffer[ ICE_CONTROLLER_MAX_MTU ];
 
-    if( ( pCtx == NULL ) ||
-        ( pBuffer == NULL ) )
+    /* The sending buffer is the input buffer by default, it's redirected to pTurnSendBuffer
+     * if TURN channel data header is required. If pTurnSendBuffer is the headroom in front of
+     * the input buffer, the header is added in place without copying the packet. */
+    *ppSendingBuffer = pBuffer;
+    *pSendingBufferLength = bufferLength;
+
+    if( ( pCtx->pNominatedSocketContext == NULL ) ||
+        ( pCtx->pNominatedSocketContext->state < ICE_CONTROLLER_SOCKET_CONTEXT_STATE_SELECTED ) )
     {
-        LogError( ( "Invalid input, pCtx: %p, pBuffer: %p", pCtx, pBuffer ) );
-        ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
+        LogWarn( ( "The connection of this session is not ready." ) );
+        ret = ICE_CONTROLLER_RESULT_FAIL_CONNECTION_NOT_READY;
     }
-
-    if( ret == ICE_CONTROLLER_RESULT_OK )
+    else if( pCtx->pNominatedSocketContext->pLocalCandidate == NULL )
     {
-        if( ( pCtx->pNominatedSocketContext == NULL ) ||
-            ( pCtx->pNominatedSocketContext->state < ICE_CONTROLLER_SOCKET_CONTEXT_STATE_SELECTED ) )
-        {
-            LogWarn( ( "The connection of this session is not ready." ) );
-            ret = ICE_CONTROLLER_RESULT_FAIL_CONNECTION_NOT_READY;
-        }
-        else if( pCtx->pNominatedSocketContext->pLocalCandidate == NULL )
-        {
-            LogWarn( ( "The connection of this session is not ready, local candidate pointer is NULL" ) );
-            ret = ICE_CONTROLLER_RESULT_FAIL_CONNECTION_NOT_READY;
-        }
-        else if( pCtx->pNominatedSocketContext->pRemoteCandidate == NULL )
-        {
-            LogWarn( ( "The connection of this session is not ready, remote candidate pointer is NULL" ) );
-            ret = ICE_CONTROLLER_RESULT_FAIL_CONNECTION_NOT_READY;
-        }
-        else if( pCtx->pNominatedSocketContext->pCandidatePair == NULL )
-        {
-            LogWarn( ( "The connection of this session is not ready, candidate pair pointer is NULL" ) );
-            ret = ICE_CONTROLLER_RESULT_FAIL_CONNECTION_NOT_READY;
-        }
-        else
-        {
-            pDestEndpoint = &pCtx->pNominatedSocketContext->pRemoteCandidate->endpoint;
-        }
+        LogWarn( ( "The connection of this session is not ready, local candidate pointer is NULL" ) );
+        ret = ICE_CONTROLLER_RESULT_FAIL_CONNECTION_NOT_READY;
+    }
+    else if( pCtx->pNominatedSocketContext->pRemoteCandidate == NULL )
+    {
+        LogWarn( ( "The connection of this session is not ready, remote candidate pointer is NULL" ) );
+        ret = ICE_CONTROLLER_RESULT_FAIL_CONNECTION_NOT_READY;
+    }
+    else if( pCtx->pNominatedSocketContext->pCandidatePair == NULL )
+    {
+        LogWarn( ( "The connection of this session is not ready, candidate pair pointer is NULL" ) );
+        ret = ICE_CONTROLLER_RESULT_FAIL_CONNECTION_NOT_READY;
+    }
+    else
+    {
+        *ppDestEndpoint = &pCtx->pNominatedSocketContext->pRemoteCandidate->endpoint;
     }
 
     if( ret == ICE_CONTROLLER_RESULT_OK )
@@ -1627,21 +1703,24 @@ IceControllerResult_t IceController_SendToRemotePeer( IceControllerContext_t * p
         {
             if( bufferLength + ICE_TURN_CHANNEL_DATA_MESSAGE_HEADER_LENGTH > ICE_CONTROLLER_MAX_MTU )
             {
-                LogError( ( "The sending buffer is larger than MTU, length: %ld", sendingBufferLength ) );
+                LogError( ( "The sending buffer is larger than MTU, length: %ld", bufferLength ) );
                 ret = ICE_CONTROLLER_RESULT_FAIL_EXCEED_MTU;
             }
             else
             {
-                memcpy( turnSendBuffer + ICE_TURN_CHANNEL_DATA_MESSAGE_HEADER_LENGTH,
-                        pBuffer,
-                        bufferLength );
+                if( pTurnSendBuffer + ICE_TURN_CHANNEL_DATA_MESSAGE_HEADER_LENGTH != pBuffer )
+                {
+                    memcpy( pTurnSendBuffer + ICE_TURN_CHANNEL_DATA_MESSAGE_HEADER_LENGTH,
+                            pBuffer,
+                            bufferLength );
+                }
 
                 if( pthread_mutex_lock( &( pCtx->iceMutex ) ) == 0 )
                 {
-                    turnBufferLength = ICE_CONTROLLER_MAX_MTU;
+                    turnBufferLength = turnSendBufferSize;
                     iceResult = Ice_CreateTurnChannelDataMessage( &pCtx->iceContext,
                                                                   pCtx->pNominatedSocketContext->pCandidatePair,
-                                                                  turnSendBuffer,
+                                                                  pTurnSendBuffer,
                                                                   bufferLength,
                                                                   &turnBufferLength );
                     pthread_mutex_unlock( &( pCtx->iceMutex ) );
@@ -1654,13 +1733,13 @@ IceControllerResult_t IceController_SendToRemotePeer( IceControllerContext_t * p
                     else
                     {
                         /* Redirect the output to the TURN server instead of remote endpoint. */
-                        pDestEndpoint = &( pCtx->pNominatedSocketContext->pIceServer->iceEndpoint );
+                        *ppDestEndpoint = &( pCtx->pNominatedSocketContext->pIceServer->iceEndpoint );
 
                         if( iceResult == ICE_RESULT_OK )
                         {
                             /* Set sending buffer/length to turn buffer since TURN channel header has been appended successfully. */
-                            pSendingBuffer = turnSendBuffer;
-                            sendingBufferLength = turnBufferLength;
+                            *ppSendingBuffer = pTurnSendBuffer;
+                            *pSendingBufferLength = turnBufferLength;
                         }
                     }
                 }
@@ -1673,6 +1752,38 @@ IceControllerResult_t IceController_SendToRemotePeer( IceControllerContext_t * p
         }
     }
 
+    return ret;
+}
+
+IceControllerResult_t IceController_SendToRemotePeer( IceControllerContext_t * pCtx,
+                                                      const uint8_t * pBuffer,
+                                                      size_t bufferLength )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    const uint8_t * pSendingBuffer = pBuffer;
+    size_t sendingBufferLength = bufferLength;
+    IceEndpoint_t * pDestEndpoint = NULL;
+    uint8_t turnSendBuffer[ ICE_CONTROLLER_MAX_MTU ];
+
+    if( ( pCtx == NULL ) ||
+        ( pBuffer == NULL ) )
+    {
+        LogError( ( "Invalid input, pCtx: %p, pBuffer: %p", pCtx, pBuffer ) );
+        ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        ret = PrepareSendingBuffer( pCtx,
+                                    pBuffer,
+                                    bufferLength,
+                                    turnSendBuffer,
+                                    sizeof( turnSendBuffer ),
+                                    &pSendingBuffer,
+                                    &sendingBufferLength,
+                                    &pDestEndpoint );
+    }
+
     if( ret == ICE_CONTROLLER_RESULT_OK )
     {
         ret = IceControllerNet_SendPacket( pCtx,
@@ -1685,6 +1796,116 @@ IceControllerResult_t IceController_SendToRemotePeer( IceControllerContext_t * p
     return ret;
 }
 
+IceControllerResult_t IceController_AddToSendBatch( IceControllerContext_t * pCtx,
+                                                    IceControllerSendBatch_t * pBatch,
+                                                    uint8_t * pBuffer,
+                                                    size_t bufferLength,
+                                                    uint64_t departureTimeUs )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    const uint8_t * pSendingBuffer = NULL;
+    size_t sendingBufferLength = 0;
+    IceEndpoint_t * pDestEndpoint = NULL;
+
+    if( ( pCtx == NULL ) ||
+        ( pBatch == NULL ) ||
+        ( pBuffer == NULL ) )
+    {
+        LogError( ( "Invalid input, pCtx: %p, pBatch: %p, pBuffer: %p", pCtx, pBatch, pBuffer ) );
+        ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
+    }
+    else if( bufferLength > ICE_CONTROLLER_MAX_MTU )
+    {
+        LogError( ( "The sending buffer is larger than MTU, length: %ld", bufferLength ) );
+        ret = ICE_CONTROLLER_RESULT_FAIL_EXCEED_MTU;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( ( ret == ICE_CONTROLLER_RESULT_OK ) &&
+        ( pBatch->packetNum > 0 ) &&
+        ( ( pBatch->packetNum >= ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ) ||
+          ( pBatch->pSocketContext != pCtx->pNominatedSocketContext ) ) )
+    {
+        /* The batch is full or the nominated socket has changed, send the queued packets first. */
+        ret = IceController_FlushSendBatch( pCtx,
+                                            pBatch );
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        /* Frame the TURN channel data in the headroom of the packet, no copy is needed. */
+        ret = PrepareSendingBuffer( pCtx,
+                                    pBuffer,
+                                    bufferLength,
+                                    pBuffer - ICE_CONTROLLER_PACKET_HEADROOM,
+                                    ICE_CONTROLLER_PACKET_HEADROOM + bufferLength + ICE_CONTROLLER_PACKET_TAILROOM,
+                                    &pSendingBuffer,
+                                    &sendingBufferLength,
+                                    &pDestEndpoint );
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        /* The sending buffer is either pBuffer or its headroom. */
+        pBatch->pPackets[ pBatch->packetNum ] = ( uint8_t * ) pSendingBuffer;
+        pBatch->packetsLength[ pBatch->packetNum ] = sendingBufferLength;
+        pBatch->packetsDepartureTimeUs[ pBatch->packetNum ] = departureTimeUs;
+        pBatch->pSocketContext = pCtx->pNominatedSocketContext;
+        pBatch->pDestEndpoint = pDestEndpoint;
+        pBatch->packetNum++;
+    }
+
+    return ret;
+}
+
+IceControllerResult_t IceController_FlushSendBatch( IceControllerContext_t * pCtx,
+                                                    IceControllerSendBatch_t * pBatch )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+
+    if( ( pCtx == NULL ) ||
+        ( pBatch == NULL ) )
+    {
+        LogError( ( "Invalid input, pCtx: %p, pBatch: %p", pCtx, pBatch ) );
+        ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
+    }
+
+    if( ( ret == ICE_CONTROLLER_RESULT_OK ) &&
+        ( pBatch->packetNum > 0 ) )
+    {
+        ret = IceControllerNet_SendPacketBatch( pCtx,
+                                                pBatch );
+
+        /* The batch is emptied no matter the result, the packets are dropped on failure. */
+        pBatch->packetNum = 0;
+        pBatch->pSocketContext = NULL;
+        pBatch->pDestEndpoint = NULL;
+    }
+
+    return ret;
+}
+
+uint8_t IceController_IsTxTimeEnabled( IceControllerContext_t * pCtx )
+{
+    uint8_t isTxTimeEnabled = 0U;
+    IceControllerSocketContext_t * pSocketContext;
+
+    if( pCtx != NULL )
+    {
+        /* Take a snapshot, the nominated socket might be changed by the ICE task. */
+        pSocketContext = pCtx->pNominatedSocketContext;
+        if( pSocketContext != NULL )
+        {
+            isTxTimeEnabled = pSocketContext->isTxTimeEnabled;
+        }
+    }
+
+    return isTxTimeEnabled;
+}
+
 IceControllerResult_t IceController_AddIceServerConfig( IceControllerContext_t * pCtx,
                                                         IceControllerIceServerConfig_t * pIceServersConfig )
 {
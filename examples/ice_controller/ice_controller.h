@@ -31,6 +31,8 @@ extern "C" {
 IceControllerResult_t IceController_Init( IceControllerContext_t * pCtx,
                                           IceControllerInitConfig_t * pInitConfig );
 IceControllerResult_t IceController_Destroy( IceControllerContext_t * pCtx );
+/* Release the mutexes and the timer of IceController_Init(), no socket may be open. */
+void IceController_Deinit( IceControllerContext_t * pCtx );
 IceControllerResult_t IceController_AddressClosing( IceControllerContext_t * pCtx );
 IceControllerResult_t IceController_DeserializeIceCandidate( const char * pDecodeMessage,
                                                              size_t decodeMessageLength,
@@ -43,11 +45,29 @@ IceControllerResult_t IceController_ProcessIceCandidatesAndPairs( IceControllerC
 IceControllerResult_t IceController_SendToRemotePeer( IceControllerContext_t * pCtx,
                                                       const uint8_t * pBuffer,
                                                       size_t bufferLength );
+/* Queue the packet into the batch, the batch is sent automatically if it's full.
+ * Call IceController_FlushSendBatch() to send the remaining packets.
+ * The packet isn't copied, it must have ICE_CONTROLLER_PACKET_HEADROOM bytes in front of pBuffer and
+ * ICE_CONTROLLER_PACKET_TAILROOM bytes after it writable, and be kept till the batch is flushed.
+ * The departure time is on monotonic clock in microseconds, it only takes effect if IceController_IsTxTimeEnabled()
+ * returns 1. Pass 0 to send the packet right away. */
+IceControllerResult_t IceController_AddToSendBatch( IceControllerContext_t * pCtx,
+                                                    IceControllerSendBatch_t * pBatch,
+                                                    uint8_t * pBuffer,
+                                                    size_t bufferLength,
+                                                    uint64_t departureTimeUs );
+IceControllerResult_t IceController_FlushSendBatch( IceControllerContext_t * pCtx,
+                                                    IceControllerSendBatch_t * pBatch );
+/* Return 1 if the nominated socket lets the kernel hold packets until their departure time. */
+uint8_t IceController_IsTxTimeEnabled( IceControllerContext_t * pCtx );
 IceControllerResult_t IceController_AddIceServerConfig( IceControllerContext_t * pCtx,
                                                         IceControllerIceServerConfig_t * pIceServersConfig );
 IceControllerResult_t IceController_PeriodConnectionCheck( IceControllerContext_t * pCtx );
 void IceController_HandleEvent( IceControllerContext_t * pCtx,
                                 IceControllerEvent_t event );
+/* Receive and handle the packets of the sockets reported by ICE_CONTROLLER_CB_EVENT_SOCKET_READY.
+ * It must be called by one thread, which is also the thread running the callbacks of the packets. */
+void IceController_HandleSocketEvents( IceControllerContext_t * pCtx );
 
 /* *INDENT-OFF* */
 #ifdef __cplusplus
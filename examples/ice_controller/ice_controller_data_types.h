@@ -27,6 +27,7 @@ extern "C" {
 
 /* Standard includes. */
 #include <stdint.h>
+#include <stdatomic.h>
 #include "demo_config.h"
 #include "ice_data_types.h"
 #include "timer_controller.h"
@@ -82,6 +83,34 @@ extern "C" {
 
 #define ICE_CONTROLLER_MAX_MTU ( 1500 )
 
+/* Packets queued by IceController_AddToSendBatch() keep this many bytes free in front of them,
+ * the TURN channel data header is written there in place. It must match ICE_TURN_CHANNEL_DATA_MESSAGE_HEADER_LENGTH,
+ * ice_controller.c checks it at build time. */
+#define ICE_CONTROLLER_PACKET_HEADROOM ( 4 )
+/* And this many bytes free after them for the TURN channel data padding to 4 bytes. */
+#define ICE_CONTROLLER_PACKET_TAILROOM ( 3 )
+
+/* Maximum number of packets sent by one sendmmsg() call. */
+#define ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ( 32 )
+#define ICE_CONTROLLER_SOCKET_RX_BATCH_MAX_PACKET_NUM ( 16 )
+#define ICE_CONTROLLER_SOCKET_RX_BUFFER_SIZE ( 4096 )
+
+/* Number of socket reactor threads shared by all ICE controllers. All sockets of an ICE controller are
+ * registered into the same reactor, the controllers are spread over the reactors in turn. */
+#ifndef ICE_CONTROLLER_SOCKET_REACTOR_THREAD_NUM
+#define ICE_CONTROLLER_SOCKET_REACTOR_THREAD_NUM ( 2 )
+#endif
+
+/* The warm pool keeps this many bound UDP sockets ready on each local interface, a session takes one for
+ * the host candidate and one for each STUN server. */
+#define ICE_CONTROLLER_WARM_POOL_SOCKET_NUM_PER_ENDPOINT ( 4 )
+#define ICE_CONTROLLER_WARM_POOL_MAX_SOCKET_NUM ( 32 )
+#define ICE_CONTROLLER_WARM_POOL_DNS_CACHE_SIZE ( 32 )
+/* The interfaces and the cached DNS results are refreshed in the background at this interval. */
+#define ICE_CONTROLLER_WARM_POOL_REFRESH_INTERVAL_MS ( 30000 )
+/* A DNS result is used till this long after it's resolved, and dropped if no session looks it up for this long. */
+#define ICE_CONTROLLER_WARM_POOL_DNS_CACHE_TTL_MS ( 300000 )
+
 typedef enum IceControllerSocketType
 {
     ICE_CONTROLLER_SOCKET_TYPE_NONE = 0,
@@ -101,6 +130,7 @@ typedef enum IceControllerCallbackEvent
     ICE_CONTROLLER_CB_EVENT_ICE_CLOSING,
     ICE_CONTROLLER_CB_EVENT_ICE_CLOSED,
     ICE_CONTROLLER_CB_EVENT_ICE_CLOSE_NOTIFY,
+    ICE_CONTROLLER_CB_EVENT_SOCKET_READY,
     ICE_CONTROLLER_CB_EVENT_MAX,
 } IceControllerCallbackEvent_t;
 
@@ -118,6 +148,7 @@ typedef struct IceControllerCallbackContent
         /* NULL for ICE_CONTROLLER_CB_EVENT_PROCESS_ICE_CANDIDATES_AND_PAIRS */
         /* NULL for ICE_CONTROLLER_CB_EVENT_PEER_TO_PEER_CONNECTION_FOUND */
         /* NULL for ICE_CONTROLLER_CB_EVENT_PERIODIC_CONNECTION_CHECK */
+        /* NULL for ICE_CONTROLLER_CB_EVENT_SOCKET_READY */
     } iceControllerCallbackContent;
 } IceControllerCallbackContent_t;
 
@@ -180,6 +211,8 @@ typedef enum IceControllerResult
     ICE_CONTROLLER_RESULT_FAIL_EXCEED_MTU,
     ICE_CONTROLLER_RESULT_FAIL_CREATE_NEXT_PAIR_REQUEST,
     ICE_CONTROLLER_RESULT_NO_SOCKET_CONTEXT_AVAILABLE,
+    ICE_CONTROLLER_RESULT_FAIL_CREATE_SOCKET_REACTOR,
+    ICE_CONTROLLER_RESULT_FAIL_ADD_SOCKET_TO_REACTOR,
     ICE_CONTROLLER_RESULT_JSON_CANDIDATE_NOT_FOUND,
     ICE_CONTROLLER_RESULT_JSON_CANDIDATE_INVALID_PRIORITY,
     ICE_CONTROLLER_RESULT_JSON_CANDIDATE_INVALID_PROTOCOL,
@@ -268,8 +301,39 @@ typedef struct IceControllerSocketContext
     IceControllerIceServer_t * pIceServer;
     IceCandidatePair_t * pCandidatePair;
     int socketFd;
+
+    /* The ICE controller owning this socket, used by the shared socket reactor to dispatch events. */
+    struct IceControllerContext * pIceControllerContext;
+
+    /* Set if the kernel accepts UDP_SEGMENT on this socket, cleared if a GSO send is rejected. */
+    uint8_t isUdpGsoSupported;
+
+    /* Set if SO_TXTIME is enabled, packets can carry a departure time for the fq qdisc. */
+    uint8_t isTxTimeEnabled;
+
+    /* Set by the socket reactor when the socket is readable, cleared by IceController_HandleSocketEvents(). */
+    atomic_uint_fast8_t isEventPending;
+
+    /* Set under socketMutex while a thread is receiving on the socket, the socket is only closed after that. */
+    uint8_t isHandling;
+    pthread_t handlingTid;
 } IceControllerSocketContext_t;
 
+/* Packets queued to be sent to remote peer at once.
+ * The batch only refers to the caller's buffers, TURN channel data header is added in their headroom at queuing time if required. */
+typedef struct IceControllerSendBatch
+{
+    uint8_t * pPackets[ ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ];
+    size_t packetsLength[ ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ];
+    /* Departure time on monotonic clock in microseconds, 0 means sending right away. */
+    uint64_t packetsDepartureTimeUs[ ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ];
+    size_t packetNum;
+
+    /* All packets in a batch go through the same socket to the same destination. */
+    IceControllerSocketContext_t * pSocketContext;
+    IceEndpoint_t * pDestEndpoint;
+} IceControllerSendBatch_t;
+
 typedef struct IceControllerIceServerConfig
 {
     IceControllerIceServer_t * pIceServers;
@@ -289,13 +353,70 @@ typedef struct IceControllerStunMsgHeader
     uint8_t pStunAttributes[0];
 } IceControllerStunMsgHeader_t;
 
+/* Epoll reactor shared by a share of the ICE controllers, so the thread count doesn't grow with the number of viewers.
+ * The reactor only reports readable sockets to their ICE controller, the packets are received and handled
+ * by the thread calling IceController_HandleSocketEvents(). */
+typedef struct IceControllerSocketReactor
+{
+    int epollFd;
+    pthread_t reactorTid;
+} IceControllerSocketReactor_t;
+
 typedef struct IceControllerSocketListenerContext
 {
     volatile uint8_t executeSocketListener;
     OnRecvNonStunPacketCallback_t onRecvNonStunPacketFunc;
     void * pOnRecvNonStunPacketCallbackContext;
+
+    /* The reactor all sockets of this ICE controller are registered into. */
+    IceControllerSocketReactor_t * pReactor;
+
+    /* Set once ICE_CONTROLLER_CB_EVENT_SOCKET_READY is reported, until the pending events are handled. */
+    atomic_uint_fast8_t isEventReported;
+
+    /* Receive buffers for recvmmsg(), only accessed by the thread handling the socket events. */
+    uint8_t rxBuffers[ ICE_CONTROLLER_SOCKET_RX_BATCH_MAX_PACKET_NUM ][ ICE_CONTROLLER_SOCKET_RX_BUFFER_SIZE ];
+    size_t rxLengths[ ICE_CONTROLLER_SOCKET_RX_BATCH_MAX_PACKET_NUM ];
+    struct sockaddr_storage rxSrcAddresses[ ICE_CONTROLLER_SOCKET_RX_BATCH_MAX_PACKET_NUM ];
 } IceControllerSocketListenerContext_t;
 
+typedef struct IceControllerWarmSocket
+{
+    int socketFd;
+    /* The local IP address and the bound port. */
+    IceEndpoint_t localEndpoint;
+    uint8_t isUdpGsoSupported;
+    uint8_t isTxTimeEnabled;
+} IceControllerWarmSocket_t;
+
+typedef struct IceControllerWarmDnsEntry
+{
+    char url[ ICE_CONTROLLER_ICE_SERVER_URL_MAX_LENGTH ];
+    IceTransportAddress_t transportAddress;     /* Only the family and the address, the port comes with each ICE server. */
+    uint64_t expireTimeMs;
+    uint64_t lastUsedTimeMs;
+} IceControllerWarmDnsEntry_t;
+
+/* Process-wide pool of what candidate gathering needs before talking to the ICE servers, kept ready by a background task:
+ * the local interface addresses, bound host sockets, and the DNS results of the ICE servers. */
+typedef struct IceControllerWarmPool
+{
+    pthread_mutex_t poolMutex;
+    /* Signaled when a socket is taken, so the refill task creates a new one. */
+    pthread_cond_t poolCond;
+    pthread_t refillTid;
+    uint8_t isRunning;
+
+    IceEndpoint_t localEndpoints[ ICE_CONTROLLER_MAX_LOCAL_CANDIDATE_COUNT ];
+    size_t localEndpointsCount;
+
+    IceControllerWarmSocket_t sockets[ ICE_CONTROLLER_WARM_POOL_MAX_SOCKET_NUM ];
+    size_t socketsCount;
+
+    IceControllerWarmDnsEntry_t dnsEntries[ ICE_CONTROLLER_WARM_POOL_DNS_CACHE_SIZE ];
+    size_t dnsEntriesCount;
+} IceControllerWarmPool_t;
+
 typedef enum IceControllerState
 {
     ICE_CONTROLLER_STATE_NONE = 0,
@@ -386,6 +507,8 @@ typedef struct IceControllerContext
 
     /* Mutex to protect global variables shared between Ice controller and socket listener. */
     pthread_mutex_t socketMutex;
+    /* Signaled under socketMutex when a thread stops receiving on a socket. */
+    pthread_cond_t socketCond;
     /* Mutex to ice context while invoking APIs of ICE library. */
     pthread_mutex_t iceMutex;
 
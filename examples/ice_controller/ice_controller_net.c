@@ -14,10 +14,15 @@
  * limitations under the License.
  */
 
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE /* For sendmmsg(). */
+#endif
 #include <errno.h>
 #include <time.h>
 #include <sys/socket.h>
 #include <arpa/inet.h>
+#include <netinet/udp.h>
+#include <linux/net_tstamp.h>
 #include <net/if.h>
 #include <ifaddrs.h>
 #include <netdb.h>
@@ -55,9 +60,28 @@
 
 #define ICE_CONTROLLER_RESEND_DELAY_MS ( 50 )
 #define ICE_CONTROLLER_RESEND_TIMEOUT_MS ( 1000 )
+/* Batch sending backs off from the initial delay and doubles it up to ICE_CONTROLLER_RESEND_DELAY_MS. */
+#define ICE_CONTROLLER_BATCH_RESEND_INITIAL_DELAY_MS ( 1 )
+
+/* UDP GSO is available since Linux 4.18, define the option in case the libc headers are older. */
+#ifndef SOL_UDP
+    #define SOL_UDP ( 17 )
+#endif
+#ifndef UDP_SEGMENT
+    #define UDP_SEGMENT ( 103 )
+#endif
 
-static void GetLocalIPAdresses( IceEndpoint_t * pLocalIpAddresses,
-                                size_t * pLocalIpAddressesNum )
+/* SO_TXTIME is available since Linux 4.19. */
+#ifndef SO_TXTIME
+    #define SO_TXTIME ( 61 )
+#endif
+#ifndef SCM_TXTIME
+    #define SCM_TXTIME SO_TXTIME
+#endif
+#define ICE_CONTROLLER_NS_PER_US ( 1000ULL )
+
+void IceControllerNet_GetLocalIpAddresses( IceEndpoint_t * pLocalIpAddresses,
+                                          size_t * pLocalIpAddressesNum )
 {
     struct ifaddrs * pIfAddrs, * pIfAddr;
     struct sockaddr_in * pIpv4Addr = NULL;
@@ -135,15 +159,14 @@ void IceControllerNet_UpdateSocketContext( IceControllerContext_t * pCtx,
     }
 }
 
-static IceControllerResult_t CreateSocketContextUdp( IceControllerContext_t * pCtx,
-                                                     uint16_t family,
+IceControllerResult_t IceControllerNet_OpenUdpSocket( uint16_t family,
                                                      IceEndpoint_t * pBindEndpoint,
-                                                     IceEndpoint_t * pConnectEndpoint,
-                                                     IceSocketProtocol_t protocol,
-                                                     IceControllerSocketContext_t ** ppOutSocketContext )
+                                                     int * pSocketFd,
+                                                     uint8_t * pIsUdpGsoSupported,
+                                                     uint8_t * pIsTxTimeEnabled )
 {
     IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
-    IceControllerSocketContext_t * pSocketContext = NULL;
+    int socketFd = -1;
     struct sockaddr_in ipv4Address;
     // struct sockaddr_in6 ipv6Addr;
     struct sockaddr * pSockAddress = NULL;
@@ -153,26 +176,26 @@ static IceControllerResult_t CreateSocketContextUdp( IceControllerContext_t * pC
         .tv_usec = 1000
     };
     uint32_t sendBufferSize = 0;
+    int gsoSegmentSize = 0;
+    socklen_t gsoSegmentSizeLength;
+    #if ENABLE_KERNEL_PACING
+        struct sock_txtime txTimeConfig;
+    #endif /* ENABLE_KERNEL_PACING */
     uint8_t needBinding = pBindEndpoint != NULL ? 1 : 0;
 
-    /* Find a free socket context. */
-    if( pCtx->socketsContextsCount < ICE_CONTROLLER_MAX_LOCAL_CANDIDATE_COUNT )
+    if( ( pSocketFd == NULL ) || ( pIsUdpGsoSupported == NULL ) || ( pIsTxTimeEnabled == NULL ) )
     {
-        pSocketContext = &pCtx->socketsContexts[ pCtx->socketsContextsCount++ ];
-    }
-    else
-    {
-        LogWarn( ( "No socket context available for ice controller. Current number: %lu", pCtx->socketsContextsCount ) );
-        ret = ICE_CONTROLLER_RESULT_NO_SOCKET_CONTEXT_AVAILABLE;
+        LogError( ( "Invalid input, pSocketFd: %p, pIsUdpGsoSupported: %p, pIsTxTimeEnabled: %p", pSocketFd, pIsUdpGsoSupported, pIsTxTimeEnabled ) );
+        ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
     }
 
     if( ret == ICE_CONTROLLER_RESULT_OK )
     {
-        pSocketContext->socketFd = socket( family == STUN_ADDRESS_IPv4 ? AF_INET : AF_INET6,
-                                           SOCK_DGRAM,
-                                           0 );
+        socketFd = socket( family == STUN_ADDRESS_IPv4 ? AF_INET : AF_INET6,
+                           SOCK_DGRAM,
+                           0 );
 
-        if( pSocketContext->socketFd == -1 )
+        if( socketFd == -1 )
         {
             LogError( ( "socket() failed to create socket with errno: %s", strerror( errno ) ) );
             ret = ICE_CONTROLLER_RESULT_FAIL_SOCKET_CREATE;
@@ -200,33 +223,24 @@ static IceControllerResult_t CreateSocketContextUdp( IceControllerContext_t * pC
             // pSockAddress = (struct sockaddr*) &ipv6Addr;
             // addressLength = sizeof(struct sockaddr_in6);
             ret = ICE_CONTROLLER_RESULT_IPV6_NOT_SUPPORT;
-            close( pSocketContext->socketFd );
-            pSocketContext->socketFd = -1;
-            pCtx->socketsContextsCount--;
         }
     }
 
     if( ( ret == ICE_CONTROLLER_RESULT_OK ) && needBinding )
     {
-        if( bind( pSocketContext->socketFd, pSockAddress, addressLength ) < 0 )
+        if( bind( socketFd, pSockAddress, addressLength ) < 0 )
         {
             LogError( ( "socket() failed to bind socket with errno: %s", strerror( errno ) ) );
             ret = ICE_CONTROLLER_RESULT_FAIL_SOCKET_BIND;
-            close( pSocketContext->socketFd );
-            pSocketContext->socketFd = -1;
-            pCtx->socketsContextsCount--;
         }
     }
 
     if( ( ret == ICE_CONTROLLER_RESULT_OK ) && needBinding )
     {
-        if( getsockname( pSocketContext->socketFd, pSockAddress, &addressLength ) < 0 )
+        if( getsockname( socketFd, pSockAddress, &addressLength ) < 0 )
         {
             LogError( ( "getsockname() failed with errno: %s", strerror( errno ) ) );
             ret = ICE_CONTROLLER_RESULT_FAIL_SOCKET_GETSOCKNAME;
-            close( pSocketContext->socketFd );
-            pSocketContext->socketFd = -1;
-            pCtx->socketsContextsCount--;
         }
         else
         {
@@ -236,9 +250,100 @@ static IceControllerResult_t CreateSocketContextUdp( IceControllerContext_t * pC
 
     if( ret == ICE_CONTROLLER_RESULT_OK )
     {
-        setsockopt( pSocketContext->socketFd, SOL_SOCKET, SO_SNDBUF, &sendBufferSize, sizeof( sendBufferSize ) );
-        setsockopt( pSocketContext->socketFd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof( struct timeval ) );
-        setsockopt( pSocketContext->socketFd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof( struct timeval ) );
+        setsockopt( socketFd, SOL_SOCKET, SO_SNDBUF, &sendBufferSize, sizeof( sendBufferSize ) );
+        setsockopt( socketFd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof( struct timeval ) );
+        setsockopt( socketFd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof( struct timeval ) );
+
+        /* Probe UDP GSO support, kernels older than 4.18 reject the option. */
+        gsoSegmentSizeLength = sizeof( gsoSegmentSize );
+        if( getsockopt( socketFd, SOL_UDP, UDP_SEGMENT, &gsoSegmentSize, &gsoSegmentSizeLength ) == 0 )
+        {
+            *pIsUdpGsoSupported = 1U;
+        }
+        else
+        {
+            LogDebug( ( "UDP GSO is not supported on this kernel, errno(%d): %s", errno, strerror( errno ) ) );
+            *pIsUdpGsoSupported = 0U;
+        }
+
+        #if ENABLE_KERNEL_PACING
+            /* The fq qdisc compares the departure time with monotonic clock. */
+            memset( &txTimeConfig, 0, sizeof( struct sock_txtime ) );
+            txTimeConfig.clockid = CLOCK_MONOTONIC;
+            txTimeConfig.flags = 0;
+            if( setsockopt( socketFd, SOL_SOCKET, SO_TXTIME, &txTimeConfig, sizeof( struct sock_txtime ) ) == 0 )
+            {
+                *pIsTxTimeEnabled = 1U;
+            }
+            else
+            {
+                LogInfo( ( "SO_TXTIME is not supported on this kernel, errno(%d): %s", errno, strerror( errno ) ) );
+                *pIsTxTimeEnabled = 0U;
+            }
+        #else
+            *pIsTxTimeEnabled = 0U;
+        #endif /* ENABLE_KERNEL_PACING */
+
+        *pSocketFd = socketFd;
+    }
+    else if( socketFd != -1 )
+    {
+        close( socketFd );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return ret;
+}
+
+static IceControllerResult_t CreateSocketContextUdp( IceControllerContext_t * pCtx,
+                                                     uint16_t family,
+                                                     IceEndpoint_t * pBindEndpoint,
+                                                     IceEndpoint_t * pConnectEndpoint,
+                                                     IceSocketProtocol_t protocol,
+                                                     IceControllerSocketContext_t ** ppOutSocketContext )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    IceControllerSocketContext_t * pSocketContext = NULL;
+    IceControllerWarmSocket_t warmSocket;
+
+    /* Find a free socket context. */
+    if( pCtx->socketsContextsCount < ICE_CONTROLLER_MAX_LOCAL_CANDIDATE_COUNT )
+    {
+        pSocketContext = &pCtx->socketsContexts[ pCtx->socketsContextsCount++ ];
+    }
+    else
+    {
+        LogWarn( ( "No socket context available for ice controller. Current number: %lu", pCtx->socketsContextsCount ) );
+        ret = ICE_CONTROLLER_RESULT_NO_SOCKET_CONTEXT_AVAILABLE;
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        /* Take a socket already bound on this interface from the warm pool, or create one. */
+        if( ( pBindEndpoint != NULL ) &&
+            ( IceControllerWarmPool_TakeSocket( pBindEndpoint,
+                                                &warmSocket ) != 0U ) )
+        {
+            pSocketContext->socketFd = warmSocket.socketFd;
+            pSocketContext->isUdpGsoSupported = warmSocket.isUdpGsoSupported;
+            pSocketContext->isTxTimeEnabled = warmSocket.isTxTimeEnabled;
+        }
+        else
+        {
+            ret = IceControllerNet_OpenUdpSocket( family,
+                                                  pBindEndpoint,
+                                                  &pSocketContext->socketFd,
+                                                  &pSocketContext->isUdpGsoSupported,
+                                                  &pSocketContext->isTxTimeEnabled );
+            if( ret != ICE_CONTROLLER_RESULT_OK )
+            {
+                pSocketContext->socketFd = -1;
+                pCtx->socketsContextsCount--;
+            }
+        }
     }
 
     if( ret == ICE_CONTROLLER_RESULT_OK )
@@ -357,6 +462,8 @@ static IceControllerResult_t CreateSocketContextTcp( IceControllerContext_t * pC
         setsockopt( pSocketContext->socketFd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof( struct timeval ) );
 
         pSocketContext->socketType = ICE_CONTROLLER_SOCKET_TYPE_TLS;
+        pSocketContext->isUdpGsoSupported = 0U;
+        pSocketContext->isTxTimeEnabled = 0U;
         *ppOutSocketContext = pSocketContext;
     }
 
@@ -419,6 +526,24 @@ static IceControllerResult_t CreateSocketContext( IceControllerContext_t * pCtx,
         }
     }
 
+    if( ( ret == ICE_CONTROLLER_RESULT_OK ) ||
+        ( ret == ICE_CONTROLLER_RESULT_CONNECTION_IN_PROGRESS ) )
+    {
+        /* Register the socket into the shared reactor for receiving. */
+        if( IceControllerSocketListener_AddSocket( pCtx,
+                                                   *ppOutSocketContext ) != ICE_CONTROLLER_RESULT_OK )
+        {
+            if( ( *ppOutSocketContext )->socketType == ICE_CONTROLLER_SOCKET_TYPE_TLS )
+            {
+                ( void ) TLS_FreeRTOS_Disconnect( &( *ppOutSocketContext )->tlsSession.xTlsNetworkContext );
+            }
+            close( ( *ppOutSocketContext )->socketFd );
+            ( *ppOutSocketContext )->socketFd = -1;
+            pCtx->socketsContextsCount--;
+            ret = ICE_CONTROLLER_RESULT_FAIL_ADD_SOCKET_TO_REACTOR;
+        }
+    }
+
     if( isLocked != 0 )
     {
         pthread_mutex_unlock( &( pCtx->socketMutex ) );
@@ -519,18 +644,33 @@ void IceControllerNet_FreeSocketContext( IceControllerContext_t * pCtx,
     {
         if( pthread_mutex_lock( &( pCtx->socketMutex ) ) == 0 )
         {
-            if( pSocketContext->socketType == ICE_CONTROLLER_SOCKET_TYPE_TLS )
+            /* Another thread might be receiving on this socket, wait until it's done before closing the socket.
+             * The receiving thread itself closes it right away, it stops receiving once the socket is closed. */
+            while( ( pSocketContext->isHandling != 0U ) &&
+                   ( pthread_equal( pSocketContext->handlingTid, pthread_self() ) == 0 ) )
+            {
+                ( void ) pthread_cond_wait( &( pCtx->socketCond ),
+                                            &( pCtx->socketMutex ) );
+            }
+
+            /* The socket might be closed while waiting. */
+            if( pSocketContext->socketFd != -1 )
             {
-                retTlsTransport = TLS_FreeRTOS_Disconnect( &pSocketContext->tlsSession.xTlsNetworkContext );
-                if( retTlsTransport != TLS_TRANSPORT_SUCCESS )
+                if( pSocketContext->socketType == ICE_CONTROLLER_SOCKET_TYPE_TLS )
                 {
-                    LogWarn( ( "Fail to disconnect TLS session with return %d", retTlsTransport ) );
+                    retTlsTransport = TLS_FreeRTOS_Disconnect( &pSocketContext->tlsSession.xTlsNetworkContext );
+                    if( retTlsTransport != TLS_TRANSPORT_SUCCESS )
+                    {
+                        LogWarn( ( "Fail to disconnect TLS session with return %d", retTlsTransport ) );
+                    }
                 }
-            }
 
-            close( pSocketContext->socketFd );
-            pSocketContext->socketFd = -1;
-            pSocketContext->state = ICE_CONTROLLER_SOCKET_CONTEXT_STATE_NONE;
+                IceControllerSocketListener_RemoveSocket( pCtx,
+                                                          pSocketContext );
+                close( pSocketContext->socketFd );
+                pSocketContext->socketFd = -1;
+                pSocketContext->state = ICE_CONTROLLER_SOCKET_CONTEXT_STATE_NONE;
+            }
 
             pthread_mutex_unlock( &( pCtx->socketMutex ) );
         }
@@ -636,8 +776,8 @@ static void AddSrflxCandidate( IceControllerContext_t * pCtx,
             continue;
         }
 
-        dnsResult = IceControllerNet_DnsLookUp( pCtx->iceServers[ i ].url,
-                                                &pCtx->iceServers[ i ].iceEndpoint.transportAddress );
+        dnsResult = IceControllerWarmPool_DnsLookUp( pCtx->iceServers[ i ].url,
+                                                     &pCtx->iceServers[ i ].iceEndpoint.transportAddress );
         if( dnsResult != ICE_CONTROLLER_RESULT_OK )
         {
             LogWarn( ( "Fail to get the DNS result of STUN server: %.*s",
@@ -774,8 +914,8 @@ static void AddRelayCandidates( IceControllerContext_t * pCtx )
                            pCtx->iceServers[i].protocol == ICE_SOCKET_PROTOCOL_UDP ? "UDP" : "TLS" ) );
             }
 
-            dnsResult = IceControllerNet_DnsLookUp( pCtx->iceServers[ i ].url,
-                                                    &pCtx->iceServers[ i ].iceEndpoint.transportAddress );
+            dnsResult = IceControllerWarmPool_DnsLookUp( pCtx->iceServers[ i ].url,
+                                                         &pCtx->iceServers[ i ].iceEndpoint.transportAddress );
             if( dnsResult != ICE_CONTROLLER_RESULT_OK )
             {
                 LogWarn( ( "Fail to get the DNS result of STUN server: %.*s",
@@ -1080,37 +1220,49 @@ IceControllerResult_t IceControllerNet_Htons( uint16_t port,
     return ICE_CONTROLLER_RESULT_OK;
 }
 
-IceControllerResult_t IceControllerNet_SendPacket( IceControllerContext_t * pCtx,
+static void SetDestinationAddress( const IceEndpoint_t * pRemoteEndpoint,
+                                   struct sockaddr_in * pIpv4Address,
+                                   struct sockaddr_in6 * pIpv6Address,
+                                   struct sockaddr ** ppDestinationAddress,
+                                   socklen_t * pAddressLength )
+{
+    if( pRemoteEndpoint->transportAddress.family == STUN_ADDRESS_IPv4 )
+    {
+        memset( pIpv4Address, 0, sizeof( struct sockaddr_in ) );
+        pIpv4Address->sin_family = AF_INET;
+        pIpv4Address->sin_port = htons( pRemoteEndpoint->transportAddress.port );
+        memcpy( &pIpv4Address->sin_addr, pRemoteEndpoint->transportAddress.address, STUN_IPV4_ADDRESS_SIZE );
+
+        *ppDestinationAddress = ( struct sockaddr * ) pIpv4Address;
+        *pAddressLength = sizeof( struct sockaddr_in );
+    }
+    else
+    {
+        memset( pIpv6Address, 0, sizeof( struct sockaddr_in6 ) );
+        pIpv6Address->sin6_family = AF_INET6;
+        pIpv6Address->sin6_port = htons( pRemoteEndpoint->transportAddress.port );
+        memcpy( &pIpv6Address->sin6_addr, pRemoteEndpoint->transportAddress.address, STUN_IPV6_ADDRESS_SIZE );
+
+        *ppDestinationAddress = ( struct sockaddr * ) pIpv6Address;
+        *pAddressLength = sizeof( struct sockaddr_in6 );
+    }
+}
+
+static IceControllerResult_t LockSocketForSending( IceControllerContext_t * pCtx,
                                                    IceControllerSocketContext_t * pSocketContext,
                                                    IceEndpoint_t * pRemoteEndpoint,
-                                                   const uint8_t * pBuffer,
-                                                   size_t bufferLength )
+                                                   uint8_t * pIsLocked )
 {
     IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
-    struct sockaddr * pDestinationAddress = NULL;
-    struct sockaddr_in ipv4Address;
-    struct sockaddr_in6 ipv6Address;
-    socklen_t addressLength = 0;
-    uint8_t isLocked = 0;
 
-    if( ( pCtx == NULL ) || ( pSocketContext == NULL ) || ( pRemoteEndpoint == NULL ) || ( pBuffer == NULL ) )
+    if( pthread_mutex_lock( &( pCtx->socketMutex ) ) == 0 )
     {
-        LogError( ( "Invalid input, pCtx: %p, pSocketContext: %p, pRemoteEndpoint: %p, pBuffer: %p",
-                    pCtx, pSocketContext, pRemoteEndpoint, pBuffer ) );
-        ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
+        *pIsLocked = 1;
     }
-
-    if( ret == ICE_CONTROLLER_RESULT_OK )
+    else
     {
-        if( pthread_mutex_lock( &( pCtx->socketMutex ) ) == 0 )
-        {
-            isLocked = 1;
-        }
-        else
-        {
-            LogError( ( "Failed to lock socket mutex." ) );
-            ret = ICE_CONTROLLER_RESULT_FAIL_MUTEX_TAKE;
-        }
+        LogError( ( "Failed to lock socket mutex." ) );
+        ret = ICE_CONTROLLER_RESULT_FAIL_MUTEX_TAKE;
     }
 
     if( ret == ICE_CONTROLLER_RESULT_OK )
@@ -1135,28 +1287,373 @@ IceControllerResult_t IceControllerNet_SendPacket( IceControllerContext_t * pCtx
         }
     }
 
-    if( ret == ICE_CONTROLLER_RESULT_OK )
+    return ret;
+}
+
+static void HandleSendFailure( IceControllerContext_t * pCtx,
+                               IceControllerSocketContext_t * pSocketContext )
+{
+    /*
+     * Socket read error detected.
+     * This typically indicates the remote peer closed the connection or WiFi disconnection.
+     * Action required: Close the local socket to properly terminate the connection.
+     */
+    ( void ) Ice_CloseCandidate( &pCtx->iceContext, pSocketContext->pLocalCandidate );
+    IceControllerNet_FreeSocketContext( pCtx, pSocketContext );
+
+    if( pSocketContext == pCtx->pNominatedSocketContext )
     {
-        if( pRemoteEndpoint->transportAddress.family == STUN_ADDRESS_IPv4 )
+        /* Disconnecting nominated socket connection, closing. */
+        LogWarn( ( "Unable to send packet through nominated socket, closing session: %.*s",
+                   ( int ) pCtx->iceContext.creds.combinedUsernameLength,
+                   pCtx->iceContext.creds.pCombinedUsername ) );
+
+        /* Notify peer connection for closing the connection. */
+        if( pCtx->onIceEventCallbackFunc )
         {
-            memset( &ipv4Address, 0, sizeof( ipv4Address ) );
-            ipv4Address.sin_family = AF_INET;
-            ipv4Address.sin_port = htons( pRemoteEndpoint->transportAddress.port );
-            memcpy( &ipv4Address.sin_addr, pRemoteEndpoint->transportAddress.address, STUN_IPV4_ADDRESS_SIZE );
+            pCtx->onIceEventCallbackFunc( pCtx->pOnIceEventCustomContext,
+                                          ICE_CONTROLLER_CB_EVENT_ICE_CLOSE_NOTIFY,
+                                          NULL );
+
+            /* Re-set the timer. */
+            IceController_UpdateTimerInterval( pCtx,
+                                               ICE_CONTROLLER_CLOSING_INTERVAL_MS );
+        }
+        else
+        {
+            LogError( ( "There is no ICE event callback function set." ) );
+        }
+    }
+}
+
+/* Return 1 if the caller should retry after the back off, or 0 if it's already timeout. */
+static uint8_t BackoffSendingBatch( uint32_t * pDelayMs,
+                                    uint32_t * pTotalDelayMs )
+{
+    uint8_t shouldRetry = 1U;
+
+    usleep( *pDelayMs * 1000 );
+    *pTotalDelayMs += *pDelayMs;
+    *pDelayMs = ( *pDelayMs * 2 < ICE_CONTROLLER_RESEND_DELAY_MS ) ? *pDelayMs * 2 : ICE_CONTROLLER_RESEND_DELAY_MS;
+
+    if( ICE_CONTROLLER_RESEND_TIMEOUT_MS <= *pTotalDelayMs )
+    {
+        shouldRetry = 0U;
+    }
+
+    return shouldRetry;
+}
+
+static IceControllerResult_t SendSocketPacketMmsg( IceControllerSocketContext_t * pSocketContext,
+                                                   IceControllerSendBatch_t * pBatch,
+                                                   size_t startIndex,
+                                                   size_t packetNum,
+                                                   struct sockaddr * pDestinationAddress,
+                                                   socklen_t addressLength )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    struct mmsghdr messages[ ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ];
+    struct iovec iovecs[ ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ];
+    char controlBuffers[ ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ][ CMSG_SPACE( sizeof( uint64_t ) ) ];
+    struct cmsghdr * pControlMessage;
+    uint64_t departureTimeNs;
+    size_t sentNum = 0;
+    int sentCount;
+    uint32_t delayMs = ICE_CONTROLLER_BATCH_RESEND_INITIAL_DELAY_MS;
+    uint32_t totalDelayMs = 0;
+    size_t i;
+
+    memset( messages, 0, sizeof( struct mmsghdr ) * packetNum );
+    for( i = 0; i < packetNum; i++ )
+    {
+        iovecs[ i ].iov_base = pBatch->pPackets[ startIndex + i ];
+        iovecs[ i ].iov_len = pBatch->packetsLength[ startIndex + i ];
+        messages[ i ].msg_hdr.msg_name = pDestinationAddress;
+        messages[ i ].msg_hdr.msg_namelen = addressLength;
+        messages[ i ].msg_hdr.msg_iov = &iovecs[ i ];
+        messages[ i ].msg_hdr.msg_iovlen = 1;
+
+        if( ( pSocketContext->isTxTimeEnabled != 0U ) &&
+            ( pBatch->packetsDepartureTimeUs[ startIndex + i ] != 0U ) )
+        {
+            /* Let the fq qdisc hold the packet until its departure time. */
+            memset( controlBuffers[ i ], 0, sizeof( controlBuffers[ i ] ) );
+            messages[ i ].msg_hdr.msg_control = controlBuffers[ i ];
+            messages[ i ].msg_hdr.msg_controllen = sizeof( controlBuffers[ i ] );
+
+            departureTimeNs = pBatch->packetsDepartureTimeUs[ startIndex + i ] * ICE_CONTROLLER_NS_PER_US;
+            pControlMessage = CMSG_FIRSTHDR( &messages[ i ].msg_hdr );
+            pControlMessage->cmsg_level = SOL_SOCKET;
+            pControlMessage->cmsg_type = SCM_TXTIME;
+            pControlMessage->cmsg_len = CMSG_LEN( sizeof( uint64_t ) );
+            memcpy( CMSG_DATA( pControlMessage ), &departureTimeNs, sizeof( uint64_t ) );
+        }
+    }
+
+    while( sentNum < packetNum )
+    {
+        /* sendmmsg() might send only part of the packets, continue from the first unsent one. */
+        sentCount = sendmmsg( pSocketContext->socketFd,
+                              &messages[ sentNum ],
+                              packetNum - sentNum,
+                              0 );
 
-            pDestinationAddress = ( struct sockaddr * ) &ipv4Address;
-            addressLength = sizeof( ipv4Address );
+        if( sentCount < 0 )
+        {
+            if( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) )
+            {
+                /* Just retry for these kinds of errno. */
+            }
+            else if( ( errno == ENOMEM ) || ( errno == ENOSPC ) || ( errno == ENOBUFS ) )
+            {
+                /* Back off once for the remaining packets instead of per packet. */
+                if( BackoffSendingBatch( &delayMs, &totalDelayMs ) == 0U )
+                {
+                    LogWarn( ( "Fail to send %lu packets before timeout: %dms", packetNum - sentNum, ICE_CONTROLLER_RESEND_TIMEOUT_MS ) );
+                    ret = ICE_CONTROLLER_RESULT_FAIL_SOCKET_SENDTO;
+                    break;
+                }
+            }
+            else
+            {
+                LogWarn( ( "Failed to send batch to socket fd: %d error, errno(%d): %s", pSocketContext->socketFd, errno, strerror( errno ) ) );
+                ret = ICE_CONTROLLER_RESULT_FAIL_SOCKET_SENDTO;
+                break;
+            }
         }
         else
         {
-            memset( &ipv6Address, 0, sizeof( ipv6Address ) );
-            ipv6Address.sin6_family = AF_INET6;
-            ipv6Address.sin6_port = htons( pRemoteEndpoint->transportAddress.port );
-            memcpy( &ipv6Address.sin6_addr, pRemoteEndpoint->transportAddress.address, STUN_IPV6_ADDRESS_SIZE );
+            sentNum += sentCount;
+            delayMs = ICE_CONTROLLER_BATCH_RESEND_INITIAL_DELAY_MS;
+        }
+    }
+
+    return ret;
+}
+
+/* Send packets [startIndex, startIndex + packetNum) as one UDP GSO super buffer. All packets must have the
+ * same length except the last one, which can be shorter. The kernel splits the buffer into datagrams.
+ * If the kernel or the device rejects the GSO request, GSO is disabled on the socket and nothing is sent,
+ * the caller is responsible to send these packets again through the fallback path. */
+static IceControllerResult_t SendSocketPacketGso( IceControllerSocketContext_t * pSocketContext,
+                                                  IceControllerSendBatch_t * pBatch,
+                                                  size_t startIndex,
+                                                  size_t packetNum,
+                                                  struct sockaddr * pDestinationAddress,
+                                                  socklen_t addressLength )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    struct msghdr message;
+    struct iovec iovecs[ ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ];
+    char controlBuffer[ CMSG_SPACE( sizeof( uint16_t ) ) ];
+    struct cmsghdr * pControlMessage;
+    uint16_t segmentSize = ( uint16_t ) pBatch->packetsLength[ startIndex ];
+    uint32_t delayMs = ICE_CONTROLLER_BATCH_RESEND_INITIAL_DELAY_MS;
+    uint32_t totalDelayMs = 0;
+    size_t i;
+
+    /* Scatter/gather the batch slots into one super buffer, no extra copy is needed. */
+    for( i = 0; i < packetNum; i++ )
+    {
+        iovecs[ i ].iov_base = pBatch->pPackets[ startIndex + i ];
+        iovecs[ i ].iov_len = pBatch->packetsLength[ startIndex + i ];
+    }
+
+    memset( &message, 0, sizeof( struct msghdr ) );
+    memset( controlBuffer, 0, sizeof( controlBuffer ) );
+    message.msg_name = pDestinationAddress;
+    message.msg_namelen = addressLength;
+    message.msg_iov = iovecs;
+    message.msg_iovlen = packetNum;
+    message.msg_control = controlBuffer;
+    message.msg_controllen = sizeof( controlBuffer );
+
+    pControlMessage = CMSG_FIRSTHDR( &message );
+    pControlMessage->cmsg_level = SOL_UDP;
+    pControlMessage->cmsg_type = UDP_SEGMENT;
+    pControlMessage->cmsg_len = CMSG_LEN( sizeof( uint16_t ) );
+    memcpy( CMSG_DATA( pControlMessage ), &segmentSize, sizeof( uint16_t ) );
+
+    while( sendmsg( pSocketContext->socketFd, &message, 0 ) < 0 )
+    {
+        if( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) )
+        {
+            /* Just retry for these kinds of errno. */
+        }
+        else if( ( errno == ENOMEM ) || ( errno == ENOSPC ) || ( errno == ENOBUFS ) )
+        {
+            if( BackoffSendingBatch( &delayMs, &totalDelayMs ) == 0U )
+            {
+                LogWarn( ( "Fail to send %lu packets with GSO before timeout: %dms", packetNum, ICE_CONTROLLER_RESEND_TIMEOUT_MS ) );
+                ret = ICE_CONTROLLER_RESULT_FAIL_SOCKET_SENDTO;
+                break;
+            }
+        }
+        else if( ( errno == EINVAL ) || ( errno == EIO ) || ( errno == ENOPROTOOPT ) || ( errno == EOPNOTSUPP ) )
+        {
+            /* Old kernel or the device doesn't support checksum offload, fall back to the normal path. */
+            LogInfo( ( "UDP GSO is rejected on socket fd: %d, errno(%d): %s, disable it", pSocketContext->socketFd, errno, strerror( errno ) ) );
+            pSocketContext->isUdpGsoSupported = 0U;
+            break;
+        }
+        else
+        {
+            LogWarn( ( "Failed to send GSO buffer to socket fd: %d error, errno(%d): %s", pSocketContext->socketFd, errno, strerror( errno ) ) );
+            ret = ICE_CONTROLLER_RESULT_FAIL_SOCKET_SENDTO;
+            break;
+        }
+    }
+
+    return ret;
+}
+
+/* Return the end index of the packets that can be sent as one GSO buffer from startIndex. */
+static size_t GetGsoSegmentEnd( IceControllerSendBatch_t * pBatch,
+                                size_t startIndex )
+{
+    size_t endIndex = startIndex + 1;
+    size_t segmentSize = pBatch->packetsLength[ startIndex ];
+
+    while( ( endIndex < pBatch->packetNum ) &&
+           ( pBatch->packetsLength[ endIndex ] == segmentSize ) )
+    {
+        endIndex++;
+    }
+
+    /* The last segment is allowed to be shorter. */
+    if( ( endIndex < pBatch->packetNum ) &&
+        ( pBatch->packetsLength[ endIndex ] < segmentSize ) )
+    {
+        endIndex++;
+    }
+
+    return endIndex;
+}
+
+static IceControllerResult_t SendSocketPacketBatch( IceControllerSocketContext_t * pSocketContext,
+                                                    IceControllerSendBatch_t * pBatch,
+                                                    struct sockaddr * pDestinationAddress,
+                                                    socklen_t addressLength )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    size_t pendingIndex = 0;
+    size_t startIndex = 0;
+    size_t endIndex;
+    size_t i;
+
+    /* TURN relay traffic doesn't use GSO, the channel data might be padded and the batch might go through TURN server. */
+    if( ( pSocketContext->isUdpGsoSupported == 0U ) ||
+        ( ( pSocketContext->pLocalCandidate != NULL ) && ( pSocketContext->pLocalCandidate->candidateType == ICE_CANDIDATE_TYPE_RELAY ) ) )
+    {
+        startIndex = pBatch->packetNum;
+    }
+
+    /* A GSO buffer leaves at a single departure time, paced packets are sent by sendmmsg() one by one. */
+    for( i = 0; ( pSocketContext->isTxTimeEnabled != 0U ) && ( i < pBatch->packetNum ); i++ )
+    {
+        if( pBatch->packetsDepartureTimeUs[ i ] != 0U )
+        {
+            startIndex = pBatch->packetNum;
+            break;
+        }
+    }
+
+    /* Equal sized packets are sent by GSO, the rest are collected and sent by sendmmsg(). */
+    while( ( ret == ICE_CONTROLLER_RESULT_OK ) &&
+           ( startIndex < pBatch->packetNum ) )
+    {
+        endIndex = GetGsoSegmentEnd( pBatch,
+                                     startIndex );
+
+        if( endIndex - startIndex < 2 )
+        {
+            /* Not worth GSO, leave it pending for sendmmsg(). */
+        }
+        else
+        {
+            if( pendingIndex < startIndex )
+            {
+                ret = SendSocketPacketMmsg( pSocketContext,
+                                            pBatch,
+                                            pendingIndex,
+                                            startIndex - pendingIndex,
+                                            pDestinationAddress,
+                                            addressLength );
+            }
+
+            if( ret == ICE_CONTROLLER_RESULT_OK )
+            {
+                ret = SendSocketPacketGso( pSocketContext,
+                                           pBatch,
+                                           startIndex,
+                                           endIndex - startIndex,
+                                           pDestinationAddress,
+                                           addressLength );
+            }
+
+            if( ( ret == ICE_CONTROLLER_RESULT_OK ) &&
+                ( pSocketContext->isUdpGsoSupported == 0U ) )
+            {
+                /* GSO was rejected, send the rest through sendmmsg(). */
+                pendingIndex = startIndex;
+                break;
+            }
 
-            pDestinationAddress = ( struct sockaddr * ) &ipv6Address;
-            addressLength = sizeof( ipv6Address );
+            pendingIndex = endIndex;
         }
+
+        startIndex = endIndex;
+    }
+
+    if( ( ret == ICE_CONTROLLER_RESULT_OK ) &&
+        ( pendingIndex < pBatch->packetNum ) )
+    {
+        ret = SendSocketPacketMmsg( pSocketContext,
+                                    pBatch,
+                                    pendingIndex,
+                                    pBatch->packetNum - pendingIndex,
+                                    pDestinationAddress,
+                                    addressLength );
+    }
+
+    return ret;
+}
+
+IceControllerResult_t IceControllerNet_SendPacket( IceControllerContext_t * pCtx,
+                                                   IceControllerSocketContext_t * pSocketContext,
+                                                   IceEndpoint_t * pRemoteEndpoint,
+                                                   const uint8_t * pBuffer,
+                                                   size_t bufferLength )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    struct sockaddr * pDestinationAddress = NULL;
+    struct sockaddr_in ipv4Address;
+    struct sockaddr_in6 ipv6Address;
+    socklen_t addressLength = 0;
+    uint8_t isLocked = 0;
+
+    if( ( pCtx == NULL ) || ( pSocketContext == NULL ) || ( pRemoteEndpoint == NULL ) || ( pBuffer == NULL ) )
+    {
+        LogError( ( "Invalid input, pCtx: %p, pSocketContext: %p, pRemoteEndpoint: %p, pBuffer: %p",
+                    pCtx, pSocketContext, pRemoteEndpoint, pBuffer ) );
+        ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        ret = LockSocketForSending( pCtx,
+                                    pSocketContext,
+                                    pRemoteEndpoint,
+                                    &isLocked );
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        SetDestinationAddress( pRemoteEndpoint,
+                               &ipv4Address,
+                               &ipv6Address,
+                               &pDestinationAddress,
+                               &addressLength );
     }
 
     /* Send data */
@@ -1181,37 +1678,82 @@ IceControllerResult_t IceControllerNet_SendPacket( IceControllerContext_t * pCtx
 
     if( ret == ICE_CONTROLLER_RESULT_FAIL_SOCKET_SENDTO )
     {
-        /*
-         * Socket read error detected.
-         * This typically indicates the remote peer closed the connection or WiFi disconnection.
-         * Action required: Close the local socket to properly terminate the connection.
-         */
-        ( void ) Ice_CloseCandidate( &pCtx->iceContext, pSocketContext->pLocalCandidate );
-        IceControllerNet_FreeSocketContext( pCtx, pSocketContext );
+        HandleSendFailure( pCtx,
+                           pSocketContext );
+    }
 
-        if( pSocketContext == pCtx->pNominatedSocketContext )
-        {
-            /* Disconnecting nominated socket connection, closing. */
-            LogWarn( ( "Unable to send packet through nominated socket, closing session: %.*s",
-                       ( int ) pCtx->iceContext.creds.combinedUsernameLength,
-                       pCtx->iceContext.creds.pCombinedUsername ) );
+    return ret;
+}
 
-            /* Notify peer connection for closing the connection. */
-            if( pCtx->onIceEventCallbackFunc )
-            {
-                pCtx->onIceEventCallbackFunc( pCtx->pOnIceEventCustomContext,
-                                              ICE_CONTROLLER_CB_EVENT_ICE_CLOSE_NOTIFY,
-                                              NULL );
+IceControllerResult_t IceControllerNet_SendPacketBatch( IceControllerContext_t * pCtx,
+                                                        IceControllerSendBatch_t * pBatch )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    struct sockaddr * pDestinationAddress = NULL;
+    struct sockaddr_in ipv4Address;
+    struct sockaddr_in6 ipv6Address;
+    socklen_t addressLength = 0;
+    uint8_t isLocked = 0;
+    size_t i;
 
-                /* Re-set the timer. */
-                IceController_UpdateTimerInterval( pCtx,
-                                                   ICE_CONTROLLER_CLOSING_INTERVAL_MS );
-            }
-            else
+    if( ( pCtx == NULL ) || ( pBatch == NULL ) ||
+        ( pBatch->pSocketContext == NULL ) || ( pBatch->pDestEndpoint == NULL ) )
+    {
+        LogError( ( "Invalid input, pCtx: %p, pBatch: %p", pCtx, pBatch ) );
+        ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        ret = LockSocketForSending( pCtx,
+                                    pBatch->pSocketContext,
+                                    pBatch->pDestEndpoint,
+                                    &isLocked );
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        SetDestinationAddress( pBatch->pDestEndpoint,
+                               &ipv4Address,
+                               &ipv6Address,
+                               &pDestinationAddress,
+                               &addressLength );
+    }
+
+    /* Send data */
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        if( pBatch->pSocketContext->socketType == ICE_CONTROLLER_SOCKET_TYPE_UDP )
+        {
+            ret = SendSocketPacketBatch( pBatch->pSocketContext,
+                                         pBatch,
+                                         pDestinationAddress,
+                                         addressLength );
+        }
+        else if( pBatch->pSocketContext->socketType == ICE_CONTROLLER_SOCKET_TYPE_TLS )
+        {
+            /* TLS is a stream, send the packets one by one. */
+            for( i = 0; ( ret == ICE_CONTROLLER_RESULT_OK ) && ( i < pBatch->packetNum ); i++ )
             {
-                LogError( ( "There is no ICE event callback function set." ) );
+                ret = SendSocketPacket( pBatch->pSocketContext, pBatch->pPackets[ i ], pBatch->packetsLength[ i ], 0, pDestinationAddress, addressLength, pBatch->pDestEndpoint );
             }
         }
+        else
+        {
+            LogError( ( "Internal error, invalid socket type %d", pBatch->pSocketContext->socketType ) );
+            ret = ICE_CONTROLLER_RESULT_FAIL_SOCKET_TYPE;
+        }
+    }
+
+    if( isLocked != 0 )
+    {
+        pthread_mutex_unlock( &( pCtx->socketMutex ) );
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_FAIL_SOCKET_SENDTO )
+    {
+        HandleSendFailure( pCtx,
+                           pBatch->pSocketContext );
     }
 
     return ret;
@@ -1232,7 +1774,7 @@ void IceControllerNet_AddLocalCandidates( IceControllerContext_t * pCtx )
     {
         /* Collect information from local network interfaces. */
         pCtx->localIceEndpointsCount = ICE_CONTROLLER_MAX_LOCAL_CANDIDATE_COUNT;
-        GetLocalIPAdresses( pCtx->localEndpoints, &pCtx->localIceEndpointsCount );
+        IceControllerWarmPool_GetLocalEndpoints( pCtx->localEndpoints, &pCtx->localIceEndpointsCount );
 
         /* Start gathering local candidates. */
         for( i = 0; i < pCtx->localIceEndpointsCount; i++ )
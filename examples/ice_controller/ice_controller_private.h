@@ -49,11 +49,22 @@ IceControllerResult_t IceControllerNet_HandleStunPacket( IceControllerContext_t
                                                          IceCandidatePair_t * pCandidatePair );
 IceControllerResult_t IceControllerNet_DnsLookUp( char * pUrl,
                                                   IceTransportAddress_t * pIceTransportAddress );
+void IceControllerNet_GetLocalIpAddresses( IceEndpoint_t * pLocalIpAddresses,
+                                          size_t * pLocalIpAddressesNum );
+/* Create a UDP socket with the ICE socket options. If pBindEndpoint isn't NULL, the socket is bound to its IP address
+ * on an ephemeral port, and the port is written back to pBindEndpoint. */
+IceControllerResult_t IceControllerNet_OpenUdpSocket( uint16_t family,
+                                                     IceEndpoint_t * pBindEndpoint,
+                                                     int * pSocketFd,
+                                                     uint8_t * pIsUdpGsoSupported,
+                                                     uint8_t * pIsTxTimeEnabled );
 IceControllerResult_t IceControllerNet_SendPacket( IceControllerContext_t * pCtx,
                                                    IceControllerSocketContext_t * pSocketContext,
                                                    IceEndpoint_t * pRemoteEndpoint,
                                                    const uint8_t * pBuffer,
                                                    size_t bufferLength );
+IceControllerResult_t IceControllerNet_SendPacketBatch( IceControllerContext_t * pCtx,
+                                                        IceControllerSendBatch_t * pBatch );
 void IceControllerNet_FreeSocketContext( IceControllerContext_t * pCtx,
                                          IceControllerSocketContext_t * pSocketContext );
 void IceControllerNet_UpdateSocketContext( IceControllerContext_t * pCtx,
@@ -77,6 +88,23 @@ IceControllerResult_t IceControllerSocketListener_Init( IceControllerContext_t *
                                                         void * pOnRecvNonStunPacketCallbackContext );
 IceControllerResult_t IceControllerSocketListener_StartPolling( IceControllerContext_t * pCtx );
 IceControllerResult_t IceControllerSocketListener_StopPolling( IceControllerContext_t * pCtx );
+IceControllerResult_t IceControllerSocketListener_AddSocket( IceControllerContext_t * pCtx,
+                                                             IceControllerSocketContext_t * pSocketContext );
+void IceControllerSocketListener_RemoveSocket( IceControllerContext_t * pCtx,
+                                               IceControllerSocketContext_t * pSocketContext );
+void IceControllerSocketListener_HandleSocketEvents( IceControllerContext_t * pCtx );
+
+/* The warm pool is started by the first ICE controller and shared by all the others. Without it, the functions below
+ * fall back to gathering on demand. */
+void IceControllerWarmPool_Init( void );
+void IceControllerWarmPool_GetLocalEndpoints( IceEndpoint_t * pLocalEndpoints,
+                                             size_t * pLocalEndpointsCount );
+/* Return 1 and a socket bound to the IP address of pBindEndpoint, its port is written back to pBindEndpoint.
+ * Return 0 if the pool has no socket for this address. */
+uint8_t IceControllerWarmPool_TakeSocket( IceEndpoint_t * pBindEndpoint,
+                                          IceControllerWarmSocket_t * pWarmSocket );
+IceControllerResult_t IceControllerWarmPool_DnsLookUp( char * pUrl,
+                                                       IceTransportAddress_t * pIceTransportAddress );
 
 /* Debug utils. */
 #if LIBRARY_LOG_LEVEL >= LOG_INFO
@@ -14,8 +14,14 @@
  * limitations under the License.
  */
 
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE /* For recvmmsg(). */
+#endif
 #include <errno.h>
 #include <unistd.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
 #include "logging.h"
 #include "ice_controller.h"
 #include "ice_controller_private.h"
@@ -23,67 +29,92 @@
 #include "stun_deserializer.h"
 #include "transport_mbedtls.h"
 
-#define ICE_CONTROLLER_SOCKET_LISTENER_SELECT_BLOCK_TIME_MS ( 50 )
-#define RX_BUFFER_SIZE ( 4096 )
+#define ICE_CONTROLLER_SOCKET_REACTOR_MAX_EVENTS ( 32 )
 
-static int32_t RecvPacketUdp( IceControllerSocketContext_t * pSocketContext,
-                              uint8_t * pBuffer,
-                              size_t bufferSize,
-                              int flags,
-                              IceEndpoint_t * pRemoteEndpoint )
+/* Every event is reported once, the socket is re-armed after the ICE controller has handled it.
+ * Keep it level-triggered, so the data arrived before re-arming is reported again. */
+#define ICE_CONTROLLER_SOCKET_REACTOR_EVENTS ( EPOLLIN | EPOLLONESHOT )
+
+static IceControllerSocketReactor_t socketReactors[ ICE_CONTROLLER_SOCKET_REACTOR_THREAD_NUM ];
+static pthread_once_t socketReactorOnce = PTHREAD_ONCE_INIT;
+static IceControllerResult_t socketReactorInitResult = ICE_CONTROLLER_RESULT_OK;
+static atomic_uint socketReactorNextIndex = 0U;
+
+static uint8_t ParseSourceAddress( const struct sockaddr_storage * pSrcAddress,
+                                   IceEndpoint_t * pRemoteEndpoint )
 {
-    int32_t ret;
-    struct sockaddr_storage srcAddress;
-    socklen_t srcAddressLength = sizeof( srcAddress );
-    struct sockaddr_in * pIpv4Address;
-    struct sockaddr_in6 * pIpv6Address;
-    uint8_t keepProcess = 1U;
+    uint8_t isValid = 1U;
+    const struct sockaddr_in * pIpv4Address;
+    const struct sockaddr_in6 * pIpv6Address;
 
-    ret = recvfrom( pSocketContext->socketFd, pBuffer, bufferSize, flags, ( struct sockaddr * ) &srcAddress, &srcAddressLength );
+    memset( pRemoteEndpoint, 0, sizeof( IceEndpoint_t ) );
 
-    if( ret < 0 )
+    if( pSrcAddress->ss_family == AF_INET )
     {
-        if( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) )
-        {
-            /* Timeout, no more data to receive. */
-            ret = 0;
-            keepProcess = 0U;
-        }
+        pIpv4Address = ( const struct sockaddr_in * ) pSrcAddress;
+
+        pRemoteEndpoint->transportAddress.family = STUN_ADDRESS_IPv4;
+        pRemoteEndpoint->transportAddress.port = ntohs( pIpv4Address->sin_port );
+        memcpy( pRemoteEndpoint->transportAddress.address, &pIpv4Address->sin_addr, STUN_IPV4_ADDRESS_SIZE );
     }
-    else if( ret == 0 )
+    else if( pSrcAddress->ss_family == AF_INET6 )
     {
-        /* Nothing to do if receive 0 byte. */
-        keepProcess = 0U;
+        pIpv6Address = ( const struct sockaddr_in6 * ) pSrcAddress;
+
+        pRemoteEndpoint->transportAddress.family = STUN_ADDRESS_IPv6;
+        pRemoteEndpoint->transportAddress.port = ntohs( pIpv6Address->sin6_port );
+        memcpy( pRemoteEndpoint->transportAddress.address, &pIpv6Address->sin6_addr, STUN_IPV6_ADDRESS_SIZE );
     }
     else
     {
-        /* Empty else marker. */
+        /* Unknown IP type, drop packet. */
+        LogWarn( ( "Unknown source type(%d) from UDP connection.", pSrcAddress->ss_family ) );
+        isValid = 0U;
     }
 
-    if( keepProcess != 0U )
+    return isValid;
+}
+
+/* Receive up to ICE_CONTROLLER_SOCKET_RX_BATCH_MAX_PACKET_NUM datagrams into the receive buffers of the ICE controller.
+ * Return the number of datagrams received, 0 if there is no more data, or negative value on error. */
+static int32_t RecvPacketUdpBatch( IceControllerSocketContext_t * pSocketContext,
+                                   IceControllerSocketListenerContext_t * pListenerContext )
+{
+    int32_t ret;
+    struct mmsghdr messages[ ICE_CONTROLLER_SOCKET_RX_BATCH_MAX_PACKET_NUM ];
+    struct iovec iovecs[ ICE_CONTROLLER_SOCKET_RX_BATCH_MAX_PACKET_NUM ];
+    int i;
+
+    memset( messages, 0, sizeof( messages ) );
+    for( i = 0; i < ICE_CONTROLLER_SOCKET_RX_BATCH_MAX_PACKET_NUM; i++ )
     {
-        /* Received data, handle this STUN message. */
-        if( srcAddress.ss_family == AF_INET )
-        {
-            pIpv4Address = ( struct sockaddr_in * ) &srcAddress;
+        iovecs[ i ].iov_base = pListenerContext->rxBuffers[ i ];
+        iovecs[ i ].iov_len = ICE_CONTROLLER_SOCKET_RX_BUFFER_SIZE;
+        messages[ i ].msg_hdr.msg_name = &pListenerContext->rxSrcAddresses[ i ];
+        messages[ i ].msg_hdr.msg_namelen = sizeof( struct sockaddr_storage );
+        messages[ i ].msg_hdr.msg_iov = &iovecs[ i ];
+        messages[ i ].msg_hdr.msg_iovlen = 1;
+    }
 
-            pRemoteEndpoint->transportAddress.family = STUN_ADDRESS_IPv4;
-            pRemoteEndpoint->transportAddress.port = ntohs( pIpv4Address->sin_port );
-            memcpy( pRemoteEndpoint->transportAddress.address, &pIpv4Address->sin_addr, STUN_IPV4_ADDRESS_SIZE );
-        }
-        else if( srcAddress.ss_family == AF_INET6 )
-        {
-            pIpv6Address = ( struct sockaddr_in6 * ) &srcAddress;
+    ret = recvmmsg( pSocketContext->socketFd,
+                    messages,
+                    ICE_CONTROLLER_SOCKET_RX_BATCH_MAX_PACKET_NUM,
+                    MSG_DONTWAIT,
+                    NULL );
 
-            pRemoteEndpoint->transportAddress.family = STUN_ADDRESS_IPv6;
-            pRemoteEndpoint->transportAddress.port = ntohs( pIpv6Address->sin6_port );
-            memcpy( pRemoteEndpoint->transportAddress.address, &pIpv6Address->sin6_addr, STUN_IPV6_ADDRESS_SIZE );
+    if( ret < 0 )
+    {
+        if( ( errno == EAGAIN ) || ( errno == EWOULDBLOCK ) )
+        {
+            /* No more data to receive. */
+            ret = 0;
         }
-        else
+    }
+    else
+    {
+        for( i = 0; i < ret; i++ )
         {
-            /* Unknown IP type, drop packet. */
-            LogWarn( ( "Unknown source type(%d) from UDP connection.", srcAddress.ss_family ) );
-            ret = -1;
+            pListenerContext->rxLengths[ i ] = messages[ i ].msg_len;
         }
     }
 
@@ -281,190 +312,241 @@ static IceControllerResult_t UpdateNominatedSocketContext( IceControllerContext_
     return ret;
 }
 
+/* Demultiplex and handle one received packet. Return ICE_CONTROLLER_RESULT_CONNECTION_CLOSED if the socket
+ * has been closed while handling the packet, the remaining packets of the batch should be dropped then. */
+static IceControllerResult_t ProcessRxPacket( IceControllerContext_t * pCtx,
+                                              IceControllerSocketContext_t * pSocketContext,
+                                              uint8_t * pBuffer,
+                                              size_t bufferLength,
+                                              IceEndpoint_t * pRemoteIceEndpoint,
+                                              OnRecvNonStunPacketCallback_t onRecvNonStunPacketFunc,
+                                              void * pOnRecvNonStunPacketCallbackContext )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    IceResult_t iceResult;
+    IceCandidatePair_t * pCandidatePair = NULL;
+    uint8_t * pTurnPayload = NULL;
+    uint16_t turnPayloadBufferLength = 0;
+    uint8_t * pProcessingBuffer = pBuffer;
+    size_t processingBufferLength = bufferLength;
+
+    LogVerbose( ( "Receiving %lu btyes on local candidate ID: 0x%04x", bufferLength, pSocketContext->pLocalCandidate->candidateId ) );
+
+    if( pSocketContext->pLocalCandidate->candidateType == ICE_CANDIDATE_TYPE_RELAY )
+    {
+        if( pthread_mutex_lock( &( pCtx->iceMutex ) ) == 0 )
+        {
+            iceResult = Ice_HandleTurnPacket( &pCtx->iceContext,
+                                              pProcessingBuffer,
+                                              processingBufferLength,
+                                              pSocketContext->pLocalCandidate,
+                                              ( const uint8_t ** ) &pTurnPayload,
+                                              &turnPayloadBufferLength,
+                                              &pCandidatePair );
+            pthread_mutex_unlock( &( pCtx->iceMutex ) );
+
+            if( iceResult == ICE_RESULT_OK )
+            {
+                LogVerbose( ( "Removed TURN channel header for local/remote candidate ID 0x%04x / 0x%04x, number: 0x%02x%02x, length: 0x%02x%02x",
+                              pCandidatePair->pLocalCandidate->candidateId,
+                              pCandidatePair->pRemoteCandidate->candidateId,
+                              pProcessingBuffer[ 0 ], pProcessingBuffer[ 1 ],
+                              pProcessingBuffer[ 2 ], pProcessingBuffer[ 3 ] ) );
+
+                /* Received TURN buffer, replace buffer pointer for further processing. */
+                pProcessingBuffer = pTurnPayload;
+                processingBufferLength = turnPayloadBufferLength;
+            }
+            else
+            {
+                /* TURN prefix not required, keep original buffer. */
+            }
+        }
+        else
+        {
+            LogError( ( "Failed to handle TURN packet: mutex lock acquisition." ) );
+            processingBufferLength = 0;
+        }
+    }
+
+    /*
+     * demux each packet off of its first byte
+     * https://tools.ietf.org/html/rfc5764#section-5.1.2
+     * +----------------+
+     * | 127 < B < 192 -+--> forward to RTP/RTCP
+     * |                |
+     * |  19 < B < 64  -+--> forward to DTLS
+     * |                |
+     * |       B < 2   -+--> forward to STUN
+     * +----------------+
+     */
+    if( processingBufferLength > 0 )
+    {
+        if( ( ( pProcessingBuffer[ 0 ] > 127 ) && ( pProcessingBuffer[ 0 ] < 192 ) ) ||
+            ( ( pProcessingBuffer[ 0 ] > 19 ) && ( pProcessingBuffer[ 0 ] < 64 ) ) )
+        {
+            /* It's not STUN packet, deliever to peer connection to handle RTP or DTLS packet. */
+            /* When ICE controlling agent sends all binding requests with USE-CANDIDATE flag in connectivity stage,
+             * it's possible to pick different agent between local and remote peer. Thus we update nominated pair pointer
+             * to handle current packet. */
+            if( onRecvNonStunPacketFunc )
+            {
+                if( pCtx->pNominatedSocketContext != pSocketContext )
+                {
+                    ret = UpdateNominatedSocketContext( pCtx, pSocketContext, pCandidatePair, pRemoteIceEndpoint );
+                }
+
+                if( ret == ICE_CONTROLLER_RESULT_OK )
+                {
+                    ( void ) onRecvNonStunPacketFunc( pOnRecvNonStunPacketCallbackContext,
+                                                      pProcessingBuffer,
+                                                      processingBufferLength );
+                }
+                else
+                {
+                    LogWarn( ( "DTLS packet rejected: Received from non-selected ICE candidate pair" ) );
+                }
+            }
+            else
+            {
+                LogError( ( "No callback function to handle DTLS/RTP/RTCP packets." ) );
+            }
+        }
+        else if( pProcessingBuffer[ 0 ] < 2 )
+        {
+            /* STUN packet. */
+            ret = IceControllerNet_HandleStunPacket( pCtx,
+                                                     pSocketContext,
+                                                     pProcessingBuffer,
+                                                     processingBufferLength,
+                                                     pRemoteIceEndpoint,
+                                                     pCandidatePair );
+            if( ( ret == ICE_CONTROLLER_RESULT_FOUND_CONNECTION ) &&
+                ( pCtx->pNominatedSocketContext == NULL ) )
+            {
+                UpdateNominatedSocketContext( pCtx,
+                                              pSocketContext,
+                                              pCandidatePair,
+                                              pRemoteIceEndpoint );
+            }
+            else if( ( ret == ICE_CONTROLLER_RESULT_FOUND_CONNECTION ) || ( ret == ICE_CONTROLLER_RESULT_OK ) )
+            {
+                /* Handle STUN packet successfully, keep processing. */
+            }
+            else if( ret == ICE_CONTROLLER_RESULT_CONNECTION_CLOSED )
+            {
+                /* Socket has been closed, skip the rest packets. */
+            }
+            else
+            {
+                LogError( ( "Fail to handle this RX packet, ret: %d, readBytes: %lu", ret, processingBufferLength ) );
+            }
+        }
+        else
+        {
+            /* Unknown packet. */
+            LogWarn( ( "drop unknown packet, length=%lu, first byte=0x%02x",
+                       processingBufferLength,
+                       pProcessingBuffer[ 0 ] ) );
+        }
+    }
+
+    return ret;
+}
+
 static void HandleRxPacket( IceControllerContext_t * pCtx,
                             IceControllerSocketContext_t * pSocketContext,
                             OnRecvNonStunPacketCallback_t onRecvNonStunPacketFunc,
                             void * pOnRecvNonStunPacketCallbackContext )
 {
     uint8_t skipProcess = 0;
-    int32_t readBytes = 0;
+    int32_t readCount = 0;
+    int32_t i;
     IceEndpoint_t remoteIceEndpoint;
-    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
-    IceResult_t iceResult;
-    IceCandidatePair_t * pCandidatePair = NULL;
-    uint8_t * pTurnPayload = NULL;
-    uint16_t turnPayloadBufferLength = 0;
-    uint8_t receiveBuffer[ RX_BUFFER_SIZE ];
-    uint8_t * pProcessingBuffer = receiveBuffer;
-    size_t processingBufferLength = 0;
+    IceControllerSocketListenerContext_t * pListenerContext = NULL;
 
     if( ( pCtx == NULL ) || ( pSocketContext == NULL ) )
     {
         LogError( ( "Invalid input, pCtx: %p, pSocketContext: %p", pCtx, pSocketContext ) );
         skipProcess = 1;
     }
+    else
+    {
+        pListenerContext = &pCtx->socketListenerContext;
+    }
 
     while( !skipProcess )
     {
-        memset( &remoteIceEndpoint, 0, sizeof( IceEndpoint_t ) );
         if( pSocketContext->socketType == ICE_CONTROLLER_SOCKET_TYPE_UDP )
         {
-            readBytes = RecvPacketUdp( pSocketContext, pProcessingBuffer, RX_BUFFER_SIZE, 0, &remoteIceEndpoint );
+            /* Drain the socket in batches until EAGAIN, the reactor reports it again after it's re-armed. */
+            readCount = RecvPacketUdpBatch( pSocketContext, pListenerContext );
         }
         else if( pSocketContext->socketType == ICE_CONTROLLER_SOCKET_TYPE_TLS )
         {
-            readBytes = RecvPacketTls( pSocketContext, pProcessingBuffer, RX_BUFFER_SIZE, &remoteIceEndpoint );
+            /* TLS is a stream, receive it into the first buffer. */
+            readCount = RecvPacketTls( pSocketContext, pListenerContext->rxBuffers[ 0 ], ICE_CONTROLLER_SOCKET_RX_BUFFER_SIZE, &remoteIceEndpoint );
+            if( readCount > 0 )
+            {
+                pListenerContext->rxLengths[ 0 ] = ( size_t ) readCount;
+                readCount = 1;
+            }
         }
         else
         {
             LogError( ( "Internal error, invalid socket type %d", pSocketContext->socketType ) );
-            skipProcess = 1;
             break;
         }
 
-        if( readBytes < 0 )
+        if( readCount < 0 )
         {
             LogError( ( "Fail to receive packets from socket ID: %d, errno: %s", pSocketContext->socketFd, strerror( errno ) ) );
-            skipProcess = 1;
             break;
         }
-        else if( readBytes == 0 )
+        else if( readCount == 0 )
         {
             /* Nothing to do if receive 0 byte. */
             break;
         }
         else
         {
-            /* Received valid data, keep addressing. */
-            LogVerbose( ( "Receiving %d btyes on local candidate ID: 0x%04x", readBytes, pSocketContext->pLocalCandidate->candidateId ) );
-            processingBufferLength = ( size_t ) readBytes;
+            /* Empty else marker. */
         }
 
-        if( pSocketContext->pLocalCandidate->candidateType == ICE_CANDIDATE_TYPE_RELAY )
+        /* Handle the received batch in one pass. */
+        for( i = 0; i < readCount; i++ )
         {
-            if( pthread_mutex_lock( &( pCtx->iceMutex ) ) == 0 )
-            {
-                iceResult = Ice_HandleTurnPacket( &pCtx->iceContext,
-                                                  pProcessingBuffer,
-                                                  processingBufferLength,
-                                                  pSocketContext->pLocalCandidate,
-                                                  ( const uint8_t ** ) &pTurnPayload,
-                                                  &turnPayloadBufferLength,
-                                                  &pCandidatePair );
-                pthread_mutex_unlock( &( pCtx->iceMutex ) );
-
-                if( iceResult == ICE_RESULT_OK )
-                {
-                    LogVerbose( ( "Removed TURN channel header for local/remote candidate ID 0x%04x / 0x%04x, number: 0x%02x%02x, length: 0x%02x%02x",
-                                  pCandidatePair->pLocalCandidate->candidateId,
-                                  pCandidatePair->pRemoteCandidate->candidateId,
-                                  pProcessingBuffer[ 0 ], pProcessingBuffer[ 1 ],
-                                  pProcessingBuffer[ 2 ], pProcessingBuffer[ 3 ] ) );
-
-                    /* Received TURN buffer, replace buffer pointer for further processing. */
-                    pProcessingBuffer = pTurnPayload;
-                    processingBufferLength = turnPayloadBufferLength;
-                }
-                else
-                {
-                    /* TURN prefix not required, keep original buffer. */
-                }
-            }
-            else
+            if( pListenerContext->rxLengths[ i ] == 0 )
             {
-                LogError( ( "Failed to handle TURN packet: mutex lock acquisition." ) );
-                break;
+                /* Nothing to do if receive 0 byte. */
+                continue;
             }
-        }
-
-        /*
-         * demux each packet off of its first byte
-         * https://tools.ietf.org/html/rfc5764#section-5.1.2
-         * +----------------+
-         * | 127 < B < 192 -+--> forward to RTP/RTCP
-         * |                |
-         * |  19 < B < 64  -+--> forward to DTLS
-         * |                |
-         * |       B < 2   -+--> forward to STUN
-         * +----------------+
-         */
-        if( processingBufferLength > 0 )
-        {
-            if( ( ( pProcessingBuffer[ 0 ] > 127 ) && ( pProcessingBuffer[ 0 ] < 192 ) ) ||
-                ( ( pProcessingBuffer[ 0 ] > 19 ) && ( pProcessingBuffer[ 0 ] < 64 ) ) )
-            {
-                /* It's not STUN packet, deliever to peer connection to handle RTP or DTLS packet. */
-                /* When ICE controlling agent sends all binding requests with USE-CANDIDATE flag in connectivity stage,
-                 * it's possible to pick different agent between local and remote peer. Thus we update nominated pair pointer
-                 * to handle current packet. */
-                if( onRecvNonStunPacketFunc )
-                {
-                    if( pCtx->pNominatedSocketContext != pSocketContext )
-                    {
-                        ret = UpdateNominatedSocketContext( pCtx, pSocketContext, pCandidatePair, &remoteIceEndpoint );
-                    }
 
-                    if( ret == ICE_CONTROLLER_RESULT_OK )
-                    {
-                        ( void ) onRecvNonStunPacketFunc( pOnRecvNonStunPacketCallbackContext,
-                                                          pProcessingBuffer,
-                                                          processingBufferLength );
-                    }
-                    else
-                    {
-                        LogWarn( ( "DTLS packet rejected: Received from non-selected ICE candidate pair" ) );
-                    }
-                }
-                else
-                {
-                    LogError( ( "No callback function to handle DTLS/RTP/RTCP packets." ) );
-                }
-            }
-            else if( pProcessingBuffer[ 0 ] < 2 )
+            if( ( pSocketContext->socketType == ICE_CONTROLLER_SOCKET_TYPE_UDP ) &&
+                ( ParseSourceAddress( &pListenerContext->rxSrcAddresses[ i ], &remoteIceEndpoint ) == 0U ) )
             {
-                /* STUN packet. */
-                ret = IceControllerNet_HandleStunPacket( pCtx,
-                                                         pSocketContext,
-                                                         pProcessingBuffer,
-                                                         processingBufferLength,
-                                                         &remoteIceEndpoint,
-                                                         pCandidatePair );
-                if( ( ret == ICE_CONTROLLER_RESULT_FOUND_CONNECTION ) &&
-                    ( pCtx->pNominatedSocketContext == NULL ) )
-                {
-                    UpdateNominatedSocketContext( pCtx,
-                                                  pSocketContext,
-                                                  pCandidatePair,
-                                                  &remoteIceEndpoint );
-                }
-                else if( ( ret == ICE_CONTROLLER_RESULT_FOUND_CONNECTION ) || ( ret == ICE_CONTROLLER_RESULT_OK ) )
-                {
-                    /* Handle STUN packet successfully, keep processing. */
-                }
-                else if( ret == ICE_CONTROLLER_RESULT_CONNECTION_CLOSED )
-                {
-                    /* Socket has been closed, skip the next recv loop. */
-                    break;
-                }
-                else
-                {
-                    LogError( ( "Fail to handle this RX packet, ret: %d, readBytes: %lu", ret, processingBufferLength ) );
-                }
+                continue;
             }
-            else
+
+            if( ProcessRxPacket( pCtx,
+                                 pSocketContext,
+                                 pListenerContext->rxBuffers[ i ],
+                                 pListenerContext->rxLengths[ i ],
+                                 &remoteIceEndpoint,
+                                 onRecvNonStunPacketFunc,
+                                 pOnRecvNonStunPacketCallbackContext ) == ICE_CONTROLLER_RESULT_CONNECTION_CLOSED )
             {
-                /* Unknown packet. */
-                LogWarn( ( "drop unknown packet, length=%lu, first byte=0x%02x",
-                           processingBufferLength,
-                           pProcessingBuffer[ 0 ] ) );
+                /* Socket has been closed, skip the next recv loop. */
+                skipProcess = 1;
+                break;
             }
         }
     }
 
-    if( readBytes < 0 )
+    if( readCount < 0 )
     {
         /*
-         * Socket read error detected (readBytes < 0).
+         * Socket read error detected (readCount < 0).
          * This typically indicates the remote peer closed the connection.
          * Action required: Close the local socket to properly terminate the connection.
          */
@@ -473,32 +555,44 @@ static void HandleRxPacket( IceControllerContext_t * pCtx,
     }
 }
 
-static void pollingSockets( IceControllerContext_t * pCtx )
+/* Re-arm the socket in the reactor of the ICE controller, the socket mutex must be held. */
+static void RearmSocket( IceControllerContext_t * pCtx,
+                         IceControllerSocketContext_t * pSocketContext )
+{
+    struct epoll_event event;
+
+    memset( &event, 0, sizeof( struct epoll_event ) );
+    event.events = ICE_CONTROLLER_SOCKET_REACTOR_EVENTS;
+    event.data.ptr = pSocketContext;
+    if( epoll_ctl( pCtx->socketListenerContext.pReactor->epollFd, EPOLL_CTL_MOD, pSocketContext->socketFd, &event ) != 0 )
+    {
+        LogWarn( ( "Fail to re-arm socket fd: %d, errno(%d): %s", pSocketContext->socketFd, errno, strerror( errno ) ) );
+    }
+}
+
+static void HandleSocketEvent( IceControllerContext_t * pCtx,
+                               IceControllerSocketContext_t * pSocketContext )
 {
-    fd_set rfds;
-    int i;
-    struct timeval tv = {
-        .tv_sec = 0,
-        .tv_usec = ICE_CONTROLLER_SOCKET_LISTENER_SELECT_BLOCK_TIME_MS * 1000,
-    };
-    int maxFd = 0;
-    int retSelect;
     uint8_t skipProcess = 0;
-    int fds[ ICE_CONTROLLER_MAX_LOCAL_CANDIDATE_COUNT ];
-    size_t fdsCount;
-    OnRecvNonStunPacketCallback_t onRecvNonStunPacketFunc;
+    OnRecvNonStunPacketCallback_t onRecvNonStunPacketFunc = NULL;
     void * pOnRecvNonStunPacketCallbackContext = NULL;
-    IceControllerSocketContext_t * pSocketContext;
-
-    FD_ZERO( &rfds );
+    IceControllerSocketContextState_t state = ICE_CONTROLLER_SOCKET_CONTEXT_STATE_NONE;
 
     if( pthread_mutex_lock( &( pCtx->socketMutex ) ) == 0 )
     {
-        for( i = 0; i < pCtx->socketsContextsCount; i++ )
+        /* The socket might be closed after the event was reported. */
+        if( ( pCtx->socketListenerContext.executeSocketListener == 0 ) ||
+            ( pSocketContext->socketFd < 0 ) )
+        {
+            skipProcess = 1;
+        }
+        else
         {
-            fds[i] = pCtx->socketsContexts[i].socketFd;
+            /* Hold the socket open until the handling is done, see IceControllerNet_FreeSocketContext(). */
+            pSocketContext->isHandling = 1U;
+            pSocketContext->handlingTid = pthread_self();
         }
-        fdsCount = pCtx->socketsContextsCount;
+        state = pSocketContext->state;
         onRecvNonStunPacketFunc = pCtx->socketListenerContext.onRecvNonStunPacketFunc;
         pOnRecvNonStunPacketCallbackContext = pCtx->socketListenerContext.pOnRecvNonStunPacketCallbackContext;
 
@@ -513,58 +607,180 @@ static void pollingSockets( IceControllerContext_t * pCtx )
 
     if( !skipProcess )
     {
-        /* Set rfds for select function. */
-        for( i = 0; i < fdsCount; i++ )
+        if( state == ICE_CONTROLLER_SOCKET_CONTEXT_STATE_CONNECTION_IN_PROGRESS )
+        {
+            ( void ) IceControllerNet_ExecuteTlsHandshake( pCtx, pSocketContext, 0U );
+        }
+        else
+        {
+            HandleRxPacket( pCtx,
+                            pSocketContext,
+                            onRecvNonStunPacketFunc,
+                            pOnRecvNonStunPacketCallbackContext );
+        }
+
+        if( pthread_mutex_lock( &( pCtx->socketMutex ) ) == 0 )
         {
-            /* fds might be removed for any reason. Handle that by checking if it's -1. */
-            if( fds[i] >= 0 )
+            pSocketContext->isHandling = 0U;
+
+            /* Polling might be stopped meanwhile, IceControllerSocketListener_StartPolling() re-arms it then. */
+            if( ( pSocketContext->socketFd >= 0 ) &&
+                ( pCtx->socketListenerContext.executeSocketListener != 0 ) )
             {
-                FD_SET( fds[i], &rfds );
-                if( fds[i] > maxFd )
-                {
-                    maxFd = fds[i];
-                }
+                RearmSocket( pCtx,
+                             pSocketContext );
             }
+            pthread_cond_broadcast( &( pCtx->socketCond ) );
+
+            /* We have finished accessing the shared resource.  Release the mutex. */
+            pthread_mutex_unlock( &( pCtx->socketMutex ) );
         }
+        else
+        {
+            LogError( ( "Unexpected behavior: fail to take mutex" ) );
+        }
+    }
+}
 
-        /* Poll all socket handlers. */
-        retSelect = select( maxFd + 1, &rfds, NULL, NULL, &tv );
-        if( retSelect < 0 )
+static void ReportSocketEvent( IceControllerSocketContext_t * pSocketContext )
+{
+    IceControllerContext_t * pCtx = pSocketContext->pIceControllerContext;
+    int32_t result;
+
+    atomic_store( &pSocketContext->isEventPending, 1U );
+
+    /* Report once until the ICE controller handles the pending events. */
+    if( ( pCtx->onIceEventCallbackFunc != NULL ) &&
+        ( atomic_exchange( &pCtx->socketListenerContext.isEventReported, 1U ) == 0U ) )
+    {
+        result = pCtx->onIceEventCallbackFunc( pCtx->pOnIceEventCustomContext,
+                                               ICE_CONTROLLER_CB_EVENT_SOCKET_READY,
+                                               NULL );
+        if( result != 0 )
         {
-            LogError( ( "select return error value %d", retSelect ) );
-            skipProcess = 1;
+            /* The event stays pending, it's handled at the next IceController_HandleSocketEvents(). */
+            LogWarn( ( "Fail to report socket event, result: %d", result ) );
+            atomic_store( &pCtx->socketListenerContext.isEventReported, 0U );
         }
-        else if( retSelect == 0 )
+    }
+}
+
+static void * SocketReactor_Task( void * pParameter )
+{
+    IceControllerSocketReactor_t * pReactor = ( IceControllerSocketReactor_t * ) pParameter;
+    struct epoll_event events[ ICE_CONTROLLER_SOCKET_REACTOR_MAX_EVENTS ];
+    int eventsCount;
+    int i;
+
+    for( ;; )
+    {
+        eventsCount = epoll_wait( pReactor->epollFd,
+                                  events,
+                                  ICE_CONTROLLER_SOCKET_REACTOR_MAX_EVENTS,
+                                  -1 );
+        if( eventsCount < 0 )
         {
-            /* It's just timeout. */
-            skipProcess = 1;
+            if( errno != EINTR )
+            {
+                LogError( ( "epoll_wait return error, errno(%d): %s", errno, strerror( errno ) ) );
+            }
+            continue;
+        }
+
+        /* Never receive or run callbacks of the sessions here, one slow session must not delay the others. */
+        for( i = 0; i < eventsCount; i++ )
+        {
+            ReportSocketEvent( ( IceControllerSocketContext_t * ) events[ i ].data.ptr );
+        }
+    }
+
+    return NULL;
+}
+
+static void InitSocketReactor( void )
+{
+    size_t i;
+
+    socketReactorInitResult = ICE_CONTROLLER_RESULT_OK;
+
+    for( i = 0; ( i < ICE_CONTROLLER_SOCKET_REACTOR_THREAD_NUM ) && ( socketReactorInitResult == ICE_CONTROLLER_RESULT_OK ); i++ )
+    {
+        socketReactors[ i ].epollFd = epoll_create1( EPOLL_CLOEXEC );
+        if( socketReactors[ i ].epollFd < 0 )
+        {
+            LogError( ( "Fail to create epoll instance, errno(%d): %s", errno, strerror( errno ) ) );
+            socketReactorInitResult = ICE_CONTROLLER_RESULT_FAIL_CREATE_SOCKET_REACTOR;
+        }
+        else if( pthread_create( &socketReactors[ i ].reactorTid,
+                                 NULL,
+                                 SocketReactor_Task,
+                                 &socketReactors[ i ] ) != 0 )
+        {
+            LogError( ( "Fail to create socket reactor task" ) );
+            close( socketReactors[ i ].epollFd );
+            socketReactors[ i ].epollFd = -1;
+            socketReactorInitResult = ICE_CONTROLLER_RESULT_FAIL_CREATE_SOCKET_REACTOR;
         }
         else
         {
             /* Empty else marker. */
         }
     }
+}
 
-    if( !skipProcess )
+IceControllerResult_t IceControllerSocketListener_AddSocket( IceControllerContext_t * pCtx,
+                                                             IceControllerSocketContext_t * pSocketContext )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    struct epoll_event event;
+
+    if( ( pCtx == NULL ) || ( pSocketContext == NULL ) || ( pSocketContext->socketFd < 0 ) )
     {
-        for( i = 0; i < fdsCount; i++ )
+        LogError( ( "Invalid input, pCtx: %p, pSocketContext: %p", pCtx, pSocketContext ) );
+        ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        pSocketContext->pIceControllerContext = pCtx;
+        atomic_store( &pSocketContext->isEventPending, 0U );
+
+        memset( &event, 0, sizeof( struct epoll_event ) );
+        event.events = ICE_CONTROLLER_SOCKET_REACTOR_EVENTS;
+        event.data.ptr = pSocketContext;
+        if( epoll_ctl( pCtx->socketListenerContext.pReactor->epollFd, EPOLL_CTL_ADD, pSocketContext->socketFd, &event ) != 0 )
         {
-            if( ( fds[i] >= 0 ) && FD_ISSET( fds[i], &rfds ) )
-            {
-                pSocketContext = &( pCtx->socketsContexts[ i ] );
+            LogError( ( "Fail to add socket fd: %d into reactor, errno(%d): %s", pSocketContext->socketFd, errno, strerror( errno ) ) );
+            ret = ICE_CONTROLLER_RESULT_FAIL_ADD_SOCKET_TO_REACTOR;
+        }
+    }
 
-                if( pSocketContext->state == ICE_CONTROLLER_SOCKET_CONTEXT_STATE_CONNECTION_IN_PROGRESS )
-                {
-                    ( void ) IceControllerNet_ExecuteTlsHandshake( pCtx, pSocketContext, 0U );
-                }
-                else
-                {
-                    HandleRxPacket( pCtx,
-                                    pSocketContext,
-                                    onRecvNonStunPacketFunc,
-                                    pOnRecvNonStunPacketCallbackContext );
-                }
-            }
+    return ret;
+}
+
+void IceControllerSocketListener_RemoveSocket( IceControllerContext_t * pCtx,
+                                               IceControllerSocketContext_t * pSocketContext )
+{
+    if( ( pCtx != NULL ) && ( pSocketContext != NULL ) && ( pSocketContext->socketFd >= 0 ) )
+    {
+        /* Closing the socket removes it from epoll as well, remove it explicitly in case the fd is duplicated. */
+        ( void ) epoll_ctl( pCtx->socketListenerContext.pReactor->epollFd, EPOLL_CTL_DEL, pSocketContext->socketFd, NULL );
+    }
+}
+
+void IceControllerSocketListener_HandleSocketEvents( IceControllerContext_t * pCtx )
+{
+    size_t i;
+
+    /* Clear it first, so the events reported while handling are reported again. */
+    atomic_store( &pCtx->socketListenerContext.isEventReported, 0U );
+
+    for( i = 0; i < ICE_CONTROLLER_MAX_LOCAL_CANDIDATE_COUNT; i++ )
+    {
+        if( atomic_exchange( &pCtx->socketsContexts[ i ].isEventPending, 0U ) != 0U )
+        {
+            HandleSocketEvent( pCtx,
+                               &pCtx->socketsContexts[ i ] );
         }
     }
 }
@@ -572,10 +788,24 @@ static void pollingSockets( IceControllerContext_t * pCtx )
 IceControllerResult_t IceControllerSocketListener_StartPolling( IceControllerContext_t * pCtx )
 {
     IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    size_t i;
 
     if( pthread_mutex_lock( &( pCtx->socketMutex ) ) == 0 )
     {
         pCtx->socketListenerContext.executeSocketListener = 1;
+        /* A report of the previous session might be dropped with its requests, report the next event anyway. */
+        atomic_store( &pCtx->socketListenerContext.isEventReported, 0U );
+
+        /* Re-arm the registered sockets, the events are not re-armed while polling is stopped. */
+        for( i = 0; i < pCtx->socketsContextsCount; i++ )
+        {
+            if( ( pCtx->socketsContexts[ i ].socketFd >= 0 ) &&
+                ( pCtx->socketsContexts[ i ].isHandling == 0U ) )
+            {
+                RearmSocket( pCtx,
+                             &pCtx->socketsContexts[ i ] );
+            }
+        }
 
         /* We have finished accessing the shared resource.  Release the mutex. */
         pthread_mutex_unlock( &( pCtx->socketMutex ) );
@@ -625,31 +855,22 @@ IceControllerResult_t IceControllerSocketListener_Init( IceControllerContext_t *
         ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
     }
 
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        /* The reactors are created by the first ICE controller and shared by all the others. */
+        ( void ) pthread_once( &socketReactorOnce,
+                               InitSocketReactor );
+        ret = socketReactorInitResult;
+    }
+
     if( ret == ICE_CONTROLLER_RESULT_OK )
     {
         pCtx->socketListenerContext.executeSocketListener = 0;
+        pCtx->socketListenerContext.pReactor = &socketReactors[ atomic_fetch_add( &socketReactorNextIndex, 1U ) % ICE_CONTROLLER_SOCKET_REACTOR_THREAD_NUM ];
+        atomic_store( &pCtx->socketListenerContext.isEventReported, 0U );
         pCtx->socketListenerContext.onRecvNonStunPacketFunc = onRecvNonStunPacketFunc;
         pCtx->socketListenerContext.pOnRecvNonStunPacketCallbackContext = pOnRecvNonStunPacketCallbackContext;
     }
 
     return ret;
 }
-
-void * IceControllerSocketListener_Task( void * pParameter )
-{
-    IceControllerContext_t * pCtx = ( IceControllerContext_t * ) pParameter;
-
-    for( ;; )
-    {
-        while( pCtx->socketListenerContext.executeSocketListener == 0 )
-        {
-            usleep( ICE_CONTROLLER_SOCKET_LISTENER_SELECT_BLOCK_TIME_MS * 1000 );
-            //vTaskDelay( pdMS_TO_TICKS( ICE_CONTROLLER_SOCKET_LISTENER_SELECT_BLOCK_TIME_MS ) );
-        }
-
-        if( pCtx->socketListenerContext.executeSocketListener == 1 )
-        {
-            pollingSockets( pCtx );
-        }
-    }
-}
@@ -0,0 +1,494 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "logging.h"
+#include "ice_controller.h"
+#include "ice_controller_private.h"
+#include "networking_utils.h"
+
+static IceControllerWarmPool_t warmPool = {
+    .isRunning = 0U,
+};
+#if ENABLE_ICE_WARM_POOL
+    static pthread_once_t warmPoolOnce = PTHREAD_ONCE_INIT;
+#endif /* ENABLE_ICE_WARM_POOL */
+
+static uint64_t GetCurrentTimeMs( void )
+{
+    return NetworkingUtils_GetCurrentMonotonicTimeUs( NULL ) / 1000;
+}
+
+static uint8_t IsSameAddress( const IceEndpoint_t * pEndpoint,
+                              const IceEndpoint_t * pOtherEndpoint )
+{
+    return ( ( pEndpoint->transportAddress.family == pOtherEndpoint->transportAddress.family ) &&
+             ( memcmp( pEndpoint->transportAddress.address,
+                       pOtherEndpoint->transportAddress.address,
+                       pEndpoint->transportAddress.family == STUN_ADDRESS_IPv4 ? STUN_IPV4_ADDRESS_SIZE : STUN_IPV6_ADDRESS_SIZE ) == 0 ) ) ? 1U : 0U;
+}
+
+/* A DNS result only resolves the family and the address, never touch the port. */
+static void CopyDnsResult( IceTransportAddress_t * pDestination,
+                           const IceTransportAddress_t * pSource )
+{
+    pDestination->family = pSource->family;
+    memcpy( pDestination->address,
+            pSource->address,
+            sizeof( pDestination->address ) );
+}
+
+static IceControllerWarmDnsEntry_t * FindDnsEntry( IceControllerWarmPool_t * pPool,
+                                                   const char * pUrl )
+{
+    IceControllerWarmDnsEntry_t * pDnsEntry = NULL;
+    size_t i;
+
+    for( i = 0; i < pPool->dnsEntriesCount; i++ )
+    {
+        if( strcmp( pPool->dnsEntries[ i ].url,
+                    pUrl ) == 0 )
+        {
+            pDnsEntry = &pPool->dnsEntries[ i ];
+            break;
+        }
+    }
+
+    return pDnsEntry;
+}
+
+/* Store the DNS result, replace the least recently used entry if the cache is full. The lock must be held. */
+static void StoreDnsEntry( IceControllerWarmPool_t * pPool,
+                           const char * pUrl,
+                           const IceTransportAddress_t * pIceTransportAddress,
+                           uint64_t currentTimeMs )
+{
+    IceControllerWarmDnsEntry_t * pDnsEntry = FindDnsEntry( pPool,
+                                                            pUrl );
+    uint8_t isNewEntry = 1U;
+    size_t i;
+
+    if( pDnsEntry != NULL )
+    {
+        /* Keep the last used time, the background refresh doesn't count as a use. */
+        isNewEntry = 0U;
+    }
+    else if( pPool->dnsEntriesCount < ICE_CONTROLLER_WARM_POOL_DNS_CACHE_SIZE )
+    {
+        pDnsEntry = &pPool->dnsEntries[ pPool->dnsEntriesCount++ ];
+    }
+    else
+    {
+        pDnsEntry = &pPool->dnsEntries[ 0 ];
+        for( i = 1; i < pPool->dnsEntriesCount; i++ )
+        {
+            if( pPool->dnsEntries[ i ].lastUsedTimeMs < pDnsEntry->lastUsedTimeMs )
+            {
+                pDnsEntry = &pPool->dnsEntries[ i ];
+            }
+        }
+    }
+
+    if( isNewEntry != 0U )
+    {
+        strcpy( pDnsEntry->url,
+                pUrl );
+        pDnsEntry->lastUsedTimeMs = currentTimeMs;
+    }
+    CopyDnsResult( &pDnsEntry->transportAddress,
+                   pIceTransportAddress );
+    pDnsEntry->expireTimeMs = currentTimeMs + ICE_CONTROLLER_WARM_POOL_DNS_CACHE_TTL_MS;
+}
+
+#if ENABLE_ICE_WARM_POOL
+
+/* Refresh the local interface addresses, and close the sockets on the addresses that are gone. */
+static void RefreshLocalEndpoints( IceControllerWarmPool_t * pPool )
+{
+    IceEndpoint_t localEndpoints[ ICE_CONTROLLER_MAX_LOCAL_CANDIDATE_COUNT ];
+    size_t localEndpointsCount = ICE_CONTROLLER_MAX_LOCAL_CANDIDATE_COUNT;
+    size_t i;
+    size_t j;
+    uint8_t isFound;
+
+    IceControllerNet_GetLocalIpAddresses( localEndpoints,
+                                          &localEndpointsCount );
+
+    pthread_mutex_lock( &pPool->poolMutex );
+
+    memcpy( pPool->localEndpoints,
+            localEndpoints,
+            localEndpointsCount * sizeof( IceEndpoint_t ) );
+    pPool->localEndpointsCount = localEndpointsCount;
+
+    i = 0;
+    while( i < pPool->socketsCount )
+    {
+        isFound = 0U;
+        for( j = 0; j < localEndpointsCount; j++ )
+        {
+            if( IsSameAddress( &pPool->sockets[ i ].localEndpoint,
+                               &localEndpoints[ j ] ) != 0U )
+            {
+                isFound = 1U;
+                break;
+            }
+        }
+
+        if( isFound == 0U )
+        {
+            close( pPool->sockets[ i ].socketFd );
+            pPool->sockets[ i ] = pPool->sockets[ --pPool->socketsCount ];
+        }
+        else
+        {
+            i++;
+        }
+    }
+
+    pthread_mutex_unlock( &pPool->poolMutex );
+}
+
+/* Resolve the cached ICE server URLs again before they expire, drop the ones no session looked up for a while. */
+static void RefreshDnsEntries( IceControllerWarmPool_t * pPool )
+{
+    char url[ ICE_CONTROLLER_ICE_SERVER_URL_MAX_LENGTH ];
+    IceTransportAddress_t transportAddress = { 0 };
+    uint64_t currentTimeMs;
+    size_t i = 0;
+    uint8_t hasUrl = 1U;
+
+    while( hasUrl != 0U )
+    {
+        pthread_mutex_lock( &pPool->poolMutex );
+
+        currentTimeMs = GetCurrentTimeMs();
+        while( ( i < pPool->dnsEntriesCount ) &&
+               ( pPool->dnsEntries[ i ].lastUsedTimeMs + ICE_CONTROLLER_WARM_POOL_DNS_CACHE_TTL_MS < currentTimeMs ) )
+        {
+            pPool->dnsEntries[ i ] = pPool->dnsEntries[ --pPool->dnsEntriesCount ];
+        }
+
+        if( i < pPool->dnsEntriesCount )
+        {
+            strcpy( url,
+                    pPool->dnsEntries[ i ].url );
+            i++;
+        }
+        else
+        {
+            hasUrl = 0U;
+        }
+
+        pthread_mutex_unlock( &pPool->poolMutex );
+
+        /* Keep the cached result if the query fails, it's used till it expires. */
+        if( ( hasUrl != 0U ) &&
+            ( IceControllerNet_DnsLookUp( url,
+                                          &transportAddress ) == ICE_CONTROLLER_RESULT_OK ) )
+        {
+            pthread_mutex_lock( &pPool->poolMutex );
+            /* The entry might be replaced while resolving, only update it if it's still cached. */
+            if( FindDnsEntry( pPool,
+                              url ) != NULL )
+            {
+                StoreDnsEntry( pPool,
+                               url,
+                               &transportAddress,
+                               GetCurrentTimeMs() );
+            }
+            pthread_mutex_unlock( &pPool->poolMutex );
+        }
+    }
+}
+
+/* Find a local address with fewer sockets than ICE_CONTROLLER_WARM_POOL_SOCKET_NUM_PER_ENDPOINT. The lock must be held. */
+static uint8_t FindEndpointToRefill( IceControllerWarmPool_t * pPool,
+                                     IceEndpoint_t * pBindEndpoint )
+{
+    uint8_t isFound = 0U;
+    size_t socketsCount;
+    size_t i;
+    size_t j;
+
+    for( i = 0; ( i < pPool->localEndpointsCount ) && ( pPool->socketsCount < ICE_CONTROLLER_WARM_POOL_MAX_SOCKET_NUM ); i++ )
+    {
+        if( pPool->localEndpoints[ i ].transportAddress.family != STUN_ADDRESS_IPv4 )
+        {
+            continue;
+        }
+
+        socketsCount = 0;
+        for( j = 0; j < pPool->socketsCount; j++ )
+        {
+            if( IsSameAddress( &pPool->sockets[ j ].localEndpoint,
+                               &pPool->localEndpoints[ i ] ) != 0U )
+            {
+                socketsCount++;
+            }
+        }
+
+        if( socketsCount < ICE_CONTROLLER_WARM_POOL_SOCKET_NUM_PER_ENDPOINT )
+        {
+            memcpy( pBindEndpoint,
+                    &pPool->localEndpoints[ i ],
+                    sizeof( IceEndpoint_t ) );
+            isFound = 1U;
+            break;
+        }
+    }
+
+    return isFound;
+}
+
+static void * WarmPoolRefill_Task( void * pParameter )
+{
+    IceControllerWarmPool_t * pPool = ( IceControllerWarmPool_t * ) pParameter;
+    IceControllerWarmSocket_t warmSocket;
+    uint64_t nextRefreshTimeMs = GetCurrentTimeMs() + ICE_CONTROLLER_WARM_POOL_REFRESH_INTERVAL_MS;
+    struct timespec waitTime;
+    uint8_t needRefill;
+
+    for( ;; )
+    {
+        if( GetCurrentTimeMs() >= nextRefreshTimeMs )
+        {
+            RefreshLocalEndpoints( pPool );
+            RefreshDnsEntries( pPool );
+            nextRefreshTimeMs = GetCurrentTimeMs() + ICE_CONTROLLER_WARM_POOL_REFRESH_INTERVAL_MS;
+        }
+
+        pthread_mutex_lock( &pPool->poolMutex );
+        needRefill = FindEndpointToRefill( pPool,
+                                           &warmSocket.localEndpoint );
+        if( needRefill == 0U )
+        {
+            waitTime.tv_sec = ( time_t ) ( nextRefreshTimeMs / 1000 );
+            waitTime.tv_nsec = ( long ) ( ( nextRefreshTimeMs % 1000 ) * 1000000 );
+            ( void ) pthread_cond_timedwait( &pPool->poolCond,
+                                             &pPool->poolMutex,
+                                             &waitTime );
+        }
+        pthread_mutex_unlock( &pPool->poolMutex );
+
+        /* Create the socket without the lock, sessions keep taking the ready ones. */
+        if( needRefill != 0U )
+        {
+            if( IceControllerNet_OpenUdpSocket( warmSocket.localEndpoint.transportAddress.family,
+                                                &warmSocket.localEndpoint,
+                                                &warmSocket.socketFd,
+                                                &warmSocket.isUdpGsoSupported,
+                                                &warmSocket.isTxTimeEnabled ) == ICE_CONTROLLER_RESULT_OK )
+            {
+                pthread_mutex_lock( &pPool->poolMutex );
+                pPool->sockets[ pPool->socketsCount++ ] = warmSocket;
+                pthread_mutex_unlock( &pPool->poolMutex );
+            }
+            else
+            {
+                /* Retry at the next refresh, the interface might be going down. */
+                LogWarn( ( "Fail to create socket for ICE warm pool, retry in %d ms.", ICE_CONTROLLER_WARM_POOL_REFRESH_INTERVAL_MS ) );
+                pthread_mutex_lock( &pPool->poolMutex );
+                waitTime.tv_sec = ( time_t ) ( nextRefreshTimeMs / 1000 );
+                waitTime.tv_nsec = ( long ) ( ( nextRefreshTimeMs % 1000 ) * 1000000 );
+                while( ( pthread_cond_timedwait( &pPool->poolCond,
+                                                 &pPool->poolMutex,
+                                                 &waitTime ) == 0 ) &&
+                       ( GetCurrentTimeMs() < nextRefreshTimeMs ) )
+                {
+                    /* Ignore the wake-ups of taken sockets till the next refresh. */
+                }
+                pthread_mutex_unlock( &pPool->poolMutex );
+            }
+        }
+    }
+
+    return NULL;
+}
+
+static void InitWarmPool( void )
+{
+    pthread_condattr_t condAttr;
+    uint8_t isCondAttrInited = 0U;
+    int result = 0;
+
+    result = pthread_mutex_init( &warmPool.poolMutex,
+                                 NULL );
+
+    if( result == 0 )
+    {
+        result = pthread_condattr_init( &condAttr );
+        isCondAttrInited = result == 0 ? 1U : 0U;
+    }
+
+    if( result == 0 )
+    {
+        /* The refill task waits till the next refresh on monotonic clock. */
+        result = pthread_condattr_setclock( &condAttr,
+                                            CLOCK_MONOTONIC );
+    }
+
+    if( result == 0 )
+    {
+        result = pthread_cond_init( &warmPool.poolCond,
+                                    &condAttr );
+    }
+
+    if( isCondAttrInited != 0U )
+    {
+        ( void ) pthread_condattr_destroy( &condAttr );
+    }
+
+    if( result == 0 )
+    {
+        /* Gather the interfaces now, the first session needs them right away. */
+        warmPool.localEndpointsCount = ICE_CONTROLLER_MAX_LOCAL_CANDIDATE_COUNT;
+        IceControllerNet_GetLocalIpAddresses( warmPool.localEndpoints,
+                                              &warmPool.localEndpointsCount );
+
+        result = pthread_create( &warmPool.refillTid,
+                                 NULL,
+                                 WarmPoolRefill_Task,
+                                 &warmPool );
+    }
+
+    if( result == 0 )
+    {
+        warmPool.isRunning = 1U;
+    }
+    else
+    {
+        LogError( ( "Fail to start ICE warm pool, gather candidates on demand, result: %d", result ) );
+    }
+}
+
+#endif /* ENABLE_ICE_WARM_POOL */
+
+void IceControllerWarmPool_Init( void )
+{
+    #if ENABLE_ICE_WARM_POOL
+        ( void ) pthread_once( &warmPoolOnce,
+                               InitWarmPool );
+    #endif /* ENABLE_ICE_WARM_POOL */
+}
+
+void IceControllerWarmPool_GetLocalEndpoints( IceEndpoint_t * pLocalEndpoints,
+                                             size_t * pLocalEndpointsCount )
+{
+    if( warmPool.isRunning != 0U )
+    {
+        pthread_mutex_lock( &warmPool.poolMutex );
+        if( *pLocalEndpointsCount > warmPool.localEndpointsCount )
+        {
+            *pLocalEndpointsCount = warmPool.localEndpointsCount;
+        }
+        memcpy( pLocalEndpoints,
+                warmPool.localEndpoints,
+                *pLocalEndpointsCount * sizeof( IceEndpoint_t ) );
+        pthread_mutex_unlock( &warmPool.poolMutex );
+    }
+    else
+    {
+        IceControllerNet_GetLocalIpAddresses( pLocalEndpoints,
+                                              pLocalEndpointsCount );
+    }
+}
+
+uint8_t IceControllerWarmPool_TakeSocket( IceEndpoint_t * pBindEndpoint,
+                                          IceControllerWarmSocket_t * pWarmSocket )
+{
+    uint8_t isTaken = 0U;
+    size_t i;
+
+    if( ( warmPool.isRunning != 0U ) && ( pBindEndpoint != NULL ) && ( pWarmSocket != NULL ) )
+    {
+        pthread_mutex_lock( &warmPool.poolMutex );
+
+        for( i = 0; i < warmPool.socketsCount; i++ )
+        {
+            if( IsSameAddress( &warmPool.sockets[ i ].localEndpoint,
+                               pBindEndpoint ) != 0U )
+            {
+                *pWarmSocket = warmPool.sockets[ i ];
+                warmPool.sockets[ i ] = warmPool.sockets[ --warmPool.socketsCount ];
+                isTaken = 1U;
+
+                ( void ) pthread_cond_signal( &warmPool.poolCond );
+                break;
+            }
+        }
+
+        pthread_mutex_unlock( &warmPool.poolMutex );
+    }
+
+    if( isTaken != 0U )
+    {
+        pBindEndpoint->transportAddress.port = pWarmSocket->localEndpoint.transportAddress.port;
+    }
+
+    return isTaken;
+}
+
+IceControllerResult_t IceControllerWarmPool_DnsLookUp( char * pUrl,
+                                                       IceTransportAddress_t * pIceTransportAddress )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    IceControllerWarmDnsEntry_t * pDnsEntry;
+    uint64_t currentTimeMs = GetCurrentTimeMs();
+    uint8_t isCached = 0U;
+
+    if( ( pUrl == NULL ) || ( pIceTransportAddress == NULL ) )
+    {
+        ret = ICE_CONTROLLER_RESULT_BAD_PARAMETER;
+    }
+
+    if( ( ret == ICE_CONTROLLER_RESULT_OK ) && ( warmPool.isRunning != 0U ) )
+    {
+        pthread_mutex_lock( &warmPool.poolMutex );
+        pDnsEntry = FindDnsEntry( &warmPool,
+                                  pUrl );
+        if( ( pDnsEntry != NULL ) && ( currentTimeMs < pDnsEntry->expireTimeMs ) )
+        {
+            CopyDnsResult( pIceTransportAddress,
+                           &pDnsEntry->transportAddress );
+            pDnsEntry->lastUsedTimeMs = currentTimeMs;
+            isCached = 1U;
+        }
+        pthread_mutex_unlock( &warmPool.poolMutex );
+    }
+
+    if( ( ret == ICE_CONTROLLER_RESULT_OK ) && ( isCached == 0U ) )
+    {
+        ret = IceControllerNet_DnsLookUp( pUrl,
+                                          pIceTransportAddress );
+
+        if( ( ret == ICE_CONTROLLER_RESULT_OK ) &&
+            ( warmPool.isRunning != 0U ) &&
+            ( strlen( pUrl ) < ICE_CONTROLLER_ICE_SERVER_URL_MAX_LENGTH ) )
+        {
+            pthread_mutex_lock( &warmPool.poolMutex );
+            StoreDnsEntry( &warmPool,
+                           pUrl,
+                           pIceTransportAddress,
+                           currentTimeMs );
+            pthread_mutex_unlock( &warmPool.poolMutex );
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,416 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Run the ICE warm pool on the loopback interface with stand-ins for the DNS resolver and the STUN server.
+ * The test checks that a cached DNS result keeps the port of each ICE server, and that a socket taken from the pool
+ * gets the srflx mapping of the endpoint it's advertised with, so the session's binding request on it is valid.
+ * Usage: IceControllerWarmPoolTest */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "logging.h"
+#include "ice_controller.h"
+#include "ice_controller_private.h"
+
+#define WARM_POOL_TEST_POLL_INTERVAL_US ( 1000 )
+#define WARM_POOL_TEST_TIMEOUT_US ( 5000000 )
+#define WARM_POOL_TEST_RECV_TIMEOUT_SEC ( 1 )
+#define WARM_POOL_TEST_STUN_SERVER_URL "stun.test.invalid"
+#define WARM_POOL_TEST_STUN_PORT ( 3478 )
+#define WARM_POOL_TEST_TURN_PORT ( 5349 )
+/* The pool keeps a few sockets per address, take more than that to check the refill. */
+#define WARM_POOL_TEST_TAKE_NUM ( ICE_CONTROLLER_WARM_POOL_SOCKET_NUM_PER_ENDPOINT + 2 )
+
+/* The STUN binding messages are built by hand, the stand-in only answers with the mapped address. */
+#define WARM_POOL_TEST_STUN_HEADER_LENGTH ( 20 )
+#define WARM_POOL_TEST_STUN_BINDING_REQUEST ( 0x0001 )
+#define WARM_POOL_TEST_STUN_BINDING_SUCCESS_RESPONSE ( 0x0101 )
+#define WARM_POOL_TEST_STUN_MAGIC_COOKIE ( 0x2112A442 )
+#define WARM_POOL_TEST_STUN_TRANSACTION_ID_OFFSET ( 8 )
+#define WARM_POOL_TEST_STUN_TRANSACTION_ID_LENGTH ( 12 )
+#define WARM_POOL_TEST_STUN_ATTRIBUTE_XOR_MAPPED_ADDRESS ( 0x0020 )
+#define WARM_POOL_TEST_STUN_XOR_MAPPED_ADDRESS_LENGTH ( 8 )
+#define WARM_POOL_TEST_STUN_RESPONSE_LENGTH ( WARM_POOL_TEST_STUN_HEADER_LENGTH + 4 + WARM_POOL_TEST_STUN_XOR_MAPPED_ADDRESS_LENGTH )
+#define WARM_POOL_TEST_STUN_FAMILY_IPV4 ( 0x01 )
+
+static const uint8_t loopbackAddress[ STUN_IPV4_ADDRESS_SIZE ] = { 127, 0, 0, 1 };
+static uint32_t dnsQueryNum = 0;
+
+/* The stand-in DNS resolver, it fills the family and the address like the real one and counts the queries. */
+IceControllerResult_t IceControllerNet_DnsLookUp( char * pUrl,
+                                                  IceTransportAddress_t * pIceTransportAddress )
+{
+    ( void ) pUrl;
+
+    dnsQueryNum++;
+    pIceTransportAddress->family = STUN_ADDRESS_IPv4;
+    memcpy( pIceTransportAddress->address,
+            loopbackAddress,
+            STUN_IPV4_ADDRESS_SIZE );
+
+    return ICE_CONTROLLER_RESULT_OK;
+}
+
+/* Only the loopback interface, so the pool binds where the stand-in STUN server listens. */
+void IceControllerNet_GetLocalIpAddresses( IceEndpoint_t * pLocalIpAddresses,
+                                          size_t * pLocalIpAddressesNum )
+{
+    if( *pLocalIpAddressesNum > 0U )
+    {
+        memset( &pLocalIpAddresses[ 0 ], 0, sizeof( IceEndpoint_t ) );
+        pLocalIpAddresses[ 0 ].transportAddress.family = STUN_ADDRESS_IPv4;
+        memcpy( pLocalIpAddresses[ 0 ].transportAddress.address,
+                loopbackAddress,
+                STUN_IPV4_ADDRESS_SIZE );
+        *pLocalIpAddressesNum = 1U;
+    }
+}
+
+/* Same binding as the ICE controller, without the GSO and SO_TXTIME probes. */
+IceControllerResult_t IceControllerNet_OpenUdpSocket( uint16_t family,
+                                                     IceEndpoint_t * pBindEndpoint,
+                                                     int * pSocketFd,
+                                                     uint8_t * pIsUdpGsoSupported,
+                                                     uint8_t * pIsTxTimeEnabled )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+    struct sockaddr_in ipv4Address;
+    socklen_t addressLength = sizeof( ipv4Address );
+    struct timeval tv = {
+        .tv_sec = WARM_POOL_TEST_RECV_TIMEOUT_SEC,
+        .tv_usec = 0,
+    };
+
+    *pIsUdpGsoSupported = 0U;
+    *pIsTxTimeEnabled = 0U;
+
+    if( family != STUN_ADDRESS_IPv4 )
+    {
+        ret = ICE_CONTROLLER_RESULT_IPV6_NOT_SUPPORT;
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        *pSocketFd = socket( AF_INET, SOCK_DGRAM, 0 );
+        if( *pSocketFd == -1 )
+        {
+            ret = ICE_CONTROLLER_RESULT_FAIL_SOCKET_CREATE;
+        }
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        memset( &ipv4Address, 0, sizeof( ipv4Address ) );
+        ipv4Address.sin_family = AF_INET;
+        memcpy( &ipv4Address.sin_addr, pBindEndpoint->transportAddress.address, STUN_IPV4_ADDRESS_SIZE );
+        if( ( bind( *pSocketFd, ( struct sockaddr * ) &ipv4Address, sizeof( ipv4Address ) ) < 0 ) ||
+            ( getsockname( *pSocketFd, ( struct sockaddr * ) &ipv4Address, &addressLength ) < 0 ) )
+        {
+            ( void ) close( *pSocketFd );
+            ret = ICE_CONTROLLER_RESULT_FAIL_SOCKET_BIND;
+        }
+    }
+
+    if( ret == ICE_CONTROLLER_RESULT_OK )
+    {
+        pBindEndpoint->transportAddress.port = ntohs( ipv4Address.sin_port );
+        ( void ) setsockopt( *pSocketFd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof( tv ) );
+    }
+
+    return ret;
+}
+
+static void WriteUint16( uint8_t * pBuffer,
+                         uint16_t value )
+{
+    pBuffer[ 0 ] = ( uint8_t ) ( value >> 8 );
+    pBuffer[ 1 ] = ( uint8_t ) value;
+}
+
+static void WriteUint32( uint8_t * pBuffer,
+                         uint32_t value )
+{
+    WriteUint16( pBuffer, ( uint16_t ) ( value >> 16 ) );
+    WriteUint16( &pBuffer[ 2 ], ( uint16_t ) value );
+}
+
+static uint16_t ReadUint16( const uint8_t * pBuffer )
+{
+    return ( uint16_t ) ( ( pBuffer[ 0 ] << 8 ) | pBuffer[ 1 ] );
+}
+
+/* The stand-in STUN server, answer one binding request with the source address it sees. */
+static int RespondBindingRequest( int serverSocketFd )
+{
+    int ret = 0;
+    uint8_t buffer[ WARM_POOL_TEST_STUN_RESPONSE_LENGTH ];
+    struct sockaddr_in sourceAddress;
+    socklen_t sourceAddressLength = sizeof( sourceAddress );
+    ssize_t recvLength;
+    uint8_t * pAttribute = &buffer[ WARM_POOL_TEST_STUN_HEADER_LENGTH ];
+
+    recvLength = recvfrom( serverSocketFd,
+                           buffer,
+                           sizeof( buffer ),
+                           0,
+                           ( struct sockaddr * ) &sourceAddress,
+                           &sourceAddressLength );
+    if( ( recvLength != WARM_POOL_TEST_STUN_HEADER_LENGTH ) ||
+        ( ReadUint16( buffer ) != WARM_POOL_TEST_STUN_BINDING_REQUEST ) )
+    {
+        printf( "STUN server got no binding request, length: %ld, errno: %s\n", recvLength, strerror( errno ) );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        /* Keep the cookie and the transaction ID of the request. */
+        WriteUint16( buffer, WARM_POOL_TEST_STUN_BINDING_SUCCESS_RESPONSE );
+        WriteUint16( &buffer[ 2 ], WARM_POOL_TEST_STUN_RESPONSE_LENGTH - WARM_POOL_TEST_STUN_HEADER_LENGTH );
+        WriteUint16( pAttribute, WARM_POOL_TEST_STUN_ATTRIBUTE_XOR_MAPPED_ADDRESS );
+        WriteUint16( &pAttribute[ 2 ], WARM_POOL_TEST_STUN_XOR_MAPPED_ADDRESS_LENGTH );
+        pAttribute[ 4 ] = 0U;
+        pAttribute[ 5 ] = WARM_POOL_TEST_STUN_FAMILY_IPV4;
+        WriteUint16( &pAttribute[ 6 ], ntohs( sourceAddress.sin_port ) ^ ( uint16_t ) ( WARM_POOL_TEST_STUN_MAGIC_COOKIE >> 16 ) );
+        WriteUint32( &pAttribute[ 8 ], ntohl( sourceAddress.sin_addr.s_addr ) ^ WARM_POOL_TEST_STUN_MAGIC_COOKIE );
+
+        if( sendto( serverSocketFd,
+                    buffer,
+                    sizeof( buffer ),
+                    0,
+                    ( struct sockaddr * ) &sourceAddress,
+                    sourceAddressLength ) != sizeof( buffer ) )
+        {
+            printf( "STUN server fails to respond, errno: %s\n", strerror( errno ) );
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Send a binding request from the warm socket, and check the mapped address against the endpoint
+ * the pool reports for the socket. */
+static int CheckSrflxMapping( int socketFd,
+                              const IceEndpoint_t * pBindEndpoint,
+                              int serverSocketFd,
+                              const struct sockaddr_in * pServerAddress,
+                              uint8_t transactionIdSeed )
+{
+    int ret = 0;
+    uint8_t request[ WARM_POOL_TEST_STUN_HEADER_LENGTH ];
+    uint8_t response[ WARM_POOL_TEST_STUN_RESPONSE_LENGTH ];
+    uint8_t * pAttribute = &response[ WARM_POOL_TEST_STUN_HEADER_LENGTH ];
+    uint8_t mappedAddress[ STUN_IPV4_ADDRESS_SIZE ];
+    uint16_t mappedPort;
+    uint32_t address;
+
+    memset( request, 0, sizeof( request ) );
+    WriteUint16( request, WARM_POOL_TEST_STUN_BINDING_REQUEST );
+    WriteUint32( &request[ 4 ], WARM_POOL_TEST_STUN_MAGIC_COOKIE );
+    memset( &request[ WARM_POOL_TEST_STUN_TRANSACTION_ID_OFFSET ], transactionIdSeed, WARM_POOL_TEST_STUN_TRANSACTION_ID_LENGTH );
+
+    if( sendto( socketFd,
+                request,
+                sizeof( request ),
+                0,
+                ( const struct sockaddr * ) pServerAddress,
+                sizeof( struct sockaddr_in ) ) != sizeof( request ) )
+    {
+        printf( "Fail to send binding request from the warm socket, errno: %s\n", strerror( errno ) );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        ret = RespondBindingRequest( serverSocketFd );
+    }
+
+    if( ( ret == 0 ) &&
+        ( ( recv( socketFd, response, sizeof( response ), 0 ) != sizeof( response ) ) ||
+          ( ReadUint16( response ) != WARM_POOL_TEST_STUN_BINDING_SUCCESS_RESPONSE ) ||
+          ( memcmp( &response[ WARM_POOL_TEST_STUN_TRANSACTION_ID_OFFSET ],
+                    &request[ WARM_POOL_TEST_STUN_TRANSACTION_ID_OFFSET ],
+                    WARM_POOL_TEST_STUN_TRANSACTION_ID_LENGTH ) != 0 ) ||
+          ( ReadUint16( pAttribute ) != WARM_POOL_TEST_STUN_ATTRIBUTE_XOR_MAPPED_ADDRESS ) ) )
+    {
+        printf( "The warm socket gets no binding response\n" );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        mappedPort = ReadUint16( &pAttribute[ 6 ] ) ^ ( uint16_t ) ( WARM_POOL_TEST_STUN_MAGIC_COOKIE >> 16 );
+        address = ( ( uint32_t ) ReadUint16( &pAttribute[ 8 ] ) << 16 | ReadUint16( &pAttribute[ 10 ] ) ) ^ WARM_POOL_TEST_STUN_MAGIC_COOKIE;
+        address = htonl( address );
+        memcpy( mappedAddress, &address, sizeof( mappedAddress ) );
+
+        if( ( mappedPort != pBindEndpoint->transportAddress.port ) ||
+            ( memcmp( mappedAddress, pBindEndpoint->transportAddress.address, STUN_IPV4_ADDRESS_SIZE ) != 0 ) )
+        {
+            printf( "The srflx mapping port %u doesn't match the warm socket endpoint port %u\n",
+                    mappedPort, pBindEndpoint->transportAddress.port );
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Two ICE servers behind the same URL share the DNS result, each keeps its own port. */
+static int TestDnsCache( void )
+{
+    int ret = 0;
+    IceTransportAddress_t stunAddress;
+    IceTransportAddress_t turnAddress;
+    char url[] = WARM_POOL_TEST_STUN_SERVER_URL;
+    uint32_t queryNumBefore = dnsQueryNum;
+
+    memset( &stunAddress, 0, sizeof( stunAddress ) );
+    memset( &turnAddress, 0, sizeof( turnAddress ) );
+    stunAddress.port = WARM_POOL_TEST_STUN_PORT;
+    turnAddress.port = WARM_POOL_TEST_TURN_PORT;
+
+    if( ( IceControllerWarmPool_DnsLookUp( url, &stunAddress ) != ICE_CONTROLLER_RESULT_OK ) ||
+        ( IceControllerWarmPool_DnsLookUp( url, &turnAddress ) != ICE_CONTROLLER_RESULT_OK ) )
+    {
+        printf( "Fail to look up %s\n", url );
+        ret = -1;
+    }
+    else if( dnsQueryNum != queryNumBefore + 1U )
+    {
+        printf( "The second lookup isn't answered from the cache, queries: %u\n", dnsQueryNum - queryNumBefore );
+        ret = -1;
+    }
+    else if( ( stunAddress.port != WARM_POOL_TEST_STUN_PORT ) ||
+             ( turnAddress.port != WARM_POOL_TEST_TURN_PORT ) )
+    {
+        printf( "The cached DNS result changes the port, STUN port: %u, TURN port: %u\n", stunAddress.port, turnAddress.port );
+        ret = -1;
+    }
+    else if( ( turnAddress.family != STUN_ADDRESS_IPv4 ) ||
+             ( memcmp( turnAddress.address, loopbackAddress, STUN_IPV4_ADDRESS_SIZE ) != 0 ) )
+    {
+        printf( "The cached DNS result has a wrong address\n" );
+        ret = -1;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return ret;
+}
+
+/* Every socket taken from the pool, including the refilled ones, is mapped to the endpoint it's advertised with. */
+static int TestSrflxOnWarmSocket( void )
+{
+    int ret = 0;
+    int serverSocketFd;
+    struct sockaddr_in serverAddress;
+    socklen_t serverAddressLength = sizeof( serverAddress );
+    struct timeval tv = {
+        .tv_sec = WARM_POOL_TEST_RECV_TIMEOUT_SEC,
+        .tv_usec = 0,
+    };
+    IceEndpoint_t bindEndpoint;
+    IceControllerWarmSocket_t warmSocket;
+    uint32_t waitTimeUs;
+    uint8_t i;
+
+    serverSocketFd = socket( AF_INET, SOCK_DGRAM, 0 );
+    memset( &serverAddress, 0, sizeof( serverAddress ) );
+    serverAddress.sin_family = AF_INET;
+    memcpy( &serverAddress.sin_addr, loopbackAddress, STUN_IPV4_ADDRESS_SIZE );
+    if( ( serverSocketFd == -1 ) ||
+        ( bind( serverSocketFd, ( struct sockaddr * ) &serverAddress, sizeof( serverAddress ) ) < 0 ) ||
+        ( getsockname( serverSocketFd, ( struct sockaddr * ) &serverAddress, &serverAddressLength ) < 0 ) )
+    {
+        printf( "Fail to start the STUN server, errno: %s\n", strerror( errno ) );
+        ret = -1;
+    }
+    else
+    {
+        ( void ) setsockopt( serverSocketFd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof( tv ) );
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < WARM_POOL_TEST_TAKE_NUM ); i++ )
+    {
+        memset( &bindEndpoint, 0, sizeof( bindEndpoint ) );
+        bindEndpoint.transportAddress.family = STUN_ADDRESS_IPv4;
+        memcpy( bindEndpoint.transportAddress.address, loopbackAddress, STUN_IPV4_ADDRESS_SIZE );
+
+        for( waitTimeUs = 0; waitTimeUs < WARM_POOL_TEST_TIMEOUT_US; waitTimeUs += WARM_POOL_TEST_POLL_INTERVAL_US )
+        {
+            if( IceControllerWarmPool_TakeSocket( &bindEndpoint,
+                                                  &warmSocket ) != 0U )
+            {
+                break;
+            }
+            ( void ) usleep( WARM_POOL_TEST_POLL_INTERVAL_US );
+        }
+
+        if( waitTimeUs >= WARM_POOL_TEST_TIMEOUT_US )
+        {
+            printf( "No warm socket after taking %u\n", i );
+            ret = -1;
+        }
+        else
+        {
+            ret = CheckSrflxMapping( warmSocket.socketFd,
+                                     &bindEndpoint,
+                                     serverSocketFd,
+                                     &serverAddress,
+                                     i );
+            ( void ) close( warmSocket.socketFd );
+        }
+    }
+
+    if( serverSocketFd != -1 )
+    {
+        ( void ) close( serverSocketFd );
+    }
+
+    return ret;
+}
+
+int main( void )
+{
+    int ret = 0;
+
+    IceControllerWarmPool_Init();
+
+    if( ret == 0 )
+    {
+        ret = TestDnsCache();
+        printf( "DNS cache: %s\n", ret == 0 ? "PASS" : "FAIL" );
+    }
+
+    if( ret == 0 )
+    {
+        ret = TestSrflxOnWarmSocket();
+        printf( "Srflx on warm socket: %s\n", ret == 0 ? "PASS" : "FAIL" );
+    }
+
+    return ret;
+}
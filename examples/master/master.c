@@ -21,6 +21,10 @@
 AppContext_t appContext;
 AppMediaSourcesContext_t appMediaSourceContext;
 
+/* Frames are packetized once and shared by all viewers. Video and audio are delivered by different threads. */
+static PeerConnectionPacketizedFrame_t packetizedVideoFrame;
+static PeerConnectionPacketizedFrame_t packetizedAudioFrame;
+
 static int32_t InitTransceiver( void * pMediaCtx, TransceiverTrackKind_t trackKind, Transceiver_t * pTranceiver );
 static int32_t OnMediaSinkHook( void * pCustom,
                                 MediaFrame_t * pFrame );
@@ -68,7 +72,12 @@ static int32_t OnMediaSinkHook( void * pCustom,
     PeerConnectionResult_t peerConnectionResult;
     Transceiver_t * pTransceiver = NULL;
     PeerConnectionFrame_t peerConnectionFrame;
-    int i;
+    PeerConnectionPacketizedFrame_t * pPacketizedFrame = NULL;
+    PeerConnectionResult_t packetizeResult = PEER_CONNECTION_RESULT_OK;
+    uint8_t isPacketized = 0U;
+    uint32_t i;
+    uint32_t appSessionCount;
+    AppSession_t * pAppSession;
 
     if( ( pAppContext == NULL ) || ( pFrame == NULL ) )
     {
@@ -83,15 +92,20 @@ static int32_t OnMediaSinkHook( void * pCustom,
         peerConnectionFrame.pData = pFrame->pData;
         peerConnectionFrame.dataLength = pFrame->size;
 
-        for( i = 0; i < AWS_MAX_VIEWER_NUM; i++ )
+        appSessionCount = AppCommon_GetAppSessionCount( pAppContext );
+        for( i = 0; i < appSessionCount; i++ )
         {
+            pAppSession = pAppContext->ppAppSessions[ i ];
+
             if( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO )
             {
-                pTransceiver = &pAppContext->appSessions[ i ].transceivers[ DEMO_TRANSCEIVER_MEDIA_INDEX_VIDEO ];
+                pTransceiver = &pAppSession->transceivers[ DEMO_TRANSCEIVER_MEDIA_INDEX_VIDEO ];
+                pPacketizedFrame = &packetizedVideoFrame;
             }
             else if( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_AUDIO )
             {
-                pTransceiver = &pAppContext->appSessions[ i ].transceivers[ DEMO_TRANSCEIVER_MEDIA_INDEX_AUDIO ];
+                pTransceiver = &pAppSession->transceivers[ DEMO_TRANSCEIVER_MEDIA_INDEX_AUDIO ];
+                pPacketizedFrame = &packetizedAudioFrame;
             }
             else
             {
@@ -100,11 +114,36 @@ static int32_t OnMediaSinkHook( void * pCustom,
                 break;
             }
 
-            if( pAppContext->appSessions[ i ].peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
+            if( pAppSession->peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
             {
-                peerConnectionResult = PeerConnection_WriteFrame( &pAppContext->appSessions[ i ].peerConnectionSession,
-                                                                  pTransceiver,
-                                                                  &peerConnectionFrame );
+                if( isPacketized == 0U )
+                {
+                    /* Packetize the frame at the first ready session, the rest of sessions only apply their own RTP headers and SRTP. */
+                    isPacketized = 1U;
+                    packetizeResult = PeerConnection_PacketizeFrame( pTransceiver,
+                                                                     &peerConnectionFrame,
+                                                                     pPacketizedFrame );
+                    if( packetizeResult != PEER_CONNECTION_RESULT_OK )
+                    {
+                        LogWarn( ( "Fail to packetize %s frame, write frame per session instead, result: %d", ( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO ) ? "video" : "audio",
+                                   packetizeResult ) );
+                    }
+                }
+
+                if( packetizeResult == PEER_CONNECTION_RESULT_OK )
+                {
+                    peerConnectionResult = PeerConnection_WritePacketizedFrame( &pAppSession->peerConnectionSession,
+                                                                                pTransceiver,
+                                                                                pPacketizedFrame );
+                }
+
+                if( ( packetizeResult != PEER_CONNECTION_RESULT_OK ) ||
+                    ( peerConnectionResult == PEER_CONNECTION_RESULT_PACKETIZED_FRAME_CODEC_MISMATCH ) )
+                {
+                    peerConnectionResult = PeerConnection_WriteFrame( &pAppSession->peerConnectionSession,
+                                                                      pTransceiver,
+                                                                      &peerConnectionFrame );
+                }
 
                 if( peerConnectionResult != PEER_CONNECTION_RESULT_OK )
                 {
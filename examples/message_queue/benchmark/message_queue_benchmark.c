@@ -0,0 +1,252 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Measure the message queue throughput with multiple producer threads and one consumer thread,
+ * the same pattern as the peer connection session request queue.
+ * Usage: MessageQueueBenchmark [producer num] [message num per producer] [queue depth] */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "logging.h"
+#include "message_queue.h"
+
+#define MESSAGE_QUEUE_BENCHMARK_QUEUE_NAME "/MessageQueueBenchmark"
+#define MESSAGE_QUEUE_BENCHMARK_DEFAULT_PRODUCER_NUM ( 4 )
+#define MESSAGE_QUEUE_BENCHMARK_DEFAULT_MESSAGE_NUM ( 250000 )
+/* Same as the peer connection request queue, it's also the default limit of fs.mqueue.msg_max. */
+#define MESSAGE_QUEUE_BENCHMARK_DEFAULT_QUEUE_DEPTH ( 10 )
+#define MESSAGE_QUEUE_BENCHMARK_MAX_PRODUCER_NUM ( 64 )
+#define MESSAGE_QUEUE_BENCHMARK_PAYLOAD_LENGTH ( 128 )
+
+typedef struct MessageQueueBenchmarkMessage
+{
+    uint32_t producerIndex;
+    uint32_t sequence;
+    uint8_t payload[ MESSAGE_QUEUE_BENCHMARK_PAYLOAD_LENGTH ];
+} MessageQueueBenchmarkMessage_t;
+
+typedef struct MessageQueueBenchmarkProducer
+{
+    pthread_t thread;
+    MessageQueueHandler_t * pMessageQueue;
+    uint32_t producerIndex;
+    uint32_t messageNum;
+    uint32_t fullCount;
+    uint32_t errorCount;
+} MessageQueueBenchmarkProducer_t;
+
+static uint64_t GetMonotonicTimeNs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000000ULL + ( uint64_t ) now.tv_nsec;
+}
+
+static void * ProducerTask( void * pParameter )
+{
+    MessageQueueBenchmarkProducer_t * pProducer = ( MessageQueueBenchmarkProducer_t * ) pParameter;
+    MessageQueueBenchmarkMessage_t message;
+    MessageQueueResult_t retMessageQueue;
+    uint32_t i;
+
+    memset( &message, 0, sizeof( message ) );
+    message.producerIndex = pProducer->producerIndex;
+
+    for( i = 0; i < pProducer->messageNum; i++ )
+    {
+        message.sequence = i;
+
+        /* Check the queue before sending like the peer connection session does, retry instead of dropping. */
+        for( ;; )
+        {
+            retMessageQueue = MessageQueue_IsFull( pProducer->pMessageQueue );
+            if( retMessageQueue == MESSAGE_QUEUE_RESULT_MQ_IS_NOT_FULL )
+            {
+                retMessageQueue = MessageQueue_Send( pProducer->pMessageQueue,
+                                                     &message,
+                                                     sizeof( message ) );
+            }
+
+            if( retMessageQueue != MESSAGE_QUEUE_RESULT_MQ_IS_FULL )
+            {
+                break;
+            }
+
+            pProducer->fullCount++;
+            ( void ) sched_yield();
+        }
+
+        if( retMessageQueue != MESSAGE_QUEUE_RESULT_OK )
+        {
+            pProducer->errorCount++;
+        }
+    }
+
+    return NULL;
+}
+
+int main( int argc,
+          char * argv[] )
+{
+    int ret = 0;
+    MessageQueueHandler_t messageQueue;
+    MessageQueueResult_t retMessageQueue;
+    MessageQueueBenchmarkProducer_t producers[ MESSAGE_QUEUE_BENCHMARK_MAX_PRODUCER_NUM ];
+    uint32_t nextSequences[ MESSAGE_QUEUE_BENCHMARK_MAX_PRODUCER_NUM ];
+    MessageQueueBenchmarkMessage_t message;
+    size_t messageLength;
+    uint32_t producerNum = MESSAGE_QUEUE_BENCHMARK_DEFAULT_PRODUCER_NUM;
+    uint32_t messageNum = MESSAGE_QUEUE_BENCHMARK_DEFAULT_MESSAGE_NUM;
+    uint32_t queueDepth = MESSAGE_QUEUE_BENCHMARK_DEFAULT_QUEUE_DEPTH;
+    uint32_t receivedNum = 0;
+    uint32_t outOfOrderNum = 0;
+    uint32_t fullCount = 0;
+    uint32_t errorCount = 0;
+    uint64_t startTimeNs;
+    uint64_t elapsedNs;
+    uint32_t i;
+
+    if( argc > 1 )
+    {
+        producerNum = ( uint32_t ) strtoul( argv[ 1 ], NULL, 10 );
+    }
+    if( argc > 2 )
+    {
+        messageNum = ( uint32_t ) strtoul( argv[ 2 ], NULL, 10 );
+    }
+    if( argc > 3 )
+    {
+        queueDepth = ( uint32_t ) strtoul( argv[ 3 ], NULL, 10 );
+    }
+
+    if( ( producerNum == 0 ) || ( producerNum > MESSAGE_QUEUE_BENCHMARK_MAX_PRODUCER_NUM ) ||
+        ( messageNum == 0 ) || ( queueDepth == 0 ) )
+    {
+        LogError( ( "Invalid input, producer num: %u (1 ~ %d), message num: %u, queue depth: %u",
+                    producerNum,
+                    MESSAGE_QUEUE_BENCHMARK_MAX_PRODUCER_NUM,
+                    messageNum,
+                    queueDepth ) );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        MessageQueue_Destroy( NULL,
+                              MESSAGE_QUEUE_BENCHMARK_QUEUE_NAME );
+
+        retMessageQueue = MessageQueue_Create( &messageQueue,
+                                               MESSAGE_QUEUE_BENCHMARK_QUEUE_NAME,
+                                               sizeof( MessageQueueBenchmarkMessage_t ),
+                                               queueDepth );
+        if( retMessageQueue != MESSAGE_QUEUE_RESULT_OK )
+        {
+            LogError( ( "Fail to create message queue, result: %d", retMessageQueue ) );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        memset( producers, 0, sizeof( producers ) );
+        memset( nextSequences, 0, sizeof( nextSequences ) );
+        startTimeNs = GetMonotonicTimeNs();
+
+        for( i = 0; i < producerNum; i++ )
+        {
+            producers[ i ].pMessageQueue = &messageQueue;
+            producers[ i ].producerIndex = i;
+            producers[ i ].messageNum = messageNum;
+            if( pthread_create( &producers[ i ].thread, NULL, ProducerTask, &producers[ i ] ) != 0 )
+            {
+                LogError( ( "Fail to create producer thread %u", i ) );
+                ret = -1;
+                break;
+            }
+        }
+
+        /* Only wait for the messages of the producers that started. */
+        producerNum = i;
+
+        while( receivedNum < producerNum * messageNum )
+        {
+            messageLength = sizeof( message );
+            retMessageQueue = MessageQueue_Recv( &messageQueue,
+                                                 &message,
+                                                 &messageLength );
+            if( retMessageQueue != MESSAGE_QUEUE_RESULT_OK )
+            {
+                LogError( ( "Fail to receive message, result: %d", retMessageQueue ) );
+                ret = -1;
+                break;
+            }
+
+            /* Each producer's messages must come out in order. */
+            if( ( message.producerIndex >= producerNum ) ||
+                ( message.sequence != nextSequences[ message.producerIndex ] ) )
+            {
+                outOfOrderNum++;
+            }
+            else
+            {
+                nextSequences[ message.producerIndex ]++;
+            }
+            receivedNum++;
+        }
+
+        elapsedNs = GetMonotonicTimeNs() - startTimeNs;
+
+        for( i = 0; i < producerNum; i++ )
+        {
+            ( void ) pthread_join( producers[ i ].thread, NULL );
+            fullCount += producers[ i ].fullCount;
+            errorCount += producers[ i ].errorCount;
+        }
+
+        MessageQueue_Destroy( &messageQueue,
+                              MESSAGE_QUEUE_BENCHMARK_QUEUE_NAME );
+
+        printf( "Backend: %s\n", MESSAGE_QUEUE_USE_POSIX_MQUEUE ? "POSIX mqueue" : "in-process ring" );
+        printf( "Producers: %u, messages per producer: %u, queue depth: %u, message length: %lu\n",
+                producerNum,
+                messageNum,
+                queueDepth,
+                sizeof( MessageQueueBenchmarkMessage_t ) );
+        printf( "Received: %u messages in %.3f ms, %.0f messages/s, %.1f ns/message\n",
+                receivedNum,
+                ( double ) elapsedNs / 1000000.0,
+                ( double ) receivedNum * 1000000000.0 / ( double ) elapsedNs,
+                ( double ) elapsedNs / ( double ) ( receivedNum != 0 ? receivedNum : 1 ) );
+        printf( "Out of order: %u, send errors: %u, queue full retries: %u\n",
+                outOfOrderNum,
+                errorCount,
+                fullCount );
+
+        if( ( outOfOrderNum != 0 ) || ( errorCount != 0 ) )
+        {
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
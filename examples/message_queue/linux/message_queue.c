@@ -14,32 +14,208 @@
  * limitations under the License.
  */
 
-#include <fcntl.h>
+#include "message_queue.h"
+
+/* In-process ring backend, the messages never leave the process and no system wide queue limit applies. */
+#if !MESSAGE_QUEUE_USE_POSIX_MQUEUE
+
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
 #include "logging.h"
-#include "message_queue.h"
 
-void MessageQueue_Destroy( MessageQueueHandler_t * pMessageQueueHandler,
-                           const char * pQueueName )
+/* Every slot starts with this header, followed by the message. */
+typedef struct MessageQueueSlot
 {
-    if( pMessageQueueHandler != NULL )
+    /* Equals the position + 1 once the message at that position is published,
+     * and the position + slot number once the slot is free for the next round. */
+    atomic_size_t sequence;
+    size_t messageLength;
+} MessageQueueSlot_t;
+
+#define MESSAGE_QUEUE_SLOT_ALIGNMENT ( sizeof( MessageQueueSlot_t ) )
+#define MESSAGE_QUEUE_GET_SLOT( pHandler, position ) ( ( MessageQueueSlot_t * ) ( ( pHandler )->pSlots + ( ( position ) % ( pHandler )->slotNum ) * ( pHandler )->slotSize ) )
+
+static void WakeUpConsumer( MessageQueueHandler_t * pMessageQueueHandler )
+{
+    uint64_t wakeUp = 1;
+    uint8_t needWakeUp = 0;
+
+    if( atomic_load( &pMessageQueueHandler->isPolled ) != 0U )
+    {
+        needWakeUp = 1;
+    }
+    else
     {
-        if( mq_close( pMessageQueueHandler->messageQueue ) == -1 )
+        /* The message is published and the flag is checked both in sequentially consistent order, same as the consumer
+         * raises the flag and checks the ring, so either the consumer sees the message or this producer sees the flag.
+         * Only one producer wakes up a waiting consumer. */
+        if( ( atomic_load( &pMessageQueueHandler->isConsumerWaiting ) != 0U ) &&
+            ( atomic_exchange( &pMessageQueueHandler->isConsumerWaiting, 0U ) != 0U ) )
         {
-            LogError( ( "mq_close error, errno: %s, queue name: %s", strerror( errno ), pMessageQueueHandler->pQueueName ) );
+            needWakeUp = 1;
         }
+    }
 
-        if( mq_unlink( pMessageQueueHandler->pQueueName ) == -1 )
+    if( needWakeUp != 0U )
+    {
+        if( write( pMessageQueueHandler->eventFd, &wakeUp, sizeof( wakeUp ) ) != sizeof( wakeUp ) )
         {
-            LogError( ( "mq_unlink error, errno: %s, queue name: %s", strerror( errno ), pMessageQueueHandler->pQueueName ) );
+            LogError( ( "Fail to wake up message queue consumer, errno: %s, queue name: %s", strerror( errno ), pMessageQueueHandler->pQueueName ) );
         }
     }
-    else
+}
+
+static void WaitForWakeUp( MessageQueueHandler_t * pMessageQueueHandler )
+{
+    uint64_t wakeUp;
+
+    if( ( read( pMessageQueueHandler->eventFd, &wakeUp, sizeof( wakeUp ) ) != sizeof( wakeUp ) ) &&
+        ( errno != EINTR ) )
     {
-        /* Remove the queue with same name. */
-        mq_unlink( pQueueName );
+        LogError( ( "Fail to wait message queue, errno: %s, queue name: %s", strerror( errno ), pMessageQueueHandler->pQueueName ) );
+    }
+}
+
+static uint8_t PopMessage( MessageQueueHandler_t * pMessageQueueHandler,
+                           void * pMessage,
+                           size_t * pMessageLength )
+{
+    uint8_t isPopped = 0;
+    size_t position;
+    size_t sequence;
+    MessageQueueSlot_t * pSlot;
+
+    /* Claim the published slot at the dequeue position, a drain with MessageQueue_TryRecv() might race the consumer. */
+    position = atomic_load_explicit( &pMessageQueueHandler->dequeuePosition, memory_order_relaxed );
+    for( ;; )
+    {
+        pSlot = MESSAGE_QUEUE_GET_SLOT( pMessageQueueHandler, position );
+        sequence = atomic_load( &pSlot->sequence );
+
+        if( sequence == position + 1 )
+        {
+            if( atomic_compare_exchange_weak_explicit( &pMessageQueueHandler->dequeuePosition,
+                                                       &position,
+                                                       position + 1,
+                                                       memory_order_relaxed,
+                                                       memory_order_relaxed ) )
+            {
+                isPopped = 1;
+                break;
+            }
+        }
+        else if( ( intptr_t )( sequence - ( position + 1 ) ) < 0 )
+        {
+            /* The message at this position is not published yet. */
+            break;
+        }
+        else
+        {
+            /* A drain took this position, retry from the latest one. */
+            position = atomic_load_explicit( &pMessageQueueHandler->dequeuePosition, memory_order_relaxed );
+        }
+    }
+
+    if( isPopped != 0U )
+    {
+        /* The producers don't reuse the slot till its sequence moves to the next round. */
+        memcpy( pMessage, pSlot + 1, pSlot->messageLength );
+        *pMessageLength = pSlot->messageLength;
+
+        /* Hand the slot over to the producers of the next round. */
+        atomic_store_explicit( &pSlot->sequence, position + pMessageQueueHandler->slotNum, memory_order_release );
+    }
+
+    return isPopped;
+}
+
+/* Take the eventfd count of one message of a polled queue without blocking, returns 0 if there is none. */
+static uint8_t TryTakeWakeUp( MessageQueueHandler_t * pMessageQueueHandler )
+{
+    uint8_t isTaken = 0;
+    struct pollfd pollFd = {
+        .fd = pMessageQueueHandler->eventFd,
+        .events = POLLIN,
+    };
+
+    if( poll( &pollFd, 1, 0 ) == 1 )
+    {
+        WaitForWakeUp( pMessageQueueHandler );
+        isTaken = 1;
+    }
+
+    return isTaken;
+}
+
+static void WaitForMessage( MessageQueueHandler_t * pMessageQueueHandler,
+                            void * pMessage,
+                            size_t * pMessageLength )
+{
+    for( ;; )
+    {
+        if( atomic_load( &pMessageQueueHandler->isPolled ) != 0U )
+        {
+            /* Every message carries one eventfd count, take the one of this message.
+             * The count is written after publishing, but a producer that claimed an earlier slot
+             * might still be copying its message, yield till it's done. */
+            WaitForWakeUp( pMessageQueueHandler );
+            while( PopMessage( pMessageQueueHandler, pMessage, pMessageLength ) == 0U )
+            {
+                ( void ) sched_yield();
+            }
+            break;
+        }
+
+        if( PopMessage( pMessageQueueHandler, pMessage, pMessageLength ) != 0U )
+        {
+            break;
+        }
+
+        /* Let the producers run once before sleeping, under load the next message is
+         * usually in the ring by then and the eventfd round trip is skipped. */
+        ( void ) sched_yield();
+        if( PopMessage( pMessageQueueHandler, pMessage, pMessageLength ) != 0U )
+        {
+            break;
+        }
+
+        /* Pairs with WakeUpConsumer(). */
+        atomic_store( &pMessageQueueHandler->isConsumerWaiting, 1U );
+
+        if( PopMessage( pMessageQueueHandler, pMessage, pMessageLength ) != 0U )
+        {
+            /* A producer might have taken the flag and written the eventfd already,
+             * it only causes one spurious wake up later. */
+            atomic_store( &pMessageQueueHandler->isConsumerWaiting, 0U );
+            break;
+        }
+
+        WaitForWakeUp( pMessageQueueHandler );
+    }
+}
+
+void MessageQueue_Destroy( MessageQueueHandler_t * pMessageQueueHandler,
+                           const char * pQueueName )
+{
+    /* The ring lives in the process, there is no queue left from the previous run to remove by name. */
+    ( void ) pQueueName;
+
+    if( pMessageQueueHandler != NULL )
+    {
+        if( ( pMessageQueueHandler->eventFd >= 0 ) &&
+            ( close( pMessageQueueHandler->eventFd ) == -1 ) )
+        {
+            LogError( ( "close eventfd error, errno: %s, queue name: %s", strerror( errno ), pMessageQueueHandler->pQueueName ) );
+        }
+        pMessageQueueHandler->eventFd = -1;
+
+        free( pMessageQueueHandler->pSlots );
+        pMessageQueueHandler->pSlots = NULL;
     }
 }
 
@@ -49,28 +225,54 @@ MessageQueueResult_t MessageQueue_Create( MessageQueueHandler_t * pMessageQueueH
                                           size_t messageQueueMaxNum )
 {
     MessageQueueResult_t ret = MESSAGE_QUEUE_RESULT_OK;
-    struct mq_attr attr;
+    size_t i;
 
-    if( ( pMessageQueueHandler == NULL ) || ( pQueueName == NULL ) )
+    if( ( pMessageQueueHandler == NULL ) || ( pQueueName == NULL ) || ( messageQueueMaxNum == 0 ) )
     {
         ret = MESSAGE_QUEUE_RESULT_BAD_PARAMETER;
     }
 
     if( ret == MESSAGE_QUEUE_RESULT_OK )
     {
-        memset( &attr, 0, sizeof( struct mq_attr ) );
-        attr.mq_msgsize = messageMaxLength;
-        attr.mq_maxmsg = messageQueueMaxNum;
+        pMessageQueueHandler->pQueueName = pQueueName;
+        pMessageQueueHandler->messageMaxLength = messageMaxLength;
+        pMessageQueueHandler->slotNum = messageQueueMaxNum;
+        pMessageQueueHandler->slotSize = sizeof( MessageQueueSlot_t ) + messageMaxLength;
+        pMessageQueueHandler->slotSize = ( pMessageQueueHandler->slotSize + MESSAGE_QUEUE_SLOT_ALIGNMENT - 1 ) / MESSAGE_QUEUE_SLOT_ALIGNMENT * MESSAGE_QUEUE_SLOT_ALIGNMENT;
+        atomic_init( &pMessageQueueHandler->enqueuePosition, 0 );
+        atomic_init( &pMessageQueueHandler->dequeuePosition, 0 );
+        atomic_init( &pMessageQueueHandler->isConsumerWaiting, 0U );
+        atomic_init( &pMessageQueueHandler->isPolled, 0U );
 
-        pMessageQueueHandler->messageQueue = mq_open( pQueueName, O_RDWR | O_CREAT, 0666, &attr );
+        /* In semaphore mode every read takes one count, so no wake up is lost between two reads. */
+        pMessageQueueHandler->eventFd = eventfd( 0, EFD_SEMAPHORE );
+        if( pMessageQueueHandler->eventFd == -1 )
+        {
+            LogError( ( "eventfd error, errno: %s, queue name: %s", strerror( errno ), pQueueName ) );
+            ret = MESSAGE_QUEUE_RESULT_MQ_OPEN_FAILED;
+        }
+    }
 
-        if( pMessageQueueHandler->messageQueue == ( mqd_t ) -1 )
+    if( ret == MESSAGE_QUEUE_RESULT_OK )
+    {
+        pMessageQueueHandler->pSlots = malloc( pMessageQueueHandler->slotNum * pMessageQueueHandler->slotSize );
+        if( pMessageQueueHandler->pSlots == NULL )
         {
+            LogError( ( "No memory for message queue, slot num: %lu, slot size: %lu, queue name: %s",
+                        pMessageQueueHandler->slotNum,
+                        pMessageQueueHandler->slotSize,
+                        pQueueName ) );
+            ( void ) close( pMessageQueueHandler->eventFd );
+            pMessageQueueHandler->eventFd = -1;
             ret = MESSAGE_QUEUE_RESULT_MQ_OPEN_FAILED;
         }
-        else
+    }
+
+    if( ret == MESSAGE_QUEUE_RESULT_OK )
+    {
+        for( i = 0; i < pMessageQueueHandler->slotNum; i++ )
         {
-            pMessageQueueHandler->pQueueName = pQueueName;
+            atomic_init( &MESSAGE_QUEUE_GET_SLOT( pMessageQueueHandler, i )->sequence, i );
         }
     }
 
@@ -82,21 +284,67 @@ MessageQueueResult_t MessageQueue_Send( MessageQueueHandler_t * pMessageQueueHan
                                         size_t messageLength )
 {
     MessageQueueResult_t ret = MESSAGE_QUEUE_RESULT_OK;
+    MessageQueueSlot_t * pSlot = NULL;
+    size_t position;
+    size_t sequence;
 
     if( ( pMessageQueueHandler == NULL ) || ( pMessage == NULL ) )
     {
         ret = MESSAGE_QUEUE_RESULT_BAD_PARAMETER;
     }
+    else if( messageLength > pMessageQueueHandler->messageMaxLength )
+    {
+        LogError( ( "Message is too long, message length: %lu, max length: %lu", messageLength, pMessageQueueHandler->messageMaxLength ) );
+        ret = MESSAGE_QUEUE_RESULT_MQ_SEND_FAILED;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
 
     if( ret == MESSAGE_QUEUE_RESULT_OK )
     {
-        if( mq_send( pMessageQueueHandler->messageQueue, pMessage, messageLength, 0 ) == -1 )
+        /* Claim the slot at the enqueue position, unless the consumer hasn't freed it yet. */
+        position = atomic_load_explicit( &pMessageQueueHandler->enqueuePosition, memory_order_relaxed );
+        for( ;; )
         {
-            LogError( ( "mq_send returns failed" ) );
-            ret = MESSAGE_QUEUE_RESULT_MQ_SEND_FAILED;
+            pSlot = MESSAGE_QUEUE_GET_SLOT( pMessageQueueHandler, position );
+            sequence = atomic_load_explicit( &pSlot->sequence, memory_order_acquire );
+
+            if( sequence == position )
+            {
+                if( atomic_compare_exchange_weak_explicit( &pMessageQueueHandler->enqueuePosition,
+                                                           &position,
+                                                           position + 1,
+                                                           memory_order_relaxed,
+                                                           memory_order_relaxed ) )
+                {
+                    break;
+                }
+            }
+            else if( ( intptr_t )( sequence - position ) < 0 )
+            {
+                /* The slot still holds the message of the previous round. */
+                ret = MESSAGE_QUEUE_RESULT_MQ_IS_FULL;
+                break;
+            }
+            else
+            {
+                /* Another producer claimed this position, retry from the latest one. */
+                position = atomic_load_explicit( &pMessageQueueHandler->enqueuePosition, memory_order_relaxed );
+            }
         }
     }
 
+    if( ret == MESSAGE_QUEUE_RESULT_OK )
+    {
+        memcpy( pSlot + 1, pMessage, messageLength );
+        pSlot->messageLength = messageLength;
+        atomic_store( &pSlot->sequence, position + 1 );
+
+        WakeUpConsumer( pMessageQueueHandler );
+    }
+
     return ret;
 }
 
@@ -105,79 +353,109 @@ MessageQueueResult_t MessageQueue_Recv( MessageQueueHandler_t * pMessageQueueHan
                                         size_t * pMessageLength )
 {
     MessageQueueResult_t ret = MESSAGE_QUEUE_RESULT_OK;
-    int32_t recvLength;
-    unsigned int recvPriority = 0;
 
-    if( ( pMessageQueueHandler == NULL ) || ( pMessage == NULL ) )
+    if( ( pMessageQueueHandler == NULL ) || ( pMessage == NULL ) || ( pMessageLength == NULL ) )
     {
         ret = MESSAGE_QUEUE_RESULT_BAD_PARAMETER;
     }
-
-    if( ret == MESSAGE_QUEUE_RESULT_OK )
+    else if( *pMessageLength < pMessageQueueHandler->messageMaxLength )
     {
-        recvLength = mq_receive( pMessageQueueHandler->messageQueue, pMessage, *pMessageLength, &recvPriority );
-        if( recvLength == -1 )
-        {
-            LogError( ( "mq_receive returns failed" ) );
-            ret = MESSAGE_QUEUE_RESULT_MQ_RECV_FAILED;
-        }
+        /* Same as mq_receive(), the buffer must be able to hold the longest message. */
+        LogError( ( "Receive buffer is too small, buffer length: %lu, max length: %lu", *pMessageLength, pMessageQueueHandler->messageMaxLength ) );
+        ret = MESSAGE_QUEUE_RESULT_MQ_RECV_FAILED;
+    }
+    else
+    {
+        /* Empty else marker. */
     }
 
     if( ret == MESSAGE_QUEUE_RESULT_OK )
     {
-        *pMessageLength = recvLength;
+        /* Block till a message arrives. */
+        WaitForMessage( pMessageQueueHandler,
+                        pMessage,
+                        pMessageLength );
     }
 
     return ret;
 }
 
-MessageQueueResult_t MessageQueue_IsEmpty( MessageQueueHandler_t * pMessageQueueHandler )
+MessageQueueResult_t MessageQueue_TryRecv( MessageQueueHandler_t * pMessageQueueHandler,
+                                           void * pMessage,
+                                           size_t * pMessageLength )
 {
     MessageQueueResult_t ret = MESSAGE_QUEUE_RESULT_OK;
-    struct mq_attr attr;
 
-    if( mq_getattr( pMessageQueueHandler->messageQueue, &attr ) == -1 )
+    if( ( pMessageQueueHandler == NULL ) || ( pMessage == NULL ) || ( pMessageLength == NULL ) )
     {
-        LogError( ( "mq_getattr returns failed" ) );
-        ret = MESSAGE_QUEUE_RESULT_MQ_GETATTR_FAILED;
+        ret = MESSAGE_QUEUE_RESULT_BAD_PARAMETER;
+    }
+    else if( *pMessageLength < pMessageQueueHandler->messageMaxLength )
+    {
+        LogError( ( "Receive buffer is too small, buffer length: %lu, max length: %lu", *pMessageLength, pMessageQueueHandler->messageMaxLength ) );
+        ret = MESSAGE_QUEUE_RESULT_MQ_RECV_FAILED;
+    }
+    else
+    {
+        /* Empty else marker. */
     }
 
-    if( ret == MESSAGE_QUEUE_RESULT_OK )
+    if( ( ret == MESSAGE_QUEUE_RESULT_OK ) &&
+        ( atomic_load( &pMessageQueueHandler->isPolled ) != 0U ) )
     {
-        if( attr.mq_curmsgs <= 0 )
+        /* Keep one eventfd count per message, or the poller wakes up for messages already received.
+         * The count is written after publishing, wait for the message like MessageQueue_Recv() does. */
+        if( TryTakeWakeUp( pMessageQueueHandler ) == 0U )
         {
             ret = MESSAGE_QUEUE_RESULT_MQ_IS_EMPTY;
         }
         else
         {
-            ret = MESSAGE_QUEUE_RESULT_MQ_HAVE_MESSAGE;
+            while( PopMessage( pMessageQueueHandler, pMessage, pMessageLength ) == 0U )
+            {
+                ( void ) sched_yield();
+            }
         }
     }
+    else if( ( ret == MESSAGE_QUEUE_RESULT_OK ) &&
+             ( PopMessage( pMessageQueueHandler,
+                           pMessage,
+                           pMessageLength ) == 0U ) )
+    {
+        /* A message still being copied by its producer is left for the next receive. */
+        ret = MESSAGE_QUEUE_RESULT_MQ_IS_EMPTY;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
 
     return ret;
 }
 
-MessageQueueResult_t MessageQueue_IsFull( MessageQueueHandler_t * pMessageQueueHandler )
+MessageQueueResult_t MessageQueue_IsEmpty( MessageQueueHandler_t * pMessageQueueHandler )
 {
-    MessageQueueResult_t ret = MESSAGE_QUEUE_RESULT_OK;
-    struct mq_attr attr;
+    MessageQueueResult_t ret = MESSAGE_QUEUE_RESULT_MQ_IS_EMPTY;
 
-    if( mq_getattr( pMessageQueueHandler->messageQueue, &attr ) == -1 )
+    /* A claimed slot counts as a message, the producer is copying it. */
+    if( atomic_load( &pMessageQueueHandler->enqueuePosition ) != atomic_load( &pMessageQueueHandler->dequeuePosition ) )
     {
-        LogError( ( "mq_getattr returns failed" ) );
-        ret = MESSAGE_QUEUE_RESULT_MQ_GETATTR_FAILED;
+        ret = MESSAGE_QUEUE_RESULT_MQ_HAVE_MESSAGE;
     }
 
-    if( ret == MESSAGE_QUEUE_RESULT_OK )
+    return ret;
+}
+
+MessageQueueResult_t MessageQueue_IsFull( MessageQueueHandler_t * pMessageQueueHandler )
+{
+    MessageQueueResult_t ret = MESSAGE_QUEUE_RESULT_MQ_IS_NOT_FULL;
+    size_t dequeuePosition;
+
+    /* Load the dequeue position first, it never passes the enqueue position. */
+    dequeuePosition = atomic_load( &pMessageQueueHandler->dequeuePosition );
+    if( atomic_load( &pMessageQueueHandler->enqueuePosition ) - dequeuePosition >= pMessageQueueHandler->slotNum )
     {
-        if( attr.mq_curmsgs == attr.mq_maxmsg )
-        {
-            ret = MESSAGE_QUEUE_RESULT_MQ_IS_FULL;
-        }
-        else
-        {
-            ret = MESSAGE_QUEUE_RESULT_MQ_IS_NOT_FULL;
-        }
+        ret = MESSAGE_QUEUE_RESULT_MQ_IS_FULL;
     }
 
     return ret;
@@ -196,9 +474,15 @@ MessageQueueResult_t MessageQueue_AttachPoll( MessageQueueHandler_t * pMessageQu
 
     if( ret == MESSAGE_QUEUE_RESULT_OK )
     {
-        pPollFd->fd = pMessageQueueHandler->messageQueue;
+        /* The eventfd is readable as long as there are messages not received yet,
+         * attach it before the first message is sent. */
+        atomic_store( &pMessageQueueHandler->isPolled, 1U );
+
+        pPollFd->fd = pMessageQueueHandler->eventFd;
         pPollFd->events = PollEvents;
     }
 
     return ret;
 }
+
+#endif /* !MESSAGE_QUEUE_USE_POSIX_MQUEUE */
@@ -27,9 +27,19 @@ extern "C" {
 
 #include <stdio.h>
 #include <stdint.h>
-#include <mqueue.h>
 #include <poll.h>
 
+/* By default the messages are passed through an in-process ring, set it to 1 to use the POSIX message queues instead. */
+#ifndef MESSAGE_QUEUE_USE_POSIX_MQUEUE
+#define MESSAGE_QUEUE_USE_POSIX_MQUEUE 0
+#endif
+
+#if MESSAGE_QUEUE_USE_POSIX_MQUEUE
+#include <mqueue.h>
+#else
+#include <stdatomic.h>
+#endif
+
 typedef enum MessageQueueResult
 {
     MESSAGE_QUEUE_RESULT_OK = 0,
@@ -44,11 +54,35 @@ typedef enum MessageQueueResult
     MESSAGE_QUEUE_RESULT_MQ_GETATTR_FAILED,
 } MessageQueueResult_t;
 
+#if MESSAGE_QUEUE_USE_POSIX_MQUEUE
 typedef struct MessageQueueHandler
 {
     const char * pQueueName;
     mqd_t messageQueue;
 } MessageQueueHandler_t;
+#else
+/* Bounded multi-producer single-consumer ring. Producers claim a slot by advancing the enqueue position
+ * and publish it by updating the slot sequence, the consumer takes a published slot by advancing the dequeue position.
+ * One consumer thread receives with MessageQueue_Recv(). MessageQueue_TryRecv() is called by that consumer, or by a
+ * thread draining the queue when the consumer isn't receiving; the dequeue position is advanced with a compare-and-swap
+ * so a drain racing the consumer still takes every message once, but it's not a multi-consumer queue.
+ * The eventfd wakes up the consumer blocked in MessageQueue_Recv(), it's only written while that consumer is waiting
+ * for a message, or for every message once the queue is polled. */
+typedef struct MessageQueueHandler
+{
+    const char * pQueueName;
+    int eventFd;
+    uint8_t * pSlots;
+    size_t slotSize;
+    size_t slotNum;
+    size_t messageMaxLength;
+    atomic_size_t enqueuePosition;
+    atomic_size_t dequeuePosition;
+    atomic_uint_fast8_t isConsumerWaiting;
+    /* Set by MessageQueue_AttachPoll(), every message writes the eventfd so the poller sees it. */
+    atomic_uint_fast8_t isPolled;
+} MessageQueueHandler_t;
+#endif /* MESSAGE_QUEUE_USE_POSIX_MQUEUE */
 
 MessageQueueResult_t MessageQueue_Create( MessageQueueHandler_t * pMessageQueueHandler,
                                           const char * pQueueName,
@@ -62,6 +96,12 @@ MessageQueueResult_t MessageQueue_Send( MessageQueueHandler_t * pMessageQueueHan
 MessageQueueResult_t MessageQueue_Recv( MessageQueueHandler_t * pMessageQueueHandler,
                                         void * pMessage,
                                         size_t * pMessageLength );
+/* Receive a message without blocking, returns MESSAGE_QUEUE_RESULT_MQ_IS_EMPTY if there is none.
+ * A polled queue must only be received by the polling thread, every message carries one count of the poll fd
+ * and it's taken by either receive. */
+MessageQueueResult_t MessageQueue_TryRecv( MessageQueueHandler_t * pMessageQueueHandler,
+                                           void * pMessage,
+                                           size_t * pMessageLength );
 MessageQueueResult_t MessageQueue_IsEmpty( MessageQueueHandler_t * pMessageQueueHandler );
 MessageQueueResult_t MessageQueue_IsFull( MessageQueueHandler_t * pMessageQueueHandler );
 MessageQueueResult_t MessageQueue_AttachPoll( MessageQueueHandler_t * pMessageQueueHandler,
@@ -0,0 +1,474 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Stress the in-process message queue with many producers and one consumer, and check that every message is received
+ * exactly once in the order of its producer. A small queue keeps the producers running into a full queue.
+ * The polled queue is received with both MessageQueue_Recv() and MessageQueue_TryRecv(), the poll fd must count
+ * exactly the messages not received yet.
+ * Usage: MessageQueueTest */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include <poll.h>
+#include "logging.h"
+#include "message_queue.h"
+
+#define MESSAGE_QUEUE_TEST_PRODUCER_NUM ( 4 )
+#define MESSAGE_QUEUE_TEST_MESSAGE_NUM_PER_PRODUCER ( 200000 )
+#define MESSAGE_QUEUE_TEST_QUEUE_LENGTH ( 16 )
+#define MESSAGE_QUEUE_TEST_PAYLOAD_LENGTH ( 48 )
+
+typedef struct MessageQueueTestMessage
+{
+    uint32_t producerId;
+    uint32_t sequence;
+    uint8_t payload[ MESSAGE_QUEUE_TEST_PAYLOAD_LENGTH ];
+} MessageQueueTestMessage_t;
+
+typedef struct MessageQueueTestProducer
+{
+    MessageQueueHandler_t * pMessageQueue;
+    pthread_t tid;
+    uint32_t producerId;
+    uint32_t fullNum;
+    int result;
+} MessageQueueTestProducer_t;
+
+/* The payload is derived from the producer and the sequence, a torn copy shows up as a mismatch. */
+static void FillMessage( MessageQueueTestMessage_t * pMessage,
+                         uint32_t producerId,
+                         uint32_t sequence )
+{
+    uint32_t i;
+
+    pMessage->producerId = producerId;
+    pMessage->sequence = sequence;
+    for( i = 0; i < MESSAGE_QUEUE_TEST_PAYLOAD_LENGTH; i++ )
+    {
+        pMessage->payload[ i ] = ( uint8_t )( producerId * 31U + sequence + i );
+    }
+}
+
+static int CheckMessage( const MessageQueueTestMessage_t * pMessage,
+                         size_t messageLength,
+                         uint32_t * pNextSequences )
+{
+    int ret = 0;
+    MessageQueueTestMessage_t expectedMessage;
+
+    if( ( messageLength != sizeof( MessageQueueTestMessage_t ) ) ||
+        ( pMessage->producerId >= MESSAGE_QUEUE_TEST_PRODUCER_NUM ) )
+    {
+        printf( "Invalid message, length: %lu, producer: %u\n", messageLength, pMessage->producerId );
+        ret = -1;
+    }
+    else if( pMessage->sequence != pNextSequences[ pMessage->producerId ] )
+    {
+        /* Lower is a duplicate, higher means messages are lost or out of order. */
+        printf( "Producer %u: sequence %u is received, expected %u\n",
+                pMessage->producerId, pMessage->sequence, pNextSequences[ pMessage->producerId ] );
+        ret = -1;
+    }
+    else
+    {
+        FillMessage( &expectedMessage, pMessage->producerId, pMessage->sequence );
+        if( memcmp( pMessage->payload, expectedMessage.payload, MESSAGE_QUEUE_TEST_PAYLOAD_LENGTH ) != 0 )
+        {
+            printf( "Producer %u: the payload of sequence %u is corrupted\n", pMessage->producerId, pMessage->sequence );
+            ret = -1;
+        }
+        pNextSequences[ pMessage->producerId ]++;
+    }
+
+    return ret;
+}
+
+static void * Producer_Task( void * pParameter )
+{
+    MessageQueueTestProducer_t * pProducer = ( MessageQueueTestProducer_t * ) pParameter;
+    MessageQueueTestMessage_t message;
+    MessageQueueResult_t result;
+    uint32_t sequence = 0;
+
+    while( ( pProducer->result == 0 ) && ( sequence < MESSAGE_QUEUE_TEST_MESSAGE_NUM_PER_PRODUCER ) )
+    {
+        FillMessage( &message, pProducer->producerId, sequence );
+        result = MessageQueue_Send( pProducer->pMessageQueue,
+                                    &message,
+                                    sizeof( message ) );
+        if( result == MESSAGE_QUEUE_RESULT_OK )
+        {
+            sequence++;
+        }
+        else if( result == MESSAGE_QUEUE_RESULT_MQ_IS_FULL )
+        {
+            /* The message isn't taken, send it again once the consumer catches up. */
+            pProducer->fullNum++;
+            ( void ) sched_yield();
+        }
+        else
+        {
+            printf( "Producer %u: fail to send, result: %d\n", pProducer->producerId, result );
+            pProducer->result = -1;
+        }
+    }
+
+    return NULL;
+}
+
+/* The poll fd is readable exactly when there are messages not received. */
+static int CheckPollFd( const char * pName,
+                        struct pollfd * pPollFd,
+                        uint8_t isReadable )
+{
+    int ret = 0;
+    int retPoll;
+
+    pPollFd->revents = 0;
+    retPoll = poll( pPollFd, 1, 0 );
+    if( retPoll != ( isReadable != 0U ? 1 : 0 ) )
+    {
+        printf( "%s: poll returns %d, expected %s\n", pName, retPoll, isReadable != 0U ? "readable" : "not readable" );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* All producers send to one consumer. A polled consumer waits for the poll fd,
+ * then alternates MessageQueue_Recv() and draining with MessageQueue_TryRecv(). */
+static int RunStress( uint8_t isPolled )
+{
+    int ret = 0;
+    MessageQueueHandler_t messageQueue;
+    MessageQueueTestProducer_t producers[ MESSAGE_QUEUE_TEST_PRODUCER_NUM ];
+    uint32_t nextSequences[ MESSAGE_QUEUE_TEST_PRODUCER_NUM ];
+    MessageQueueTestMessage_t message;
+    size_t messageLength;
+    struct pollfd pollFd;
+    uint32_t receivedNum = 0;
+    uint32_t fullNum = 0;
+    uint32_t tryRecvNum = 0;
+    uint32_t i;
+    const char * pName = isPolled != 0U ? "Polled stress" : "Stress";
+
+    memset( producers, 0, sizeof( producers ) );
+    memset( nextSequences, 0, sizeof( nextSequences ) );
+
+    if( MessageQueue_Create( &messageQueue,
+                             "/MessageQueueTest",
+                             sizeof( MessageQueueTestMessage_t ),
+                             MESSAGE_QUEUE_TEST_QUEUE_LENGTH ) != MESSAGE_QUEUE_RESULT_OK )
+    {
+        printf( "%s: fail to create the message queue\n", pName );
+        ret = -1;
+    }
+
+    if( ( ret == 0 ) &&
+        ( isPolled != 0U ) &&
+        ( MessageQueue_AttachPoll( &messageQueue, &pollFd, POLLIN ) != MESSAGE_QUEUE_RESULT_OK ) )
+    {
+        printf( "%s: fail to attach the poll fd\n", pName );
+        ret = -1;
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < MESSAGE_QUEUE_TEST_PRODUCER_NUM ); i++ )
+    {
+        producers[ i ].pMessageQueue = &messageQueue;
+        producers[ i ].producerId = i;
+        if( pthread_create( &producers[ i ].tid, NULL, Producer_Task, &producers[ i ] ) != 0 )
+        {
+            printf( "%s: fail to create producer %u\n", pName, i );
+            ret = -1;
+        }
+    }
+
+    while( ( ret == 0 ) && ( receivedNum < MESSAGE_QUEUE_TEST_PRODUCER_NUM * MESSAGE_QUEUE_TEST_MESSAGE_NUM_PER_PRODUCER ) )
+    {
+        if( ( isPolled != 0U ) && ( poll( &pollFd, 1, 1000 ) != 1 ) )
+        {
+            printf( "%s: the poll fd isn't readable, %u messages received\n", pName, receivedNum );
+            ret = -1;
+            break;
+        }
+
+        messageLength = sizeof( message );
+        if( MessageQueue_Recv( &messageQueue, &message, &messageLength ) != MESSAGE_QUEUE_RESULT_OK )
+        {
+            printf( "%s: fail to receive\n", pName );
+            ret = -1;
+        }
+        else
+        {
+            ret = CheckMessage( &message, messageLength, nextSequences );
+            receivedNum++;
+        }
+
+        /* Drain what's there now, like the session task after a wake up. */
+        while( ( ret == 0 ) && ( ( receivedNum % 3U ) == 0U ) )
+        {
+            messageLength = sizeof( message );
+            if( MessageQueue_TryRecv( &messageQueue, &message, &messageLength ) != MESSAGE_QUEUE_RESULT_OK )
+            {
+                break;
+            }
+            ret = CheckMessage( &message, messageLength, nextSequences );
+            receivedNum++;
+            tryRecvNum++;
+        }
+    }
+
+    for( i = 0; i < MESSAGE_QUEUE_TEST_PRODUCER_NUM; i++ )
+    {
+        if( producers[ i ].pMessageQueue != NULL )
+        {
+            if( ret != 0 )
+            {
+                /* Stop the producers, nobody receives any more. */
+                producers[ i ].result = -1;
+            }
+            ( void ) pthread_join( producers[ i ].tid, NULL );
+            fullNum += producers[ i ].fullNum;
+            if( ( ret == 0 ) && ( producers[ i ].result != 0 ) )
+            {
+                ret = -1;
+            }
+        }
+    }
+
+    if( ret == 0 )
+    {
+        messageLength = sizeof( message );
+        if( ( MessageQueue_TryRecv( &messageQueue, &message, &messageLength ) != MESSAGE_QUEUE_RESULT_MQ_IS_EMPTY ) ||
+            ( MessageQueue_IsEmpty( &messageQueue ) != MESSAGE_QUEUE_RESULT_MQ_IS_EMPTY ) )
+        {
+            printf( "%s: the queue isn't empty after all messages are received\n", pName );
+            ret = -1;
+        }
+    }
+
+    if( ( ret == 0 ) && ( isPolled != 0U ) )
+    {
+        ret = CheckPollFd( pName, &pollFd, 0U );
+    }
+
+    printf( "%s: %u messages received, %u by TryRecv, the queue is full %u times\n", pName, receivedNum, tryRecvNum, fullNum );
+
+    if( ( ret == 0 ) && ( fullNum == 0U ) )
+    {
+        printf( "%s: the producers never run into a full queue\n", pName );
+        ret = -1;
+    }
+
+    MessageQueue_Destroy( &messageQueue, "/MessageQueueTest" );
+
+    return ret;
+}
+
+/* A full queue refuses the message without taking it, receiving one makes room in order. */
+static int TestFull( void )
+{
+    int ret = 0;
+    MessageQueueHandler_t messageQueue;
+    MessageQueueTestMessage_t message;
+    uint32_t nextSequences[ MESSAGE_QUEUE_TEST_PRODUCER_NUM ];
+    size_t messageLength;
+    uint32_t i;
+
+    memset( nextSequences, 0, sizeof( nextSequences ) );
+
+    if( MessageQueue_Create( &messageQueue,
+                             "/MessageQueueTest",
+                             sizeof( MessageQueueTestMessage_t ),
+                             4U ) != MESSAGE_QUEUE_RESULT_OK )
+    {
+        printf( "Full: fail to create the message queue\n" );
+        ret = -1;
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < 4U ); i++ )
+    {
+        FillMessage( &message, 0U, i );
+        if( ( MessageQueue_IsFull( &messageQueue ) != MESSAGE_QUEUE_RESULT_MQ_IS_NOT_FULL ) ||
+            ( MessageQueue_Send( &messageQueue, &message, sizeof( message ) ) != MESSAGE_QUEUE_RESULT_OK ) )
+        {
+            printf( "Full: fail to send message %u\n", i );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        FillMessage( &message, 0U, 4U );
+        if( ( MessageQueue_IsFull( &messageQueue ) != MESSAGE_QUEUE_RESULT_MQ_IS_FULL ) ||
+            ( MessageQueue_Send( &messageQueue, &message, sizeof( message ) ) != MESSAGE_QUEUE_RESULT_MQ_IS_FULL ) )
+        {
+            printf( "Full: the full queue takes one more message\n" );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        messageLength = sizeof( message );
+        if( ( MessageQueue_TryRecv( &messageQueue, &message, &messageLength ) != MESSAGE_QUEUE_RESULT_OK ) ||
+            ( CheckMessage( &message, messageLength, nextSequences ) != 0 ) )
+        {
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        FillMessage( &message, 0U, 4U );
+        if( ( MessageQueue_IsFull( &messageQueue ) != MESSAGE_QUEUE_RESULT_MQ_IS_NOT_FULL ) ||
+            ( MessageQueue_Send( &messageQueue, &message, sizeof( message ) ) != MESSAGE_QUEUE_RESULT_OK ) )
+        {
+            printf( "Full: no room after receiving a message\n" );
+            ret = -1;
+        }
+    }
+
+    for( i = 1; ( ret == 0 ) && ( i < 5U ); i++ )
+    {
+        messageLength = sizeof( message );
+        if( ( MessageQueue_TryRecv( &messageQueue, &message, &messageLength ) != MESSAGE_QUEUE_RESULT_OK ) ||
+            ( CheckMessage( &message, messageLength, nextSequences ) != 0 ) )
+        {
+            printf( "Full: fail to receive message %u\n", i );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        /* Too long to send, too short to receive into. */
+        messageLength = sizeof( message ) - 1U;
+        if( ( MessageQueue_Send( &messageQueue, &message, sizeof( message ) + 1U ) != MESSAGE_QUEUE_RESULT_MQ_SEND_FAILED ) ||
+            ( MessageQueue_TryRecv( &messageQueue, &message, &messageLength ) != MESSAGE_QUEUE_RESULT_MQ_RECV_FAILED ) )
+        {
+            printf( "Full: the message length isn't checked\n" );
+            ret = -1;
+        }
+    }
+
+    MessageQueue_Destroy( &messageQueue, "/MessageQueueTest" );
+
+    return ret;
+}
+
+/* Every message carries one count of the poll fd, whichever receive takes the message takes its count. */
+static int TestPollCount( void )
+{
+    int ret = 0;
+    MessageQueueHandler_t messageQueue;
+    MessageQueueTestMessage_t message;
+    uint32_t nextSequences[ MESSAGE_QUEUE_TEST_PRODUCER_NUM ];
+    struct pollfd pollFd;
+    size_t messageLength;
+    uint32_t i;
+
+    memset( nextSequences, 0, sizeof( nextSequences ) );
+
+    if( ( MessageQueue_Create( &messageQueue,
+                               "/MessageQueueTest",
+                               sizeof( MessageQueueTestMessage_t ),
+                               8U ) != MESSAGE_QUEUE_RESULT_OK ) ||
+        ( MessageQueue_AttachPoll( &messageQueue, &pollFd, POLLIN ) != MESSAGE_QUEUE_RESULT_OK ) )
+    {
+        printf( "Poll count: fail to create the message queue\n" );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPollFd( "Poll count before sending", &pollFd, 0U );
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < 3U ); i++ )
+    {
+        FillMessage( &message, 0U, i );
+        if( MessageQueue_Send( &messageQueue, &message, sizeof( message ) ) != MESSAGE_QUEUE_RESULT_OK )
+        {
+            ret = -1;
+        }
+    }
+
+    /* 2 by TryRecv, the last one by Recv, which must not wait for a count taken by TryRecv. */
+    for( i = 0; ( ret == 0 ) && ( i < 3U ); i++ )
+    {
+        ret = CheckPollFd( "Poll count with messages", &pollFd, 1U );
+        messageLength = sizeof( message );
+        if( ( ret == 0 ) &&
+            ( ( ( i < 2U ) ? MessageQueue_TryRecv( &messageQueue, &message, &messageLength ) :
+                MessageQueue_Recv( &messageQueue, &message, &messageLength ) ) != MESSAGE_QUEUE_RESULT_OK ) )
+        {
+            printf( "Poll count: fail to receive message %u\n", i );
+            ret = -1;
+        }
+
+        if( ret == 0 )
+        {
+            ret = CheckMessage( &message, messageLength, nextSequences );
+        }
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPollFd( "Poll count after receiving", &pollFd, 0U );
+    }
+
+    if( ret == 0 )
+    {
+        messageLength = sizeof( message );
+        if( MessageQueue_TryRecv( &messageQueue, &message, &messageLength ) != MESSAGE_QUEUE_RESULT_MQ_IS_EMPTY )
+        {
+            printf( "Poll count: a message is received from the empty queue\n" );
+            ret = -1;
+        }
+    }
+
+    MessageQueue_Destroy( &messageQueue, "/MessageQueueTest" );
+
+    return ret;
+}
+
+int main( void )
+{
+    int ret = 0;
+    int result;
+
+    result = TestFull();
+    printf( "Full: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestPollCount();
+    printf( "Poll count: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = RunStress( 0U );
+    printf( "Stress: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = RunStress( 1U );
+    printf( "Polled stress: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    return ret == 0 ? 0 : 1;
+}
@@ -60,6 +60,13 @@ uint64_t NetworkingUtils_GetCurrentTimeUs( void * pTick )
     return ( ( uint64_t ) nowTime.tv_sec * 1000 * 1000 ) + ( ( uint64_t ) nowTime.tv_nsec / 1000 );
 }
 
+uint64_t NetworkingUtils_GetCurrentMonotonicTimeUs( void * pTick )
+{
+    struct timespec nowTime;
+    clock_gettime( CLOCK_MONOTONIC, &nowTime );
+    return ( ( uint64_t ) nowTime.tv_sec * 1000 * 1000 ) + ( ( uint64_t ) nowTime.tv_nsec / 1000 );
+}
+
 uint64_t NetworkingUtils_GetTimeFromIso8601( const char * pDate,
                                              size_t dateLength )
 {
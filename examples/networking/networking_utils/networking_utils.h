@@ -32,6 +32,8 @@ extern "C" {
 
 uint64_t NetworkingUtils_GetCurrentTimeSec( void * pTick );
 uint64_t NetworkingUtils_GetCurrentTimeUs( void * pTick );
+/* Not affected by wall clock changes, for measuring intervals. */
+uint64_t NetworkingUtils_GetCurrentMonotonicTimeUs( void * pTick );
 uint64_t NetworkingUtils_GetTimeFromIso8601( const char * pDate,
                                              size_t dateLength );
 uint64_t NetworkingUtils_GetNTPTimeFromUnixTimeUs( uint64_t timeUs );
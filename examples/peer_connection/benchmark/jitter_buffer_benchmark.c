@@ -0,0 +1,371 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Measure the cost of pushing keyframes into the jitter buffer with their packets in random order.
+ * Every packet is allocated and pushed like PeerConnectionSrtp_HandleSrtpPacket() does, and every ready frame is
+ * copied out packet by packet. The run fails if any frame is not popped as ready.
+ * Usage: JitterBufferBenchmark [frame num] [packet num per frame] */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "logging.h"
+#include "peer_connection_jitter_buffer.h"
+#include "peer_connection_g711_helper.h"
+#include "peer_connection_h264_helper.h"
+#include "peer_connection_h265_helper.h"
+#include "peer_connection_opus_helper.h"
+
+#define JITTER_BUFFER_BENCHMARK_DEFAULT_FRAME_NUM ( 1000 )
+#define JITTER_BUFFER_BENCHMARK_DEFAULT_PACKET_NUM ( 300 )
+#define JITTER_BUFFER_BENCHMARK_CLOCK_RATE ( 90000 )
+#define JITTER_BUFFER_BENCHMARK_TOLERENCE_SEC ( 3 )
+#define JITTER_BUFFER_BENCHMARK_PACKET_SIZE ( 1200 )
+#define JITTER_BUFFER_BENCHMARK_FRAME_INTERVAL ( 3000 )
+#define JITTER_BUFFER_BENCHMARK_CODEC ( 1 << TRANSCEIVER_RTC_CODEC_H264_PROFILE_42E01F_LEVEL_ASYMMETRY_ALLOWED_PACKETIZATION_BIT )
+
+typedef struct JitterBufferBenchmarkContext
+{
+    PeerConnectionJitterBuffer_t jitterBuffer;
+    uint8_t * pFrameBuffer;
+    size_t frameBufferSize;
+    uint32_t readyFrameNum;
+    uint32_t dropFrameNum;
+    uint32_t randomSeed;
+} JitterBufferBenchmarkContext_t;
+
+static JitterBufferBenchmarkContext_t benchmarkContext;
+
+static uint64_t GetMonotonicTimeNs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000000ULL + ( uint64_t ) now.tv_nsec;
+}
+
+/* Use a fixed linear congruential generator so that runs push the same packet orders. */
+static uint32_t GetRandom( JitterBufferBenchmarkContext_t * pContext )
+{
+    pContext->randomSeed = pContext->randomSeed * 1103515245U + 12345U;
+
+    return ( pContext->randomSeed >> 16 ) & 0x7FFFU;
+}
+
+static int CompareDuration( const void * pA,
+                            const void * pB )
+{
+    uint64_t a = *( const uint64_t * ) pA;
+    uint64_t b = *( const uint64_t * ) pB;
+
+    return ( a > b ) - ( a < b );
+}
+
+/* The first payload byte marks the start packet of a frame, the frame is copied out in the frame ready callback. */
+PeerConnectionResult_t GetH264PacketProperty( PeerConnectionJitterBufferPacket_t * pPacket,
+                                              uint8_t * pIsStartPacket )
+{
+    *pIsStartPacket = pPacket->pPacketBuffer[ pPacket->payloadOffset ];
+
+    return PEER_CONNECTION_RESULT_OK;
+}
+
+PeerConnectionResult_t FillFrameH264( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                      uint16_t rtpSeqStart,
+                                      uint16_t rtpSeqEnd,
+                                      uint8_t * pOutBuffer,
+                                      size_t * pOutBufferLength,
+                                      uint32_t * pRtpTimestamp )
+{
+    ( void ) pJitterBuffer;
+    ( void ) rtpSeqStart;
+    ( void ) rtpSeqEnd;
+    ( void ) pOutBuffer;
+    ( void ) pOutBufferLength;
+    ( void ) pRtpTimestamp;
+
+    return PEER_CONNECTION_RESULT_OK;
+}
+
+/* The other codecs are not used by the benchmark. */
+PeerConnectionResult_t GetOpusPacketProperty( PeerConnectionJitterBufferPacket_t * pPacket,
+                                              uint8_t * pIsStartPacket )
+{
+    return GetH264PacketProperty( pPacket,
+                                  pIsStartPacket );
+}
+
+PeerConnectionResult_t FillFrameOpus( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                      uint16_t rtpSeqStart,
+                                      uint16_t rtpSeqEnd,
+                                      uint8_t * pOutBuffer,
+                                      size_t * pOutBufferLength,
+                                      uint32_t * pRtpTimestamp )
+{
+    return FillFrameH264( pJitterBuffer, rtpSeqStart, rtpSeqEnd, pOutBuffer, pOutBufferLength, pRtpTimestamp );
+}
+
+PeerConnectionResult_t GetG711PacketProperty( PeerConnectionJitterBufferPacket_t * pPacket,
+                                              uint8_t * pIsStartPacket )
+{
+    return GetH264PacketProperty( pPacket,
+                                  pIsStartPacket );
+}
+
+PeerConnectionResult_t FillFrameG711( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                      uint16_t rtpSeqStart,
+                                      uint16_t rtpSeqEnd,
+                                      uint8_t * pOutBuffer,
+                                      size_t * pOutBufferLength,
+                                      uint32_t * pRtpTimestamp )
+{
+    return FillFrameH264( pJitterBuffer, rtpSeqStart, rtpSeqEnd, pOutBuffer, pOutBufferLength, pRtpTimestamp );
+}
+
+PeerConnectionResult_t GetH265PacketProperty( PeerConnectionJitterBufferPacket_t * pPacket,
+                                              uint8_t * pIsStartPacket )
+{
+    return GetH264PacketProperty( pPacket,
+                                  pIsStartPacket );
+}
+
+PeerConnectionResult_t FillFrameH265( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                      uint16_t rtpSeqStart,
+                                      uint16_t rtpSeqEnd,
+                                      uint8_t * pOutBuffer,
+                                      size_t * pOutBufferLength,
+                                      uint32_t * pRtpTimestamp )
+{
+    return FillFrameH264( pJitterBuffer, rtpSeqStart, rtpSeqEnd, pOutBuffer, pOutBufferLength, pRtpTimestamp );
+}
+
+static PeerConnectionResult_t OnFrameReady( void * pCustomContext,
+                                            uint16_t startSequence,
+                                            uint16_t endSequence )
+{
+    JitterBufferBenchmarkContext_t * pContext = ( JitterBufferBenchmarkContext_t * ) pCustomContext;
+    PeerConnectionJitterBufferPacket_t * pPacket;
+    size_t frameLength = 0U;
+    uint16_t i;
+
+    for( i = startSequence; i != ( uint16_t )( endSequence + 1 ); i++ )
+    {
+        if( ( PeerConnectionJitterBuffer_GetPacket( &pContext->jitterBuffer,
+                                                    i,
+                                                    &pPacket ) == PEER_CONNECTION_RESULT_OK ) &&
+            ( frameLength + pPacket->payloadLength <= pContext->frameBufferSize ) )
+        {
+            memcpy( &pContext->pFrameBuffer[ frameLength ],
+                    &pPacket->pPacketBuffer[ pPacket->payloadOffset ],
+                    pPacket->payloadLength );
+            frameLength += pPacket->payloadLength;
+        }
+    }
+
+    pContext->readyFrameNum++;
+
+    return PEER_CONNECTION_RESULT_OK;
+}
+
+static PeerConnectionResult_t OnFrameDrop( void * pCustomContext,
+                                           uint16_t startSequence,
+                                           uint16_t endSequence )
+{
+    JitterBufferBenchmarkContext_t * pContext = ( JitterBufferBenchmarkContext_t * ) pCustomContext;
+
+    ( void ) startSequence;
+    ( void ) endSequence;
+
+    pContext->dropFrameNum++;
+
+    return PEER_CONNECTION_RESULT_OK;
+}
+
+static PeerConnectionResult_t PushFrame( JitterBufferBenchmarkContext_t * pContext,
+                                         uint16_t startSequence,
+                                         uint32_t rtpTimestamp,
+                                         const uint16_t * pOffsets,
+                                         uint32_t packetNum )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionJitterBufferPacket_t * pPacket = NULL;
+    uint32_t i;
+
+    for( i = 0; ( ret == PEER_CONNECTION_RESULT_OK ) && ( i < packetNum ); i++ )
+    {
+        ret = PeerConnectionJitterBuffer_AllocateBuffer( &pContext->jitterBuffer,
+                                                         &pPacket,
+                                                         JITTER_BUFFER_BENCHMARK_PACKET_SIZE );
+
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            /* Only the bytes the codec hook reads, the packets are copied out as they are. */
+            pPacket->pPacketBuffer[ 0 ] = pOffsets[ i ] == 0U ? 1U : 0U;
+            pPacket->packetBufferLength = JITTER_BUFFER_BENCHMARK_PACKET_SIZE;
+            pPacket->payloadOffset = 0U;
+            pPacket->payloadLength = JITTER_BUFFER_BENCHMARK_PACKET_SIZE;
+            pPacket->receiveTick = GetMonotonicTimeNs() / 1000U;
+            pPacket->rtpTimestamp = rtpTimestamp;
+            pPacket->sequenceNumber = ( uint16_t )( startSequence + pOffsets[ i ] );
+            pPacket->isEndOfFrame = pOffsets[ i ] == packetNum - 1U ? 1U : 0U;
+
+            ret = PeerConnectionJitterBuffer_Push( &pContext->jitterBuffer,
+                                                   pPacket );
+        }
+    }
+
+    return ret;
+}
+
+int main( int argc,
+          char * argv[] )
+{
+    int ret = 0;
+    JitterBufferBenchmarkContext_t * pContext = &benchmarkContext;
+    uint16_t * pOffsets = NULL;
+    uint64_t * pDurationNs = NULL;
+    uint32_t frameNum = JITTER_BUFFER_BENCHMARK_DEFAULT_FRAME_NUM;
+    uint32_t packetNum = JITTER_BUFFER_BENCHMARK_DEFAULT_PACKET_NUM;
+    uint64_t totalDurationNs = 0U;
+    uint64_t startTimeNs;
+    uint16_t sequenceNumber = 0U;
+    uint16_t offset;
+    uint32_t i;
+    uint32_t j;
+    uint32_t k;
+    PeerConnectionResult_t result;
+
+    if( argc > 1 )
+    {
+        frameNum = ( uint32_t ) strtoul( argv[ 1 ], NULL, 10 );
+    }
+    if( argc > 2 )
+    {
+        packetNum = ( uint32_t ) strtoul( argv[ 2 ], NULL, 10 );
+    }
+
+    /* Keep the frame within the received bitmap and the frame in flight within the half of the buffer that
+     * the jitter buffer accepts around its newest packet. */
+    if( ( frameNum == 0 ) ||
+        ( packetNum == 0 ) ||
+        ( packetNum > PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE ) ||
+        ( packetNum > PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM / 2 ) )
+    {
+        LogError( ( "Invalid input, frame num: %u, packet num: %u", frameNum, packetNum ) );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        memset( pContext, 0, sizeof( JitterBufferBenchmarkContext_t ) );
+        pContext->randomSeed = 1U;
+        pContext->frameBufferSize = ( size_t ) packetNum * JITTER_BUFFER_BENCHMARK_PACKET_SIZE;
+        pContext->pFrameBuffer = ( uint8_t * ) malloc( pContext->frameBufferSize );
+        pOffsets = ( uint16_t * ) malloc( packetNum * sizeof( uint16_t ) );
+        pDurationNs = ( uint64_t * ) calloc( frameNum,
+                                             sizeof( uint64_t ) );
+        if( ( pContext->pFrameBuffer == NULL ) || ( pOffsets == NULL ) || ( pDurationNs == NULL ) )
+        {
+            LogError( ( "Fail to allocate memory for %u frames of %u packets", frameNum, packetNum ) );
+            ret = -1;
+        }
+    }
+
+    if( ( ret == 0 ) &&
+        ( PeerConnectionJitterBuffer_Create( &pContext->jitterBuffer,
+                                             OnFrameReady,
+                                             pContext,
+                                             OnFrameDrop,
+                                             pContext,
+                                             JITTER_BUFFER_BENCHMARK_TOLERENCE_SEC,
+                                             JITTER_BUFFER_BENCHMARK_CODEC,
+                                             JITTER_BUFFER_BENCHMARK_CLOCK_RATE ) != PEER_CONNECTION_RESULT_OK ) )
+    {
+        LogError( ( "Fail to create jitter buffer" ) );
+        ret = -1;
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < frameNum ); i++ )
+    {
+        for( j = 0; j < packetNum; j++ )
+        {
+            pOffsets[ j ] = ( uint16_t ) j;
+        }
+
+        for( j = packetNum - 1U; j > 0U; j-- )
+        {
+            k = GetRandom( pContext ) % ( j + 1U );
+            offset = pOffsets[ j ];
+            pOffsets[ j ] = pOffsets[ k ];
+            pOffsets[ k ] = offset;
+        }
+
+        startTimeNs = GetMonotonicTimeNs();
+        result = PushFrame( pContext,
+                            sequenceNumber,
+                            i * JITTER_BUFFER_BENCHMARK_FRAME_INTERVAL,
+                            pOffsets,
+                            packetNum );
+        pDurationNs[ i ] = GetMonotonicTimeNs() - startTimeNs;
+        totalDurationNs += pDurationNs[ i ];
+        sequenceNumber = ( uint16_t )( sequenceNumber + packetNum );
+
+        if( result != PEER_CONNECTION_RESULT_OK )
+        {
+            LogError( ( "Fail to push frame %u, result: %d", i, result ) );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        qsort( pDurationNs,
+               frameNum,
+               sizeof( uint64_t ),
+               CompareDuration );
+
+        printf( "Frames: %u, packets per frame: %u, ready: %u, dropped: %u\n",
+                frameNum,
+                packetNum,
+                pContext->readyFrameNum,
+                pContext->dropFrameNum );
+        printf( "Push per packet: %.1f ns\n",
+                ( double ) totalDurationNs / ( ( double ) frameNum * packetNum ) );
+        printf( "Push per frame: p50 %.3f us, p99 %.3f us, max %.3f us\n",
+                ( double ) pDurationNs[ frameNum / 2U ] / 1000.0,
+                ( double ) pDurationNs[ ( ( uint64_t ) frameNum * 99U ) / 100U ] / 1000.0,
+                ( double ) pDurationNs[ frameNum - 1U ] / 1000.0 );
+
+        if( ( pContext->readyFrameNum != frameNum ) || ( pContext->dropFrameNum != 0U ) )
+        {
+            ret = -1;
+        }
+    }
+
+    if( pContext->jitterBuffer.isInit != 0U )
+    {
+        PeerConnectionJitterBuffer_Free( &pContext->jitterBuffer );
+    }
+
+    free( pContext->pFrameBuffer );
+    free( pOffsets );
+    free( pDurationNs );
+
+    return ret;
+}
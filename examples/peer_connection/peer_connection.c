@@ -27,6 +27,7 @@
 #include "rtp_api.h"
 #include "rtcp_api.h"
 #include "peer_connection_rolling_buffer.h"
+#include "peer_connection_reception_stats.h"
 #if METRIC_PRINT_ENABLED
 #include "metric.h"
 #endif
@@ -37,25 +38,43 @@
 #include "peer_connection_h265_helper.h"
 #include "peer_connection_opus_helper.h"
 #include "peer_connection_g711_helper.h"
+#include "peer_connection_packetized_frame_helper.h"
+#include "peer_connection_twcc_feedback.h"
+#include "peer_connection_twcc_history.h"
+#include "peer_connection_bandwidth_estimator.h"
+#include "peer_connection_pacer.h"
 
 #if ENABLE_SCTP_DATA_CHANNEL
 #include "peer_connection_sctp.h"
 #endif /* ENABLE_SCTP_DATA_CHANNEL */
 
 #define PEER_CONNECTION_SESSION_TASK_NAME "PcSessionTsk"
-#define PEER_CONNECTION_SESSION_RX_TASK_NAME "PcRxTsk" // For Ice controller to monitor socket Rx path
 #define PEER_CONNECTION_MESSAGE_QUEUE_NAME "/PcSessionMq"
 #define PEER_CONNECTION_AUDIO_TIMER_NAME "RtcpAudioSenderReportTimer"
 #define PEER_CONNECTION_VIDEO_TIMER_NAME "RtcpVideoSenderReportTimer"
 
 #define PEER_CONNECTION_MAX_QUEUE_MSG_NUM ( 10 )
 #define PEER_CONNECTION_RTCP_REPORT_TIMER_INTERVAL_MS ( 5000 )
+/* Transport-cc feedback interval, it's short so the remote sender can react to congestion quickly. */
+#define PEER_CONNECTION_RTCP_TWCC_FEEDBACK_TIMER_INTERVAL_MS ( 100 )
+/* Feedback packets sent at most in one interval, to catch up a burst of received packets. */
+#define PEER_CONNECTION_RTCP_TWCC_FEEDBACK_MAX_PACKET_NUM_PER_INTERVAL ( 4 )
 
 #define PEER_CONNECTION_MAX_DTLS_DECRYPTED_DATA_LENGTH ( 2048 )
 
+/* The resources created by PeerConnection_Init(), a failed init releases the ones it got to. */
+#define PEER_CONNECTION_INIT_REQUEST_QUEUE ( 1U << 0 )
+#define PEER_CONNECTION_INIT_SRTP_TRANSMIT_MUTEX ( 1U << 1 )
+#define PEER_CONNECTION_INIT_SRTP_RECEIVE_MUTEX ( 1U << 2 )
+#define PEER_CONNECTION_INIT_STARTUP_BARRIER ( 1U << 3 )
+#define PEER_CONNECTION_INIT_ICE_CONTROLLER ( 1U << 4 )
+#define PEER_CONNECTION_INIT_PACER ( 1U << 5 )
+#define PEER_CONNECTION_INIT_TWCC_MUTEX ( 1U << 6 )
+#define PEER_CONNECTION_INIT_TIMERS ( 1U << 7 )
+#define PEER_CONNECTION_INIT_ALL ( 0xFFU )
+
 PeerConnectionContext_t peerConnectionContext = { 0 };
 
-extern void * IceControllerSocketListener_Task( void * pParameter );
 static void * PeerConnection_SessionTask( void * pParameter );
 static void SessionProcessEndlessLoop( PeerConnectionSession_t * pSession );
 static PeerConnectionResult_t SendPeerConnectionEvent( PeerConnectionSession_t * pSession,
@@ -75,6 +94,9 @@ static PeerConnectionResult_t HandleIceClosing( PeerConnectionSession_t * pSessi
 
 static PeerConnectionResult_t PeerConnection_OnRtcpSenderReportCallback( PeerConnectionSession_t * pSession,
                                                                          PeerConnectionSessionRequestMessage_t * pRequestMessage );
+#if ENABLE_TWCC_SUPPORT
+static PeerConnectionResult_t PeerConnection_OnRtcpTwccFeedbackCallback( PeerConnectionSession_t * pSession );
+#endif /* ENABLE_TWCC_SUPPORT */
 static int32_t InitDtlsSession( PeerConnectionSession_t * pSession, uint8_t isServer );
 static int32_t ExecuteDtlsHandshake( PeerConnectionSession_t * pSession );
 static int32_t OnDtlsHandshakeComplete( PeerConnectionSession_t * pSession );
@@ -98,6 +120,13 @@ static void * PeerConnection_SessionTask( void * pParameter )
             continue;
         }
 
+        if( pSession->state == PEER_CONNECTION_SESSION_STATE_NONE )
+        {
+            /* Woken up by PeerConnection_Deinit(). */
+            LogDebug( ( "Leaving peer connection session task." ) );
+            break;
+        }
+
         LogDebug( ( "Entering peer connection session endless loop." ) );
         SessionProcessEndlessLoop( pSession );
     }
@@ -120,6 +149,14 @@ static void SessionProcessEndlessLoop( PeerConnectionSession_t * pSession )
     {
         result = HandleRequest( pSession,
                                 &pSession->requestQueue );
+
+        /* Receive the packets of readable sockets on this task, the socket reactor only reports them.
+         * It's checked after every request, so the events are handled even if the report was dropped by a full queue. */
+        if( result == PEER_CONNECTION_RESULT_OK )
+        {
+            IceController_HandleSocketEvents( &pSession->iceControllerContext );
+        }
+
         if( ( result != PEER_CONNECTION_RESULT_OK ) &&
             ( result != PEER_CONNECTION_RESULT_CLOSING ) )
         {
@@ -158,17 +195,14 @@ static void EmptyMessageQueue( MessageQueueHandler_t * pMessageQueue )
     }
     else
     {
+        /* The session task might be receiving from the same queue, never block here. */
         do
         {
-            result = MessageQueue_IsEmpty( pMessageQueue );
-            if( result == MESSAGE_QUEUE_RESULT_MQ_HAVE_MESSAGE )
-            {
-                requestMsgLength = sizeof( PeerConnectionSessionRequestMessage_t );
-                ( void ) MessageQueue_Recv( pMessageQueue,
-                                            &requestMsg,
-                                            &requestMsgLength );
-            }
-        } while( result == MESSAGE_QUEUE_RESULT_MQ_HAVE_MESSAGE );
+            requestMsgLength = sizeof( PeerConnectionSessionRequestMessage_t );
+            result = MessageQueue_TryRecv( pMessageQueue,
+                                           &requestMsg,
+                                           &requestMsgLength );
+        } while( result == MESSAGE_QUEUE_RESULT_OK );
     }
 }
 
@@ -271,6 +305,18 @@ static void OnRtcpSenderReportVideoTimerExpire( void * pParameter )
     }
 }
 
+#if ENABLE_TWCC_SUPPORT
+static void OnRtcpTwccFeedbackTimerExpire( void * pParameter )
+{
+    PeerConnectionSession_t * pSession = ( PeerConnectionSession_t * ) pParameter;
+
+    ( void ) SendPeerConnectionEvent( pSession,
+                                      PEER_CONNECTION_SESSION_REQUEST_TYPE_RTCP_TWCC_FEEDBACK,
+                                      NULL,
+                                      0U );
+}
+#endif /* ENABLE_TWCC_SUPPORT */
+
 static void OnCloseSessionTimerExpire( void * pParameter )
 {
     PeerConnectionSession_t * pSession = ( PeerConnectionSession_t * ) pParameter;
@@ -316,6 +362,11 @@ static void OnClosePeerConnection( PeerConnectionSession_t * pSession )
 
         /* Reset the state to inited for user to re-use. */
         pSession->state = PEER_CONNECTION_SESSION_STATE_INITED;
+
+        if( pSession->onSessionClosedCallback != NULL )
+        {
+            pSession->onSessionClosedCallback( pSession->pSessionClosedUserContext );
+        }
     }
 }
 
@@ -369,6 +420,11 @@ static PeerConnectionResult_t HandleRequest( PeerConnectionSession_t * pSession,
                 ( void ) PeerConnection_OnRtcpSenderReportCallback( pSession,
                                                                     &requestMsg );
                 break;
+            #if ENABLE_TWCC_SUPPORT
+                case PEER_CONNECTION_SESSION_REQUEST_TYPE_RTCP_TWCC_FEEDBACK:
+                    ( void ) PeerConnection_OnRtcpTwccFeedbackCallback( pSession );
+                    break;
+            #endif /* ENABLE_TWCC_SUPPORT */
             case PEER_CONNECTION_SESSION_REQUEST_TYPE_PEER_CONNECTION_CLOSE:
                 PeerConnection_CloseSession( pSession );
                 break;
@@ -378,6 +434,9 @@ static PeerConnectionResult_t HandleRequest( PeerConnectionSession_t * pSession,
                 /* Reset the state to init for next peer since ICE negotiation has not started yet */
                 OnClosePeerConnection( pSession );
                 break;
+            case PEER_CONNECTION_SESSION_REQUEST_TYPE_ICE_SOCKET_READY:
+                /* Only wakes up this task, the socket events are handled after every request in SessionProcessEndlessLoop(). */
+                break;
             default:
                 /* Unknown request, drop it. */
                 LogDebug( ( "Dropping unknown request %d", requestMsg.requestType ) );
@@ -553,6 +612,32 @@ static int32_t OnIceEventProcessIceCandidatesAndPairs( PeerConnectionSession_t *
     return ret;
 }
 
+static int32_t OnIceEventSocketReady( PeerConnectionSession_t * pSession )
+{
+    int32_t ret = 0;
+    PeerConnectionResult_t result;
+
+    if( pSession == NULL )
+    {
+        LogError( ( "Invalid input, pSession: %p", pSession ) );
+        ret = -10;
+    }
+
+    if( ret == 0 )
+    {
+        result = SendPeerConnectionEvent( pSession,
+                                          PEER_CONNECTION_SESSION_REQUEST_TYPE_ICE_SOCKET_READY,
+                                          NULL,
+                                          0U );
+        if( result != PEER_CONNECTION_RESULT_OK )
+        {
+            ret = -11;
+        }
+    }
+
+    return ret;
+}
+
 static int32_t OnIceEventPeriodicConnectionCheck( PeerConnectionSession_t * pSession )
 {
     int32_t ret = 0;
@@ -766,6 +851,10 @@ static int32_t HandleIceEventCallback( void * pCustomContext,
                 /* Trigger peer connection close flow because of ICE event. */
                 ret = OnIceEventPeerConnectionClose( pSession );
                 break;
+            case ICE_CONTROLLER_CB_EVENT_SOCKET_READY:
+                /* Called by the socket reactor, receive the packets on the session task. */
+                ret = OnIceEventSocketReady( pSession );
+                break;
             default:
                 LogError( ( "Unknown event: %d", event ) );
                 ret = -2;
@@ -937,6 +1026,25 @@ static void PeerConnection_SetTimer( PeerConnectionSession_t * pSession )
             /* Do Nothing, Coverity Happy. */
         }
     }
+
+    #if ENABLE_TWCC_SUPPORT
+        if( pSession->rtpConfig.twccId > 0U )
+        {
+            retTimer = TimerController_IsTimerSet( &pSession->twccFeedbackTimer );
+            if( retTimer == TIMER_CONTROLLER_RESULT_NOT_SET )
+            {
+                /* Transport-cc is negotiated, start sending feedback for the media received. */
+                LogDebug( ( "Trigger rtcp transport-cc feedback timer." ) );
+                retTimer = TimerController_SetTimer( &pSession->twccFeedbackTimer,
+                                                     PEER_CONNECTION_RTCP_TWCC_FEEDBACK_TIMER_INTERVAL_MS,
+                                                     PEER_CONNECTION_RTCP_TWCC_FEEDBACK_TIMER_INTERVAL_MS );
+                if( retTimer != TIMER_CONTROLLER_RESULT_OK )
+                {
+                    LogError( ( "Fail to start RTCP transport-cc feedback timer, result: %d", retTimer ) );
+                }
+            }
+        }
+    #endif /* ENABLE_TWCC_SUPPORT */
 }
 
 static int32_t OnDtlsHandshakeComplete( PeerConnectionSession_t * pSession )
@@ -1233,6 +1341,7 @@ static PeerConnectionResult_t InitializeIceController( PeerConnectionSession_t *
         if( iceControllerResult != ICE_CONTROLLER_RESULT_OK )
         {
             LogError( ( "Fail to add Ice server config into Ice Controller." ) );
+            IceController_Deinit( &pSession->iceControllerContext );
             ret = PEER_CONNECTION_RESULT_FAIL_ICE_CONTROLLER_ADD_ICE_SERVER_CONFIG;
         }
     }
@@ -1314,6 +1423,38 @@ static PeerConnectionResult_t PeerConnection_ResetTimer( PeerConnectionSession_t
         }
     }
 
+    #if ENABLE_TWCC_SUPPORT
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            timerControllerResult = TimerController_IsTimerSet( &pSession->twccFeedbackTimer );
+
+            if( timerControllerResult == TIMER_CONTROLLER_RESULT_SET )
+            {
+                TimerController_Reset( &pSession->twccFeedbackTimer );
+                LogDebug( ( "Reset RTCP transport-cc feedback timer." ) );
+            }
+            else if( timerControllerResult == TIMER_CONTROLLER_RESULT_NOT_SET )
+            {
+                /* Do Nothing */
+            }
+            else
+            {
+                LogError( ( "Fail to reset RTCP transport-cc feedback timer." ) );
+                ret = PEER_CONNECTION_RESULT_FAIL_TIMER_RESET;
+            }
+
+            /* Drop the arrival records and sent packets of this peer. */
+            PeerConnectionTwccFeedback_Reset( &pSession->twccFeedback );
+            PeerConnectionTwccHistory_Reset( &pSession->twccHistory );
+
+            /* The next peer may be behind a different link. */
+            ( void ) PeerConnectionBandwidthEstimator_Init( &pSession->bandwidthEstimator,
+                                                            PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MIN_BITRATE_BPS,
+                                                            PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_BITRATE_BPS );
+            pSession->twccMetaData.remoteEstimatedBitrateBps = 0U;
+        }
+    #endif /* ENABLE_TWCC_SUPPORT */
+
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         timerControllerResult = TimerController_IsTimerSet( &pSession->closeSessionTimer );
@@ -1500,17 +1641,78 @@ static PeerConnectionResult_t SetDefaultPayloadTypes( PeerConnectionSession_t *
     return ret;
 }
 
+static void ReleaseSessionResources( PeerConnectionSession_t * pSession,
+                                     uint32_t initializedBitmap )
+{
+    /* The timer callbacks post requests to the session, stop them first. */
+    if( ( initializedBitmap & PEER_CONNECTION_INIT_TIMERS ) != 0U )
+    {
+        #if ENABLE_TWCC_SUPPORT
+            TimerController_Delete( &pSession->twccFeedbackTimer );
+        #endif
+        TimerController_Delete( &pSession->rtcpAudioSenderReportTimer );
+        TimerController_Delete( &pSession->rtcpVideoSenderReportTimer );
+        TimerController_Delete( &pSession->closeSessionTimer );
+    }
+
+    if( ( initializedBitmap & PEER_CONNECTION_INIT_PACER ) != 0U )
+    {
+        /* The pacer updates the TWCC history, it's stopped before the history is freed. */
+        PeerConnectionPacer_Destroy( &pSession->pacer );
+
+        #if ENABLE_TWCC_SUPPORT
+            PeerConnectionTwccFeedback_Free( &pSession->twccFeedback );
+            PeerConnectionTwccHistory_Free( &pSession->twccHistory );
+        #endif
+    }
+
+    #if ENABLE_TWCC_SUPPORT
+        if( ( initializedBitmap & PEER_CONNECTION_INIT_TWCC_MUTEX ) != 0U )
+        {
+            ( void ) pthread_mutex_destroy( &( pSession->twccMetaData.twccBitrateMutex ) );
+        }
+    #endif
+
+    if( ( initializedBitmap & PEER_CONNECTION_INIT_ICE_CONTROLLER ) != 0U )
+    {
+        IceController_Deinit( &pSession->iceControllerContext );
+    }
+
+    if( ( initializedBitmap & PEER_CONNECTION_INIT_STARTUP_BARRIER ) != 0U )
+    {
+        ( void ) close( pSession->startupBarrier );
+        pSession->startupBarrier = -1;
+    }
+
+    if( ( initializedBitmap & PEER_CONNECTION_INIT_SRTP_RECEIVE_MUTEX ) != 0U )
+    {
+        ( void ) pthread_mutex_destroy( &( pSession->srtpReceiveMutex ) );
+    }
+
+    if( ( initializedBitmap & PEER_CONNECTION_INIT_SRTP_TRANSMIT_MUTEX ) != 0U )
+    {
+        ( void ) pthread_mutex_destroy( &( pSession->srtpTransmitMutex ) );
+    }
+
+    if( ( initializedBitmap & PEER_CONNECTION_INIT_REQUEST_QUEUE ) != 0U )
+    {
+        MessageQueue_Destroy( &pSession->requestQueue,
+                              NULL );
+    }
+}
+
 PeerConnectionResult_t PeerConnection_Init( PeerConnectionSession_t * pSession,
                                             PeerConnectionSessionConfiguration_t * pSessionConfig )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     #if ENABLE_TWCC_SUPPORT
-        RtcpTwccManagerResult_t resultRtcpTwccManager = RTCP_TWCC_MANAGER_RESULT_OK;
+        size_t twccHistoryLength = PEER_CONNECTION_TWCC_HISTORY_DEFAULT_LENGTH;
     #endif
     MessageQueueResult_t retMessageQueue;
     TimerControllerResult_t retTimer;
+    uint32_t initializedBitmap = 0U;
     char tempName[ 20 ];
-    static uint8_t initSeq = 0;
+    static uint16_t initSeq = 0;
 
     if( ( pSession == NULL ) || ( pSessionConfig == NULL ) )
     {
@@ -1567,15 +1769,36 @@ PeerConnectionResult_t PeerConnection_Init( PeerConnectionSession_t * pSession,
             LogError( ( "Fail to open message queue" ) );
             ret = PEER_CONNECTION_RESULT_FAIL_MQ_INIT;
         }
+        else
+        {
+            initializedBitmap |= PEER_CONNECTION_INIT_REQUEST_QUEUE;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_init( &( pSession->srtpTransmitMutex ), NULL ) != 0 )
+        {
+            LogError( ( "Fail to create mutex of Tx SRTP session." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_CREATE_SRTP_MUTEX;
+        }
+        else
+        {
+            initializedBitmap |= PEER_CONNECTION_INIT_SRTP_TRANSMIT_MUTEX;
+        }
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( pthread_mutex_init( &( pSession->srtpSessionMutex ), NULL ) != 0 )
+        if( pthread_mutex_init( &( pSession->srtpReceiveMutex ), NULL ) != 0 )
         {
-            LogError( ( "Fail to create mutex of SRTP session." ) );
+            LogError( ( "Fail to create mutex of Rx SRTP session." ) );
             ret = PEER_CONNECTION_RESULT_FAIL_CREATE_SRTP_MUTEX;
         }
+        else
+        {
+            initializedBitmap |= PEER_CONNECTION_INIT_SRTP_RECEIVE_MUTEX;
+        }
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
@@ -1587,24 +1810,9 @@ PeerConnectionResult_t PeerConnection_Init( PeerConnectionSession_t * pSession,
             LogError( ( "eventfd failed" ) );
             ret = PEER_CONNECTION_RESULT_FAIL_CREATE_STARTUP_BARRIER;
         }
-    }
-
-    if( ret == PEER_CONNECTION_RESULT_OK )
-    {
-        /* Initialize session task. */
-        ( void ) snprintf( tempName,
-                           sizeof( tempName ),
-                           "%s%02d",
-                           PEER_CONNECTION_SESSION_TASK_NAME,
-                           initSeq );
-
-        if( pthread_create( &( pSession->pTaskHandler ),
-                            NULL,
-                            PeerConnection_SessionTask,
-                            pSession ) != 0 )
+        else
         {
-            LogError( ( "xTaskCreate(%s) failed", tempName ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_CREATE_TASK_ICE_CONTROLLER;
+            initializedBitmap |= PEER_CONNECTION_INIT_STARTUP_BARRIER;
         }
     }
 
@@ -1613,42 +1821,43 @@ PeerConnectionResult_t PeerConnection_Init( PeerConnectionSession_t * pSession,
         /* Initialize other modules. */
         ret = InitializeIceController( pSession,
                                        pSessionConfig );
-    }
-
-    if( ret == PEER_CONNECTION_RESULT_OK )
-    {
-        ( void ) snprintf( tempName,
-                           sizeof( tempName ),
-                           "%s%02d",
-                           PEER_CONNECTION_SESSION_RX_TASK_NAME,
-                           initSeq++ );
-
-        if( pthread_create( &( pSession->pSocketListener ),
-                            NULL,
-                            IceControllerSocketListener_Task,
-                            &( pSession->iceControllerContext ) ) != 0 )
+        if( ret == PEER_CONNECTION_RESULT_OK )
         {
-            LogError( ( "xTaskCreate(%s) failed", tempName ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_CREATE_TASK_ICE_SOCK_LISTENER;
+            initializedBitmap |= PEER_CONNECTION_INIT_ICE_CONTROLLER;
         }
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        pSession->state = PEER_CONNECTION_SESSION_STATE_INITED;
-        pSession->pCtx = &peerConnectionContext;
+        /* The pacer sends the RTP packets through the ICE controller at a steady rate. */
+        ret = PeerConnectionPacer_Create( &pSession->pacer,
+                                          &pSession->iceControllerContext );
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            /* The TWCC history and feedback created after the pacer are released along with it. */
+            initializedBitmap |= PEER_CONNECTION_INIT_PACER;
+        }
     }
 
     #if ENABLE_TWCC_SUPPORT
         if( ret == PEER_CONNECTION_RESULT_OK )
         {
-            resultRtcpTwccManager = RtcpTwccManager_Init( &pSession->pCtx->rtcpTwccManager,
-                                                          pSession->pCtx->twccPacketInfo,
-                                                          PEER_CONNECTION_RTCP_TWCC_MAX_ARRAY );
-            if( resultRtcpTwccManager != RTCP_TWCC_MANAGER_RESULT_OK )
+            /* Each session keeps its own sent packets, so the feedback of one viewer never misses because of the others. */
+            if( pSessionConfig->twccHistoryLength != 0U )
             {
-                LogError( ( "Fail to Initialize RTCP TWCC Manager, result: %d", resultRtcpTwccManager ) );
-                ret = PEER_CONNECTION_RESULT_FAIL_RTCP_TWCC_INIT;
+                twccHistoryLength = pSessionConfig->twccHistoryLength;
+            }
+
+            ret = PeerConnectionTwccHistory_Create( &pSession->twccHistory,
+                                                    twccHistoryLength );
+            if( ret != PEER_CONNECTION_RESULT_OK )
+            {
+                LogError( ( "Fail to create TWCC history, length: %lu, result: %d", twccHistoryLength, ret ) );
+            }
+            else
+            {
+                PeerConnectionPacer_SetTwccHistory( &pSession->pacer,
+                                                    &pSession->twccHistory );
             }
         }
 
@@ -1660,6 +1869,36 @@ PeerConnectionResult_t PeerConnection_Init( PeerConnectionSession_t * pSession,
                 LogError( ( "Fail to create mutex for TWCC." ) );
                 ret = PEER_CONNECTION_RESULT_FAIL_CREATE_TWCC_MUTEX;
             }
+            else
+            {
+                initializedBitmap |= PEER_CONNECTION_INIT_TWCC_MUTEX;
+            }
+        }
+
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            ret = PeerConnectionTwccFeedback_Init( &pSession->twccFeedback );
+        }
+
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            ret = PeerConnectionBandwidthEstimator_Init( &pSession->bandwidthEstimator,
+                                                         PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MIN_BITRATE_BPS,
+                                                         PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_BITRATE_BPS );
+        }
+
+        /* Initialize timer for transport-cc feedback. */
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            initializedBitmap |= PEER_CONNECTION_INIT_TIMERS;
+            retTimer = TimerController_Create( &pSession->twccFeedbackTimer,
+                                               OnRtcpTwccFeedbackTimerExpire,
+                                               pSession );
+            if( retTimer != TIMER_CONTROLLER_RESULT_OK )
+            {
+                LogError( ( "TimerController_Create return fail, result: %d", retTimer ) );
+                ret = PEER_CONNECTION_RESULT_FAIL_TIMER_INIT;
+            }
         }
 
     #endif
@@ -1667,6 +1906,8 @@ PeerConnectionResult_t PeerConnection_Init( PeerConnectionSession_t * pSession,
     /* Initialize timer for audio Sender Reports. */
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
+        /* The session is zeroed, deleting the timers not created yet is harmless. */
+        initializedBitmap |= PEER_CONNECTION_INIT_TIMERS;
         retTimer = TimerController_Create( &pSession->rtcpAudioSenderReportTimer,
                                            OnRtcpSenderReportAudioTimerExpire,
                                            pSession );
@@ -1707,6 +1948,89 @@ PeerConnectionResult_t PeerConnection_Init( PeerConnectionSession_t * pSession,
         }
     }
 
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* Initialize session task. It's started last, so a failed init has no task to stop. */
+        ( void ) snprintf( tempName,
+                           sizeof( tempName ),
+                           "%s%02d",
+                           PEER_CONNECTION_SESSION_TASK_NAME,
+                           initSeq++ );
+
+        if( pthread_create( &( pSession->pTaskHandler ),
+                            NULL,
+                            PeerConnection_SessionTask,
+                            pSession ) != 0 )
+        {
+            LogError( ( "xTaskCreate(%s) failed", tempName ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_CREATE_TASK_ICE_CONTROLLER;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        pSession->state = PEER_CONNECTION_SESSION_STATE_INITED;
+        pSession->pCtx = &peerConnectionContext;
+    }
+    else if( initializedBitmap != 0U )
+    {
+        ReleaseSessionResources( pSession,
+                                 initializedBitmap );
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnection_Deinit( PeerConnectionSession_t * pSession )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    ssize_t retWrite;
+    uint64_t signalStartUpBarrier = 1;
+
+    if( pSession == NULL )
+    {
+        LogError( ( "Invalid input, pSession: %p", pSession ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else if( pSession->state != PEER_CONNECTION_SESSION_STATE_INITED )
+    {
+        /* A started session is using the sockets and the task, it must be closed first. */
+        LogError( ( "Invalid session state to deinit: %d", pSession->state ) );
+        ret = PEER_CONNECTION_RESULT_INVALID_SESSION_STATE;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* Wake the session task up from the start up barrier, it exits on the NONE state. */
+        pSession->state = PEER_CONNECTION_SESSION_STATE_NONE;
+        retWrite = write( pSession->startupBarrier,
+                          &signalStartUpBarrier,
+                          sizeof( signalStartUpBarrier ) );
+        if( retWrite != sizeof( uint64_t ) )
+        {
+            LogError( ( "Fail to signal start up barrier, errno(%d): %s.", errno, strerror( errno ) ) );
+            pSession->state = PEER_CONNECTION_SESSION_STATE_INITED;
+            ret = PEER_CONNECTION_RESULT_FAIL_SIGNAL_STARTUP_BARRIER;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        ( void ) pthread_join( pSession->pTaskHandler,
+                               NULL );
+
+        ReleaseSessionResources( pSession,
+                                 PEER_CONNECTION_INIT_ALL );
+    }
+
     return ret;
 }
 
@@ -2230,58 +2554,91 @@ PeerConnectionResult_t PeerConnection_WriteFrame( PeerConnectionSession_t * pSes
         ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
 
-    /* Encode the frame into multiple payload buffers (>=1). */
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         if( pSession->state < PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
         {
             LogInfo( ( "This session is not ready for sending frames, state: %d.", pSession->state ) );
         }
-        else if( TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap,
-                                               TRANSCEIVER_RTC_CODEC_H264_PROFILE_42E01F_LEVEL_ASYMMETRY_ALLOWED_PACKETIZATION_BIT ) )
-        {
-            ret = PeerConnectionSrtp_WriteH264Frame( pSession,
-                                                     pTransceiver,
-                                                     pFrame );
-        }
-        else if( TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap,
-                                               TRANSCEIVER_RTC_CODEC_OPUS_BIT ) )
+        else
         {
-            ret = PeerConnectionSrtp_WriteOpusFrame( pSession,
-                                                     pTransceiver,
-                                                     pFrame );
+            /* Encode the frame into multiple payload buffers (>=1) of the sender, then send them with the session's RTP headers and SRTP.
+             * Callers writing the same frame to multiple sessions should packetize it once by PeerConnection_PacketizeFrame() instead. */
+            ret = PeerConnectionSrtp_WriteFrame( pSession,
+                                                 pTransceiver,
+                                                 pFrame );
         }
-        else if( TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap,
-                                               TRANSCEIVER_RTC_CODEC_VP8_BIT ) )
-        {
+    }
 
-        }
-        else if( TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap,
-                                               TRANSCEIVER_RTC_CODEC_MULAW_BIT ) )
-        {
-            ret = PeerConnectionSrtp_WriteG711Frame( pSession,
-                                                     pTransceiver,
-                                                     pFrame );
-        }
-        else if( TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap,
-                                               TRANSCEIVER_RTC_CODEC_ALAW_BIT ) )
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnection_PacketizeFrame( const Transceiver_t * pTransceiver,
+                                                      const PeerConnectionFrame_t * pFrame,
+                                                      PeerConnectionPacketizedFrame_t * pPacketizedFrame )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pTransceiver == NULL ) ||
+        ( pFrame == NULL ) ||
+        ( pPacketizedFrame == NULL ) )
+    {
+        LogError( ( "Invalid input, pTransceiver: %p, pFrame: %p, pPacketizedFrame: %p",
+                    pTransceiver, pFrame, pPacketizedFrame ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    /* Split the frame into RTP payloads once, the buffers of the packetized frame grow to fit the frame. */
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        ret = PeerConnectionSrtp_PacketizeFrame( pTransceiver,
+                                                 pFrame,
+                                                 pPacketizedFrame );
+    }
+
+    return ret;
+}
+
+void PeerConnection_FreePacketizedFrame( PeerConnectionPacketizedFrame_t * pPacketizedFrame )
+{
+    PeerConnectionSrtp_FreePacketizedFrame( pPacketizedFrame );
+}
+
+PeerConnectionResult_t PeerConnection_WritePacketizedFrame( PeerConnectionSession_t * pSession,
+                                                            Transceiver_t * pTransceiver,
+                                                            const PeerConnectionPacketizedFrame_t * pPacketizedFrame )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pSession == NULL ) ||
+        ( pTransceiver == NULL ) ||
+        ( pPacketizedFrame == NULL ) )
+    {
+        LogError( ( "Invalid input, pSession: %p, pTransceiver: %p, pPacketizedFrame: %p",
+                    pSession, pTransceiver, pPacketizedFrame ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    /* Apply session specific SSRC, sequence number, header extensions and SRTP to the packetized frame. */
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pSession->state < PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
         {
-            ret = PeerConnectionSrtp_WriteG711Frame( pSession,
-                                                     pTransceiver,
-                                                     pFrame );
+            LogInfo( ( "This session is not ready for sending frames, state: %d.", pSession->state ) );
         }
-        else if( TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap,
-                                               TRANSCEIVER_RTC_CODEC_H265_BIT ) )
+        else if( !TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap,
+                                                pPacketizedFrame->codecBit ) )
         {
-            ret = PeerConnectionSrtp_WriteH265Frame( pSession,
-                                                     pTransceiver,
-                                                     pFrame );
+            LogError( ( "Packetized frame codec bit %u is not enabled in codec bit map: 0x%x",
+                        pPacketizedFrame->codecBit,
+                        ( int ) pTransceiver->codecBitMap ) );
+            ret = PEER_CONNECTION_RESULT_PACKETIZED_FRAME_CODEC_MISMATCH;
         }
         else
         {
-            /* TODO: Unknown, no matching codec. */
-            LogError( ( "Codec is not supported, codec bit map: 0x%x", ( int ) pTransceiver->codecBitMap ) );
-            ret = PEER_CONNECTION_RESULT_UNKNOWN_TX_CODEC;
+            ret = PeerConnectionSrtp_WritePacketizedFrame( pSession,
+                                                           pTransceiver,
+                                                           pPacketizedFrame );
         }
     }
 
@@ -2438,8 +2795,12 @@ static PeerConnectionResult_t PeerConnection_OnRtcpSenderReportCallback( PeerCon
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     IceControllerResult_t iceControllerResult;
     RtcpSenderReport_t rtcpSenderReport = { 0 };
-    uint8_t srtcpPacket[ PEER_CONNECTION_SRTCP_RTCP_PACKET_MIN_LENGTH ];
+    RtcpReceptionReport_t receptionReport;
+    PeerConnectionSrtpReceiver_t * pSrtpReceiver;
+    uint8_t srtcpPacket[ PEER_CONNECTION_SRTCP_SENDER_REPORT_PACKET_MAX_LENGTH ];
     uint8_t readyToSend = 0;
+    uint8_t isPacketReady = 0U;
+    size_t numReceptionReports = 0U;
     size_t srtcpPacketLength = sizeof( srtcpPacket );
     uint64_t currentTimeUs = pRequestMessage->peerConnectionSessionRequestContent.rtcpContent.currentTimeUs;
     const Transceiver_t * pTransceiver = pRequestMessage->peerConnectionSessionRequestContent.rtcpContent.pTransceiver;
@@ -2452,12 +2813,46 @@ static PeerConnectionResult_t PeerConnection_OnRtcpSenderReportCallback( PeerCon
         ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
 
-    if( ( ret == PEER_CONNECTION_RESULT_OK ) && ( pSession->srtpTransmitSession != NULL ) && ( currentTimeUs - pTransceiver->rtpSender.rtpFirstFrameWallClockTimeUs >= 2500 * 1000 ) )
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) && ( pSession->srtpTransmitSession != NULL ) )
+    {
+        /* Report the reception of the same kind of media, the remote uses it for loss, jitter and RTT. */
+        pSrtpReceiver = ( pTransceiver->trackKind == TRANSCEIVER_TRACK_KIND_AUDIO ) ? &pSession->audioSrtpReceiver : &pSession->videoSrtpReceiver;
+        if( PeerConnectionReceptionStats_GetReceptionReport( &pSrtpReceiver->receptionStats,
+                                                             NetworkingUtils_GetCurrentMonotonicTimeUs( NULL ),
+                                                             &receptionReport ) == PEER_CONNECTION_RESULT_OK )
+        {
+            numReceptionReports = 1U;
+        }
+    }
+
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+        ( pSession->srtpTransmitSession != NULL ) &&
+        ( pTransceiver->direction != TRANSCEIVER_TRACK_DIRECTION_RECVONLY ) &&
+        ( currentTimeUs - pTransceiver->rtpSender.rtpFirstFrameWallClockTimeUs >= 2500 * 1000 ) )
     {
         readyToSend = 1;
     }
 
-    if( !readyToSend )
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) && !readyToSend && ( numReceptionReports > 0U ) )
+    {
+        /* We're not sending media through this transceiver, only the receiver report is sent. */
+        ret = PeerConnectionSrtcp_ConstructReceiverReportPacket( pSession,
+                                                                 pTransceiver->ssrc,
+                                                                 &receptionReport,
+                                                                 numReceptionReports,
+                                                                 &( srtcpPacket[ 0 ] ),
+                                                                 &( srtcpPacketLength ) );
+        if( ret != PEER_CONNECTION_RESULT_OK )
+        {
+            LogError( ( "Fail to serialize and encrypt RTCP Receiver Report." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_RTCP_SERIALIZE_RECEIVER_REPORT;
+        }
+        else
+        {
+            isPacketReady = 1U;
+        }
+    }
+    else if( !readyToSend )
     {
         LogVerbose( ( "Send Report No Frames are sent to SSRC :  %u",
                       pTransceiver->ssrc ) );
@@ -2478,10 +2873,8 @@ static PeerConnectionResult_t PeerConnection_OnRtcpSenderReportCallback( PeerCon
         rtcpSenderReport.senderInfo.ntpTime = NetworkingUtils_GetNTPTimeFromUnixTimeUs( currentTimeUs );
         rtcpSenderReport.senderInfo.packetCount = pTransceiver->rtcpStats.rtpPacketsTransmitted;
         rtcpSenderReport.senderInfo.octetCount = pTransceiver->rtcpStats.rtpBytesTransmitted;
-
-        /* Since the Master isn't processing the received RTP Packets. We don't have any reception reports.*/
-        rtcpSenderReport.pReceptionReports = NULL;
-        rtcpSenderReport.numReceptionReports = 0;
+        rtcpSenderReport.pReceptionReports = ( numReceptionReports > 0U ) ? &receptionReport : NULL;
+        rtcpSenderReport.numReceptionReports = numReceptionReports;
 
         ret = PeerConnectionSrtcp_ConstructSenderReportPacket( ( pSession ),
                                                                &( rtcpSenderReport ),
@@ -2492,30 +2885,93 @@ static PeerConnectionResult_t PeerConnection_OnRtcpSenderReportCallback( PeerCon
             LogError( ( "Fail to serialize and encrypt RTCP Sender Report." ) );
             ret = PEER_CONNECTION_RESULT_FAIL_RTCP_SERIALIZE_SENDER_REPORT;
         }
+        else
+        {
+            isPacketReady = 1U;
+        }
+    }
 
-        /* Send the constructed RTCP packets through network. */
-        if( ret == PEER_CONNECTION_RESULT_OK )
+    /* Send the constructed RTCP packets through network. */
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) && ( isPacketReady != 0U ) )
+    {
+        iceControllerResult = IceController_SendToRemotePeer( &( pSession->iceControllerContext ),
+                                                              ( srtcpPacket ),
+                                                              srtcpPacketLength );
+
+        if( iceControllerResult != ICE_CONTROLLER_RESULT_OK )
+        {
+            LogWarn( ( "Fail to send RTCP packet, ret: %d", iceControllerResult ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_ICE_CONTROLLER_SEND_RTCP_PACKET;
+        }
+        else if( readyToSend )
+        {
+            LogDebug( ( "Send RTCP Sender Report with Status : %u  to SSRC :  %u, NTP Time :  %lu, RTP Time:  %u,  PacketCount : %u, OctetCount : %u, ReceptionReports : %lu",ret,
+                        rtcpSenderReport.senderSsrc, rtcpSenderReport.senderInfo.ntpTime, rtcpSenderReport.senderInfo.rtpTime, rtcpSenderReport.senderInfo.packetCount, rtcpSenderReport.senderInfo.octetCount, numReceptionReports ) );
+        }
+        else
+        {
+            LogDebug( ( "Send RTCP Receiver Report from SSRC : %u, source SSRC : %u, fraction lost : %u, cumulative lost : %u, jitter : %u",
+                        pTransceiver->ssrc, receptionReport.sourceSsrc, receptionReport.fractionLost,
+                        receptionReport.cumulativePacketsLost, receptionReport.interArrivalJitter ) );
+        }
+    }
+
+    return ret;
+}
+#if ENABLE_TWCC_SUPPORT
+static PeerConnectionResult_t PeerConnection_OnRtcpTwccFeedbackCallback( PeerConnectionSession_t * pSession )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    IceControllerResult_t iceControllerResult;
+    uint8_t srtcpPacket[ PEER_CONNECTION_SRTCP_TWCC_FEEDBACK_PACKET_MAX_LENGTH ];
+    size_t srtcpPacketLength = sizeof( srtcpPacket );
+    int i;
+
+    if( pSession == NULL )
+    {
+        LogError( ( "Invalid input, pSession: %p", pSession ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    /* One feedback packet carries limited packets, send more if there are still packets to report. */
+    for( i = 0; ( ret == PEER_CONNECTION_RESULT_OK ) && ( i < PEER_CONNECTION_RTCP_TWCC_FEEDBACK_MAX_PACKET_NUM_PER_INTERVAL ); i++ )
+    {
+        if( pSession->srtpTransmitSession == NULL )
+        {
+            /* The session is closed or not ready yet. */
+            break;
+        }
+
+        srtcpPacketLength = sizeof( srtcpPacket );
+        ret = PeerConnectionSrtcp_ConstructTwccFeedbackPacket( pSession,
+                                                               srtcpPacket,
+                                                               &srtcpPacketLength );
+        if( ret != PEER_CONNECTION_RESULT_OK )
+        {
+            LogError( ( "Fail to serialize and encrypt RTCP transport-cc feedback, result: %d", ret ) );
+        }
+        else if( srtcpPacketLength == 0U )
+        {
+            /* All received packets are reported. */
+            break;
+        }
+        else
         {
             iceControllerResult = IceController_SendToRemotePeer( &( pSession->iceControllerContext ),
-                                                                  ( srtcpPacket ),
+                                                                  srtcpPacket,
                                                                   srtcpPacketLength );
-
             if( iceControllerResult != ICE_CONTROLLER_RESULT_OK )
             {
-                LogWarn( ( "Fail to send RTCP packet, ret: %d", iceControllerResult ) );
+                LogWarn( ( "Fail to send RTCP transport-cc feedback, ret: %d", iceControllerResult ) );
                 ret = PEER_CONNECTION_RESULT_FAIL_ICE_CONTROLLER_SEND_RTCP_PACKET;
             }
-            else
-            {
-                LogDebug( ( "Send RTCP Sender Report with Status : %u  to SSRC :  %u, NTP Time :  %lu, RTP Time:  %u,  PacketCount : %u, OctetCount : %u",ret,
-                            rtcpSenderReport.senderSsrc, rtcpSenderReport.senderInfo.ntpTime, rtcpSenderReport.senderInfo.rtpTime, rtcpSenderReport.senderInfo.packetCount, rtcpSenderReport.senderInfo.octetCount ) );
-            }
         }
-
     }
 
     return ret;
 }
+#endif /* ENABLE_TWCC_SUPPORT */
+
 PeerConnectionResult_t PeerConnection_SetPictureLossIndicationCallback( PeerConnectionSession_t * pSession,
                                                                         OnPictureLossIndicationCallback_t onPictureLossIndicationCallback,
                                                                         void * pUserContext )
@@ -2535,6 +2991,44 @@ PeerConnectionResult_t PeerConnection_SetPictureLossIndicationCallback( PeerConn
     return ret;
 }
 
+PeerConnectionResult_t PeerConnection_SetReceiverEstimatedMaximumBitrateCallback( PeerConnectionSession_t * pSession,
+                                                                                  OnReceiverEstimatedMaximumBitrateCallback_t onReceiverEstimatedMaximumBitrateCallback,
+                                                                                  void * pUserContext )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pSession == NULL ) || ( onReceiverEstimatedMaximumBitrateCallback == NULL ) )
+    {
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else
+    {
+        pSession->onReceiverEstimatedMaximumBitrateCallback = onReceiverEstimatedMaximumBitrateCallback;
+        pSession->pReceiverEstimatedMaximumBitrateUserContext = pUserContext;
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnection_SetSessionClosedCallback( PeerConnectionSession_t * pSession,
+                                                                OnSessionClosedCallback_t onSessionClosedCallback,
+                                                                void * pUserContext )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pSession == NULL ) || ( onSessionClosedCallback == NULL ) )
+    {
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else
+    {
+        pSession->onSessionClosedCallback = onSessionClosedCallback;
+        pSession->pSessionClosedUserContext = pUserContext;
+    }
+
+    return ret;
+}
+
 #if ENABLE_TWCC_SUPPORT
     PeerConnectionResult_t PeerConnection_SetSenderBandwidthEstimationCallback( PeerConnectionSession_t * pSession,
                                                                                 OnBandwidthEstimationCallback_t onBandwidthEstimationCallback,
@@ -33,6 +33,8 @@ extern "C" {
 
     PeerConnectionResult_t PeerConnection_Init( PeerConnectionSession_t * pSession,
                                                 PeerConnectionSessionConfiguration_t * pSessionConfig );
+    /* Stop the session task and release the resources of PeerConnection_Init(), the session must not have been started. */
+    PeerConnectionResult_t PeerConnection_Deinit( PeerConnectionSession_t * pSession );
     PeerConnectionResult_t PeerConnection_Start( PeerConnectionSession_t * pSession );
     PeerConnectionResult_t PeerConnection_AddTransceiver( PeerConnectionSession_t * pSession,
                                                           Transceiver_t * pTransceiver );
@@ -68,6 +70,15 @@ extern "C" {
     PeerConnectionResult_t PeerConnection_WriteFrame( PeerConnectionSession_t * pSession,
                                                       Transceiver_t * pTransceiver,
                                                       const PeerConnectionFrame_t * pFrame );
+/* Packetize the frame once, then write the same packetized frame to multiple sessions. */
+    PeerConnectionResult_t PeerConnection_PacketizeFrame( const Transceiver_t * pTransceiver,
+                                                          const PeerConnectionFrame_t * pFrame,
+                                                          PeerConnectionPacketizedFrame_t * pPacketizedFrame );
+    PeerConnectionResult_t PeerConnection_WritePacketizedFrame( PeerConnectionSession_t * pSession,
+                                                                Transceiver_t * pTransceiver,
+                                                                const PeerConnectionPacketizedFrame_t * pPacketizedFrame );
+    /* Release the buffers of a packetized frame filled by PeerConnection_PacketizeFrame(). */
+    void PeerConnection_FreePacketizedFrame( PeerConnectionPacketizedFrame_t * pPacketizedFrame );
     PeerConnectionResult_t PeerConnection_CreateAnswer( PeerConnectionSession_t * pSession,
                                                         PeerConnectionBufferSessionDescription_t * pOutputBufferSessionDescription,
                                                         char * pOutputSerializedSdpMessage,
@@ -84,6 +95,14 @@ extern "C" {
     PeerConnectionResult_t PeerConnection_SetPictureLossIndicationCallback( PeerConnectionSession_t * pSession,
                                                                             OnPictureLossIndicationCallback_t onPictureLossIndicationCallback,
                                                                             void * pUserContext );
+/* Receive the REMB (goog-remb) feedback, the receiver's estimate of the maximum total bitrate it can take. */
+    PeerConnectionResult_t PeerConnection_SetReceiverEstimatedMaximumBitrateCallback( PeerConnectionSession_t * pSession,
+                                                                                      OnReceiverEstimatedMaximumBitrateCallback_t onReceiverEstimatedMaximumBitrateCallback,
+                                                                                      void * pUserContext );
+/* Get notified on the session task when a session is closed and can be re-used for the next peer. */
+    PeerConnectionResult_t PeerConnection_SetSessionClosedCallback( PeerConnectionSession_t * pSession,
+                                                                    OnSessionClosedCallback_t onSessionClosedCallback,
+                                                                    void * pUserContext );
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,537 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_bandwidth_estimator.h"
+
+#if ENABLE_TWCC_SUPPORT
+
+/* https://datatracker.ietf.org/doc/html/draft-ietf-rmcat-gcc-02#section-5.2, packets sent within a burst time form a group. */
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_BURST_TIME_US ( 5000 )
+/* Restart the delay estimation if the arrival time jumps, e.g. the remote clock is reset. */
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_ARRIVAL_TIME_JUMP_US ( 3000000 )
+
+/* Trendline filter. */
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_SMOOTHING_COEFFICIENT ( 0.9 )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_THRESHOLD_GAIN ( 4.0 )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_NUM_DELTAS ( 1000U )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_NUM_DELTAS_IN_TREND ( 60U )
+
+/* https://datatracker.ietf.org/doc/html/draft-ietf-rmcat-gcc-02#section-5.4, adaptive threshold. */
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_INITIAL_THRESHOLD_MS ( 12.5 )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MIN_THRESHOLD_MS ( 6.0 )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_THRESHOLD_MS ( 600.0 )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_THRESHOLD_K_UP ( 0.0087 )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_THRESHOLD_K_DOWN ( 0.039 )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_ADAPT_OFFSET_MS ( 15.0 )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_THRESHOLD_TIME_DELTA_MS ( 100.0 )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_OVERUSING_TIME_THRESHOLD_MS ( 10.0 )
+
+/* https://datatracker.ietf.org/doc/html/draft-ietf-rmcat-gcc-02#section-5.5, AIMD rate controller. */
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_ACKED_WINDOW_US ( 500000 )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_DECREASE_FACTOR ( 0.85 )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MULTIPLICATIVE_INCREASE_PER_SECOND ( 0.08 )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MIN_ADDITIVE_INCREASE_BPS ( 4000 )
+/* The time for the sender to see the effect of a rate change, it's RTT + 100 ms in the draft. A RTT of 100 ms is assumed. */
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_RESPONSE_TIME_US ( 200000 )
+/* Don't go beyond the acknowledged bitrate too far, there is no evidence that the link can carry more. */
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_ACKED_RATIO ( 1.5 )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_ACKED_MARGIN_BPS ( 10000 )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_ELAPSED_TIME_US ( 1000000 )
+
+static void ResetDelayEstimation( PeerConnectionBandwidthEstimator_t * pBandwidthEstimator )
+{
+    memset( &pBandwidthEstimator->currentGroup, 0, sizeof( PeerConnectionBandwidthEstimatorPacketGroup_t ) );
+    memset( &pBandwidthEstimator->previousGroup, 0, sizeof( PeerConnectionBandwidthEstimatorPacketGroup_t ) );
+    pBandwidthEstimator->numDeltas = 0U;
+    pBandwidthEstimator->firstArrivalTimeUs = 0U;
+    pBandwidthEstimator->accumulatedDelayMs = 0.0;
+    pBandwidthEstimator->smoothedDelayMs = 0.0;
+    pBandwidthEstimator->trendlineSampleCount = 0U;
+    pBandwidthEstimator->trendlineSampleIndex = 0U;
+    pBandwidthEstimator->previousTrend = 0.0;
+    pBandwidthEstimator->overusingTimeMs = -1.0;
+    pBandwidthEstimator->overuseCount = 0U;
+    pBandwidthEstimator->bandwidthUsage = PEER_CONNECTION_BANDWIDTH_USAGE_NORMAL;
+}
+
+/* Least squares slope of the smoothed delay over arrival time. */
+static double GetTrendlineSlope( const PeerConnectionBandwidthEstimator_t * pBandwidthEstimator,
+                                 double defaultSlope )
+{
+    double meanX = 0.0;
+    double meanY = 0.0;
+    double numerator = 0.0;
+    double denominator = 0.0;
+    double slope = defaultSlope;
+    uint32_t i;
+
+    for( i = 0; i < pBandwidthEstimator->trendlineSampleCount; i++ )
+    {
+        meanX += pBandwidthEstimator->arrivalTimesMs[ i ];
+        meanY += pBandwidthEstimator->smoothedDelaysMs[ i ];
+    }
+    meanX /= pBandwidthEstimator->trendlineSampleCount;
+    meanY /= pBandwidthEstimator->trendlineSampleCount;
+
+    for( i = 0; i < pBandwidthEstimator->trendlineSampleCount; i++ )
+    {
+        numerator += ( pBandwidthEstimator->arrivalTimesMs[ i ] - meanX ) * ( pBandwidthEstimator->smoothedDelaysMs[ i ] - meanY );
+        denominator += ( pBandwidthEstimator->arrivalTimesMs[ i ] - meanX ) * ( pBandwidthEstimator->arrivalTimesMs[ i ] - meanX );
+    }
+
+    if( denominator != 0.0 )
+    {
+        slope = numerator / denominator;
+    }
+
+    return slope;
+}
+
+static void UpdateThreshold( PeerConnectionBandwidthEstimator_t * pBandwidthEstimator,
+                             double modifiedTrend,
+                             uint64_t arrivalTimeUs )
+{
+    double absTrend = ( modifiedTrend < 0.0 ) ? -modifiedTrend : modifiedTrend;
+    double timeDeltaMs;
+    double k;
+
+    if( pBandwidthEstimator->lastThresholdUpdateTimeUs == 0U )
+    {
+        pBandwidthEstimator->lastThresholdUpdateTimeUs = arrivalTimeUs;
+    }
+
+    /* Don't adapt to the spikes far above the threshold, they're likely over-use the threshold must catch. */
+    if( absTrend <= pBandwidthEstimator->thresholdMs + PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_ADAPT_OFFSET_MS )
+    {
+        k = ( absTrend < pBandwidthEstimator->thresholdMs ) ? PEER_CONNECTION_BANDWIDTH_ESTIMATOR_THRESHOLD_K_DOWN : PEER_CONNECTION_BANDWIDTH_ESTIMATOR_THRESHOLD_K_UP;
+        timeDeltaMs = ( arrivalTimeUs > pBandwidthEstimator->lastThresholdUpdateTimeUs ) ? ( double )( arrivalTimeUs - pBandwidthEstimator->lastThresholdUpdateTimeUs ) / 1000.0 : 0.0;
+        if( timeDeltaMs > PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_THRESHOLD_TIME_DELTA_MS )
+        {
+            timeDeltaMs = PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_THRESHOLD_TIME_DELTA_MS;
+        }
+
+        pBandwidthEstimator->thresholdMs += k * ( absTrend - pBandwidthEstimator->thresholdMs ) * timeDeltaMs;
+        if( pBandwidthEstimator->thresholdMs < PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MIN_THRESHOLD_MS )
+        {
+            pBandwidthEstimator->thresholdMs = PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MIN_THRESHOLD_MS;
+        }
+        else if( pBandwidthEstimator->thresholdMs > PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_THRESHOLD_MS )
+        {
+            pBandwidthEstimator->thresholdMs = PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_THRESHOLD_MS;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+
+    pBandwidthEstimator->lastThresholdUpdateTimeUs = arrivalTimeUs;
+}
+
+static void DetectOveruse( PeerConnectionBandwidthEstimator_t * pBandwidthEstimator,
+                           double trend,
+                           double sendDeltaMs,
+                           uint64_t arrivalTimeUs )
+{
+    uint32_t numDeltas = pBandwidthEstimator->numDeltas;
+    double modifiedTrend;
+
+    if( numDeltas >= 2U )
+    {
+        if( numDeltas > PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_NUM_DELTAS_IN_TREND )
+        {
+            numDeltas = PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_NUM_DELTAS_IN_TREND;
+        }
+        modifiedTrend = numDeltas * trend * PEER_CONNECTION_BANDWIDTH_ESTIMATOR_THRESHOLD_GAIN;
+
+        if( modifiedTrend > pBandwidthEstimator->thresholdMs )
+        {
+            if( pBandwidthEstimator->overusingTimeMs < 0.0 )
+            {
+                /* Assume over-use started half way between the groups. */
+                pBandwidthEstimator->overusingTimeMs = sendDeltaMs / 2.0;
+            }
+            else
+            {
+                pBandwidthEstimator->overusingTimeMs += sendDeltaMs;
+            }
+            pBandwidthEstimator->overuseCount++;
+
+            /* Signal over-use only if it lasts and the delay keeps growing. */
+            if( ( pBandwidthEstimator->overusingTimeMs > PEER_CONNECTION_BANDWIDTH_ESTIMATOR_OVERUSING_TIME_THRESHOLD_MS ) &&
+                ( pBandwidthEstimator->overuseCount > 1U ) &&
+                ( trend >= pBandwidthEstimator->previousTrend ) )
+            {
+                pBandwidthEstimator->overusingTimeMs = 0.0;
+                pBandwidthEstimator->overuseCount = 0U;
+                pBandwidthEstimator->bandwidthUsage = PEER_CONNECTION_BANDWIDTH_USAGE_OVERUSING;
+            }
+        }
+        else if( modifiedTrend < -pBandwidthEstimator->thresholdMs )
+        {
+            pBandwidthEstimator->overusingTimeMs = -1.0;
+            pBandwidthEstimator->overuseCount = 0U;
+            pBandwidthEstimator->bandwidthUsage = PEER_CONNECTION_BANDWIDTH_USAGE_UNDERUSING;
+        }
+        else
+        {
+            pBandwidthEstimator->overusingTimeMs = -1.0;
+            pBandwidthEstimator->overuseCount = 0U;
+            pBandwidthEstimator->bandwidthUsage = PEER_CONNECTION_BANDWIDTH_USAGE_NORMAL;
+        }
+
+        pBandwidthEstimator->previousTrend = trend;
+        UpdateThreshold( pBandwidthEstimator,
+                         modifiedTrend,
+                         arrivalTimeUs );
+    }
+}
+
+static void UpdateTrendline( PeerConnectionBandwidthEstimator_t * pBandwidthEstimator,
+                             double delayVariationMs,
+                             double sendDeltaMs,
+                             uint64_t arrivalTimeUs )
+{
+    uint32_t index = pBandwidthEstimator->trendlineSampleIndex;
+    double trend = pBandwidthEstimator->previousTrend;
+
+    if( pBandwidthEstimator->numDeltas == 0U )
+    {
+        pBandwidthEstimator->firstArrivalTimeUs = arrivalTimeUs;
+    }
+
+    if( pBandwidthEstimator->numDeltas < PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_NUM_DELTAS )
+    {
+        pBandwidthEstimator->numDeltas++;
+    }
+
+    /* Exponential smoothing of the accumulated one-way delay variation. */
+    pBandwidthEstimator->accumulatedDelayMs += delayVariationMs;
+    pBandwidthEstimator->smoothedDelayMs = PEER_CONNECTION_BANDWIDTH_ESTIMATOR_SMOOTHING_COEFFICIENT * pBandwidthEstimator->smoothedDelayMs +
+                                           ( 1.0 - PEER_CONNECTION_BANDWIDTH_ESTIMATOR_SMOOTHING_COEFFICIENT ) * pBandwidthEstimator->accumulatedDelayMs;
+
+    pBandwidthEstimator->arrivalTimesMs[ index ] = ( double )( arrivalTimeUs - pBandwidthEstimator->firstArrivalTimeUs ) / 1000.0;
+    pBandwidthEstimator->smoothedDelaysMs[ index ] = pBandwidthEstimator->smoothedDelayMs;
+    pBandwidthEstimator->trendlineSampleIndex = ( index + 1U ) % PEER_CONNECTION_BANDWIDTH_ESTIMATOR_TRENDLINE_WINDOW_SIZE;
+    if( pBandwidthEstimator->trendlineSampleCount < PEER_CONNECTION_BANDWIDTH_ESTIMATOR_TRENDLINE_WINDOW_SIZE )
+    {
+        pBandwidthEstimator->trendlineSampleCount++;
+    }
+
+    if( pBandwidthEstimator->trendlineSampleCount == PEER_CONNECTION_BANDWIDTH_ESTIMATOR_TRENDLINE_WINDOW_SIZE )
+    {
+        trend = GetTrendlineSlope( pBandwidthEstimator,
+                                   trend );
+    }
+
+    DetectOveruse( pBandwidthEstimator,
+                   trend,
+                   sendDeltaMs,
+                   arrivalTimeUs );
+}
+
+static void UpdateAckedBitrate( PeerConnectionBandwidthEstimator_t * pBandwidthEstimator,
+                                uint64_t arrivalTimeUs,
+                                uint16_t packetSize )
+{
+    if( ( pBandwidthEstimator->ackedWindowBytes == 0U ) ||
+        ( arrivalTimeUs < pBandwidthEstimator->ackedWindowStartTimeUs ) )
+    {
+        pBandwidthEstimator->ackedWindowStartTimeUs = arrivalTimeUs;
+        pBandwidthEstimator->ackedWindowBytes = 0U;
+    }
+
+    pBandwidthEstimator->ackedWindowBytes += packetSize;
+    if( arrivalTimeUs - pBandwidthEstimator->ackedWindowStartTimeUs >= PEER_CONNECTION_BANDWIDTH_ESTIMATOR_ACKED_WINDOW_US )
+    {
+        pBandwidthEstimator->ackedBitrateBps = pBandwidthEstimator->ackedWindowBytes * 8U * 1000000U / ( arrivalTimeUs - pBandwidthEstimator->ackedWindowStartTimeUs );
+        pBandwidthEstimator->ackedWindowBytes = 0U;
+    }
+
+    if( pBandwidthEstimator->averagePacketSizeBytes == 0.0 )
+    {
+        pBandwidthEstimator->averagePacketSizeBytes = packetSize;
+    }
+    else
+    {
+        pBandwidthEstimator->averagePacketSizeBytes = 0.95 * pBandwidthEstimator->averagePacketSizeBytes + 0.05 * packetSize;
+    }
+}
+
+PeerConnectionResult_t PeerConnectionBandwidthEstimator_Init( PeerConnectionBandwidthEstimator_t * pBandwidthEstimator,
+                                                              uint64_t minBitrateBps,
+                                                              uint64_t maxBitrateBps )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pBandwidthEstimator == NULL ) ||
+        ( minBitrateBps > maxBitrateBps ) )
+    {
+        LogError( ( "Invalid input, pBandwidthEstimator: %p, minBitrateBps: %lu, maxBitrateBps: %lu",
+                    pBandwidthEstimator,
+                    minBitrateBps,
+                    maxBitrateBps ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        memset( pBandwidthEstimator, 0, sizeof( PeerConnectionBandwidthEstimator_t ) );
+        ResetDelayEstimation( pBandwidthEstimator );
+        pBandwidthEstimator->thresholdMs = PEER_CONNECTION_BANDWIDTH_ESTIMATOR_INITIAL_THRESHOLD_MS;
+        pBandwidthEstimator->rateControlState = PEER_CONNECTION_RATE_CONTROL_STATE_HOLD;
+        pBandwidthEstimator->minBitrateBps = minBitrateBps;
+        pBandwidthEstimator->maxBitrateBps = maxBitrateBps;
+        pBandwidthEstimator->targetBitrateBps = maxBitrateBps;
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionBandwidthEstimator_OnPacketFeedback( PeerConnectionBandwidthEstimator_t * pBandwidthEstimator,
+                                                                          uint64_t sendTimeUs,
+                                                                          uint64_t arrivalTimeUs,
+                                                                          uint16_t packetSize )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionBandwidthEstimatorPacketGroup_t * pCurrentGroup;
+    PeerConnectionBandwidthEstimatorPacketGroup_t * pPreviousGroup;
+    int64_t sendDeltaUs;
+    int64_t arrivalDeltaUs;
+
+    if( pBandwidthEstimator == NULL )
+    {
+        LogError( ( "Invalid input, pBandwidthEstimator: %p", pBandwidthEstimator ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        UpdateAckedBitrate( pBandwidthEstimator,
+                            arrivalTimeUs,
+                            packetSize );
+
+        pCurrentGroup = &pBandwidthEstimator->currentGroup;
+        pPreviousGroup = &pBandwidthEstimator->previousGroup;
+
+        if( pCurrentGroup->isValid == 0U )
+        {
+            pCurrentGroup->isValid = 1U;
+            pCurrentGroup->firstSendTimeUs = sendTimeUs;
+            pCurrentGroup->lastSendTimeUs = sendTimeUs;
+            pCurrentGroup->lastArrivalTimeUs = arrivalTimeUs;
+        }
+        else if( sendTimeUs < pCurrentGroup->firstSendTimeUs )
+        {
+            /* Sent before current group, it's too late to account it. */
+        }
+        else if( sendTimeUs - pCurrentGroup->firstSendTimeUs <= PEER_CONNECTION_BANDWIDTH_ESTIMATOR_BURST_TIME_US )
+        {
+            if( sendTimeUs > pCurrentGroup->lastSendTimeUs )
+            {
+                pCurrentGroup->lastSendTimeUs = sendTimeUs;
+            }
+            if( arrivalTimeUs > pCurrentGroup->lastArrivalTimeUs )
+            {
+                pCurrentGroup->lastArrivalTimeUs = arrivalTimeUs;
+            }
+        }
+        else
+        {
+            /* A new group starts, compare the completed group with its previous one. */
+            if( pPreviousGroup->isValid != 0U )
+            {
+                sendDeltaUs = ( int64_t )( pCurrentGroup->lastSendTimeUs - pPreviousGroup->lastSendTimeUs );
+                arrivalDeltaUs = ( int64_t )( pCurrentGroup->lastArrivalTimeUs - pPreviousGroup->lastArrivalTimeUs );
+
+                if( ( arrivalDeltaUs - sendDeltaUs > PEER_CONNECTION_BANDWIDTH_ESTIMATOR_ARRIVAL_TIME_JUMP_US ) ||
+                    ( arrivalDeltaUs < -PEER_CONNECTION_BANDWIDTH_ESTIMATOR_ARRIVAL_TIME_JUMP_US ) )
+                {
+                    LogWarn( ( "Arrival time jumps by %ld us, restart delay-based bandwidth estimation.", arrivalDeltaUs ) );
+                    ResetDelayEstimation( pBandwidthEstimator );
+                }
+                else
+                {
+                    UpdateTrendline( pBandwidthEstimator,
+                                     ( double )( arrivalDeltaUs - sendDeltaUs ) / 1000.0,
+                                     ( double ) sendDeltaUs / 1000.0,
+                                     pCurrentGroup->lastArrivalTimeUs );
+                }
+            }
+
+            memcpy( pPreviousGroup, pCurrentGroup, sizeof( PeerConnectionBandwidthEstimatorPacketGroup_t ) );
+            pCurrentGroup->isValid = 1U;
+            pCurrentGroup->firstSendTimeUs = sendTimeUs;
+            pCurrentGroup->lastSendTimeUs = sendTimeUs;
+            pCurrentGroup->lastArrivalTimeUs = arrivalTimeUs;
+        }
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionBandwidthEstimator_Update( PeerConnectionBandwidthEstimator_t * pBandwidthEstimator,
+                                                                uint64_t currentTimeUs )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    uint64_t elapsedTimeUs = 0U;
+    uint64_t increaseBps;
+    uint64_t maxIncreasedBitrateBps;
+    uint64_t decreasedBitrateBps;
+
+    if( pBandwidthEstimator == NULL )
+    {
+        LogError( ( "Invalid input, pBandwidthEstimator: %p", pBandwidthEstimator ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( ( pBandwidthEstimator->lastRateUpdateTimeUs != 0U ) && ( currentTimeUs > pBandwidthEstimator->lastRateUpdateTimeUs ) )
+        {
+            elapsedTimeUs = currentTimeUs - pBandwidthEstimator->lastRateUpdateTimeUs;
+            if( elapsedTimeUs > PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_ELAPSED_TIME_US )
+            {
+                elapsedTimeUs = PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_ELAPSED_TIME_US;
+            }
+        }
+
+        /* https://datatracker.ietf.org/doc/html/draft-ietf-rmcat-gcc-02#section-6, state transitions by the detector signal. */
+        switch( pBandwidthEstimator->bandwidthUsage )
+        {
+            case PEER_CONNECTION_BANDWIDTH_USAGE_OVERUSING:
+                if( currentTimeUs - pBandwidthEstimator->lastDecreaseTimeUs >= PEER_CONNECTION_BANDWIDTH_ESTIMATOR_RESPONSE_TIME_US )
+                {
+                    pBandwidthEstimator->rateControlState = PEER_CONNECTION_RATE_CONTROL_STATE_DECREASE;
+                }
+                else
+                {
+                    /* The last decrease hasn't taken effect yet. */
+                    pBandwidthEstimator->rateControlState = PEER_CONNECTION_RATE_CONTROL_STATE_HOLD;
+                }
+                break;
+            case PEER_CONNECTION_BANDWIDTH_USAGE_UNDERUSING:
+                /* Let the queues drain before increasing again. */
+                pBandwidthEstimator->rateControlState = PEER_CONNECTION_RATE_CONTROL_STATE_HOLD;
+                break;
+            default:
+                if( pBandwidthEstimator->rateControlState == PEER_CONNECTION_RATE_CONTROL_STATE_HOLD )
+                {
+                    pBandwidthEstimator->rateControlState = PEER_CONNECTION_RATE_CONTROL_STATE_INCREASE;
+                }
+                break;
+        }
+
+        switch( pBandwidthEstimator->rateControlState )
+        {
+            case PEER_CONNECTION_RATE_CONTROL_STATE_INCREASE:
+                if( ( pBandwidthEstimator->linkCapacityBps != 0U ) &&
+                    ( pBandwidthEstimator->ackedBitrateBps > pBandwidthEstimator->linkCapacityBps * PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_ACKED_RATIO ) )
+                {
+                    /* The link is far better than it used to be, forget the old capacity. */
+                    pBandwidthEstimator->linkCapacityBps = 0U;
+                }
+
+                if( pBandwidthEstimator->linkCapacityBps != 0U )
+                {
+                    /* Close to the capacity, add about one packet per response time. */
+                    increaseBps = ( uint64_t )( pBandwidthEstimator->averagePacketSizeBytes * 8U * 1000000U / PEER_CONNECTION_BANDWIDTH_ESTIMATOR_RESPONSE_TIME_US );
+                    if( increaseBps < PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MIN_ADDITIVE_INCREASE_BPS )
+                    {
+                        increaseBps = PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MIN_ADDITIVE_INCREASE_BPS;
+                    }
+                    increaseBps = increaseBps * elapsedTimeUs / 1000000U;
+                }
+                else
+                {
+                    increaseBps = ( uint64_t )( pBandwidthEstimator->targetBitrateBps * PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MULTIPLICATIVE_INCREASE_PER_SECOND * elapsedTimeUs / 1000000U );
+                }
+
+                if( pBandwidthEstimator->ackedBitrateBps != 0U )
+                {
+                    maxIncreasedBitrateBps = ( uint64_t )( pBandwidthEstimator->ackedBitrateBps * PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_ACKED_RATIO ) + PEER_CONNECTION_BANDWIDTH_ESTIMATOR_ACKED_MARGIN_BPS;
+                    if( pBandwidthEstimator->targetBitrateBps < maxIncreasedBitrateBps )
+                    {
+                        pBandwidthEstimator->targetBitrateBps += increaseBps;
+                        if( pBandwidthEstimator->targetBitrateBps > maxIncreasedBitrateBps )
+                        {
+                            pBandwidthEstimator->targetBitrateBps = maxIncreasedBitrateBps;
+                        }
+                    }
+                }
+                else
+                {
+                    pBandwidthEstimator->targetBitrateBps += increaseBps;
+                }
+                break;
+            case PEER_CONNECTION_RATE_CONTROL_STATE_DECREASE:
+                if( pBandwidthEstimator->ackedBitrateBps != 0U )
+                {
+                    decreasedBitrateBps = ( uint64_t )( pBandwidthEstimator->ackedBitrateBps * PEER_CONNECTION_BANDWIDTH_ESTIMATOR_DECREASE_FACTOR );
+
+                    if( pBandwidthEstimator->linkCapacityBps == 0U )
+                    {
+                        pBandwidthEstimator->linkCapacityBps = pBandwidthEstimator->ackedBitrateBps;
+                    }
+                    else
+                    {
+                        pBandwidthEstimator->linkCapacityBps = ( uint64_t )( 0.95 * pBandwidthEstimator->linkCapacityBps + 0.05 * pBandwidthEstimator->ackedBitrateBps );
+                    }
+                }
+                else
+                {
+                    decreasedBitrateBps = ( uint64_t )( pBandwidthEstimator->targetBitrateBps * PEER_CONNECTION_BANDWIDTH_ESTIMATOR_DECREASE_FACTOR );
+                }
+
+                if( decreasedBitrateBps < pBandwidthEstimator->targetBitrateBps )
+                {
+                    LogInfo( ( "Over-use detected, decrease the delay-based estimate from %lu bps to %lu bps, acknowledged: %lu bps",
+                               pBandwidthEstimator->targetBitrateBps,
+                               decreasedBitrateBps,
+                               pBandwidthEstimator->ackedBitrateBps ) );
+                    pBandwidthEstimator->targetBitrateBps = decreasedBitrateBps;
+                    pBandwidthEstimator->lastDecreaseTimeUs = currentTimeUs;
+                }
+
+                pBandwidthEstimator->rateControlState = PEER_CONNECTION_RATE_CONTROL_STATE_HOLD;
+                break;
+            default:
+                /* Hold the target bitrate. */
+                break;
+        }
+
+        if( pBandwidthEstimator->targetBitrateBps < pBandwidthEstimator->minBitrateBps )
+        {
+            pBandwidthEstimator->targetBitrateBps = pBandwidthEstimator->minBitrateBps;
+        }
+        else if( pBandwidthEstimator->targetBitrateBps > pBandwidthEstimator->maxBitrateBps )
+        {
+            pBandwidthEstimator->targetBitrateBps = pBandwidthEstimator->maxBitrateBps;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+
+        pBandwidthEstimator->lastRateUpdateTimeUs = currentTimeUs;
+    }
+
+    return ret;
+}
+
+#endif /* ENABLE_TWCC_SUPPORT */
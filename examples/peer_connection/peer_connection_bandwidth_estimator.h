@@ -0,0 +1,59 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PEER_CONNECTION_BANDWIDTH_ESTIMATOR_H
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_H
+
+#pragma once
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+
+#include "peer_connection_data_types.h"
+
+#if ENABLE_TWCC_SUPPORT
+
+/* The delay-based estimate starts at maxBitrateBps, so it limits the sending bitrate only after over-use is detected. */
+PeerConnectionResult_t PeerConnectionBandwidthEstimator_Init( PeerConnectionBandwidthEstimator_t * pBandwidthEstimator,
+                                                              uint64_t minBitrateBps,
+                                                              uint64_t maxBitrateBps );
+
+/* Feed one packet reported as received by transport-cc feedback, in transport-wide sequence number order.
+ * Only the differences of the send times, and of the arrival times, are used, so they don't need to share the same clock. */
+PeerConnectionResult_t PeerConnectionBandwidthEstimator_OnPacketFeedback( PeerConnectionBandwidthEstimator_t * pBandwidthEstimator,
+                                                                          uint64_t sendTimeUs,
+                                                                          uint64_t arrivalTimeUs,
+                                                                          uint16_t packetSize );
+
+/* Update the target bitrate by the over-use detector state, once per transport-cc feedback packet. */
+PeerConnectionResult_t PeerConnectionBandwidthEstimator_Update( PeerConnectionBandwidthEstimator_t * pBandwidthEstimator,
+                                                                uint64_t currentTimeUs );
+
+#endif /* ENABLE_TWCC_SUPPORT */
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+}
+#endif
+/* *INDENT-ON* */
+
+#endif /* PEER_CONNECTION_BANDWIDTH_ESTIMATOR_H */
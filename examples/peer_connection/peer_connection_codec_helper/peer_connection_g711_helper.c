@@ -15,6 +15,7 @@
  */
 
 #include "peer_connection_codec_helper.h"
+#include "peer_connection_packetized_frame_helper.h"
 #include "g711_packetizer.h"
 #include "g711_depacketizer.h"
 
@@ -34,8 +35,8 @@ PeerConnectionResult_t GetG711PacketProperty( PeerConnectionJitterBufferPacket_t
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        resultG711 = G711Depacketizer_GetPacketProperties( pPacket->pPacketBuffer,
-                                                           pPacket->packetBufferLength,
+        resultG711 = G711Depacketizer_GetPacketProperties( pPacket->pPacketBuffer + pPacket->payloadOffset,
+                                                           pPacket->payloadLength,
                                                            &properties );
         if( resultG711 != G711_RESULT_OK )
         {
@@ -100,8 +101,8 @@ PeerConnectionResult_t FillFrameG711( PeerConnectionJitterBuffer_t * pJitterBuff
         {
             index = PEER_CONNECTION_JITTER_BUFFER_WRAP( i, PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM );
             pPacket = &pJitterBuffer->rtpPackets[ index ];
-            g711Packet.pPacketData = pPacket->pPacketBuffer;
-            g711Packet.packetDataLength = pPacket->packetBufferLength;
+            g711Packet.pPacketData = pPacket->pPacketBuffer + pPacket->payloadOffset;
+            g711Packet.packetDataLength = pPacket->payloadLength;
             rtpTimestamp = pPacket->rtpTimestamp;
             LogDebug( ( "Adding packet seq: %u, length: %lu, timestamp: %u", i, g711Packet.packetDataLength, rtpTimestamp ) );
 
@@ -139,46 +140,20 @@ PeerConnectionResult_t FillFrameG711( PeerConnectionJitterBuffer_t * pJitterBuff
     return ret;
 }
 
-PeerConnectionResult_t PeerConnectionSrtp_WriteG711Frame( PeerConnectionSession_t * pSession,
-                                                          Transceiver_t * pTransceiver,
-                                                          const PeerConnectionFrame_t * pFrame )
+PeerConnectionResult_t PeerConnectionSrtp_PacketizeG711Frame( const PeerConnectionFrame_t * pFrame,
+                                                          uint32_t codecBit,
+                                                          PeerConnectionPacketizedFrame_t * pPacketizedFrame )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     G711PacketizerContext_t g711PacketizerContext;
     G711Result_t resultG711;
     G711Packet_t packetG711;
-    uint8_t rtpBuffer[ PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH ];
-    PeerConnectionRollingBufferPacket_t * pRollingBufferPacket = NULL;
-    uint8_t * pSrtpPacket = NULL;
-    size_t srtpPacketLength = 0;
     G711Frame_t g711Frame;
-    PeerConnectionSrtpSender_t * pSrtpSender = NULL;
-    uint8_t isLocked = 0;
-    uint8_t bufferAfterEncrypt = 1;
-    IceControllerResult_t resultIceController;
-    uint16_t * pRtpSeq = NULL;
-    uint32_t payloadType;
-    uint32_t * pSsrc = NULL;
-    uint32_t packetSent = 0;
-    uint32_t bytesSent = 0;
-    uint32_t randomRtpTimeoffset = 0;    // TODO : Spec required random rtp time offset ( current implementation of KVS SDK )
-    #if ENABLE_TWCC_SUPPORT
-    /* Add TWCC packet tracking */
-    TwccPacketInfo_t packetInfo;
-    #endif /* ENABLE_TWCC_SUPPORT */
 
-    if( ( pSession == NULL ) ||
-        ( pTransceiver == NULL ) ||
-        ( pFrame == NULL ) )
+    if( ( pFrame == NULL ) ||
+        ( pPacketizedFrame == NULL ) )
     {
-        LogError( ( "Invalid input, pSession: %p, pTransceiver: %p, pFrame: %p",
-                    pSession, pTransceiver, pFrame ) );
-        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
-    }
-
-    if( pTransceiver->trackKind != TRANSCEIVER_TRACK_KIND_AUDIO )
-    {
-        LogError( ( "Invalid track kind." ) );
+        LogError( ( "Invalid input, pFrame: %p, pPacketizedFrame: %p", pFrame, pPacketizedFrame ) );
         ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
 
@@ -197,192 +172,41 @@ PeerConnectionResult_t PeerConnectionSrtp_WriteG711Frame( PeerConnectionSession_
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        pSsrc = &pTransceiver->ssrc;
-        pSrtpSender = &pSession->audioSrtpSender;
-        pRtpSeq = &pSession->rtpConfig.audioSequenceNumber;
-        payloadType = pSession->rtpConfig.audioCodecPayload;
-        if( ( pSession->rtpConfig.audioCodecRtxPayload != 0 ) &&
-            ( pSession->rtpConfig.audioCodecRtxPayload != pSession->rtpConfig.audioCodecPayload ) )
-        {
-            bufferAfterEncrypt = 0;
-        }
-
-        if( pthread_mutex_lock( &( pSrtpSender->senderMutex ) ) == 0 )
-        {
-            isLocked = 1;
-        }
-        else
-        {
-            LogError( ( "Fail to take sender mutex" ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SENDER_MUTEX;
-        }
+        PeerConnectionSrtp_ResetPacketizedFrame( pPacketizedFrame,
+                                                 codecBit,
+                                                 PEER_CONNECTION_SRTP_PCM_CLOCKRATE,
+                                                 pFrame->presentationUs );
     }
 
     while( ret == PEER_CONNECTION_RESULT_OK )
     {
-        /* Get buffer from sender for later use.
-         * PeerConnectionRollingBuffer_GetRtpSequenceBuffer() returns the buffer with its size.
-         * If the bufferAfterEncrypt = 0, we store only RTP payload to the buffer.
-         * If the bufferAfterEncrypt = 1, we store the encrypted SRTP packet to the buffer. */
-        pRollingBufferPacket = NULL;
-        ret = PeerConnectionRollingBuffer_GetRtpSequenceBuffer( &pSrtpSender->txRollingBuffer,
-                                                                *pRtpSeq,
-                                                                &pRollingBufferPacket );
-        if( ( ret != PEER_CONNECTION_RESULT_OK ) ||
-            ( pRollingBufferPacket == NULL ) )
+        ret = PeerConnectionSrtp_GetPacketizedPayloadBuffer( pPacketizedFrame,
+                                                             &packetG711.pPacketData,
+                                                             &packetG711.packetDataLength );
+        if( ret != PEER_CONNECTION_RESULT_OK )
         {
-            LogWarn( ( "Fail to get RTP buffer for seq: %u", *pRtpSeq ) );
             break;
         }
 
-        /* Get each NALU payload then serialize SRTP packet. */
-        if( bufferAfterEncrypt == 0 )
-        {
-            packetG711.pPacketData = pRollingBufferPacket->pPacketBuffer + PEER_CONNECTION_SRTP_RTX_WRITE_RESERVED_BYTES;
-            packetG711.packetDataLength = pRollingBufferPacket->packetBufferLength - PEER_CONNECTION_SRTP_RTX_WRITE_RESERVED_BYTES;
-
-            /* Using local buffer for SRTP packet, use the entire packet length. */
-            pSrtpPacket = rtpBuffer;
-            srtpPacketLength = PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH;
-        }
-        else
-        {
-            /* Using local buffer for RTP payload only, set RTP payload length. */
-            packetG711.pPacketData = rtpBuffer;
-            packetG711.packetDataLength = PEER_CONNECTION_SRTP_RTP_PAYLOAD_MAX_LENGTH;
-
-            pSrtpPacket = pRollingBufferPacket->pPacketBuffer;
-            srtpPacketLength = pRollingBufferPacket->packetBufferLength;
-        }
-
         resultG711 = G711Packetizer_GetPacket( &g711PacketizerContext,
                                                &packetG711 );
         if( resultG711 == G711_RESULT_NO_MORE_PACKETS )
         {
-            PeerConnectionRollingBuffer_DiscardRtpSequenceBuffer( &pSrtpSender->txRollingBuffer,
-                                                                  pRollingBufferPacket );
-            /* Eraly break because no packet available. */
             break;
         }
         else if( resultG711 == G711_RESULT_OK )
         {
-            /* Prepare RTP packet for each payload buffer. */
-            memset( &pRollingBufferPacket->rtpPacket, 0, sizeof( RtpPacket_t ) );
-            pRollingBufferPacket->rtpPacket.header.payloadType = payloadType;
-            pRollingBufferPacket->rtpPacket.header.sequenceNumber = *pRtpSeq;
-            pRollingBufferPacket->rtpPacket.header.ssrc = *pSsrc;
-
             /* For G711, typically each packet is complete, so we set the marker bit for each packet */
-            pRollingBufferPacket->rtpPacket.header.flags |= RTP_HEADER_FLAG_MARKER;
-
-            pRollingBufferPacket->rtpPacket.header.csrcCount = 0;
-            pRollingBufferPacket->rtpPacket.header.pCsrc = NULL;
-            pRollingBufferPacket->rtpPacket.header.timestamp = PEER_CONNECTION_SRTP_CONVERT_TIME_US_TO_RTP_TIMESTAMP( PEER_CONNECTION_SRTP_PCM_CLOCKRATE, pFrame->presentationUs );
-
-            if( pSession->rtpConfig.twccId > 0 )
-            {
-                pRollingBufferPacket->rtpPacket.header.flags |= RTP_HEADER_FLAG_EXTENSION;
-                pRollingBufferPacket->rtpPacket.header.extension.extensionProfile = PEER_CONNECTION_SRTP_TWCC_EXT_PROFILE;
-                pRollingBufferPacket->rtpPacket.header.extension.extensionPayloadLength = 1;
-                pRollingBufferPacket->twccExtensionPayload = PEER_CONNECTION_SRTP_GET_TWCC_PAYLOAD( pSession->rtpConfig.twccId, pSession->rtpConfig.twccSequence );
-                pRollingBufferPacket->rtpPacket.header.extension.pExtensionPayload = &pRollingBufferPacket->twccExtensionPayload;
-
-                #if ENABLE_TWCC_SUPPORT
-                memset( &packetInfo, 0, sizeof( TwccPacketInfo_t ) );
-                packetInfo.packetSize = packetG711.packetDataLength;
-                packetInfo.localSentTime = NetworkingUtils_GetCurrentTimeUs( NULL );
-                packetInfo.packetSeqNum = pSession->rtpConfig.twccSequence;
-
-                RtcpTwccManager_AddPacketInfo( &pSession->pCtx->rtcpTwccManager,
-                                               &packetInfo );
-                #endif /* ENABLE_TWCC_SUPPORT */
-
-                pSession->rtpConfig.twccSequence++;
-            }
-
-            pRollingBufferPacket->rtpPacket.payloadLength = packetG711.packetDataLength;
-            pRollingBufferPacket->rtpPacket.pPayload = packetG711.pPacketData;
-
-            /* PeerConnectionSrtp_ConstructSrtpPacket() serializes RTP packet and encrypt it. */
-            ret = PeerConnectionSrtp_ConstructSrtpPacket( pSession,
-                                                          &pRollingBufferPacket->rtpPacket,
-                                                          pSrtpPacket,
-                                                          &srtpPacketLength );
+            ret = PeerConnectionSrtp_AppendPacketizedPayload( pPacketizedFrame,
+                                                              packetG711.packetDataLength,
+                                                              1U );
         }
         else
         {
             LogError( ( "Fail to get G711 packet, result: %d", resultG711 ) );
             ret = PEER_CONNECTION_RESULT_FAIL_PACKETIZER_GET_PACKET;
         }
-
-        if( ret == PEER_CONNECTION_RESULT_OK )
-        {
-            /* Update the rolling buffer length before storing. */
-            if( bufferAfterEncrypt == 0 )
-            {
-                pRollingBufferPacket->packetBufferLength = packetG711.packetDataLength;
-            }
-            else
-            {
-                pRollingBufferPacket->packetBufferLength = srtpPacketLength;
-            }
-
-            /* Udpate the packet into rolling buffer. */
-            ret = PeerConnectionRollingBuffer_SetPacket( &pSrtpSender->txRollingBuffer,
-                                                         ( *pRtpSeq )++,
-                                                         pRollingBufferPacket );
-        }
-
-        if( ( ret != PEER_CONNECTION_RESULT_OK ) && ( pRollingBufferPacket != NULL ) )
-        {
-            /* If any failure, release the allocated RTP buffer. */
-            PeerConnectionRollingBuffer_DiscardRtpSequenceBuffer( &pSrtpSender->txRollingBuffer,
-                                                                  pRollingBufferPacket );
-        }
-
-        /* Write the constructed RTP packets through network. */
-        if( ret == PEER_CONNECTION_RESULT_OK )
-        {
-            resultIceController = IceController_SendToRemotePeer( &pSession->iceControllerContext,
-                                                                  pSrtpPacket,
-                                                                  srtpPacketLength );
-            if( resultIceController != ICE_CONTROLLER_RESULT_OK )
-            {
-                LogWarn( ( "Fail to send RTP packet, ret: %d", resultIceController ) );
-                ret = PEER_CONNECTION_RESULT_FAIL_ICE_CONTROLLER_SEND_RTP_PACKET;
-            }
-        }
-
-        if( ret == PEER_CONNECTION_RESULT_OK )
-        {
-            packetSent++;
-            bytesSent += pRollingBufferPacket->rtpPacket.payloadLength;
-        }
-
-        #if METRIC_PRINT_ENABLED
-        if( ret == PEER_CONNECTION_RESULT_OK )
-        {
-            Metric_EndEvent( METRIC_EVENT_SENDING_FIRST_FRAME );
-        }
-        #endif
-    }
-
-    if( packetSent != 0 )
-    {
-        if( pTransceiver->rtpSender.rtpFirstFrameWallClockTimeUs == 0 )
-        {
-            pTransceiver->rtpSender.rtpFirstFrameWallClockTimeUs = NetworkingUtils_GetCurrentTimeUs( NULL );
-            pTransceiver->rtpSender.rtpTimeOffset = randomRtpTimeoffset;
-        }
-
-        pTransceiver->rtcpStats.rtpPacketsTransmitted += packetSent;
-        pTransceiver->rtcpStats.rtpBytesTransmitted += bytesSent;
-    }
-
-    if( isLocked )
-    {
-        pthread_mutex_unlock( &( pSrtpSender->senderMutex ) );
     }
 
     return ret;
-}
\ No newline at end of file
+}
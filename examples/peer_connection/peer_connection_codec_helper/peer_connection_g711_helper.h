@@ -32,8 +32,8 @@ PeerConnectionResult_t FillFrameG711( PeerConnectionJitterBuffer_t * pJitterBuff
                                       size_t * pOutBufferLength,
                                       uint32_t * pRtpTimestamp );
 
-PeerConnectionResult_t PeerConnectionSrtp_WriteG711Frame( PeerConnectionSession_t * pSession,
-                                                          Transceiver_t * pTransceiver,
-                                                          const PeerConnectionFrame_t * pFrame );
+PeerConnectionResult_t PeerConnectionSrtp_PacketizeG711Frame( const PeerConnectionFrame_t * pFrame,
+                                                          uint32_t codecBit,
+                                                          PeerConnectionPacketizedFrame_t * pPacketizedFrame );
 
 #endif /* PEER_CONNECTION_G711_HELPER_H */
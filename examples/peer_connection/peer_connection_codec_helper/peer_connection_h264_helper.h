@@ -32,8 +32,7 @@ PeerConnectionResult_t FillFrameH264( PeerConnectionJitterBuffer_t * pJitterBuff
                                       size_t * pOutBufferLength,
                                       uint32_t * pRtpTimestamp );
 
-PeerConnectionResult_t PeerConnectionSrtp_WriteH264Frame( PeerConnectionSession_t * pSession,
-                                                          Transceiver_t * pTransceiver,
-                                                          const PeerConnectionFrame_t * pFrame );
+PeerConnectionResult_t PeerConnectionSrtp_PacketizeH264Frame( const PeerConnectionFrame_t * pFrame,
+                                                          PeerConnectionPacketizedFrame_t * pPacketizedFrame );
 
 #endif /* PEER_CONNECTION_H264_HELPER_H */
@@ -32,8 +32,7 @@ PeerConnectionResult_t FillFrameH265( PeerConnectionJitterBuffer_t * pJitterBuff
                                       size_t * pOutBufferLength,
                                       uint32_t * pRtpTimestamp );
 
-PeerConnectionResult_t PeerConnectionSrtp_WriteH265Frame( PeerConnectionSession_t * pSession,
-                                                          Transceiver_t * pTransceiver,
-                                                          const PeerConnectionFrame_t * pFrame );
+PeerConnectionResult_t PeerConnectionSrtp_PacketizeH265Frame( const PeerConnectionFrame_t * pFrame,
+                                                          PeerConnectionPacketizedFrame_t * pPacketizedFrame );
 
 #endif /* PEER_CONNECTION_H265_HELPER_H */
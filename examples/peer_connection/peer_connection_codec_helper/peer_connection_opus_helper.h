@@ -16,8 +16,7 @@ PeerConnectionResult_t FillFrameOpus( PeerConnectionJitterBuffer_t * pJitterBuff
                                       size_t * pOutBufferLength,
                                       uint32_t * pRtpTimestamp );
 
-PeerConnectionResult_t PeerConnectionSrtp_WriteOpusFrame( PeerConnectionSession_t * pSession,
-                                                          Transceiver_t * pTransceiver,
-                                                          const PeerConnectionFrame_t * pFrame );
+PeerConnectionResult_t PeerConnectionSrtp_PacketizeOpusFrame( const PeerConnectionFrame_t * pFrame,
+                                                          PeerConnectionPacketizedFrame_t * pPacketizedFrame );
 
 #endif /* PEER_CONNECTION_OPUS_HELPER_H */
@@ -0,0 +1,557 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "peer_connection_codec_helper.h"
+#include "peer_connection_packetized_frame_helper.h"
+#include "peer_connection_h264_helper.h"
+#include "peer_connection_h265_helper.h"
+#include "peer_connection_opus_helper.h"
+#include "peer_connection_g711_helper.h"
+#include "peer_connection_twcc_history.h"
+#include "peer_connection_pacer.h"
+
+/* Packetize with the smaller payload size so that the same payloads can be sent to sessions with or without RTX. */
+#define PEER_CONNECTION_PACKETIZED_FRAME_PAYLOAD_MAX_LENGTH ( PEER_CONNECTION_SRTP_RTP_PAYLOAD_MAX_LENGTH - PEER_CONNECTION_SRTP_RTX_WRITE_RESERVED_BYTES )
+
+void PeerConnectionSrtp_ResetPacketizedFrame( PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                              uint32_t codecBit,
+                                              uint32_t clockRate,
+                                              uint64_t presentationUs )
+{
+    if( pPacketizedFrame != NULL )
+    {
+        pPacketizedFrame->codecBit = codecBit;
+        pPacketizedFrame->presentationUs = presentationUs;
+        pPacketizedFrame->rtpTimestamp = PEER_CONNECTION_SRTP_CONVERT_TIME_US_TO_RTP_TIMESTAMP( clockRate, presentationUs );
+        pPacketizedFrame->payloadNum = 0;
+        pPacketizedFrame->payloadBufferUsedLength = 0;
+    }
+}
+
+/* Make room for one more payload of the maximum length, growing the buffers if the frame doesn't fit. */
+static PeerConnectionResult_t ReservePacketizedPayload( PeerConnectionPacketizedFrame_t * pPacketizedFrame )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionPacketizedPayload_t * pPayloads = NULL;
+    uint8_t * pPayloadBuffer = NULL;
+    size_t capacity;
+    size_t bufferSize;
+
+    if( pPacketizedFrame->payloadNum >= pPacketizedFrame->payloadCapacity )
+    {
+        capacity = pPacketizedFrame->payloadCapacity == 0U ? PEER_CONNECTION_PACKETIZED_FRAME_INITIAL_PAYLOAD_NUM : pPacketizedFrame->payloadCapacity * 2U;
+        pPayloads = ( PeerConnectionPacketizedPayload_t * )realloc( pPacketizedFrame->pPayloads,
+                                                                    capacity * sizeof( PeerConnectionPacketizedPayload_t ) );
+        if( pPayloads == NULL )
+        {
+            LogError( ( "Fail to grow packetized frame to %lu payloads", capacity ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_PACKETIZED_FRAME_NO_ENOUGH_MEMORY;
+        }
+        else
+        {
+            pPacketizedFrame->pPayloads = pPayloads;
+            pPacketizedFrame->payloadCapacity = capacity;
+        }
+    }
+
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+        ( pPacketizedFrame->payloadBufferSize - pPacketizedFrame->payloadBufferUsedLength < PEER_CONNECTION_PACKETIZED_FRAME_PAYLOAD_MAX_LENGTH ) )
+    {
+        bufferSize = pPacketizedFrame->payloadBufferSize == 0U ? PEER_CONNECTION_PACKETIZED_FRAME_INITIAL_PAYLOAD_NUM * PEER_CONNECTION_PACKETIZED_FRAME_PAYLOAD_MAX_LENGTH : pPacketizedFrame->payloadBufferSize * 2U;
+        pPayloadBuffer = ( uint8_t * )realloc( pPacketizedFrame->pPayloadBuffer,
+                                               bufferSize );
+        if( pPayloadBuffer == NULL )
+        {
+            LogError( ( "Fail to grow packetized frame to %lu bytes", bufferSize ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_PACKETIZED_FRAME_NO_ENOUGH_MEMORY;
+        }
+        else
+        {
+            pPacketizedFrame->pPayloadBuffer = pPayloadBuffer;
+            pPacketizedFrame->payloadBufferSize = bufferSize;
+        }
+    }
+
+    return ret;
+}
+
+void PeerConnectionSrtp_FreePacketizedFrame( PeerConnectionPacketizedFrame_t * pPacketizedFrame )
+{
+    if( pPacketizedFrame != NULL )
+    {
+        free( pPacketizedFrame->pPayloads );
+        free( pPacketizedFrame->pPayloadBuffer );
+        memset( pPacketizedFrame, 0, sizeof( PeerConnectionPacketizedFrame_t ) );
+    }
+}
+
+PeerConnectionResult_t PeerConnectionSrtp_GetPacketizedPayloadBuffer( PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                                                      uint8_t ** ppPayloadBuffer,
+                                                                      size_t * pPayloadBufferLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pPacketizedFrame == NULL ) ||
+        ( ppPayloadBuffer == NULL ) ||
+        ( pPayloadBufferLength == NULL ) )
+    {
+        LogError( ( "Invalid input, pPacketizedFrame: %p, ppPayloadBuffer: %p, pPayloadBufferLength: %p",
+                    pPacketizedFrame, ppPayloadBuffer, pPayloadBufferLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        ret = ReservePacketizedPayload( pPacketizedFrame );
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        *ppPayloadBuffer = &pPacketizedFrame->pPayloadBuffer[ pPacketizedFrame->payloadBufferUsedLength ];
+        *pPayloadBufferLength = PEER_CONNECTION_PACKETIZED_FRAME_PAYLOAD_MAX_LENGTH;
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionSrtp_AppendPacketizedPayload( PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                                                   size_t payloadLength,
+                                                                   uint8_t isMarker )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionPacketizedPayload_t * pPayload = NULL;
+
+    /* The space was reserved by PeerConnectionSrtp_GetPacketizedPayloadBuffer(). */
+    if( ( pPacketizedFrame == NULL ) ||
+        ( payloadLength > PEER_CONNECTION_PACKETIZED_FRAME_PAYLOAD_MAX_LENGTH ) ||
+        ( pPacketizedFrame->payloadNum >= pPacketizedFrame->payloadCapacity ) ||
+        ( pPacketizedFrame->payloadBufferSize - pPacketizedFrame->payloadBufferUsedLength < payloadLength ) )
+    {
+        LogError( ( "Invalid input, pPacketizedFrame: %p, payloadLength: %lu", pPacketizedFrame, payloadLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        pPayload = &pPacketizedFrame->pPayloads[ pPacketizedFrame->payloadNum ];
+        pPayload->payloadOffset = pPacketizedFrame->payloadBufferUsedLength;
+        pPayload->payloadLength = payloadLength;
+        pPayload->isMarker = isMarker;
+
+        pPacketizedFrame->payloadNum++;
+        pPacketizedFrame->payloadBufferUsedLength += payloadLength;
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionSrtp_PacketizeFrame( const Transceiver_t * pTransceiver,
+                                                          const PeerConnectionFrame_t * pFrame,
+                                                          PeerConnectionPacketizedFrame_t * pPacketizedFrame )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    /* The codec is selected by the order of preference. */
+    if( TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap,
+                                      TRANSCEIVER_RTC_CODEC_H264_PROFILE_42E01F_LEVEL_ASYMMETRY_ALLOWED_PACKETIZATION_BIT ) )
+    {
+        ret = PeerConnectionSrtp_PacketizeH264Frame( pFrame,
+                                                     pPacketizedFrame );
+    }
+    else if( TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap,
+                                           TRANSCEIVER_RTC_CODEC_OPUS_BIT ) )
+    {
+        ret = PeerConnectionSrtp_PacketizeOpusFrame( pFrame,
+                                                     pPacketizedFrame );
+    }
+    else if( TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap,
+                                           TRANSCEIVER_RTC_CODEC_MULAW_BIT ) )
+    {
+        ret = PeerConnectionSrtp_PacketizeG711Frame( pFrame,
+                                                     TRANSCEIVER_RTC_CODEC_MULAW_BIT,
+                                                     pPacketizedFrame );
+    }
+    else if( TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap,
+                                           TRANSCEIVER_RTC_CODEC_ALAW_BIT ) )
+    {
+        ret = PeerConnectionSrtp_PacketizeG711Frame( pFrame,
+                                                     TRANSCEIVER_RTC_CODEC_ALAW_BIT,
+                                                     pPacketizedFrame );
+    }
+    else if( TRANSCEIVER_IS_CODEC_ENABLED( pTransceiver->codecBitMap,
+                                           TRANSCEIVER_RTC_CODEC_H265_BIT ) )
+    {
+        ret = PeerConnectionSrtp_PacketizeH265Frame( pFrame,
+                                                     pPacketizedFrame );
+    }
+    else
+    {
+        LogError( ( "Codec is not supported, codec bit map: 0x%x", ( int ) pTransceiver->codecBitMap ) );
+        ret = PEER_CONNECTION_RESULT_UNKNOWN_TX_CODEC;
+    }
+
+    return ret;
+}
+
+static PeerConnectionSrtpSender_t * GetSrtpSender( PeerConnectionSession_t * pSession,
+                                                   const Transceiver_t * pTransceiver )
+{
+    PeerConnectionSrtpSender_t * pSrtpSender = NULL;
+
+    if( pTransceiver->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO )
+    {
+        pSrtpSender = &pSession->videoSrtpSender;
+    }
+    else if( pTransceiver->trackKind == TRANSCEIVER_TRACK_KIND_AUDIO )
+    {
+        pSrtpSender = &pSession->audioSrtpSender;
+    }
+    else
+    {
+        LogError( ( "Invalid track kind: %d", pTransceiver->trackKind ) );
+    }
+
+    return pSrtpSender;
+}
+
+/* Send the packetized frame with the RTP headers and SRTP of the session, the sender mutex must be held. */
+static PeerConnectionResult_t WritePacketizedFrameLocked( PeerConnectionSession_t * pSession,
+                                                          Transceiver_t * pTransceiver,
+                                                          PeerConnectionSrtpSender_t * pSrtpSender,
+                                                          const PeerConnectionPacketizedFrame_t * pPacketizedFrame )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    uint8_t rtpBuffer[ PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH ];
+    PeerConnectionRollingBufferPacket_t * pRollingBufferPacket = NULL;
+    const PeerConnectionPacketizedPayload_t * pPayload = NULL;
+    const uint8_t * pPayloadData = NULL;
+    uint8_t * pSrtpPacket = NULL;
+    size_t srtpPacketLength = 0;
+    uint8_t isBatchProtecting = 0;
+    uint8_t bufferAfterEncrypt = 1;
+    uint8_t hasTwccSequence = 0U;
+    uint16_t twccSequence = 0U;
+    PeerConnectionPacerPriority_t priority = PEER_CONNECTION_PACER_PRIORITY_VIDEO;
+    uint16_t * pRtpSeq = NULL;
+    uint32_t payloadType;
+    uint32_t packetSent = 0;
+    uint32_t bytesSent = 0;
+    uint32_t rtpTimestamp = 0;
+    size_t i;
+    #if ENABLE_TWCC_SUPPORT
+    /* Add TWCC packet tracking */
+    TwccPacketInfo_t packetInfo;
+    #endif /* ENABLE_TWCC_SUPPORT */
+
+    if( pTransceiver->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO )
+    {
+        pRtpSeq = &pSession->rtpConfig.videoSequenceNumber;
+        payloadType = pSession->rtpConfig.videoCodecPayload;
+        priority = PEER_CONNECTION_PACER_PRIORITY_VIDEO;
+        if( ( pSession->rtpConfig.videoCodecRtxPayload != 0 ) &&
+            ( pSession->rtpConfig.videoCodecRtxPayload != pSession->rtpConfig.videoCodecPayload ) )
+        {
+            bufferAfterEncrypt = 0;
+        }
+    }
+    else
+    {
+        pRtpSeq = &pSession->rtpConfig.audioSequenceNumber;
+        payloadType = pSession->rtpConfig.audioCodecPayload;
+        priority = PEER_CONNECTION_PACER_PRIORITY_AUDIO;
+        if( ( pSession->rtpConfig.audioCodecRtxPayload != 0 ) &&
+            ( pSession->rtpConfig.audioCodecRtxPayload != pSession->rtpConfig.audioCodecPayload ) )
+        {
+            bufferAfterEncrypt = 0;
+        }
+    }
+
+    /* The packetized frame is shared by sessions, apply the timestamp offset of this sender. */
+    if( pTransceiver->rtpSender.rtpFirstFrameWallClockTimeUs == 0 )
+    {
+        pTransceiver->rtpSender.rtpTimestampOffset = ( uint32_t ) rand();
+    }
+    rtpTimestamp = pPacketizedFrame->rtpTimestamp + pTransceiver->rtpSender.rtpTimestampOffset;
+
+    /* Encrypt all packets of the frame under one acquisition of the Tx SRTP session mutex. */
+    ret = PeerConnectionSrtp_BeginProtectBatch( pSession );
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        isBatchProtecting = 1;
+    }
+
+    for( i = 0; ( ret == PEER_CONNECTION_RESULT_OK ) && ( i < pPacketizedFrame->payloadNum ); i++ )
+    {
+        pPayload = &pPacketizedFrame->pPayloads[ i ];
+        pPayloadData = &pPacketizedFrame->pPayloadBuffer[ pPayload->payloadOffset ];
+
+        /* Get buffer from sender for later use.
+         * If the bufferAfterEncrypt = 0, we copy only RTP payload to the buffer.
+         * If the bufferAfterEncrypt = 1, we store the encrypted SRTP packet to the buffer
+         * and serialize the RTP payload directly from the packetized frame. */
+        pRollingBufferPacket = NULL;
+        ret = PeerConnectionRollingBuffer_GetRtpSequenceBuffer( &pSrtpSender->txRollingBuffer,
+                                                                *pRtpSeq,
+                                                                &pRollingBufferPacket );
+        if( ( ret != PEER_CONNECTION_RESULT_OK ) ||
+            ( pRollingBufferPacket == NULL ) )
+        {
+            LogWarn( ( "Fail to get RTP buffer for seq: %u", *pRtpSeq ) );
+            break;
+        }
+
+        /* Prepare RTP packet for each payload buffer. */
+        memset( &pRollingBufferPacket->rtpPacket, 0, sizeof( RtpPacket_t ) );
+
+        if( bufferAfterEncrypt == 0 )
+        {
+            memcpy( pRollingBufferPacket->pPacketBuffer + PEER_CONNECTION_SRTP_RTX_WRITE_RESERVED_BYTES,
+                    pPayloadData,
+                    pPayload->payloadLength );
+            pRollingBufferPacket->rtpPacket.pPayload = pRollingBufferPacket->pPacketBuffer + PEER_CONNECTION_SRTP_RTX_WRITE_RESERVED_BYTES;
+
+            /* Using local buffer for SRTP packet, use the entire packet length. */
+            pSrtpPacket = rtpBuffer;
+            srtpPacketLength = PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH;
+        }
+        else
+        {
+            pRollingBufferPacket->rtpPacket.pPayload = ( uint8_t * ) pPayloadData;
+
+            pSrtpPacket = pRollingBufferPacket->pPacketBuffer;
+            srtpPacketLength = pRollingBufferPacket->packetBufferLength;
+        }
+        pRollingBufferPacket->rtpPacket.payloadLength = pPayload->payloadLength;
+
+        pRollingBufferPacket->rtpPacket.header.payloadType = payloadType;
+        pRollingBufferPacket->rtpPacket.header.sequenceNumber = *pRtpSeq;
+        pRollingBufferPacket->rtpPacket.header.ssrc = pTransceiver->ssrc;
+        if( pPayload->isMarker != 0U )
+        {
+            pRollingBufferPacket->rtpPacket.header.flags |= RTP_HEADER_FLAG_MARKER;
+        }
+
+        pRollingBufferPacket->rtpPacket.header.csrcCount = 0;
+        pRollingBufferPacket->rtpPacket.header.pCsrc = NULL;
+        pRollingBufferPacket->rtpPacket.header.timestamp = rtpTimestamp;
+
+        if( pSession->rtpConfig.twccId > 0 )
+        {
+            pRollingBufferPacket->rtpPacket.header.flags |= RTP_HEADER_FLAG_EXTENSION;
+            pRollingBufferPacket->rtpPacket.header.extension.extensionProfile = PEER_CONNECTION_SRTP_TWCC_EXT_PROFILE;
+            pRollingBufferPacket->rtpPacket.header.extension.extensionPayloadLength = 1;
+            pRollingBufferPacket->twccExtensionPayload = PEER_CONNECTION_SRTP_GET_TWCC_PAYLOAD( pSession->rtpConfig.twccId, pSession->rtpConfig.twccSequence );
+            pRollingBufferPacket->rtpPacket.header.extension.pExtensionPayload = &pRollingBufferPacket->twccExtensionPayload;
+
+            #if ENABLE_TWCC_SUPPORT
+            memset( &packetInfo, 0, sizeof( TwccPacketInfo_t ) );
+            packetInfo.packetSize = pPayload->payloadLength;
+            packetInfo.localSentTime = NetworkingUtils_GetCurrentTimeUs( NULL );
+            packetInfo.packetSeqNum = pSession->rtpConfig.twccSequence;
+
+            ( void ) PeerConnectionTwccHistory_AddPacketInfo( &pSession->twccHistory,
+                                                              &packetInfo );
+            #endif /* ENABLE_TWCC_SUPPORT */
+
+            hasTwccSequence = 1U;
+            twccSequence = pSession->rtpConfig.twccSequence;
+            pSession->rtpConfig.twccSequence++;
+        }
+
+        /* PeerConnectionSrtp_ConstructSrtpPacketInBatch() serializes RTP packet and encrypt it. */
+        ret = PeerConnectionSrtp_ConstructSrtpPacketInBatch( pSession,
+                                                             &pRollingBufferPacket->rtpPacket,
+                                                             pSrtpPacket,
+                                                             &srtpPacketLength );
+
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            /* Update the rolling buffer length before storing. */
+            if( bufferAfterEncrypt == 0 )
+            {
+                pRollingBufferPacket->packetBufferLength = pPayload->payloadLength;
+            }
+            else
+            {
+                pRollingBufferPacket->packetBufferLength = srtpPacketLength;
+
+                /* The packetized frame is reused for next frame, don't keep the reference in rolling buffer. */
+                pRollingBufferPacket->rtpPacket.pPayload = NULL;
+            }
+
+            /* Udpate the packet into rolling buffer. */
+            ret = PeerConnectionRollingBuffer_SetPacket( &pSrtpSender->txRollingBuffer,
+                                                         ( *pRtpSeq )++,
+                                                         pRollingBufferPacket );
+        }
+
+        if( ( ret != PEER_CONNECTION_RESULT_OK ) && ( pRollingBufferPacket != NULL ) )
+        {
+            /* If any failure, release the allocated RTP buffer. */
+            PeerConnectionRollingBuffer_DiscardRtpSequenceBuffer( &pSrtpSender->txRollingBuffer,
+                                                                  pRollingBufferPacket );
+        }
+
+        /* Write the constructed RTP packets through network. */
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            /* Queue the packet, the pacer spreads the packets of a frame over time instead of sending them in a burst. */
+            ret = PeerConnectionPacer_EnqueuePacket( &pSession->pacer,
+                                                     priority,
+                                                     pSrtpPacket,
+                                                     srtpPacketLength,
+                                                     hasTwccSequence,
+                                                     twccSequence );
+        }
+
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            packetSent++;
+            bytesSent += pPayload->payloadLength;
+        }
+
+        #if METRIC_PRINT_ENABLED
+        if( ret == PEER_CONNECTION_RESULT_OK )
+        {
+            Metric_EndEvent( METRIC_EVENT_SENDING_FIRST_FRAME );
+        }
+        #endif
+    }
+
+    if( packetSent != 0 )
+    {
+        if( pTransceiver->rtpSender.rtpFirstFrameWallClockTimeUs == 0 )
+        {
+            pTransceiver->rtpSender.rtpFirstFrameWallClockTimeUs = NetworkingUtils_GetCurrentTimeUs( NULL );
+            /* Sender reports map this wall clock time to the RTP timestamp of the first frame. */
+            pTransceiver->rtpSender.rtpTimeOffset = rtpTimestamp;
+        }
+
+        pTransceiver->rtcpStats.rtpPacketsTransmitted += packetSent;
+        pTransceiver->rtcpStats.rtpBytesTransmitted += bytesSent;
+    }
+
+    if( isBatchProtecting )
+    {
+        PeerConnectionSrtp_EndProtectBatch( pSession );
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionSrtp_WritePacketizedFrame( PeerConnectionSession_t * pSession,
+                                                                Transceiver_t * pTransceiver,
+                                                                const PeerConnectionPacketizedFrame_t * pPacketizedFrame )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionSrtpSender_t * pSrtpSender = NULL;
+
+    if( ( pSession == NULL ) ||
+        ( pTransceiver == NULL ) ||
+        ( pPacketizedFrame == NULL ) )
+    {
+        LogError( ( "Invalid input, pSession: %p, pTransceiver: %p, pPacketizedFrame: %p",
+                    pSession, pTransceiver, pPacketizedFrame ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        pSrtpSender = GetSrtpSender( pSession,
+                                     pTransceiver );
+        if( pSrtpSender == NULL )
+        {
+            ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_lock( &( pSrtpSender->senderMutex ) ) == 0 )
+        {
+            ret = WritePacketizedFrameLocked( pSession,
+                                              pTransceiver,
+                                              pSrtpSender,
+                                              pPacketizedFrame );
+            pthread_mutex_unlock( &( pSrtpSender->senderMutex ) );
+        }
+        else
+        {
+            LogError( ( "Fail to take sender mutex" ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SENDER_MUTEX;
+        }
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionSrtp_WriteFrame( PeerConnectionSession_t * pSession,
+                                                      Transceiver_t * pTransceiver,
+                                                      const PeerConnectionFrame_t * pFrame )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionSrtpSender_t * pSrtpSender = NULL;
+
+    if( ( pSession == NULL ) ||
+        ( pTransceiver == NULL ) ||
+        ( pFrame == NULL ) )
+    {
+        LogError( ( "Invalid input, pSession: %p, pTransceiver: %p, pFrame: %p",
+                    pSession, pTransceiver, pFrame ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        pSrtpSender = GetSrtpSender( pSession,
+                                     pTransceiver );
+        if( pSrtpSender == NULL )
+        {
+            ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* The sender's packetized frame is reused by every frame, so packetize and send under the sender mutex. */
+        if( pthread_mutex_lock( &( pSrtpSender->senderMutex ) ) == 0 )
+        {
+            ret = PeerConnectionSrtp_PacketizeFrame( pTransceiver,
+                                                     pFrame,
+                                                     &pSrtpSender->packetizedFrame );
+
+            if( ret == PEER_CONNECTION_RESULT_OK )
+            {
+                ret = WritePacketizedFrameLocked( pSession,
+                                                  pTransceiver,
+                                                  pSrtpSender,
+                                                  &pSrtpSender->packetizedFrame );
+            }
+
+            pthread_mutex_unlock( &( pSrtpSender->senderMutex ) );
+        }
+        else
+        {
+            LogError( ( "Fail to take sender mutex" ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SENDER_MUTEX;
+        }
+    }
+
+    return ret;
+}
@@ -0,0 +1,58 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PEER_CONNECTION_PACKETIZED_FRAME_HELPER_H
+#define PEER_CONNECTION_PACKETIZED_FRAME_HELPER_H
+
+/* Standard includes. */
+#include <stdint.h>
+
+#include "peer_connection_data_types.h"
+
+void PeerConnectionSrtp_ResetPacketizedFrame( PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                              uint32_t codecBit,
+                                              uint32_t clockRate,
+                                              uint64_t presentationUs );
+
+/* Release the buffers grown by the packetized frame. */
+void PeerConnectionSrtp_FreePacketizedFrame( PeerConnectionPacketizedFrame_t * pPacketizedFrame );
+
+/* Get the free space for next RTP payload, growing the frame if it's full. The returned length is limited so that
+ * the payload always fits into the rolling buffer, even if RTX is enabled. */
+PeerConnectionResult_t PeerConnectionSrtp_GetPacketizedPayloadBuffer( PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                                                      uint8_t ** ppPayloadBuffer,
+                                                                      size_t * pPayloadBufferLength );
+
+/* Commit the RTP payload written into the buffer from PeerConnectionSrtp_GetPacketizedPayloadBuffer(). */
+PeerConnectionResult_t PeerConnectionSrtp_AppendPacketizedPayload( PeerConnectionPacketizedFrame_t * pPacketizedFrame,
+                                                                   size_t payloadLength,
+                                                                   uint8_t isMarker );
+
+/* Packetize the frame with the preferred codec of the transceiver. */
+PeerConnectionResult_t PeerConnectionSrtp_PacketizeFrame( const Transceiver_t * pTransceiver,
+                                                          const PeerConnectionFrame_t * pFrame,
+                                                          PeerConnectionPacketizedFrame_t * pPacketizedFrame );
+
+PeerConnectionResult_t PeerConnectionSrtp_WritePacketizedFrame( PeerConnectionSession_t * pSession,
+                                                                Transceiver_t * pTransceiver,
+                                                                const PeerConnectionPacketizedFrame_t * pPacketizedFrame );
+
+/* Packetize the frame into the sender's packetized frame and send it. */
+PeerConnectionResult_t PeerConnectionSrtp_WriteFrame( PeerConnectionSession_t * pSession,
+                                                      Transceiver_t * pTransceiver,
+                                                      const PeerConnectionFrame_t * pFrame );
+
+#endif /* PEER_CONNECTION_PACKETIZED_FRAME_HELPER_H */
@@ -53,13 +53,35 @@ extern "C" {
 #define PEER_CONNECTION_CNAME_LENGTH ( 16 )
 #define PEER_CONNECTION_CERTIFICATE_FINGERPRINT_LENGTH ( CERTIFICATE_FINGERPRINT_LENGTH )
 #define PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM ( 1000 )
+/* The size of each packet buffer in jitter buffer packet pool, it must be able to store a whole decrypted RTP packet. */
+#define PEER_CONNECTION_JITTER_BUFFER_PACKET_BUFFER_SIZE ( 1400 )
+/* The maximum number of frames being assembled in jitter buffer at the same time. */
+#define PEER_CONNECTION_JITTER_BUFFER_MAX_FRAME_NUM ( 128 )
+/* The number of bits in the received bitmap of each frame, it's the maximum packet number of a frame.
+ * A frame spanning more sequence numbers would alias in the bitmap, it's dropped instead. */
+#define PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE ( 512 )
 #define PEER_CONNECTION_FRAME_BUFFER_SIZE ( 16384 )
+/* The range of RTP sequence numbers tracked by NACK generator, it must be a power of 2. */
+#define PEER_CONNECTION_NACK_GENERATOR_WINDOW_SIZE ( 512 )
 
 #define PEER_CONNECTION_FRAME_CURRENT_VERSION ( 0 )
 
+/* A packetized frame stores all RTP payloads of one frame, so it can be shared by all sessions.
+ * Its buffers start with room for this number of payloads and double whenever a frame needs more. */
+#define PEER_CONNECTION_PACKETIZED_FRAME_INITIAL_PAYLOAD_NUM ( 64 )
+
 #define PEER_CONNECTION_SDP_DESCRIPTION_BUFFER_MAX_LENGTH ( 10000 )
 
+/* The maximum number of packet status parsed from one transport-cc feedback packet received. */
 #define PEER_CONNECTION_RTCP_TWCC_MAX_ARRAY ( 100 )
+/* The default number of sent packets kept per session for the transport-cc feedback, it must be a power of 2. */
+#define PEER_CONNECTION_TWCC_HISTORY_DEFAULT_LENGTH ( 1024 )
+/* The range of transport-wide sequence numbers waiting for feedback, it must be a power of 2. */
+#define PEER_CONNECTION_TWCC_FEEDBACK_WINDOW_SIZE ( 1024 )
+/* The maximum number of packet status in one transport-cc feedback packet. */
+#define PEER_CONNECTION_TWCC_FEEDBACK_MAX_PACKET_STATUS_NUM ( 256 )
+/* The number of delay samples in the linear regression of delay-based bandwidth estimator. */
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_TRENDLINE_WINDOW_SIZE ( 20 )
 
 #define PEER_CONNECTION_MAX_DTLS_DECRYPTED_DATA_LENGTH ( 2048 )
 
@@ -71,6 +93,8 @@ extern "C" {
 #define PEER_CONNECTION_MAX_VIDEO_BITRATE_KBPS                     2048000 // Unit kilobits/sec. Value could change based on codec.
 #define PEER_CONNECTION_MIN_AUDIO_BITRATE_BPS                      4000    // Unit bits/sec. Value could change based on codec.
 #define PEER_CONNECTION_MAX_AUDIO_BITRATE_BPS                      650000  // Unit bits/sec. Value could change based on codec.
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MIN_BITRATE_BPS        ( ( uint64_t ) PEER_CONNECTION_MIN_VIDEO_BITRATE_KBPS * 1024U + PEER_CONNECTION_MIN_AUDIO_BITRATE_BPS )
+#define PEER_CONNECTION_BANDWIDTH_ESTIMATOR_MAX_BITRATE_BPS        ( ( uint64_t ) PEER_CONNECTION_MAX_VIDEO_BITRATE_KBPS * 1024U + PEER_CONNECTION_MAX_AUDIO_BITRATE_BPS )
 
 #define PEER_CONNECTION_WAIT_SDP_MESSAGE_TIMEOUT_MS    ( 12000 )
 #define PEER_CONNECTION_INACTIVE_CONNECTION_TIMEOUT_MS ( 30000 )
@@ -82,6 +106,7 @@ typedef enum PeerConnectionResult
     PEER_CONNECTION_RESULT_CLOSING,
     PEER_CONNECTION_RESULT_BAD_PARAMETER,
     PEER_CONNECTION_RESULT_NO_FREE_TRANSCEIVER,
+    PEER_CONNECTION_RESULT_INVALID_SESSION_STATE,
     PEER_CONNECTION_RESULT_FAIL_CREATE_TASK_ICE_CONTROLLER,
     PEER_CONNECTION_RESULT_FAIL_CREATE_TASK_ICE_SOCK_LISTENER,
     PEER_CONNECTION_RESULT_FAIL_CREATE_STARTUP_BARRIER,
@@ -126,6 +151,10 @@ typedef enum PeerConnectionResult
     PEER_CONNECTION_RESULT_FAIL_CREATE_TWCC_MUTEX,
     PEER_CONNECTION_RESULT_FAIL_TAKE_TWCC_MUTEX,
     PEER_CONNECTION_RESULT_FAIL_TAKE_BITRATE_MOD_MUTEX,
+    PEER_CONNECTION_RESULT_FAIL_CREATE_TWCC_HISTORY_MUTEX,
+    PEER_CONNECTION_RESULT_FAIL_TAKE_TWCC_HISTORY_MUTEX,
+    PEER_CONNECTION_RESULT_FAIL_TWCC_HISTORY_NO_ENOUGH_MEMORY,
+    PEER_CONNECTION_RESULT_TWCC_HISTORY_PACKET_NOT_FOUND,
     PEER_CONNECTION_RESULT_FAIL_TIMER_INIT,
     PEER_CONNECTION_RESULT_FAIL_TIMER_RESET,
     PEER_CONNECTION_RESULT_FAIL_RTCP_PARSE_TWCC,
@@ -135,18 +164,36 @@ typedef enum PeerConnectionResult
     PEER_CONNECTION_RESULT_FAIL_CREATE_SRTP_MUTEX,
     PEER_CONNECTION_RESULT_FAIL_INIT_DTLS_SESSION,
     PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX,
+    PEER_CONNECTION_RESULT_FAIL_CREATE_RECEPTION_STATS_MUTEX,
+    PEER_CONNECTION_RESULT_FAIL_TAKE_RECEPTION_STATS_MUTEX,
     PEER_CONNECTION_RESULT_FAIL_PACKET_INFO_NO_ENOUGH_MEMORY,
+    PEER_CONNECTION_RESULT_FAIL_ROLLING_BUFFER_SLAB_NO_ENOUGH_MEMORY,
+    PEER_CONNECTION_RESULT_FAIL_ROLLING_BUFFER_NO_FREE_SLOT,
+    PEER_CONNECTION_RESULT_FAIL_PACER_NO_ENOUGH_MEMORY,
+    PEER_CONNECTION_RESULT_FAIL_CREATE_PACER_MUTEX,
+    PEER_CONNECTION_RESULT_FAIL_TAKE_PACER_MUTEX,
+    PEER_CONNECTION_RESULT_FAIL_CREATE_PACER_TASK,
     PEER_CONNECTION_RESULT_FAIL_RTP_PACKET_QUEUE_INIT,
     PEER_CONNECTION_RESULT_FAIL_RTP_PACKET_QUEUE_RETRIEVE,
     PEER_CONNECTION_RESULT_FAIL_RTP_PACKET_ENQUEUE,
     PEER_CONNECTION_RESULT_FAIL_PACKETIZER_INIT,
     PEER_CONNECTION_RESULT_FAIL_PACKETIZER_ADD_FRAME,
     PEER_CONNECTION_RESULT_FAIL_PACKETIZER_GET_PACKET,
+    PEER_CONNECTION_RESULT_PACKETIZED_FRAME_CODEC_MISMATCH,
+    PEER_CONNECTION_RESULT_FAIL_PACKETIZED_FRAME_NO_ENOUGH_MEMORY,
     PEER_CONNECTION_RESULT_FAIL_DEPACKETIZER_INIT,
     PEER_CONNECTION_RESULT_FAIL_DEPACKETIZER_GET_PROPERTIES,
     PEER_CONNECTION_RESULT_FAIL_DEPACKETIZER_ADD_PACKET,
     PEER_CONNECTION_RESULT_FAIL_DEPACKETIZER_GET_FRAME,
     PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_SEQ_NOT_FOUND,
+    PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_POOL_NO_ENOUGH_MEMORY,
+    PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_PACKET_NO_ENOUGH_MEMORY,
+    PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_NO_FREE_FRAME,
+    PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_FRAME_TOO_LARGE,
+    PEER_CONNECTION_RESULT_FAIL_RTCP_SERIALIZE_NACK,
+    PEER_CONNECTION_RESULT_FAIL_RTCP_SERIALIZE_TWCC,
+    PEER_CONNECTION_RESULT_FAIL_RTCP_SERIALIZE_RECEIVER_REPORT,
+    PEER_CONNECTION_RESULT_NO_RECEPTION_STATS,
     PEER_CONNECTION_RESULT_FAIL_SDP_DESERIALIZE_OFFER,
     PEER_CONNECTION_RESULT_FAIL_SDP_GET_PAYLOAD_TYPES,
     PEER_CONNECTION_RESULT_FAIL_SDP_SET_PAYLOAD_TYPE,
@@ -162,6 +209,7 @@ typedef enum PeerConnectionResult
     PEER_CONNECTION_RESULT_UNKNOWN_CODEC,
     PEER_CONNECTION_RESULT_UNKNOWN_TRANSCEIVER,
     PEER_CONNECTION_RESULT_PACKET_OUTDATED,
+    PEER_CONNECTION_RESULT_PACKET_DUPLICATED,
     PEER_CONNECTION_RESULT_FAIL_SCTP_WRITE,
     PEER_CONNECTION_RESULT_FAIL_SCTP_READ,
     PEER_CONNECTION_RESULT_FAIL_SCTP_CLOSE,
@@ -194,6 +242,11 @@ typedef void (* OnIceCandidateReadyCallback_t)( void * pCustomContext,
 typedef void ( * OnPictureLossIndicationCallback_t )( void * pCustomContext,
                                                       RtcpPliPacket_t * pRtcpPliPacket );
 
+typedef void ( * OnReceiverEstimatedMaximumBitrateCallback_t )( void * pCustomContext,
+                                                                RtcpRembPacket_t * pRtcpRembPacket );
+
+typedef void ( * OnSessionClosedCallback_t )( void * pCustomContext );
+
 /*
  * Media relates data structures.
  */
@@ -205,6 +258,31 @@ typedef struct PeerConnectionFrame
     uint64_t presentationUs;
 } PeerConnectionFrame_t;
 
+typedef struct PeerConnectionPacketizedPayload
+{
+    /* Offset in pPayloadBuffer, the buffer moves when it grows. */
+    size_t payloadOffset;
+    size_t payloadLength;
+    uint8_t isMarker; /* Set RTP marker bit on this packet. */
+} PeerConnectionPacketizedPayload_t;
+
+typedef struct PeerConnectionPacketizedFrame
+{
+    /* The codec bit (TransceiverRtcCodecBit_t) used to packetize this frame. */
+    uint32_t codecBit;
+    uint64_t presentationUs;
+    uint32_t rtpTimestamp;
+
+    /* RTP payloads stored back to back in pPayloadBuffer. Start from a zeroed frame, the buffers grow to fit
+     * the largest frame and are kept for the next frames until PeerConnection_FreePacketizedFrame(). */
+    PeerConnectionPacketizedPayload_t * pPayloads;
+    size_t payloadNum;
+    size_t payloadCapacity;
+    uint8_t * pPayloadBuffer;
+    size_t payloadBufferSize;
+    size_t payloadBufferUsedLength;
+} PeerConnectionPacketizedFrame_t;
+
 typedef struct PeerConnectionJitterBufferPacket PeerConnectionJitterBufferPacket_t;
 typedef struct PeerConnectionJitterBuffer PeerConnectionJitterBuffer_t;
 
@@ -239,6 +317,14 @@ typedef struct PeerConnectionRollingBuffer
     RtpPacketQueue_t packetQueue;
     size_t maxSizePerPacket;
     size_t capacity;     /* Buffer duration * highest expected bitrate (in bps) / 8 / maxPacketSize. */
+
+    /* Fixed-size slab for the packets, allocated once at creation. Each slot is a
+     * PeerConnectionRollingBufferPacket_t followed by maxSizePerPacket bytes of packet buffer. */
+    uint8_t * pSlab;
+    size_t slabSlotSize;
+    size_t slabSlotCount;
+    size_t * pFreeSlotIndexes;
+    size_t freeSlotCount;
 } PeerConnectionRollingBuffer_t;
 
 typedef struct PeerConnectionJitterBufferPacket
@@ -246,15 +332,35 @@ typedef struct PeerConnectionJitterBufferPacket
     uint8_t isPushed;
     uint16_t sequenceNumber;
     uint32_t rtpTimestamp;
-    uint64_t receiveTick;
-    uint8_t * pPacketBuffer;
+    uint64_t receiveTick;     /* The monotonic arrival time in microseconds. */
+    uint8_t * pPacketBuffer;     /* The whole decrypted RTP packet, owned by this entry. */
     size_t packetBufferLength;
+    size_t payloadOffset;     /* The offset of RTP payload in pPacketBuffer. */
+    size_t payloadLength;
+    uint8_t isEndOfFrame;     /* The marker bit in RTP header is set. */
 } PeerConnectionJitterBufferPacket_t;
 
+typedef struct PeerConnectionJitterBufferFrame
+{
+    uint8_t isUsed;
+    uint8_t isStartReceived;     /* The start packet of this frame is received. */
+    uint8_t isEndReceived;     /* The packet with marker bit of this frame is received. */
+    uint32_t rtpTimestamp;     /* The key of this frame. */
+    uint16_t startSequenceNumber;
+    uint16_t endSequenceNumber;
+    uint16_t oldestSequenceNumber;     /* The oldest RTP sequence number received in this frame. */
+    uint16_t newestSequenceNumber;     /* The newest RTP sequence number received in this frame. */
+    uint8_t isTooLarge;     /* The frame spans more sequence numbers than its bitmap, it's dropped. */
+    uint64_t lastReceiveTimeUs;     /* The arrival time of the latest packet in this frame. */
+    uint16_t receivedPacketCount;
+    uint32_t receivedBitmap[ PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE / 32 ];     /* Indexed by RTP sequence number, to skip duplicated packets. */
+} PeerConnectionJitterBufferFrame_t;
+
 typedef struct PeerConnectionJitterBuffer
 {
     uint8_t isInit;
     uint8_t isStart;     /* The jitter buffer starts to receive packet or not. */
+    uint8_t isPopped;     /* Any frame has been popped or dropped, packets not newer than lastPopSequenceNumber are outdated. */
     size_t capacity;     /* The total number of packets that packet queue can store. */
     uint32_t clockRate;     /* The clock rate based on the codec. For example: the clock rate is 90000 if the chosen RTP is H264/90000. */
     uint32_t codec;     /* The codec. For example: the codec is set to H264 if the chosen RTP is H264/90000. */
@@ -265,7 +371,32 @@ typedef struct PeerConnectionJitterBuffer
     uint16_t oldestReceivedSequenceNumber;     /* The oldest RTP sequence number that received in the packet queue. */
     uint16_t newestReceivedSequenceNumber;     /* The newest RTP sequence number that received in the packet queue. */
     uint32_t newestReceivedTimestamp;     /* The newest timestamp in packet queue. */
+
+    /* Adaptive playout delay, it's how long a frame with missing packets is waited before dropping. */
+    uint64_t newestReceiveTimeUs;     /* The arrival time of newest pushed packet. */
+    uint64_t lastJitterReceiveTimeUs;     /* The arrival time of previous packet used in jitter estimation. */
+    uint32_t lastJitterRtpTimestamp;     /* The RTP timestamp of previous packet used in jitter estimation. */
+    uint8_t isJitterInit;
+    uint32_t jitter;     /* RFC 3550 interarrival jitter in RTP timestamp units, scaled by 16. */
+    uint64_t lateArrivalDelayUs;     /* Extra delay learned from packets that arrived after their frame was dropped. */
+    uint64_t lastDropReceiveTimeUs;     /* The arrival time of the latest packet in the latest dropped frame. */
+    uint16_t lastDropStartSequenceNumber;
+    uint16_t lastDropEndSequenceNumber;
+    uint8_t isDropped;
+    uint64_t playoutDelayUs;     /* The current playout delay. */
+    uint64_t maxPlayoutDelayUs;     /* The tolerence buffer time, the upper bound of playout delay. */
     PeerConnectionJitterBufferPacket_t rtpPackets[ PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM ];     /* The buffer for packet queue. */
+    /* The packet being decrypted, it only takes its entry in rtpPackets once it's authenticated and accepted,
+     * so a forged or replayed sequence number can't evict the packet already there. */
+    PeerConnectionJitterBufferPacket_t pendingPacket;
+    PeerConnectionJitterBufferFrame_t frames[ PEER_CONNECTION_JITTER_BUFFER_MAX_FRAME_NUM ];     /* The frames being assembled, keyed by RTP timestamp. */
+
+    /* Packet buffer pool, allocated once at creation. Each entry in rtpPackets and the pending packet hold at most one
+     * buffer, so PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM + 1 buffers are enough for the whole queue. */
+    uint8_t * pPacketBufferPool;
+    uint16_t * pFreePacketBufferIndexes;
+    size_t freePacketBufferCount;
+    uint64_t heapAllocationCount;     /* The number of packet buffers allocated from heap because the pool can't serve them. */
 
     /* Callback functions & custom contexts. */
     OnJitterBufferFrameReadyCallback_t onFrameReadyCallbackFunc;
@@ -276,6 +407,46 @@ typedef struct PeerConnectionJitterBuffer
     FillFrameFunc_t fillFrameFunc;
 } PeerConnectionJitterBuffer_t;
 
+typedef struct PeerConnectionNackGeneratorEntry
+{
+    uint8_t isMissing;
+    uint8_t retryCount;
+    uint64_t nextSendTimeUs;     /* The time to (re)send NACK for this sequence number. */
+} PeerConnectionNackGeneratorEntry_t;
+
+typedef struct PeerConnectionNackGenerator
+{
+    uint8_t isEnabled;
+    uint8_t isStarted;
+    uint16_t oldestSequenceNumber;     /* The oldest sequence number in the tracking window. */
+    uint16_t newestSequenceNumber;     /* The newest sequence number received. */
+    uint32_t missingCount;
+    uint64_t rttUs;     /* Round trip time, the interval between NACKs for the same sequence number. */
+    PeerConnectionNackGeneratorEntry_t entries[ PEER_CONNECTION_NACK_GENERATOR_WINDOW_SIZE ];     /* Indexed by RTP sequence number. */
+} PeerConnectionNackGenerator_t;
+
+/* RFC 3550 reception statistics of one inbound SSRC, see https://datatracker.ietf.org/doc/html/rfc3550#appendix-A.1 */
+typedef struct PeerConnectionReceptionStats
+{
+    /* The statistics are updated by the receiving thread and reported by the session task. */
+    pthread_mutex_t statsMutex;
+    uint8_t isMutexInit;
+    uint8_t isStarted;
+    uint32_t ssrc;
+    uint16_t maxSequenceNumber;     /* The highest sequence number received. */
+    uint32_t cycles;     /* Shifted count of sequence number cycles. */
+    uint32_t baseSequenceNumber;
+    uint32_t badSequenceNumber;     /* The last 'bad' sequence number + 1, to resync after a large jump. */
+    uint32_t receivedPacketCount;
+    uint32_t expectedPrior;     /* Packets expected at last report. */
+    uint32_t receivedPrior;     /* Packets received at last report. */
+    uint8_t isTransitInit;
+    uint32_t lastTransit;     /* Relative transit time of the previous packet, in RTP timestamp units. */
+    uint32_t jitter;     /* Estimated interarrival jitter, scaled by 16. */
+    uint32_t lastSenderReportNtp;     /* Middle 32 bits of the NTP timestamp in the last sender report received. */
+    uint64_t lastSenderReportReceiveTimeUs;
+} PeerConnectionReceptionStats_t;
+
 /*
  * Session relates data structures.
  */
@@ -286,10 +457,12 @@ typedef enum PeerConnectionSessionRequestType
     PEER_CONNECTION_SESSION_REQUEST_TYPE_PROCESS_ICE_CANDIDATES_AND_PAIRS,
     PEER_CONNECTION_SESSION_REQUEST_TYPE_PERIOD_CONNECTION_CHECK,
     PEER_CONNECTION_SESSION_REQUEST_TYPE_RTCP_SENDER_REPORT,
+    PEER_CONNECTION_SESSION_REQUEST_TYPE_RTCP_TWCC_FEEDBACK,
     PEER_CONNECTION_SESSION_REQUEST_TYPE_ICE_CLOSING,
     PEER_CONNECTION_SESSION_REQUEST_TYPE_ICE_CLOSED,
     PEER_CONNECTION_SESSION_REQUEST_TYPE_PEER_CONNECTION_CLOSE,
     PEER_CONNECTION_SESSION_REQUEST_TYPE_PEER_CONNECTION_CLOSE_NO_ICE_FLOW,
+    PEER_CONNECTION_SESSION_REQUEST_TYPE_ICE_SOCKET_READY,
 } PeerConnectionSessionRequestType_t;
 
 typedef struct PeerConnectionSessionRequestMessage
@@ -343,6 +516,9 @@ typedef struct PeerConnectionSrtpSender
     /* RTP Tx rolling buffer. */
     PeerConnectionRollingBuffer_t txRollingBuffer;
 
+    /* Frames written by PeerConnection_WriteFrame() are packetized here, under the sender mutex. */
+    PeerConnectionPacketizedFrame_t packetizedFrame;
+
     /* Mutex to protect sender info like rolling buffer. */
     pthread_mutex_t senderMutex;
     uint8_t isSenderMutexInit;
@@ -354,6 +530,12 @@ typedef struct PeerConnectionSrtpReceiver
     PeerConnectionJitterBuffer_t rxJitterBuffer;
     uint8_t frameBuffer[ PEER_CONNECTION_FRAME_BUFFER_SIZE ];
 
+    /* Track the lost packets and request retransmission by RTCP NACK. */
+    PeerConnectionNackGenerator_t nackGenerator;
+
+    /* Statistics reported to the remote sender in RTCP reception report blocks. */
+    PeerConnectionReceptionStats_t receptionStats;
+
     OnFrameReadyCallback_t onFrameReadyCallbackFunc;
     void * pOnFrameReadyCallbackCustomContext;
 } PeerConnectionSrtpReceiver_t;
@@ -367,9 +549,154 @@ typedef struct PeerConnectionSrtpReceiver
         uint32_t modifiedVideoBitrateKbps;
         uint64_t lastAdjustmentTimeUs;
         double averagePacketLoss;
+        uint64_t remoteEstimatedBitrateBps;     /* The latest REMB from the remote, 0 if none is received. */
     } PeerConnectionTwccMetaData_t;
+
+    typedef struct PeerConnectionTwccHistory
+    {
+        /* Mutex to protect the packet info, packets are added by sending threads and looked up by receiving thread. */
+        pthread_mutex_t historyMutex;
+        uint8_t isInit;
+        TwccPacketInfo_t * pPacketInfo;     /* Indexed by transport-wide sequence number. */
+        size_t length;     /* Must be a power of 2. */
+    } PeerConnectionTwccHistory_t;
+
+    typedef struct PeerConnectionTwccFeedback
+    {
+        /* Mutex to protect the arrival records, packets are recorded by receiving thread and reported by session task. */
+        pthread_mutex_t feedbackMutex;
+        uint8_t isMutexInit;
+        uint8_t isStarted;
+        uint8_t feedbackPacketCount;
+        uint16_t baseSequenceNumber;     /* The oldest transport-wide sequence number not reported yet. */
+        uint16_t newestSequenceNumber;
+        uint64_t arrivalTimesUs[ PEER_CONNECTION_TWCC_FEEDBACK_WINDOW_SIZE ];     /* Indexed by transport-wide sequence number, 0 means not received. */
+    } PeerConnectionTwccFeedback_t;
+
+    typedef enum PeerConnectionBandwidthUsage
+    {
+        PEER_CONNECTION_BANDWIDTH_USAGE_NORMAL = 0,
+        PEER_CONNECTION_BANDWIDTH_USAGE_UNDERUSING,
+        PEER_CONNECTION_BANDWIDTH_USAGE_OVERUSING,
+    } PeerConnectionBandwidthUsage_t;
+
+    typedef enum PeerConnectionRateControlState
+    {
+        PEER_CONNECTION_RATE_CONTROL_STATE_HOLD = 0,
+        PEER_CONNECTION_RATE_CONTROL_STATE_INCREASE,
+        PEER_CONNECTION_RATE_CONTROL_STATE_DECREASE,
+    } PeerConnectionRateControlState_t;
+
+    /* A group of packets sent in one burst, see https://datatracker.ietf.org/doc/html/draft-ietf-rmcat-gcc-02#section-5.2 */
+    typedef struct PeerConnectionBandwidthEstimatorPacketGroup
+    {
+        uint8_t isValid;
+        uint64_t firstSendTimeUs;
+        uint64_t lastSendTimeUs;
+        uint64_t lastArrivalTimeUs;
+    } PeerConnectionBandwidthEstimatorPacketGroup_t;
+
+    typedef struct PeerConnectionBandwidthEstimator
+    {
+        /* Inter-arrival delay variation between packet groups. */
+        PeerConnectionBandwidthEstimatorPacketGroup_t currentGroup;
+        PeerConnectionBandwidthEstimatorPacketGroup_t previousGroup;
+
+        /* Trendline filter over the accumulated delay variation. */
+        uint32_t numDeltas;
+        uint64_t firstArrivalTimeUs;
+        double accumulatedDelayMs;
+        double smoothedDelayMs;
+        double arrivalTimesMs[ PEER_CONNECTION_BANDWIDTH_ESTIMATOR_TRENDLINE_WINDOW_SIZE ];
+        double smoothedDelaysMs[ PEER_CONNECTION_BANDWIDTH_ESTIMATOR_TRENDLINE_WINDOW_SIZE ];
+        uint32_t trendlineSampleCount;
+        uint32_t trendlineSampleIndex;     /* The next slot to write, the samples form a ring. */
+        double previousTrend;
+
+        /* Over-use detector with adaptive threshold. */
+        double thresholdMs;
+        double overusingTimeMs;     /* Negative if not over-using. */
+        uint32_t overuseCount;
+        uint64_t lastThresholdUpdateTimeUs;
+        PeerConnectionBandwidthUsage_t bandwidthUsage;
+
+        /* Throughput acknowledged by the remote. */
+        uint64_t ackedWindowStartTimeUs;
+        uint64_t ackedWindowBytes;
+        uint64_t ackedBitrateBps;
+        double averagePacketSizeBytes;
+
+        /* AIMD rate controller. */
+        PeerConnectionRateControlState_t rateControlState;
+        uint64_t lastRateUpdateTimeUs;
+        uint64_t lastDecreaseTimeUs;
+        uint64_t linkCapacityBps;     /* Estimated at last decrease, 0 if unknown. */
+        uint64_t minBitrateBps;
+        uint64_t maxBitrateBps;
+        uint64_t targetBitrateBps;     /* The delay-based estimate of total sending bitrate. */
+    } PeerConnectionBandwidthEstimator_t;
 #endif
 
+/* The pacer queues, in the order of priority. */
+typedef enum PeerConnectionPacerPriority
+{
+    PEER_CONNECTION_PACER_PRIORITY_AUDIO = 0,
+    PEER_CONNECTION_PACER_PRIORITY_RETRANSMISSION,
+    PEER_CONNECTION_PACER_PRIORITY_VIDEO,
+    PEER_CONNECTION_PACER_PRIORITY_NUM,
+} PeerConnectionPacerPriority_t;
+
+/* The SRTP packet is stored after ICE_CONTROLLER_PACKET_HEADROOM bytes and followed by ICE_CONTROLLER_PACKET_TAILROOM bytes,
+ * so the ICE controller frames the TURN channel data in place when the packet leaves. */
+typedef struct PeerConnectionPacerPacket
+{
+    uint8_t buffer[ ICE_CONTROLLER_PACKET_HEADROOM + ICE_CONTROLLER_MAX_MTU + ICE_CONTROLLER_PACKET_TAILROOM ];
+    size_t packetLength;
+    uint8_t hasTransportSequenceNumber;
+    uint16_t transportSequenceNumber;
+    uint64_t departureTimeUs;     /* Monotonic time the kernel sends the packet, 0 means right away. */
+} PeerConnectionPacerPacket_t;
+
+typedef struct PeerConnectionPacerQueue
+{
+    PeerConnectionPacerPacket_t * pPackets;
+    size_t capacity;
+    size_t head;
+    size_t count;
+    size_t inFlightCount;     /* Packets right before head being sent by the pacer task, their slots can't be reused yet. */
+} PeerConnectionPacerQueue_t;
+
+typedef struct PeerConnectionPacer
+{
+    /* Mutex to protect the queues and the budget, packets are queued by media and receiving threads and sent by pacer task. */
+    pthread_mutex_t pacerMutex;
+    /* Wakes up the pacer task when a packet is queued to empty queues. */
+    pthread_cond_t pacerCond;
+    pthread_t pacerTask;
+    uint8_t isInit;
+    uint8_t isStopping;     /* Set by PeerConnectionPacer_Destroy() to make the pacer task exit. */
+
+    PeerConnectionPacerQueue_t queues[ PEER_CONNECTION_PACER_PRIORITY_NUM ];
+    size_t queuedPacketCount;
+    size_t queuedBytes;
+    uint64_t droppedPacketCount;     /* Packets dropped because their queue was full. */
+
+    uint64_t mediaBitrateBps;     /* The bitrate of all media sent, it caps the target bitrate. */
+    uint64_t targetBitrateBps;     /* The packets are released at a multiple of it, 0 means no pacing. */
+    int64_t budgetBits;     /* Bits allowed to be sent now, negative means the pacer is ahead of the rate. */
+    uint64_t lastBudgetUpdateTimeUs;     /* Monotonic time. */
+    uint64_t nextDepartureTimeUs;     /* Monotonic time of the next packet if the kernel paces them. */
+
+    IceControllerContext_t * pIceControllerContext;
+    /* Packets released in one round are sent from their queue slots without holding the pacer mutex. */
+    PeerConnectionPacerPacket_t * pReleasedPackets[ ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ];
+    IceControllerSendBatch_t sendBatch;
+    #if ENABLE_TWCC_SUPPORT
+        /* The send time of packets with transport-wide sequence number is updated when they leave the pacer. */
+        PeerConnectionTwccHistory_t * pTwccHistory;
+    #endif /* ENABLE_TWCC_SUPPORT */
+} PeerConnectionPacer_t;
+
 typedef struct PeerConnectionContext PeerConnectionContext_t;
 typedef struct PeerConnectionSession PeerConnectionSession_t;
 typedef struct PeerConnectionDataChannel PeerConnectionDataChannel_t;
@@ -400,7 +727,6 @@ typedef struct PeerConnectionSession
     volatile PeerConnectionSessionState_t state;
 
     pthread_t pTaskHandler;
-    pthread_t pSocketListener;
 
     /* Task synchronization using eventfd to block peer connection session until SetRemoteDescription completes.
      * That ensures ICE Controller processes candidates only after remote description is set, as ICE credentials
@@ -427,8 +753,10 @@ typedef struct PeerConnectionSession
 
     /* DTLS session. */
     DtlsSession_t dtlsSession;
-    /* SRTP sessions. */
-    pthread_mutex_t srtpSessionMutex;
+    /* SRTP sessions. The transmit and receive contexts are locked separately,
+     * so sending media never waits for the received packets being decrypted. */
+    pthread_mutex_t srtpTransmitMutex;
+    pthread_mutex_t srtpReceiveMutex;
     srtp_t srtpTransmitSession;
     srtp_t srtpReceiveSession;
     /* RTP config. */
@@ -447,6 +775,14 @@ typedef struct PeerConnectionSession
     OnPictureLossIndicationCallback_t onPictureLossIndicationCallback;
     void * pPictureLossIndicationUserContext;
 
+    /* REMB callback and context */
+    OnReceiverEstimatedMaximumBitrateCallback_t onReceiverEstimatedMaximumBitrateCallback;
+    void * pReceiverEstimatedMaximumBitrateUserContext;
+
+    /* Session closed callback and context, invoked once the session is back to inited for re-use. */
+    OnSessionClosedCallback_t onSessionClosedCallback;
+    void * pSessionClosedUserContext;
+
     #if ENABLE_SCTP_DATA_CHANNEL
         uint8_t ucEnableDataChannelLocal;
         uint8_t ucEnableDataChannelRemote;
@@ -462,6 +798,9 @@ typedef struct PeerConnectionSession
     PeerConnectionSrtpReceiver_t videoSrtpReceiver;
     PeerConnectionSrtpReceiver_t audioSrtpReceiver;
 
+    /* Outgoing RTP packets are spread over time by the pacer instead of sent in bursts. */
+    PeerConnectionPacer_t pacer;
+
     TimerHandler_t rtcpAudioSenderReportTimer;
     TimerHandler_t rtcpVideoSenderReportTimer;
     TimerHandler_t closeSessionTimer;
@@ -475,6 +814,16 @@ typedef struct PeerConnectionSession
         void * pOnBandwidthEstimationCallbackContext;
         
         PeerConnectionTwccMetaData_t twccMetaData;
+
+        /* Packets sent with transport-wide sequence number, waiting for the transport-cc feedback. */
+        PeerConnectionTwccHistory_t twccHistory;
+
+        /* Transport-cc feedback for the media received. */
+        PeerConnectionTwccFeedback_t twccFeedback;
+        TimerHandler_t twccFeedbackTimer;
+
+        /* Delay-based estimate driven by the transport-cc feedback received. */
+        PeerConnectionBandwidthEstimator_t bandwidthEstimator;
     #endif
 
     /* Pointer that points to peer connection context. */
@@ -495,6 +844,12 @@ typedef struct PeerConnectionSessionConfiguration
     size_t rootCaPathLength;
     char * pRootCaPem;
     size_t rootCaPemLength;
+
+    #if ENABLE_TWCC_SUPPORT
+        /* The number of sent packets kept for the transport-cc feedback, it must be a power of 2.
+         * Set 0 to use PEER_CONNECTION_TWCC_HISTORY_DEFAULT_LENGTH. */
+        size_t twccHistoryLength;
+    #endif /* ENABLE_TWCC_SUPPORT */
 } PeerConnectionSessionConfiguration_t;
 
 /*
@@ -521,11 +876,6 @@ typedef struct PeerConnectionContext
     PeerConnectionDtlsContext_t dtlsContext;
     RtpContext_t rtpContext;
     RtcpContext_t rtcpContext;
-
-    #if ENABLE_TWCC_SUPPORT
-        RtcpTwccManager_t rtcpTwccManager;
-        TwccPacketInfo_t twccPacketInfo[ PEER_CONNECTION_RTCP_TWCC_MAX_ARRAY ];
-    #endif
 } PeerConnectionContext_t;
 
 /* *INDENT-OFF* */
@@ -31,6 +31,17 @@
 #define PEER_CONNECTION_JITTER_BUFFER_WRAP( x, max ) ( ( x ) % max )
 #define PEER_CONNECTION_JITTER_BUFFER_INCREASE_WITH_WRAP( x, y, max ) ( PEER_CONNECTION_JITTER_BUFFER_WRAP( ( x ) + ( y ), max ) )
 #define PEER_CONNECTION_JITTER_BUFFER_DECREASE_WITH_WRAP( x, y, max ) ( PEER_CONNECTION_JITTER_BUFFER_WRAP( ( x ) - ( y ), max ) )
+/* Signed distance from b to a, taking wrapping into account. */
+#define PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( a, b ) ( ( int16_t )( ( uint16_t )( ( a ) - ( b ) ) ) )
+#define PEER_CONNECTION_JITTER_BUFFER_TIMESTAMP_DIFF( a, b ) ( ( int32_t )( ( uint32_t )( ( a ) - ( b ) ) ) )
+/* The playout delay is PEER_CONNECTION_JITTER_BUFFER_MIN_PLAYOUT_DELAY_US + PEER_CONNECTION_JITTER_BUFFER_JITTER_MULTIPLIER * jitter
+ * + late arrival delay, capped by the tolerence buffer time. */
+#define PEER_CONNECTION_JITTER_BUFFER_MIN_PLAYOUT_DELAY_US ( 10000 )
+#define PEER_CONNECTION_JITTER_BUFFER_JITTER_MULTIPLIER ( 4 )
+/* The late arrival delay decays by 1/256 for every frame popped in time. */
+#define PEER_CONNECTION_JITTER_BUFFER_LATE_ARRIVAL_DECAY_SHIFT ( 8 )
+/* One buffer for each entry, and one for the pending packet being decrypted. */
+#define PEER_CONNECTION_JITTER_BUFFER_POOL_BUFFER_NUM ( PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM + 1 )
 
 static void DiscardPacket( PeerConnectionJitterBuffer_t * pJitterBuffer,
                            PeerConnectionJitterBufferPacket_t * pPacket );
@@ -61,18 +72,18 @@ static void DiscardPackets( PeerConnectionJitterBuffer_t * pJitterBuffer,
     }
 }
 
-static uint8_t IsRtpPacketExpired( PeerConnectionJitterBuffer_t * pJitterBuffer,
-                                   PeerConnectionJitterBufferPacket_t * pPacket )
+static uint8_t IsRtpTimestampExpired( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                      uint32_t rtpTimestamp )
 {
     uint8_t isExpired = 0U;
     uint32_t earliestBufferTimestamp = 0U;
 
     earliestBufferTimestamp = pJitterBuffer->newestReceivedTimestamp - pJitterBuffer->tolerenceRtpTimeStamp;
     if( ( ( pJitterBuffer->newestReceivedTimestamp > earliestBufferTimestamp ) &&
-          ( pPacket->rtpTimestamp < earliestBufferTimestamp ) ) ||
+          ( rtpTimestamp < earliestBufferTimestamp ) ) ||
         ( ( pJitterBuffer->newestReceivedTimestamp < earliestBufferTimestamp ) &&
-          ( pPacket->rtpTimestamp < earliestBufferTimestamp ) &&
-          ( pPacket->rtpTimestamp > pJitterBuffer->newestReceivedTimestamp ) ) )
+          ( rtpTimestamp < earliestBufferTimestamp ) &&
+          ( rtpTimestamp > pJitterBuffer->newestReceivedTimestamp ) ) )
     {
         isExpired = 1U;
     }
@@ -80,16 +91,333 @@ static uint8_t IsRtpPacketExpired( PeerConnectionJitterBuffer_t * pJitterBuffer,
     return isExpired;
 }
 
+static uint8_t IsFrameExpired( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                               PeerConnectionJitterBufferFrame_t * pFrame )
+{
+    uint8_t isExpired = 0U;
+
+    if( ( pJitterBuffer->newestReceiveTimeUs >= pFrame->lastReceiveTimeUs ) &&
+        ( pJitterBuffer->newestReceiveTimeUs - pFrame->lastReceiveTimeUs >= pJitterBuffer->playoutDelayUs ) )
+    {
+        /* No packet of this frame arrived within the playout delay, the missing ones are not coming in time. */
+        isExpired = 1U;
+    }
+    else
+    {
+        isExpired = IsRtpTimestampExpired( pJitterBuffer,
+                                           pFrame->rtpTimestamp );
+    }
+
+    return isExpired;
+}
+
+static void UpdatePlayoutDelay( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                PeerConnectionJitterBufferPacket_t * pPacket )
+{
+    int64_t arrivalDiff;
+    int64_t transitDiff;
+    uint64_t jitterUs;
+
+    if( pPacket->receiveTick > pJitterBuffer->newestReceiveTimeUs )
+    {
+        pJitterBuffer->newestReceiveTimeUs = pPacket->receiveTick;
+    }
+
+    /* Only in-order packets are measured, reordered packets and retransmissions are not jitter of the link. */
+    if( ( pJitterBuffer->clockRate != 0U ) &&
+        ( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( pPacket->sequenceNumber, pJitterBuffer->newestReceivedSequenceNumber ) > 0 ) )
+    {
+        if( pJitterBuffer->isJitterInit != 0U )
+        {
+            /* RFC 3550 section 6.4.1, D(i,j) = (Rj - Ri) - (Sj - Si), J = J + (|D(i,j)| - J) / 16. */
+            arrivalDiff = ( int64_t )( pPacket->receiveTick - pJitterBuffer->lastJitterReceiveTimeUs ) * pJitterBuffer->clockRate / 1000000;
+            transitDiff = arrivalDiff - PEER_CONNECTION_JITTER_BUFFER_TIMESTAMP_DIFF( pPacket->rtpTimestamp, pJitterBuffer->lastJitterRtpTimestamp );
+            if( transitDiff < 0 )
+            {
+                transitDiff = -transitDiff;
+            }
+            if( transitDiff > ( int64_t ) pJitterBuffer->tolerenceRtpTimeStamp )
+            {
+                /* Timestamp jumps (e.g. the remote restarts the stream) are not jitter. */
+                transitDiff = pJitterBuffer->tolerenceRtpTimeStamp;
+            }
+            pJitterBuffer->jitter += ( uint32_t ) transitDiff - ( ( pJitterBuffer->jitter + 8U ) >> 4 );
+        }
+
+        pJitterBuffer->isJitterInit = 1U;
+        pJitterBuffer->lastJitterReceiveTimeUs = pPacket->receiveTick;
+        pJitterBuffer->lastJitterRtpTimestamp = pPacket->rtpTimestamp;
+
+        jitterUs = ( uint64_t )( pJitterBuffer->jitter >> 4 ) * 1000000 / pJitterBuffer->clockRate;
+        pJitterBuffer->playoutDelayUs = PEER_CONNECTION_JITTER_BUFFER_MIN_PLAYOUT_DELAY_US +
+                                        PEER_CONNECTION_JITTER_BUFFER_JITTER_MULTIPLIER * jitterUs +
+                                        pJitterBuffer->lateArrivalDelayUs;
+        if( pJitterBuffer->playoutDelayUs > pJitterBuffer->maxPlayoutDelayUs )
+        {
+            pJitterBuffer->playoutDelayUs = pJitterBuffer->maxPlayoutDelayUs;
+        }
+    }
+}
+
+static void RecordDroppedPackets( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                  PeerConnectionJitterBufferFrame_t * pFrame,
+                                  uint16_t startSeq,
+                                  uint16_t endSeq )
+{
+    pJitterBuffer->isDropped = 1U;
+    pJitterBuffer->lastDropStartSequenceNumber = startSeq;
+    pJitterBuffer->lastDropEndSequenceNumber = endSeq;
+    pJitterBuffer->lastDropReceiveTimeUs = pFrame->lastReceiveTimeUs;
+}
+
+static PeerConnectionJitterBufferFrame_t * GetOrCreateFrame( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                                             uint32_t rtpTimestamp )
+{
+    PeerConnectionJitterBufferFrame_t * pFrame = NULL;
+    PeerConnectionJitterBufferFrame_t * pFreeFrame = NULL;
+    size_t i;
+
+    for( i = 0; i < PEER_CONNECTION_JITTER_BUFFER_MAX_FRAME_NUM; i++ )
+    {
+        if( pJitterBuffer->frames[ i ].isUsed == 0U )
+        {
+            if( pFreeFrame == NULL )
+            {
+                pFreeFrame = &pJitterBuffer->frames[ i ];
+            }
+        }
+        else if( pJitterBuffer->frames[ i ].rtpTimestamp == rtpTimestamp )
+        {
+            pFrame = &pJitterBuffer->frames[ i ];
+            break;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+
+    if( ( pFrame == NULL ) &&
+        ( pFreeFrame != NULL ) )
+    {
+        memset( pFreeFrame, 0, sizeof( PeerConnectionJitterBufferFrame_t ) );
+        pFreeFrame->isUsed = 1U;
+        pFreeFrame->rtpTimestamp = rtpTimestamp;
+        pFrame = pFreeFrame;
+    }
+
+    return pFrame;
+}
+
+static PeerConnectionJitterBufferFrame_t * GetOldestFrame( PeerConnectionJitterBuffer_t * pJitterBuffer )
+{
+    PeerConnectionJitterBufferFrame_t * pOldestFrame = NULL;
+    size_t i;
+
+    for( i = 0; i < PEER_CONNECTION_JITTER_BUFFER_MAX_FRAME_NUM; i++ )
+    {
+        if( ( pJitterBuffer->frames[ i ].isUsed != 0U ) &&
+            ( ( pOldestFrame == NULL ) ||
+              ( PEER_CONNECTION_JITTER_BUFFER_TIMESTAMP_DIFF( pJitterBuffer->frames[ i ].rtpTimestamp, pOldestFrame->rtpTimestamp ) < 0 ) ) )
+        {
+            pOldestFrame = &pJitterBuffer->frames[ i ];
+        }
+    }
+
+    return pOldestFrame;
+}
+
+static uint8_t GetFrameEndSequence( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                    PeerConnectionJitterBufferFrame_t * pFrame,
+                                    uint16_t * pEndSeq )
+{
+    uint8_t isEndKnown = 0U;
+    PeerConnectionJitterBufferFrame_t * pNextFrame = NULL;
+    size_t i;
+
+    if( pFrame->isEndReceived != 0U )
+    {
+        /* The packet with marker bit is the last packet of the frame. */
+        *pEndSeq = pFrame->endSequenceNumber;
+        isEndKnown = 1U;
+    }
+    else
+    {
+        /* Otherwise the frame ends right before the start packet of next frame. */
+        for( i = 0; i < PEER_CONNECTION_JITTER_BUFFER_MAX_FRAME_NUM; i++ )
+        {
+            if( ( pJitterBuffer->frames[ i ].isUsed != 0U ) &&
+                ( PEER_CONNECTION_JITTER_BUFFER_TIMESTAMP_DIFF( pJitterBuffer->frames[ i ].rtpTimestamp, pFrame->rtpTimestamp ) > 0 ) &&
+                ( ( pNextFrame == NULL ) ||
+                  ( PEER_CONNECTION_JITTER_BUFFER_TIMESTAMP_DIFF( pJitterBuffer->frames[ i ].rtpTimestamp, pNextFrame->rtpTimestamp ) < 0 ) ) )
+            {
+                pNextFrame = &pJitterBuffer->frames[ i ];
+            }
+        }
+
+        if( ( pNextFrame != NULL ) &&
+            ( pNextFrame->isStartReceived != 0U ) )
+        {
+            *pEndSeq = ( uint16_t )( pNextFrame->startSequenceNumber - 1 );
+            isEndKnown = 1U;
+        }
+    }
+
+    return isEndKnown;
+}
+
+static uint8_t IsFrameComplete( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                PeerConnectionJitterBufferFrame_t * pFrame,
+                                uint16_t * pEndSeq )
+{
+    uint8_t isComplete = 0U;
+
+    /* A frame is complete when every packet from its start to its end is received. */
+    if( ( pFrame->isStartReceived != 0U ) &&
+        ( GetFrameEndSequence( pJitterBuffer, pFrame, pEndSeq ) != 0U ) &&
+        ( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( *pEndSeq, pFrame->startSequenceNumber ) >= 0 ) &&
+        ( pFrame->receivedPacketCount == ( uint16_t )( *pEndSeq - pFrame->startSequenceNumber + 1 ) ) )
+    {
+        isComplete = 1U;
+    }
+
+    return isComplete;
+}
+
+static void ReleaseFrame( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                          PeerConnectionJitterBufferFrame_t * pFrame,
+                          uint16_t endSeq )
+{
+    PeerConnectionJitterBufferPacket_t * pPacket;
+
+    if( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( endSeq, pJitterBuffer->oldestReceivedSequenceNumber ) >= 0 )
+    {
+        /* Packets from the oldest one to the end of this frame are consumed, move to the next sequence. */
+        pPacket = &pJitterBuffer->rtpPackets[ PEER_CONNECTION_JITTER_BUFFER_WRAP( endSeq, PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM ) ];
+        if( pPacket->isPushed != 0U )
+        {
+            pJitterBuffer->lastPopTick = pPacket->receiveTick;
+        }
+        DiscardPackets( pJitterBuffer,
+                        pJitterBuffer->oldestReceivedSequenceNumber,
+                        endSeq,
+                        NULL );
+        pJitterBuffer->lastPopSequenceNumber = endSeq;
+        pJitterBuffer->lastPopRtpTimestamp = pFrame->rtpTimestamp;
+        pJitterBuffer->oldestReceivedSequenceNumber = ( uint16_t )( endSeq + 1 );
+        pJitterBuffer->isPopped = 1U;
+    }
+
+    memset( pFrame, 0, sizeof( PeerConnectionJitterBufferFrame_t ) );
+}
+
+static PeerConnectionResult_t AddPacketToFrame( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                                PeerConnectionJitterBufferPacket_t * pPacket )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionJitterBufferFrame_t * pFrame = NULL;
+    uint8_t isStart = 0U;
+    uint16_t bitIndex;
+
+    if( ( pJitterBuffer->getPacketPropertyFunc == NULL ) ||
+        ( pJitterBuffer->getPacketPropertyFunc( pPacket,
+                                                &isStart ) != PEER_CONNECTION_RESULT_OK ) )
+    {
+        /* No get properties callback function or it returns failure. This packet is invalid, its frame can only expire. */
+        LogInfo( ( "Fail to get property, dumping RTP payload, 0x%x 0x%x 0x%x 0x%x",
+                   pPacket->pPacketBuffer[ pPacket->payloadOffset + 0 ],
+                   pPacket->pPacketBuffer[ pPacket->payloadOffset + 1 ],
+                   pPacket->pPacketBuffer[ pPacket->payloadOffset + 2 ],
+                   pPacket->pPacketBuffer[ pPacket->payloadOffset + 3 ] ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_DEPACKETIZER_GET_PROPERTIES;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        pFrame = GetOrCreateFrame( pJitterBuffer,
+                                   pPacket->rtpTimestamp );
+        if( pFrame == NULL )
+        {
+            LogWarn( ( "No free frame in jitter buffer, dropping packet with seq: %u, timestamp: %u",
+                       pPacket->sequenceNumber,
+                       pPacket->rtpTimestamp ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_NO_FREE_FRAME;
+        }
+    }
+
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+        ( pFrame->receivedPacketCount > 0U ) &&
+        ( ( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( pPacket->sequenceNumber, pFrame->oldestSequenceNumber ) >= PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE ) ||
+          ( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( pFrame->newestSequenceNumber, pPacket->sequenceNumber ) >= PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE ) ) )
+    {
+        /* The bitmap can't tell this packet from the one a bitmap size away, the frame would never complete. */
+        if( pFrame->isTooLarge == 0U )
+        {
+            LogWarn( ( "Frame with timestamp: %u spans more than %u packets, dropping it",
+                       pPacket->rtpTimestamp,
+                       PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE ) );
+            pFrame->isTooLarge = 1U;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+
+        ret = PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_FRAME_TOO_LARGE;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* Count each sequence number once, so a duplicated packet doesn't complete the frame early. */
+        bitIndex = PEER_CONNECTION_JITTER_BUFFER_WRAP( pPacket->sequenceNumber, PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE );
+        if( ( pFrame->receivedBitmap[ bitIndex / 32U ] & ( 1U << ( bitIndex % 32U ) ) ) == 0U )
+        {
+            pFrame->receivedBitmap[ bitIndex / 32U ] |= ( 1U << ( bitIndex % 32U ) );
+            pFrame->receivedPacketCount++;
+        }
+
+        if( ( isStart != 0U ) &&
+            ( ( pFrame->isStartReceived == 0U ) ||
+              ( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( pPacket->sequenceNumber, pFrame->startSequenceNumber ) < 0 ) ) )
+        {
+            pFrame->isStartReceived = 1U;
+            pFrame->startSequenceNumber = pPacket->sequenceNumber;
+        }
+
+        if( pPacket->isEndOfFrame != 0U )
+        {
+            pFrame->isEndReceived = 1U;
+            pFrame->endSequenceNumber = pPacket->sequenceNumber;
+        }
+
+        if( ( pFrame->receivedPacketCount == 1U ) ||
+            ( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( pPacket->sequenceNumber, pFrame->newestSequenceNumber ) > 0 ) )
+        {
+            pFrame->newestSequenceNumber = pPacket->sequenceNumber;
+        }
+
+        if( ( pFrame->receivedPacketCount == 1U ) ||
+            ( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( pPacket->sequenceNumber, pFrame->oldestSequenceNumber ) < 0 ) )
+        {
+            pFrame->oldestSequenceNumber = pPacket->sequenceNumber;
+        }
+
+        if( pPacket->receiveTick > pFrame->lastReceiveTimeUs )
+        {
+            pFrame->lastReceiveTimeUs = pPacket->receiveTick;
+        }
+    }
+
+    return ret;
+}
+
 static PeerConnectionResult_t ParseFramesInJitterBuffer( PeerConnectionJitterBuffer_t * pJitterBuffer,
                                                          int32_t isClosing )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
-    uint16_t i, index, prev;
-    PeerConnectionJitterBufferPacket_t * pPacket;
-    uint8_t isFrameDataContinuous = 1U;
-    uint8_t isStart;
-    int32_t popingPacketStartSeq = -1;
-    int32_t firstPacketSeq = -1;
+    PeerConnectionJitterBufferFrame_t * pFrame;
+    uint16_t endSeq;
+    uint8_t isComplete;
 
     if( pJitterBuffer == NULL )
     {
@@ -109,163 +437,92 @@ static PeerConnectionResult_t ParseFramesInJitterBuffer( PeerConnectionJitterBuf
         /* Empty else marker. */
     }
 
-    if( ret == PEER_CONNECTION_RESULT_OK )
+    /* Frames are popped in timestamp order. Only the oldest frame is checked each round, so the
+     * cost doesn't depend on how many packets are buffered. */
+    while( ret == PEER_CONNECTION_RESULT_OK )
     {
-        /* Note that newest sequence is probably less than oldest sequence due to wrapping. */
-        firstPacketSeq = pJitterBuffer->oldestReceivedSequenceNumber;
-        prev = firstPacketSeq;
-        for( i = pJitterBuffer->oldestReceivedSequenceNumber; i != ( uint16_t )( pJitterBuffer->newestReceivedSequenceNumber + 1 ); i++ )
+        pFrame = GetOldestFrame( pJitterBuffer );
+        if( pFrame == NULL )
         {
-            index = PEER_CONNECTION_JITTER_BUFFER_WRAP( i,
-                                                        PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM );
-            pPacket = &pJitterBuffer->rtpPackets[ index ];
-            if( pPacket->isPushed == 0U )
+            break;
+        }
+
+        isComplete = IsFrameComplete( pJitterBuffer, pFrame, &endSeq );
+        if( ( isComplete != 0U ) &&
+            ( pFrame->startSequenceNumber == pJitterBuffer->oldestReceivedSequenceNumber ) )
+        {
+            /* We now have an full frame ready between start index and end index. */
+            ret = pJitterBuffer->onFrameReadyCallbackFunc( pJitterBuffer->pOnFrameReadyCallbackContext,
+                                                           pFrame->startSequenceNumber,
+                                                           endSeq );
+            ReleaseFrame( pJitterBuffer, pFrame, endSeq );
+            pJitterBuffer->lateArrivalDelayUs -= pJitterBuffer->lateArrivalDelayUs >> PEER_CONNECTION_JITTER_BUFFER_LATE_ARRIVAL_DECAY_SHIFT;
+            if( ret != PEER_CONNECTION_RESULT_OK )
             {
-                isFrameDataContinuous = 0;
-                if( ( isClosing == 0U ) &&
-                    ( !IsRtpPacketExpired( pJitterBuffer, pPacket ) ) )
-                {
-                    /* Current frame is not completely received, break to wait for a while. */
-                    break;
-                }
+                LogError( ( "Terminating parsing jitter buffer by frame ready callback function, result: %d", ret ) );
             }
-            else
+        }
+        else if( ( isComplete != 0U ) &&
+                 ( isClosing == 0 ) &&
+                 ( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( pFrame->startSequenceNumber, pJitterBuffer->oldestReceivedSequenceNumber ) > 0 ) &&
+                 ( IsFrameExpired( pJitterBuffer, pFrame ) != 0U ) )
+        {
+            /* The missing packets before this complete frame are expired, drop them and pop this frame in next round. */
+            ret = pJitterBuffer->onFrameDropCallbackFunc( pJitterBuffer->pOnFrameDropCallbackContext,
+                                                          pJitterBuffer->oldestReceivedSequenceNumber,
+                                                          ( uint16_t )( pFrame->startSequenceNumber - 1 ) );
+            RecordDroppedPackets( pJitterBuffer,
+                                  pFrame,
+                                  pJitterBuffer->oldestReceivedSequenceNumber,
+                                  ( uint16_t )( pFrame->startSequenceNumber - 1 ) );
+            DiscardPackets( pJitterBuffer,
+                            pJitterBuffer->oldestReceivedSequenceNumber,
+                            ( uint16_t )( pFrame->startSequenceNumber - 1 ),
+                            NULL );
+            pJitterBuffer->lastPopSequenceNumber = ( uint16_t )( pFrame->startSequenceNumber - 1 );
+            pJitterBuffer->oldestReceivedSequenceNumber = pFrame->startSequenceNumber;
+            pJitterBuffer->isPopped = 1U;
+            if( ret != PEER_CONNECTION_RESULT_OK )
             {
-                if( pPacket->rtpTimestamp != pJitterBuffer->lastPopRtpTimestamp )
-                {
-                    if( ( popingPacketStartSeq != -1 ) &&
-                        ( isFrameDataContinuous != 0U ) )
-                    {
-                        /* We now have an full frame ready between start index and end index. */
-                        if( pJitterBuffer->onFrameReadyCallbackFunc )
-                        {
-                            ret = pJitterBuffer->onFrameReadyCallbackFunc( pJitterBuffer->pOnFrameReadyCallbackContext,
-                                                                           popingPacketStartSeq,
-                                                                           prev );
-                        }
-                        DiscardPackets( pJitterBuffer,
-                                        popingPacketStartSeq,
-                                        prev,
-                                        pPacket );
-                        popingPacketStartSeq = -1;
-                        firstPacketSeq = i;
-                        if( ret != PEER_CONNECTION_RESULT_OK )
-                        {
-                            LogError( ( "Terminating parsing jitter buffer by frame ready callback function, result: %d", ret ) );
-                            break;
-                        }
-                    }
-                    else if( IsRtpPacketExpired( pJitterBuffer, pPacket ) )
-                    {
-                        /* data is expired, drop them */
-                        if( pJitterBuffer->onFrameDropCallbackFunc )
-                        {
-                            ret = pJitterBuffer->onFrameDropCallbackFunc( pJitterBuffer->pOnFrameReadyCallbackContext,
-                                                                          firstPacketSeq,
-                                                                          prev );
-                        }
-                        DiscardPackets( pJitterBuffer,
-                                        firstPacketSeq,
-                                        prev,
-                                        pPacket );
-                        popingPacketStartSeq = -1;
-                        firstPacketSeq = i;
-                        if( ret != PEER_CONNECTION_RESULT_OK )
-                        {
-                            LogError( ( "Terminating parsing jitter buffer by frame drop callback function, result: %d", ret ) );
-                            break;
-                        }
-                    }
-                    else
-                    {
-                        /* The following packets are still in tolerence timestamp, not necessary to parse them for now. */
-                        break;
-                    }
-                }
+                LogError( ( "Terminating parsing jitter buffer by frame drop callback function, result: %d", ret ) );
+            }
+        }
+        else if( ( isClosing != 0 ) ||
+                 ( pFrame->isTooLarge != 0U ) ||
+                 ( IsFrameExpired( pJitterBuffer, pFrame ) != 0U ) )
+        {
+            /* Data is expired or can't be assembled, drop everything up to the last received packet of this frame. */
+            if( ( GetFrameEndSequence( pJitterBuffer, pFrame, &endSeq ) == 0U ) ||
+                ( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( endSeq, pFrame->newestSequenceNumber ) < 0 ) )
+            {
+                endSeq = pFrame->newestSequenceNumber;
             }
 
-            if( pPacket->rtpTimestamp == pJitterBuffer->lastPopRtpTimestamp )
+            ret = pJitterBuffer->onFrameDropCallbackFunc( pJitterBuffer->pOnFrameDropCallbackContext,
+                                                          pJitterBuffer->oldestReceivedSequenceNumber,
+                                                          endSeq );
+            RecordDroppedPackets( pJitterBuffer,
+                                  pFrame,
+                                  pJitterBuffer->oldestReceivedSequenceNumber,
+                                  endSeq );
+            ReleaseFrame( pJitterBuffer, pFrame, endSeq );
+            if( ret != PEER_CONNECTION_RESULT_OK )
             {
-                if( ( pJitterBuffer->getPacketPropertyFunc ) &&
-                    ( pJitterBuffer->getPacketPropertyFunc( pPacket,
-                                                            &isStart ) == PEER_CONNECTION_RESULT_OK ) )
+                if( isClosing != 0 )
                 {
-                    if( ( popingPacketStartSeq == -1 ) &&
-                        ( isStart != 0U ) )
-                    {
-                        popingPacketStartSeq = i;
-                    }
+                    LogWarn( ( "Getting error return in drop frame callback function while closing jitter buffer, result: %d", ret ) );
+                    ret = PEER_CONNECTION_RESULT_OK;
                 }
                 else
                 {
-                    /* No get properties callback function or it returns failure. This packet is invalid, drop it. */
-                    isFrameDataContinuous = 0;
-                    LogInfo( ( "Fail to get property, dumping RTP payload, 0x%x 0x%x 0x%x 0x%x",
-                               pPacket->pPacketBuffer[0],
-                               pPacket->pPacketBuffer[1],
-                               pPacket->pPacketBuffer[2],
-                               pPacket->pPacketBuffer[3] ) );
-                    DiscardPacket( pJitterBuffer,
-                                   pPacket );
-                    if( ( isClosing == 0U ) &&
-                        ( !IsRtpPacketExpired( pJitterBuffer, pPacket ) ) )
-                    {
-                        /* Detect invalid packet */
-                        break;
-                    }
+                    LogError( ( "Terminating parsing jitter buffer by frame drop callback function, result: %d", ret ) );
                 }
             }
-
-            prev = i;
         }
-
-        /* Deal with last frame when closing */
-        if( isClosing != 0U )
+        else
         {
-            firstPacketSeq = pJitterBuffer->oldestReceivedSequenceNumber;
-            prev = firstPacketSeq;
-            for( i = pJitterBuffer->oldestReceivedSequenceNumber; i != ( uint16_t )( pJitterBuffer->newestReceivedSequenceNumber + 1 ); i++ )
-            {
-                index = PEER_CONNECTION_JITTER_BUFFER_WRAP( i,
-                                                            PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM );
-                pPacket = &pJitterBuffer->rtpPackets[ index ];
-                if( pPacket->isPushed == 0U )
-                {
-                    if( pJitterBuffer->onFrameDropCallbackFunc )
-                    {
-                        ret = pJitterBuffer->onFrameDropCallbackFunc( pJitterBuffer->pOnFrameReadyCallbackContext,
-                                                                      firstPacketSeq,
-                                                                      prev );
-                    }
-                    DiscardPackets( pJitterBuffer,
-                                    firstPacketSeq,
-                                    prev,
-                                    NULL );
-                    firstPacketSeq = i;
-                    if( ret != PEER_CONNECTION_RESULT_OK )
-                    {
-                        LogWarn( ( "Getting error return in drop frame callback function while closing jitter buffer, result: %d", ret ) );
-                        continue;
-                    }
-                }
-
-                prev = i;
-            }
-
-            if( pJitterBuffer->onFrameDropCallbackFunc )
-            {
-                ret = pJitterBuffer->onFrameDropCallbackFunc( pJitterBuffer->pOnFrameReadyCallbackContext,
-                                                              firstPacketSeq,
-                                                              prev );
-            }
-            DiscardPackets( pJitterBuffer,
-                            firstPacketSeq,
-                            prev,
-                            NULL );
-            if( ret != PEER_CONNECTION_RESULT_OK )
-            {
-                LogWarn( ( "Getting error return in drop frame callback function while closing jitter buffer, result: %d", ret ) );
-            }
+            /* The oldest frame is still in tolerence timestamp, wait for its missing packets. */
+            break;
         }
     }
 
@@ -285,6 +542,36 @@ static PeerConnectionResult_t ShouldAcceptPacket( PeerConnectionJitterBuffer_t *
         ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
 
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+        ( pJitterBuffer->isPopped != 0U ) &&
+        ( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( pPacket->sequenceNumber, pJitterBuffer->lastPopSequenceNumber ) <= 0 ) )
+    {
+        /* The frame of this packet has been popped or dropped already. */
+        ret = PEER_CONNECTION_RESULT_PACKET_OUTDATED;
+
+        if( ( pJitterBuffer->isDropped != 0U ) &&
+            ( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( pPacket->sequenceNumber, pJitterBuffer->lastDropStartSequenceNumber ) >= 0 ) &&
+            ( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( pJitterBuffer->lastDropEndSequenceNumber, pPacket->sequenceNumber ) >= 0 ) &&
+            ( pPacket->receiveTick - pJitterBuffer->lastDropReceiveTimeUs > pJitterBuffer->playoutDelayUs ) &&
+            ( pPacket->receiveTick > pJitterBuffer->lastDropReceiveTimeUs ) )
+        {
+            /* The packet was dropped too early, e.g. a retransmission, wait long enough for it next time with some margin. */
+            pJitterBuffer->lateArrivalDelayUs += pPacket->receiveTick - pJitterBuffer->lastDropReceiveTimeUs - pJitterBuffer->playoutDelayUs +
+                                                 PEER_CONNECTION_JITTER_BUFFER_MIN_PLAYOUT_DELAY_US;
+            if( pJitterBuffer->lateArrivalDelayUs > pJitterBuffer->maxPlayoutDelayUs )
+            {
+                pJitterBuffer->lateArrivalDelayUs = pJitterBuffer->maxPlayoutDelayUs;
+            }
+            pJitterBuffer->isDropped = 0U;
+            LogInfo( ( "Packet seq: %u arrived after being dropped, late arrival delay: %lu us",
+                       pPacket->sequenceNumber,
+                       pJitterBuffer->lateArrivalDelayUs ) );
+        }
+        LogInfo( ( "Dropping packet with seq: %u because it's not newer than last pop seq: %u",
+                   pPacket->sequenceNumber,
+                   pJitterBuffer->lastPopSequenceNumber ) );
+    }
+
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         rtpSeqOffset = pJitterBuffer->capacity / 2;
@@ -335,37 +622,20 @@ static PeerConnectionResult_t UpdateJitterBufferAddPacket( PeerConnectionJitterB
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        /* Update newest sequence number. */
-        if( pPacket->sequenceNumber > pJitterBuffer->newestReceivedSequenceNumber )
+        /* Update newest sequence number, the packet is already in the tolerence range so the signed distance handles wrapping. */
+        if( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( pPacket->sequenceNumber, pJitterBuffer->newestReceivedSequenceNumber ) > 0 )
         {
             /* The RTP sequence number in packet is just larger than newest one. */
             pJitterBuffer->newestReceivedSequenceNumber = pPacket->sequenceNumber;
         }
-        else if( ( ( pJitterBuffer->newestReceivedSequenceNumber + PEER_CONNECTION_JITTER_BUFFER_SEQ_WRAPPER_THRESHOLD ) & 0xFFFF ) <= pPacket->sequenceNumber )
-        {
-            /* Overflow is happening, we update the newest sequence number only if it's in the range of threshold. */
-            pJitterBuffer->newestReceivedSequenceNumber = pPacket->sequenceNumber;
-        }
-        else
-        {
-            /* Do nothing for non newest packets. */
-        }
 
-        /* Update oldest sequecen number. */
-        if( pPacket->sequenceNumber < pJitterBuffer->oldestReceivedSequenceNumber )
+        /* Update oldest sequecen number. Once a frame is popped, the oldest sequence number only moves forward with popping. */
+        if( ( pJitterBuffer->isPopped == 0U ) &&
+            ( PEER_CONNECTION_JITTER_BUFFER_SEQ_DIFF( pPacket->sequenceNumber, pJitterBuffer->oldestReceivedSequenceNumber ) < 0 ) )
         {
             /* The RTP sequence number in packet is just older than oldest one. */
             pJitterBuffer->oldestReceivedSequenceNumber = pPacket->sequenceNumber;
         }
-        else if( ( ( pJitterBuffer->oldestReceivedSequenceNumber - PEER_CONNECTION_JITTER_BUFFER_SEQ_WRAPPER_THRESHOLD ) & 0xFFFF ) <= pPacket->sequenceNumber )
-        {
-            /* Overflow is happening, we update the newest sequence number only if it's in the range of threshold. */
-            pJitterBuffer->newestReceivedSequenceNumber = pPacket->sequenceNumber;
-        }
-        else
-        {
-            /* Do nothing for non newest packets. */
-        }
 
         /* Update newest timestamp. */
         if( pPacket->rtpTimestamp > pJitterBuffer->newestReceivedTimestamp )
@@ -402,13 +672,70 @@ static PeerConnectionResult_t UpdateJitterBufferAddPacket( PeerConnectionJitterB
     return ret;
 }
 
+static uint8_t * AcquirePacketBuffer( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                      size_t packetBufferSize )
+{
+    uint8_t * pPacketBuffer = NULL;
+
+    if( ( packetBufferSize <= PEER_CONNECTION_JITTER_BUFFER_PACKET_BUFFER_SIZE ) &&
+        ( pJitterBuffer->freePacketBufferCount > 0 ) )
+    {
+        pJitterBuffer->freePacketBufferCount--;
+        pPacketBuffer = pJitterBuffer->pPacketBufferPool + pJitterBuffer->pFreePacketBufferIndexes[ pJitterBuffer->freePacketBufferCount ] * PEER_CONNECTION_JITTER_BUFFER_PACKET_BUFFER_SIZE;
+    }
+    else
+    {
+        /* The pool can't serve this packet, fall back to heap. */
+        pPacketBuffer = ( uint8_t * )malloc( packetBufferSize );
+        pJitterBuffer->heapAllocationCount++;
+        LogWarn( ( "Allocating jitter buffer packet from heap, packet size: %lu, free pool buffers: %lu, heap allocation count: %lu",
+                   packetBufferSize,
+                   pJitterBuffer->freePacketBufferCount,
+                   pJitterBuffer->heapAllocationCount ) );
+    }
+
+    return pPacketBuffer;
+}
+
+static void ReleasePacketBuffer( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                 uint8_t * pPacketBuffer )
+{
+    if( ( pJitterBuffer->pPacketBufferPool != NULL ) &&
+        ( pPacketBuffer >= pJitterBuffer->pPacketBufferPool ) &&
+        ( pPacketBuffer < pJitterBuffer->pPacketBufferPool + PEER_CONNECTION_JITTER_BUFFER_POOL_BUFFER_NUM * PEER_CONNECTION_JITTER_BUFFER_PACKET_BUFFER_SIZE ) )
+    {
+        /* Return the buffer to the pool. */
+        pJitterBuffer->pFreePacketBufferIndexes[ pJitterBuffer->freePacketBufferCount++ ] = ( uint16_t )( ( pPacketBuffer - pJitterBuffer->pPacketBufferPool ) / PEER_CONNECTION_JITTER_BUFFER_PACKET_BUFFER_SIZE );
+    }
+    else
+    {
+        free( pPacketBuffer );
+    }
+}
+
+static void FreePacketBufferPool( PeerConnectionJitterBuffer_t * pJitterBuffer )
+{
+    if( pJitterBuffer->pPacketBufferPool != NULL )
+    {
+        free( pJitterBuffer->pPacketBufferPool );
+        pJitterBuffer->pPacketBufferPool = NULL;
+    }
+
+    if( pJitterBuffer->pFreePacketBufferIndexes != NULL )
+    {
+        free( pJitterBuffer->pFreePacketBufferIndexes );
+        pJitterBuffer->pFreePacketBufferIndexes = NULL;
+    }
+
+    pJitterBuffer->freePacketBufferCount = 0;
+}
+
 static void DiscardPacket( PeerConnectionJitterBuffer_t * pJitterBuffer,
                            PeerConnectionJitterBufferPacket_t * pPacket )
 {
-    ( void ) pJitterBuffer;
     if( pPacket && ( pPacket->pPacketBuffer != NULL ) )
     {
-        free( pPacket->pPacketBuffer );
+        ReleasePacketBuffer( pJitterBuffer, pPacket->pPacketBuffer );
         memset( pPacket, 0, sizeof( PeerConnectionJitterBufferPacket_t ) );
     }
 }
@@ -423,6 +750,7 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_Create( PeerConnectionJitterBu
                                                           uint32_t clockRate )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    uint16_t i;
 
     if( ( pJitterBuffer == NULL ) ||
         ( codec == 0 ) )
@@ -446,6 +774,8 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_Create( PeerConnectionJitterBu
         pJitterBuffer->oldestReceivedSequenceNumber = 0U;
         /* Converting tolerence buffer in seconds into RTP time stamp format. */
         pJitterBuffer->tolerenceRtpTimeStamp = tolerenceBufferSec * ( clockRate );
+        pJitterBuffer->maxPlayoutDelayUs = ( uint64_t ) tolerenceBufferSec * 1000 * 1000;
+        pJitterBuffer->playoutDelayUs = pJitterBuffer->maxPlayoutDelayUs;
 
         pJitterBuffer->onFrameReadyCallbackFunc = onFrameReadyCallbackFunc;
         pJitterBuffer->pOnFrameReadyCallbackContext = pOnFrameReadyCallbackContext;
@@ -495,6 +825,28 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_Create( PeerConnectionJitterBu
         }
     }
 
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* Allocate all packet buffers at once, so receiving doesn't need any heap allocation. */
+        pJitterBuffer->pPacketBufferPool = ( uint8_t * )malloc( PEER_CONNECTION_JITTER_BUFFER_POOL_BUFFER_NUM * PEER_CONNECTION_JITTER_BUFFER_PACKET_BUFFER_SIZE );
+        pJitterBuffer->pFreePacketBufferIndexes = ( uint16_t * )malloc( PEER_CONNECTION_JITTER_BUFFER_POOL_BUFFER_NUM * sizeof( uint16_t ) );
+        if( ( pJitterBuffer->pPacketBufferPool == NULL ) || ( pJitterBuffer->pFreePacketBufferIndexes == NULL ) )
+        {
+            LogError( ( "No memory available for allocating jitter buffer packet pool with total size %lu",
+                        ( size_t ) PEER_CONNECTION_JITTER_BUFFER_POOL_BUFFER_NUM * PEER_CONNECTION_JITTER_BUFFER_PACKET_BUFFER_SIZE ) );
+            FreePacketBufferPool( pJitterBuffer );
+            ret = PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_POOL_NO_ENOUGH_MEMORY;
+        }
+        else
+        {
+            for( i = 0; i < PEER_CONNECTION_JITTER_BUFFER_POOL_BUFFER_NUM; i++ )
+            {
+                pJitterBuffer->pFreePacketBufferIndexes[ i ] = PEER_CONNECTION_JITTER_BUFFER_POOL_BUFFER_NUM - 1 - i;
+            }
+            pJitterBuffer->freePacketBufferCount = PEER_CONNECTION_JITTER_BUFFER_POOL_BUFFER_NUM;
+        }
+    }
+
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         pJitterBuffer->isInit = 1U;
@@ -533,16 +885,19 @@ void PeerConnectionJitterBuffer_Free( PeerConnectionJitterBuffer_t * pJitterBuff
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         DiscardPackets( pJitterBuffer, 0, PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM - 1, NULL );
+        DiscardPacket( pJitterBuffer, &pJitterBuffer->pendingPacket );
+
+        /* All packets have been returned to the pool, release it in one call. */
+        LogInfo( ( "Freeing jitter buffer, packets allocated from heap during its lifetime: %lu", pJitterBuffer->heapAllocationCount ) );
+        FreePacketBufferPool( pJitterBuffer );
     }
 }
 
 PeerConnectionResult_t PeerConnectionJitterBuffer_AllocateBuffer( PeerConnectionJitterBuffer_t * pJitterBuffer,
                                                                   PeerConnectionJitterBufferPacket_t ** ppOutPacket,
-                                                                  size_t packetBufferSize,
-                                                                  uint16_t rtpSeq )
+                                                                  size_t packetBufferSize )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
-    int index = PEER_CONNECTION_JITTER_BUFFER_WRAP( rtpSeq, PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM );
 
     if( ( pJitterBuffer == NULL ) ||
         ( ppOutPacket == NULL ) )
@@ -567,20 +922,53 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_AllocateBuffer( PeerConnection
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        *ppOutPacket = &pJitterBuffer->rtpPackets[index];
+        /* The sequence number in the header isn't authenticated yet, don't touch the entry it points to. */
+        *ppOutPacket = &pJitterBuffer->pendingPacket;
         if( ( *ppOutPacket )->pPacketBuffer != NULL )
         {
-            /* Remove old information. */
+            /* The previous pending packet was neither pushed nor discarded. */
             DiscardPacket( pJitterBuffer, *ppOutPacket );
         }
 
-        ( *ppOutPacket )->pPacketBuffer = ( uint8_t * )malloc( packetBufferSize );
-        ( *ppOutPacket )->packetBufferLength = packetBufferSize;
+        memset( *ppOutPacket, 0, sizeof( PeerConnectionJitterBufferPacket_t ) );
+        ( *ppOutPacket )->pPacketBuffer = AcquirePacketBuffer( pJitterBuffer, packetBufferSize );
+        if( ( *ppOutPacket )->pPacketBuffer == NULL )
+        {
+            LogError( ( "No memory available for allocating jitter buffer packet with size %lu", packetBufferSize ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_PACKET_NO_ENOUGH_MEMORY;
+        }
+        else
+        {
+            ( *ppOutPacket )->packetBufferLength = packetBufferSize;
+            ( *ppOutPacket )->payloadLength = packetBufferSize;
+        }
     }
 
     return ret;
 }
 
+void PeerConnectionJitterBuffer_DiscardBuffer( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                               PeerConnectionJitterBufferPacket_t * pPacket )
+{
+    if( ( pJitterBuffer == NULL ) ||
+        ( pPacket == NULL ) )
+    {
+        LogError( ( "Invalid input, pJitterBuffer: %p, pPacket: %p", pJitterBuffer, pPacket ) );
+    }
+    else if( pJitterBuffer->isInit == 0U )
+    {
+        LogWarn( ( "Jitter buffer is not initialized yet or it has been freed." ) );
+    }
+    else if( pPacket->isPushed != 0U )
+    {
+        LogWarn( ( "The packet seq: %u has been pushed, it's released by jitter buffer.", pPacket->sequenceNumber ) );
+    }
+    else
+    {
+        DiscardPacket( pJitterBuffer, pPacket );
+    }
+}
+
 PeerConnectionResult_t PeerConnectionJitterBuffer_GetPacket( PeerConnectionJitterBuffer_t * pJitterBuffer,
                                                              uint16_t rtpSeq,
                                                              PeerConnectionJitterBufferPacket_t ** ppOutPacket )
@@ -627,6 +1015,7 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_Push( PeerConnectionJitterBuff
                                                         PeerConnectionJitterBufferPacket_t * pPacket )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionJitterBufferPacket_t * pEntry;
 
     if( ( pJitterBuffer == NULL ) ||
         ( pPacket == NULL ) )
@@ -657,6 +1046,36 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_Push( PeerConnectionJitterBuff
         ret = ShouldAcceptPacket( pJitterBuffer, pPacket );
     }
 
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        pEntry = &pJitterBuffer->rtpPackets[ PEER_CONNECTION_JITTER_BUFFER_WRAP( pPacket->sequenceNumber, PEER_CONNECTION_JITTER_BUFFER_MAX_ENTRY_NUM ) ];
+        if( ( pEntry->isPushed != 0U ) &&
+            ( pEntry->sequenceNumber == pPacket->sequenceNumber ) )
+        {
+            /* Keep the packet received first, its frame has already counted this sequence number. */
+            LogDebug( ( "Dropping duplicated packet with seq: %u", pPacket->sequenceNumber ) );
+            ret = PEER_CONNECTION_RESULT_PACKET_DUPLICATED;
+        }
+        else
+        {
+            /* Anything left in the entry is out of the tolerence range, the pending packet takes it over. */
+            DiscardPacket( pJitterBuffer, pEntry );
+            memcpy( pEntry,
+                    pPacket,
+                    sizeof( PeerConnectionJitterBufferPacket_t ) );
+            memset( pPacket, 0, sizeof( PeerConnectionJitterBufferPacket_t ) );
+            pPacket = pEntry;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        UpdatePlayoutDelay( pJitterBuffer, pPacket );
+
+        /* Track the packet in its frame, so a frame can be popped as soon as its last gap is filled. */
+        ret = AddPacketToFrame( pJitterBuffer, pPacket );
+    }
+
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         pPacket->isPushed = 1U;
@@ -665,19 +1084,15 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_Push( PeerConnectionJitterBuff
         ret = UpdateJitterBufferAddPacket( pJitterBuffer, pPacket );
     }
 
-    if( ret != PEER_CONNECTION_RESULT_OK )
+    if( ( ret != PEER_CONNECTION_RESULT_OK ) && ( pJitterBuffer != NULL ) )
     {
         /* Remove this packet if any error happens. */
-        if( pPacket && ( pPacket->pPacketBuffer != NULL ) )
-        {
-            free( pPacket->pPacketBuffer );
-            memset( pPacket, 0, sizeof( PeerConnectionJitterBufferPacket_t ) );
-        }
+        DiscardPacket( pJitterBuffer, pPacket );
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        /* Parse the jitter buffer to check if any frames are ready for decoding or if any packets need to be dropped. */
+        /* Check if the oldest frames are ready for decoding or need to be dropped. */
         ret = ParseFramesInJitterBuffer( pJitterBuffer, 0 );
     }
 
@@ -44,15 +44,21 @@ PeerConnectionResult_t PeerConnectionJitterBuffer_Create( PeerConnectionJitterBu
 
 void PeerConnectionJitterBuffer_Free( PeerConnectionJitterBuffer_t * pJitterBuffer );
 
+/* Get the pending packet with a buffer to decrypt into, it's not bound to any sequence number until it's pushed. */
 PeerConnectionResult_t PeerConnectionJitterBuffer_AllocateBuffer( PeerConnectionJitterBuffer_t * pJitterBuffer,
                                                                   PeerConnectionJitterBufferPacket_t ** ppOutPacket,
-                                                                  size_t packetBufferSize,
-                                                                  uint16_t rtpSeq );
+                                                                  size_t packetBufferSize );
+
+/* Release a buffer from PeerConnectionJitterBuffer_AllocateBuffer() that is not going to be pushed. */
+void PeerConnectionJitterBuffer_DiscardBuffer( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                               PeerConnectionJitterBufferPacket_t * pPacket );
 
 PeerConnectionResult_t PeerConnectionJitterBuffer_GetPacket( PeerConnectionJitterBuffer_t * pJitterBuffer,
                                                              uint16_t rtpSeq,
                                                              PeerConnectionJitterBufferPacket_t ** ppOutPacket );
 
+/* Move the pending packet to the entry of its sequence number. A packet already received with the same
+ * sequence number is kept and PEER_CONNECTION_RESULT_PACKET_DUPLICATED is returned. */
 PeerConnectionResult_t PeerConnectionJitterBuffer_Push( PeerConnectionJitterBuffer_t * pJitterBuffer,
                                                         PeerConnectionJitterBufferPacket_t * pPacket );
 
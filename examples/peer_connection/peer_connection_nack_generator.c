@@ -0,0 +1,267 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_nack_generator.h"
+
+#define PEER_CONNECTION_NACK_GENERATOR_INDEX( seq ) ( ( seq ) & ( PEER_CONNECTION_NACK_GENERATOR_WINDOW_SIZE - 1 ) )
+/* Signed distance from b to a, taking wrapping into account. */
+#define PEER_CONNECTION_NACK_GENERATOR_SEQ_DIFF( a, b ) ( ( int16_t )( ( uint16_t )( ( a ) - ( b ) ) ) )
+/* The RTT used before any RTCP receiver report tells us the real one. */
+#define PEER_CONNECTION_NACK_GENERATOR_DEFAULT_RTT_US ( 100000 )
+#define PEER_CONNECTION_NACK_GENERATOR_MIN_RETRY_INTERVAL_US ( 10000 )
+#define PEER_CONNECTION_NACK_GENERATOR_MAX_RETRY_INTERVAL_US ( 1000000 )
+/* Give up a missing packet after sending this many NACKs for it. */
+#define PEER_CONNECTION_NACK_GENERATOR_MAX_RETRY_COUNT ( 5 )
+
+static void StopTracking( PeerConnectionNackGenerator_t * pNackGenerator,
+                          uint16_t rtpSeq )
+{
+    PeerConnectionNackGeneratorEntry_t * pEntry = &pNackGenerator->entries[ PEER_CONNECTION_NACK_GENERATOR_INDEX( rtpSeq ) ];
+
+    if( pEntry->isMissing != 0U )
+    {
+        pEntry->isMissing = 0U;
+        pNackGenerator->missingCount--;
+    }
+}
+
+static void MoveOldestSequenceNumber( PeerConnectionNackGenerator_t * pNackGenerator,
+                                      uint16_t oldestSequenceNumber )
+{
+    while( ( pNackGenerator->oldestSequenceNumber != oldestSequenceNumber ) &&
+           ( pNackGenerator->missingCount > 0U ) )
+    {
+        StopTracking( pNackGenerator, pNackGenerator->oldestSequenceNumber );
+        pNackGenerator->oldestSequenceNumber++;
+    }
+
+    /* No missing packet left in between, jump to the target directly. */
+    pNackGenerator->oldestSequenceNumber = oldestSequenceNumber;
+}
+
+PeerConnectionResult_t PeerConnectionNackGenerator_Init( PeerConnectionNackGenerator_t * pNackGenerator )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( pNackGenerator == NULL )
+    {
+        LogError( ( "Invalid input, pNackGenerator: %p", pNackGenerator ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        memset( pNackGenerator, 0, sizeof( PeerConnectionNackGenerator_t ) );
+        pNackGenerator->rttUs = PEER_CONNECTION_NACK_GENERATOR_DEFAULT_RTT_US;
+        pNackGenerator->isEnabled = 1U;
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionNackGenerator_OnPacketReceived( PeerConnectionNackGenerator_t * pNackGenerator,
+                                                                     uint16_t rtpSeq,
+                                                                     uint64_t currentTimeUs )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionNackGeneratorEntry_t * pEntry;
+    int16_t seqDiff;
+    uint16_t i;
+
+    if( pNackGenerator == NULL )
+    {
+        LogError( ( "Invalid input, pNackGenerator: %p", pNackGenerator ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else if( pNackGenerator->isEnabled == 0U )
+    {
+        /* NACK is not used by this receiver, nothing to track. */
+    }
+    else if( pNackGenerator->isStarted == 0U )
+    {
+        pNackGenerator->isStarted = 1U;
+        pNackGenerator->oldestSequenceNumber = rtpSeq;
+        pNackGenerator->newestSequenceNumber = rtpSeq;
+    }
+    else
+    {
+        seqDiff = PEER_CONNECTION_NACK_GENERATOR_SEQ_DIFF( rtpSeq, pNackGenerator->newestSequenceNumber );
+
+        if( seqDiff >= PEER_CONNECTION_NACK_GENERATOR_WINDOW_SIZE )
+        {
+            /* The gap is too large to recover by retransmission, restart from this packet. */
+            LogWarn( ( "Sequence number jumps from %u to %u, reset NACK generator.",
+                       pNackGenerator->newestSequenceNumber,
+                       rtpSeq ) );
+            memset( pNackGenerator->entries, 0, sizeof( pNackGenerator->entries ) );
+            pNackGenerator->missingCount = 0U;
+            pNackGenerator->oldestSequenceNumber = rtpSeq;
+            pNackGenerator->newestSequenceNumber = rtpSeq;
+        }
+        else if( seqDiff > 0 )
+        {
+            /* Keep the tracking window within PEER_CONNECTION_NACK_GENERATOR_WINDOW_SIZE so every entry maps to one sequence number. */
+            if( PEER_CONNECTION_NACK_GENERATOR_SEQ_DIFF( rtpSeq, pNackGenerator->oldestSequenceNumber ) >= PEER_CONNECTION_NACK_GENERATOR_WINDOW_SIZE )
+            {
+                MoveOldestSequenceNumber( pNackGenerator,
+                                          ( uint16_t )( rtpSeq - PEER_CONNECTION_NACK_GENERATOR_WINDOW_SIZE + 1 ) );
+            }
+
+            for( i = ( uint16_t )( pNackGenerator->newestSequenceNumber + 1U ); i != rtpSeq; i++ )
+            {
+                pEntry = &pNackGenerator->entries[ PEER_CONNECTION_NACK_GENERATOR_INDEX( i ) ];
+                pEntry->isMissing = 1U;
+                pEntry->retryCount = 0U;
+                pEntry->nextSendTimeUs = currentTimeUs;
+                pNackGenerator->missingCount++;
+            }
+
+            pNackGenerator->newestSequenceNumber = rtpSeq;
+        }
+        else if( PEER_CONNECTION_NACK_GENERATOR_SEQ_DIFF( rtpSeq, pNackGenerator->oldestSequenceNumber ) >= 0 )
+        {
+            /* A reordered or retransmitted packet fills the gap. */
+            StopTracking( pNackGenerator, rtpSeq );
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+
+        if( pNackGenerator->missingCount == 0U )
+        {
+            pNackGenerator->oldestSequenceNumber = pNackGenerator->newestSequenceNumber;
+        }
+    }
+
+    return ret;
+}
+
+void PeerConnectionNackGenerator_RemoveUpTo( PeerConnectionNackGenerator_t * pNackGenerator,
+                                             uint16_t rtpSeq )
+{
+    if( ( pNackGenerator != NULL ) &&
+        ( pNackGenerator->isStarted != 0U ) &&
+        ( PEER_CONNECTION_NACK_GENERATOR_SEQ_DIFF( rtpSeq, pNackGenerator->oldestSequenceNumber ) >= 0 ) )
+    {
+        if( PEER_CONNECTION_NACK_GENERATOR_SEQ_DIFF( rtpSeq, pNackGenerator->newestSequenceNumber ) >= 0 )
+        {
+            /* The newest sequence number is never missing, keep it as the start of the window. */
+            MoveOldestSequenceNumber( pNackGenerator,
+                                      pNackGenerator->newestSequenceNumber );
+        }
+        else
+        {
+            MoveOldestSequenceNumber( pNackGenerator,
+                                      ( uint16_t )( rtpSeq + 1U ) );
+        }
+    }
+}
+
+void PeerConnectionNackGenerator_UpdateRtt( PeerConnectionNackGenerator_t * pNackGenerator,
+                                            uint64_t rttUs )
+{
+    if( pNackGenerator != NULL )
+    {
+        if( rttUs < PEER_CONNECTION_NACK_GENERATOR_MIN_RETRY_INTERVAL_US )
+        {
+            rttUs = PEER_CONNECTION_NACK_GENERATOR_MIN_RETRY_INTERVAL_US;
+        }
+        else if( rttUs > PEER_CONNECTION_NACK_GENERATOR_MAX_RETRY_INTERVAL_US )
+        {
+            rttUs = PEER_CONNECTION_NACK_GENERATOR_MAX_RETRY_INTERVAL_US;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+
+        pNackGenerator->rttUs = rttUs;
+    }
+}
+
+PeerConnectionResult_t PeerConnectionNackGenerator_GetNackList( PeerConnectionNackGenerator_t * pNackGenerator,
+                                                                uint64_t currentTimeUs,
+                                                                uint16_t * pSeqList,
+                                                                size_t * pSeqListLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionNackGeneratorEntry_t * pEntry;
+    uint32_t remainingMissingCount;
+    size_t seqCount = 0U;
+    uint8_t isLeading = 1U;
+    uint16_t i;
+
+    if( ( pNackGenerator == NULL ) ||
+        ( pSeqList == NULL ) ||
+        ( pSeqListLength == NULL ) )
+    {
+        LogError( ( "Invalid input, pNackGenerator: %p, pSeqList: %p, pSeqListLength: %p", pNackGenerator, pSeqList, pSeqListLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+        ( pNackGenerator->isEnabled != 0U ) )
+    {
+        remainingMissingCount = pNackGenerator->missingCount;
+
+        for( i = pNackGenerator->oldestSequenceNumber; ( remainingMissingCount > 0U ) && ( seqCount < *pSeqListLength ); i++ )
+        {
+            pEntry = &pNackGenerator->entries[ PEER_CONNECTION_NACK_GENERATOR_INDEX( i ) ];
+
+            if( pEntry->isMissing != 0U )
+            {
+                remainingMissingCount--;
+
+                if( pEntry->nextSendTimeUs <= currentTimeUs )
+                {
+                    pSeqList[ seqCount++ ] = i;
+                    pEntry->retryCount++;
+                    pEntry->nextSendTimeUs = currentTimeUs + pNackGenerator->rttUs;
+
+                    if( pEntry->retryCount >= PEER_CONNECTION_NACK_GENERATOR_MAX_RETRY_COUNT )
+                    {
+                        LogVerbose( ( "Stop sending NACK for seq: %u after %u retries.", i, pEntry->retryCount ) );
+                        StopTracking( pNackGenerator, i );
+                    }
+                }
+            }
+
+            if( pEntry->isMissing != 0U )
+            {
+                isLeading = 0U;
+            }
+            else if( isLeading != 0U )
+            {
+                /* Nothing missing before it, the window can start from the next one. */
+                pNackGenerator->oldestSequenceNumber = ( uint16_t )( i + 1U );
+            }
+            else
+            {
+                /* Empty else marker. */
+            }
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        *pSeqListLength = seqCount;
+    }
+
+    return ret;
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PEER_CONNECTION_NACK_GENERATOR_H
+#define PEER_CONNECTION_NACK_GENERATOR_H
+
+#pragma once
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+
+#include "peer_connection_data_types.h"
+
+PeerConnectionResult_t PeerConnectionNackGenerator_Init( PeerConnectionNackGenerator_t * pNackGenerator );
+
+/* Record a received RTP sequence number, the sequence numbers skipped by it are tracked as missing. */
+PeerConnectionResult_t PeerConnectionNackGenerator_OnPacketReceived( PeerConnectionNackGenerator_t * pNackGenerator,
+                                                                     uint16_t rtpSeq,
+                                                                     uint64_t currentTimeUs );
+
+/* Stop tracking the sequence numbers up to rtpSeq, e.g. the jitter buffer has already moved on. */
+void PeerConnectionNackGenerator_RemoveUpTo( PeerConnectionNackGenerator_t * pNackGenerator,
+                                             uint16_t rtpSeq );
+
+void PeerConnectionNackGenerator_UpdateRtt( PeerConnectionNackGenerator_t * pNackGenerator,
+                                            uint64_t rttUs );
+
+/* Get the missing sequence numbers due to be NACKed at current time, in ascending order. */
+PeerConnectionResult_t PeerConnectionNackGenerator_GetNackList( PeerConnectionNackGenerator_t * pNackGenerator,
+                                                                uint64_t currentTimeUs,
+                                                                uint16_t * pSeqList,
+                                                                size_t * pSeqListLength );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+}
+#endif
+/* *INDENT-ON* */
+
+#endif /* PEER_CONNECTION_NACK_GENERATOR_H */
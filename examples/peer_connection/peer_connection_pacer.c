@@ -0,0 +1,647 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "logging.h"
+#include "peer_connection_pacer.h"
+#include "networking_utils.h"
+#include "ice_controller.h"
+#if ENABLE_TWCC_SUPPORT
+    #include "peer_connection_twcc_history.h"
+#endif /* ENABLE_TWCC_SUPPORT */
+
+#define PEER_CONNECTION_PACER_US_PER_SECOND ( 1000000ULL )
+#define PEER_CONNECTION_PACER_NS_PER_US ( 1000ULL )
+
+static const size_t pacerQueueLength[ PEER_CONNECTION_PACER_PRIORITY_NUM ] = {
+    PEER_CONNECTION_PACER_AUDIO_QUEUE_LENGTH,
+    PEER_CONNECTION_PACER_RETRANSMISSION_QUEUE_LENGTH,
+    PEER_CONNECTION_PACER_VIDEO_QUEUE_LENGTH,
+};
+
+static uint64_t GetPacingBitrate( const PeerConnectionPacer_t * pPacer )
+{
+    uint64_t pacingBitrateBps;
+    uint64_t drainBitrateBps;
+
+    pacingBitrateBps = pPacer->targetBitrateBps * PEER_CONNECTION_PACER_PACING_FACTOR_PERCENT / 100U;
+
+    /* Don't let the packets wait too long if the encoders produce more than the target bitrate. */
+    drainBitrateBps = ( uint64_t ) pPacer->queuedBytes * 8U * PEER_CONNECTION_PACER_US_PER_SECOND / PEER_CONNECTION_PACER_MAX_QUEUE_TIME_US;
+    if( ( pacingBitrateBps != 0U ) && ( drainBitrateBps > pacingBitrateBps ) )
+    {
+        pacingBitrateBps = drainBitrateBps;
+    }
+
+    return pacingBitrateBps;
+}
+
+static void UpdateBudget( PeerConnectionPacer_t * pPacer,
+                          uint64_t pacingBitrateBps,
+                          uint64_t currentTimeUs )
+{
+    int64_t maxBudgetBits;
+
+    if( currentTimeUs > pPacer->lastBudgetUpdateTimeUs )
+    {
+        pPacer->budgetBits += ( int64_t ) ( pacingBitrateBps * ( currentTimeUs - pPacer->lastBudgetUpdateTimeUs ) / PEER_CONNECTION_PACER_US_PER_SECOND );
+    }
+    pPacer->lastBudgetUpdateTimeUs = currentTimeUs;
+
+    maxBudgetBits = ( int64_t ) ( pacingBitrateBps * PEER_CONNECTION_PACER_MAX_BURST_US / PEER_CONNECTION_PACER_US_PER_SECOND );
+    if( pPacer->budgetBits > maxBudgetBits )
+    {
+        pPacer->budgetBits = maxBudgetBits;
+    }
+}
+
+static PeerConnectionPacerQueue_t * GetNextQueue( PeerConnectionPacer_t * pPacer )
+{
+    PeerConnectionPacerQueue_t * pQueue = NULL;
+    int i;
+
+    for( i = 0; i < PEER_CONNECTION_PACER_PRIORITY_NUM; i++ )
+    {
+        if( pPacer->queues[ i ].count > 0U )
+        {
+            pQueue = &pPacer->queues[ i ];
+            break;
+        }
+    }
+
+    return pQueue;
+}
+
+/* Take the packet at head without copying it, the slot stays in flight till the pacer task finishes sending. */
+static PeerConnectionPacerPacket_t * PopPacket( PeerConnectionPacer_t * pPacer,
+                                                PeerConnectionPacerQueue_t * pQueue )
+{
+    PeerConnectionPacerPacket_t * pPacket = &pQueue->pPackets[ pQueue->head ];
+
+    pQueue->head = ( pQueue->head + 1U ) % pQueue->capacity;
+    pQueue->count--;
+    pQueue->inFlightCount++;
+    pPacer->queuedPacketCount--;
+    pPacer->queuedBytes -= pPacket->packetLength;
+
+    return pPacket;
+}
+
+/* Move packets allowed by the budget to the released list, must be called with pacer mutex taken. */
+static size_t ReleasePackets( PeerConnectionPacer_t * pPacer,
+                              uint64_t pacingBitrateBps )
+{
+    size_t releasedCount = 0U;
+    PeerConnectionPacerQueue_t * pQueue;
+
+    while( ( releasedCount < ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ) &&
+           ( ( pacingBitrateBps == 0U ) || ( pPacer->budgetBits >= 0 ) ) )
+    {
+        pQueue = GetNextQueue( pPacer );
+        if( pQueue == NULL )
+        {
+            break;
+        }
+
+        pPacer->pReleasedPackets[ releasedCount ] = PopPacket( pPacer,
+                                                               pQueue );
+        pPacer->pReleasedPackets[ releasedCount ]->departureTimeUs = 0U;
+        pPacer->budgetBits -= ( int64_t ) pPacer->pReleasedPackets[ releasedCount ]->packetLength * 8;
+        releasedCount++;
+    }
+
+    return releasedCount;
+}
+
+/* Move packets due within the horizon to the released list with their departure times, the kernel spaces them out.
+ * Must be called with pacer mutex taken. */
+static size_t ReleasePacketsWithDepartureTime( PeerConnectionPacer_t * pPacer,
+                                               uint64_t pacingBitrateBps,
+                                               uint64_t currentTimeUs )
+{
+    size_t releasedCount = 0U;
+    PeerConnectionPacerQueue_t * pQueue;
+
+    while( ( releasedCount < ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ) &&
+           ( pPacer->nextDepartureTimeUs <= currentTimeUs + PEER_CONNECTION_PACER_KERNEL_PACING_HORIZON_US ) )
+    {
+        pQueue = GetNextQueue( pPacer );
+        if( pQueue == NULL )
+        {
+            break;
+        }
+
+        pPacer->pReleasedPackets[ releasedCount ] = PopPacket( pPacer,
+                                                               pQueue );
+        pPacer->pReleasedPackets[ releasedCount ]->departureTimeUs = pPacer->nextDepartureTimeUs;
+        pPacer->nextDepartureTimeUs += ( uint64_t ) pPacer->pReleasedPackets[ releasedCount ]->packetLength * 8U * PEER_CONNECTION_PACER_US_PER_SECOND / pacingBitrateBps;
+        releasedCount++;
+    }
+
+    return releasedCount;
+}
+
+/* Sleep on the condition until the monotonic time, or a packet is queued to empty queues. */
+static void WaitUntil( PeerConnectionPacer_t * pPacer,
+                       uint64_t wakeUpTimeUs )
+{
+    struct timespec wakeUpTime;
+
+    wakeUpTime.tv_sec = ( time_t ) ( wakeUpTimeUs / PEER_CONNECTION_PACER_US_PER_SECOND );
+    wakeUpTime.tv_nsec = ( long ) ( ( wakeUpTimeUs % PEER_CONNECTION_PACER_US_PER_SECOND ) * PEER_CONNECTION_PACER_NS_PER_US );
+    ( void ) pthread_cond_timedwait( &pPacer->pacerCond,
+                                     &pPacer->pacerMutex,
+                                     &wakeUpTime );
+}
+
+static void SendReleasedPackets( PeerConnectionPacer_t * pPacer,
+                                 size_t releasedCount )
+{
+    IceControllerResult_t resultIceController;
+    size_t i;
+    #if ENABLE_TWCC_SUPPORT
+        uint64_t currentTimeUs;
+        uint64_t currentMonotonicTimeUs;
+        uint64_t sentTimeUs;
+    #endif /* ENABLE_TWCC_SUPPORT */
+
+    for( i = 0; i < releasedCount; i++ )
+    {
+        resultIceController = IceController_AddToSendBatch( pPacer->pIceControllerContext,
+                                                            &pPacer->sendBatch,
+                                                            &pPacer->pReleasedPackets[ i ]->buffer[ ICE_CONTROLLER_PACKET_HEADROOM ],
+                                                            pPacer->pReleasedPackets[ i ]->packetLength,
+                                                            pPacer->pReleasedPackets[ i ]->departureTimeUs );
+        if( resultIceController != ICE_CONTROLLER_RESULT_OK )
+        {
+            LogWarn( ( "Fail to send RTP packet, ret: %d", resultIceController ) );
+        }
+    }
+
+    resultIceController = IceController_FlushSendBatch( pPacer->pIceControllerContext,
+                                                        &pPacer->sendBatch );
+    if( resultIceController != ICE_CONTROLLER_RESULT_OK )
+    {
+        LogWarn( ( "Fail to send RTP packets in batch, ret: %d", resultIceController ) );
+    }
+
+    #if ENABLE_TWCC_SUPPORT
+        if( pPacer->pTwccHistory != NULL )
+        {
+            /* The delay-based estimate must not see the time spent in the pacer as network delay.
+             * The TWCC history is on wall clock, the departure time on monotonic clock is converted by the offset. */
+            currentTimeUs = NetworkingUtils_GetCurrentTimeUs( NULL );
+            currentMonotonicTimeUs = NetworkingUtils_GetCurrentMonotonicTimeUs( NULL );
+            for( i = 0; i < releasedCount; i++ )
+            {
+                if( pPacer->pReleasedPackets[ i ]->hasTransportSequenceNumber != 0U )
+                {
+                    sentTimeUs = currentTimeUs;
+                    if( pPacer->pReleasedPackets[ i ]->departureTimeUs > currentMonotonicTimeUs )
+                    {
+                        sentTimeUs += pPacer->pReleasedPackets[ i ]->departureTimeUs - currentMonotonicTimeUs;
+                    }
+
+                    ( void ) PeerConnectionTwccHistory_SetSentTime( pPacer->pTwccHistory,
+                                                                    pPacer->pReleasedPackets[ i ]->transportSequenceNumber,
+                                                                    sentTimeUs );
+                }
+            }
+        }
+    #endif /* ENABLE_TWCC_SUPPORT */
+}
+
+static void * PeerConnectionPacer_Task( void * pParameter )
+{
+    PeerConnectionPacer_t * pPacer = ( PeerConnectionPacer_t * ) pParameter;
+    uint64_t currentTimeUs;
+    uint64_t pacingBitrateBps;
+    uint64_t waitTimeUs;
+    size_t releasedCount;
+    uint8_t isLocked = 0U;
+    int i;
+
+    if( pthread_mutex_lock( &pPacer->pacerMutex ) != 0 )
+    {
+        LogError( ( "Failed to lock pacer mutex, pacer task exits." ) );
+    }
+    else
+    {
+        isLocked = 1U;
+
+        while( pPacer->isStopping == 0U )
+        {
+            if( pPacer->queuedPacketCount == 0U )
+            {
+                ( void ) pthread_cond_wait( &pPacer->pacerCond,
+                                            &pPacer->pacerMutex );
+                continue;
+            }
+
+            currentTimeUs = NetworkingUtils_GetCurrentMonotonicTimeUs( NULL );
+            pacingBitrateBps = GetPacingBitrate( pPacer );
+
+            if( ( pacingBitrateBps != 0U ) &&
+                ( IceController_IsTxTimeEnabled( pPacer->pIceControllerContext ) != 0U ) )
+            {
+                /* The kernel holds the packets till their departure times. Sleep till half of the horizon is drained,
+                 * then fill it up again, so the task wakes up once per half horizon instead of per packet. */
+                if( pPacer->nextDepartureTimeUs < currentTimeUs )
+                {
+                    pPacer->nextDepartureTimeUs = currentTimeUs;
+                }
+
+                if( pPacer->nextDepartureTimeUs > currentTimeUs + PEER_CONNECTION_PACER_KERNEL_PACING_HORIZON_US / 2U )
+                {
+                    WaitUntil( pPacer,
+                               pPacer->nextDepartureTimeUs - PEER_CONNECTION_PACER_KERNEL_PACING_HORIZON_US / 2U );
+                    continue;
+                }
+
+                releasedCount = ReleasePacketsWithDepartureTime( pPacer,
+                                                                 pacingBitrateBps,
+                                                                 currentTimeUs );
+            }
+            else
+            {
+                UpdateBudget( pPacer,
+                              pacingBitrateBps,
+                              currentTimeUs );
+
+                if( ( pacingBitrateBps != 0U ) && ( pPacer->budgetBits < 0 ) )
+                {
+                    /* Sleep till the budget is paid back, rounded up to the next microsecond. */
+                    waitTimeUs = ( ( uint64_t ) ( -pPacer->budgetBits ) * PEER_CONNECTION_PACER_US_PER_SECOND + pacingBitrateBps - 1U ) / pacingBitrateBps;
+                    WaitUntil( pPacer,
+                               currentTimeUs + waitTimeUs );
+                    continue;
+                }
+
+                releasedCount = ReleasePackets( pPacer,
+                                                pacingBitrateBps );
+            }
+
+            /* Don't block the media threads while sending. */
+            ( void ) pthread_mutex_unlock( &pPacer->pacerMutex );
+            SendReleasedPackets( pPacer,
+                                 releasedCount );
+            if( pthread_mutex_lock( &pPacer->pacerMutex ) != 0 )
+            {
+                LogError( ( "Failed to lock pacer mutex, pacer task exits." ) );
+                isLocked = 0U;
+                break;
+            }
+
+            /* All released packets are on the wire, their slots can be reused. */
+            for( i = 0; i < PEER_CONNECTION_PACER_PRIORITY_NUM; i++ )
+            {
+                pPacer->queues[ i ].inFlightCount = 0U;
+            }
+        }
+
+        if( isLocked != 0U )
+        {
+            ( void ) pthread_mutex_unlock( &pPacer->pacerMutex );
+        }
+    }
+
+    return NULL;
+}
+
+PeerConnectionResult_t PeerConnectionPacer_Create( PeerConnectionPacer_t * pPacer,
+                                                   IceControllerContext_t * pIceControllerContext )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    pthread_condattr_t condAttr;
+    uint8_t isMutexInit = 0U;
+    uint8_t isCondInit = 0U;
+    int i;
+
+    if( ( pPacer == NULL ) ||
+        ( pIceControllerContext == NULL ) )
+    {
+        LogError( ( "Invalid input, pPacer: %p, pIceControllerContext: %p", pPacer, pIceControllerContext ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        memset( pPacer, 0, sizeof( PeerConnectionPacer_t ) );
+        pPacer->pIceControllerContext = pIceControllerContext;
+
+        for( i = 0; i < PEER_CONNECTION_PACER_PRIORITY_NUM; i++ )
+        {
+            pPacer->queues[ i ].pPackets = ( PeerConnectionPacerPacket_t * )malloc( pacerQueueLength[ i ] * sizeof( PeerConnectionPacerPacket_t ) );
+            if( pPacer->queues[ i ].pPackets == NULL )
+            {
+                LogError( ( "No memory available for allocating pacer queue with total size %lu, length: %lu",
+                            pacerQueueLength[ i ] * sizeof( PeerConnectionPacerPacket_t ),
+                            pacerQueueLength[ i ] ) );
+                ret = PEER_CONNECTION_RESULT_FAIL_PACER_NO_ENOUGH_MEMORY;
+                break;
+            }
+            pPacer->queues[ i ].capacity = pacerQueueLength[ i ];
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_init( &pPacer->pacerMutex, NULL ) != 0 )
+        {
+            LogError( ( "Fail to create mutex for pacer." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_CREATE_PACER_MUTEX;
+        }
+        else
+        {
+            isMutexInit = 1U;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* The pacer sleeps on monotonic clock, wall clock changes must not stall or burst the sending. */
+        if( ( pthread_condattr_init( &condAttr ) != 0 ) ||
+            ( pthread_condattr_setclock( &condAttr, CLOCK_MONOTONIC ) != 0 ) ||
+            ( pthread_cond_init( &pPacer->pacerCond, &condAttr ) != 0 ) )
+        {
+            LogError( ( "Fail to create condition variable for pacer." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_CREATE_PACER_MUTEX;
+        }
+        else
+        {
+            isCondInit = 1U;
+        }
+        ( void ) pthread_condattr_destroy( &condAttr );
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_create( &pPacer->pacerTask,
+                            NULL,
+                            PeerConnectionPacer_Task,
+                            pPacer ) != 0 )
+        {
+            LogError( ( "Fail to create pacer task." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_CREATE_PACER_TASK;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        pPacer->isInit = 1U;
+    }
+    else if( ret != PEER_CONNECTION_RESULT_BAD_PARAMETER )
+    {
+        if( isCondInit != 0U )
+        {
+            ( void ) pthread_cond_destroy( &pPacer->pacerCond );
+        }
+
+        if( isMutexInit != 0U )
+        {
+            ( void ) pthread_mutex_destroy( &pPacer->pacerMutex );
+        }
+
+        for( i = 0; i < PEER_CONNECTION_PACER_PRIORITY_NUM; i++ )
+        {
+            free( pPacer->queues[ i ].pPackets );
+            pPacer->queues[ i ].pPackets = NULL;
+            pPacer->queues[ i ].capacity = 0U;
+        }
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return ret;
+}
+
+#if ENABLE_TWCC_SUPPORT
+    void PeerConnectionPacer_SetTwccHistory( PeerConnectionPacer_t * pPacer,
+                                             PeerConnectionTwccHistory_t * pTwccHistory )
+    {
+        if( pPacer != NULL )
+        {
+            pPacer->pTwccHistory = pTwccHistory;
+        }
+    }
+#endif /* ENABLE_TWCC_SUPPORT */
+
+PeerConnectionResult_t PeerConnectionPacer_Start( PeerConnectionPacer_t * pPacer,
+                                                  uint64_t mediaBitrateBps )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pPacer == NULL ) ||
+        ( pPacer->isInit == 0U ) )
+    {
+        LogError( ( "Invalid input, pPacer: %p", pPacer ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_lock( &pPacer->pacerMutex ) == 0 )
+        {
+            pPacer->mediaBitrateBps = mediaBitrateBps;
+            pPacer->targetBitrateBps = mediaBitrateBps;
+            pPacer->budgetBits = 0;
+            pPacer->lastBudgetUpdateTimeUs = NetworkingUtils_GetCurrentMonotonicTimeUs( NULL );
+            ( void ) pthread_mutex_unlock( &pPacer->pacerMutex );
+
+            LogInfo( ( "Start pacing at %lu%% of %lu bps", ( uint64_t ) PEER_CONNECTION_PACER_PACING_FACTOR_PERCENT, mediaBitrateBps ) );
+        }
+        else
+        {
+            LogError( ( "Failed to lock pacer mutex." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_PACER_MUTEX;
+        }
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionPacer_SetBitrate( PeerConnectionPacer_t * pPacer,
+                                                       uint64_t bitrateBps )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pPacer == NULL ) ||
+        ( pPacer->isInit == 0U ) ||
+        ( bitrateBps == 0U ) )
+    {
+        LogError( ( "Invalid input, pPacer: %p, bitrateBps: %lu", pPacer, bitrateBps ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_lock( &pPacer->pacerMutex ) == 0 )
+        {
+            /* Nothing is sent faster than the media, the estimate only slows the pacer down. */
+            if( ( pPacer->mediaBitrateBps != 0U ) && ( bitrateBps > pPacer->mediaBitrateBps ) )
+            {
+                bitrateBps = pPacer->mediaBitrateBps;
+            }
+            pPacer->targetBitrateBps = bitrateBps;
+            ( void ) pthread_mutex_unlock( &pPacer->pacerMutex );
+        }
+        else
+        {
+            LogError( ( "Failed to lock pacer mutex." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_PACER_MUTEX;
+        }
+    }
+
+    return ret;
+}
+
+void PeerConnectionPacer_Reset( PeerConnectionPacer_t * pPacer )
+{
+    int i;
+
+    if( ( pPacer != NULL ) && ( pPacer->isInit != 0U ) )
+    {
+        if( pthread_mutex_lock( &pPacer->pacerMutex ) == 0 )
+        {
+            for( i = 0; i < PEER_CONNECTION_PACER_PRIORITY_NUM; i++ )
+            {
+                /* Keep head and the packets in flight, the pacer task might be sending them. */
+                pPacer->queues[ i ].count = 0U;
+            }
+            pPacer->queuedPacketCount = 0U;
+            pPacer->queuedBytes = 0U;
+            pPacer->mediaBitrateBps = 0U;
+            pPacer->targetBitrateBps = 0U;
+            pPacer->budgetBits = 0;
+            pPacer->nextDepartureTimeUs = 0U;
+            ( void ) pthread_mutex_unlock( &pPacer->pacerMutex );
+        }
+        else
+        {
+            LogError( ( "Failed to lock pacer mutex." ) );
+        }
+    }
+}
+
+void PeerConnectionPacer_Destroy( PeerConnectionPacer_t * pPacer )
+{
+    int i;
+
+    if( ( pPacer != NULL ) && ( pPacer->isInit != 0U ) )
+    {
+        if( pthread_mutex_lock( &pPacer->pacerMutex ) == 0 )
+        {
+            pPacer->isStopping = 1U;
+            ( void ) pthread_cond_signal( &pPacer->pacerCond );
+            ( void ) pthread_mutex_unlock( &pPacer->pacerMutex );
+
+            /* The task might be sending released packets from the queues, wait for it before freeing them. */
+            ( void ) pthread_join( pPacer->pacerTask,
+                                   NULL );
+
+            ( void ) pthread_cond_destroy( &pPacer->pacerCond );
+            ( void ) pthread_mutex_destroy( &pPacer->pacerMutex );
+
+            for( i = 0; i < PEER_CONNECTION_PACER_PRIORITY_NUM; i++ )
+            {
+                free( pPacer->queues[ i ].pPackets );
+                pPacer->queues[ i ].pPackets = NULL;
+                pPacer->queues[ i ].capacity = 0U;
+            }
+
+            pPacer->isInit = 0U;
+        }
+        else
+        {
+            LogError( ( "Failed to lock pacer mutex." ) );
+        }
+    }
+}
+
+PeerConnectionResult_t PeerConnectionPacer_EnqueuePacket( PeerConnectionPacer_t * pPacer,
+                                                          PeerConnectionPacerPriority_t priority,
+                                                          const uint8_t * pPacket,
+                                                          size_t packetLength,
+                                                          uint8_t hasTransportSequenceNumber,
+                                                          uint16_t transportSequenceNumber )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    PeerConnectionPacerQueue_t * pQueue;
+    PeerConnectionPacerPacket_t * pSlot;
+    uint64_t droppedPacketCount = 0U;
+
+    if( ( pPacer == NULL ) ||
+        ( pPacer->isInit == 0U ) ||
+        ( priority >= PEER_CONNECTION_PACER_PRIORITY_NUM ) ||
+        ( pPacket == NULL ) ||
+        ( packetLength > ICE_CONTROLLER_MAX_MTU ) )
+    {
+        LogError( ( "Invalid input, pPacer: %p, priority: %d, pPacket: %p, packetLength: %lu", pPacer, priority, pPacket, packetLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_lock( &pPacer->pacerMutex ) == 0 )
+        {
+            pQueue = &pPacer->queues[ priority ];
+            if( pQueue->count + pQueue->inFlightCount >= pQueue->capacity )
+            {
+                /* Drop the new packet, the slot of the oldest one might still be in flight. */
+                pPacer->droppedPacketCount++;
+                droppedPacketCount = pPacer->droppedPacketCount;
+            }
+            else
+            {
+                pSlot = &pQueue->pPackets[ ( pQueue->head + pQueue->count ) % pQueue->capacity ];
+                memcpy( &pSlot->buffer[ ICE_CONTROLLER_PACKET_HEADROOM ],
+                        pPacket,
+                        packetLength );
+                pSlot->packetLength = packetLength;
+                pSlot->hasTransportSequenceNumber = hasTransportSequenceNumber;
+                pSlot->transportSequenceNumber = transportSequenceNumber;
+                pSlot->departureTimeUs = 0U;
+                pQueue->count++;
+                pPacer->queuedPacketCount++;
+                pPacer->queuedBytes += packetLength;
+
+                /* The pacer task only waits without timeout when all queues are empty. */
+                if( pPacer->queuedPacketCount == 1U )
+                {
+                    ( void ) pthread_cond_signal( &pPacer->pacerCond );
+                }
+            }
+            ( void ) pthread_mutex_unlock( &pPacer->pacerMutex );
+        }
+        else
+        {
+            LogError( ( "Failed to lock pacer mutex." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_PACER_MUTEX;
+        }
+    }
+
+    if( droppedPacketCount != 0U )
+    {
+        /* The remote recovers it by NACK like a packet lost on the network, so the rest of the frame is still sent. */
+        LogDebug( ( "Pacer queue of priority %d is full, drop the packet, dropped: %lu", priority, droppedPacketCount ) );
+    }
+
+    return ret;
+}
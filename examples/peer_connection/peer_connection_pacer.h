@@ -0,0 +1,85 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PEER_CONNECTION_PACER_H
+#define PEER_CONNECTION_PACER_H
+
+#pragma once
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+
+#include "peer_connection_data_types.h"
+
+#define PEER_CONNECTION_PACER_AUDIO_QUEUE_LENGTH ( 64 )
+#define PEER_CONNECTION_PACER_RETRANSMISSION_QUEUE_LENGTH ( 128 )
+#define PEER_CONNECTION_PACER_VIDEO_QUEUE_LENGTH ( 512 )
+/* Packets are released at this percentage of the media bitrate, so the pacer drains faster than the encoders fill it. */
+#define PEER_CONNECTION_PACER_PACING_FACTOR_PERCENT ( 250 )
+/* The budget saved while idle is limited to this duration at the pacing rate, it bounds the burst after idle. */
+#define PEER_CONNECTION_PACER_MAX_BURST_US ( 5000 )
+/* The pacing rate is raised if the queued packets would wait longer than this. */
+#define PEER_CONNECTION_PACER_MAX_QUEUE_TIME_US ( 500000 )
+/* If the socket supports SO_TXTIME, packets are handed to the kernel up to this long before their departure time. */
+#define PEER_CONNECTION_PACER_KERNEL_PACING_HORIZON_US ( 20000 )
+
+/* Allocate the queues and start the pacer task. */
+PeerConnectionResult_t PeerConnectionPacer_Create( PeerConnectionPacer_t * pPacer,
+                                                   IceControllerContext_t * pIceControllerContext );
+
+#if ENABLE_TWCC_SUPPORT
+/* Update the send time of packets in the TWCC history when they're released. */
+void PeerConnectionPacer_SetTwccHistory( PeerConnectionPacer_t * pPacer,
+                                         PeerConnectionTwccHistory_t * pTwccHistory );
+#endif /* ENABLE_TWCC_SUPPORT */
+
+/* Start pacing at the bitrate of all media sent, e.g. the session is connected. */
+PeerConnectionResult_t PeerConnectionPacer_Start( PeerConnectionPacer_t * pPacer,
+                                                  uint64_t mediaBitrateBps );
+
+/* Follow the estimated bitrate, it's capped by the media bitrate set in PeerConnectionPacer_Start(). */
+PeerConnectionResult_t PeerConnectionPacer_SetBitrate( PeerConnectionPacer_t * pPacer,
+                                                       uint64_t bitrateBps );
+
+/* Drop all packets queued, e.g. the session is closed. */
+void PeerConnectionPacer_Reset( PeerConnectionPacer_t * pPacer );
+
+/* Stop the pacer task and free the queues. */
+void PeerConnectionPacer_Destroy( PeerConnectionPacer_t * pPacer );
+
+/* Copy the SRTP packet into the queue of the priority, the pacer task sends it later.
+ * If the queue is full, the packet is dropped, it's still in the rolling buffer for the remote to NACK.
+ * Sending it around the queue would overtake the queued packets and miss its TWCC send time. */
+PeerConnectionResult_t PeerConnectionPacer_EnqueuePacket( PeerConnectionPacer_t * pPacer,
+                                                          PeerConnectionPacerPriority_t priority,
+                                                          const uint8_t * pPacket,
+                                                          size_t packetLength,
+                                                          uint8_t hasTransportSequenceNumber,
+                                                          uint16_t transportSequenceNumber );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+}
+#endif
+/* *INDENT-ON* */
+
+#endif /* PEER_CONNECTION_PACER_H */
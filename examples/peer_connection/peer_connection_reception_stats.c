@@ -0,0 +1,349 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_reception_stats.h"
+
+/* https://datatracker.ietf.org/doc/html/rfc3550#appendix-A.1 */
+#define PEER_CONNECTION_RECEPTION_STATS_RTP_SEQ_MOD         ( 1U << 16 )
+#define PEER_CONNECTION_RECEPTION_STATS_MAX_DROPOUT         ( 3000U )
+#define PEER_CONNECTION_RECEPTION_STATS_MAX_MISORDER        ( 100U )
+
+/* The cumulative number of packets lost is a signed 24-bit field. */
+#define PEER_CONNECTION_RECEPTION_STATS_MAX_CUMULATIVE_LOST ( 0x7FFFFF )
+#define PEER_CONNECTION_RECEPTION_STATS_MIN_CUMULATIVE_LOST ( -0x800000 )
+
+/* https://datatracker.ietf.org/doc/html/rfc3550#section-6.4.1, DLSR is expressed in units of 1/65536 seconds. */
+#define PEER_CONNECTION_RECEPTION_STATS_DLSR_TIMESCALE      ( 65536U )
+
+static void InitSequence( PeerConnectionReceptionStats_t * pReceptionStats,
+                          uint16_t rtpSeq )
+{
+    pReceptionStats->baseSequenceNumber = rtpSeq;
+    pReceptionStats->maxSequenceNumber = rtpSeq;
+    pReceptionStats->badSequenceNumber = PEER_CONNECTION_RECEPTION_STATS_RTP_SEQ_MOD + 1U;
+    pReceptionStats->cycles = 0U;
+    pReceptionStats->receivedPacketCount = 0U;
+    pReceptionStats->receivedPrior = 0U;
+    pReceptionStats->expectedPrior = 0U;
+}
+
+static void ClearStats( PeerConnectionReceptionStats_t * pReceptionStats )
+{
+    pReceptionStats->isStarted = 0U;
+    pReceptionStats->ssrc = 0U;
+    InitSequence( pReceptionStats, 0U );
+    pReceptionStats->isTransitInit = 0U;
+    pReceptionStats->lastTransit = 0U;
+    pReceptionStats->jitter = 0U;
+    pReceptionStats->lastSenderReportNtp = 0U;
+    pReceptionStats->lastSenderReportReceiveTimeUs = 0U;
+}
+
+/* Returns 0 if the packet is not counted, i.e. the sequence number jumps and it's not confirmed by the next packet yet. */
+static uint8_t UpdateSequence( PeerConnectionReceptionStats_t * pReceptionStats,
+                               uint16_t rtpSeq )
+{
+    uint8_t isValid = 1U;
+    uint16_t seqDelta = ( uint16_t )( rtpSeq - pReceptionStats->maxSequenceNumber );
+
+    if( seqDelta < PEER_CONNECTION_RECEPTION_STATS_MAX_DROPOUT )
+    {
+        /* In order, with permissible gap. */
+        if( rtpSeq < pReceptionStats->maxSequenceNumber )
+        {
+            /* Sequence number wrapped, count another 64K cycle. */
+            pReceptionStats->cycles += PEER_CONNECTION_RECEPTION_STATS_RTP_SEQ_MOD;
+        }
+        pReceptionStats->maxSequenceNumber = rtpSeq;
+    }
+    else if( seqDelta <= PEER_CONNECTION_RECEPTION_STATS_RTP_SEQ_MOD - PEER_CONNECTION_RECEPTION_STATS_MAX_MISORDER )
+    {
+        if( rtpSeq == pReceptionStats->badSequenceNumber )
+        {
+            /* Two sequential packets, assume that the other side restarted without telling us. */
+            LogInfo( ( "Sequence number of SSRC: %u restarts from %u", pReceptionStats->ssrc, rtpSeq ) );
+            InitSequence( pReceptionStats, rtpSeq );
+        }
+        else
+        {
+            pReceptionStats->badSequenceNumber = ( uint32_t )( ( rtpSeq + 1U ) & ( PEER_CONNECTION_RECEPTION_STATS_RTP_SEQ_MOD - 1U ) );
+            isValid = 0U;
+        }
+    }
+    else
+    {
+        /* Duplicate or reordered packet. */
+    }
+
+    return isValid;
+}
+
+static void UpdateJitter( PeerConnectionReceptionStats_t * pReceptionStats,
+                          uint32_t rtpTimestamp,
+                          uint32_t clockRate,
+                          uint64_t receiveTimeUs )
+{
+    /* https://datatracker.ietf.org/doc/html/rfc3550#appendix-A.8, the arrival time is in the same units as RTP timestamp. */
+    uint32_t arrival = ( uint32_t )( receiveTimeUs * clockRate / 1000000ULL );
+    uint32_t transit = arrival - rtpTimestamp;
+    int32_t transitDelta;
+
+    if( pReceptionStats->isTransitInit != 0U )
+    {
+        transitDelta = ( int32_t )( transit - pReceptionStats->lastTransit );
+        if( transitDelta < 0 )
+        {
+            transitDelta = -transitDelta;
+        }
+        pReceptionStats->jitter = ( uint32_t )( ( int64_t ) pReceptionStats->jitter + transitDelta - ( ( pReceptionStats->jitter + 8U ) >> 4 ) );
+    }
+
+    pReceptionStats->isTransitInit = 1U;
+    pReceptionStats->lastTransit = transit;
+}
+
+PeerConnectionResult_t PeerConnectionReceptionStats_Init( PeerConnectionReceptionStats_t * pReceptionStats )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( pReceptionStats == NULL )
+    {
+        LogError( ( "Invalid input, pReceptionStats: %p", pReceptionStats ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) && ( pReceptionStats->isMutexInit == 0U ) )
+    {
+        if( pthread_mutex_init( &( pReceptionStats->statsMutex ), NULL ) != 0 )
+        {
+            LogError( ( "Fail to create mutex for reception statistics." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_CREATE_RECEPTION_STATS_MUTEX;
+        }
+        else
+        {
+            pReceptionStats->isMutexInit = 1U;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        PeerConnectionReceptionStats_Reset( pReceptionStats );
+    }
+
+    return ret;
+}
+
+void PeerConnectionReceptionStats_Reset( PeerConnectionReceptionStats_t * pReceptionStats )
+{
+    if( ( pReceptionStats != NULL ) &&
+        ( pReceptionStats->isMutexInit != 0U ) &&
+        ( pthread_mutex_lock( &( pReceptionStats->statsMutex ) ) == 0 ) )
+    {
+        ClearStats( pReceptionStats );
+        pthread_mutex_unlock( &( pReceptionStats->statsMutex ) );
+    }
+}
+
+PeerConnectionResult_t PeerConnectionReceptionStats_OnPacketReceived( PeerConnectionReceptionStats_t * pReceptionStats,
+                                                                      uint32_t ssrc,
+                                                                      uint16_t rtpSeq,
+                                                                      uint32_t rtpTimestamp,
+                                                                      uint32_t clockRate,
+                                                                      uint64_t receiveTimeUs )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    uint8_t isLocked = 0U;
+
+    if( ( pReceptionStats == NULL ) || ( pReceptionStats->isMutexInit == 0U ) )
+    {
+        LogError( ( "Invalid input, pReceptionStats: %p", pReceptionStats ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_lock( &( pReceptionStats->statsMutex ) ) == 0 )
+        {
+            isLocked = 1U;
+        }
+        else
+        {
+            LogError( ( "Fail to take reception statistics mutex." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_RECEPTION_STATS_MUTEX;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( ( pReceptionStats->isStarted == 0U ) || ( pReceptionStats->ssrc != ssrc ) )
+        {
+            /* First packet from this source. */
+            ClearStats( pReceptionStats );
+            pReceptionStats->isStarted = 1U;
+            pReceptionStats->ssrc = ssrc;
+            InitSequence( pReceptionStats, rtpSeq );
+        }
+
+        if( UpdateSequence( pReceptionStats, rtpSeq ) != 0U )
+        {
+            pReceptionStats->receivedPacketCount++;
+
+            if( clockRate != 0U )
+            {
+                UpdateJitter( pReceptionStats,
+                              rtpTimestamp,
+                              clockRate,
+                              receiveTimeUs );
+            }
+        }
+    }
+
+    if( isLocked != 0U )
+    {
+        pthread_mutex_unlock( &( pReceptionStats->statsMutex ) );
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionReceptionStats_OnSenderReport( PeerConnectionReceptionStats_t * pReceptionStats,
+                                                                    uint64_t ntpTime,
+                                                                    uint64_t receiveTimeUs )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pReceptionStats == NULL ) || ( pReceptionStats->isMutexInit == 0U ) )
+    {
+        LogError( ( "Invalid input, pReceptionStats: %p", pReceptionStats ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else if( pthread_mutex_lock( &( pReceptionStats->statsMutex ) ) != 0 )
+    {
+        LogError( ( "Fail to take reception statistics mutex." ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_TAKE_RECEPTION_STATS_MUTEX;
+    }
+    else
+    {
+        /* The middle 32 bits of the NTP timestamp, the low 16 bits of the integer part and the high 16 bits of the fractional part. */
+        pReceptionStats->lastSenderReportNtp = ( uint32_t )( ( ntpTime >> 16U ) & 0xFFFFFFFFULL );
+        pReceptionStats->lastSenderReportReceiveTimeUs = receiveTimeUs;
+        pthread_mutex_unlock( &( pReceptionStats->statsMutex ) );
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionReceptionStats_GetReceptionReport( PeerConnectionReceptionStats_t * pReceptionStats,
+                                                                        uint64_t currentTimeUs,
+                                                                        RtcpReceptionReport_t * pReceptionReport )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    uint8_t isLocked = 0U;
+    uint32_t expected;
+    uint32_t expectedInterval;
+    uint32_t receivedInterval;
+    int64_t lost;
+    int64_t lostInterval;
+
+    if( ( pReceptionStats == NULL ) ||
+        ( pReceptionReport == NULL ) )
+    {
+        LogError( ( "Invalid input, pReceptionStats: %p, pReceptionReport: %p", pReceptionStats, pReceptionReport ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else if( pReceptionStats->isMutexInit == 0U )
+    {
+        /* The receiver has never been set up. */
+        ret = PEER_CONNECTION_RESULT_NO_RECEPTION_STATS;
+    }
+    else
+    {
+        if( pthread_mutex_lock( &( pReceptionStats->statsMutex ) ) == 0 )
+        {
+            isLocked = 1U;
+        }
+        else
+        {
+            LogError( ( "Fail to take reception statistics mutex." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_RECEPTION_STATS_MUTEX;
+        }
+    }
+
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) && ( pReceptionStats->isStarted == 0U ) )
+    {
+        ret = PEER_CONNECTION_RESULT_NO_RECEPTION_STATS;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* https://datatracker.ietf.org/doc/html/rfc3550#appendix-A.3 */
+        expected = pReceptionStats->cycles + pReceptionStats->maxSequenceNumber - pReceptionStats->baseSequenceNumber + 1U;
+        lost = ( int64_t ) expected - pReceptionStats->receivedPacketCount;
+        if( lost > PEER_CONNECTION_RECEPTION_STATS_MAX_CUMULATIVE_LOST )
+        {
+            lost = PEER_CONNECTION_RECEPTION_STATS_MAX_CUMULATIVE_LOST;
+        }
+        else if( lost < PEER_CONNECTION_RECEPTION_STATS_MIN_CUMULATIVE_LOST )
+        {
+            lost = PEER_CONNECTION_RECEPTION_STATS_MIN_CUMULATIVE_LOST;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+
+        expectedInterval = expected - pReceptionStats->expectedPrior;
+        pReceptionStats->expectedPrior = expected;
+        receivedInterval = pReceptionStats->receivedPacketCount - pReceptionStats->receivedPrior;
+        pReceptionStats->receivedPrior = pReceptionStats->receivedPacketCount;
+        lostInterval = ( int64_t ) expectedInterval - receivedInterval;
+
+        pReceptionReport->sourceSsrc = pReceptionStats->ssrc;
+        if( ( expectedInterval == 0U ) || ( lostInterval <= 0 ) )
+        {
+            /* Duplicates may make the number of packets lost negative, report no loss in that case. */
+            pReceptionReport->fractionLost = 0U;
+        }
+        else
+        {
+            pReceptionReport->fractionLost = ( uint8_t )( ( lostInterval << 8 ) / expectedInterval );
+        }
+        pReceptionReport->cumulativePacketsLost = ( uint32_t )( ( int32_t ) lost ) & 0xFFFFFFU;
+        pReceptionReport->extendedHighestSeqNumReceived = pReceptionStats->cycles + pReceptionStats->maxSequenceNumber;
+        pReceptionReport->interArrivalJitter = pReceptionStats->jitter >> 4;
+        pReceptionReport->lastSR = pReceptionStats->lastSenderReportNtp;
+
+        if( ( pReceptionStats->lastSenderReportNtp == 0U ) ||
+            ( currentTimeUs < pReceptionStats->lastSenderReportReceiveTimeUs ) )
+        {
+            /* No sender report received from this source yet. */
+            pReceptionReport->delaySinceLastSR = 0U;
+        }
+        else
+        {
+            pReceptionReport->delaySinceLastSR = ( uint32_t )( ( currentTimeUs - pReceptionStats->lastSenderReportReceiveTimeUs ) * PEER_CONNECTION_RECEPTION_STATS_DLSR_TIMESCALE / 1000000ULL );
+        }
+    }
+
+    if( isLocked != 0U )
+    {
+        pthread_mutex_unlock( &( pReceptionStats->statsMutex ) );
+    }
+
+    return ret;
+}
@@ -0,0 +1,63 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PEER_CONNECTION_RECEPTION_STATS_H
+#define PEER_CONNECTION_RECEPTION_STATS_H
+
+#pragma once
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+
+#include "peer_connection_data_types.h"
+
+PeerConnectionResult_t PeerConnectionReceptionStats_Init( PeerConnectionReceptionStats_t * pReceptionStats );
+
+/* Forget the statistics of previous source, the mutex is kept for next initialization. */
+void PeerConnectionReceptionStats_Reset( PeerConnectionReceptionStats_t * pReceptionStats );
+
+/* Update the sequence number and interarrival jitter statistics with a received RTP packet. */
+PeerConnectionResult_t PeerConnectionReceptionStats_OnPacketReceived( PeerConnectionReceptionStats_t * pReceptionStats,
+                                                                      uint32_t ssrc,
+                                                                      uint16_t rtpSeq,
+                                                                      uint32_t rtpTimestamp,
+                                                                      uint32_t clockRate,
+                                                                      uint64_t receiveTimeUs );
+
+/* Remember the NTP timestamp of the sender report received from the source, for LSR/DLSR. */
+PeerConnectionResult_t PeerConnectionReceptionStats_OnSenderReport( PeerConnectionReceptionStats_t * pReceptionStats,
+                                                                    uint64_t ntpTime,
+                                                                    uint64_t receiveTimeUs );
+
+/* Fill the reception report block since last call, PEER_CONNECTION_RESULT_NO_RECEPTION_STATS if nothing is received yet.
+ * The receive times passed in must come from the same clock as currentTimeUs. */
+PeerConnectionResult_t PeerConnectionReceptionStats_GetReceptionReport( PeerConnectionReceptionStats_t * pReceptionStats,
+                                                                        uint64_t currentTimeUs,
+                                                                        RtcpReceptionReport_t * pReceptionReport );
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+}
+#endif
+/* *INDENT-ON* */
+
+#endif /* PEER_CONNECTION_RECEPTION_STATS_H */
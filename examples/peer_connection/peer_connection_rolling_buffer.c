@@ -21,6 +21,27 @@
 
 //#include "FreeRTOS.h"
 
+/* Keep every slab slot aligned for PeerConnectionRollingBufferPacket_t. */
+#define PEER_CONNECTION_ROLLING_BUFFER_ALIGN_SIZE( size ) ( ( ( size ) + sizeof( void * ) - 1 ) & ~( sizeof( void * ) - 1 ) )
+
+static void FreeSlab( PeerConnectionRollingBuffer_t * pRollingBuffer )
+{
+    if( pRollingBuffer->pSlab != NULL )
+    {
+        free( pRollingBuffer->pSlab );
+        pRollingBuffer->pSlab = NULL;
+    }
+
+    if( pRollingBuffer->pFreeSlotIndexes != NULL )
+    {
+        free( pRollingBuffer->pFreeSlotIndexes );
+        pRollingBuffer->pFreeSlotIndexes = NULL;
+    }
+
+    pRollingBuffer->slabSlotCount = 0;
+    pRollingBuffer->freeSlotCount = 0;
+}
+
 PeerConnectionResult_t PeerConnectionRollingBuffer_Create( PeerConnectionRollingBuffer_t * pRollingBuffer,
                                                            uint32_t rollingbufferBitRate,  // bps
                                                            uint32_t rollingbufferDurationSec,  // duration in seconds
@@ -28,6 +49,7 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_Create( PeerConnectionRolling
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     RtpPacketQueueResult_t resultRtpPacketQueue;
+    size_t i;
 
     if( ( pRollingBuffer == NULL ) ||
         ( rollingbufferBitRate == 0 ) ||
@@ -44,6 +66,8 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_Create( PeerConnectionRolling
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
+        pRollingBuffer->pSlab = NULL;
+        pRollingBuffer->pFreeSlotIndexes = NULL;
         pRollingBuffer->maxSizePerPacket = maxSizePerPacket;
         pRollingBuffer->capacity = rollingbufferDurationSec * rollingbufferBitRate / 8U / maxSizePerPacket;
         pRollingBuffer->packetQueue.pRtpPacketInfoArray = ( RtpPacketInfo_t * )malloc( pRollingBuffer->capacity * sizeof( RtpPacketInfo_t ) );
@@ -76,10 +100,48 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_Create( PeerConnectionRolling
         }
     }
 
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* Allocate all packet slots at once, so sending doesn't need any heap allocation. */
+        pRollingBuffer->slabSlotSize = PEER_CONNECTION_ROLLING_BUFFER_ALIGN_SIZE( sizeof( PeerConnectionRollingBufferPacket_t ) + maxSizePerPacket );
+        pRollingBuffer->slabSlotCount = pRollingBuffer->capacity + PEER_CONNECTION_ROLLING_BUFFER_SPARE_SLOT_NUM;
+        pRollingBuffer->pSlab = ( uint8_t * )malloc( pRollingBuffer->slabSlotCount * pRollingBuffer->slabSlotSize );
+        pRollingBuffer->pFreeSlotIndexes = ( size_t * )malloc( pRollingBuffer->slabSlotCount * sizeof( size_t ) );
+        if( ( pRollingBuffer->pSlab == NULL ) || ( pRollingBuffer->pFreeSlotIndexes == NULL ) )
+        {
+            LogError( ( "No memory available for allocating rolling buffer slab with total size %lu, slot count: %lu, slot size: %lu",
+                        pRollingBuffer->slabSlotCount * pRollingBuffer->slabSlotSize,
+                        pRollingBuffer->slabSlotCount,
+                        pRollingBuffer->slabSlotSize ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_ROLLING_BUFFER_SLAB_NO_ENOUGH_MEMORY;
+        }
+        else
+        {
+            for( i = 0; i < pRollingBuffer->slabSlotCount; i++ )
+            {
+                pRollingBuffer->pFreeSlotIndexes[ i ] = pRollingBuffer->slabSlotCount - 1 - i;
+            }
+            pRollingBuffer->freeSlotCount = pRollingBuffer->slabSlotCount;
+        }
+    }
+
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         pRollingBuffer->isInit = 1U;
     }
+    else if( ret != PEER_CONNECTION_RESULT_BAD_PARAMETER )
+    {
+        FreeSlab( pRollingBuffer );
+        if( pRollingBuffer->packetQueue.pRtpPacketInfoArray != NULL )
+        {
+            free( pRollingBuffer->packetQueue.pRtpPacketInfoArray );
+            pRollingBuffer->packetQueue.pRtpPacketInfoArray = NULL;
+        }
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
 
     return ret;
 }
@@ -87,8 +149,6 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_Create( PeerConnectionRolling
 void PeerConnectionRollingBuffer_Free( PeerConnectionRollingBuffer_t * pRollingBuffer )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
-    RtpPacketQueueResult_t resultRtpPacketQueue = RTP_PACKET_QUEUE_RESULT_OK;
-    RtpPacketInfo_t rtpPacketInfo;
 
     if( pRollingBuffer == NULL )
     {
@@ -110,15 +170,8 @@ void PeerConnectionRollingBuffer_Free( PeerConnectionRollingBuffer_t * pRollingB
     {
         pRollingBuffer->isInit = 0U;
 
-        while( resultRtpPacketQueue == RTP_PACKET_QUEUE_RESULT_OK )
-        {
-            resultRtpPacketQueue = RtpPacketQueue_Dequeue( &pRollingBuffer->packetQueue,
-                                                           &rtpPacketInfo );
-            if( ( resultRtpPacketQueue == RTP_PACKET_QUEUE_RESULT_OK ) && ( rtpPacketInfo.pSerializedRtpPacket != NULL ) )
-            {
-                free( rtpPacketInfo.pSerializedRtpPacket );
-            }
-        }
+        /* The packets in the queue live in the slab, they're released together with it. */
+        FreeSlab( pRollingBuffer );
 
         if( pRollingBuffer->packetQueue.pRtpPacketInfoArray != NULL )
         {
@@ -151,9 +204,15 @@ PeerConnectionResult_t PeerConnectionRollingBuffer_GetRtpSequenceBuffer( PeerCon
         LogError( ( "Rolling buffer is not initialized yet." ) );
         ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
+    else if( pRollingBuffer->freeSlotCount == 0 )
+    {
+        LogError( ( "No free slot in rolling buffer slab, slot count: %lu", pRollingBuffer->slabSlotCount ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_ROLLING_BUFFER_NO_FREE_SLOT;
+    }
     else
     {
-        *ppPacket = ( PeerConnectionRollingBufferPacket_t * )malloc( sizeof( PeerConnectionRollingBufferPacket_t ) + pRollingBuffer->maxSizePerPacket );
+        pRollingBuffer->freeSlotCount--;
+        *ppPacket = ( PeerConnectionRollingBufferPacket_t * )( pRollingBuffer->pSlab + pRollingBuffer->pFreeSlotIndexes[ pRollingBuffer->freeSlotCount ] * pRollingBuffer->slabSlotSize );
         ( *ppPacket )->pPacketBuffer = ( uint8_t * )( ( *ppPacket ) + 1 );
         ( *ppPacket )->packetBufferLength = pRollingBuffer->maxSizePerPacket;
     }
@@ -174,9 +233,16 @@ void PeerConnectionRollingBuffer_DiscardRtpSequenceBuffer( PeerConnectionRolling
     {
         LogWarn( ( "Rolling buffer is not initialized yet or it has been freed." ) );
     }
+    else if( ( ( uint8_t * ) pPacket < pRollingBuffer->pSlab ) ||
+             ( ( uint8_t * ) pPacket >= pRollingBuffer->pSlab + pRollingBuffer->slabSlotCount * pRollingBuffer->slabSlotSize ) ||
+             ( pRollingBuffer->freeSlotCount >= pRollingBuffer->slabSlotCount ) )
+    {
+        LogError( ( "The packet %p doesn't belong to the rolling buffer slab.", pPacket ) );
+    }
     else
     {
-        free( pPacket );
+        /* Return the slot to the slab. */
+        pRollingBuffer->pFreeSlotIndexes[ pRollingBuffer->freeSlotCount++ ] = ( ( uint8_t * ) pPacket - pRollingBuffer->pSlab ) / pRollingBuffer->slabSlotSize;
     }
 }
 
@@ -34,6 +34,8 @@ extern "C" {
 #include "peer_connection_data_types.h"
 
 #define PEER_CONNECTION_ROLLING_BUFFER_DURATION_IN_SECONDS ( 3 )
+/* Slots reserved on top of the capacity for the packets being prepared before PeerConnectionRollingBuffer_SetPacket(). */
+#define PEER_CONNECTION_ROLLING_BUFFER_SPARE_SLOT_NUM ( 2 )
 
 PeerConnectionResult_t PeerConnectionRollingBuffer_Create( PeerConnectionRollingBuffer_t * pRollingBuffer,
                                                            uint32_t rollingbufferBitRate,  // bps
@@ -20,6 +20,12 @@
 #include "peer_connection_srtcp.h"
 #include "peer_connection_srtp.h"
 #include "peer_connection_rolling_buffer.h"
+#include "peer_connection_nack_generator.h"
+#include "peer_connection_reception_stats.h"
+#include "peer_connection_twcc_feedback.h"
+#include "peer_connection_twcc_history.h"
+#include "peer_connection_bandwidth_estimator.h"
+#include "peer_connection_pacer.h"
 
 /* API includes. */
 #include "rtp_api.h"
@@ -44,6 +50,28 @@
 /*   bits of the integer part and the high 16 bits of the fractional part. */
 #define PEER_CONNECTION_SRTCP_MID_NTP( currentTimeNTP )    ( uint32_t ) ( ( currentTimeNTP >> 16U ) & 0xffffffffULL )
 
+/* https://datatracker.ietf.org/doc/html/rfc4585#section-6.2.1 */
+#define PEER_CONNECTION_SRTCP_RTCP_VERSION                           ( 2 )
+#define PEER_CONNECTION_SRTCP_RTPFB_PACKET_TYPE                      ( 205 )
+#define PEER_CONNECTION_SRTCP_GENERIC_NACK_FMT                       ( 1 )
+#define PEER_CONNECTION_SRTCP_FEEDBACK_HEADER_LENGTH                 ( 12 )
+#define PEER_CONNECTION_SRTCP_NACK_FCI_LENGTH                        ( 4 )
+#define PEER_CONNECTION_SRTCP_NACK_BLP_BITS                          ( 16 )
+
+/* https://datatracker.ietf.org/doc/html/rfc3550#section-6.4.2 */
+#define PEER_CONNECTION_SRTCP_RR_PACKET_TYPE                         ( 201 )
+#define PEER_CONNECTION_SRTCP_RR_HEADER_LENGTH                       ( 8 )
+#define PEER_CONNECTION_SRTCP_WRITE_UINT16( pBuffer, value )                \
+    do {                                                                    \
+        ( pBuffer )[ 0 ] = ( uint8_t )( ( ( value ) >> 8 ) & 0xFF );        \
+        ( pBuffer )[ 1 ] = ( uint8_t )( ( value ) & 0xFF );                 \
+    } while( 0 )
+#define PEER_CONNECTION_SRTCP_WRITE_UINT32( pBuffer, value )                \
+    do {                                                                    \
+        PEER_CONNECTION_SRTCP_WRITE_UINT16( pBuffer, ( value ) >> 16 );     \
+        PEER_CONNECTION_SRTCP_WRITE_UINT16( &( pBuffer )[ 2 ], value );     \
+    } while( 0 )
+
 /*-----------------------------------------------------------*/
 
 static PeerConnectionResult_t PeerConnectionSrtcp_MatchRemoteBySsrc( PeerConnectionSession_t * pSession,
@@ -78,7 +106,6 @@ static PeerConnectionResult_t ResendSrtpPacket( PeerConnectionSession_t * pSessi
     PeerConnectionSrtpSender_t * pSrtpSender = NULL;
     uint8_t isSenderLocked = 0U;
     PeerConnectionRollingBufferPacket_t * pRollingBufferPacket = NULL;
-    IceControllerResult_t resultIceController;
     uint8_t bufferAfterEncrypt = 1;
     uint8_t srtpBuffer[ PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH ];
     uint8_t * pSrtpPacket = NULL;
@@ -197,13 +224,17 @@ static PeerConnectionResult_t ResendSrtpPacket( PeerConnectionSession_t * pSessi
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        resultIceController = IceController_SendToRemotePeer( &pSession->iceControllerContext,
-                                                              pSrtpPacket,
-                                                              srtpPacketLength );
-
-        if( resultIceController != ICE_CONTROLLER_RESULT_OK )
+        /* Re-transmissions are paced as well, ahead of the video but behind the audio. */
+        ret = PeerConnectionPacer_EnqueuePacket( &pSession->pacer,
+                                                 PEER_CONNECTION_PACER_PRIORITY_RETRANSMISSION,
+                                                 pSrtpPacket,
+                                                 srtpPacketLength,
+                                                 0U,
+                                                 0U );
+
+        if( ret != PEER_CONNECTION_RESULT_OK )
         {
-            LogWarn( ( "Fail to re-send RTP packet, ret: %d, seq: %u, SSRC: 0x%x", resultIceController, rtpSeq, ssrc ) );
+            LogWarn( ( "Fail to re-send RTP packet, ret: %d, seq: %u, SSRC: 0x%x", ret, rtpSeq, ssrc ) );
             ret = PEER_CONNECTION_RESULT_FAIL_ICE_CONTROLLER_RESEND_RTP_PACKET;
         }
         else
@@ -340,12 +371,9 @@ static PeerConnectionResult_t OnRtcpNackEvent( PeerConnectionSession_t * pSessio
     {
         PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
         RtcpResult_t resultRtcp;
-        RtcpTwccManagerResult_t resultRtcpTwccManager = RTCP_TWCC_MANAGER_RESULT_OK;
         RtcpTwccPacket_t twccPacket;
-        TwccPacketInfo_t * pTwccPacketInfo;
         TwccBandwidthInfo_t twccBandwidthInfo;
         PacketArrivalInfo_t packetArrivalInfo[ PEER_CONNECTION_RTCP_TWCC_MAX_ARRAY ];
-        int i;
 
 
         if( ( pSession == NULL ) || ( pRtcpPacket == NULL ) )
@@ -377,31 +405,21 @@ static PeerConnectionResult_t OnRtcpNackEvent( PeerConnectionSession_t * pSessio
 
         if( ret == PEER_CONNECTION_RESULT_OK )
         {
-            for( i = 0; i < twccPacket.arrivalInfoListLength; i++ )
-            {
-                /* Checks if the seq number already exists. */
-                resultRtcpTwccManager = RtcpTwccManager_FindPacketInfo( &pSession->pCtx->rtcpTwccManager,
-                                                                        twccPacket.pArrivalInfoList[ i ].seqNum,
-                                                                        &pTwccPacketInfo );
-
-                if( resultRtcpTwccManager == RTCP_TWCC_MANAGER_RESULT_OK )
-                {
-                    pTwccPacketInfo->localSentTime = twccPacket.pArrivalInfoList[ i ].remoteArrivalTime;
-                }
-            }
+            ret = PeerConnectionTwccHistory_OnFeedback( &pSession->twccHistory,
+                                                        twccPacket.pArrivalInfoList,
+                                                        twccPacket.arrivalInfoListLength,
+                                                        &pSession->bandwidthEstimator,
+                                                        &twccBandwidthInfo );
         }
 
         if( ret == PEER_CONNECTION_RESULT_OK )
         {
-            resultRtcpTwccManager = RtcpTwccManager_HandleTwccPacket( &pSession->pCtx->rtcpTwccManager,
-                                                                      &twccPacket,
-                                                                      &twccBandwidthInfo );
+            ( void ) PeerConnectionBandwidthEstimator_Update( &pSession->bandwidthEstimator,
+                                                              NetworkingUtils_GetCurrentTimeUs( NULL ) );
 
-            if( resultRtcpTwccManager != RTCP_TWCC_MANAGER_RESULT_OK )
-            {
-                LogError( ( "Fail to handle RTCP TWCC packet, result: %d", resultRtcpTwccManager ) );
-                ret = PEER_CONNECTION_RESULT_FAIL_RTCP_HANDLE_TWCC;
-            }
+            /* Follow the estimate with the pacing rate, the media encoders catch up later. */
+            ( void ) PeerConnectionPacer_SetBitrate( &pSession->pacer,
+                                                     pSession->bandwidthEstimator.targetBitrateBps );
         }
 
         if( ret == PEER_CONNECTION_RESULT_OK )
@@ -540,6 +558,7 @@ static PeerConnectionResult_t OnRtcpRembEvent( PeerConnectionSession_t * pSessio
     RtcpRembPacket_t rembPacket;
     const Transceiver_t * pTransceiver = NULL;
     uint32_t ssrcList[ PEER_CONNECTION_SRTCP_REMB_MAX_SSRC_NUM ];
+    uint8_t isSsrcMatched = 0U;
     int i;
 
     if( ( pSession == NULL ) || ( pRtcpPacket == NULL ) )
@@ -575,11 +594,12 @@ static PeerConnectionResult_t OnRtcpRembEvent( PeerConnectionSession_t * pSessio
 
             if( ret == PEER_CONNECTION_RESULT_OK )
             {
-                /* Initiate a callback to update the estimated maximum bitrate to adjust sending rate based on receiver's feedback. */
+                isSsrcMatched = 1U;
             }
             else if( ret == PEER_CONNECTION_RESULT_UNKNOWN_SSRC )
             {
                 LogWarn( ( "Received REMB for non existing ssrc: %u", rembPacket.pSsrcList[ i ] ) );
+                ret = PEER_CONNECTION_RESULT_OK;
             }
             else
             {
@@ -588,6 +608,20 @@ static PeerConnectionResult_t OnRtcpRembEvent( PeerConnectionSession_t * pSessio
         }
     }
 
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) && ( isSsrcMatched != 0U ) )
+    {
+        LogVerbose( ( "RTCP_PACKET_PAYLOAD_FEEDBACK_REMB, bitrate: %lu bps, SSRC number: %lu",
+                      ( uint64_t ) rembPacket.bitRate,
+                      ( uint64_t ) rembPacket.ssrcListLength ) );
+
+        /* The estimated maximum bitrate applies to all the SSRCs listed, so the callback is called once per REMB packet. */
+        if( pSession->onReceiverEstimatedMaximumBitrateCallback != NULL )
+        {
+            pSession->onReceiverEstimatedMaximumBitrateCallback( pSession->pReceiverEstimatedMaximumBitrateUserContext,
+                                                                 &rembPacket );
+        }
+    }
+
     return ret;
 }
 
@@ -653,6 +687,27 @@ static PeerConnectionResult_t OnRtcpSenderReportEvent( PeerConnectionSession_t *
         }
     }
 
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* Keep LSR and its arrival time for the reception report blocks sent to this source. */
+        if( senderReport.senderSsrc == pSession->rtpConfig.remoteVideoSsrc )
+        {
+            ( void ) PeerConnectionReceptionStats_OnSenderReport( &pSession->videoSrtpReceiver.receptionStats,
+                                                                  senderReport.senderInfo.ntpTime,
+                                                                  NetworkingUtils_GetCurrentMonotonicTimeUs( NULL ) );
+        }
+        else if( senderReport.senderSsrc == pSession->rtpConfig.remoteAudioSsrc )
+        {
+            ( void ) PeerConnectionReceptionStats_OnSenderReport( &pSession->audioSrtpReceiver.receptionStats,
+                                                                  senderReport.senderInfo.ntpTime,
+                                                                  NetworkingUtils_GetCurrentMonotonicTimeUs( NULL ) );
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+
     return ret;
 }
 
@@ -746,6 +801,12 @@ static PeerConnectionResult_t OnRtcpReceiverReportEvent( PeerConnectionSession_t
                 roundTripPropagationDelay = currentTimeNTP - receiverReport.pReceptionReports[ 0 ].lastSR - receiverReport.pReceptionReports[ 0 ].delaySinceLastSR;
                 roundTripPropagationDelay = ( roundTripPropagationDelay * 1000 ) / PEER_CONNECTION_SRTCP_DLSR_TIMESCALE;                             /* The Round Trip Propogation Delay is in ms unit. */
 
+                /* Both directions share the same path, so the RTT paces the NACK retries of our receivers as well. */
+                PeerConnectionNackGenerator_UpdateRtt( &pSession->videoSrtpReceiver.nackGenerator,
+                                                       ( uint64_t ) roundTripPropagationDelay * 1000U );
+                PeerConnectionNackGenerator_UpdateRtt( &pSession->audioSrtpReceiver.nackGenerator,
+                                                       ( uint64_t ) roundTripPropagationDelay * 1000U );
+
                 if( pTransceiver->trackKind == TRANSCEIVER_TRACK_KIND_AUDIO )
                 {
                     LogVerbose( ( "RTCP_PACKET_TYPE_RECEIVER_REPORT Round Trip Propagation Delay for Audio : %u ms", roundTripPropagationDelay ) );
@@ -763,6 +824,57 @@ static PeerConnectionResult_t OnRtcpReceiverReportEvent( PeerConnectionSession_t
     return ret;
 }
 
+static PeerConnectionResult_t ProtectRtcpPacket( PeerConnectionSession_t * pSession,
+                                                 uint8_t * pRtcpPacket,
+                                                 size_t rtcpPacketLength,
+                                                 size_t * pOutputSrtcpPacketLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    srtp_err_status_t errorStatus;
+    uint8_t isLocked = 0U;
+
+    if( pthread_mutex_lock( &( pSession->srtpTransmitMutex ) ) == 0 )
+    {
+        isLocked = 1U;
+    }
+    else
+    {
+        LogError( ( "Fail to take Tx SRTP session mutex to construct SRTCP packet." ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
+    }
+
+    /* Encrypt it by SRTP. */
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pSession->srtpTransmitSession != NULL )
+        {
+            errorStatus = srtp_protect_rtcp( pSession->srtpTransmitSession,
+                                             pRtcpPacket,
+                                             rtcpPacketLength,
+                                             pRtcpPacket,
+                                             pOutputSrtcpPacketLength,
+                                             0 );
+            if( errorStatus != srtp_err_status_ok )
+            {
+                LogError( ( "Fail to encrypt Tx SRTCP packet, errorStatus: %d", errorStatus ) );
+                ret = PEER_CONNECTION_RESULT_FAIL_ENCRYPT_SRTP_RTCP_PACKET;
+            }
+        }
+        else
+        {
+            LogError( ( "SRTP session has been freed before encrypting." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_ENCRYPT_SRTP_RTCP_PACKET;
+        }
+    }
+
+    if( isLocked != 0U )
+    {
+        pthread_mutex_unlock( &( pSession->srtpTransmitMutex ) );
+    }
+
+    return ret;
+}
+
 PeerConnectionResult_t PeerConnectionSrtcp_ConstructSenderReportPacket( PeerConnectionSession_t * pSession,
                                                                         RtcpSenderReport_t * pSenderReport,
                                                                         uint8_t * pOutputSrtcpPacket,
@@ -771,8 +883,6 @@ PeerConnectionResult_t PeerConnectionSrtcp_ConstructSenderReportPacket( PeerConn
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     RtcpResult_t resultRtcp;
     size_t rtcpBufferLength;
-    srtp_err_status_t errorStatus;
-    uint8_t isLocked = 0U;
 
     if( ( pSession == NULL ) ||
         ( pSenderReport == NULL ) ||
@@ -810,48 +920,233 @@ PeerConnectionResult_t PeerConnectionSrtcp_ConstructSenderReportPacket( PeerConn
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( pthread_mutex_lock( &( pSession->srtpSessionMutex ) ) == 0 )
+        ret = ProtectRtcpPacket( pSession,
+                                 pOutputSrtcpPacket,
+                                 rtcpBufferLength,
+                                 pOutputSrtcpPacketLength );
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionSrtcp_ConstructNackPacket( PeerConnectionSession_t * pSession,
+                                                                uint32_t senderSsrc,
+                                                                uint32_t mediaSsrc,
+                                                                const uint16_t * pSeqList,
+                                                                size_t seqListLength,
+                                                                uint8_t * pOutputSrtcpPacket,
+                                                                size_t * pOutputSrtcpPacketLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    size_t rtcpBufferLength = PEER_CONNECTION_SRTCP_FEEDBACK_HEADER_LENGTH;
+    uint16_t packetId;
+    uint16_t lostBitmask;
+    uint16_t seqDiff;
+    size_t i = 0U;
+
+    if( ( pSession == NULL ) ||
+        ( pSeqList == NULL ) ||
+        ( seqListLength == 0U ) ||
+        ( pOutputSrtcpPacket == NULL ) ||
+        ( pOutputSrtcpPacketLength == NULL ) )
+    {
+        LogError( ( "Invalid input, pSession: %p, pSeqList: %p, seqListLength: %lu, pOutputSrtcpPacket: %p, pOutputSrtcpPacketLength: %p",
+                    pSession,
+                    pSeqList,
+                    seqListLength,
+                    pOutputSrtcpPacket,
+                    pOutputSrtcpPacketLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else if( *pOutputSrtcpPacketLength < PEER_CONNECTION_SRTCP_FEEDBACK_HEADER_LENGTH )
+    {
+        LogError( ( "The output buffer length: %lu is too short for a RTCP NACK packet", *pOutputSrtcpPacketLength ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_RTCP_SERIALIZE_NACK;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    /* Each FCI carries a packet ID and a bitmask of the following 16 lost packets. */
+    while( ( ret == PEER_CONNECTION_RESULT_OK ) && ( i < seqListLength ) )
+    {
+        if( rtcpBufferLength + PEER_CONNECTION_SRTCP_NACK_FCI_LENGTH > *pOutputSrtcpPacketLength )
         {
-            isLocked = 1U;
+            LogError( ( "No space for the FCI of seq: %u in RTCP NACK packet", pSeqList[ i ] ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_RTCP_SERIALIZE_NACK;
+            break;
         }
-        else
+
+        packetId = pSeqList[ i ];
+        lostBitmask = 0U;
+        for( i++; i < seqListLength; i++ )
         {
-            LogError( ( "Fail to take SRTP session mutex to construct SRTCP packet." ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
+            seqDiff = ( uint16_t )( pSeqList[ i ] - packetId );
+            if( ( seqDiff == 0U ) || ( seqDiff > PEER_CONNECTION_SRTCP_NACK_BLP_BITS ) )
+            {
+                break;
+            }
+            lostBitmask |= ( uint16_t )( 1U << ( seqDiff - 1U ) );
         }
+
+        PEER_CONNECTION_SRTCP_WRITE_UINT16( &pOutputSrtcpPacket[ rtcpBufferLength ], packetId );
+        PEER_CONNECTION_SRTCP_WRITE_UINT16( &pOutputSrtcpPacket[ rtcpBufferLength + 2 ], lostBitmask );
+        rtcpBufferLength += PEER_CONNECTION_SRTCP_NACK_FCI_LENGTH;
     }
 
-    /* Encrypt it by SRTP. */
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( pSession->srtpTransmitSession != NULL )
+        /* The length field is the packet length in 32-bit words minus one. */
+        pOutputSrtcpPacket[ 0 ] = ( uint8_t )( ( PEER_CONNECTION_SRTCP_RTCP_VERSION << 6 ) | PEER_CONNECTION_SRTCP_GENERIC_NACK_FMT );
+        pOutputSrtcpPacket[ 1 ] = PEER_CONNECTION_SRTCP_RTPFB_PACKET_TYPE;
+        PEER_CONNECTION_SRTCP_WRITE_UINT16( &pOutputSrtcpPacket[ 2 ], ( rtcpBufferLength / 4U ) - 1U );
+        PEER_CONNECTION_SRTCP_WRITE_UINT32( &pOutputSrtcpPacket[ 4 ], senderSsrc );
+        PEER_CONNECTION_SRTCP_WRITE_UINT32( &pOutputSrtcpPacket[ 8 ], mediaSsrc );
+
+        ret = ProtectRtcpPacket( pSession,
+                                 pOutputSrtcpPacket,
+                                 rtcpBufferLength,
+                                 pOutputSrtcpPacketLength );
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionSrtcp_ConstructReceiverReportPacket( PeerConnectionSession_t * pSession,
+                                                                          uint32_t senderSsrc,
+                                                                          const RtcpReceptionReport_t * pReceptionReports,
+                                                                          size_t numReceptionReports,
+                                                                          uint8_t * pOutputSrtcpPacket,
+                                                                          size_t * pOutputSrtcpPacketLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    size_t rtcpBufferLength = PEER_CONNECTION_SRTCP_RR_HEADER_LENGTH + numReceptionReports * PEER_CONNECTION_SRTCP_RECEPTION_REPORT_BLOCK_LENGTH;
+    uint8_t * pReportBlock;
+    size_t i;
+
+    if( ( pSession == NULL ) ||
+        ( ( pReceptionReports == NULL ) && ( numReceptionReports != 0U ) ) ||
+        ( pOutputSrtcpPacket == NULL ) ||
+        ( pOutputSrtcpPacketLength == NULL ) )
+    {
+        LogError( ( "Invalid input, pSession: %p, pReceptionReports: %p, numReceptionReports: %lu, pOutputSrtcpPacket: %p, pOutputSrtcpPacketLength: %p",
+                    pSession,
+                    pReceptionReports,
+                    numReceptionReports,
+                    pOutputSrtcpPacket,
+                    pOutputSrtcpPacketLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else if( numReceptionReports > PEER_CONNECTION_RTCP_RECEIVER_REPORT_RECEPTION_REPORT_NUM )
+    {
+        LogError( ( "Too many reception report blocks: %lu in one RTCP Receiver Report", numReceptionReports ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_RTCP_SERIALIZE_RECEIVER_REPORT;
+    }
+    else if( *pOutputSrtcpPacketLength < rtcpBufferLength )
+    {
+        LogError( ( "The output buffer length: %lu is too short for a RTCP Receiver Report with %lu blocks", *pOutputSrtcpPacketLength, numReceptionReports ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_RTCP_SERIALIZE_RECEIVER_REPORT;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* The length field is the packet length in 32-bit words minus one. */
+        pOutputSrtcpPacket[ 0 ] = ( uint8_t )( ( PEER_CONNECTION_SRTCP_RTCP_VERSION << 6 ) | numReceptionReports );
+        pOutputSrtcpPacket[ 1 ] = PEER_CONNECTION_SRTCP_RR_PACKET_TYPE;
+        PEER_CONNECTION_SRTCP_WRITE_UINT16( &pOutputSrtcpPacket[ 2 ], ( rtcpBufferLength / 4U ) - 1U );
+        PEER_CONNECTION_SRTCP_WRITE_UINT32( &pOutputSrtcpPacket[ 4 ], senderSsrc );
+
+        for( i = 0; i < numReceptionReports; i++ )
         {
-            errorStatus = srtp_protect_rtcp( pSession->srtpTransmitSession,
-                                             pOutputSrtcpPacket,
-                                             rtcpBufferLength,
-                                             pOutputSrtcpPacket,
-                                             pOutputSrtcpPacketLength,
-                                             0 );
-            if( errorStatus != srtp_err_status_ok )
-            {
-                LogError( ( "Fail to encrypt Tx SRTCP packet, errorStatus: %d", errorStatus ) );
-                ret = PEER_CONNECTION_RESULT_FAIL_ENCRYPT_SRTP_RTCP_PACKET;
-            }
+            pReportBlock = &pOutputSrtcpPacket[ PEER_CONNECTION_SRTCP_RR_HEADER_LENGTH + i * PEER_CONNECTION_SRTCP_RECEPTION_REPORT_BLOCK_LENGTH ];
+            PEER_CONNECTION_SRTCP_WRITE_UINT32( &pReportBlock[ 0 ], pReceptionReports[ i ].sourceSsrc );
+            PEER_CONNECTION_SRTCP_WRITE_UINT32( &pReportBlock[ 4 ], ( ( uint32_t ) pReceptionReports[ i ].fractionLost << 24 ) | ( ( uint32_t ) pReceptionReports[ i ].cumulativePacketsLost & 0xFFFFFFU ) );
+            PEER_CONNECTION_SRTCP_WRITE_UINT32( &pReportBlock[ 8 ], pReceptionReports[ i ].extendedHighestSeqNumReceived );
+            PEER_CONNECTION_SRTCP_WRITE_UINT32( &pReportBlock[ 12 ], pReceptionReports[ i ].interArrivalJitter );
+            PEER_CONNECTION_SRTCP_WRITE_UINT32( &pReportBlock[ 16 ], pReceptionReports[ i ].lastSR );
+            PEER_CONNECTION_SRTCP_WRITE_UINT32( &pReportBlock[ 20 ], pReceptionReports[ i ].delaySinceLastSR );
         }
-        else
+
+        ret = ProtectRtcpPacket( pSession,
+                                 pOutputSrtcpPacket,
+                                 rtcpBufferLength,
+                                 pOutputSrtcpPacketLength );
+    }
+
+    return ret;
+}
+
+#if ENABLE_TWCC_SUPPORT
+PeerConnectionResult_t PeerConnectionSrtcp_ConstructTwccFeedbackPacket( PeerConnectionSession_t * pSession,
+                                                                        uint8_t * pOutputSrtcpPacket,
+                                                                        size_t * pOutputSrtcpPacketLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    size_t rtcpBufferLength;
+    uint32_t senderSsrc = 0U;
+    uint32_t mediaSsrc;
+    uint32_t i;
+
+    if( ( pSession == NULL ) ||
+        ( pOutputSrtcpPacket == NULL ) ||
+        ( pOutputSrtcpPacketLength == NULL ) )
+    {
+        LogError( ( "Invalid input, pSession: %p, pOutputSrtcpPacket: %p, pOutputSrtcpPacketLength: %p",
+                    pSession,
+                    pOutputSrtcpPacket,
+                    pOutputSrtcpPacketLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* The feedback covers all media on the transport, any local and remote SSRC identifies it. */
+        if( pSession->transceiverCount > 0U )
         {
-            LogError( ( "SRTP session has been freed before encrypting." ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_ENCRYPT_SRTP_RTCP_PACKET;
+            senderSsrc = pSession->pTransceivers[ 0 ]->ssrc;
+        }
+        for( i = 0; i < pSession->transceiverCount; i++ )
+        {
+            if( pSession->pTransceivers[ i ]->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO )
+            {
+                senderSsrc = pSession->pTransceivers[ i ]->ssrc;
+                break;
+            }
         }
+        mediaSsrc = ( pSession->rtpConfig.remoteVideoSsrc != 0U ) ? pSession->rtpConfig.remoteVideoSsrc : pSession->rtpConfig.remoteAudioSsrc;
+
+        rtcpBufferLength = *pOutputSrtcpPacketLength;
+        ret = PeerConnectionTwccFeedback_SerializePacket( &pSession->twccFeedback,
+                                                          senderSsrc,
+                                                          mediaSsrc,
+                                                          pOutputSrtcpPacket,
+                                                          &rtcpBufferLength );
     }
 
-    if( isLocked != 0U )
+    if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        pthread_mutex_unlock( &( pSession->srtpSessionMutex ) );
+        if( rtcpBufferLength == 0U )
+        {
+            /* Nothing received since last feedback. */
+            *pOutputSrtcpPacketLength = 0U;
+        }
+        else
+        {
+            ret = ProtectRtcpPacket( pSession,
+                                     pOutputSrtcpPacket,
+                                     rtcpBufferLength,
+                                     pOutputSrtcpPacketLength );
+        }
     }
 
     return ret;
 }
+#endif /* ENABLE_TWCC_SUPPORT */
 
 PeerConnectionResult_t PeerConnectionSrtp_HandleSrtcpPacket( PeerConnectionSession_t * pSession,
                                                              uint8_t * pBuffer,
@@ -876,13 +1171,13 @@ PeerConnectionResult_t PeerConnectionSrtp_HandleSrtcpPacket( PeerConnectionSessi
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( pthread_mutex_lock( &( pSession->srtpSessionMutex ) ) == 0 )
+        if( pthread_mutex_lock( &( pSession->srtpReceiveMutex ) ) == 0 )
         {
             isLocked = 1U;
         }
         else
         {
-            LogError( ( "Fail to take SRTP session mutex to decrypt SRTCP packet." ) );
+            LogError( ( "Fail to take Rx SRTP session mutex to decrypt SRTCP packet." ) );
             ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
         }
     }
@@ -917,7 +1212,7 @@ PeerConnectionResult_t PeerConnectionSrtp_HandleSrtcpPacket( PeerConnectionSessi
 
     if( isLocked != 0U )
     {
-        pthread_mutex_unlock( &( pSession->srtpSessionMutex ) );
+        pthread_mutex_unlock( &( pSession->srtpReceiveMutex ) );
     }
 
 
@@ -29,9 +29,24 @@ extern "C" {
 #include <stdint.h>
 
 #include "peer_connection_data_types.h"
+#include "peer_connection_twcc_feedback.h"
 
 /* 28 Bytes of RTCP with 0 Reception Reports + 14 bytes of SRTCP */
 #define PEER_CONNECTION_SRTCP_RTCP_PACKET_MIN_LENGTH      ( 42 )
+/* One reception report block takes 24 bytes in SR/RR. */
+#define PEER_CONNECTION_SRTCP_RECEPTION_REPORT_BLOCK_LENGTH ( 24 )
+/* 28 Bytes of RTCP SR + 1 Reception Report + 14 bytes of SRTCP */
+#define PEER_CONNECTION_SRTCP_SENDER_REPORT_PACKET_MAX_LENGTH   ( PEER_CONNECTION_SRTCP_RTCP_PACKET_MIN_LENGTH + PEER_CONNECTION_SRTCP_RECEPTION_REPORT_BLOCK_LENGTH )
+/* 8 Bytes of RTCP RR + 1 Reception Report + 14 bytes of SRTCP */
+#define PEER_CONNECTION_SRTCP_RECEIVER_REPORT_PACKET_MAX_LENGTH ( 8 + PEER_CONNECTION_SRTCP_RECEPTION_REPORT_BLOCK_LENGTH + 14 )
+/* The maximum number of sequence numbers carried by one generic NACK packet, each one needs 4 bytes FCI at most. */
+#define PEER_CONNECTION_SRTCP_NACK_MAX_FCI_NUM             ( 64 )
+/* 12 Bytes of RTCP feedback header + 4 bytes per FCI + 14 bytes of SRTCP */
+#define PEER_CONNECTION_SRTCP_NACK_PACKET_MAX_LENGTH       ( 12 + 4 * PEER_CONNECTION_SRTCP_NACK_MAX_FCI_NUM + 14 )
+#if ENABLE_TWCC_SUPPORT
+/* Transport-cc feedback RTCP packet + 14 bytes of SRTCP */
+    #define PEER_CONNECTION_SRTCP_TWCC_FEEDBACK_PACKET_MAX_LENGTH    ( PEER_CONNECTION_TWCC_FEEDBACK_RTCP_PACKET_MAX_LENGTH + 14 )
+#endif /* ENABLE_TWCC_SUPPORT */
 
     PeerConnectionResult_t PeerConnectionSrtp_HandleSrtcpPacket( PeerConnectionSession_t * pSession,
                                                                  uint8_t * pBuffer,
@@ -40,6 +55,28 @@ extern "C" {
                                                                             RtcpSenderReport_t * pSenderReport,
                                                                             uint8_t * pOutputSrtcpPacket,
                                                                             size_t * pOutputSrtcpPacketLength );
+/* Serialize a RFC 3550 receiver report with the reception report blocks and encrypt it. */
+    PeerConnectionResult_t PeerConnectionSrtcp_ConstructReceiverReportPacket( PeerConnectionSession_t * pSession,
+                                                                              uint32_t senderSsrc,
+                                                                              const RtcpReceptionReport_t * pReceptionReports,
+                                                                              size_t numReceptionReports,
+                                                                              uint8_t * pOutputSrtcpPacket,
+                                                                              size_t * pOutputSrtcpPacketLength );
+/* Serialize the sequence numbers in ascending order into a RFC 4585 generic NACK packet and encrypt it. */
+    PeerConnectionResult_t PeerConnectionSrtcp_ConstructNackPacket( PeerConnectionSession_t * pSession,
+                                                                    uint32_t senderSsrc,
+                                                                    uint32_t mediaSsrc,
+                                                                    const uint16_t * pSeqList,
+                                                                    size_t seqListLength,
+                                                                    uint8_t * pOutputSrtcpPacket,
+                                                                    size_t * pOutputSrtcpPacketLength );
+#if ENABLE_TWCC_SUPPORT
+/* Serialize the packets received since last feedback into a transport-cc feedback packet and encrypt it.
+ * The output length is set to 0 if there is nothing to report. */
+    PeerConnectionResult_t PeerConnectionSrtcp_ConstructTwccFeedbackPacket( PeerConnectionSession_t * pSession,
+                                                                            uint8_t * pOutputSrtcpPacket,
+                                                                            size_t * pOutputSrtcpPacketLength );
+#endif /* ENABLE_TWCC_SUPPORT */
 
 #ifdef __cplusplus
 }
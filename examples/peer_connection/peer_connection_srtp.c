@@ -20,6 +20,11 @@
 #include "peer_connection_srtp.h"
 #include "peer_connection_rolling_buffer.h"
 #include "peer_connection_jitter_buffer.h"
+#include "peer_connection_nack_generator.h"
+#include "peer_connection_reception_stats.h"
+#include "peer_connection_srtcp.h"
+#include "peer_connection_twcc_feedback.h"
+#include "peer_connection_pacer.h"
 #if METRIC_PRINT_ENABLED
 #include "metric.h"
 #endif
@@ -32,9 +37,24 @@
 #include "peer_connection_h264_helper.h"
 #include "peer_connection_h265_helper.h"
 #include "peer_connection_opus_helper.h"
+#include "peer_connection_packetized_frame_helper.h"
 #include "ice_controller.h"
 #include "networking_utils.h"
 
+/* The RTP fixed header is sent in plaintext by SRTP, see RFC 3550 section 5.1. */
+#define PEER_CONNECTION_SRTP_RTP_HEADER_MIN_LENGTH ( 12 )
+#define PEER_CONNECTION_SRTP_RTP_HEADER_SSRC_OFFSET ( 8 )
+#define PEER_CONNECTION_SRTP_READ_UINT16( pBuffer ) ( ( uint16_t ) ( ( ( uint16_t )( pBuffer )[ 0 ] << 8 ) | ( uint16_t )( pBuffer )[ 1 ] ) )
+#define PEER_CONNECTION_SRTP_READ_UINT32( pBuffer ) ( ( ( uint32_t )( pBuffer )[ 0 ] << 24 ) | ( ( uint32_t )( pBuffer )[ 1 ] << 16 ) | ( ( uint32_t )( pBuffer )[ 2 ] << 8 ) | ( uint32_t )( pBuffer )[ 3 ] )
+/* https://datatracker.ietf.org/doc/html/rfc8285#section-4 */
+#define PEER_CONNECTION_SRTP_RTP_HEADER_EXTENSION_BIT ( 0x10 )
+#define PEER_CONNECTION_SRTP_RTP_HEADER_CSRC_COUNT_MASK ( 0x0F )
+#define PEER_CONNECTION_SRTP_RTP_HEADER_EXTENSION_HEADER_LENGTH ( 4 )
+#define PEER_CONNECTION_SRTP_RTP_TWO_BYTE_EXTENSION_PROFILE ( 0x1000 )
+#define PEER_CONNECTION_SRTP_RTP_TWO_BYTE_EXTENSION_PROFILE_MASK ( 0xFFF0 )
+#define PEER_CONNECTION_SRTP_RTP_ONE_BYTE_EXTENSION_ID_STOP ( 15 )
+#define PEER_CONNECTION_SRTP_TWCC_EXTENSION_LENGTH ( 2 )
+
 /*-----------------------------------------------------------*/
 
 static PeerConnectionResult_t OnJitterBufferFrameReady( void * pCustomContext,
@@ -111,64 +131,182 @@ static PeerConnectionResult_t OnJitterBufferFrameDrop( void * pCustomContext,
     return ret;
 }
 
-PeerConnectionResult_t PeerConnectionSrtp_ConstructSrtpPacket( PeerConnectionSession_t * pSession,
-                                                               RtpPacket_t * pPacketRtp,
-                                                               uint8_t * pOutputSrtpPacket,
-                                                               size_t * pOutputSrtpPacketLength )
+#if ENABLE_TWCC_SUPPORT
+static uint8_t GetTransportSequenceNumber( const uint8_t * pRtpPacket,
+                                           size_t rtpPacketLength,
+                                           uint8_t extensionId,
+                                           uint16_t * pTransportSequenceNumber )
 {
-    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
-    RtpResult_t resultRtp;
-    size_t rtpBufferLength;
-    srtp_err_status_t errorStatus;
-    uint8_t isLocked = 0U;
+    uint8_t isFound = 0U;
+    size_t offset;
+    size_t extensionEnd;
+    uint16_t profile;
+    uint8_t elementId;
+    size_t elementLength;
 
-    if( ( pSession == NULL ) ||
-        ( pPacketRtp == NULL ) ||
-        ( pOutputSrtpPacket == NULL ) ||
-        ( pOutputSrtpPacketLength == NULL ) )
-    {
-        LogError( ( "Invalid input, pSession: %p, pPacketRtp: %p, pOutputSrtpPacket: %p, pOutputSrtpPacketLength: %p",
-                    pSession,
-                    pPacketRtp,
-                    pOutputSrtpPacket,
-                    pOutputSrtpPacketLength ) );
-        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
-    }
+    offset = PEER_CONNECTION_SRTP_RTP_HEADER_MIN_LENGTH + 4U * ( pRtpPacket[ 0 ] & PEER_CONNECTION_SRTP_RTP_HEADER_CSRC_COUNT_MASK );
 
-    /* Get buffer from sender for serializing RTP packet */
-    if( ret == PEER_CONNECTION_RESULT_OK )
+    if( ( ( pRtpPacket[ 0 ] & PEER_CONNECTION_SRTP_RTP_HEADER_EXTENSION_BIT ) != 0U ) &&
+        ( offset + PEER_CONNECTION_SRTP_RTP_HEADER_EXTENSION_HEADER_LENGTH <= rtpPacketLength ) )
     {
-        rtpBufferLength = *pOutputSrtpPacketLength;
-    }
+        profile = PEER_CONNECTION_SRTP_READ_UINT16( &pRtpPacket[ offset ] );
+        extensionEnd = offset + PEER_CONNECTION_SRTP_RTP_HEADER_EXTENSION_HEADER_LENGTH + 4U * PEER_CONNECTION_SRTP_READ_UINT16( &pRtpPacket[ offset + 2U ] );
+        offset += PEER_CONNECTION_SRTP_RTP_HEADER_EXTENSION_HEADER_LENGTH;
+        if( extensionEnd > rtpPacketLength )
+        {
+            extensionEnd = offset;
+        }
 
-    /* Contruct RTP packet for each payload buffer. */
-    if( ret == PEER_CONNECTION_RESULT_OK )
-    {
-        resultRtp = Rtp_Serialize( &pSession->pCtx->rtpContext,
-                                   pPacketRtp,
-                                   pOutputSrtpPacket,
-                                   &rtpBufferLength );
-        if( resultRtp != RTP_RESULT_OK )
+        /* Walk through the elements in one-byte or two-byte header format. */
+        while( ( isFound == 0U ) && ( offset < extensionEnd ) )
         {
-            LogError( ( "Fail to serialize RTP packet, result: %d", resultRtp ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_RTP_SERIALIZE;
+            if( profile == PEER_CONNECTION_SRTP_TWCC_EXT_PROFILE )
+            {
+                elementId = pRtpPacket[ offset ] >> 4;
+                elementLength = ( pRtpPacket[ offset ] & 0x0FU ) + 1U;
+                if( elementId == PEER_CONNECTION_SRTP_RTP_ONE_BYTE_EXTENSION_ID_STOP )
+                {
+                    break;
+                }
+                else if( elementId == 0U )
+                {
+                    /* Padding byte. */
+                    offset++;
+                    continue;
+                }
+                else
+                {
+                    offset++;
+                }
+            }
+            else if( ( profile & PEER_CONNECTION_SRTP_RTP_TWO_BYTE_EXTENSION_PROFILE_MASK ) == PEER_CONNECTION_SRTP_RTP_TWO_BYTE_EXTENSION_PROFILE )
+            {
+                elementId = pRtpPacket[ offset ];
+                if( elementId == 0U )
+                {
+                    /* Padding byte. */
+                    offset++;
+                    continue;
+                }
+                else if( offset + 2U > extensionEnd )
+                {
+                    break;
+                }
+                else
+                {
+                    elementLength = pRtpPacket[ offset + 1U ];
+                    offset += 2U;
+                }
+            }
+            else
+            {
+                /* Unknown header extension profile. */
+                break;
+            }
+
+            if( ( elementId == extensionId ) &&
+                ( elementLength >= PEER_CONNECTION_SRTP_TWCC_EXTENSION_LENGTH ) &&
+                ( offset + PEER_CONNECTION_SRTP_TWCC_EXTENSION_LENGTH <= extensionEnd ) )
+            {
+                *pTransportSequenceNumber = PEER_CONNECTION_SRTP_READ_UINT16( &pRtpPacket[ offset ] );
+                isFound = 1U;
+            }
+            offset += elementLength;
         }
     }
 
-    if( ret == PEER_CONNECTION_RESULT_OK )
+    return isFound;
+}
+#endif /* ENABLE_TWCC_SUPPORT */
+
+static PeerConnectionResult_t SendNackPacket( PeerConnectionSession_t * pSession,
+                                              PeerConnectionSrtpReceiver_t * pSrtpReceiver,
+                                              uint32_t mediaSsrc,
+                                              uint64_t currentTimeUs )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    IceControllerResult_t iceControllerResult;
+    TransceiverTrackKind_t trackKind;
+    uint16_t seqList[ PEER_CONNECTION_SRTCP_NACK_MAX_FCI_NUM ];
+    size_t seqListLength = PEER_CONNECTION_SRTCP_NACK_MAX_FCI_NUM;
+    uint8_t srtcpPacket[ PEER_CONNECTION_SRTCP_NACK_PACKET_MAX_LENGTH ];
+    size_t srtcpPacketLength = sizeof( srtcpPacket );
+    uint32_t senderSsrc = 0U;
+    uint32_t i;
+
+    /* Every sequence number needs one FCI at most, so the list always fits in one NACK packet. */
+    ret = PeerConnectionNackGenerator_GetNackList( &pSrtpReceiver->nackGenerator,
+                                                   currentTimeUs,
+                                                   seqList,
+                                                   &seqListLength );
+
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) && ( seqListLength > 0U ) )
     {
-        if( pthread_mutex_lock( &( pSession->srtpSessionMutex ) ) == 0 )
+        /* Use the local SSRC of the same kind as the NACK sender. */
+        trackKind = ( pSrtpReceiver == &pSession->videoSrtpReceiver ) ? TRANSCEIVER_TRACK_KIND_VIDEO : TRANSCEIVER_TRACK_KIND_AUDIO;
+        for( i = 0; i < pSession->transceiverCount; i++ )
         {
-            isLocked = 1U;
+            if( pSession->pTransceivers[ i ]->trackKind == trackKind )
+            {
+                senderSsrc = pSession->pTransceivers[ i ]->ssrc;
+                break;
+            }
         }
-        else
+
+        ret = PeerConnectionSrtcp_ConstructNackPacket( pSession,
+                                                       senderSsrc,
+                                                       mediaSsrc,
+                                                       seqList,
+                                                       seqListLength,
+                                                       srtcpPacket,
+                                                       &srtcpPacketLength );
+
+        if( ret == PEER_CONNECTION_RESULT_OK )
         {
-            LogError( ( "Fail to take SRTP session mutex to construct SRTP packet." ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
+            iceControllerResult = IceController_SendToRemotePeer( &( pSession->iceControllerContext ),
+                                                                  srtcpPacket,
+                                                                  srtcpPacketLength );
+            if( iceControllerResult != ICE_CONTROLLER_RESULT_OK )
+            {
+                LogWarn( ( "Fail to send RTCP NACK packet, ret: %d", iceControllerResult ) );
+                ret = PEER_CONNECTION_RESULT_FAIL_ICE_CONTROLLER_SEND_RTCP_PACKET;
+            }
+            else
+            {
+                LogVerbose( ( "Send RTCP NACK for %lu packets to SSRC: %u, first seq: %u",
+                              seqListLength,
+                              mediaSsrc,
+                              seqList[ 0 ] ) );
+            }
         }
     }
 
-    /* Encrypt it by SRTP. */
+    return ret;
+}
+
+static PeerConnectionResult_t SerializeAndProtectRtpPacket( PeerConnectionSession_t * pSession,
+                                                            RtpPacket_t * pPacketRtp,
+                                                            uint8_t * pOutputSrtpPacket,
+                                                            size_t * pOutputSrtpPacketLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    RtpResult_t resultRtp;
+    size_t rtpBufferLength;
+    srtp_err_status_t errorStatus;
+
+    /* Contruct RTP packet for each payload buffer. */
+    rtpBufferLength = *pOutputSrtpPacketLength;
+    resultRtp = Rtp_Serialize( &pSession->pCtx->rtpContext,
+                               pPacketRtp,
+                               pOutputSrtpPacket,
+                               &rtpBufferLength );
+    if( resultRtp != RTP_RESULT_OK )
+    {
+        LogError( ( "Fail to serialize RTP packet, result: %d", resultRtp ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_RTP_SERIALIZE;
+    }
+
+    /* Encrypt it by SRTP, the caller holds the Tx SRTP session mutex. */
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         if( pSession->srtpTransmitSession != NULL )
@@ -191,14 +329,120 @@ PeerConnectionResult_t PeerConnectionSrtp_ConstructSrtpPacket( PeerConnectionSes
         }
     }
 
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionSrtp_ConstructSrtpPacket( PeerConnectionSession_t * pSession,
+                                                               RtpPacket_t * pPacketRtp,
+                                                               uint8_t * pOutputSrtpPacket,
+                                                               size_t * pOutputSrtpPacketLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    uint8_t isLocked = 0U;
+
+    if( ( pSession == NULL ) ||
+        ( pPacketRtp == NULL ) ||
+        ( pOutputSrtpPacket == NULL ) ||
+        ( pOutputSrtpPacketLength == NULL ) )
+    {
+        LogError( ( "Invalid input, pSession: %p, pPacketRtp: %p, pOutputSrtpPacket: %p, pOutputSrtpPacketLength: %p",
+                    pSession,
+                    pPacketRtp,
+                    pOutputSrtpPacket,
+                    pOutputSrtpPacketLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_lock( &( pSession->srtpTransmitMutex ) ) == 0 )
+        {
+            isLocked = 1U;
+        }
+        else
+        {
+            LogError( ( "Fail to take Tx SRTP session mutex to construct SRTP packet." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        ret = SerializeAndProtectRtpPacket( pSession,
+                                            pPacketRtp,
+                                            pOutputSrtpPacket,
+                                            pOutputSrtpPacketLength );
+    }
+
     if( isLocked != 0U )
     {
-        pthread_mutex_unlock( &( pSession->srtpSessionMutex ) );
+        pthread_mutex_unlock( &( pSession->srtpTransmitMutex ) );
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionSrtp_BeginProtectBatch( PeerConnectionSession_t * pSession )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( pSession == NULL )
+    {
+        LogError( ( "Invalid input, pSession: %p", pSession ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else if( pthread_mutex_lock( &( pSession->srtpTransmitMutex ) ) != 0 )
+    {
+        LogError( ( "Fail to take Tx SRTP session mutex to protect SRTP packets." ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionSrtp_ConstructSrtpPacketInBatch( PeerConnectionSession_t * pSession,
+                                                                      RtpPacket_t * pPacketRtp,
+                                                                      uint8_t * pOutputSrtpPacket,
+                                                                      size_t * pOutputSrtpPacketLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pSession == NULL ) ||
+        ( pPacketRtp == NULL ) ||
+        ( pOutputSrtpPacket == NULL ) ||
+        ( pOutputSrtpPacketLength == NULL ) )
+    {
+        LogError( ( "Invalid input, pSession: %p, pPacketRtp: %p, pOutputSrtpPacket: %p, pOutputSrtpPacketLength: %p",
+                    pSession,
+                    pPacketRtp,
+                    pOutputSrtpPacket,
+                    pOutputSrtpPacketLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        ret = SerializeAndProtectRtpPacket( pSession,
+                                            pPacketRtp,
+                                            pOutputSrtpPacket,
+                                            pOutputSrtpPacketLength );
     }
 
     return ret;
 }
 
+void PeerConnectionSrtp_EndProtectBatch( PeerConnectionSession_t * pSession )
+{
+    if( pSession != NULL )
+    {
+        pthread_mutex_unlock( &( pSession->srtpTransmitMutex ) );
+    }
+}
+
 PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSession )
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
@@ -210,7 +454,9 @@ PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSessi
     PeerConnectionSrtpReceiver_t * pSrtpReceiver = NULL;
     int i;
     size_t maxSizePerPacket = PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH;
-    uint8_t isLocked = 0U;
+    uint8_t isTransmitLocked = 0U;
+    uint8_t isReceiveLocked = 0U;
+    uint64_t mediaBitrateBps = 0U;
 
     if( pSession == NULL )
     {
@@ -237,15 +483,29 @@ PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSessi
         }
     }
 
+    /* Always take the Tx mutex before the Rx mutex when both are needed. */
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( pthread_mutex_lock( &( pSession->srtpSessionMutex ) ) == 0 )
+        if( pthread_mutex_lock( &( pSession->srtpTransmitMutex ) ) == 0 )
         {
-            isLocked = 1U;
+            isTransmitLocked = 1U;
         }
         else
         {
-            LogError( ( "Fail to take SRTP session mutex to create SRTP session instance." ) );
+            LogError( ( "Fail to take Tx SRTP session mutex to create SRTP session instance." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_lock( &( pSession->srtpReceiveMutex ) ) == 0 )
+        {
+            isReceiveLocked = 1U;
+        }
+        else
+        {
+            LogError( ( "Fail to take Rx SRTP session mutex to create SRTP session instance." ) );
             ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
         }
     }
@@ -302,9 +562,14 @@ PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSessi
         }
     }
 
-    if( isLocked != 0U )
+    if( isReceiveLocked != 0U )
+    {
+        pthread_mutex_unlock( &( pSession->srtpReceiveMutex ) );
+    }
+
+    if( isTransmitLocked != 0U )
     {
-        pthread_mutex_unlock( &( pSession->srtpSessionMutex ) );
+        pthread_mutex_unlock( &( pSession->srtpTransmitMutex ) );
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
@@ -327,6 +592,7 @@ PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSessi
                                                           pSession->pTransceivers[i]->rollingbufferBitRate, // bps
                                                           pSession->pTransceivers[i]->rollingbufferDurationSec, // duration in seconds
                                                           maxSizePerPacket );
+                mediaBitrateBps += pSession->pTransceivers[i]->rollingbufferBitRate;
             }
             else if( ( pSession->pTransceivers[i]->trackKind == TRANSCEIVER_TRACK_KIND_AUDIO ) &&
                      ( ( pSession->pTransceivers[i]->direction == TRANSCEIVER_TRACK_DIRECTION_SENDRECV ) ||
@@ -343,6 +609,7 @@ PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSessi
                                                           pSession->pTransceivers[i]->rollingbufferBitRate, // bps
                                                           pSession->pTransceivers[i]->rollingbufferDurationSec, // duration in seconds
                                                           maxSizePerPacket );
+                mediaBitrateBps += pSession->pTransceivers[i]->rollingbufferBitRate;
             }
             else
             {
@@ -368,9 +635,17 @@ PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSessi
                 }
                 pSrtpSender->isSenderMutexInit = 1U;
             }
+
         }
     }
 
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* Pace the packets at a multiple of the bitrate of all media sent. */
+        ret = PeerConnectionPacer_Start( &pSession->pacer,
+                                         mediaBitrateBps );
+    }
+
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         /* Initialize Jitter buffers. */
@@ -390,6 +665,17 @@ PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSessi
                                                          PEER_CONNECTION_SRTP_JITTER_BUFFER_TOLERENCE_TIME_SECOND,   // buffer time in seconds
                                                          pSession->pTransceivers[i]->codecBitMap,
                                                          PEER_CONNECTION_SRTP_VIDEO_CLOCKRATE );
+
+                if( ret == PEER_CONNECTION_RESULT_OK )
+                {
+                    /* Only video negotiates "nack" RTCP feedback in SDP. */
+                    ret = PeerConnectionNackGenerator_Init( &pSrtpReceiver->nackGenerator );
+                }
+
+                if( ret == PEER_CONNECTION_RESULT_OK )
+                {
+                    ret = PeerConnectionReceptionStats_Init( &pSrtpReceiver->receptionStats );
+                }
             }
             else if( ( pSession->pTransceivers[i]->trackKind == TRANSCEIVER_TRACK_KIND_AUDIO ) &&
                      ( ( pSession->pTransceivers[i]->direction == TRANSCEIVER_TRACK_DIRECTION_SENDRECV ) ||
@@ -411,6 +697,11 @@ PeerConnectionResult_t PeerConnectionSrtp_Init( PeerConnectionSession_t * pSessi
                                                          PEER_CONNECTION_SRTP_JITTER_BUFFER_TOLERENCE_TIME_SECOND,   // buffer time in seconds
                                                          pSession->pTransceivers[i]->codecBitMap,
                                                          PEER_CONNECTION_SRTP_PCM_CLOCKRATE );
+
+                if( ret == PEER_CONNECTION_RESULT_OK )
+                {
+                    ret = PeerConnectionReceptionStats_Init( &pSrtpReceiver->receptionStats );
+                }
             }
             else
             {
@@ -433,7 +724,8 @@ PeerConnectionResult_t PeerConnectionSrtp_DeInit( PeerConnectionSession_t * pSes
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     srtp_err_status_t errorStatus;
-    uint8_t isLocked = 0U;
+    uint8_t isTransmitLocked = 0U;
+    uint8_t isReceiveLocked = 0U;
 
     if( pSession == NULL )
     {
@@ -443,13 +735,22 @@ PeerConnectionResult_t PeerConnectionSrtp_DeInit( PeerConnectionSession_t * pSes
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( pthread_mutex_lock( &( pSession->srtpSessionMutex ) ) == 0 )
+        if( pthread_mutex_lock( &( pSession->srtpTransmitMutex ) ) == 0 )
         {
-            isLocked = 1U;
+            isTransmitLocked = 1U;
         }
         else
         {
-            LogError( ( "Fail to take SRTP session mutex to release SRTP session." ) );
+            LogError( ( "Fail to take Tx SRTP session mutex to release SRTP session." ) );
+        }
+
+        if( pthread_mutex_lock( &( pSession->srtpReceiveMutex ) ) == 0 )
+        {
+            isReceiveLocked = 1U;
+        }
+        else
+        {
+            LogError( ( "Fail to take Rx SRTP session mutex to release SRTP session." ) );
         }
     }
 
@@ -480,17 +781,26 @@ PeerConnectionResult_t PeerConnectionSrtp_DeInit( PeerConnectionSession_t * pSes
         }
     }
 
-    if( isLocked != 0U )
+    if( isReceiveLocked != 0U )
     {
-        pthread_mutex_unlock( &( pSession->srtpSessionMutex ) );
+        pthread_mutex_unlock( &( pSession->srtpReceiveMutex ) );
+    }
+
+    if( isTransmitLocked != 0U )
+    {
+        pthread_mutex_unlock( &( pSession->srtpTransmitMutex ) );
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
+        /* Drop the packets not sent yet, they belong to the closed connection. */
+        PeerConnectionPacer_Reset( &pSession->pacer );
+
         /* Clean up Video SRTP Sender */
         if( pthread_mutex_lock( &( pSession->videoSrtpSender.senderMutex ) ) == 0 )
         {
             PeerConnectionRollingBuffer_Free( &pSession->videoSrtpSender.txRollingBuffer );
+            PeerConnectionSrtp_FreePacketizedFrame( &pSession->videoSrtpSender.packetizedFrame );
             pthread_mutex_unlock( &( pSession->videoSrtpSender.senderMutex ) );
         }
 
@@ -498,6 +808,7 @@ PeerConnectionResult_t PeerConnectionSrtp_DeInit( PeerConnectionSession_t * pSes
         if( pthread_mutex_lock( &( pSession->audioSrtpSender.senderMutex ) ) == 0 )
         {
             PeerConnectionRollingBuffer_Free( &pSession->audioSrtpSender.txRollingBuffer );
+            PeerConnectionSrtp_FreePacketizedFrame( &pSession->audioSrtpSender.packetizedFrame );
             pthread_mutex_unlock( &( pSession->audioSrtpSender.senderMutex ) );
         }
     }
@@ -511,6 +822,14 @@ PeerConnectionResult_t PeerConnectionSrtp_DeInit( PeerConnectionSession_t * pSes
         /* Clean up Audio SRTP Receiver */
         memset( pSession->audioSrtpReceiver.frameBuffer, 0, PEER_CONNECTION_FRAME_BUFFER_SIZE );
         PeerConnectionJitterBuffer_Free( &pSession->audioSrtpReceiver.rxJitterBuffer );
+
+        /* Clean up NACK generators, it disables NACK till next initialization. */
+        memset( &pSession->videoSrtpReceiver.nackGenerator, 0, sizeof( PeerConnectionNackGenerator_t ) );
+        memset( &pSession->audioSrtpReceiver.nackGenerator, 0, sizeof( PeerConnectionNackGenerator_t ) );
+
+        /* Clean up reception statistics, the next connection may come from other sources. */
+        PeerConnectionReceptionStats_Reset( &pSession->videoSrtpReceiver.receptionStats );
+        PeerConnectionReceptionStats_Reset( &pSession->audioSrtpReceiver.receptionStats );
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
@@ -531,29 +850,71 @@ PeerConnectionResult_t PeerConnectionSrtp_HandleSrtpPacket( PeerConnectionSessio
 {
     PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
     srtp_err_status_t errorStatus;
-    uint8_t rtpBuffer[ PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH ];
-    size_t rtpBufferLength = PEER_CONNECTION_SRTP_RTP_PACKET_MAX_LENGTH;
+    size_t rtpBufferLength = 0;
     RtpResult_t resultRtp;
     RtpPacket_t rtpPacket;
     PeerConnectionJitterBufferPacket_t * pJitterBufferPacket = NULL;
     PeerConnectionSrtpReceiver_t * pSrtpReceiver = NULL;
+    uint32_t ssrc;
+    uint64_t receiveTimeUs;
     uint8_t isLocked = 0U;
+    #if ENABLE_TWCC_SUPPORT
+        uint16_t transportSequenceNumber;
+    #endif /* ENABLE_TWCC_SUPPORT */
 
     if( ( pSession == NULL ) || ( pBuffer == NULL ) )
     {
         LogError( ( "Invalid input, pSession: %p, pBuffer: %p", pSession, pBuffer ) );
         ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
     }
+    else if( bufferLength < PEER_CONNECTION_SRTP_RTP_HEADER_MIN_LENGTH )
+    {
+        LogError( ( "Invalid input, bufferLength: %lu is too short for a RTP packet", bufferLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* SRTP doesn't encrypt RTP header, so the receiver can be selected before decrypting. */
+        ssrc = PEER_CONNECTION_SRTP_READ_UINT32( &pBuffer[ PEER_CONNECTION_SRTP_RTP_HEADER_SSRC_OFFSET ] );
+
+        if( pSession->rtpConfig.remoteVideoSsrc == ssrc )
+        {
+            pSrtpReceiver = &pSession->videoSrtpReceiver;
+        }
+        else if( pSession->rtpConfig.remoteAudioSsrc == ssrc )
+        {
+            pSrtpReceiver = &pSession->audioSrtpReceiver;
+        }
+        else
+        {
+            LogWarn( ( "Received unknown SSRC: %u RTP packet.", ssrc ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_RTP_RX_NO_MATCHING_SSRC;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        /* The decrypted packet is never longer than the SRTP packet, decrypt it straight into a jitter buffer packet.
+         * It takes the entry of its sequence number only when it's pushed, after the authentication. */
+        ret = PeerConnectionJitterBuffer_AllocateBuffer( &pSrtpReceiver->rxJitterBuffer,
+                                                         &pJitterBufferPacket,
+                                                         bufferLength );
+    }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( pthread_mutex_lock( &( pSession->srtpSessionMutex ) ) == 0 )
+        if( pthread_mutex_lock( &( pSession->srtpReceiveMutex ) ) == 0 )
         {
             isLocked = 1U;
         }
         else
         {
-            LogError( ( "Fail to take SRTP session mutex to construct SRTCP packet." ) );
+            LogError( ( "Fail to take Rx SRTP session mutex to decrypt SRTP packet." ) );
             ret = PEER_CONNECTION_RESULT_FAIL_TAKE_SRTP_MUTEX;
         }
     }
@@ -563,10 +924,11 @@ PeerConnectionResult_t PeerConnectionSrtp_HandleSrtpPacket( PeerConnectionSessio
     {
         if( pSession->srtpReceiveSession != NULL )
         {
+            rtpBufferLength = pJitterBufferPacket->packetBufferLength;
             errorStatus = srtp_unprotect( pSession->srtpReceiveSession,
                                           pBuffer,
                                           bufferLength,
-                                          rtpBuffer,
+                                          pJitterBufferPacket->pPacketBuffer,
                                           &rtpBufferLength );
             if( errorStatus != srtp_err_status_ok )
             {
@@ -587,14 +949,14 @@ PeerConnectionResult_t PeerConnectionSrtp_HandleSrtpPacket( PeerConnectionSessio
 
     if( isLocked != 0U )
     {
-        pthread_mutex_unlock( &( pSession->srtpSessionMutex ) );
+        pthread_mutex_unlock( &( pSession->srtpReceiveMutex ) );
     }
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
         /* Deserialize RTP packet. */
         resultRtp = Rtp_DeSerialize( &pSession->pCtx->rtpContext,
-                                     rtpBuffer,
+                                     pJitterBufferPacket->pPacketBuffer,
                                      rtpBufferLength,
                                      &rtpPacket );
         if( resultRtp != RTP_RESULT_OK )
@@ -606,44 +968,70 @@ PeerConnectionResult_t PeerConnectionSrtp_HandleSrtpPacket( PeerConnectionSessio
 
     if( ret == PEER_CONNECTION_RESULT_OK )
     {
-        if( pSession->rtpConfig.remoteVideoSsrc == rtpPacket.header.ssrc )
-        {
-            pSrtpReceiver = &pSession->videoSrtpReceiver;
-        }
-        else if( pSession->rtpConfig.remoteAudioSsrc == rtpPacket.header.ssrc )
+        /* Hand the buffer over to jitter buffer, the payload stays where it was decrypted. */
+        pJitterBufferPacket->packetBufferLength = rtpBufferLength;
+        pJitterBufferPacket->payloadOffset = ( size_t )( rtpPacket.pPayload - pJitterBufferPacket->pPacketBuffer );
+        pJitterBufferPacket->payloadLength = rtpPacket.payloadLength;
+        receiveTimeUs = NetworkingUtils_GetCurrentMonotonicTimeUs( NULL );
+        pJitterBufferPacket->receiveTick = receiveTimeUs;
+        pJitterBufferPacket->rtpTimestamp = rtpPacket.header.timestamp;
+        pJitterBufferPacket->sequenceNumber = rtpPacket.header.sequenceNumber;
+        pJitterBufferPacket->isEndOfFrame = ( ( rtpPacket.header.flags & RTP_HEADER_FLAG_MARKER ) != 0 ) ? 1U : 0U;
+
+        #if ENABLE_TWCC_SUPPORT
+            /* Record the arrival time for transport-cc feedback, see draft-holmer-rmcat-transport-wide-cc-extensions-01. */
+            if( ( pSession->rtpConfig.twccId > 0U ) &&
+                ( GetTransportSequenceNumber( pJitterBufferPacket->pPacketBuffer,
+                                              rtpBufferLength,
+                                              ( uint8_t ) pSession->rtpConfig.twccId,
+                                              &transportSequenceNumber ) != 0U ) )
+            {
+                ( void ) PeerConnectionTwccFeedback_RecordPacket( &pSession->twccFeedback,
+                                                                  transportSequenceNumber,
+                                                                  receiveTimeUs );
+            }
+        #endif /* ENABLE_TWCC_SUPPORT */
+
+        ( void ) PeerConnectionReceptionStats_OnPacketReceived( &pSrtpReceiver->receptionStats,
+                                                                ssrc,
+                                                                rtpPacket.header.sequenceNumber,
+                                                                rtpPacket.header.timestamp,
+                                                                pSrtpReceiver->rxJitterBuffer.clockRate,
+                                                                receiveTimeUs );
+
+        /* Track the gaps before the jitter buffer takes the packet. */
+        ( void ) PeerConnectionNackGenerator_OnPacketReceived( &pSrtpReceiver->nackGenerator,
+                                                               rtpPacket.header.sequenceNumber,
+                                                               receiveTimeUs );
+
+        ret = PeerConnectionJitterBuffer_Push( &pSrtpReceiver->rxJitterBuffer,
+                                               pJitterBufferPacket );
+
+        if( pSrtpReceiver->rxJitterBuffer.isPopped != 0U )
         {
-            pSrtpReceiver = &pSession->audioSrtpReceiver;
+            /* No need to recover the packets that the jitter buffer has already given up. */
+            PeerConnectionNackGenerator_RemoveUpTo( &pSrtpReceiver->nackGenerator,
+                                                    pSrtpReceiver->rxJitterBuffer.lastPopSequenceNumber );
         }
-        else
+
+        /* Retries are driven by the incoming packets, media keeps flowing while there is any gap to recover. */
+        if( pSrtpReceiver->nackGenerator.missingCount > 0U )
         {
-            LogWarn( ( "Received unknown SSRC: %u RTP packet.", rtpPacket.header.ssrc ) );
-            ret = PEER_CONNECTION_RESULT_FAIL_RTP_RX_NO_MATCHING_SSRC;
+            ( void ) SendNackPacket( pSession,
+                                     pSrtpReceiver,
+                                     ssrc,
+                                     receiveTimeUs );
         }
     }
-
-    if( ret == PEER_CONNECTION_RESULT_OK )
+    else if( pJitterBufferPacket != NULL )
     {
-        ret = PeerConnectionJitterBuffer_AllocateBuffer( &pSrtpReceiver->rxJitterBuffer,
-                                                         &pJitterBufferPacket,
-                                                         rtpPacket.payloadLength,
-                                                         rtpPacket.header.sequenceNumber );
+        /* The packet is not going to be pushed, return its buffer. */
+        PeerConnectionJitterBuffer_DiscardBuffer( &pSrtpReceiver->rxJitterBuffer,
+                                                  pJitterBufferPacket );
     }
-
-    if( ret == PEER_CONNECTION_RESULT_OK )
+    else
     {
-        memcpy( pJitterBufferPacket->pPacketBuffer, rtpPacket.pPayload, rtpPacket.payloadLength );
-        pJitterBufferPacket->receiveTick = time( NULL ); //xTaskGetTickCount();
-        pJitterBufferPacket->rtpTimestamp = rtpPacket.header.timestamp;
-        pJitterBufferPacket->sequenceNumber = rtpPacket.header.sequenceNumber;
-        // LogInfo( ( "Dumping RTP payload: %u, seq: %u, timestamp: %lu", rtpPacket.payloadLength, rtpPacket.header.sequenceNumber, rtpPacket.header.timestamp ) );
-        // for( int i = 0; i < rtpPacket.payloadLength; i++ )
-        // {
-        //     printf( "%02x ", rtpPacket.pPayload[i] );
-        // }
-        // printf( "\n" );
-
-        ret = PeerConnectionJitterBuffer_Push( &pSrtpReceiver->rxJitterBuffer,
-                                               pJitterBufferPacket );
+        /* Empty else marker. */
     }
 
     return ret;
@@ -41,6 +41,15 @@ PeerConnectionResult_t PeerConnectionSrtp_ConstructSrtpPacket( PeerConnectionSes
                                                                RtpPacket_t * pPacketRtp,
                                                                uint8_t * pOutputSrtpPacket,
                                                                size_t * pOutputSrtpPacketLength );
+/* Protect all packets of a frame under one acquisition of the Tx SRTP session mutex.
+ * Call PeerConnectionSrtp_ConstructSrtpPacketInBatch() for each packet between
+ * PeerConnectionSrtp_BeginProtectBatch() and PeerConnectionSrtp_EndProtectBatch(). */
+PeerConnectionResult_t PeerConnectionSrtp_BeginProtectBatch( PeerConnectionSession_t * pSession );
+PeerConnectionResult_t PeerConnectionSrtp_ConstructSrtpPacketInBatch( PeerConnectionSession_t * pSession,
+                                                                      RtpPacket_t * pPacketRtp,
+                                                                      uint8_t * pOutputSrtpPacket,
+                                                                      size_t * pOutputSrtpPacketLength );
+void PeerConnectionSrtp_EndProtectBatch( PeerConnectionSession_t * pSession );
 
 /* *INDENT-OFF* */
 #ifdef __cplusplus
@@ -0,0 +1,448 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_twcc_feedback.h"
+
+#if ENABLE_TWCC_SUPPORT
+
+#define PEER_CONNECTION_TWCC_FEEDBACK_INDEX( seq ) ( ( seq ) & ( PEER_CONNECTION_TWCC_FEEDBACK_WINDOW_SIZE - 1 ) )
+/* Signed distance from b to a, taking wrapping into account. */
+#define PEER_CONNECTION_TWCC_FEEDBACK_SEQ_DIFF( a, b ) ( ( int16_t )( ( uint16_t )( ( a ) - ( b ) ) ) )
+
+/* https://datatracker.ietf.org/doc/html/draft-holmer-rmcat-transport-wide-cc-extensions-01#section-3.1 */
+#define PEER_CONNECTION_TWCC_FEEDBACK_RTCP_VERSION ( 2 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_RTCP_PADDING_BIT ( 0x20 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_FMT ( 15 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_RTPFB_PACKET_TYPE ( 205 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_HEADER_LENGTH ( 20 )
+/* Reference time is in multiples of 64ms, receive deltas are in multiples of 250us. */
+#define PEER_CONNECTION_TWCC_FEEDBACK_REFERENCE_TIME_UNIT_US ( 64000 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_DELTA_UNIT_US ( 250 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_DELTA_UNITS_PER_REFERENCE_TIME ( 256 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_REFERENCE_TIME_MASK ( 0xFFFFFF )
+#define PEER_CONNECTION_TWCC_FEEDBACK_SMALL_DELTA_MAX ( 255 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_LARGE_DELTA_MIN ( -32768 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_LARGE_DELTA_MAX ( 32767 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_SYMBOL_NOT_RECEIVED ( 0 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_SYMBOL_SMALL_DELTA ( 1 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_SYMBOL_LARGE_DELTA ( 2 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_RUN_LENGTH_MAX ( 0x1FFF )
+#define PEER_CONNECTION_TWCC_FEEDBACK_STATUS_VECTOR_CHUNK ( 0x8000 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_TWO_BIT_SYMBOL ( 0x4000 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_ONE_BIT_SYMBOL_NUM ( 14 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_TWO_BIT_SYMBOL_NUM ( 7 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_WRITE_UINT16( pBuffer, value )            \
+    do {                                                                        \
+        ( pBuffer )[ 0 ] = ( uint8_t )( ( ( value ) >> 8 ) & 0xFF );            \
+        ( pBuffer )[ 1 ] = ( uint8_t )( ( value ) & 0xFF );                     \
+    } while( 0 )
+#define PEER_CONNECTION_TWCC_FEEDBACK_WRITE_UINT32( pBuffer, value )            \
+    do {                                                                        \
+        PEER_CONNECTION_TWCC_FEEDBACK_WRITE_UINT16( pBuffer, ( value ) >> 16 ); \
+        PEER_CONNECTION_TWCC_FEEDBACK_WRITE_UINT16( &( pBuffer )[ 2 ], value ); \
+    } while( 0 )
+
+static void ClearArrivalTimes( PeerConnectionTwccFeedback_t * pTwccFeedback,
+                               uint16_t startSeq,
+                               uint16_t count )
+{
+    uint16_t i;
+
+    if( count >= PEER_CONNECTION_TWCC_FEEDBACK_WINDOW_SIZE )
+    {
+        memset( pTwccFeedback->arrivalTimesUs, 0, sizeof( pTwccFeedback->arrivalTimesUs ) );
+    }
+    else
+    {
+        for( i = 0; i < count; i++ )
+        {
+            pTwccFeedback->arrivalTimesUs[ PEER_CONNECTION_TWCC_FEEDBACK_INDEX( ( uint16_t )( startSeq + i ) ) ] = 0U;
+        }
+    }
+}
+
+static size_t SerializePacketChunks( const uint8_t * pSymbols,
+                                     uint16_t symbolCount,
+                                     uint8_t * pBuffer )
+{
+    size_t length = 0U;
+    uint16_t i = 0U;
+    uint16_t runLength;
+    uint16_t vectorLength;
+    uint16_t chunk;
+    uint16_t k;
+    uint8_t hasLargeDelta;
+
+    while( i < symbolCount )
+    {
+        runLength = 1U;
+        while( ( i + runLength < symbolCount ) &&
+               ( pSymbols[ i + runLength ] == pSymbols[ i ] ) &&
+               ( runLength < PEER_CONNECTION_TWCC_FEEDBACK_RUN_LENGTH_MAX ) )
+        {
+            runLength++;
+        }
+
+        if( runLength >= PEER_CONNECTION_TWCC_FEEDBACK_ONE_BIT_SYMBOL_NUM )
+        {
+            /* Run length chunk. */
+            chunk = ( uint16_t )( ( pSymbols[ i ] << 13 ) | runLength );
+            i += runLength;
+        }
+        else
+        {
+            vectorLength = symbolCount - i;
+            if( vectorLength > PEER_CONNECTION_TWCC_FEEDBACK_ONE_BIT_SYMBOL_NUM )
+            {
+                vectorLength = PEER_CONNECTION_TWCC_FEEDBACK_ONE_BIT_SYMBOL_NUM;
+            }
+
+            hasLargeDelta = 0U;
+            for( k = 0; k < vectorLength; k++ )
+            {
+                if( pSymbols[ i + k ] == PEER_CONNECTION_TWCC_FEEDBACK_SYMBOL_LARGE_DELTA )
+                {
+                    hasLargeDelta = 1U;
+                    break;
+                }
+            }
+
+            if( hasLargeDelta == 0U )
+            {
+                /* Status vector chunk with 14 one-bit symbols. */
+                chunk = PEER_CONNECTION_TWCC_FEEDBACK_STATUS_VECTOR_CHUNK;
+                for( k = 0; k < vectorLength; k++ )
+                {
+                    chunk |= ( uint16_t )( pSymbols[ i + k ] << ( 13 - k ) );
+                }
+            }
+            else
+            {
+                /* Status vector chunk with 7 two-bit symbols. */
+                if( vectorLength > PEER_CONNECTION_TWCC_FEEDBACK_TWO_BIT_SYMBOL_NUM )
+                {
+                    vectorLength = PEER_CONNECTION_TWCC_FEEDBACK_TWO_BIT_SYMBOL_NUM;
+                }
+
+                chunk = PEER_CONNECTION_TWCC_FEEDBACK_STATUS_VECTOR_CHUNK | PEER_CONNECTION_TWCC_FEEDBACK_TWO_BIT_SYMBOL;
+                for( k = 0; k < vectorLength; k++ )
+                {
+                    chunk |= ( uint16_t )( pSymbols[ i + k ] << ( 12 - 2 * k ) );
+                }
+            }
+            i += vectorLength;
+        }
+
+        PEER_CONNECTION_TWCC_FEEDBACK_WRITE_UINT16( &pBuffer[ length ], chunk );
+        length += 2U;
+    }
+
+    return length;
+}
+
+PeerConnectionResult_t PeerConnectionTwccFeedback_Init( PeerConnectionTwccFeedback_t * pTwccFeedback )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( pTwccFeedback == NULL )
+    {
+        LogError( ( "Invalid input, pTwccFeedback: %p", pTwccFeedback ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        memset( pTwccFeedback, 0, sizeof( PeerConnectionTwccFeedback_t ) );
+
+        if( pthread_mutex_init( &( pTwccFeedback->feedbackMutex ), NULL ) != 0 )
+        {
+            LogError( ( "Fail to create mutex for TWCC feedback." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_CREATE_TWCC_MUTEX;
+        }
+        else
+        {
+            pTwccFeedback->isMutexInit = 1U;
+        }
+    }
+
+    return ret;
+}
+
+void PeerConnectionTwccFeedback_Reset( PeerConnectionTwccFeedback_t * pTwccFeedback )
+{
+    if( ( pTwccFeedback != NULL ) &&
+        ( pTwccFeedback->isMutexInit != 0U ) &&
+        ( pthread_mutex_lock( &( pTwccFeedback->feedbackMutex ) ) == 0 ) )
+    {
+        memset( pTwccFeedback->arrivalTimesUs, 0, sizeof( pTwccFeedback->arrivalTimesUs ) );
+        pTwccFeedback->isStarted = 0U;
+        pTwccFeedback->feedbackPacketCount = 0U;
+        pthread_mutex_unlock( &( pTwccFeedback->feedbackMutex ) );
+    }
+}
+
+void PeerConnectionTwccFeedback_Free( PeerConnectionTwccFeedback_t * pTwccFeedback )
+{
+    if( ( pTwccFeedback != NULL ) &&
+        ( pTwccFeedback->isMutexInit != 0U ) )
+    {
+        pTwccFeedback->isMutexInit = 0U;
+        ( void ) pthread_mutex_destroy( &( pTwccFeedback->feedbackMutex ) );
+    }
+}
+
+PeerConnectionResult_t PeerConnectionTwccFeedback_RecordPacket( PeerConnectionTwccFeedback_t * pTwccFeedback,
+                                                                uint16_t transportSequenceNumber,
+                                                                uint64_t arrivalTimeUs )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    int16_t seqDiff;
+    uint16_t newBaseSequenceNumber;
+    uint8_t isLocked = 0U;
+
+    if( ( pTwccFeedback == NULL ) || ( arrivalTimeUs == 0U ) )
+    {
+        LogError( ( "Invalid input, pTwccFeedback: %p, arrivalTimeUs: %lu", pTwccFeedback, arrivalTimeUs ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_lock( &( pTwccFeedback->feedbackMutex ) ) == 0 )
+        {
+            isLocked = 1U;
+        }
+        else
+        {
+            LogError( ( "Fail to take TWCC feedback mutex." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_TWCC_MUTEX;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pTwccFeedback->isStarted == 0U )
+        {
+            pTwccFeedback->isStarted = 1U;
+            pTwccFeedback->baseSequenceNumber = transportSequenceNumber;
+            pTwccFeedback->newestSequenceNumber = transportSequenceNumber;
+        }
+
+        seqDiff = PEER_CONNECTION_TWCC_FEEDBACK_SEQ_DIFF( transportSequenceNumber, pTwccFeedback->baseSequenceNumber );
+        if( seqDiff < 0 )
+        {
+            /* The packet arrives after its feedback has been sent, it has been reported as lost. */
+            LogVerbose( ( "Ignore late transport-wide seq: %u, base seq: %u", transportSequenceNumber, pTwccFeedback->baseSequenceNumber ) );
+        }
+        else
+        {
+            if( seqDiff >= PEER_CONNECTION_TWCC_FEEDBACK_WINDOW_SIZE )
+            {
+                /* Feedback is falling behind, drop the oldest records to make room. */
+                newBaseSequenceNumber = ( uint16_t )( transportSequenceNumber - PEER_CONNECTION_TWCC_FEEDBACK_WINDOW_SIZE + 1 );
+                LogWarn( ( "TWCC feedback window is full, drop records from seq: %u to seq: %u",
+                           pTwccFeedback->baseSequenceNumber,
+                           ( uint16_t )( newBaseSequenceNumber - 1U ) ) );
+                ClearArrivalTimes( pTwccFeedback,
+                                   pTwccFeedback->baseSequenceNumber,
+                                   ( uint16_t )( newBaseSequenceNumber - pTwccFeedback->baseSequenceNumber ) );
+                pTwccFeedback->baseSequenceNumber = newBaseSequenceNumber;
+            }
+
+            pTwccFeedback->arrivalTimesUs[ PEER_CONNECTION_TWCC_FEEDBACK_INDEX( transportSequenceNumber ) ] = arrivalTimeUs;
+            if( PEER_CONNECTION_TWCC_FEEDBACK_SEQ_DIFF( transportSequenceNumber, pTwccFeedback->newestSequenceNumber ) > 0 )
+            {
+                pTwccFeedback->newestSequenceNumber = transportSequenceNumber;
+            }
+        }
+    }
+
+    if( isLocked != 0U )
+    {
+        pthread_mutex_unlock( &( pTwccFeedback->feedbackMutex ) );
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionTwccFeedback_SerializePacket( PeerConnectionTwccFeedback_t * pTwccFeedback,
+                                                                   uint32_t senderSsrc,
+                                                                   uint32_t mediaSsrc,
+                                                                   uint8_t * pOutputRtcpPacket,
+                                                                   size_t * pOutputRtcpPacketLength )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    uint8_t symbols[ PEER_CONNECTION_TWCC_FEEDBACK_MAX_PACKET_STATUS_NUM ];
+    int32_t deltas[ PEER_CONNECTION_TWCC_FEEDBACK_MAX_PACKET_STATUS_NUM ];
+    uint16_t statusCount = 0U;
+    uint16_t i;
+    uint64_t arrivalTimeUs = 0U;
+    int64_t referenceTime;
+    int64_t lastArrivalTimeUnits;
+    int64_t arrivalTimeUnits;
+    int64_t delta;
+    size_t length = 0U;
+    size_t paddingLength;
+    uint8_t isLocked = 0U;
+
+    if( ( pTwccFeedback == NULL ) ||
+        ( pOutputRtcpPacket == NULL ) ||
+        ( pOutputRtcpPacketLength == NULL ) )
+    {
+        LogError( ( "Invalid input, pTwccFeedback: %p, pOutputRtcpPacket: %p, pOutputRtcpPacketLength: %p",
+                    pTwccFeedback,
+                    pOutputRtcpPacket,
+                    pOutputRtcpPacketLength ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+    else if( *pOutputRtcpPacketLength < PEER_CONNECTION_TWCC_FEEDBACK_RTCP_PACKET_MAX_LENGTH )
+    {
+        LogError( ( "The output buffer length: %lu is too short for a transport-cc feedback packet", *pOutputRtcpPacketLength ) );
+        ret = PEER_CONNECTION_RESULT_FAIL_RTCP_SERIALIZE_TWCC;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_lock( &( pTwccFeedback->feedbackMutex ) ) == 0 )
+        {
+            isLocked = 1U;
+        }
+        else
+        {
+            LogError( ( "Fail to take TWCC feedback mutex." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_TWCC_MUTEX;
+        }
+    }
+
+    if( ( ret == PEER_CONNECTION_RESULT_OK ) &&
+        ( pTwccFeedback->isStarted != 0U ) &&
+        ( PEER_CONNECTION_TWCC_FEEDBACK_SEQ_DIFF( pTwccFeedback->newestSequenceNumber, pTwccFeedback->baseSequenceNumber ) >= 0 ) )
+    {
+        statusCount = ( uint16_t )( pTwccFeedback->newestSequenceNumber - pTwccFeedback->baseSequenceNumber ) + 1U;
+        if( statusCount > PEER_CONNECTION_TWCC_FEEDBACK_MAX_PACKET_STATUS_NUM )
+        {
+            statusCount = PEER_CONNECTION_TWCC_FEEDBACK_MAX_PACKET_STATUS_NUM;
+        }
+
+        /* The reference time comes from the first received packet, the newest packet is always received. */
+        for( i = 0; arrivalTimeUs == 0U; i++ )
+        {
+            arrivalTimeUs = pTwccFeedback->arrivalTimesUs[ PEER_CONNECTION_TWCC_FEEDBACK_INDEX( ( uint16_t )( pTwccFeedback->baseSequenceNumber + i ) ) ];
+        }
+        referenceTime = ( int64_t )( arrivalTimeUs / PEER_CONNECTION_TWCC_FEEDBACK_REFERENCE_TIME_UNIT_US );
+        lastArrivalTimeUnits = referenceTime * PEER_CONNECTION_TWCC_FEEDBACK_DELTA_UNITS_PER_REFERENCE_TIME;
+
+        /* Deltas are accumulated in 250us units, so rounding errors don't add up. */
+        for( i = 0; i < statusCount; i++ )
+        {
+            arrivalTimeUs = pTwccFeedback->arrivalTimesUs[ PEER_CONNECTION_TWCC_FEEDBACK_INDEX( ( uint16_t )( pTwccFeedback->baseSequenceNumber + i ) ) ];
+            if( arrivalTimeUs == 0U )
+            {
+                symbols[ i ] = PEER_CONNECTION_TWCC_FEEDBACK_SYMBOL_NOT_RECEIVED;
+                continue;
+            }
+
+            arrivalTimeUnits = ( int64_t )( arrivalTimeUs / PEER_CONNECTION_TWCC_FEEDBACK_DELTA_UNIT_US );
+            delta = arrivalTimeUnits - lastArrivalTimeUnits;
+            if( ( delta >= 0 ) && ( delta <= PEER_CONNECTION_TWCC_FEEDBACK_SMALL_DELTA_MAX ) )
+            {
+                symbols[ i ] = PEER_CONNECTION_TWCC_FEEDBACK_SYMBOL_SMALL_DELTA;
+            }
+            else if( ( delta >= PEER_CONNECTION_TWCC_FEEDBACK_LARGE_DELTA_MIN ) && ( delta <= PEER_CONNECTION_TWCC_FEEDBACK_LARGE_DELTA_MAX ) )
+            {
+                symbols[ i ] = PEER_CONNECTION_TWCC_FEEDBACK_SYMBOL_LARGE_DELTA;
+            }
+            else
+            {
+                /* The delta can't be represented, report the rest in next feedback. */
+                statusCount = i;
+                break;
+            }
+
+            deltas[ i ] = ( int32_t ) delta;
+            lastArrivalTimeUnits = arrivalTimeUnits;
+        }
+
+        /* Header, followed by packet chunks and receive deltas. */
+        pOutputRtcpPacket[ 0 ] = ( uint8_t )( ( PEER_CONNECTION_TWCC_FEEDBACK_RTCP_VERSION << 6 ) | PEER_CONNECTION_TWCC_FEEDBACK_FMT );
+        pOutputRtcpPacket[ 1 ] = PEER_CONNECTION_TWCC_FEEDBACK_RTPFB_PACKET_TYPE;
+        PEER_CONNECTION_TWCC_FEEDBACK_WRITE_UINT32( &pOutputRtcpPacket[ 4 ], senderSsrc );
+        PEER_CONNECTION_TWCC_FEEDBACK_WRITE_UINT32( &pOutputRtcpPacket[ 8 ], mediaSsrc );
+        PEER_CONNECTION_TWCC_FEEDBACK_WRITE_UINT16( &pOutputRtcpPacket[ 12 ], pTwccFeedback->baseSequenceNumber );
+        PEER_CONNECTION_TWCC_FEEDBACK_WRITE_UINT16( &pOutputRtcpPacket[ 14 ], statusCount );
+        PEER_CONNECTION_TWCC_FEEDBACK_WRITE_UINT32( &pOutputRtcpPacket[ 16 ],
+                                                    ( ( ( uint32_t ) referenceTime & PEER_CONNECTION_TWCC_FEEDBACK_REFERENCE_TIME_MASK ) << 8 ) | pTwccFeedback->feedbackPacketCount );
+        length = PEER_CONNECTION_TWCC_FEEDBACK_HEADER_LENGTH;
+
+        length += SerializePacketChunks( symbols,
+                                         statusCount,
+                                         &pOutputRtcpPacket[ length ] );
+
+        for( i = 0; i < statusCount; i++ )
+        {
+            if( symbols[ i ] == PEER_CONNECTION_TWCC_FEEDBACK_SYMBOL_SMALL_DELTA )
+            {
+                pOutputRtcpPacket[ length++ ] = ( uint8_t ) deltas[ i ];
+            }
+            else if( symbols[ i ] == PEER_CONNECTION_TWCC_FEEDBACK_SYMBOL_LARGE_DELTA )
+            {
+                PEER_CONNECTION_TWCC_FEEDBACK_WRITE_UINT16( &pOutputRtcpPacket[ length ], ( uint16_t )( int16_t ) deltas[ i ] );
+                length += 2U;
+            }
+            else
+            {
+                /* Empty else marker. */
+            }
+        }
+
+        /* RTCP packet must be 32-bit aligned, the last padding byte counts the padding bytes. */
+        paddingLength = ( 4U - ( length % 4U ) ) % 4U;
+        if( paddingLength > 0U )
+        {
+            memset( &pOutputRtcpPacket[ length ], 0, paddingLength );
+            length += paddingLength;
+            pOutputRtcpPacket[ length - 1U ] = ( uint8_t ) paddingLength;
+            pOutputRtcpPacket[ 0 ] |= PEER_CONNECTION_TWCC_FEEDBACK_RTCP_PADDING_BIT;
+        }
+        PEER_CONNECTION_TWCC_FEEDBACK_WRITE_UINT16( &pOutputRtcpPacket[ 2 ], ( length / 4U ) - 1U );
+
+        ClearArrivalTimes( pTwccFeedback,
+                           pTwccFeedback->baseSequenceNumber,
+                           statusCount );
+        pTwccFeedback->baseSequenceNumber += statusCount;
+        pTwccFeedback->feedbackPacketCount++;
+    }
+
+    if( isLocked != 0U )
+    {
+        pthread_mutex_unlock( &( pTwccFeedback->feedbackMutex ) );
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        *pOutputRtcpPacketLength = length;
+    }
+
+    return ret;
+}
+
+#endif /* ENABLE_TWCC_SUPPORT */
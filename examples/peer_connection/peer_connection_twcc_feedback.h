@@ -0,0 +1,65 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PEER_CONNECTION_TWCC_FEEDBACK_H
+#define PEER_CONNECTION_TWCC_FEEDBACK_H
+
+#pragma once
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+
+#include "peer_connection_data_types.h"
+
+#if ENABLE_TWCC_SUPPORT
+
+/* 20 Bytes of header + 2 bytes chunk per 7 packets at most + 2 bytes delta per packet at most + 3 bytes padding. */
+#define PEER_CONNECTION_TWCC_FEEDBACK_RTCP_PACKET_MAX_LENGTH ( 20 + 2 * ( ( PEER_CONNECTION_TWCC_FEEDBACK_MAX_PACKET_STATUS_NUM + 6 ) / 7 ) + 2 * PEER_CONNECTION_TWCC_FEEDBACK_MAX_PACKET_STATUS_NUM + 3 )
+
+PeerConnectionResult_t PeerConnectionTwccFeedback_Init( PeerConnectionTwccFeedback_t * pTwccFeedback );
+
+/* Forget all packets recorded, e.g. the session is closed. */
+void PeerConnectionTwccFeedback_Reset( PeerConnectionTwccFeedback_t * pTwccFeedback );
+
+void PeerConnectionTwccFeedback_Free( PeerConnectionTwccFeedback_t * pTwccFeedback );
+
+PeerConnectionResult_t PeerConnectionTwccFeedback_RecordPacket( PeerConnectionTwccFeedback_t * pTwccFeedback,
+                                                                uint16_t transportSequenceNumber,
+                                                                uint64_t arrivalTimeUs );
+
+/* Serialize the packets not reported yet into a transport-cc feedback RTCP packet.
+ * The output length is set to 0 if there is nothing to report. */
+PeerConnectionResult_t PeerConnectionTwccFeedback_SerializePacket( PeerConnectionTwccFeedback_t * pTwccFeedback,
+                                                                   uint32_t senderSsrc,
+                                                                   uint32_t mediaSsrc,
+                                                                   uint8_t * pOutputRtcpPacket,
+                                                                   size_t * pOutputRtcpPacketLength );
+
+#endif /* ENABLE_TWCC_SUPPORT */
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+}
+#endif
+/* *INDENT-ON* */
+
+#endif /* PEER_CONNECTION_TWCC_FEEDBACK_H */
@@ -0,0 +1,305 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_twcc_history.h"
+#include "peer_connection_bandwidth_estimator.h"
+
+#if ENABLE_TWCC_SUPPORT
+
+#define PEER_CONNECTION_TWCC_HISTORY_INDEX( pTwccHistory, seq ) ( ( seq ) & ( ( pTwccHistory )->length - 1 ) )
+/* The sequence number is 16 bits, a longer history never gets its upper slots used. */
+#define PEER_CONNECTION_TWCC_HISTORY_MAX_LENGTH ( 65536 )
+/* The RTCP TWCC parser reports the remote arrival times in 100 ns units, the same unit as the duration in TwccBandwidthInfo_t.
+ * The packets not received are reported with an arrival time of 0 or all ones. */
+#define PEER_CONNECTION_TWCC_HISTORY_ARRIVAL_TIME_TO_US( arrivalTime ) ( ( uint64_t ) ( arrivalTime ) / 10U )
+#define PEER_CONNECTION_TWCC_HISTORY_IS_PACKET_RECEIVED( arrivalTime ) ( ( ( uint64_t ) ( arrivalTime ) != 0U ) && ( ( uint64_t ) ( arrivalTime ) != UINT64_MAX ) )
+#define PEER_CONNECTION_TWCC_HISTORY_US_TO_DURATION( timeUs ) ( ( uint64_t ) ( timeUs ) * 10U )
+
+PeerConnectionResult_t PeerConnectionTwccHistory_Create( PeerConnectionTwccHistory_t * pTwccHistory,
+                                                         size_t length )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pTwccHistory == NULL ) ||
+        ( length == 0 ) ||
+        ( length > PEER_CONNECTION_TWCC_HISTORY_MAX_LENGTH ) ||
+        ( ( length & ( length - 1 ) ) != 0 ) )
+    {
+        LogError( ( "Invalid input, pTwccHistory: %p, length: %lu", pTwccHistory, length ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        memset( pTwccHistory, 0, sizeof( PeerConnectionTwccHistory_t ) );
+        pTwccHistory->pPacketInfo = ( TwccPacketInfo_t * )malloc( length * sizeof( TwccPacketInfo_t ) );
+        if( pTwccHistory->pPacketInfo == NULL )
+        {
+            LogError( ( "No memory available for allocating TWCC history with total size %lu, length: %lu",
+                        length * sizeof( TwccPacketInfo_t ),
+                        length ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TWCC_HISTORY_NO_ENOUGH_MEMORY;
+        }
+        else
+        {
+            memset( pTwccHistory->pPacketInfo, 0, length * sizeof( TwccPacketInfo_t ) );
+            pTwccHistory->length = length;
+        }
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_init( &pTwccHistory->historyMutex, NULL ) != 0 )
+        {
+            LogError( ( "Fail to create mutex for TWCC history." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_CREATE_TWCC_HISTORY_MUTEX;
+            free( pTwccHistory->pPacketInfo );
+            pTwccHistory->pPacketInfo = NULL;
+            pTwccHistory->length = 0;
+        }
+        else
+        {
+            pTwccHistory->isInit = 1U;
+        }
+    }
+
+    return ret;
+}
+
+void PeerConnectionTwccHistory_Free( PeerConnectionTwccHistory_t * pTwccHistory )
+{
+    if( ( pTwccHistory != NULL ) && ( pTwccHistory->isInit != 0U ) )
+    {
+        pTwccHistory->isInit = 0U;
+        ( void ) pthread_mutex_destroy( &pTwccHistory->historyMutex );
+        free( pTwccHistory->pPacketInfo );
+        pTwccHistory->pPacketInfo = NULL;
+        pTwccHistory->length = 0;
+    }
+}
+
+void PeerConnectionTwccHistory_Reset( PeerConnectionTwccHistory_t * pTwccHistory )
+{
+    if( ( pTwccHistory != NULL ) && ( pTwccHistory->isInit != 0U ) )
+    {
+        if( pthread_mutex_lock( &pTwccHistory->historyMutex ) == 0 )
+        {
+            memset( pTwccHistory->pPacketInfo, 0, pTwccHistory->length * sizeof( TwccPacketInfo_t ) );
+            ( void ) pthread_mutex_unlock( &pTwccHistory->historyMutex );
+        }
+        else
+        {
+            LogError( ( "Failed to lock TWCC history mutex." ) );
+        }
+    }
+}
+
+PeerConnectionResult_t PeerConnectionTwccHistory_AddPacketInfo( PeerConnectionTwccHistory_t * pTwccHistory,
+                                                                const TwccPacketInfo_t * pPacketInfo )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+
+    if( ( pTwccHistory == NULL ) ||
+        ( pTwccHistory->isInit == 0U ) ||
+        ( pPacketInfo == NULL ) )
+    {
+        LogError( ( "Invalid input, pTwccHistory: %p, pPacketInfo: %p", pTwccHistory, pPacketInfo ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_lock( &pTwccHistory->historyMutex ) == 0 )
+        {
+            memcpy( &pTwccHistory->pPacketInfo[ PEER_CONNECTION_TWCC_HISTORY_INDEX( pTwccHistory, pPacketInfo->packetSeqNum ) ],
+                    pPacketInfo,
+                    sizeof( TwccPacketInfo_t ) );
+            ( void ) pthread_mutex_unlock( &pTwccHistory->historyMutex );
+        }
+        else
+        {
+            LogError( ( "Failed to lock TWCC history mutex." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_TWCC_HISTORY_MUTEX;
+        }
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionTwccHistory_SetSentTime( PeerConnectionTwccHistory_t * pTwccHistory,
+                                                              uint16_t transportSequenceNumber,
+                                                              uint64_t sentTimeUs )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    TwccPacketInfo_t * pSlot;
+
+    if( ( pTwccHistory == NULL ) ||
+        ( pTwccHistory->isInit == 0U ) ||
+        ( sentTimeUs == 0U ) )
+    {
+        LogError( ( "Invalid input, pTwccHistory: %p, sentTimeUs: %lu", pTwccHistory, sentTimeUs ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_lock( &pTwccHistory->historyMutex ) == 0 )
+        {
+            pSlot = &pTwccHistory->pPacketInfo[ PEER_CONNECTION_TWCC_HISTORY_INDEX( pTwccHistory, transportSequenceNumber ) ];
+
+            if( ( pSlot->localSentTime != 0 ) &&
+                ( pSlot->packetSeqNum == transportSequenceNumber ) )
+            {
+                pSlot->localSentTime = sentTimeUs;
+            }
+            else
+            {
+                ret = PEER_CONNECTION_RESULT_TWCC_HISTORY_PACKET_NOT_FOUND;
+            }
+
+            ( void ) pthread_mutex_unlock( &pTwccHistory->historyMutex );
+        }
+        else
+        {
+            LogError( ( "Failed to lock TWCC history mutex." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_TWCC_HISTORY_MUTEX;
+        }
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionTwccHistory_FindPacketInfo( PeerConnectionTwccHistory_t * pTwccHistory,
+                                                                 uint16_t transportSequenceNumber,
+                                                                 TwccPacketInfo_t * pPacketInfo )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    const TwccPacketInfo_t * pSlot;
+
+    if( ( pTwccHistory == NULL ) ||
+        ( pTwccHistory->isInit == 0U ) ||
+        ( pPacketInfo == NULL ) )
+    {
+        LogError( ( "Invalid input, pTwccHistory: %p, pPacketInfo: %p", pTwccHistory, pPacketInfo ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        if( pthread_mutex_lock( &pTwccHistory->historyMutex ) == 0 )
+        {
+            pSlot = &pTwccHistory->pPacketInfo[ PEER_CONNECTION_TWCC_HISTORY_INDEX( pTwccHistory, transportSequenceNumber ) ];
+
+            /* The slot may hold a newer packet, or nothing if the send time is 0. */
+            if( ( pSlot->localSentTime != 0 ) &&
+                ( pSlot->packetSeqNum == transportSequenceNumber ) )
+            {
+                memcpy( pPacketInfo,
+                        pSlot,
+                        sizeof( TwccPacketInfo_t ) );
+            }
+            else
+            {
+                ret = PEER_CONNECTION_RESULT_TWCC_HISTORY_PACKET_NOT_FOUND;
+            }
+
+            ( void ) pthread_mutex_unlock( &pTwccHistory->historyMutex );
+        }
+        else
+        {
+            LogError( ( "Failed to lock TWCC history mutex." ) );
+            ret = PEER_CONNECTION_RESULT_FAIL_TAKE_TWCC_HISTORY_MUTEX;
+        }
+    }
+
+    return ret;
+}
+
+PeerConnectionResult_t PeerConnectionTwccHistory_OnFeedback( PeerConnectionTwccHistory_t * pTwccHistory,
+                                                             const PacketArrivalInfo_t * pArrivalInfoList,
+                                                             size_t arrivalInfoListLength,
+                                                             PeerConnectionBandwidthEstimator_t * pBandwidthEstimator,
+                                                             TwccBandwidthInfo_t * pTwccBandwidthInfo )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_OK;
+    TwccPacketInfo_t twccPacketInfo;
+    uint64_t firstSentTimeUs = UINT64_MAX;
+    uint64_t lastSentTimeUs = 0;
+    size_t i;
+
+    if( ( pTwccHistory == NULL ) ||
+        ( pTwccHistory->isInit == 0U ) ||
+        ( ( pArrivalInfoList == NULL ) && ( arrivalInfoListLength > 0U ) ) ||
+        ( pTwccBandwidthInfo == NULL ) )
+    {
+        LogError( ( "Invalid input, pTwccHistory: %p, pArrivalInfoList: %p, pTwccBandwidthInfo: %p", pTwccHistory, pArrivalInfoList, pTwccBandwidthInfo ) );
+        ret = PEER_CONNECTION_RESULT_BAD_PARAMETER;
+    }
+
+    if( ret == PEER_CONNECTION_RESULT_OK )
+    {
+        memset( pTwccBandwidthInfo,
+                0,
+                sizeof( TwccBandwidthInfo_t ) );
+
+        for( i = 0; i < arrivalInfoListLength; i++ )
+        {
+            /* Packets sent too long ago were replaced in the history, skip them. */
+            if( PeerConnectionTwccHistory_FindPacketInfo( pTwccHistory,
+                                                          pArrivalInfoList[ i ].seqNum,
+                                                          &twccPacketInfo ) == PEER_CONNECTION_RESULT_OK )
+            {
+                pTwccBandwidthInfo->sentBytes += twccPacketInfo.packetSize;
+                pTwccBandwidthInfo->sentPackets++;
+                if( twccPacketInfo.localSentTime < firstSentTimeUs )
+                {
+                    firstSentTimeUs = twccPacketInfo.localSentTime;
+                }
+                if( twccPacketInfo.localSentTime > lastSentTimeUs )
+                {
+                    lastSentTimeUs = twccPacketInfo.localSentTime;
+                }
+
+                if( PEER_CONNECTION_TWCC_HISTORY_IS_PACKET_RECEIVED( pArrivalInfoList[ i ].remoteArrivalTime ) )
+                {
+                    pTwccBandwidthInfo->receivedBytes += twccPacketInfo.packetSize;
+                    pTwccBandwidthInfo->receivedPackets++;
+
+                    if( pBandwidthEstimator != NULL )
+                    {
+                        ( void ) PeerConnectionBandwidthEstimator_OnPacketFeedback( pBandwidthEstimator,
+                                                                                    twccPacketInfo.localSentTime,
+                                                                                    PEER_CONNECTION_TWCC_HISTORY_ARRIVAL_TIME_TO_US( pArrivalInfoList[ i ].remoteArrivalTime ),
+                                                                                    twccPacketInfo.packetSize );
+                    }
+                }
+            }
+        }
+
+        /* The duration covers the sending of the packets reported, so it's valid even if all of them are lost. */
+        if( lastSentTimeUs > firstSentTimeUs )
+        {
+            pTwccBandwidthInfo->duration = PEER_CONNECTION_TWCC_HISTORY_US_TO_DURATION( lastSentTimeUs - firstSentTimeUs );
+        }
+    }
+
+    return ret;
+}
+
+#endif /* ENABLE_TWCC_SUPPORT */
@@ -0,0 +1,74 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef PEER_CONNECTION_TWCC_HISTORY_H
+#define PEER_CONNECTION_TWCC_HISTORY_H
+
+#pragma once
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+extern "C" {
+#endif
+/* *INDENT-ON* */
+
+/* Standard includes. */
+#include <stdint.h>
+
+#include "peer_connection_data_types.h"
+
+#if ENABLE_TWCC_SUPPORT
+
+PeerConnectionResult_t PeerConnectionTwccHistory_Create( PeerConnectionTwccHistory_t * pTwccHistory,
+                                                         size_t length );
+
+void PeerConnectionTwccHistory_Free( PeerConnectionTwccHistory_t * pTwccHistory );
+
+/* Forget all packets recorded, e.g. the session is closed. */
+void PeerConnectionTwccHistory_Reset( PeerConnectionTwccHistory_t * pTwccHistory );
+
+/* Record a sent packet, it replaces the packet sent one history length earlier. */
+PeerConnectionResult_t PeerConnectionTwccHistory_AddPacketInfo( PeerConnectionTwccHistory_t * pTwccHistory,
+                                                                const TwccPacketInfo_t * pPacketInfo );
+
+/* Update the send time of a recorded packet when it actually leaves, e.g. after being paced. */
+PeerConnectionResult_t PeerConnectionTwccHistory_SetSentTime( PeerConnectionTwccHistory_t * pTwccHistory,
+                                                              uint16_t transportSequenceNumber,
+                                                              uint64_t sentTimeUs );
+
+/* Copy out the packet info of the transport-wide sequence number.
+ * Return PEER_CONNECTION_RESULT_TWCC_HISTORY_PACKET_NOT_FOUND if it's never sent or already replaced. */
+PeerConnectionResult_t PeerConnectionTwccHistory_FindPacketInfo( PeerConnectionTwccHistory_t * pTwccHistory,
+                                                                 uint16_t transportSequenceNumber,
+                                                                 TwccPacketInfo_t * pPacketInfo );
+
+/* Account the packets reported by a transport-cc feedback: the bytes and packets sent and received, and the duration of their sending.
+ * Packets no longer in the history are skipped. The received ones are fed to the bandwidth estimator if it's not NULL. */
+PeerConnectionResult_t PeerConnectionTwccHistory_OnFeedback( PeerConnectionTwccHistory_t * pTwccHistory,
+                                                             const PacketArrivalInfo_t * pArrivalInfoList,
+                                                             size_t arrivalInfoListLength,
+                                                             PeerConnectionBandwidthEstimator_t * pBandwidthEstimator,
+                                                             TwccBandwidthInfo_t * pTwccBandwidthInfo );
+
+#endif /* ENABLE_TWCC_SUPPORT */
+
+/* *INDENT-OFF* */
+#ifdef __cplusplus
+}
+#endif
+/* *INDENT-ON* */
+
+#endif /* PEER_CONNECTION_TWCC_HISTORY_H */
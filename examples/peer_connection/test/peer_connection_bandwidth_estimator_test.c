@@ -0,0 +1,419 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Feed the delay-based bandwidth estimator with synthetic transport-cc feedback.
+ * The packets go through a simulated bottleneck link with a FIFO queue, the feedback reports their send and arrival times
+ * every 100 ms like a remote peer does, then the estimate is checked against the link capacity.
+ * Usage: PeerConnectionBandwidthEstimatorTest */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_bandwidth_estimator.h"
+
+#if ENABLE_TWCC_SUPPORT
+
+#define BANDWIDTH_ESTIMATOR_TEST_PACKET_SIZE ( 1200 )
+#define BANDWIDTH_ESTIMATOR_TEST_BASE_DELAY_US ( 30000 )
+#define BANDWIDTH_ESTIMATOR_TEST_MAX_JITTER_US ( 1000 )
+#define BANDWIDTH_ESTIMATOR_TEST_FEEDBACK_INTERVAL_US ( 100000 )
+#define BANDWIDTH_ESTIMATOR_TEST_TICK_US ( 100 )
+#define BANDWIDTH_ESTIMATOR_TEST_MAX_PENDING_PACKET_NUM ( 8192 )
+#define BANDWIDTH_ESTIMATOR_TEST_MIN_BITRATE_BPS ( 100000 )
+#define BANDWIDTH_ESTIMATOR_TEST_MAX_BITRATE_BPS ( 20000000 )
+/* The decreases are at least the response time apart, see PEER_CONNECTION_BANDWIDTH_ESTIMATOR_RESPONSE_TIME_US. */
+#define BANDWIDTH_ESTIMATOR_TEST_RESPONSE_TIME_US ( 200000 )
+
+typedef struct BandwidthEstimatorTestPacket
+{
+    uint64_t sendTimeUs;
+    uint64_t arrivalTimeUs;
+} BandwidthEstimatorTestPacket_t;
+
+typedef struct BandwidthEstimatorTestLink
+{
+    PeerConnectionBandwidthEstimator_t estimator;
+    BandwidthEstimatorTestPacket_t pendingPackets[ BANDWIDTH_ESTIMATOR_TEST_MAX_PENDING_PACKET_NUM ];
+    uint32_t pendingPacketNum;
+    uint64_t currentTimeUs;
+    uint64_t nextFeedbackTimeUs;
+    double nextSendTimeUs;
+    double linkFreeTimeUs;
+    uint64_t arrivalTimeOffsetUs;
+    uint32_t randomSeed;
+
+    /* Results. */
+    uint32_t overuseNum;
+    uint32_t decreaseNum;
+    uint64_t minDecreaseIntervalUs;
+} BandwidthEstimatorTestLink_t;
+
+/* The test must be reproducible, use a fixed linear congruential generator for the jitter. */
+static uint32_t GetRandom( BandwidthEstimatorTestLink_t * pLink )
+{
+    pLink->randomSeed = pLink->randomSeed * 1103515245U + 12345U;
+
+    return ( pLink->randomSeed >> 16 ) & 0x7FFFU;
+}
+
+static int InitLink( BandwidthEstimatorTestLink_t * pLink,
+                     uint64_t minBitrateBps,
+                     uint64_t maxBitrateBps )
+{
+    int ret = 0;
+
+    memset( pLink, 0, sizeof( BandwidthEstimatorTestLink_t ) );
+    pLink->currentTimeUs = 1000000U;
+    pLink->nextFeedbackTimeUs = pLink->currentTimeUs + BANDWIDTH_ESTIMATOR_TEST_FEEDBACK_INTERVAL_US;
+    pLink->nextSendTimeUs = ( double ) pLink->currentTimeUs;
+    pLink->randomSeed = 1U;
+    pLink->minDecreaseIntervalUs = UINT64_MAX;
+
+    if( PeerConnectionBandwidthEstimator_Init( &pLink->estimator,
+                                               minBitrateBps,
+                                               maxBitrateBps ) != PEER_CONNECTION_RESULT_OK )
+    {
+        LogError( ( "Fail to initialize the bandwidth estimator" ) );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Send at min(target, encoder bitrate), or at the fixed send bitrate if it's not 0, through a link of the capacity for the duration. */
+static int RunLink( BandwidthEstimatorTestLink_t * pLink,
+                    double capacityBps,
+                    double encoderBitrateBps,
+                    double fixedSendBitrateBps,
+                    uint64_t durationUs )
+{
+    int ret = 0;
+    uint64_t endTimeUs = pLink->currentTimeUs + durationUs;
+    uint64_t lastDecreaseTimeUs;
+    double sendBitrateBps;
+    double departureTimeUs;
+    uint32_t i;
+    uint32_t keptNum;
+
+    for( ; ( ret == 0 ) && ( pLink->currentTimeUs < endTimeUs ); pLink->currentTimeUs += BANDWIDTH_ESTIMATOR_TEST_TICK_US )
+    {
+        if( fixedSendBitrateBps != 0.0 )
+        {
+            sendBitrateBps = fixedSendBitrateBps;
+        }
+        else if( encoderBitrateBps < ( double ) pLink->estimator.targetBitrateBps )
+        {
+            sendBitrateBps = encoderBitrateBps;
+        }
+        else
+        {
+            sendBitrateBps = ( double ) pLink->estimator.targetBitrateBps;
+        }
+
+        if( ( double ) pLink->currentTimeUs >= pLink->nextSendTimeUs )
+        {
+            if( pLink->pendingPacketNum == BANDWIDTH_ESTIMATOR_TEST_MAX_PENDING_PACKET_NUM )
+            {
+                LogError( ( "Too many packets in flight" ) );
+                ret = -1;
+                break;
+            }
+
+            /* The packet waits for the packets in front of it, then takes its transmission time. */
+            departureTimeUs = ( pLink->linkFreeTimeUs > ( double ) pLink->currentTimeUs ) ? pLink->linkFreeTimeUs : ( double ) pLink->currentTimeUs;
+            departureTimeUs += BANDWIDTH_ESTIMATOR_TEST_PACKET_SIZE * 8.0 * 1000000.0 / capacityBps;
+            pLink->linkFreeTimeUs = departureTimeUs;
+
+            pLink->pendingPackets[ pLink->pendingPacketNum ].sendTimeUs = pLink->currentTimeUs;
+            pLink->pendingPackets[ pLink->pendingPacketNum ].arrivalTimeUs = ( uint64_t ) departureTimeUs +
+                                                                             BANDWIDTH_ESTIMATOR_TEST_BASE_DELAY_US +
+                                                                             GetRandom( pLink ) % BANDWIDTH_ESTIMATOR_TEST_MAX_JITTER_US;
+            pLink->pendingPacketNum++;
+            pLink->nextSendTimeUs += BANDWIDTH_ESTIMATOR_TEST_PACKET_SIZE * 8.0 * 1000000.0 / sendBitrateBps;
+        }
+
+        if( pLink->currentTimeUs >= pLink->nextFeedbackTimeUs )
+        {
+            /* Report the packets arrived so far, the remote clock is shifted by arrivalTimeOffsetUs. */
+            keptNum = 0U;
+            for( i = 0; i < pLink->pendingPacketNum; i++ )
+            {
+                if( pLink->pendingPackets[ i ].arrivalTimeUs <= pLink->currentTimeUs )
+                {
+                    ( void ) PeerConnectionBandwidthEstimator_OnPacketFeedback( &pLink->estimator,
+                                                                                pLink->pendingPackets[ i ].sendTimeUs,
+                                                                                pLink->pendingPackets[ i ].arrivalTimeUs + pLink->arrivalTimeOffsetUs,
+                                                                                BANDWIDTH_ESTIMATOR_TEST_PACKET_SIZE );
+                }
+                else
+                {
+                    pLink->pendingPackets[ keptNum++ ] = pLink->pendingPackets[ i ];
+                }
+            }
+            pLink->pendingPacketNum = keptNum;
+
+            if( pLink->estimator.bandwidthUsage == PEER_CONNECTION_BANDWIDTH_USAGE_OVERUSING )
+            {
+                pLink->overuseNum++;
+            }
+
+            lastDecreaseTimeUs = pLink->estimator.lastDecreaseTimeUs;
+            ( void ) PeerConnectionBandwidthEstimator_Update( &pLink->estimator,
+                                                              pLink->currentTimeUs );
+            if( pLink->estimator.lastDecreaseTimeUs != lastDecreaseTimeUs )
+            {
+                if( ( lastDecreaseTimeUs != 0U ) &&
+                    ( pLink->estimator.lastDecreaseTimeUs - lastDecreaseTimeUs < pLink->minDecreaseIntervalUs ) )
+                {
+                    pLink->minDecreaseIntervalUs = pLink->estimator.lastDecreaseTimeUs - lastDecreaseTimeUs;
+                }
+                pLink->decreaseNum++;
+            }
+
+            pLink->nextFeedbackTimeUs += BANDWIDTH_ESTIMATOR_TEST_FEEDBACK_INTERVAL_US;
+        }
+    }
+
+    return ret;
+}
+
+static uint64_t GetQueueDelayUs( const BandwidthEstimatorTestLink_t * pLink )
+{
+    return ( pLink->linkFreeTimeUs > ( double ) pLink->currentTimeUs ) ? ( uint64_t ) ( pLink->linkFreeTimeUs - ( double ) pLink->currentTimeUs ) : 0U;
+}
+
+static int CheckResult( const char * pTestName,
+                        int isPassed )
+{
+    printf( "%s: %s\n",
+            pTestName,
+            isPassed ? "pass" : "FAIL" );
+
+    return isPassed ? 0 : -1;
+}
+
+/* Below the link capacity the delay stays flat, the estimate must not move. */
+static int TestUnderCapacity( BandwidthEstimatorTestLink_t * pLink )
+{
+    int ret = InitLink( pLink,
+                        BANDWIDTH_ESTIMATOR_TEST_MIN_BITRATE_BPS,
+                        2000000U );
+
+    if( ret == 0 )
+    {
+        ret = RunLink( pLink,
+                       2000000.0,
+                       1000000.0,
+                       0.0,
+                       10000000U );
+    }
+
+    if( ret == 0 )
+    {
+        printf( "Under capacity: target %lu bps, acknowledged %lu bps, over-use %u times\n",
+                pLink->estimator.targetBitrateBps,
+                pLink->estimator.ackedBitrateBps,
+                pLink->overuseNum );
+        ret = CheckResult( "Under capacity",
+                           ( pLink->overuseNum == 0U ) &&
+                           ( pLink->decreaseNum == 0U ) &&
+                           ( pLink->estimator.targetBitrateBps == 2000000U ) );
+    }
+
+    return ret;
+}
+
+/* Start far above a 1 Mbps link, the estimate must come down to the capacity and drain the queue,
+ * then follow the capacity when it doubles. */
+static int TestBottleneck( BandwidthEstimatorTestLink_t * pLink )
+{
+    int ret = InitLink( pLink,
+                        BANDWIDTH_ESTIMATOR_TEST_MIN_BITRATE_BPS,
+                        BANDWIDTH_ESTIMATOR_TEST_MAX_BITRATE_BPS );
+    uint64_t queueDelayUs = 0U;
+
+    if( ret == 0 )
+    {
+        ret = RunLink( pLink,
+                       1000000.0,
+                       3000000.0,
+                       0.0,
+                       30000000U );
+    }
+
+    if( ret == 0 )
+    {
+        queueDelayUs = GetQueueDelayUs( pLink );
+        printf( "Bottleneck 1 Mbps: target %lu bps, queue delay %lu ms, %u decreases, min interval %lu ms\n",
+                pLink->estimator.targetBitrateBps,
+                queueDelayUs / 1000U,
+                pLink->decreaseNum,
+                ( pLink->decreaseNum > 1U ) ? pLink->minDecreaseIntervalUs / 1000U : 0U );
+        ret = CheckResult( "Bottleneck 1 Mbps",
+                           ( pLink->decreaseNum > 0U ) &&
+                           ( pLink->minDecreaseIntervalUs >= BANDWIDTH_ESTIMATOR_TEST_RESPONSE_TIME_US ) &&
+                           ( pLink->estimator.targetBitrateBps >= 700000U ) &&
+                           ( pLink->estimator.targetBitrateBps <= 1300000U ) &&
+                           ( queueDelayUs < 100000U ) );
+    }
+
+    if( ret == 0 )
+    {
+        ret = RunLink( pLink,
+                       2000000.0,
+                       3000000.0,
+                       0.0,
+                       30000000U );
+    }
+
+    if( ret == 0 )
+    {
+        queueDelayUs = GetQueueDelayUs( pLink );
+        printf( "Bottleneck 2 Mbps: target %lu bps, queue delay %lu ms\n",
+                pLink->estimator.targetBitrateBps,
+                queueDelayUs / 1000U );
+        ret = CheckResult( "Bottleneck 2 Mbps",
+                           ( pLink->estimator.targetBitrateBps >= 1500000U ) &&
+                           ( pLink->estimator.targetBitrateBps <= 2600000U ) &&
+                           ( queueDelayUs < 100000U ) );
+    }
+
+    return ret;
+}
+
+/* Something else than the estimate, e.g. retransmissions, overloads the link while the estimate is already
+ * below the decreased bitrate. Nothing is decreased, so the next real decrease must not be held back. */
+static int TestNothingToDecrease( BandwidthEstimatorTestLink_t * pLink )
+{
+    int ret = InitLink( pLink,
+                        BANDWIDTH_ESTIMATOR_TEST_MIN_BITRATE_BPS,
+                        300000U );
+
+    /* Let the acknowledged bitrate settle first, a decrease without it is relative to the estimate. */
+    if( ret == 0 )
+    {
+        ret = RunLink( pLink,
+                       1000000.0,
+                       0.0,
+                       400000.0,
+                       2000000U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = RunLink( pLink,
+                       1000000.0,
+                       0.0,
+                       2000000.0,
+                       3000000U );
+    }
+
+    if( ret == 0 )
+    {
+        printf( "Nothing to decrease: target %lu bps, acknowledged %lu bps, over-use %u times, last decrease at %lu us\n",
+                pLink->estimator.targetBitrateBps,
+                pLink->estimator.ackedBitrateBps,
+                pLink->overuseNum,
+                pLink->estimator.lastDecreaseTimeUs );
+        ret = CheckResult( "Nothing to decrease",
+                           ( pLink->overuseNum > 0U ) &&
+                           ( pLink->estimator.targetBitrateBps == 300000U ) &&
+                           ( pLink->estimator.lastDecreaseTimeUs == 0U ) );
+    }
+
+    return ret;
+}
+
+/* A jump of the remote arrival clock must restart the estimation instead of being taken as queuing delay. */
+static int TestArrivalTimeJump( BandwidthEstimatorTestLink_t * pLink )
+{
+    int ret = InitLink( pLink,
+                        BANDWIDTH_ESTIMATOR_TEST_MIN_BITRATE_BPS,
+                        2000000U );
+
+    if( ret == 0 )
+    {
+        ret = RunLink( pLink,
+                       2000000.0,
+                       1000000.0,
+                       0.0,
+                       5000000U );
+    }
+
+    if( ret == 0 )
+    {
+        pLink->arrivalTimeOffsetUs = 10000000U;
+        ret = RunLink( pLink,
+                       2000000.0,
+                       1000000.0,
+                       0.0,
+                       5000000U );
+    }
+
+    if( ret == 0 )
+    {
+        printf( "Arrival time jump: target %lu bps, over-use %u times\n",
+                pLink->estimator.targetBitrateBps,
+                pLink->overuseNum );
+        ret = CheckResult( "Arrival time jump",
+                           ( pLink->overuseNum == 0U ) &&
+                           ( pLink->decreaseNum == 0U ) &&
+                           ( pLink->estimator.targetBitrateBps == 2000000U ) );
+    }
+
+    return ret;
+}
+
+int main( void )
+{
+    int ret = 0;
+    /* Too large for the stack. */
+    static BandwidthEstimatorTestLink_t link;
+
+    if( TestUnderCapacity( &link ) != 0 )
+    {
+        ret = -1;
+    }
+
+    if( TestBottleneck( &link ) != 0 )
+    {
+        ret = -1;
+    }
+
+    if( TestNothingToDecrease( &link ) != 0 )
+    {
+        ret = -1;
+    }
+
+    if( TestArrivalTimeJump( &link ) != 0 )
+    {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+#else /* ENABLE_TWCC_SUPPORT */
+
+int main( void )
+{
+    printf( "ENABLE_TWCC_SUPPORT is disabled, skip the bandwidth estimator test.\n" );
+
+    return 0;
+}
+
+#endif /* ENABLE_TWCC_SUPPORT */
@@ -0,0 +1,671 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Push packets into the jitter buffer the way PeerConnectionSrtp_HandleSrtpPacket() does, and check the frames
+ * it pops, also for frames in random order and frames larger than the received bitmap. The first byte of each
+ * payload says whether the packet starts a frame, the second one tags the copy of the packet, so the test tells
+ * which copy of a sequence number ends up in the frame.
+ * Usage: PeerConnectionJitterBufferTest */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_jitter_buffer.h"
+#include "peer_connection_g711_helper.h"
+#include "peer_connection_h264_helper.h"
+#include "peer_connection_h265_helper.h"
+#include "peer_connection_opus_helper.h"
+
+#define JITTER_BUFFER_TEST_CLOCK_RATE ( 90000 )
+#define JITTER_BUFFER_TEST_TOLERENCE_SEC ( 3 )
+#define JITTER_BUFFER_TEST_PACKET_SIZE ( 1200 )
+#define JITTER_BUFFER_TEST_PAYLOAD_START_OFFSET ( 0 )
+#define JITTER_BUFFER_TEST_PAYLOAD_TAG_OFFSET ( 1 )
+#define JITTER_BUFFER_TEST_MAX_FRAME_NUM ( 4096 )
+#define JITTER_BUFFER_TEST_CODEC ( 1 << TRANSCEIVER_RTC_CODEC_H264_PROFILE_42E01F_LEVEL_ASYMMETRY_ALLOWED_PACKETIZATION_BIT )
+#define JITTER_BUFFER_TEST_KEYFRAME_PACKET_NUM ( 300 )
+
+typedef struct JitterBufferTestFrame
+{
+    uint16_t startSequence;
+    uint16_t endSequence;
+    uint8_t isDropped;
+    uint8_t isTagMatched;     /* Every packet of a ready frame carries the expected tag. */
+} JitterBufferTestFrame_t;
+
+typedef struct JitterBufferTestContext
+{
+    PeerConnectionJitterBuffer_t jitterBuffer;
+    uint64_t currentTimeUs;
+    uint8_t expectedTag;
+    JitterBufferTestFrame_t frames[ JITTER_BUFFER_TEST_MAX_FRAME_NUM ];
+    size_t frameNum;
+    uint32_t randomSeed;
+} JitterBufferTestContext_t;
+
+static JitterBufferTestContext_t testContext;
+
+/* The test must be reproducible, use a fixed linear congruential generator for the packet order. */
+static uint32_t GetRandom( JitterBufferTestContext_t * pContext )
+{
+    pContext->randomSeed = pContext->randomSeed * 1103515245U + 12345U;
+
+    return ( pContext->randomSeed >> 16 ) & 0x7FFFU;
+}
+
+/* Only the packet property is needed to assemble frames, the test reads the payloads in the frame ready callback. */
+PeerConnectionResult_t GetH264PacketProperty( PeerConnectionJitterBufferPacket_t * pPacket,
+                                              uint8_t * pIsStartPacket )
+{
+    *pIsStartPacket = pPacket->pPacketBuffer[ pPacket->payloadOffset + JITTER_BUFFER_TEST_PAYLOAD_START_OFFSET ];
+
+    return PEER_CONNECTION_RESULT_OK;
+}
+
+PeerConnectionResult_t FillFrameH264( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                      uint16_t rtpSeqStart,
+                                      uint16_t rtpSeqEnd,
+                                      uint8_t * pOutBuffer,
+                                      size_t * pOutBufferLength,
+                                      uint32_t * pRtpTimestamp )
+{
+    ( void ) pJitterBuffer;
+    ( void ) rtpSeqStart;
+    ( void ) rtpSeqEnd;
+    ( void ) pOutBuffer;
+    ( void ) pOutBufferLength;
+    ( void ) pRtpTimestamp;
+
+    return PEER_CONNECTION_RESULT_OK;
+}
+
+/* The other codecs are not used by the test. */
+PeerConnectionResult_t GetOpusPacketProperty( PeerConnectionJitterBufferPacket_t * pPacket,
+                                              uint8_t * pIsStartPacket )
+{
+    return GetH264PacketProperty( pPacket,
+                                  pIsStartPacket );
+}
+
+PeerConnectionResult_t FillFrameOpus( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                      uint16_t rtpSeqStart,
+                                      uint16_t rtpSeqEnd,
+                                      uint8_t * pOutBuffer,
+                                      size_t * pOutBufferLength,
+                                      uint32_t * pRtpTimestamp )
+{
+    return FillFrameH264( pJitterBuffer, rtpSeqStart, rtpSeqEnd, pOutBuffer, pOutBufferLength, pRtpTimestamp );
+}
+
+PeerConnectionResult_t GetG711PacketProperty( PeerConnectionJitterBufferPacket_t * pPacket,
+                                              uint8_t * pIsStartPacket )
+{
+    return GetH264PacketProperty( pPacket,
+                                  pIsStartPacket );
+}
+
+PeerConnectionResult_t FillFrameG711( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                      uint16_t rtpSeqStart,
+                                      uint16_t rtpSeqEnd,
+                                      uint8_t * pOutBuffer,
+                                      size_t * pOutBufferLength,
+                                      uint32_t * pRtpTimestamp )
+{
+    return FillFrameH264( pJitterBuffer, rtpSeqStart, rtpSeqEnd, pOutBuffer, pOutBufferLength, pRtpTimestamp );
+}
+
+PeerConnectionResult_t GetH265PacketProperty( PeerConnectionJitterBufferPacket_t * pPacket,
+                                              uint8_t * pIsStartPacket )
+{
+    return GetH264PacketProperty( pPacket,
+                                  pIsStartPacket );
+}
+
+PeerConnectionResult_t FillFrameH265( PeerConnectionJitterBuffer_t * pJitterBuffer,
+                                      uint16_t rtpSeqStart,
+                                      uint16_t rtpSeqEnd,
+                                      uint8_t * pOutBuffer,
+                                      size_t * pOutBufferLength,
+                                      uint32_t * pRtpTimestamp )
+{
+    return FillFrameH264( pJitterBuffer, rtpSeqStart, rtpSeqEnd, pOutBuffer, pOutBufferLength, pRtpTimestamp );
+}
+
+static PeerConnectionResult_t OnFrameReady( void * pCustomContext,
+                                            uint16_t startSequence,
+                                            uint16_t endSequence )
+{
+    JitterBufferTestContext_t * pContext = ( JitterBufferTestContext_t * ) pCustomContext;
+    JitterBufferTestFrame_t * pFrame;
+    PeerConnectionJitterBufferPacket_t * pPacket;
+    uint16_t i;
+
+    if( pContext->frameNum < JITTER_BUFFER_TEST_MAX_FRAME_NUM )
+    {
+        pFrame = &pContext->frames[ pContext->frameNum++ ];
+        pFrame->startSequence = startSequence;
+        pFrame->endSequence = endSequence;
+        pFrame->isDropped = 0U;
+        pFrame->isTagMatched = 1U;
+
+        for( i = startSequence; i != ( uint16_t )( endSequence + 1 ); i++ )
+        {
+            if( ( PeerConnectionJitterBuffer_GetPacket( &pContext->jitterBuffer,
+                                                        i,
+                                                        &pPacket ) != PEER_CONNECTION_RESULT_OK ) ||
+                ( pPacket->pPacketBuffer[ pPacket->payloadOffset + JITTER_BUFFER_TEST_PAYLOAD_TAG_OFFSET ] != pContext->expectedTag ) )
+            {
+                pFrame->isTagMatched = 0U;
+            }
+        }
+    }
+
+    return PEER_CONNECTION_RESULT_OK;
+}
+
+static PeerConnectionResult_t OnFrameDrop( void * pCustomContext,
+                                           uint16_t startSequence,
+                                           uint16_t endSequence )
+{
+    JitterBufferTestContext_t * pContext = ( JitterBufferTestContext_t * ) pCustomContext;
+    JitterBufferTestFrame_t * pFrame;
+
+    if( pContext->frameNum < JITTER_BUFFER_TEST_MAX_FRAME_NUM )
+    {
+        pFrame = &pContext->frames[ pContext->frameNum++ ];
+        pFrame->startSequence = startSequence;
+        pFrame->endSequence = endSequence;
+        pFrame->isDropped = 1U;
+        pFrame->isTagMatched = 0U;
+    }
+
+    return PEER_CONNECTION_RESULT_OK;
+}
+
+static int CreateJitterBuffer( JitterBufferTestContext_t * pContext )
+{
+    int ret = 0;
+
+    memset( pContext, 0, sizeof( JitterBufferTestContext_t ) );
+    pContext->currentTimeUs = 1000000U;
+    pContext->expectedTag = 'A';
+    pContext->randomSeed = 1U;
+
+    if( PeerConnectionJitterBuffer_Create( &pContext->jitterBuffer,
+                                           OnFrameReady,
+                                           pContext,
+                                           OnFrameDrop,
+                                           pContext,
+                                           JITTER_BUFFER_TEST_TOLERENCE_SEC,
+                                           JITTER_BUFFER_TEST_CODEC,
+                                           JITTER_BUFFER_TEST_CLOCK_RATE ) != PEER_CONNECTION_RESULT_OK )
+    {
+        printf( "Fail to create jitter buffer\n" );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Get the pending packet and fill it like it's decrypted, the caller pushes or discards it. */
+static PeerConnectionJitterBufferPacket_t * ReceivePacket( JitterBufferTestContext_t * pContext,
+                                                           uint16_t sequenceNumber,
+                                                           uint32_t rtpTimestamp,
+                                                           uint8_t isStart,
+                                                           uint8_t isEnd,
+                                                           uint8_t tag )
+{
+    PeerConnectionJitterBufferPacket_t * pPacket = NULL;
+
+    if( PeerConnectionJitterBuffer_AllocateBuffer( &pContext->jitterBuffer,
+                                                   &pPacket,
+                                                   JITTER_BUFFER_TEST_PACKET_SIZE ) == PEER_CONNECTION_RESULT_OK )
+    {
+        memset( pPacket->pPacketBuffer, 0, JITTER_BUFFER_TEST_PACKET_SIZE );
+        pPacket->pPacketBuffer[ JITTER_BUFFER_TEST_PAYLOAD_START_OFFSET ] = isStart;
+        pPacket->pPacketBuffer[ JITTER_BUFFER_TEST_PAYLOAD_TAG_OFFSET ] = tag;
+        pPacket->packetBufferLength = JITTER_BUFFER_TEST_PACKET_SIZE;
+        pPacket->payloadOffset = 0U;
+        pPacket->payloadLength = JITTER_BUFFER_TEST_PACKET_SIZE;
+        pPacket->receiveTick = pContext->currentTimeUs;
+        pPacket->rtpTimestamp = rtpTimestamp;
+        pPacket->sequenceNumber = sequenceNumber;
+        pPacket->isEndOfFrame = isEnd;
+    }
+    else
+    {
+        printf( "Fail to allocate buffer for packet %u\n", sequenceNumber );
+    }
+
+    return pPacket;
+}
+
+static PeerConnectionResult_t PushPacket( JitterBufferTestContext_t * pContext,
+                                          uint16_t sequenceNumber,
+                                          uint32_t rtpTimestamp,
+                                          uint8_t isStart,
+                                          uint8_t isEnd,
+                                          uint8_t tag )
+{
+    PeerConnectionResult_t ret = PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_PACKET_NO_ENOUGH_MEMORY;
+    PeerConnectionJitterBufferPacket_t * pPacket;
+
+    pPacket = ReceivePacket( pContext,
+                             sequenceNumber,
+                             rtpTimestamp,
+                             isStart,
+                             isEnd,
+                             tag );
+    if( pPacket != NULL )
+    {
+        ret = PeerConnectionJitterBuffer_Push( &pContext->jitterBuffer,
+                                               pPacket );
+    }
+
+    return ret;
+}
+
+static int CheckFrame( JitterBufferTestContext_t * pContext,
+                       size_t frameIndex,
+                       uint16_t startSequence,
+                       uint16_t endSequence )
+{
+    int ret = 0;
+    JitterBufferTestFrame_t * pFrame = &pContext->frames[ frameIndex ];
+
+    if( frameIndex >= pContext->frameNum )
+    {
+        printf( "Frame %lu is not popped, popped frames: %lu\n", frameIndex, pContext->frameNum );
+        ret = -1;
+    }
+    else if( ( pFrame->isDropped != 0U ) ||
+             ( pFrame->startSequence != startSequence ) ||
+             ( pFrame->endSequence != endSequence ) )
+    {
+        printf( "Frame %lu is %s from %u to %u, expected ready from %u to %u\n",
+                frameIndex, pFrame->isDropped != 0U ? "dropped" : "ready",
+                pFrame->startSequence, pFrame->endSequence, startSequence, endSequence );
+        ret = -1;
+    }
+    else if( pFrame->isTagMatched == 0U )
+    {
+        printf( "Frame %lu from %u to %u has packets of a wrong copy\n", frameIndex, startSequence, endSequence );
+        ret = -1;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return ret;
+}
+
+/* A duplicate of a buffered packet, e.g. a replayed or retransmitted one, must not replace it. */
+static int TestDuplicate( void )
+{
+    int ret = CreateJitterBuffer( &testContext );
+
+    if( ( ret == 0 ) &&
+        ( ( PushPacket( &testContext, 100U, 3000U, 1U, 0U, 'A' ) != PEER_CONNECTION_RESULT_OK ) ||
+          ( PushPacket( &testContext, 101U, 3000U, 0U, 0U, 'A' ) != PEER_CONNECTION_RESULT_OK ) ) )
+    {
+        printf( "Fail to push the first packets\n" );
+        ret = -1;
+    }
+
+    if( ( ret == 0 ) &&
+        ( PushPacket( &testContext, 101U, 3000U, 0U, 0U, 'B' ) != PEER_CONNECTION_RESULT_PACKET_DUPLICATED ) )
+    {
+        printf( "Duplicated packet is not rejected\n" );
+        ret = -1;
+    }
+
+    if( ( ret == 0 ) &&
+        ( ( PushPacket( &testContext, 102U, 3000U, 0U, 0U, 'A' ) != PEER_CONNECTION_RESULT_OK ) ||
+          ( PushPacket( &testContext, 103U, 3000U, 0U, 1U, 'A' ) != PEER_CONNECTION_RESULT_OK ) ) )
+    {
+        printf( "Fail to push the last packets\n" );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckFrame( &testContext, 0U, 100U, 103U );
+    }
+
+    if( testContext.jitterBuffer.isInit != 0U )
+    {
+        PeerConnectionJitterBuffer_Free( &testContext.jitterBuffer );
+    }
+
+    return ret;
+}
+
+/* A packet that fails the authentication is discarded before it's pushed, the buffered packet with the same
+ * sequence number stays. */
+static int TestDiscardBeforePush( void )
+{
+    int ret = CreateJitterBuffer( &testContext );
+    PeerConnectionJitterBufferPacket_t * pPacket = NULL;
+
+    if( ( ret == 0 ) &&
+        ( PushPacket( &testContext, 200U, 6000U, 1U, 0U, 'A' ) != PEER_CONNECTION_RESULT_OK ) )
+    {
+        printf( "Fail to push the first packet\n" );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        /* The forged packet carries the sequence number of the buffered one. */
+        pPacket = ReceivePacket( &testContext, 200U, 6000U, 1U, 0U, 'B' );
+        if( pPacket == NULL )
+        {
+            ret = -1;
+        }
+        else
+        {
+            PeerConnectionJitterBuffer_DiscardBuffer( &testContext.jitterBuffer,
+                                                      pPacket );
+        }
+    }
+
+    if( ( ret == 0 ) &&
+        ( PushPacket( &testContext, 201U, 6000U, 0U, 1U, 'A' ) != PEER_CONNECTION_RESULT_OK ) )
+    {
+        printf( "Fail to push the last packet\n" );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckFrame( &testContext, 0U, 200U, 201U );
+    }
+
+    if( testContext.jitterBuffer.isInit != 0U )
+    {
+        PeerConnectionJitterBuffer_Free( &testContext.jitterBuffer );
+    }
+
+    return ret;
+}
+
+/* A long stream with the sequence number wrapping, every packet is decrypted into the pool, never the heap. */
+static int TestPoolOnly( void )
+{
+    int ret = CreateJitterBuffer( &testContext );
+    const uint32_t frameNum = 1000U;
+    const uint16_t packetNumPerFrame = 3U;
+    uint16_t sequenceNumber = 65000U;
+    uint32_t rtpTimestamp = 0U;
+    uint32_t i;
+    uint16_t j;
+
+    for( i = 0; ( ret == 0 ) && ( i < frameNum ); i++ )
+    {
+        for( j = 0; ( ret == 0 ) && ( j < packetNumPerFrame ); j++ )
+        {
+            if( PushPacket( &testContext,
+                            sequenceNumber,
+                            rtpTimestamp,
+                            j == 0U ? 1U : 0U,
+                            j == packetNumPerFrame - 1U ? 1U : 0U,
+                            'A' ) != PEER_CONNECTION_RESULT_OK )
+            {
+                printf( "Fail to push packet %u\n", sequenceNumber );
+                ret = -1;
+            }
+            sequenceNumber++;
+        }
+        rtpTimestamp += JITTER_BUFFER_TEST_CLOCK_RATE / 30U;
+        testContext.currentTimeUs += 33333U;
+    }
+
+    if( ( ret == 0 ) && ( testContext.frameNum != frameNum ) )
+    {
+        printf( "Popped %lu frames, expected %u\n", testContext.frameNum, frameNum );
+        ret = -1;
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < frameNum ); i++ )
+    {
+        ret = CheckFrame( &testContext,
+                          i,
+                          ( uint16_t )( 65000U + i * packetNumPerFrame ),
+                          ( uint16_t )( 65000U + i * packetNumPerFrame + packetNumPerFrame - 1U ) );
+    }
+
+    if( ( ret == 0 ) && ( testContext.jitterBuffer.heapAllocationCount != 0U ) )
+    {
+        printf( "%lu packets allocated from heap\n", testContext.jitterBuffer.heapAllocationCount );
+        ret = -1;
+    }
+
+    if( testContext.jitterBuffer.isInit != 0U )
+    {
+        PeerConnectionJitterBuffer_Free( &testContext.jitterBuffer );
+    }
+
+    return ret;
+}
+
+/* Push the packets of a frame in the order of the offsets. */
+static int PushFrame( JitterBufferTestContext_t * pContext,
+                      uint16_t startSequence,
+                      uint16_t packetNum,
+                      uint32_t rtpTimestamp,
+                      const uint16_t * pOffsets )
+{
+    int ret = 0;
+    PeerConnectionResult_t result;
+    uint16_t i;
+
+    for( i = 0; ( ret == 0 ) && ( i < packetNum ); i++ )
+    {
+        result = PushPacket( pContext,
+                             ( uint16_t )( startSequence + pOffsets[ i ] ),
+                             rtpTimestamp,
+                             pOffsets[ i ] == 0U ? 1U : 0U,
+                             pOffsets[ i ] == packetNum - 1U ? 1U : 0U,
+                             'A' );
+        if( result != PEER_CONNECTION_RESULT_OK )
+        {
+            printf( "Fail to push packet %u, result: %d\n", ( uint16_t )( startSequence + pOffsets[ i ] ), result );
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+static void GetOffsets( JitterBufferTestContext_t * pContext,
+                        uint16_t * pOffsets,
+                        uint16_t packetNum,
+                        uint8_t isShuffled )
+{
+    uint16_t i;
+    uint16_t j;
+    uint16_t offset;
+
+    for( i = 0; i < packetNum; i++ )
+    {
+        pOffsets[ i ] = i;
+    }
+
+    for( i = packetNum - 1U; ( isShuffled != 0U ) && ( i > 0U ); i-- )
+    {
+        j = ( uint16_t )( GetRandom( pContext ) % ( i + 1U ) );
+        offset = pOffsets[ i ];
+        pOffsets[ i ] = pOffsets[ j ];
+        pOffsets[ j ] = offset;
+    }
+}
+
+/* A keyframe in random order is popped once its last gap is filled, not before. */
+static int TestRandomOrder( void )
+{
+    int ret = CreateJitterBuffer( &testContext );
+    uint16_t offsets[ JITTER_BUFFER_TEST_KEYFRAME_PACKET_NUM ];
+    uint32_t round;
+
+    /* The sequence number wraps in the middle of the frame. */
+    for( round = 0; ( ret == 0 ) && ( round < 10U ); round++ )
+    {
+        GetOffsets( &testContext,
+                    offsets,
+                    JITTER_BUFFER_TEST_KEYFRAME_PACKET_NUM,
+                    1U );
+        ret = PushFrame( &testContext,
+                         ( uint16_t )( 65400U + round * JITTER_BUFFER_TEST_KEYFRAME_PACKET_NUM ),
+                         JITTER_BUFFER_TEST_KEYFRAME_PACKET_NUM,
+                         round * 3000U,
+                         offsets );
+
+        if( ( ret == 0 ) && ( testContext.frameNum != round + 1U ) )
+        {
+            printf( "Popped %lu frames after frame %u\n", testContext.frameNum, round );
+            ret = -1;
+        }
+
+        if( ret == 0 )
+        {
+            ret = CheckFrame( &testContext,
+                              round,
+                              ( uint16_t )( 65400U + round * JITTER_BUFFER_TEST_KEYFRAME_PACKET_NUM ),
+                              ( uint16_t )( 65400U + round * JITTER_BUFFER_TEST_KEYFRAME_PACKET_NUM + JITTER_BUFFER_TEST_KEYFRAME_PACKET_NUM - 1U ) );
+        }
+    }
+
+    if( testContext.jitterBuffer.isInit != 0U )
+    {
+        PeerConnectionJitterBuffer_Free( &testContext.jitterBuffer );
+    }
+
+    return ret;
+}
+
+/* A frame fitting the bitmap exactly is popped, a larger one is rejected and dropped instead of aliasing in the
+ * bitmap and waiting for its expiration, and the next frame is still popped. */
+static int TestFrameSize( void )
+{
+    int ret = CreateJitterBuffer( &testContext );
+    static uint16_t offsets[ PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE + 100 ];
+    const uint16_t largeFramePacketNum = PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE + 100;
+    uint16_t sequenceNumber = 0U;
+    uint16_t i;
+
+    GetOffsets( &testContext,
+                offsets,
+                largeFramePacketNum,
+                0U );
+
+    if( ret == 0 )
+    {
+        ret = PushFrame( &testContext,
+                         sequenceNumber,
+                         PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE,
+                         0U,
+                         offsets );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckFrame( &testContext,
+                          0U,
+                          sequenceNumber,
+                          ( uint16_t )( sequenceNumber + PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE - 1U ) );
+        sequenceNumber += PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE;
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < largeFramePacketNum ); i++ )
+    {
+        if( ( PushPacket( &testContext,
+                          ( uint16_t )( sequenceNumber + i ),
+                          3000U,
+                          i == 0U ? 1U : 0U,
+                          i == largeFramePacketNum - 1U ? 1U : 0U,
+                          'A' ) == PEER_CONNECTION_RESULT_FAIL_JITTER_BUFFER_FRAME_TOO_LARGE ) !=
+            ( i >= PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE ) )
+        {
+            printf( "Packet %u of the large frame is %s\n", i, i < PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE ? "rejected" : "accepted" );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        sequenceNumber += largeFramePacketNum;
+        ret = PushFrame( &testContext,
+                         sequenceNumber,
+                         3U,
+                         6000U,
+                         offsets );
+    }
+
+    if( ( ret == 0 ) &&
+        ( ( testContext.frameNum != 3U ) ||
+          ( testContext.frames[ 1 ].isDropped == 0U ) ||
+          ( testContext.frames[ 1 ].startSequence != PEER_CONNECTION_JITTER_BUFFER_FRAME_BITMAP_SIZE ) ||
+          ( testContext.frames[ 1 ].endSequence != ( uint16_t )( sequenceNumber - 1U ) ) ) )
+    {
+        printf( "The large frame is not dropped, popped frames: %lu\n", testContext.frameNum );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckFrame( &testContext,
+                          2U,
+                          sequenceNumber,
+                          ( uint16_t )( sequenceNumber + 2U ) );
+    }
+
+    if( testContext.jitterBuffer.isInit != 0U )
+    {
+        PeerConnectionJitterBuffer_Free( &testContext.jitterBuffer );
+    }
+
+    return ret;
+}
+
+int main( void )
+{
+    int ret = 0;
+    int result;
+
+    result = TestDuplicate();
+    printf( "Duplicate: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestDiscardBeforePush();
+    printf( "Discard before push: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestPoolOnly();
+    printf( "Pool only: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestRandomOrder();
+    printf( "Random order: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestFrameSize();
+    printf( "Frame size: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    return ret == 0 ? 0 : 1;
+}
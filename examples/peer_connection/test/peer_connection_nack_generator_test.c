@@ -0,0 +1,519 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Run the NACK generator over a lossy UDP loopback.
+ * A sender socket sends numbered packets to a receiver socket, dropping some of them, the media packets carry only the RTP sequence number.
+ * The receiver feeds the NACK generator and sends its NACK lists back, the sender retransmits the NACKed packets.
+ * The first retransmission of every other lost packet and every 10th NACK are dropped too, so some packets take several retries.
+ * A few packets are dropped with all their retransmissions to hit the retry limit.
+ * The drops don't depend on the timing, so a recoverable packet is always recovered within the retry limit.
+ * Usage: PeerConnectionNackGeneratorTest */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "logging.h"
+#include "peer_connection_nack_generator.h"
+
+#define NACK_TEST_PACKET_NUM ( 3000 )
+#define NACK_TEST_PACKET_INTERVAL_US ( 1000 )
+/* Start close to the end of the sequence number space to cover the wrap around. */
+#define NACK_TEST_FIRST_SEQUENCE_NUMBER ( 64000 )
+#define NACK_TEST_LOSS_PERCENT ( 10 )
+/* Every this many NACKs one is dropped. */
+#define NACK_TEST_NACK_LOSS_INTERVAL ( 10 )
+/* Every this many packets one is dropped with all its retransmissions. */
+#define NACK_TEST_UNRECOVERABLE_PACKET_INTERVAL ( 500 )
+#define NACK_TEST_NACK_INTERVAL_US ( 5000 )
+#define NACK_TEST_RTT_US ( 20000 )
+/* Same as PEER_CONNECTION_NACK_GENERATOR_MAX_RETRY_COUNT. */
+#define NACK_TEST_MAX_RETRY_COUNT ( 5 )
+/* Same as PEER_CONNECTION_NACK_GENERATOR_MIN_RETRY_INTERVAL_US and PEER_CONNECTION_NACK_GENERATOR_MAX_RETRY_INTERVAL_US. */
+#define NACK_TEST_MIN_RTT_US ( 10000 )
+#define NACK_TEST_MAX_RTT_US ( 1000000 )
+/* Keep running after the last packet until every retry is done. */
+#define NACK_TEST_DRAIN_TIME_US ( NACK_TEST_RTT_US * ( NACK_TEST_MAX_RETRY_COUNT + 2 ) + 100000 )
+#define NACK_TEST_MAX_NACK_LIST_LENGTH ( 128 )
+
+typedef struct NackTestPacket
+{
+    uint8_t isReceived;
+    uint8_t isLost;
+    uint32_t retransmissionCount;
+    uint32_t nackCount;
+    uint64_t lastNackTimeUs;
+} NackTestPacket_t;
+
+typedef struct NackTestContext
+{
+    PeerConnectionNackGenerator_t nackGenerator;
+    NackTestPacket_t packets[ NACK_TEST_PACKET_NUM ];
+    int senderSocket;
+    int receiverSocket;
+    struct sockaddr_in senderAddress;
+    struct sockaddr_in receiverAddress;
+    uint32_t randomSeed;
+
+    /* Results. */
+    uint32_t lostNum;
+    uint32_t nackListNum;
+    uint32_t nackNum;
+    uint32_t retransmissionNum;
+    uint32_t spuriousNackNum;
+    uint32_t unorderedNackListNum;
+    uint32_t earlyRetryNum;
+} NackTestContext_t;
+
+static uint64_t GetMonotonicTimeUs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000ULL + ( uint64_t ) now.tv_nsec / 1000ULL;
+}
+
+/* The test must be reproducible, use a fixed linear congruential generator for the losses of the packets sent the first time. */
+static uint8_t ShouldDrop( NackTestContext_t * pContext )
+{
+    pContext->randomSeed = pContext->randomSeed * 1103515245U + 12345U;
+
+    return ( ( ( pContext->randomSeed >> 16 ) & 0x7FFFU ) % 100U ) < NACK_TEST_LOSS_PERCENT;
+}
+
+static uint8_t IsUnrecoverable( uint32_t index )
+{
+    return ( index % NACK_TEST_UNRECOVERABLE_PACKET_INTERVAL ) == NACK_TEST_UNRECOVERABLE_PACKET_INTERVAL / 2U;
+}
+
+static uint32_t GetPacketIndex( uint16_t rtpSeq )
+{
+    return ( uint16_t )( rtpSeq - ( uint16_t ) NACK_TEST_FIRST_SEQUENCE_NUMBER );
+}
+
+static int OpenSocket( struct sockaddr_in * pAddress )
+{
+    int socketFd;
+    socklen_t addressLength = sizeof( struct sockaddr_in );
+
+    memset( pAddress, 0, sizeof( struct sockaddr_in ) );
+    pAddress->sin_family = AF_INET;
+    pAddress->sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+    pAddress->sin_port = 0;
+
+    socketFd = socket( AF_INET, SOCK_DGRAM, 0 );
+    if( socketFd < 0 )
+    {
+        LogError( ( "Fail to create socket" ) );
+    }
+    else if( ( bind( socketFd, ( struct sockaddr * ) pAddress, addressLength ) != 0 ) ||
+             ( getsockname( socketFd, ( struct sockaddr * ) pAddress, &addressLength ) != 0 ) )
+    {
+        LogError( ( "Fail to bind socket" ) );
+        close( socketFd );
+        socketFd = -1;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return socketFd;
+}
+
+static void SendSequenceNumbers( int socketFd,
+                                 const struct sockaddr_in * pDestination,
+                                 const uint16_t * pSeqList,
+                                 size_t seqListLength )
+{
+    uint8_t buffer[ NACK_TEST_MAX_NACK_LIST_LENGTH * 2U ];
+    size_t i;
+
+    for( i = 0; i < seqListLength; i++ )
+    {
+        buffer[ i * 2U ] = ( uint8_t )( pSeqList[ i ] >> 8 );
+        buffer[ i * 2U + 1U ] = ( uint8_t )( pSeqList[ i ] & 0xFFU );
+    }
+
+    ( void ) sendto( socketFd,
+                     buffer,
+                     seqListLength * 2U,
+                     0,
+                     ( const struct sockaddr * ) pDestination,
+                     sizeof( struct sockaddr_in ) );
+}
+
+static size_t ReceiveSequenceNumbers( int socketFd,
+                                      uint16_t * pSeqList )
+{
+    uint8_t buffer[ NACK_TEST_MAX_NACK_LIST_LENGTH * 2U ];
+    ssize_t receivedLength;
+    size_t i;
+    size_t seqListLength = 0U;
+
+    receivedLength = recv( socketFd,
+                           buffer,
+                           sizeof( buffer ),
+                           MSG_DONTWAIT );
+    if( receivedLength > 0 )
+    {
+        seqListLength = ( size_t ) receivedLength / 2U;
+        for( i = 0; i < seqListLength; i++ )
+        {
+            pSeqList[ i ] = ( uint16_t )( ( buffer[ i * 2U ] << 8 ) | buffer[ i * 2U + 1U ] );
+        }
+    }
+
+    return seqListLength;
+}
+
+static void SendMediaPacket( NackTestContext_t * pContext,
+                             uint32_t index,
+                             uint8_t isRetransmission )
+{
+    uint16_t rtpSeq = ( uint16_t )( NACK_TEST_FIRST_SEQUENCE_NUMBER + index );
+    uint8_t isDropped;
+
+    /* Never drop the last packet, nothing after it would reveal the loss. */
+    if( index == NACK_TEST_PACKET_NUM - 1U )
+    {
+        isDropped = 0U;
+    }
+    else if( IsUnrecoverable( index ) != 0U )
+    {
+        isDropped = 1U;
+    }
+    else if( isRetransmission != 0U )
+    {
+        isDropped = ( ( pContext->packets[ index ].retransmissionCount == 0U ) && ( ( index % 2U ) == 0U ) ) ? 1U : 0U;
+    }
+    else
+    {
+        isDropped = ShouldDrop( pContext );
+    }
+
+    if( isRetransmission != 0U )
+    {
+        pContext->packets[ index ].retransmissionCount++;
+        pContext->retransmissionNum++;
+    }
+    else if( isDropped != 0U )
+    {
+        pContext->packets[ index ].isLost = 1U;
+        pContext->lostNum++;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    if( isDropped == 0U )
+    {
+        SendSequenceNumbers( pContext->senderSocket,
+                             &pContext->receiverAddress,
+                             &rtpSeq,
+                             1U );
+    }
+}
+
+static void OnNackList( NackTestContext_t * pContext,
+                        const uint16_t * pSeqList,
+                        size_t seqListLength,
+                        uint64_t currentTimeUs )
+{
+    NackTestPacket_t * pPacket;
+    uint32_t index;
+    size_t i;
+
+    for( i = 0; i < seqListLength; i++ )
+    {
+        index = GetPacketIndex( pSeqList[ i ] );
+
+        if( ( i > 0U ) && ( ( int16_t )( pSeqList[ i ] - pSeqList[ i - 1U ] ) <= 0 ) )
+        {
+            pContext->unorderedNackListNum++;
+        }
+
+        if( ( index >= NACK_TEST_PACKET_NUM ) || ( pContext->packets[ index ].isReceived != 0U ) )
+        {
+            pContext->spuriousNackNum++;
+        }
+        else
+        {
+            pPacket = &pContext->packets[ index ];
+            if( ( pPacket->nackCount > 0U ) &&
+                ( currentTimeUs - pPacket->lastNackTimeUs < NACK_TEST_RTT_US ) )
+            {
+                pContext->earlyRetryNum++;
+            }
+            pPacket->nackCount++;
+            pPacket->lastNackTimeUs = currentTimeUs;
+        }
+
+        pContext->nackNum++;
+    }
+}
+
+static int RunLoopback( NackTestContext_t * pContext )
+{
+    int ret = 0;
+    struct pollfd pollFds[ 2 ];
+    uint16_t seqList[ NACK_TEST_MAX_NACK_LIST_LENGTH ];
+    size_t seqListLength;
+    uint64_t startTimeUs = GetMonotonicTimeUs();
+    uint64_t currentTimeUs = startTimeUs;
+    uint64_t nextNackTimeUs = startTimeUs + NACK_TEST_NACK_INTERVAL_US;
+    uint64_t endTimeUs = startTimeUs + ( uint64_t ) NACK_TEST_PACKET_NUM * NACK_TEST_PACKET_INTERVAL_US + NACK_TEST_DRAIN_TIME_US;
+    uint32_t sentNum = 0U;
+    uint32_t index;
+    size_t i;
+
+    pollFds[ 0 ].fd = pContext->senderSocket;
+    pollFds[ 0 ].events = POLLIN;
+    pollFds[ 1 ].fd = pContext->receiverSocket;
+    pollFds[ 1 ].events = POLLIN;
+
+    while( currentTimeUs < endTimeUs )
+    {
+        while( ( sentNum < NACK_TEST_PACKET_NUM ) &&
+               ( startTimeUs + ( uint64_t ) sentNum * NACK_TEST_PACKET_INTERVAL_US <= currentTimeUs ) )
+        {
+            SendMediaPacket( pContext,
+                             sentNum,
+                             0U );
+            sentNum++;
+        }
+
+        /* Receiver, record the packets and report the gaps. */
+        while( ReceiveSequenceNumbers( pContext->receiverSocket,
+                                       seqList ) == 1U )
+        {
+            index = GetPacketIndex( seqList[ 0 ] );
+            if( index < NACK_TEST_PACKET_NUM )
+            {
+                pContext->packets[ index ].isReceived = 1U;
+            }
+
+            if( PeerConnectionNackGenerator_OnPacketReceived( &pContext->nackGenerator,
+                                                              seqList[ 0 ],
+                                                              currentTimeUs ) != PEER_CONNECTION_RESULT_OK )
+            {
+                LogError( ( "Fail to record packet, seq: %u", seqList[ 0 ] ) );
+                ret = -1;
+            }
+        }
+
+        if( currentTimeUs >= nextNackTimeUs )
+        {
+            seqListLength = NACK_TEST_MAX_NACK_LIST_LENGTH;
+            if( PeerConnectionNackGenerator_GetNackList( &pContext->nackGenerator,
+                                                         currentTimeUs,
+                                                         seqList,
+                                                         &seqListLength ) != PEER_CONNECTION_RESULT_OK )
+            {
+                LogError( ( "Fail to get NACK list" ) );
+                ret = -1;
+            }
+            else if( seqListLength > 0U )
+            {
+                OnNackList( pContext,
+                            seqList,
+                            seqListLength,
+                            currentTimeUs );
+
+                /* The NACK itself can be lost too. */
+                pContext->nackListNum++;
+                if( ( pContext->nackListNum % NACK_TEST_NACK_LOSS_INTERVAL ) != 0U )
+                {
+                    SendSequenceNumbers( pContext->receiverSocket,
+                                         &pContext->senderAddress,
+                                         seqList,
+                                         seqListLength );
+                }
+            }
+            else
+            {
+                /* Empty else marker. */
+            }
+
+            nextNackTimeUs += NACK_TEST_NACK_INTERVAL_US;
+        }
+
+        /* Sender, retransmit the NACKed packets. */
+        while( ( seqListLength = ReceiveSequenceNumbers( pContext->senderSocket,
+                                                         seqList ) ) > 0U )
+        {
+            for( i = 0; i < seqListLength; i++ )
+            {
+                index = GetPacketIndex( seqList[ i ] );
+                if( index < sentNum )
+                {
+                    SendMediaPacket( pContext,
+                                     index,
+                                     1U );
+                }
+            }
+        }
+
+        ( void ) poll( pollFds,
+                       2,
+                       1 );
+        currentTimeUs = GetMonotonicTimeUs();
+    }
+
+    return ret;
+}
+
+/* The retry interval follows the RTT, within the limits. */
+static int TestRttLimits( NackTestContext_t * pContext )
+{
+    int ret = 0;
+
+    PeerConnectionNackGenerator_UpdateRtt( &pContext->nackGenerator,
+                                           1U );
+    if( pContext->nackGenerator.rttUs != NACK_TEST_MIN_RTT_US )
+    {
+        ret = -1;
+    }
+
+    PeerConnectionNackGenerator_UpdateRtt( &pContext->nackGenerator,
+                                           10U * NACK_TEST_MAX_RTT_US );
+    if( pContext->nackGenerator.rttUs != NACK_TEST_MAX_RTT_US )
+    {
+        ret = -1;
+    }
+
+    PeerConnectionNackGenerator_UpdateRtt( &pContext->nackGenerator,
+                                           NACK_TEST_RTT_US );
+    if( pContext->nackGenerator.rttUs != NACK_TEST_RTT_US )
+    {
+        ret = -1;
+    }
+
+    printf( "RTT limits: %s\n",
+            ( ret == 0 ) ? "pass" : "FAIL" );
+
+    return ret;
+}
+
+int main( void )
+{
+    int ret = 0;
+    /* Too large for the stack. */
+    static NackTestContext_t context;
+    uint32_t unrecoveredNum = 0U;
+    uint32_t unrecoverableNum = 0U;
+    uint32_t wrongRetryCountNum = 0U;
+    uint32_t i;
+
+    memset( &context, 0, sizeof( NackTestContext_t ) );
+    context.randomSeed = 1U;
+    context.senderSocket = OpenSocket( &context.senderAddress );
+    context.receiverSocket = OpenSocket( &context.receiverAddress );
+
+    if( ( context.senderSocket < 0 ) || ( context.receiverSocket < 0 ) )
+    {
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        if( PeerConnectionNackGenerator_Init( &context.nackGenerator ) != PEER_CONNECTION_RESULT_OK )
+        {
+            LogError( ( "Fail to initialize NACK generator" ) );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        ret = TestRttLimits( &context );
+    }
+
+    if( ret == 0 )
+    {
+        ret = RunLoopback( &context );
+    }
+
+    if( ret == 0 )
+    {
+        for( i = 0; i < NACK_TEST_PACKET_NUM; i++ )
+        {
+            if( IsUnrecoverable( i ) != 0U )
+            {
+                unrecoverableNum++;
+                if( context.packets[ i ].nackCount != NACK_TEST_MAX_RETRY_COUNT )
+                {
+                    LogError( ( "Unrecoverable packet %u is NACKed %u times", i, context.packets[ i ].nackCount ) );
+                    wrongRetryCountNum++;
+                }
+            }
+            else if( context.packets[ i ].isReceived == 0U )
+            {
+                LogError( ( "Packet %u is never recovered, NACKed %u times", i, context.packets[ i ].nackCount ) );
+                unrecoveredNum++;
+            }
+            else
+            {
+                /* Empty else marker. */
+            }
+        }
+
+        printf( "Packets: %u, lost: %u, NACKed sequence numbers: %u, retransmissions: %u\n",
+                NACK_TEST_PACKET_NUM,
+                context.lostNum,
+                context.nackNum,
+                context.retransmissionNum );
+        printf( "Unrecovered: %u, unrecoverable with wrong retry count: %u/%u, spurious NACKs: %u, unordered NACK lists: %u, retries within RTT: %u\n",
+                unrecoveredNum,
+                wrongRetryCountNum,
+                unrecoverableNum,
+                context.spuriousNackNum,
+                context.unorderedNackListNum,
+                context.earlyRetryNum );
+
+        if( ( unrecoveredNum != 0U ) ||
+            ( wrongRetryCountNum != 0U ) ||
+            ( context.spuriousNackNum != 0U ) ||
+            ( context.unorderedNackListNum != 0U ) ||
+            ( context.earlyRetryNum != 0U ) ||
+            ( context.lostNum == 0U ) )
+        {
+            ret = -1;
+        }
+
+        printf( "Lossy loopback: %s\n",
+                ( ret == 0 ) ? "pass" : "FAIL" );
+    }
+
+    if( context.senderSocket >= 0 )
+    {
+        close( context.senderSocket );
+    }
+
+    if( context.receiverSocket >= 0 )
+    {
+        close( context.receiverSocket );
+    }
+
+    return ret;
+}
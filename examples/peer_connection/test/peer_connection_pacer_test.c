@@ -0,0 +1,548 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Run the pacer task against a recording ICE controller and check the packets it sends.
+ * Every packet carries its index, the test checks the spacing between the send times against the pacing rate,
+ * the priority between queues, the order in a queue, the drops on a full queue and the TWCC send times.
+ * Usage: PeerConnectionPacerTest */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "logging.h"
+#include "peer_connection_pacer.h"
+#include "networking_utils.h"
+#include "ice_controller.h"
+
+#define PACER_TEST_MAX_PACKET_NUM ( 1024 )
+#define PACER_TEST_POLL_INTERVAL_US ( 1000 )
+#define PACER_TEST_TIMEOUT_US ( 10000000 )
+#define PACER_TEST_US_PER_SECOND ( 1000000ULL )
+
+typedef struct PacerTestSentPacket
+{
+    uint32_t index;
+    PeerConnectionPacerPriority_t priority;
+    size_t packetLength;
+    uint64_t sentTimeUs;
+} PacerTestSentPacket_t;
+
+typedef struct PacerTestRecorder
+{
+    pthread_mutex_t mutex;
+    PacerTestSentPacket_t sentPackets[ PACER_TEST_MAX_PACKET_NUM ];
+    size_t sentPacketNum;
+    #if ENABLE_TWCC_SUPPORT
+        /* How many times the send time of each transport-wide sequence number is set. */
+        uint32_t sentTimeSetNum[ PACER_TEST_MAX_PACKET_NUM ];
+    #endif /* ENABLE_TWCC_SUPPORT */
+} PacerTestRecorder_t;
+
+static PacerTestRecorder_t recorder;
+static IceControllerContext_t iceControllerContext;
+static PeerConnectionPacer_t pacer;
+#if ENABLE_TWCC_SUPPORT
+    static PeerConnectionTwccHistory_t twccHistory;
+#endif /* ENABLE_TWCC_SUPPORT */
+
+/* The recording ICE controller, the pacer task calls it without holding the pacer mutex. */
+IceControllerResult_t IceController_AddToSendBatch( IceControllerContext_t * pCtx,
+                                                    IceControllerSendBatch_t * pBatch,
+                                                    uint8_t * pBuffer,
+                                                    size_t bufferLength,
+                                                    uint64_t departureTimeUs )
+{
+    PacerTestSentPacket_t * pSentPacket;
+
+    ( void ) pCtx;
+    ( void ) pBatch;
+    ( void ) departureTimeUs;
+
+    ( void ) pthread_mutex_lock( &recorder.mutex );
+    if( recorder.sentPacketNum < PACER_TEST_MAX_PACKET_NUM )
+    {
+        pSentPacket = &recorder.sentPackets[ recorder.sentPacketNum ];
+        memcpy( &pSentPacket->index,
+                pBuffer,
+                sizeof( uint32_t ) );
+        pSentPacket->priority = ( PeerConnectionPacerPriority_t ) pBuffer[ sizeof( uint32_t ) ];
+        pSentPacket->packetLength = bufferLength;
+        pSentPacket->sentTimeUs = NetworkingUtils_GetCurrentMonotonicTimeUs( NULL );
+        recorder.sentPacketNum++;
+    }
+    ( void ) pthread_mutex_unlock( &recorder.mutex );
+
+    return ICE_CONTROLLER_RESULT_OK;
+}
+
+IceControllerResult_t IceController_FlushSendBatch( IceControllerContext_t * pCtx,
+                                                    IceControllerSendBatch_t * pBatch )
+{
+    ( void ) pCtx;
+    ( void ) pBatch;
+
+    return ICE_CONTROLLER_RESULT_OK;
+}
+
+/* The kernel pacing path needs a socket with SO_TXTIME, the pacer task spaces the packets itself here. */
+uint8_t IceController_IsTxTimeEnabled( IceControllerContext_t * pCtx )
+{
+    ( void ) pCtx;
+
+    return 0U;
+}
+
+#if ENABLE_TWCC_SUPPORT
+    PeerConnectionResult_t PeerConnectionTwccHistory_SetSentTime( PeerConnectionTwccHistory_t * pTwccHistory,
+                                                                  uint16_t transportSequenceNumber,
+                                                                  uint64_t sentTimeUs )
+    {
+        ( void ) pTwccHistory;
+        ( void ) sentTimeUs;
+
+        ( void ) pthread_mutex_lock( &recorder.mutex );
+        if( transportSequenceNumber < PACER_TEST_MAX_PACKET_NUM )
+        {
+            recorder.sentTimeSetNum[ transportSequenceNumber ]++;
+        }
+        ( void ) pthread_mutex_unlock( &recorder.mutex );
+
+        return PEER_CONNECTION_RESULT_OK;
+    }
+#endif /* ENABLE_TWCC_SUPPORT */
+
+static void ResetRecorder( void )
+{
+    ( void ) pthread_mutex_lock( &recorder.mutex );
+    recorder.sentPacketNum = 0U;
+    #if ENABLE_TWCC_SUPPORT
+        memset( recorder.sentTimeSetNum, 0, sizeof( recorder.sentTimeSetNum ) );
+    #endif /* ENABLE_TWCC_SUPPORT */
+    ( void ) pthread_mutex_unlock( &recorder.mutex );
+}
+
+static size_t GetSentPacketNum( void )
+{
+    size_t sentPacketNum;
+
+    ( void ) pthread_mutex_lock( &recorder.mutex );
+    sentPacketNum = recorder.sentPacketNum;
+    ( void ) pthread_mutex_unlock( &recorder.mutex );
+
+    return sentPacketNum;
+}
+
+static uint64_t GetDroppedPacketCount( void )
+{
+    uint64_t droppedPacketCount;
+
+    ( void ) pthread_mutex_lock( &pacer.pacerMutex );
+    droppedPacketCount = pacer.droppedPacketCount;
+    ( void ) pthread_mutex_unlock( &pacer.pacerMutex );
+
+    return droppedPacketCount;
+}
+
+/* Wait till every packet enqueued is either sent or dropped. */
+static int WaitForPackets( size_t packetNum )
+{
+    int ret = 0;
+    uint64_t deadlineUs = NetworkingUtils_GetCurrentMonotonicTimeUs( NULL ) + PACER_TEST_TIMEOUT_US;
+
+    while( GetSentPacketNum() + ( size_t ) GetDroppedPacketCount() < packetNum )
+    {
+        if( NetworkingUtils_GetCurrentMonotonicTimeUs( NULL ) > deadlineUs )
+        {
+            printf( "Timeout, sent: %lu, dropped: %lu, enqueued: %lu\n", GetSentPacketNum(), GetDroppedPacketCount(), packetNum );
+            ret = -1;
+            break;
+        }
+        ( void ) usleep( PACER_TEST_POLL_INTERVAL_US );
+    }
+
+    /* Let a late packet show up as an error. */
+    ( void ) usleep( 10 * PACER_TEST_POLL_INTERVAL_US );
+    if( ( ret == 0 ) && ( GetSentPacketNum() + ( size_t ) GetDroppedPacketCount() != packetNum ) )
+    {
+        printf( "Sent %lu, dropped %lu, but enqueued %lu\n", GetSentPacketNum(), GetDroppedPacketCount(), packetNum );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+static int EnqueuePacket( PeerConnectionPacerPriority_t priority,
+                          uint32_t index,
+                          size_t packetLength,
+                          uint8_t hasTransportSequenceNumber )
+{
+    int ret = 0;
+    uint8_t packet[ ICE_CONTROLLER_MAX_MTU ];
+
+    memset( packet, 0, packetLength );
+    memcpy( packet,
+            &index,
+            sizeof( uint32_t ) );
+    packet[ sizeof( uint32_t ) ] = ( uint8_t ) priority;
+
+    if( PeerConnectionPacer_EnqueuePacket( &pacer,
+                                           priority,
+                                           packet,
+                                           packetLength,
+                                           hasTransportSequenceNumber,
+                                           ( uint16_t ) index ) != PEER_CONNECTION_RESULT_OK )
+    {
+        printf( "Fail to enqueue packet %u\n", index );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Packets in one queue go out in order, each at most once. */
+static int CheckOrder( void )
+{
+    int ret = 0;
+    int64_t lastIndex[ PEER_CONNECTION_PACER_PRIORITY_NUM ];
+    size_t i;
+    int j;
+
+    for( j = 0; j < PEER_CONNECTION_PACER_PRIORITY_NUM; j++ )
+    {
+        lastIndex[ j ] = -1;
+    }
+
+    for( i = 0; i < recorder.sentPacketNum; i++ )
+    {
+        if( ( int64_t ) recorder.sentPackets[ i ].index <= lastIndex[ recorder.sentPackets[ i ].priority ] )
+        {
+            printf( "Packet %u of priority %d sent after packet %ld\n",
+                    recorder.sentPackets[ i ].index,
+                    recorder.sentPackets[ i ].priority,
+                    lastIndex[ recorder.sentPackets[ i ].priority ] );
+            ret = -1;
+            break;
+        }
+        lastIndex[ recorder.sentPackets[ i ].priority ] = recorder.sentPackets[ i ].index;
+    }
+
+    return ret;
+}
+
+/* A backlog of video frames is spread at the pacing rate, no window of packets is sent faster than the rate
+ * allows plus the burst budget and the packet that overdraws it. */
+static int TestSpacing( void )
+{
+    int ret = 0;
+    const uint64_t targetBitrateBps = 1000000U;
+    const uint64_t pacingBitrateBps = targetBitrateBps * PEER_CONNECTION_PACER_PACING_FACTOR_PERCENT / 100U;
+    const size_t packetLength = 1000U;
+    const uint32_t packetNum = 100U;
+    uint64_t maxBurstBits;
+    uint64_t windowBits;
+    uint64_t allowedBits;
+    uint64_t durationUs;
+    uint64_t minDurationUs;
+    uint64_t minGapUs = UINT64_MAX;
+    size_t i;
+    size_t j;
+
+    ResetRecorder();
+    if( PeerConnectionPacer_Start( &pacer,
+                                   targetBitrateBps ) != PEER_CONNECTION_RESULT_OK )
+    {
+        printf( "Fail to start pacer\n" );
+        ret = -1;
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < packetNum ); i++ )
+    {
+        ret = EnqueuePacket( PEER_CONNECTION_PACER_PRIORITY_VIDEO,
+                             ( uint32_t ) i,
+                             packetLength,
+                             0U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = WaitForPackets( packetNum );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckOrder();
+    }
+
+    if( ( ret == 0 ) && ( recorder.sentPacketNum != packetNum ) )
+    {
+        printf( "Sent %lu packets, expected %u\n", recorder.sentPacketNum, packetNum );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        /* The window starts with packet i, so packet i is paid by the budget like the overdrawing one. */
+        maxBurstBits = pacingBitrateBps * PEER_CONNECTION_PACER_MAX_BURST_US / PACER_TEST_US_PER_SECOND + 2U * packetLength * 8U;
+        for( i = 0; ( ret == 0 ) && ( i < recorder.sentPacketNum ); i++ )
+        {
+            windowBits = 0U;
+            for( j = i; j < recorder.sentPacketNum; j++ )
+            {
+                windowBits += recorder.sentPackets[ j ].packetLength * 8U;
+                allowedBits = pacingBitrateBps * ( recorder.sentPackets[ j ].sentTimeUs - recorder.sentPackets[ i ].sentTimeUs ) / PACER_TEST_US_PER_SECOND + maxBurstBits;
+                if( windowBits > allowedBits )
+                {
+                    printf( "Packets %lu to %lu sent %lu bits in %lu us, allowed: %lu bits\n",
+                            i, j, windowBits, recorder.sentPackets[ j ].sentTimeUs - recorder.sentPackets[ i ].sentTimeUs, allowedBits );
+                    ret = -1;
+                    break;
+                }
+            }
+
+            if( ( i > 0U ) && ( recorder.sentPackets[ i ].sentTimeUs - recorder.sentPackets[ i - 1U ].sentTimeUs < minGapUs ) )
+            {
+                minGapUs = recorder.sentPackets[ i ].sentTimeUs - recorder.sentPackets[ i - 1U ].sentTimeUs;
+            }
+        }
+    }
+
+    if( ret == 0 )
+    {
+        durationUs = recorder.sentPackets[ recorder.sentPacketNum - 1U ].sentTimeUs - recorder.sentPackets[ 0 ].sentTimeUs;
+        minDurationUs = ( packetNum * packetLength * 8U - maxBurstBits ) * PACER_TEST_US_PER_SECOND / pacingBitrateBps;
+        printf( "Spacing: %u packets of %lu bytes at %lu bps in %lu us, expected at least %lu us, min gap: %lu us\n",
+                packetNum, packetLength, pacingBitrateBps, durationUs, minDurationUs, minGapUs );
+
+        /* The sending must not be late much either, leave room for a loaded machine. */
+        if( durationUs > 3U * ( packetNum * packetLength * 8U * PACER_TEST_US_PER_SECOND / pacingBitrateBps ) )
+        {
+            printf( "Sending took %lu us, too slow for the pacing rate\n", durationUs );
+            ret = -1;
+        }
+    }
+
+    PeerConnectionPacer_Reset( &pacer );
+
+    return ret;
+}
+
+/* Audio queued behind a video backlog overtakes it, the video is still sent in order. */
+static int TestPriority( void )
+{
+    int ret = 0;
+    const uint32_t videoPacketNum = 50U;
+    const uint32_t audioPacketNum = 5U;
+    /* The packets released before the audio is queued, the first round might take the burst budget. */
+    const size_t maxVideoAheadNum = 10U;
+    size_t sentVideoNum = 0U;
+    size_t sentAudioNum = 0U;
+    size_t i;
+
+    ResetRecorder();
+    if( PeerConnectionPacer_Start( &pacer,
+                                   200000U ) != PEER_CONNECTION_RESULT_OK )
+    {
+        printf( "Fail to start pacer\n" );
+        ret = -1;
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < videoPacketNum ); i++ )
+    {
+        ret = EnqueuePacket( PEER_CONNECTION_PACER_PRIORITY_VIDEO,
+                             ( uint32_t ) i,
+                             500U,
+                             0U );
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < audioPacketNum ); i++ )
+    {
+        ret = EnqueuePacket( PEER_CONNECTION_PACER_PRIORITY_AUDIO,
+                             ( uint32_t ) i,
+                             100U,
+                             0U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = WaitForPackets( videoPacketNum + audioPacketNum );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckOrder();
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < recorder.sentPacketNum ); i++ )
+    {
+        if( recorder.sentPackets[ i ].priority == PEER_CONNECTION_PACER_PRIORITY_AUDIO )
+        {
+            sentAudioNum++;
+            if( sentVideoNum > maxVideoAheadNum )
+            {
+                printf( "Audio packet %u sent after %lu video packets\n", recorder.sentPackets[ i ].index, sentVideoNum );
+                ret = -1;
+            }
+        }
+        else
+        {
+            sentVideoNum++;
+        }
+    }
+
+    if( ( ret == 0 ) && ( ( sentAudioNum != audioPacketNum ) || ( sentVideoNum != videoPacketNum ) ) )
+    {
+        printf( "Sent %lu audio and %lu video packets, expected %u and %u\n", sentAudioNum, sentVideoNum, audioPacketNum, videoPacketNum );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        printf( "Priority: %u audio packets sent ahead of a %u video packet backlog\n", audioPacketNum, videoPacketNum );
+    }
+
+    PeerConnectionPacer_Reset( &pacer );
+
+    return ret;
+}
+
+/* More packets than the video queue holds, the ones that don't fit are dropped and counted,
+ * never sent around the queue, and every packet sent gets its TWCC send time. */
+static int TestFullQueue( void )
+{
+    int ret = 0;
+    const uint32_t packetNum = PEER_CONNECTION_PACER_VIDEO_QUEUE_LENGTH + 200U;
+    uint64_t droppedPacketCountBefore = GetDroppedPacketCount();
+    uint64_t droppedPacketCount = 0U;
+    size_t i;
+
+    ResetRecorder();
+    if( PeerConnectionPacer_Start( &pacer,
+                                   100000U ) != PEER_CONNECTION_RESULT_OK )
+    {
+        printf( "Fail to start pacer\n" );
+        ret = -1;
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < packetNum ); i++ )
+    {
+        ret = EnqueuePacket( PEER_CONNECTION_PACER_PRIORITY_VIDEO,
+                             ( uint32_t ) i,
+                             200U,
+                             1U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = WaitForPackets( packetNum + ( size_t ) droppedPacketCountBefore );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckOrder();
+    }
+
+    if( ret == 0 )
+    {
+        droppedPacketCount = GetDroppedPacketCount() - droppedPacketCountBefore;
+        if( droppedPacketCount < packetNum - PEER_CONNECTION_PACER_VIDEO_QUEUE_LENGTH - ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM )
+        {
+            printf( "Only %lu packets dropped, the queue holds %u\n", droppedPacketCount, PEER_CONNECTION_PACER_VIDEO_QUEUE_LENGTH );
+            ret = -1;
+        }
+    }
+
+    #if ENABLE_TWCC_SUPPORT
+        for( i = 0; ( ret == 0 ) && ( i < recorder.sentPacketNum ); i++ )
+        {
+            if( recorder.sentTimeSetNum[ recorder.sentPackets[ i ].index ] != 1U )
+            {
+                printf( "Send time of packet %u set %u times\n", recorder.sentPackets[ i ].index, recorder.sentTimeSetNum[ recorder.sentPackets[ i ].index ] );
+                ret = -1;
+            }
+            recorder.sentTimeSetNum[ recorder.sentPackets[ i ].index ] = 0U;
+        }
+
+        for( i = 0; ( ret == 0 ) && ( i < packetNum ); i++ )
+        {
+            if( recorder.sentTimeSetNum[ i ] != 0U )
+            {
+                printf( "Send time of dropped packet %lu is set\n", i );
+                ret = -1;
+            }
+        }
+    #endif /* ENABLE_TWCC_SUPPORT */
+
+    if( ret == 0 )
+    {
+        printf( "Full queue: %u packets enqueued, %lu sent, %lu dropped\n", packetNum, recorder.sentPacketNum, droppedPacketCount );
+    }
+
+    PeerConnectionPacer_Reset( &pacer );
+
+    return ret;
+}
+
+int main( void )
+{
+    int ret = 0;
+
+    if( pthread_mutex_init( &recorder.mutex, NULL ) != 0 )
+    {
+        printf( "Fail to create recorder mutex\n" );
+        ret = -1;
+    }
+
+    if( ( ret == 0 ) &&
+        ( PeerConnectionPacer_Create( &pacer,
+                                      &iceControllerContext ) != PEER_CONNECTION_RESULT_OK ) )
+    {
+        printf( "Fail to create pacer\n" );
+        ret = -1;
+    }
+
+    #if ENABLE_TWCC_SUPPORT
+        if( ret == 0 )
+        {
+            PeerConnectionPacer_SetTwccHistory( &pacer,
+                                                &twccHistory );
+        }
+    #endif /* ENABLE_TWCC_SUPPORT */
+
+    if( ret == 0 )
+    {
+        ret = TestSpacing();
+        printf( "Spacing: %s\n", ret == 0 ? "PASS" : "FAIL" );
+    }
+
+    if( ret == 0 )
+    {
+        ret = TestPriority();
+        printf( "Priority: %s\n", ret == 0 ? "PASS" : "FAIL" );
+    }
+
+    if( ret == 0 )
+    {
+        ret = TestFullQueue();
+        printf( "Full queue: %s\n", ret == 0 ? "PASS" : "FAIL" );
+    }
+
+    /* The pacer task must exit while packets could still be queued. */
+    PeerConnectionPacer_Destroy( &pacer );
+
+    return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,477 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Run the pacer task in kernel pacing mode over a UDP loopback socket with SO_TXTIME, the packets carry their
+ * departure times in SCM_TXTIME like IceController_FlushSendBatch() does. The receiver takes the kernel timestamps
+ * of the packets and checks their spacing against the pacing rate.
+ * The fq qdisc must be on the loopback interface, e.g. "tc qdisc replace dev lo root fq", otherwise the departure
+ * times are ignored and the test is skipped.
+ * Usage: PeerConnectionPacerTxTimeTest */
+
+#ifndef _GNU_SOURCE
+    #define _GNU_SOURCE /* For sendmmsg(). */
+#endif
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <linux/net_tstamp.h>
+#include "logging.h"
+#include "peer_connection_pacer.h"
+#include "networking_utils.h"
+#include "ice_controller.h"
+
+/* The return code ctest takes as skipped, see SKIP_RETURN_CODE in CMake/PeerConnectionTests.cmake. */
+#define PACER_TXTIME_TEST_SKIP_RETURN_CODE ( 77 )
+/* Small enough that the queue doesn't raise the pacing rate, see PEER_CONNECTION_PACER_MAX_QUEUE_TIME_US. */
+#define PACER_TXTIME_TEST_PACKET_NUM ( 100 )
+#define PACER_TXTIME_TEST_PACKET_SIZE ( 1000 )
+#define PACER_TXTIME_TEST_TARGET_BITRATE_BPS ( 1000000 )
+/* A probe packet is sent this far in the future, it must not arrive much earlier if the departure time is honored. */
+#define PACER_TXTIME_TEST_PROBE_DELAY_US ( 50000 )
+#define PACER_TXTIME_TEST_RECEIVE_TIMEOUT_MS ( 5000 )
+/* Slack for the timer of the qdisc and the receive timestamps. */
+#define PACER_TXTIME_TEST_TIMER_SLACK_US ( 1000 )
+#define PACER_TXTIME_TEST_US_PER_SECOND ( 1000000ULL )
+#define PACER_TXTIME_TEST_NS_PER_US ( 1000ULL )
+
+typedef struct PacerTxTimeTestPacket
+{
+    uint8_t * pBuffer;
+    size_t bufferLength;
+    uint64_t departureTimeUs;
+} PacerTxTimeTestPacket_t;
+
+static int sendSocketFd = -1;
+static int receiveSocketFd = -1;
+static struct sockaddr_in receiveAddress;
+static PacerTxTimeTestPacket_t batchPackets[ ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ];
+static size_t batchPacketNum;
+static IceControllerContext_t iceControllerContext;
+static PeerConnectionPacer_t pacer;
+
+static int SendPackets( const PacerTxTimeTestPacket_t * pPackets,
+                        size_t packetNum )
+{
+    int ret = 0;
+    struct mmsghdr messages[ ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ];
+    struct iovec iovecs[ ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ];
+    char controlBuffers[ ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM ][ CMSG_SPACE( sizeof( uint64_t ) ) ];
+    struct cmsghdr * pControlMessage;
+    uint64_t departureTimeNs;
+    size_t sentNum = 0U;
+    int sentCount;
+    size_t i;
+
+    memset( messages, 0, sizeof( messages ) );
+    memset( controlBuffers, 0, sizeof( controlBuffers ) );
+    for( i = 0; i < packetNum; i++ )
+    {
+        iovecs[ i ].iov_base = pPackets[ i ].pBuffer;
+        iovecs[ i ].iov_len = pPackets[ i ].bufferLength;
+        messages[ i ].msg_hdr.msg_name = &receiveAddress;
+        messages[ i ].msg_hdr.msg_namelen = sizeof( receiveAddress );
+        messages[ i ].msg_hdr.msg_iov = &iovecs[ i ];
+        messages[ i ].msg_hdr.msg_iovlen = 1;
+
+        if( pPackets[ i ].departureTimeUs != 0U )
+        {
+            messages[ i ].msg_hdr.msg_control = controlBuffers[ i ];
+            messages[ i ].msg_hdr.msg_controllen = sizeof( controlBuffers[ i ] );
+
+            departureTimeNs = pPackets[ i ].departureTimeUs * PACER_TXTIME_TEST_NS_PER_US;
+            pControlMessage = CMSG_FIRSTHDR( &messages[ i ].msg_hdr );
+            pControlMessage->cmsg_level = SOL_SOCKET;
+            pControlMessage->cmsg_type = SCM_TXTIME;
+            pControlMessage->cmsg_len = CMSG_LEN( sizeof( uint64_t ) );
+            memcpy( CMSG_DATA( pControlMessage ), &departureTimeNs, sizeof( uint64_t ) );
+        }
+    }
+
+    while( sentNum < packetNum )
+    {
+        sentCount = sendmmsg( sendSocketFd,
+                              &messages[ sentNum ],
+                              packetNum - sentNum,
+                              0 );
+        if( sentCount < 0 )
+        {
+            printf( "Fail to send packets, errno(%d): %s\n", errno, strerror( errno ) );
+            ret = -1;
+            break;
+        }
+        sentNum += ( size_t ) sentCount;
+    }
+
+    return ret;
+}
+
+/* The ICE controller of the pacer sends the batch over the loopback socket, the packets are kept in their pacer
+ * slots till the batch is flushed. */
+IceControllerResult_t IceController_AddToSendBatch( IceControllerContext_t * pCtx,
+                                                    IceControllerSendBatch_t * pBatch,
+                                                    uint8_t * pBuffer,
+                                                    size_t bufferLength,
+                                                    uint64_t departureTimeUs )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+
+    if( batchPacketNum == ICE_CONTROLLER_SEND_BATCH_MAX_PACKET_NUM )
+    {
+        ret = IceController_FlushSendBatch( pCtx,
+                                            pBatch );
+    }
+
+    batchPackets[ batchPacketNum ].pBuffer = pBuffer;
+    batchPackets[ batchPacketNum ].bufferLength = bufferLength;
+    batchPackets[ batchPacketNum ].departureTimeUs = departureTimeUs;
+    batchPacketNum++;
+
+    return ret;
+}
+
+IceControllerResult_t IceController_FlushSendBatch( IceControllerContext_t * pCtx,
+                                                    IceControllerSendBatch_t * pBatch )
+{
+    IceControllerResult_t ret = ICE_CONTROLLER_RESULT_OK;
+
+    ( void ) pCtx;
+    ( void ) pBatch;
+
+    if( SendPackets( batchPackets,
+                     batchPacketNum ) != 0 )
+    {
+        ret = ICE_CONTROLLER_RESULT_FAIL;
+    }
+    batchPacketNum = 0U;
+
+    return ret;
+}
+
+uint8_t IceController_IsTxTimeEnabled( IceControllerContext_t * pCtx )
+{
+    ( void ) pCtx;
+
+    return 1U;
+}
+
+#if ENABLE_TWCC_SUPPORT
+    PeerConnectionResult_t PeerConnectionTwccHistory_SetSentTime( PeerConnectionTwccHistory_t * pTwccHistory,
+                                                                  uint16_t transportSequenceNumber,
+                                                                  uint64_t sentTimeUs )
+    {
+        ( void ) pTwccHistory;
+        ( void ) transportSequenceNumber;
+        ( void ) sentTimeUs;
+
+        return PEER_CONNECTION_RESULT_OK;
+    }
+#endif /* ENABLE_TWCC_SUPPORT */
+
+/* Receive one packet with its kernel receive timestamp, return the packet length or -1 on timeout. */
+static int ReceivePacket( uint8_t * pBuffer,
+                          size_t bufferLength,
+                          uint64_t * pReceiveTimeUs )
+{
+    int ret = -1;
+    struct pollfd pollFd;
+    struct msghdr message;
+    struct iovec iov;
+    char controlBuffer[ CMSG_SPACE( sizeof( struct timespec ) ) ];
+    struct cmsghdr * pControlMessage;
+    struct timespec receiveTime;
+
+    pollFd.fd = receiveSocketFd;
+    pollFd.events = POLLIN;
+    pollFd.revents = 0;
+    if( poll( &pollFd, 1, PACER_TXTIME_TEST_RECEIVE_TIMEOUT_MS ) > 0 )
+    {
+        memset( &message, 0, sizeof( message ) );
+        iov.iov_base = pBuffer;
+        iov.iov_len = bufferLength;
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = controlBuffer;
+        message.msg_controllen = sizeof( controlBuffer );
+
+        ret = ( int ) recvmsg( receiveSocketFd, &message, 0 );
+    }
+
+    if( ret >= 0 )
+    {
+        /* The timestamp is on wall clock, only the differences between the packets are used. */
+        *pReceiveTimeUs = 0U;
+        for( pControlMessage = CMSG_FIRSTHDR( &message ); pControlMessage != NULL; pControlMessage = CMSG_NXTHDR( &message, pControlMessage ) )
+        {
+            if( ( pControlMessage->cmsg_level == SOL_SOCKET ) && ( pControlMessage->cmsg_type == SCM_TIMESTAMPNS ) )
+            {
+                memcpy( &receiveTime, CMSG_DATA( pControlMessage ), sizeof( struct timespec ) );
+                *pReceiveTimeUs = ( uint64_t ) receiveTime.tv_sec * PACER_TXTIME_TEST_US_PER_SECOND + ( uint64_t ) receiveTime.tv_nsec / PACER_TXTIME_TEST_NS_PER_US;
+            }
+        }
+
+        if( *pReceiveTimeUs == 0U )
+        {
+            printf( "No receive timestamp on the packet\n" );
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+static int OpenSockets( void )
+{
+    int ret = 0;
+    socklen_t addressLength = sizeof( receiveAddress );
+    struct sock_txtime txTimeConfig;
+    int enable = 1;
+
+    sendSocketFd = socket( AF_INET, SOCK_DGRAM, 0 );
+    receiveSocketFd = socket( AF_INET, SOCK_DGRAM, 0 );
+    if( ( sendSocketFd < 0 ) || ( receiveSocketFd < 0 ) )
+    {
+        printf( "Fail to create sockets, errno(%d): %s\n", errno, strerror( errno ) );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        memset( &receiveAddress, 0, sizeof( receiveAddress ) );
+        receiveAddress.sin_family = AF_INET;
+        receiveAddress.sin_addr.s_addr = htonl( INADDR_LOOPBACK );
+        if( ( bind( receiveSocketFd, ( struct sockaddr * ) &receiveAddress, sizeof( receiveAddress ) ) != 0 ) ||
+            ( getsockname( receiveSocketFd, ( struct sockaddr * ) &receiveAddress, &addressLength ) != 0 ) ||
+            ( setsockopt( receiveSocketFd, SOL_SOCKET, SO_TIMESTAMPNS, &enable, sizeof( enable ) ) != 0 ) )
+        {
+            printf( "Fail to set up receiving socket, errno(%d): %s\n", errno, strerror( errno ) );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        /* Same setting as IceControllerNet_OpenUdpSocket() with ENABLE_KERNEL_PACING. */
+        memset( &txTimeConfig, 0, sizeof( struct sock_txtime ) );
+        txTimeConfig.clockid = CLOCK_MONOTONIC;
+        txTimeConfig.flags = 0;
+        if( setsockopt( sendSocketFd, SOL_SOCKET, SO_TXTIME, &txTimeConfig, sizeof( struct sock_txtime ) ) != 0 )
+        {
+            printf( "SO_TXTIME is not supported, errno(%d): %s, skip\n", errno, strerror( errno ) );
+            ret = PACER_TXTIME_TEST_SKIP_RETURN_CODE;
+        }
+    }
+
+    return ret;
+}
+
+/* Send a packet due in the future, without fq on the interface it arrives right away. */
+static int ProbeDepartureTime( void )
+{
+    int ret = 0;
+    uint8_t packet[ PACER_TXTIME_TEST_PACKET_SIZE ];
+    PacerTxTimeTestPacket_t probePacket;
+    uint64_t sentTimeUs;
+    uint64_t receiveTimeUs;
+    uint64_t delayUs;
+
+    memset( packet, 0, sizeof( packet ) );
+    probePacket.pBuffer = packet;
+    probePacket.bufferLength = sizeof( packet );
+    sentTimeUs = NetworkingUtils_GetCurrentMonotonicTimeUs( NULL );
+    probePacket.departureTimeUs = sentTimeUs + PACER_TXTIME_TEST_PROBE_DELAY_US;
+
+    ret = SendPackets( &probePacket,
+                       1U );
+
+    if( ( ret == 0 ) && ( ReceivePacket( packet, sizeof( packet ), &receiveTimeUs ) < 0 ) )
+    {
+        printf( "Probe packet is lost\n" );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        delayUs = NetworkingUtils_GetCurrentMonotonicTimeUs( NULL ) - sentTimeUs;
+        if( delayUs < PACER_TXTIME_TEST_PROBE_DELAY_US / 2U )
+        {
+            printf( "Packet due in %u us arrived in %lu us, the departure time is ignored, add the fq qdisc to lo to run the test, skip\n",
+                    PACER_TXTIME_TEST_PROBE_DELAY_US, delayUs );
+            ret = PACER_TXTIME_TEST_SKIP_RETURN_CODE;
+        }
+    }
+
+    return ret;
+}
+
+/* The kernel sends the packets at their departure times, no window of packets arrives faster than the pacing rate
+ * allows plus the packet at each end and the timer slack. */
+static int TestSpacing( void )
+{
+    int ret = 0;
+    const uint64_t pacingBitrateBps = ( uint64_t ) PACER_TXTIME_TEST_TARGET_BITRATE_BPS * PEER_CONNECTION_PACER_PACING_FACTOR_PERCENT / 100U;
+    const uint64_t packetBits = PACER_TXTIME_TEST_PACKET_SIZE * 8U;
+    static uint64_t receiveTimesUs[ PACER_TXTIME_TEST_PACKET_NUM ];
+    uint8_t packet[ PACER_TXTIME_TEST_PACKET_SIZE ];
+    uint32_t index;
+    uint64_t windowBits;
+    uint64_t allowedBits;
+    uint64_t durationUs;
+    uint64_t expectedDurationUs;
+    uint32_t i;
+    uint32_t j;
+
+    if( PeerConnectionPacer_Start( &pacer,
+                                   PACER_TXTIME_TEST_TARGET_BITRATE_BPS ) != PEER_CONNECTION_RESULT_OK )
+    {
+        printf( "Fail to start pacer\n" );
+        ret = -1;
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < PACER_TXTIME_TEST_PACKET_NUM ); i++ )
+    {
+        memset( packet, 0, sizeof( packet ) );
+        memcpy( packet,
+                &i,
+                sizeof( uint32_t ) );
+        if( PeerConnectionPacer_EnqueuePacket( &pacer,
+                                               PEER_CONNECTION_PACER_PRIORITY_VIDEO,
+                                               packet,
+                                               sizeof( packet ),
+                                               0U,
+                                               0U ) != PEER_CONNECTION_RESULT_OK )
+        {
+            printf( "Fail to enqueue packet %u\n", i );
+            ret = -1;
+        }
+    }
+
+    /* The loopback keeps the order, a packet out of place means the kernel sent it at a wrong time. */
+    for( i = 0; ( ret == 0 ) && ( i < PACER_TXTIME_TEST_PACKET_NUM ); i++ )
+    {
+        if( ReceivePacket( packet, sizeof( packet ), &receiveTimesUs[ i ] ) < 0 )
+        {
+            printf( "Only %u of %u packets received\n", i, PACER_TXTIME_TEST_PACKET_NUM );
+            ret = -1;
+        }
+        else
+        {
+            memcpy( &index,
+                    packet,
+                    sizeof( uint32_t ) );
+            if( index != i )
+            {
+                printf( "Packet %u received at position %u\n", index, i );
+                ret = -1;
+            }
+        }
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < PACER_TXTIME_TEST_PACKET_NUM ); i++ )
+    {
+        windowBits = 0U;
+        for( j = i; j < PACER_TXTIME_TEST_PACKET_NUM; j++ )
+        {
+            windowBits += packetBits;
+            allowedBits = pacingBitrateBps * ( receiveTimesUs[ j ] - receiveTimesUs[ i ] + PACER_TXTIME_TEST_TIMER_SLACK_US ) / PACER_TXTIME_TEST_US_PER_SECOND + 2U * packetBits;
+            if( windowBits > allowedBits )
+            {
+                printf( "Packets %u to %u arrived %lu bits in %lu us, allowed: %lu bits\n",
+                        i, j, windowBits, receiveTimesUs[ j ] - receiveTimesUs[ i ], allowedBits );
+                ret = -1;
+                break;
+            }
+        }
+    }
+
+    if( ret == 0 )
+    {
+        durationUs = receiveTimesUs[ PACER_TXTIME_TEST_PACKET_NUM - 1 ] - receiveTimesUs[ 0 ];
+        expectedDurationUs = ( PACER_TXTIME_TEST_PACKET_NUM - 1U ) * packetBits * PACER_TXTIME_TEST_US_PER_SECOND / pacingBitrateBps;
+        printf( "Spacing: %u packets of %u bytes at %lu bps arrived in %lu us, expected %lu us\n",
+                PACER_TXTIME_TEST_PACKET_NUM, PACER_TXTIME_TEST_PACKET_SIZE, pacingBitrateBps, durationUs, expectedDurationUs );
+
+        if( durationUs > 2U * expectedDurationUs )
+        {
+            printf( "The packets arrived too slowly for the pacing rate\n" );
+            ret = -1;
+        }
+    }
+
+    PeerConnectionPacer_Reset( &pacer );
+
+    return ret;
+}
+
+int main( void )
+{
+    int ret;
+
+    ret = OpenSockets();
+
+    if( ret == 0 )
+    {
+        ret = ProbeDepartureTime();
+    }
+
+    if( ( ret == 0 ) &&
+        ( PeerConnectionPacer_Create( &pacer,
+                                      &iceControllerContext ) != PEER_CONNECTION_RESULT_OK ) )
+    {
+        printf( "Fail to create pacer\n" );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        ret = TestSpacing();
+        printf( "Kernel pacing spacing: %s\n", ret == 0 ? "PASS" : "FAIL" );
+    }
+
+    /* Stop the pacer before closing the socket it sends through. */
+    PeerConnectionPacer_Destroy( &pacer );
+
+    if( sendSocketFd >= 0 )
+    {
+        ( void ) close( sendSocketFd );
+    }
+
+    if( receiveSocketFd >= 0 )
+    {
+        ( void ) close( receiveSocketFd );
+    }
+
+    if( ret == PACER_TXTIME_TEST_SKIP_RETURN_CODE )
+    {
+        /* Keep the skip code for ctest. */
+    }
+    else if( ret != 0 )
+    {
+        ret = 1;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return ret;
+}
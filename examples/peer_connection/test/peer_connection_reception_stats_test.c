@@ -0,0 +1,449 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Feed the RFC 3550 reception statistics with known sequences of RTP packets and check the reception report blocks.
+ * Usage: PeerConnectionReceptionStatsTest */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_reception_stats.h"
+
+#define RECEPTION_STATS_TEST_SSRC ( 0x12345678U )
+#define RECEPTION_STATS_TEST_VIDEO_CLOCK_RATE ( 90000U )
+#define RECEPTION_STATS_TEST_AUDIO_CLOCK_RATE ( 48000U )
+#define RECEPTION_STATS_TEST_PACKET_INTERVAL_US ( 20000U )
+#define RECEPTION_STATS_TEST_START_TIME_US ( 1000000U )
+
+static PeerConnectionReceptionStats_t receptionStats;
+
+static int Receive( uint32_t ssrc,
+                    uint16_t rtpSeq,
+                    uint32_t rtpTimestamp,
+                    uint32_t clockRate,
+                    uint64_t receiveTimeUs )
+{
+    int ret = 0;
+
+    if( PeerConnectionReceptionStats_OnPacketReceived( &receptionStats,
+                                                       ssrc,
+                                                       rtpSeq,
+                                                       rtpTimestamp,
+                                                       clockRate,
+                                                       receiveTimeUs ) != PEER_CONNECTION_RESULT_OK )
+    {
+        printf( "Fail to record seq: %u\n", rtpSeq );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Receive the sequence numbers in [ firstSeq, firstSeq + count ), skipping one in every skipInterval of them if it's not 0.
+ * The first and the last ones are always received. */
+static int ReceiveRange( uint16_t firstSeq,
+                         uint32_t count,
+                         uint32_t skipInterval )
+{
+    int ret = 0;
+    uint32_t i;
+
+    for( i = 0; ( ret == 0 ) && ( i < count ); i++ )
+    {
+        if( ( skipInterval == 0U ) || ( ( i % skipInterval ) != 1U ) )
+        {
+            ret = Receive( RECEPTION_STATS_TEST_SSRC,
+                           ( uint16_t )( firstSeq + i ),
+                           0U,
+                           0U,
+                           0U );
+        }
+    }
+
+    return ret;
+}
+
+static int CheckReport( const char * pName,
+                        uint64_t currentTimeUs,
+                        uint8_t fractionLost,
+                        uint32_t cumulativePacketsLost,
+                        uint32_t extendedHighestSeqNum )
+{
+    int ret = 0;
+    RtcpReceptionReport_t receptionReport;
+
+    memset( &receptionReport, 0, sizeof( RtcpReceptionReport_t ) );
+    if( PeerConnectionReceptionStats_GetReceptionReport( &receptionStats,
+                                                         currentTimeUs,
+                                                         &receptionReport ) != PEER_CONNECTION_RESULT_OK )
+    {
+        printf( "%s: fail to get the reception report\n", pName );
+        ret = -1;
+    }
+    else if( ( receptionReport.sourceSsrc != RECEPTION_STATS_TEST_SSRC ) ||
+             ( receptionReport.fractionLost != fractionLost ) ||
+             ( receptionReport.cumulativePacketsLost != cumulativePacketsLost ) ||
+             ( receptionReport.extendedHighestSeqNumReceived != extendedHighestSeqNum ) )
+    {
+        printf( "%s: SSRC: 0x%08X, fraction lost: %u, cumulative lost: 0x%06X, extended highest seq: %u, "
+                "expected fraction lost: %u, cumulative lost: 0x%06X, extended highest seq: %u\n",
+                pName,
+                receptionReport.sourceSsrc,
+                receptionReport.fractionLost,
+                receptionReport.cumulativePacketsLost,
+                receptionReport.extendedHighestSeqNumReceived,
+                fractionLost,
+                cumulativePacketsLost,
+                extendedHighestSeqNum );
+        ret = -1;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return ret;
+}
+
+static int ResetStats( void )
+{
+    int ret = 0;
+    RtcpReceptionReport_t receptionReport;
+
+    if( PeerConnectionReceptionStats_Init( &receptionStats ) != PEER_CONNECTION_RESULT_OK )
+    {
+        printf( "Fail to initialize the reception statistics\n" );
+        ret = -1;
+    }
+    else if( PeerConnectionReceptionStats_GetReceptionReport( &receptionStats,
+                                                              0U,
+                                                              &receptionReport ) != PEER_CONNECTION_RESULT_NO_RECEPTION_STATS )
+    {
+        printf( "A reception report is made before any packet is received\n" );
+        ret = -1;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
+
+    return ret;
+}
+
+/* One in every 10 packets is lost, then an interval without loss reports no fraction lost but keeps the cumulative count. */
+static int TestLoss( void )
+{
+    int ret = ResetStats();
+
+    if( ret == 0 )
+    {
+        ret = ReceiveRange( 1000U, 100U, 10U );
+    }
+
+    if( ret == 0 )
+    {
+        /* 10 of 100 lost is 25 / 256. */
+        ret = CheckReport( "Loss", 0U, 25U, 10U, 1099U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = ReceiveRange( 1100U, 50U, 0U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckReport( "No loss after loss", 0U, 0U, 10U, 1149U );
+    }
+
+    return ret;
+}
+
+/* The sequence number wraps, the extended highest sequence number counts the cycle. */
+static int TestWrap( void )
+{
+    int ret = ResetStats();
+
+    if( ret == 0 )
+    {
+        /* 65500 ~ 65535 and 0 ~ 99, one in every 40 of them is lost. */
+        ret = ReceiveRange( 65500U, 136U, 40U );
+    }
+
+    if( ret == 0 )
+    {
+        /* 4 of 136 lost is 7 / 256. */
+        ret = CheckReport( "Wrap", 0U, 7U, 4U, 65536U + 99U );
+    }
+
+    return ret;
+}
+
+/* Duplicates count as received like RFC 3550 does, the cumulative lost goes negative and the fraction lost stays 0.
+ * A reordered packet is not a loss. */
+static int TestDuplicates( void )
+{
+    int ret = ResetStats();
+
+    if( ret == 0 )
+    {
+        ret = ReceiveRange( 1U, 18U, 0U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = Receive( RECEPTION_STATS_TEST_SSRC, 20U, 0U, 0U, 0U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = Receive( RECEPTION_STATS_TEST_SSRC, 19U, 0U, 0U, 0U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckReport( "Reordered", 0U, 0U, 0U, 20U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = ReceiveRange( 5U, 2U, 0U );
+    }
+
+    if( ret == 0 )
+    {
+        /* -2 in the signed 24-bit field. */
+        ret = CheckReport( "Duplicates", 0U, 0U, 0xFFFFFEU, 20U );
+    }
+
+    return ret;
+}
+
+/* A single packet far off the sequence is ignored. Two sequential ones far off mean the sender restarted,
+ * the statistics start over from them. A new SSRC starts over too. */
+static int TestRestart( void )
+{
+    int ret = ResetStats();
+
+    if( ret == 0 )
+    {
+        ret = ReceiveRange( 100U, 50U, 0U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = Receive( RECEPTION_STATS_TEST_SSRC, 30000U, 0U, 0U, 0U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = ReceiveRange( 150U, 10U, 0U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckReport( "Stray packet", 0U, 0U, 0U, 159U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = ReceiveRange( 40000U, 10U, 0U );
+    }
+
+    if( ret == 0 )
+    {
+        /* 40000 is not counted, the statistics start from 40001. */
+        ret = CheckReport( "Restart", 0U, 0U, 0U, 40009U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = ReceiveRange( 40012U, 8U, 0U );
+    }
+
+    if( ret == 0 )
+    {
+        /* 40010 and 40011 of 40001 ~ 40019 are lost. */
+        ret = CheckReport( "Loss after restart", 0U, 2U * 256U / 10U, 2U, 40019U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = Receive( RECEPTION_STATS_TEST_SSRC + 1U, 7U, 0U, 0U, 0U );
+    }
+
+    if( ( ret == 0 ) &&
+        ( ( receptionStats.ssrc != RECEPTION_STATS_TEST_SSRC + 1U ) ||
+          ( receptionStats.maxSequenceNumber != 7U ) ||
+          ( receptionStats.receivedPacketCount != 1U ) ) )
+    {
+        printf( "New SSRC: the statistics don't start over, max seq: %u, received: %u\n",
+                receptionStats.maxSequenceNumber, receptionStats.receivedPacketCount );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Every other packet arrives 1 ms late, the transit time changes by 1 ms on every packet.
+ * The jitter converges to 1 ms in RTP timestamp units, i.e. it's scaled by the clock rate. A steady stream has no jitter. */
+static int TestJitter( uint32_t clockRate )
+{
+    int ret = ResetStats();
+    RtcpReceptionReport_t receptionReport;
+    uint32_t expectedJitter = clockRate / 1000U;
+    uint32_t rtpTimestampStep = clockRate * RECEPTION_STATS_TEST_PACKET_INTERVAL_US / 1000000U;
+    uint64_t receiveTimeUs;
+    uint32_t i;
+
+    for( i = 0; ( ret == 0 ) && ( i < 500U ); i++ )
+    {
+        receiveTimeUs = RECEPTION_STATS_TEST_START_TIME_US + ( uint64_t ) i * RECEPTION_STATS_TEST_PACKET_INTERVAL_US + ( ( i % 2U ) * 1000U );
+        ret = Receive( RECEPTION_STATS_TEST_SSRC,
+                       ( uint16_t ) i,
+                       0x80000000U + i * rtpTimestampStep,
+                       clockRate,
+                       receiveTimeUs );
+    }
+
+    if( ( ret == 0 ) &&
+        ( PeerConnectionReceptionStats_GetReceptionReport( &receptionStats,
+                                                           0U,
+                                                           &receptionReport ) != PEER_CONNECTION_RESULT_OK ) )
+    {
+        ret = -1;
+    }
+
+    if( ( ret == 0 ) &&
+        ( ( receptionReport.interArrivalJitter + 2U < expectedJitter ) || ( receptionReport.interArrivalJitter > expectedJitter ) ) )
+    {
+        printf( "Jitter at %u Hz: %u, expected %u\n", clockRate, receptionReport.interArrivalJitter, expectedJitter );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        ret = ResetStats();
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < 100U ); i++ )
+    {
+        ret = Receive( RECEPTION_STATS_TEST_SSRC,
+                       ( uint16_t ) i,
+                       i * rtpTimestampStep,
+                       clockRate,
+                       RECEPTION_STATS_TEST_START_TIME_US + ( uint64_t ) i * RECEPTION_STATS_TEST_PACKET_INTERVAL_US );
+    }
+
+    if( ( ret == 0 ) &&
+        ( ( PeerConnectionReceptionStats_GetReceptionReport( &receptionStats,
+                                                             0U,
+                                                             &receptionReport ) != PEER_CONNECTION_RESULT_OK ) ||
+          ( receptionReport.interArrivalJitter != 0U ) ) )
+    {
+        printf( "Jitter of a steady stream at %u Hz: %u\n", clockRate, receptionReport.interArrivalJitter );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* LSR is the middle 32 bits of the NTP timestamp of the last sender report, DLSR the time since it in 1/65536 s. */
+static int TestSenderReport( void )
+{
+    int ret = ResetStats();
+    RtcpReceptionReport_t receptionReport;
+    /* 0x83AA7E80 seconds and a quarter. */
+    const uint64_t ntpTime = 0x83AA7E8040000000ULL;
+    const uint64_t senderReportReceiveTimeUs = 5000000U;
+
+    if( ret == 0 )
+    {
+        ret = ReceiveRange( 1U, 10U, 0U );
+    }
+
+    if( ( ret == 0 ) &&
+        ( ( PeerConnectionReceptionStats_GetReceptionReport( &receptionStats,
+                                                             senderReportReceiveTimeUs,
+                                                             &receptionReport ) != PEER_CONNECTION_RESULT_OK ) ||
+          ( receptionReport.lastSR != 0U ) ||
+          ( receptionReport.delaySinceLastSR != 0U ) ) )
+    {
+        printf( "No sender report: LSR: 0x%08X, DLSR: %u\n", receptionReport.lastSR, receptionReport.delaySinceLastSR );
+        ret = -1;
+    }
+
+    if( ( ret == 0 ) &&
+        ( PeerConnectionReceptionStats_OnSenderReport( &receptionStats,
+                                                       ntpTime,
+                                                       senderReportReceiveTimeUs ) != PEER_CONNECTION_RESULT_OK ) )
+    {
+        printf( "Fail to record the sender report\n" );
+        ret = -1;
+    }
+
+    if( ( ret == 0 ) &&
+        ( ( PeerConnectionReceptionStats_GetReceptionReport( &receptionStats,
+                                                             senderReportReceiveTimeUs + 1500000U,
+                                                             &receptionReport ) != PEER_CONNECTION_RESULT_OK ) ||
+          ( receptionReport.lastSR != 0x7E804000U ) ||
+          ( receptionReport.delaySinceLastSR != 98304U ) ) )
+    {
+        /* 1.5 s is 98304 / 65536 s. */
+        printf( "Sender report: LSR: 0x%08X, DLSR: %u, expected LSR: 0x7E804000, DLSR: 98304\n",
+                receptionReport.lastSR, receptionReport.delaySinceLastSR );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int main( void )
+{
+    int ret = 0;
+    int result;
+
+    result = TestLoss();
+    printf( "Loss: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestWrap();
+    printf( "Wrap: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestDuplicates();
+    printf( "Duplicates: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestRestart();
+    printf( "Restart: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestJitter( RECEPTION_STATS_TEST_VIDEO_CLOCK_RATE );
+    printf( "Video jitter: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestJitter( RECEPTION_STATS_TEST_AUDIO_CLOCK_RATE );
+    printf( "Audio jitter: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestSenderReport();
+    printf( "Sender report: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    return ret == 0 ? 0 : 1;
+}
@@ -0,0 +1,523 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Record known arrival patterns into the transport-cc feedback and check the serialized RTCP packets byte by byte.
+ * The arrival times are multiples of the 250 us delta unit, and the first one of every pattern is on a 64 ms reference time,
+ * so the expected deltas can be written down directly.
+ * Usage: PeerConnectionTwccFeedbackTest */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_twcc_feedback.h"
+
+#if ENABLE_TWCC_SUPPORT
+
+#define TWCC_FEEDBACK_TEST_SENDER_SSRC ( 0x11223344U )
+#define TWCC_FEEDBACK_TEST_MEDIA_SSRC ( 0x55667788U )
+#define TWCC_FEEDBACK_TEST_REFERENCE_TIME_UNIT_US ( 64000U )
+#define TWCC_FEEDBACK_TEST_DELTA_UNIT_US ( 250U )
+
+/* The header fields of the feedback packets, the SSRCs are always the test ones. */
+#define TWCC_FEEDBACK_TEST_HEADER( hasPadding, lengthInWords, baseSeq, statusCount, referenceTime, feedbackCount ) \
+    ( uint8_t )( 0x8F | ( ( hasPadding ) ? 0x20 : 0x00 ) ), 205,                                                  \
+    ( uint8_t )( ( lengthInWords ) >> 8 ), ( uint8_t )( lengthInWords ),                                           \
+    0x11, 0x22, 0x33, 0x44,                                                                                        \
+    0x55, 0x66, 0x77, 0x88,                                                                                        \
+    ( uint8_t )( ( baseSeq ) >> 8 ), ( uint8_t )( baseSeq ),                                                       \
+    ( uint8_t )( ( statusCount ) >> 8 ), ( uint8_t )( statusCount ),                                               \
+    ( uint8_t )( ( referenceTime ) >> 16 ), ( uint8_t )( ( referenceTime ) >> 8 ), ( uint8_t )( referenceTime ),   \
+    ( uint8_t )( feedbackCount )
+
+static uint8_t feedbackPacket[ PEER_CONNECTION_TWCC_FEEDBACK_RTCP_PACKET_MAX_LENGTH ];
+
+static uint16_t ReadUint16( const uint8_t * pBuffer )
+{
+    return ( uint16_t )( ( pBuffer[ 0 ] << 8 ) | pBuffer[ 1 ] );
+}
+
+static int CreateFeedback( PeerConnectionTwccFeedback_t * pTwccFeedback )
+{
+    int ret = 0;
+
+    if( PeerConnectionTwccFeedback_Init( pTwccFeedback ) != PEER_CONNECTION_RESULT_OK )
+    {
+        printf( "Fail to initialize the TWCC feedback\n" );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+static int Record( PeerConnectionTwccFeedback_t * pTwccFeedback,
+                   uint16_t transportSequenceNumber,
+                   uint64_t arrivalTimeUs )
+{
+    int ret = 0;
+
+    if( PeerConnectionTwccFeedback_RecordPacket( pTwccFeedback,
+                                                 transportSequenceNumber,
+                                                 arrivalTimeUs ) != PEER_CONNECTION_RESULT_OK )
+    {
+        printf( "Fail to record seq: %u\n", transportSequenceNumber );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+static size_t Serialize( PeerConnectionTwccFeedback_t * pTwccFeedback )
+{
+    size_t length = sizeof( feedbackPacket );
+
+    if( PeerConnectionTwccFeedback_SerializePacket( pTwccFeedback,
+                                                    TWCC_FEEDBACK_TEST_SENDER_SSRC,
+                                                    TWCC_FEEDBACK_TEST_MEDIA_SSRC,
+                                                    feedbackPacket,
+                                                    &length ) != PEER_CONNECTION_RESULT_OK )
+    {
+        printf( "Fail to serialize the feedback\n" );
+        length = 0U;
+    }
+
+    return length;
+}
+
+static int CheckPacket( const char * pName,
+                        size_t length,
+                        const uint8_t * pExpected,
+                        size_t expectedLength )
+{
+    int ret = 0;
+    size_t i;
+
+    if( ( length != expectedLength ) ||
+        ( memcmp( feedbackPacket, pExpected, expectedLength ) != 0 ) )
+    {
+        printf( "%s: serialized %lu bytes, expected %lu bytes\n", pName, length, expectedLength );
+        for( i = 0; i < length; i++ )
+        {
+            printf( "%02X%s", feedbackPacket[ i ], ( ( i + 1U ) % 4U == 0U ) ? "\n" : " " );
+        }
+        printf( "\nExpected:\n" );
+        for( i = 0; i < expectedLength; i++ )
+        {
+            printf( "%02X%s", pExpected[ i ], ( ( i + 1U ) % 4U == 0U ) ? "\n" : " " );
+        }
+        printf( "\n" );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* 20 packets received 1 ms apart form a run of small deltas. */
+static int TestRunLength( void )
+{
+    static PeerConnectionTwccFeedback_t twccFeedback;
+    const uint8_t expected[] = {
+        TWCC_FEEDBACK_TEST_HEADER( 1, 10, 100, 20, 10, 0 ),
+        0x20, 0x14,     /* Run of 20 small deltas. */
+        0, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4,
+        0x00, 0x02     /* Padding. */
+    };
+    int ret = CreateFeedback( &twccFeedback );
+    uint16_t i;
+
+    for( i = 0; ( ret == 0 ) && ( i < 20U ); i++ )
+    {
+        ret = Record( &twccFeedback,
+                      ( uint16_t )( 100U + i ),
+                      10U * TWCC_FEEDBACK_TEST_REFERENCE_TIME_UNIT_US + i * 1000U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPacket( "Run length",
+                           Serialize( &twccFeedback ),
+                           expected,
+                           sizeof( expected ) );
+    }
+
+    return ret;
+}
+
+/* Two losses break the run, the statuses fit a vector of 14 one-bit symbols. */
+static int TestOneBitVector( void )
+{
+    static PeerConnectionTwccFeedback_t twccFeedback;
+    const uint8_t expected[] = {
+        TWCC_FEEDBACK_TEST_HEADER( 1, 7, 200, 10, 5, 0 ),
+        0xBB, 0xB0,     /* 1110 1110 11 */
+        0, 2, 2, 4, 2, 2, 4, 2,
+        0x00, 0x02
+    };
+    int ret = CreateFeedback( &twccFeedback );
+    uint16_t i;
+
+    for( i = 0; ( ret == 0 ) && ( i < 10U ); i++ )
+    {
+        if( ( i != 3U ) && ( i != 7U ) )
+        {
+            ret = Record( &twccFeedback,
+                          ( uint16_t )( 200U + i ),
+                          5U * TWCC_FEEDBACK_TEST_REFERENCE_TIME_UNIT_US + i * 500U );
+        }
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPacket( "One-bit vector",
+                           Serialize( &twccFeedback ),
+                           expected,
+                           sizeof( expected ) );
+    }
+
+    return ret;
+}
+
+/* A 100 ms gap and a reordered packet need large deltas, the statuses take a vector of 7 two-bit symbols. */
+static int TestTwoBitVector( void )
+{
+    static PeerConnectionTwccFeedback_t twccFeedback;
+    const uint8_t expected[] = {
+        TWCC_FEEDBACK_TEST_HEADER( 1, 7, 300, 5, 3, 0 ),
+        0xD6, 0x60,     /* small, small, large, small, large */
+        0,
+        4,
+        0x01, 0x90,     /* 400 units. */
+        4,
+        0xFF, 0xFE,     /* -2 units. */
+        0x00, 0x00, 0x03
+    };
+    const uint64_t baseTimeUs = 3U * TWCC_FEEDBACK_TEST_REFERENCE_TIME_UNIT_US;
+    int ret = CreateFeedback( &twccFeedback );
+
+    if( ret == 0 )
+    {
+        ret = Record( &twccFeedback, 300U, baseTimeUs );
+    }
+
+    if( ret == 0 )
+    {
+        ret = Record( &twccFeedback, 301U, baseTimeUs + 1000U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = Record( &twccFeedback, 302U, baseTimeUs + 101000U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = Record( &twccFeedback, 303U, baseTimeUs + 102000U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = Record( &twccFeedback, 304U, baseTimeUs + 101500U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPacket( "Two-bit vector",
+                           Serialize( &twccFeedback ),
+                           expected,
+                           sizeof( expected ) );
+    }
+
+    return ret;
+}
+
+/* A 10 s gap is out of the range of a large delta, the packet after it is reported in the next feedback on its own reference time. */
+static int TestUnrepresentableDelta( void )
+{
+    static PeerConnectionTwccFeedback_t twccFeedback;
+    const uint8_t expectedFirst[] = {
+        TWCC_FEEDBACK_TEST_HEADER( 1, 5, 400, 1, 2, 0 ),
+        0xA0, 0x00,     /* One small delta. */
+        0,
+        0x01
+    };
+    const uint8_t expectedSecond[] = {
+        TWCC_FEEDBACK_TEST_HEADER( 1, 5, 401, 1, 158, 1 ),
+        0xA0, 0x00,
+        64,     /* 10128 ms is 16 ms past the reference time of 158 * 64 ms. */
+        0x01
+    };
+    int ret = CreateFeedback( &twccFeedback );
+
+    if( ret == 0 )
+    {
+        ret = Record( &twccFeedback, 400U, 2U * TWCC_FEEDBACK_TEST_REFERENCE_TIME_UNIT_US );
+    }
+
+    if( ret == 0 )
+    {
+        ret = Record( &twccFeedback, 401U, 2U * TWCC_FEEDBACK_TEST_REFERENCE_TIME_UNIT_US + 10000000U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPacket( "Unrepresentable delta, first feedback",
+                           Serialize( &twccFeedback ),
+                           expectedFirst,
+                           sizeof( expectedFirst ) );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPacket( "Unrepresentable delta, second feedback",
+                           Serialize( &twccFeedback ),
+                           expectedSecond,
+                           sizeof( expectedSecond ) );
+    }
+
+    return ret;
+}
+
+/* A packet a full window ahead of the oldest unreported one drops the oldest records.
+ * The 1024 remaining statuses take 4 feedbacks of 256, the received packet is the last one. */
+static int TestWindowOverflow( void )
+{
+    static PeerConnectionTwccFeedback_t twccFeedback;
+    const uint64_t arrivalTimeUs = 7U * TWCC_FEEDBACK_TEST_REFERENCE_TIME_UNIT_US + 2500U;
+    const uint16_t newestSeq = 1000U + PEER_CONNECTION_TWCC_FEEDBACK_WINDOW_SIZE + 10U;
+    const uint16_t baseSeq = newestSeq - PEER_CONNECTION_TWCC_FEEDBACK_WINDOW_SIZE + 1U;
+    const uint8_t expectedLost[] = {
+        TWCC_FEEDBACK_TEST_HEADER( 1, 5, baseSeq, 256, 7, 0 ),
+        0x01, 0x00,     /* Run of 256 not received. */
+        0x00, 0x02
+    };
+    const uint8_t expectedLast[] = {
+        TWCC_FEEDBACK_TEST_HEADER( 1, 6, baseSeq + 768U, 256, 7, 3 ),
+        0x00, 0xFF,     /* Run of 255 not received. */
+        0xA0, 0x00,     /* One small delta. */
+        10,
+        0x00, 0x00, 0x03
+    };
+    size_t length;
+    int ret = CreateFeedback( &twccFeedback );
+    int i;
+
+    if( ret == 0 )
+    {
+        ret = Record( &twccFeedback, 1000U, arrivalTimeUs - 1000U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = Record( &twccFeedback, newestSeq, arrivalTimeUs );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPacket( "Window overflow, first feedback",
+                           Serialize( &twccFeedback ),
+                           expectedLost,
+                           sizeof( expectedLost ) );
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < 2 ); i++ )
+    {
+        length = Serialize( &twccFeedback );
+        if( ( length != sizeof( expectedLost ) ) ||
+            ( ReadUint16( &feedbackPacket[ 12 ] ) != ( uint16_t )( baseSeq + 256U * ( i + 1 ) ) ) ||
+            ( ReadUint16( &feedbackPacket[ 20 ] ) != 0x0100U ) )
+        {
+            printf( "Window overflow, feedback %d: unexpected length: %lu, base seq: %u\n",
+                    i + 2, length, ReadUint16( &feedbackPacket[ 12 ] ) );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPacket( "Window overflow, last feedback",
+                           Serialize( &twccFeedback ),
+                           expectedLast,
+                           sizeof( expectedLast ) );
+    }
+
+    if( ( ret == 0 ) && ( Serialize( &twccFeedback ) != 0U ) )
+    {
+        printf( "Window overflow: feedback left after all statuses are reported\n" );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* A packet arriving after its feedback was sent has been reported as lost already, it's not reported again. */
+static int TestLatePacket( void )
+{
+    static PeerConnectionTwccFeedback_t twccFeedback;
+    const uint8_t expected[] = {
+        TWCC_FEEDBACK_TEST_HEADER( 1, 5, 505, 1, 1, 1 ),
+        0xA0, 0x00,
+        8,
+        0x01
+    };
+    size_t length;
+    int ret = CreateFeedback( &twccFeedback );
+    uint16_t i;
+
+    for( i = 500U; ( ret == 0 ) && ( i < 505U ); i++ )
+    {
+        if( i != 503U )
+        {
+            ret = Record( &twccFeedback, i, TWCC_FEEDBACK_TEST_REFERENCE_TIME_UNIT_US + ( i - 500U ) * 250U );
+        }
+    }
+
+    if( ret == 0 )
+    {
+        length = Serialize( &twccFeedback );
+        if( ( length == 0U ) ||
+            ( ReadUint16( &feedbackPacket[ 14 ] ) != 5U ) )
+        {
+            printf( "Late packet: unexpected first feedback, length: %lu\n", length );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        ret = Record( &twccFeedback, 503U, TWCC_FEEDBACK_TEST_REFERENCE_TIME_UNIT_US + 1500U );
+    }
+
+    if( ret == 0 )
+    {
+        length = Serialize( &twccFeedback );
+        if( length != 0U )
+        {
+            printf( "Late packet: the late packet is reported again, length: %lu\n", length );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        ret = Record( &twccFeedback, 505U, TWCC_FEEDBACK_TEST_REFERENCE_TIME_UNIT_US + 2000U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPacket( "Late packet",
+                           Serialize( &twccFeedback ),
+                           expected,
+                           sizeof( expected ) );
+    }
+
+    return ret;
+}
+
+/* The statuses continue across the wrap of the transport-wide sequence number.
+ * 20 + 2 + 6 bytes is 32-bit aligned, so the packet has no padding. */
+static int TestSequenceWrap( void )
+{
+    static PeerConnectionTwccFeedback_t twccFeedback;
+    const uint8_t expectedWrap[] = {
+        TWCC_FEEDBACK_TEST_HEADER( 0, 6, 65533, 6, 4, 0 ),
+        0xBF, 0x00,     /* Six small deltas. */
+        0, 1, 1, 1, 1, 1
+    };
+    const uint8_t expectedAfterWrap[] = {
+        TWCC_FEEDBACK_TEST_HEADER( 1, 5, 3, 1, 4, 1 ),
+        0xA0, 0x00,
+        11,
+        0x01
+    };
+    int ret = CreateFeedback( &twccFeedback );
+    uint16_t seq = 65533U;
+    uint16_t i;
+
+    for( i = 0; ( ret == 0 ) && ( i < 6U ); i++ )
+    {
+        ret = Record( &twccFeedback, seq++, 4U * TWCC_FEEDBACK_TEST_REFERENCE_TIME_UNIT_US + i * TWCC_FEEDBACK_TEST_DELTA_UNIT_US );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPacket( "Sequence wrap",
+                           Serialize( &twccFeedback ),
+                           expectedWrap,
+                           sizeof( expectedWrap ) );
+    }
+
+    if( ret == 0 )
+    {
+        ret = Record( &twccFeedback, seq, 4U * TWCC_FEEDBACK_TEST_REFERENCE_TIME_UNIT_US + 11U * TWCC_FEEDBACK_TEST_DELTA_UNIT_US );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPacket( "After sequence wrap",
+                           Serialize( &twccFeedback ),
+                           expectedAfterWrap,
+                           sizeof( expectedAfterWrap ) );
+    }
+
+    return ret;
+}
+
+int main( void )
+{
+    int ret = 0;
+    int result;
+
+    result = TestRunLength();
+    printf( "Run length: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestOneBitVector();
+    printf( "One-bit vector: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestTwoBitVector();
+    printf( "Two-bit vector: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestUnrepresentableDelta();
+    printf( "Unrepresentable delta: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestWindowOverflow();
+    printf( "Window overflow: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestLatePacket();
+    printf( "Late packet: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestSequenceWrap();
+    printf( "Sequence wrap: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    return ret == 0 ? 0 : 1;
+}
+
+#else /* ENABLE_TWCC_SUPPORT */
+
+int main( void )
+{
+    printf( "ENABLE_TWCC_SUPPORT is disabled, skip the TWCC feedback test.\n" );
+
+    return 0;
+}
+
+#endif /* ENABLE_TWCC_SUPPORT */
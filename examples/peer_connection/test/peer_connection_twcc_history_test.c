@@ -0,0 +1,510 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Record sent packets into the TWCC history ring, then look them up and account transport-cc feedback against them
+ * like the SRTCP receiver does.
+ * Usage: PeerConnectionTwccHistoryTest */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include "logging.h"
+#include "peer_connection_twcc_history.h"
+#include "peer_connection_bandwidth_estimator.h"
+
+#if ENABLE_TWCC_SUPPORT
+
+#define TWCC_HISTORY_TEST_LENGTH ( 8 )
+#define TWCC_HISTORY_TEST_START_TIME_US ( 1000000U )
+#define TWCC_HISTORY_TEST_SEND_INTERVAL_US ( 1000U )
+#define TWCC_HISTORY_TEST_BASE_DELAY_US ( 30000U )
+#define TWCC_HISTORY_TEST_PACKET_SIZE ( 1000U )
+/* The feedback reports the arrival times in 100 ns units, the same unit as the duration. */
+#define TWCC_HISTORY_TEST_US_TO_ARRIVAL_TIME( timeUs ) ( ( uint64_t ) ( timeUs ) * 10U )
+#define TWCC_HISTORY_TEST_MIN_BITRATE_BPS ( 100000 )
+#define TWCC_HISTORY_TEST_MAX_BITRATE_BPS ( 20000000 )
+
+static PeerConnectionTwccHistory_t twccHistory;
+
+static uint64_t GetSentTimeUs( uint16_t seq )
+{
+    /* Sequence numbers before the wrap are sent first. */
+    return TWCC_HISTORY_TEST_START_TIME_US + ( uint64_t )( ( uint16_t )( seq + 100U ) ) * TWCC_HISTORY_TEST_SEND_INTERVAL_US;
+}
+
+static uint16_t GetPacketSize( uint16_t seq )
+{
+    return ( uint16_t )( TWCC_HISTORY_TEST_PACKET_SIZE + ( seq % 100U ) );
+}
+
+/* Record the packets in [ firstSeq, firstSeq + count ), the sequence number wraps. */
+static int SendPackets( uint16_t firstSeq,
+                        uint32_t count )
+{
+    int ret = 0;
+    TwccPacketInfo_t packetInfo;
+    uint16_t seq;
+    uint32_t i;
+
+    for( i = 0; ( ret == 0 ) && ( i < count ); i++ )
+    {
+        seq = ( uint16_t )( firstSeq + i );
+        memset( &packetInfo, 0, sizeof( TwccPacketInfo_t ) );
+        packetInfo.packetSeqNum = seq;
+        packetInfo.packetSize = GetPacketSize( seq );
+        packetInfo.localSentTime = GetSentTimeUs( seq );
+
+        if( PeerConnectionTwccHistory_AddPacketInfo( &twccHistory, &packetInfo ) != PEER_CONNECTION_RESULT_OK )
+        {
+            printf( "Fail to add seq: %u\n", seq );
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+/* Check the packets in [ firstSeq, firstSeq + count ) are all found, or all not found. */
+static int CheckPackets( const char * pName,
+                         uint16_t firstSeq,
+                         uint32_t count,
+                         uint8_t isFound )
+{
+    int ret = 0;
+    PeerConnectionResult_t result;
+    TwccPacketInfo_t packetInfo;
+    uint16_t seq;
+    uint32_t i;
+
+    for( i = 0; ( ret == 0 ) && ( i < count ); i++ )
+    {
+        seq = ( uint16_t )( firstSeq + i );
+        result = PeerConnectionTwccHistory_FindPacketInfo( &twccHistory, seq, &packetInfo );
+
+        if( isFound == 0U )
+        {
+            if( result != PEER_CONNECTION_RESULT_TWCC_HISTORY_PACKET_NOT_FOUND )
+            {
+                printf( "%s: seq: %u is found, result: %d\n", pName, seq, result );
+                ret = -1;
+            }
+        }
+        else if( result != PEER_CONNECTION_RESULT_OK )
+        {
+            printf( "%s: seq: %u is not found, result: %d\n", pName, seq, result );
+            ret = -1;
+        }
+        else if( ( packetInfo.packetSeqNum != seq ) ||
+                 ( packetInfo.packetSize != GetPacketSize( seq ) ) ||
+                 ( packetInfo.localSentTime != GetSentTimeUs( seq ) ) )
+        {
+            printf( "%s: seq: %u is found as seq: %u, size: %u, sent time: %lu\n",
+                    pName, seq, packetInfo.packetSeqNum, ( uint32_t ) packetInfo.packetSize, ( uint64_t ) packetInfo.localSentTime );
+            ret = -1;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+
+    return ret;
+}
+
+static int CreateHistory( void )
+{
+    int ret = 0;
+
+    if( PeerConnectionTwccHistory_Create( &twccHistory, TWCC_HISTORY_TEST_LENGTH ) != PEER_CONNECTION_RESULT_OK )
+    {
+        printf( "Fail to create the TWCC history\n" );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* The length must be a power of two that a 16-bit sequence number can index. */
+static int TestCreate( void )
+{
+    int ret = 0;
+    PeerConnectionTwccHistory_t history;
+    size_t invalidLengths[] = { 0, 6, 65536 * 2 };
+    size_t i;
+
+    for( i = 0; i < sizeof( invalidLengths ) / sizeof( invalidLengths[ 0 ] ); i++ )
+    {
+        memset( &history, 0, sizeof( PeerConnectionTwccHistory_t ) );
+        if( PeerConnectionTwccHistory_Create( &history, invalidLengths[ i ] ) != PEER_CONNECTION_RESULT_BAD_PARAMETER )
+        {
+            printf( "Length %lu is accepted\n", invalidLengths[ i ] );
+            PeerConnectionTwccHistory_Free( &history );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        ret = CreateHistory();
+    }
+
+    if( ret == 0 )
+    {
+        /* Nothing is sent yet, the empty slots must not match sequence number 0. */
+        ret = CheckPackets( "Empty", 0U, TWCC_HISTORY_TEST_LENGTH, 0U );
+        PeerConnectionTwccHistory_Free( &twccHistory );
+    }
+
+    return ret;
+}
+
+/* The sequence number wraps in the middle of the ring. */
+static int TestWrap( void )
+{
+    int ret = CreateHistory();
+
+    if( ret == 0 )
+    {
+        ret = SendPackets( 65532U, TWCC_HISTORY_TEST_LENGTH );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPackets( "Wrap", 65532U, TWCC_HISTORY_TEST_LENGTH, 1U );
+    }
+
+    if( ( ret == 0 ) &&
+        ( PeerConnectionTwccHistory_SetSentTime( &twccHistory, 1U, GetSentTimeUs( 1U ) ) != PEER_CONNECTION_RESULT_OK ) )
+    {
+        printf( "Wrap: fail to set the sent time of seq: 1\n" );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPackets( "Wrap after setting the sent time", 65532U, TWCC_HISTORY_TEST_LENGTH, 1U );
+    }
+
+    PeerConnectionTwccHistory_Free( &twccHistory );
+
+    return ret;
+}
+
+/* A packet one history length later replaces the stale one in its slot, looking up or updating the stale one fails. */
+static int TestOverwrite( void )
+{
+    int ret = CreateHistory();
+
+    if( ret == 0 )
+    {
+        ret = SendPackets( 0U, TWCC_HISTORY_TEST_LENGTH + 4U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPackets( "Stale", 0U, 4U, 0U );
+    }
+
+    if( ret == 0 )
+    {
+        ret = CheckPackets( "Overwrite", 4U, TWCC_HISTORY_TEST_LENGTH, 1U );
+    }
+
+    if( ( ret == 0 ) &&
+        ( PeerConnectionTwccHistory_SetSentTime( &twccHistory, 2U, GetSentTimeUs( 2U ) ) != PEER_CONNECTION_RESULT_TWCC_HISTORY_PACKET_NOT_FOUND ) )
+    {
+        printf( "Overwrite: the sent time of stale seq: 2 is set\n" );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        /* Setting the sent time of the stale packet must leave the new one in its slot. */
+        ret = CheckPackets( "Overwrite after setting the stale sent time", 4U, TWCC_HISTORY_TEST_LENGTH, 1U );
+    }
+
+    if( ret == 0 )
+    {
+        PeerConnectionTwccHistory_Reset( &twccHistory );
+        ret = CheckPackets( "Reset", 4U, TWCC_HISTORY_TEST_LENGTH, 0U );
+    }
+
+    PeerConnectionTwccHistory_Free( &twccHistory );
+
+    return ret;
+}
+
+static int CheckBandwidthInfo( const char * pName,
+                               const TwccBandwidthInfo_t * pTwccBandwidthInfo,
+                               uint64_t sentBytes,
+                               uint64_t sentPackets,
+                               uint64_t receivedBytes,
+                               uint64_t receivedPackets,
+                               uint64_t duration )
+{
+    int ret = 0;
+
+    if( ( pTwccBandwidthInfo->sentBytes != sentBytes ) ||
+        ( pTwccBandwidthInfo->sentPackets != sentPackets ) ||
+        ( pTwccBandwidthInfo->receivedBytes != receivedBytes ) ||
+        ( pTwccBandwidthInfo->receivedPackets != receivedPackets ) ||
+        ( ( uint64_t ) pTwccBandwidthInfo->duration != duration ) )
+    {
+        printf( "%s: sent bytes: %lu, packets: %lu, received bytes: %lu, packets: %lu, duration: %lu, "
+                "expected sent bytes: %lu, packets: %lu, received bytes: %lu, packets: %lu, duration: %lu\n",
+                pName,
+                ( uint64_t ) pTwccBandwidthInfo->sentBytes,
+                ( uint64_t ) pTwccBandwidthInfo->sentPackets,
+                ( uint64_t ) pTwccBandwidthInfo->receivedBytes,
+                ( uint64_t ) pTwccBandwidthInfo->receivedPackets,
+                ( uint64_t ) pTwccBandwidthInfo->duration,
+                sentBytes,
+                sentPackets,
+                receivedBytes,
+                receivedPackets,
+                duration );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* The feedback reports packets sent across the wrap, a packet never sent and stale ones,
+ * and some lost with an arrival time of 0 or all ones. Only the received ones reach the bandwidth estimator. */
+static int TestFeedback( void )
+{
+    int ret = CreateHistory();
+    PacketArrivalInfo_t arrivalInfoList[ TWCC_HISTORY_TEST_LENGTH + 4 ];
+    TwccBandwidthInfo_t twccBandwidthInfo;
+    PeerConnectionBandwidthEstimator_t bandwidthEstimator;
+    uint64_t sentBytes = 0U;
+    uint64_t receivedBytes = 0U;
+    uint64_t receivedPackets = 0U;
+    uint16_t seq;
+    size_t i;
+
+    if( ret == 0 )
+    {
+        /* 65530 ~ 65535 and 0 ~ 5 are sent, 65530 ~ 65533 are replaced by 2 ~ 5. */
+        ret = SendPackets( 65530U, TWCC_HISTORY_TEST_LENGTH + 4U );
+    }
+
+    if( ( ret == 0 ) &&
+        ( PeerConnectionBandwidthEstimator_Init( &bandwidthEstimator,
+                                                 TWCC_HISTORY_TEST_MIN_BITRATE_BPS,
+                                                 TWCC_HISTORY_TEST_MAX_BITRATE_BPS ) != PEER_CONNECTION_RESULT_OK ) )
+    {
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        memset( arrivalInfoList, 0, sizeof( arrivalInfoList ) );
+        for( i = 0; i < TWCC_HISTORY_TEST_LENGTH + 4U; i++ )
+        {
+            seq = ( uint16_t )( 65530U + i );
+            arrivalInfoList[ i ].seqNum = seq;
+            if( i == 7U )
+            {
+                arrivalInfoList[ i ].remoteArrivalTime = 0U;
+            }
+            else if( i == 9U )
+            {
+                arrivalInfoList[ i ].remoteArrivalTime = UINT64_MAX;
+            }
+            else
+            {
+                arrivalInfoList[ i ].remoteArrivalTime = TWCC_HISTORY_TEST_US_TO_ARRIVAL_TIME( GetSentTimeUs( seq ) + TWCC_HISTORY_TEST_BASE_DELAY_US );
+            }
+
+            /* The first 4 are stale. */
+            if( i >= 4U )
+            {
+                sentBytes += GetPacketSize( seq );
+                if( ( i != 7U ) && ( i != 9U ) )
+                {
+                    receivedBytes += GetPacketSize( seq );
+                    receivedPackets++;
+                }
+            }
+        }
+
+        if( PeerConnectionTwccHistory_OnFeedback( &twccHistory,
+                                                  arrivalInfoList,
+                                                  TWCC_HISTORY_TEST_LENGTH + 4U,
+                                                  &bandwidthEstimator,
+                                                  &twccBandwidthInfo ) != PEER_CONNECTION_RESULT_OK )
+        {
+            printf( "Feedback: fail to account the feedback\n" );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        /* 65534 ~ 5 are found, sent 7 ms apart. */
+        ret = CheckBandwidthInfo( "Feedback",
+                                  &twccBandwidthInfo,
+                                  sentBytes,
+                                  TWCC_HISTORY_TEST_LENGTH,
+                                  receivedBytes,
+                                  receivedPackets,
+                                  TWCC_HISTORY_TEST_US_TO_ARRIVAL_TIME( ( TWCC_HISTORY_TEST_LENGTH - 1U ) * TWCC_HISTORY_TEST_SEND_INTERVAL_US ) );
+    }
+
+    if( ( ret == 0 ) &&
+        ( ( bandwidthEstimator.ackedWindowBytes != receivedBytes ) ||
+          ( bandwidthEstimator.ackedWindowStartTimeUs != GetSentTimeUs( 65534U ) + TWCC_HISTORY_TEST_BASE_DELAY_US ) ) )
+    {
+        printf( "Feedback: the bandwidth estimator gets %lu bytes from %lu us, expected %lu bytes from %lu us\n",
+                bandwidthEstimator.ackedWindowBytes,
+                bandwidthEstimator.ackedWindowStartTimeUs,
+                receivedBytes,
+                GetSentTimeUs( 65534U ) + TWCC_HISTORY_TEST_BASE_DELAY_US );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        /* A packet never sent is skipped, e.g. the remote reports a corrupted sequence number. */
+        arrivalInfoList[ 0 ].seqNum = 100U;
+        arrivalInfoList[ 0 ].remoteArrivalTime = TWCC_HISTORY_TEST_US_TO_ARRIVAL_TIME( TWCC_HISTORY_TEST_START_TIME_US );
+        if( ( PeerConnectionTwccHistory_OnFeedback( &twccHistory,
+                                                    arrivalInfoList,
+                                                    1U,
+                                                    NULL,
+                                                    &twccBandwidthInfo ) != PEER_CONNECTION_RESULT_OK ) ||
+            ( CheckBandwidthInfo( "Never sent", &twccBandwidthInfo, 0U, 0U, 0U, 0U, 0U ) != 0 ) )
+        {
+            ret = -1;
+        }
+    }
+
+    PeerConnectionTwccHistory_Free( &twccHistory );
+
+    return ret;
+}
+
+/* All packets reported are lost, the duration still covers their sending so the callback reports the loss.
+ * A single packet has no duration. */
+static int TestAllLost( void )
+{
+    int ret = CreateHistory();
+    PacketArrivalInfo_t arrivalInfoList[ TWCC_HISTORY_TEST_LENGTH ];
+    TwccBandwidthInfo_t twccBandwidthInfo;
+    PeerConnectionBandwidthEstimator_t bandwidthEstimator;
+    uint64_t sentBytes = 0U;
+    size_t i;
+
+    if( ret == 0 )
+    {
+        ret = SendPackets( 200U, TWCC_HISTORY_TEST_LENGTH );
+    }
+
+    if( ( ret == 0 ) &&
+        ( PeerConnectionBandwidthEstimator_Init( &bandwidthEstimator,
+                                                 TWCC_HISTORY_TEST_MIN_BITRATE_BPS,
+                                                 TWCC_HISTORY_TEST_MAX_BITRATE_BPS ) != PEER_CONNECTION_RESULT_OK ) )
+    {
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        memset( arrivalInfoList, 0, sizeof( arrivalInfoList ) );
+        for( i = 0; i < TWCC_HISTORY_TEST_LENGTH; i++ )
+        {
+            arrivalInfoList[ i ].seqNum = ( uint16_t )( 200U + i );
+            sentBytes += GetPacketSize( ( uint16_t )( 200U + i ) );
+        }
+
+        if( ( PeerConnectionTwccHistory_OnFeedback( &twccHistory,
+                                                    arrivalInfoList,
+                                                    TWCC_HISTORY_TEST_LENGTH,
+                                                    &bandwidthEstimator,
+                                                    &twccBandwidthInfo ) != PEER_CONNECTION_RESULT_OK ) ||
+            ( CheckBandwidthInfo( "All lost",
+                                  &twccBandwidthInfo,
+                                  sentBytes,
+                                  TWCC_HISTORY_TEST_LENGTH,
+                                  0U,
+                                  0U,
+                                  TWCC_HISTORY_TEST_US_TO_ARRIVAL_TIME( ( TWCC_HISTORY_TEST_LENGTH - 1U ) * TWCC_HISTORY_TEST_SEND_INTERVAL_US ) ) != 0 ) )
+        {
+            ret = -1;
+        }
+    }
+
+    if( ( ret == 0 ) && ( bandwidthEstimator.ackedWindowBytes != 0U ) )
+    {
+        printf( "All lost: the bandwidth estimator gets %lu bytes\n", bandwidthEstimator.ackedWindowBytes );
+        ret = -1;
+    }
+
+    if( ( ret == 0 ) &&
+        ( ( PeerConnectionTwccHistory_OnFeedback( &twccHistory,
+                                                  arrivalInfoList,
+                                                  1U,
+                                                  NULL,
+                                                  &twccBandwidthInfo ) != PEER_CONNECTION_RESULT_OK ) ||
+          ( CheckBandwidthInfo( "Single lost", &twccBandwidthInfo, GetPacketSize( 200U ), 1U, 0U, 0U, 0U ) != 0 ) ) )
+    {
+        ret = -1;
+    }
+
+    PeerConnectionTwccHistory_Free( &twccHistory );
+
+    return ret;
+}
+
+int main( void )
+{
+    int ret = 0;
+    int result;
+
+    result = TestCreate();
+    printf( "Create: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestWrap();
+    printf( "Wrap: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestOverwrite();
+    printf( "Overwrite: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestFeedback();
+    printf( "Feedback: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestAllLost();
+    printf( "All lost: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    return ret == 0 ? 0 : 1;
+}
+
+#else /* ENABLE_TWCC_SUPPORT */
+
+int main( void )
+{
+    printf( "ENABLE_TWCC_SUPPORT is disabled, skip the TWCC history test.\n" );
+
+    return 0;
+}
+
+#endif /* ENABLE_TWCC_SUPPORT */
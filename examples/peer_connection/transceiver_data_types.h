@@ -113,6 +113,8 @@ typedef struct TransceiverRtpSender
     /* RTCP Sender Report Stats. */
     uint64_t rtpTimeOffset;
     uint64_t rtpFirstFrameWallClockTimeUs;
+    /* Random offset added to the RTP timestamps of the frames, chosen before the first frame as RFC 3550 requires. */
+    uint32_t rtpTimestampOffset;
 } TransceiverRtpSender_t;
 
 typedef struct Transceiver
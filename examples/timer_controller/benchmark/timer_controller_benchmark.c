@@ -0,0 +1,276 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Measure the firing accuracy of the timer controller with many armed timers.
+ * Half of the timers fire once, the other half repeat and reset themselves from their own callback
+ * like the ICE controller does. The run fails if any timer fires early or later than the allowed lateness.
+ * Usage: TimerControllerBenchmark [timer num] [max lateness ms] */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "logging.h"
+#include "timer_controller.h"
+
+#define TIMER_CONTROLLER_BENCHMARK_DEFAULT_TIMER_NUM ( 1000 )
+/* A timer fires on the next 1 ms tick, the rest of the budget is for the scheduling latency of a loaded host. */
+#define TIMER_CONTROLLER_BENCHMARK_DEFAULT_MAX_LATENESS_MS ( 20 )
+#define TIMER_CONTROLLER_BENCHMARK_MAX_INITIAL_TIME_MS ( 2000 )
+#define TIMER_CONTROLLER_BENCHMARK_MIN_REPEAT_TIME_MS ( 10 )
+#define TIMER_CONTROLLER_BENCHMARK_MAX_REPEAT_TIME_MS ( 200 )
+#define TIMER_CONTROLLER_BENCHMARK_REPEAT_FIRE_NUM ( 5 )
+
+typedef struct TimerControllerBenchmarkTimer
+{
+    TimerHandler_t timerHandler;
+    uint64_t expectedTimeNs;
+    uint32_t repeatTimeMs;
+    uint32_t fireNum;
+    int64_t * pLatenessNs;
+} TimerControllerBenchmarkTimer_t;
+
+static pthread_mutex_t benchmarkMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t benchmarkCond = PTHREAD_COND_INITIALIZER;
+static uint32_t doneTimerNum = 0;
+
+static uint64_t GetMonotonicTimeNs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000000ULL + ( uint64_t ) now.tv_nsec;
+}
+
+static int CompareLateness( const void * pA,
+                            const void * pB )
+{
+    int64_t a = *( const int64_t * ) pA;
+    int64_t b = *( const int64_t * ) pB;
+
+    return ( a > b ) - ( a < b );
+}
+
+static void OnTimerExpire( void * pUserContext )
+{
+    TimerControllerBenchmarkTimer_t * pTimer = ( TimerControllerBenchmarkTimer_t * ) pUserContext;
+    uint64_t nowNs = GetMonotonicTimeNs();
+    uint8_t isDone = 0;
+
+    ( void ) pthread_mutex_lock( &benchmarkMutex );
+
+    if( pTimer->fireNum == TIMER_CONTROLLER_BENCHMARK_REPEAT_FIRE_NUM )
+    {
+        /* The repeating timer fired again before its reset took effect, there's no room to record it. */
+    }
+    else
+    {
+        pTimer->pLatenessNs[ pTimer->fireNum ] = ( int64_t ) ( nowNs - pTimer->expectedTimeNs );
+        pTimer->fireNum++;
+
+        if( ( pTimer->repeatTimeMs == 0U ) || ( pTimer->fireNum == TIMER_CONTROLLER_BENCHMARK_REPEAT_FIRE_NUM ) )
+        {
+            isDone = 1;
+        }
+        else
+        {
+            pTimer->expectedTimeNs += ( uint64_t ) pTimer->repeatTimeMs * 1000000ULL;
+        }
+    }
+
+    ( void ) pthread_mutex_unlock( &benchmarkMutex );
+
+    if( isDone != 0 )
+    {
+        if( pTimer->repeatTimeMs != 0U )
+        {
+            /* Stop the repeating timer from its own callback. */
+            TimerController_Reset( &pTimer->timerHandler );
+        }
+
+        /* Count it as done only after the last access to the timer, the main thread frees it afterwards. */
+        ( void ) pthread_mutex_lock( &benchmarkMutex );
+        doneTimerNum++;
+        ( void ) pthread_cond_signal( &benchmarkCond );
+        ( void ) pthread_mutex_unlock( &benchmarkMutex );
+    }
+}
+
+int main( int argc,
+          char * argv[] )
+{
+    int ret = 0;
+    TimerControllerBenchmarkTimer_t * pTimers = NULL;
+    int64_t * pLatenessNs = NULL;
+    uint32_t timerNum = TIMER_CONTROLLER_BENCHMARK_DEFAULT_TIMER_NUM;
+    uint32_t maxLatenessMs = TIMER_CONTROLLER_BENCHMARK_DEFAULT_MAX_LATENESS_MS;
+    uint32_t initialTimeMs;
+    uint32_t sampleNum = 0;
+    uint32_t earlyNum = 0;
+    uint32_t lateNum = 0;
+    uint32_t i;
+    uint32_t j;
+
+    if( argc > 1 )
+    {
+        timerNum = ( uint32_t ) strtoul( argv[ 1 ], NULL, 10 );
+    }
+    if( argc > 2 )
+    {
+        maxLatenessMs = ( uint32_t ) strtoul( argv[ 2 ], NULL, 10 );
+    }
+
+    if( timerNum == 0 )
+    {
+        LogError( ( "Invalid input, timer num: %u", timerNum ) );
+        ret = -1;
+    }
+
+    if( ret == 0 )
+    {
+        pTimers = ( TimerControllerBenchmarkTimer_t * ) calloc( timerNum,
+                                                                 sizeof( TimerControllerBenchmarkTimer_t ) );
+        pLatenessNs = ( int64_t * ) calloc( ( size_t ) timerNum * TIMER_CONTROLLER_BENCHMARK_REPEAT_FIRE_NUM,
+                                            sizeof( int64_t ) );
+        if( ( pTimers == NULL ) || ( pLatenessNs == NULL ) )
+        {
+            LogError( ( "Fail to allocate memory for %u timers", timerNum ) );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        srand( ( unsigned int ) time( NULL ) );
+
+        for( i = 0; i < timerNum; i++ )
+        {
+            pTimers[ i ].pLatenessNs = &pLatenessNs[ ( size_t ) i * TIMER_CONTROLLER_BENCHMARK_REPEAT_FIRE_NUM ];
+            if( ( i % 2U ) != 0U )
+            {
+                pTimers[ i ].repeatTimeMs = TIMER_CONTROLLER_BENCHMARK_MIN_REPEAT_TIME_MS +
+                                            ( uint32_t ) rand() % ( TIMER_CONTROLLER_BENCHMARK_MAX_REPEAT_TIME_MS - TIMER_CONTROLLER_BENCHMARK_MIN_REPEAT_TIME_MS );
+            }
+
+            if( TimerController_Create( &pTimers[ i ].timerHandler,
+                                        OnTimerExpire,
+                                        &pTimers[ i ] ) != TIMER_CONTROLLER_RESULT_OK )
+            {
+                LogError( ( "Fail to create timer %u", i ) );
+                ret = -1;
+                break;
+            }
+        }
+    }
+
+    if( ret == 0 )
+    {
+        for( i = 0; i < timerNum; i++ )
+        {
+            initialTimeMs = 1U + ( uint32_t ) rand() % TIMER_CONTROLLER_BENCHMARK_MAX_INITIAL_TIME_MS;
+
+            ( void ) pthread_mutex_lock( &benchmarkMutex );
+            pTimers[ i ].expectedTimeNs = GetMonotonicTimeNs() + ( uint64_t ) initialTimeMs * 1000000ULL;
+            ( void ) pthread_mutex_unlock( &benchmarkMutex );
+
+            if( TimerController_SetTimer( &pTimers[ i ].timerHandler,
+                                          initialTimeMs,
+                                          pTimers[ i ].repeatTimeMs ) != TIMER_CONTROLLER_RESULT_OK )
+            {
+                LogError( ( "Fail to set timer %u", i ) );
+                ret = -1;
+                break;
+            }
+        }
+
+        /* Wait for the timers that were set. */
+        timerNum = i;
+    }
+
+    if( ret == 0 )
+    {
+        ( void ) pthread_mutex_lock( &benchmarkMutex );
+        while( doneTimerNum < timerNum )
+        {
+            ( void ) pthread_cond_wait( &benchmarkCond,
+                                        &benchmarkMutex );
+        }
+
+        for( i = 0; i < timerNum; i++ )
+        {
+            for( j = 0; j < pTimers[ i ].fireNum; j++ )
+            {
+                if( pTimers[ i ].pLatenessNs[ j ] < 0 )
+                {
+                    earlyNum++;
+                }
+                else if( pTimers[ i ].pLatenessNs[ j ] > ( int64_t ) maxLatenessMs * 1000000LL )
+                {
+                    lateNum++;
+                }
+                else
+                {
+                    /* Empty else marker. */
+                }
+
+                /* Pack the samples to the front for sorting. */
+                pLatenessNs[ sampleNum++ ] = pTimers[ i ].pLatenessNs[ j ];
+            }
+        }
+        ( void ) pthread_mutex_unlock( &benchmarkMutex );
+
+        qsort( pLatenessNs,
+               sampleNum,
+               sizeof( int64_t ),
+               CompareLateness );
+
+        printf( "Timers: %u (%u repeating), firings: %u\n",
+                timerNum,
+                timerNum / 2U,
+                sampleNum );
+        printf( "Lateness: min %.3f ms, p50 %.3f ms, p99 %.3f ms, max %.3f ms\n",
+                ( double ) pLatenessNs[ 0 ] / 1000000.0,
+                ( double ) pLatenessNs[ sampleNum / 2U ] / 1000000.0,
+                ( double ) pLatenessNs[ ( ( uint64_t ) sampleNum * 99U ) / 100U ] / 1000000.0,
+                ( double ) pLatenessNs[ sampleNum - 1U ] / 1000000.0 );
+        printf( "Early: %u, later than %u ms: %u\n",
+                earlyNum,
+                maxLatenessMs,
+                lateNum );
+
+        if( ( earlyNum != 0 ) || ( lateNum != 0 ) )
+        {
+            ret = -1;
+        }
+    }
+
+    if( pTimers != NULL )
+    {
+        /* Make sure no timer fires into the freed memory, including the ones left set by a failure. */
+        for( i = 0; i < timerNum; i++ )
+        {
+            TimerController_Delete( &pTimers[ i ].timerHandler );
+        }
+    }
+
+    free( pTimers );
+    free( pLatenessNs );
+
+    return ret;
+}
@@ -0,0 +1,512 @@
+/*
+ * Copyright Amazon.com, Inc. or its affiliates. All Rights Reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License").
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *    http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Fire timers through every level of the timing wheel and beyond it, and reset or delete them while they're dispatched.
+ * The test is built with a short wheel tick, so the upper levels and the timers beyond the wheel fire in seconds.
+ * Usage: TimerControllerTest */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "logging.h"
+#include "timer_controller.h"
+
+/* Must match the tick the timer controller is built with. */
+#ifndef TIMER_CONTROLLER_WHEEL_TICK_NS
+#define TIMER_CONTROLLER_WHEEL_TICK_NS ( 1000000ULL )
+#endif
+/* 4 levels of 64 slots. */
+#define TIMER_CONTROLLER_TEST_WHEEL_SPAN_MS ( ( 1ULL << 24 ) * TIMER_CONTROLLER_WHEEL_TICK_NS / 1000000ULL )
+/* The rest of the budget is for the scheduling latency of a loaded host. */
+#define TIMER_CONTROLLER_TEST_MAX_LATENESS_MS ( 50 )
+#define TIMER_CONTROLLER_TEST_REPEAT_TIME_MS ( 7 )
+#define TIMER_CONTROLLER_TEST_REPEAT_FIRE_NUM ( 40 )
+#define TIMER_CONTROLLER_TEST_CALLBACK_TIME_MS ( 100 )
+#define TIMER_CONTROLLER_TEST_MAX_FIRE_NUM ( 64 )
+
+typedef enum TimerControllerTestAction
+{
+    TIMER_CONTROLLER_TEST_ACTION_NONE = 0,
+    TIMER_CONTROLLER_TEST_ACTION_RESET_SELF,
+    TIMER_CONTROLLER_TEST_ACTION_DELETE_SELF,
+    TIMER_CONTROLLER_TEST_ACTION_SET_SELF,
+    TIMER_CONTROLLER_TEST_ACTION_DELETE_OTHER,
+    TIMER_CONTROLLER_TEST_ACTION_SLEEP,
+} TimerControllerTestAction_t;
+
+typedef struct TimerControllerTestTimer
+{
+    TimerHandler_t timerHandler;
+    uint64_t setTimeNs;
+    uint32_t initialTimeMs;
+    uint32_t repeatTimeMs;
+
+    /* The action is taken in the callback once the timer has fired actionFireNum times. */
+    TimerControllerTestAction_t action;
+    uint32_t actionFireNum;
+    struct TimerControllerTestTimer * pOtherTimer;
+
+    uint32_t fireNum;
+    uint64_t fireTimeNs[ TIMER_CONTROLLER_TEST_MAX_FIRE_NUM ];
+    uint8_t isCallbackRunning;
+    uint8_t isCallbackDone;
+} TimerControllerTestTimer_t;
+
+static pthread_mutex_t testMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static uint64_t GetMonotonicTimeNs( void )
+{
+    struct timespec now;
+
+    clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000000ULL + ( uint64_t ) now.tv_nsec;
+}
+
+static void SleepMs( uint32_t timeMs )
+{
+    struct timespec sleepTime = {
+        .tv_sec = timeMs / 1000U,
+        .tv_nsec = ( long ) ( timeMs % 1000U ) * 1000000L,
+    };
+
+    ( void ) nanosleep( &sleepTime, NULL );
+}
+
+static void OnTimerExpire( void * pUserContext )
+{
+    TimerControllerTestTimer_t * pTimer = ( TimerControllerTestTimer_t * ) pUserContext;
+    uint64_t nowNs = GetMonotonicTimeNs();
+    uint8_t isActionTime;
+
+    ( void ) pthread_mutex_lock( &testMutex );
+    if( pTimer->fireNum < TIMER_CONTROLLER_TEST_MAX_FIRE_NUM )
+    {
+        pTimer->fireTimeNs[ pTimer->fireNum ] = nowNs;
+    }
+    pTimer->fireNum++;
+    isActionTime = ( pTimer->fireNum == pTimer->actionFireNum ) ? 1U : 0U;
+    pTimer->isCallbackRunning = 1U;
+    ( void ) pthread_mutex_unlock( &testMutex );
+
+    if( isActionTime != 0U )
+    {
+        switch( pTimer->action )
+        {
+            case TIMER_CONTROLLER_TEST_ACTION_RESET_SELF:
+                TimerController_Reset( &pTimer->timerHandler );
+                break;
+            case TIMER_CONTROLLER_TEST_ACTION_DELETE_SELF:
+                TimerController_Delete( &pTimer->timerHandler );
+                break;
+            case TIMER_CONTROLLER_TEST_ACTION_SET_SELF:
+                ( void ) TimerController_SetTimer( &pTimer->timerHandler,
+                                                   pTimer->initialTimeMs,
+                                                   0U );
+                break;
+            case TIMER_CONTROLLER_TEST_ACTION_DELETE_OTHER:
+                TimerController_Delete( &pTimer->pOtherTimer->timerHandler );
+                break;
+            case TIMER_CONTROLLER_TEST_ACTION_SLEEP:
+                SleepMs( TIMER_CONTROLLER_TEST_CALLBACK_TIME_MS );
+                break;
+            default:
+                break;
+        }
+    }
+
+    ( void ) pthread_mutex_lock( &testMutex );
+    pTimer->isCallbackRunning = 0U;
+    pTimer->isCallbackDone = 1U;
+    ( void ) pthread_mutex_unlock( &testMutex );
+}
+
+static int StartTimer( TimerControllerTestTimer_t * pTimer,
+                       uint32_t initialTimeMs,
+                       uint32_t repeatTimeMs )
+{
+    int ret = 0;
+
+    pTimer->initialTimeMs = initialTimeMs;
+    pTimer->repeatTimeMs = repeatTimeMs;
+
+    if( TimerController_Create( &pTimer->timerHandler,
+                                OnTimerExpire,
+                                pTimer ) != TIMER_CONTROLLER_RESULT_OK )
+    {
+        printf( "Fail to create the timer of %u ms\n", initialTimeMs );
+        ret = -1;
+    }
+    else
+    {
+        pTimer->setTimeNs = GetMonotonicTimeNs();
+        if( TimerController_SetTimer( &pTimer->timerHandler,
+                                      initialTimeMs,
+                                      repeatTimeMs ) != TIMER_CONTROLLER_RESULT_OK )
+        {
+            printf( "Fail to set the timer of %u ms\n", initialTimeMs );
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+static uint32_t GetFireNum( TimerControllerTestTimer_t * pTimer )
+{
+    uint32_t fireNum;
+
+    ( void ) pthread_mutex_lock( &testMutex );
+    fireNum = pTimer->fireNum;
+    ( void ) pthread_mutex_unlock( &testMutex );
+
+    return fireNum;
+}
+
+/* Wait till the timer has fired fireNum times, or the timeout. */
+static void WaitForFireNum( TimerControllerTestTimer_t * pTimer,
+                            uint32_t fireNum,
+                            uint32_t timeoutMs )
+{
+    uint64_t deadlineNs = GetMonotonicTimeNs() + ( uint64_t ) timeoutMs * 1000000ULL;
+
+    while( ( GetFireNum( pTimer ) < fireNum ) && ( GetMonotonicTimeNs() < deadlineNs ) )
+    {
+        SleepMs( 1U );
+    }
+}
+
+/* Check the fire times against the set time, a timer never fires early and at most the max lateness late. */
+static int CheckFireTimes( const char * pName,
+                           TimerControllerTestTimer_t * pTimer,
+                           uint32_t expectedFireNum )
+{
+    int ret = 0;
+    uint64_t expectedTimeNs;
+    uint32_t i;
+
+    ( void ) pthread_mutex_lock( &testMutex );
+
+    if( pTimer->fireNum != expectedFireNum )
+    {
+        printf( "%s: the timer of %u ms fires %u times, expected %u\n", pName, pTimer->initialTimeMs, pTimer->fireNum, expectedFireNum );
+        ret = -1;
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < pTimer->fireNum ) && ( i < TIMER_CONTROLLER_TEST_MAX_FIRE_NUM ); i++ )
+    {
+        expectedTimeNs = pTimer->setTimeNs + ( ( uint64_t ) pTimer->initialTimeMs + ( uint64_t ) i * pTimer->repeatTimeMs ) * 1000000ULL;
+        if( pTimer->fireTimeNs[ i ] < expectedTimeNs )
+        {
+            printf( "%s: the timer of %u ms fires %lu us early at fire %u\n",
+                    pName, pTimer->initialTimeMs, ( expectedTimeNs - pTimer->fireTimeNs[ i ] ) / 1000U, i );
+            ret = -1;
+        }
+        else if( pTimer->fireTimeNs[ i ] - expectedTimeNs > TIMER_CONTROLLER_TEST_MAX_LATENESS_MS * 1000000ULL )
+        {
+            printf( "%s: the timer of %u ms fires %lu us late at fire %u\n",
+                    pName, pTimer->initialTimeMs, ( pTimer->fireTimeNs[ i ] - expectedTimeNs ) / 1000U, i );
+            ret = -1;
+        }
+        else
+        {
+            /* Empty else marker. */
+        }
+    }
+
+    ( void ) pthread_mutex_unlock( &testMutex );
+
+    return ret;
+}
+
+/* One-shot timers land on every level, they're cascaded down level by level and fire in time.
+ * The last one is beyond the wheel, it's parked in the farthest slot and re-inserted. */
+static int TestCascade( void )
+{
+    int ret = 0;
+    uint32_t initialTimesMs[] = { 1, 2, 3, 50, 130, 140, 1000, 3000, ( uint32_t ) TIMER_CONTROLLER_TEST_WHEEL_SPAN_MS + 100U };
+    TimerControllerTestTimer_t timers[ sizeof( initialTimesMs ) / sizeof( initialTimesMs[ 0 ] ) ];
+    size_t timerNum = sizeof( initialTimesMs ) / sizeof( initialTimesMs[ 0 ] );
+    size_t i;
+
+    memset( timers, 0, sizeof( timers ) );
+    for( i = 0; ( ret == 0 ) && ( i < timerNum ); i++ )
+    {
+        ret = StartTimer( &timers[ i ], initialTimesMs[ i ], 0U );
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < timerNum ); i++ )
+    {
+        WaitForFireNum( &timers[ i ], 1U, initialTimesMs[ i ] + TIMER_CONTROLLER_TEST_MAX_LATENESS_MS * 4U );
+        ret = CheckFireTimes( "Cascade", &timers[ i ], 1U );
+    }
+
+    for( i = 0; ( ret == 0 ) && ( i < timerNum ); i++ )
+    {
+        if( TimerController_IsTimerSet( &timers[ i ].timerHandler ) != TIMER_CONTROLLER_RESULT_NOT_SET )
+        {
+            printf( "Cascade: the timer of %u ms is still set after it fires\n", initialTimesMs[ i ] );
+            ret = -1;
+        }
+    }
+
+    for( i = 0; i < timerNum; i++ )
+    {
+        TimerController_Delete( &timers[ i ].timerHandler );
+    }
+
+    return ret;
+}
+
+/* A repeating timer goes around all slots of the lower levels many times, its period doesn't drift. */
+static int TestWrap( void )
+{
+    int ret;
+    TimerControllerTestTimer_t timer;
+
+    memset( &timer, 0, sizeof( timer ) );
+    ret = StartTimer( &timer, TIMER_CONTROLLER_TEST_REPEAT_TIME_MS, TIMER_CONTROLLER_TEST_REPEAT_TIME_MS );
+
+    if( ret == 0 )
+    {
+        WaitForFireNum( &timer, TIMER_CONTROLLER_TEST_REPEAT_FIRE_NUM,
+                        TIMER_CONTROLLER_TEST_REPEAT_TIME_MS * ( TIMER_CONTROLLER_TEST_REPEAT_FIRE_NUM + 1U ) + TIMER_CONTROLLER_TEST_MAX_LATENESS_MS * 4U );
+        TimerController_Delete( &timer.timerHandler );
+        ret = CheckFireTimes( "Wrap", &timer, GetFireNum( &timer ) );
+    }
+
+    if( ( ret == 0 ) && ( GetFireNum( &timer ) < TIMER_CONTROLLER_TEST_REPEAT_FIRE_NUM ) )
+    {
+        printf( "Wrap: the repeating timer fires %u times, expected %u\n", GetFireNum( &timer ), TIMER_CONTROLLER_TEST_REPEAT_FIRE_NUM );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* A timer far beyond the wheel stays set and doesn't fire, deleting it takes it out. */
+static int TestFarFuture( void )
+{
+    int ret;
+    TimerControllerTestTimer_t timer;
+
+    memset( &timer, 0, sizeof( timer ) );
+    ret = StartTimer( &timer, UINT32_MAX, 0U );
+
+    if( ret == 0 )
+    {
+        SleepMs( 100U );
+        if( ( GetFireNum( &timer ) != 0U ) ||
+            ( TimerController_IsTimerSet( &timer.timerHandler ) != TIMER_CONTROLLER_RESULT_SET ) )
+        {
+            printf( "Far future: the timer fires %u times or is not set\n", GetFireNum( &timer ) );
+            ret = -1;
+        }
+    }
+
+    TimerController_Delete( &timer.timerHandler );
+    if( ( ret == 0 ) &&
+        ( TimerController_IsTimerSet( &timer.timerHandler ) != TIMER_CONTROLLER_RESULT_NOT_SET ) )
+    {
+        printf( "Far future: the timer is still set after it's deleted\n" );
+        ret = -1;
+    }
+
+    return ret;
+}
+
+/* Callbacks reset, delete or set their own timers, or delete another timer, while the dispatcher runs them.
+ * Deleting its own timer from the callback must not wait for the callback itself. */
+static int TestResetDuringDispatch( void )
+{
+    int ret = 0;
+    TimerControllerTestTimer_t resetTimer;
+    TimerControllerTestTimer_t deleteTimer;
+    TimerControllerTestTimer_t setTimer;
+    TimerControllerTestTimer_t deleteOtherTimer;
+    TimerControllerTestTimer_t otherTimer;
+
+    memset( &resetTimer, 0, sizeof( resetTimer ) );
+    memset( &deleteTimer, 0, sizeof( deleteTimer ) );
+    memset( &setTimer, 0, sizeof( setTimer ) );
+    memset( &deleteOtherTimer, 0, sizeof( deleteOtherTimer ) );
+    memset( &otherTimer, 0, sizeof( otherTimer ) );
+
+    resetTimer.action = TIMER_CONTROLLER_TEST_ACTION_RESET_SELF;
+    resetTimer.actionFireNum = 3U;
+    deleteTimer.action = TIMER_CONTROLLER_TEST_ACTION_DELETE_SELF;
+    deleteTimer.actionFireNum = 2U;
+    setTimer.action = TIMER_CONTROLLER_TEST_ACTION_SET_SELF;
+    setTimer.actionFireNum = 1U;
+    deleteOtherTimer.action = TIMER_CONTROLLER_TEST_ACTION_DELETE_OTHER;
+    deleteOtherTimer.actionFireNum = 1U;
+    deleteOtherTimer.pOtherTimer = &otherTimer;
+
+    ret = StartTimer( &resetTimer, 5U, 5U );
+    if( ret == 0 )
+    {
+        ret = StartTimer( &deleteTimer, 5U, 5U );
+    }
+    if( ret == 0 )
+    {
+        ret = StartTimer( &setTimer, 5U, 0U );
+    }
+    if( ret == 0 )
+    {
+        ret = StartTimer( &otherTimer, 30U, 0U );
+    }
+    if( ret == 0 )
+    {
+        ret = StartTimer( &deleteOtherTimer, 10U, 0U );
+    }
+
+    if( ret == 0 )
+    {
+        /* The repeating ones would have fired about 20 times. */
+        SleepMs( 100U );
+
+        if( ( GetFireNum( &resetTimer ) != 3U ) ||
+            ( TimerController_IsTimerSet( &resetTimer.timerHandler ) != TIMER_CONTROLLER_RESULT_NOT_SET ) )
+        {
+            printf( "Reset during dispatch: the timer reset by its callback fires %u times, expected 3\n", GetFireNum( &resetTimer ) );
+            ret = -1;
+        }
+
+        if( ( GetFireNum( &deleteTimer ) != 2U ) ||
+            ( TimerController_IsTimerSet( &deleteTimer.timerHandler ) != TIMER_CONTROLLER_RESULT_NOT_SET ) )
+        {
+            printf( "Reset during dispatch: the timer deleted by its callback fires %u times, expected 2\n", GetFireNum( &deleteTimer ) );
+            ret = -1;
+        }
+
+        /* Set again by its callback, it fires once more. */
+        if( ( GetFireNum( &setTimer ) != 2U ) ||
+            ( setTimer.fireTimeNs[ 1 ] - setTimer.fireTimeNs[ 0 ] < setTimer.initialTimeMs * 1000000ULL ) )
+        {
+            printf( "Reset during dispatch: the timer set by its callback fires %u times, expected 2\n", GetFireNum( &setTimer ) );
+            ret = -1;
+        }
+
+        if( ( GetFireNum( &otherTimer ) != 0U ) ||
+            ( TimerController_IsTimerSet( &otherTimer.timerHandler ) != TIMER_CONTROLLER_RESULT_NOT_SET ) )
+        {
+            printf( "Reset during dispatch: the timer deleted by another callback fires %u times\n", GetFireNum( &otherTimer ) );
+            ret = -1;
+        }
+    }
+
+    TimerController_Delete( &resetTimer.timerHandler );
+    TimerController_Delete( &deleteTimer.timerHandler );
+    TimerController_Delete( &setTimer.timerHandler );
+    TimerController_Delete( &deleteOtherTimer.timerHandler );
+    TimerController_Delete( &otherTimer.timerHandler );
+
+    return ret;
+}
+
+/* Deleting a timer from another thread while its callback runs returns after the callback, and it doesn't fire again. */
+static int TestDeleteDuringDispatch( void )
+{
+    int ret;
+    TimerControllerTestTimer_t timer;
+    uint8_t isCallbackRunning = 0U;
+    uint8_t isCallbackDone = 0U;
+    uint32_t fireNum;
+    uint64_t deadlineNs;
+
+    memset( &timer, 0, sizeof( timer ) );
+    timer.action = TIMER_CONTROLLER_TEST_ACTION_SLEEP;
+    timer.actionFireNum = 1U;
+
+    ret = StartTimer( &timer, 5U, 5U );
+
+    if( ret == 0 )
+    {
+        deadlineNs = GetMonotonicTimeNs() + TIMER_CONTROLLER_TEST_CALLBACK_TIME_MS * 1000000ULL;
+        while( ( isCallbackRunning == 0U ) && ( GetMonotonicTimeNs() < deadlineNs ) )
+        {
+            SleepMs( 1U );
+            ( void ) pthread_mutex_lock( &testMutex );
+            isCallbackRunning = timer.isCallbackRunning;
+            ( void ) pthread_mutex_unlock( &testMutex );
+        }
+
+        if( isCallbackRunning == 0U )
+        {
+            printf( "Delete during dispatch: the callback doesn't run\n" );
+            ret = -1;
+        }
+    }
+
+    TimerController_Delete( &timer.timerHandler );
+
+    if( ret == 0 )
+    {
+        ( void ) pthread_mutex_lock( &testMutex );
+        isCallbackRunning = timer.isCallbackRunning;
+        isCallbackDone = timer.isCallbackDone;
+        fireNum = timer.fireNum;
+        ( void ) pthread_mutex_unlock( &testMutex );
+
+        if( ( isCallbackRunning != 0U ) || ( isCallbackDone == 0U ) )
+        {
+            printf( "Delete during dispatch: the delete returns before the callback\n" );
+            ret = -1;
+        }
+    }
+
+    if( ret == 0 )
+    {
+        SleepMs( 50U );
+        if( GetFireNum( &timer ) != fireNum )
+        {
+            printf( "Delete during dispatch: the timer fires %u times after it's deleted\n", GetFireNum( &timer ) - fireNum );
+            ret = -1;
+        }
+    }
+
+    return ret;
+}
+
+int main( void )
+{
+    int ret = 0;
+    int result;
+
+    result = TestCascade();
+    printf( "Cascade: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestWrap();
+    printf( "Wrap: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestFarFuture();
+    printf( "Far future: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestResetDuringDispatch();
+    printf( "Reset during dispatch: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    result = TestDeleteDuringDispatch();
+    printf( "Delete during dispatch: %s\n", result == 0 ? "PASS" : "FAIL" );
+    ret |= result;
+
+    return ret == 0 ? 0 : 1;
+}
@@ -14,23 +14,336 @@
  * limitations under the License.
  */
 
-#include <signal.h>
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
 #include "logging.h"
 #include "timer_controller.h"
 
-static void generalTimerCallback( union sigval sv )
+/* Level 0 slots are one tick wide, a slot of every upper level spans a whole rotation of the level below.
+ * With 4 levels of 64 slots and 1 ms ticks, the wheel covers 2^24 ms (~4.6 hours) ahead,
+ * later timers are parked in the farthest slot and re-inserted when it's cascaded.
+ * A shorter tick must divide 1 ms, the tests use one to get through all levels quickly. */
+#ifndef TIMER_CONTROLLER_WHEEL_TICK_NS
+#define TIMER_CONTROLLER_WHEEL_TICK_NS ( 1000000ULL )
+#endif
+#define TIMER_CONTROLLER_WHEEL_MS_TO_TICK( timeMs ) ( ( uint64_t ) ( timeMs ) * 1000000ULL / TIMER_CONTROLLER_WHEEL_TICK_NS )
+#define TIMER_CONTROLLER_WHEEL_SLOT_BITS ( 6 )
+#define TIMER_CONTROLLER_WHEEL_SLOT_NUM ( 1U << TIMER_CONTROLLER_WHEEL_SLOT_BITS )
+#define TIMER_CONTROLLER_WHEEL_SLOT_MASK ( TIMER_CONTROLLER_WHEEL_SLOT_NUM - 1U )
+#define TIMER_CONTROLLER_WHEEL_LEVEL_NUM ( 4 )
+#define TIMER_CONTROLLER_WHEEL_LEVEL_SHIFT( level ) ( ( level ) * TIMER_CONTROLLER_WHEEL_SLOT_BITS )
+#define TIMER_CONTROLLER_WHEEL_LEVEL_SPAN( level ) ( 1ULL << TIMER_CONTROLLER_WHEEL_LEVEL_SHIFT( level ) )
+
+typedef struct TimerControllerWheel
 {
-    TimerHandler_t * pTimerHandler = ( TimerHandler_t * ) sv.sival_ptr;
+    pthread_mutex_t wheelMutex;
+    /* Signaled when a callback returns, TimerController_Delete waits on it for the callback of its timer. */
+    pthread_cond_t dispatchCond;
+    pthread_t dispatcherTid;
+    /* The timer whose callback is running, NULL if none. */
+    TimerHandler_t * pDispatchingTimer;
+    int timerFd;
+    uint64_t startTimeNs;
+    /* The last tick processed by the dispatcher. */
+    uint64_t currentTick;
+    /* The tick the timerfd is armed for, 0 if it's disarmed. */
+    uint64_t armedTick;
+    size_t timerCount;
+    TimerHandler_t * pSlots[ TIMER_CONTROLLER_WHEEL_LEVEL_NUM ][ TIMER_CONTROLLER_WHEEL_SLOT_NUM ];
+} TimerControllerWheel_t;
 
-    if( pTimerHandler == NULL )
+static TimerControllerWheel_t timerWheel = {
+    .timerFd = -1,
+};
+static pthread_once_t timerWheelOnce = PTHREAD_ONCE_INIT;
+static TimerControllerResult_t timerWheelInitResult = TIMER_CONTROLLER_RESULT_OK;
+
+static uint64_t GetMonotonicTimeNs( void )
+{
+    struct timespec now;
+
+    ( void ) clock_gettime( CLOCK_MONOTONIC, &now );
+
+    return ( uint64_t ) now.tv_sec * 1000000000ULL + ( uint64_t ) now.tv_nsec;
+}
+
+static void LinkTimer( TimerControllerWheel_t * pWheel,
+                       TimerHandler_t * pTimerHandler )
+{
+    uint64_t slotTick;
+    uint64_t delta;
+    int level = 0;
+
+    if( pTimerHandler->expireTick < pWheel->currentTick )
     {
-        LogWarn( ( "Unexpected behavior, timer expires with NULL data pointer" ) );
+        /* Already overdue, fire it at the next tick. A timer cascaded down at its own expiry tick
+         * lands in the current level 0 slot, which is fired right after the cascade. */
+        pTimerHandler->expireTick = pWheel->currentTick + 1;
+    }
+
+    /* Pick the lowest level whose rotation still reaches the expiry. */
+    delta = pTimerHandler->expireTick - pWheel->currentTick;
+    while( ( level < TIMER_CONTROLLER_WHEEL_LEVEL_NUM - 1 ) &&
+           ( delta >= TIMER_CONTROLLER_WHEEL_LEVEL_SPAN( level + 1 ) ) )
+    {
+        level++;
+    }
+
+    if( delta >= TIMER_CONTROLLER_WHEEL_LEVEL_SPAN( TIMER_CONTROLLER_WHEEL_LEVEL_NUM ) )
+    {
+        /* Beyond the wheel, park it in the farthest slot. */
+        slotTick = pWheel->currentTick + TIMER_CONTROLLER_WHEEL_LEVEL_SPAN( TIMER_CONTROLLER_WHEEL_LEVEL_NUM ) - 1;
     }
     else
     {
-        pTimerHandler->onTimerExpire( pTimerHandler->pUserContext );
+        slotTick = pTimerHandler->expireTick;
+    }
+
+    pTimerHandler->ppSlot = &pWheel->pSlots[ level ][ ( slotTick >> TIMER_CONTROLLER_WHEEL_LEVEL_SHIFT( level ) ) & TIMER_CONTROLLER_WHEEL_SLOT_MASK ];
+    pTimerHandler->pPrev = NULL;
+    pTimerHandler->pNext = *pTimerHandler->ppSlot;
+    if( pTimerHandler->pNext != NULL )
+    {
+        pTimerHandler->pNext->pPrev = pTimerHandler;
+    }
+    *pTimerHandler->ppSlot = pTimerHandler;
+}
+
+static void UnlinkTimer( TimerHandler_t * pTimerHandler )
+{
+    if( pTimerHandler->pPrev != NULL )
+    {
+        pTimerHandler->pPrev->pNext = pTimerHandler->pNext;
+    }
+    else
+    {
+        *pTimerHandler->ppSlot = pTimerHandler->pNext;
+    }
+
+    if( pTimerHandler->pNext != NULL )
+    {
+        pTimerHandler->pNext->pPrev = pTimerHandler->pPrev;
+    }
+
+    pTimerHandler->pPrev = NULL;
+    pTimerHandler->pNext = NULL;
+    pTimerHandler->ppSlot = NULL;
+}
+
+static void CascadeSlot( TimerControllerWheel_t * pWheel,
+                         int level )
+{
+    TimerHandler_t ** ppSlot = &pWheel->pSlots[ level ][ ( pWheel->currentTick >> TIMER_CONTROLLER_WHEEL_LEVEL_SHIFT( level ) ) & TIMER_CONTROLLER_WHEEL_SLOT_MASK ];
+    TimerHandler_t * pTimerHandler;
+
+    /* The slot's span starts now, move its timers down to the lower levels. */
+    while( *ppSlot != NULL )
+    {
+        pTimerHandler = *ppSlot;
+        UnlinkTimer( pTimerHandler );
+        LinkTimer( pWheel, pTimerHandler );
+    }
+}
+
+static uint64_t GetNextWakeUpTick( const TimerControllerWheel_t * pWheel )
+{
+    uint64_t nextTick = UINT64_MAX;
+    uint64_t block;
+    uint32_t i;
+    int level;
+
+    /* A level 0 timer fires at its slot, an upper level timer needs a wake up when its slot is cascaded. */
+    for( level = 0; level < TIMER_CONTROLLER_WHEEL_LEVEL_NUM; level++ )
+    {
+        block = pWheel->currentTick >> TIMER_CONTROLLER_WHEEL_LEVEL_SHIFT( level );
+        for( i = 1; i <= TIMER_CONTROLLER_WHEEL_SLOT_NUM; i++ )
+        {
+            if( pWheel->pSlots[ level ][ ( block + i ) & TIMER_CONTROLLER_WHEEL_SLOT_MASK ] != NULL )
+            {
+                if( ( ( block + i ) << TIMER_CONTROLLER_WHEEL_LEVEL_SHIFT( level ) ) < nextTick )
+                {
+                    nextTick = ( block + i ) << TIMER_CONTROLLER_WHEEL_LEVEL_SHIFT( level );
+                }
+                break;
+            }
+        }
+    }
+
+    return nextTick;
+}
+
+static void AdvanceWheel( TimerControllerWheel_t * pWheel,
+                          uint64_t nowTick )
+{
+    TimerHandler_t ** ppSlot;
+    TimerHandler_t * pTimerHandler;
+    TimerControllerTimerExpireCallback onTimerExpire;
+    void * pUserContext;
+    uint64_t nextTick;
+    int level;
+
+    while( ( pWheel->currentTick < nowTick ) && ( pWheel->timerCount > 0 ) )
+    {
+        /* Jump over the ticks with nothing to fire or cascade, stepping through them one by one
+         * falls behind the time when the dispatcher wakes up late or a cascade moves a timer far down. */
+        nextTick = GetNextWakeUpTick( pWheel );
+        if( nextTick > nowTick )
+        {
+            break;
+        }
+        pWheel->currentTick = nextTick;
+
+        for( level = TIMER_CONTROLLER_WHEEL_LEVEL_NUM - 1; level > 0; level-- )
+        {
+            if( ( pWheel->currentTick & ( TIMER_CONTROLLER_WHEEL_LEVEL_SPAN( level ) - 1 ) ) == 0 )
+            {
+                CascadeSlot( pWheel, level );
+            }
+        }
+
+        ppSlot = &pWheel->pSlots[ 0 ][ pWheel->currentTick & TIMER_CONTROLLER_WHEEL_SLOT_MASK ];
+        while( *ppSlot != NULL )
+        {
+            pTimerHandler = *ppSlot;
+            UnlinkTimer( pTimerHandler );
+
+            /* Re-arm repeating timers before the callback, the callback is free to reset or re-set it. */
+            if( pTimerHandler->repeatTimeMs != 0U )
+            {
+                pTimerHandler->expireTick += TIMER_CONTROLLER_WHEEL_MS_TO_TICK( pTimerHandler->repeatTimeMs );
+                LinkTimer( pWheel, pTimerHandler );
+            }
+            else
+            {
+                pTimerHandler->isSet = 0U;
+                pWheel->timerCount--;
+            }
+
+            onTimerExpire = pTimerHandler->onTimerExpire;
+            pUserContext = pTimerHandler->pUserContext;
+            pWheel->pDispatchingTimer = pTimerHandler;
+
+            ( void ) pthread_mutex_unlock( &pWheel->wheelMutex );
+            onTimerExpire( pUserContext );
+            ( void ) pthread_mutex_lock( &pWheel->wheelMutex );
+
+            pWheel->pDispatchingTimer = NULL;
+            ( void ) pthread_cond_broadcast( &pWheel->dispatchCond );
+        }
+    }
+
+    if( pWheel->currentTick < nowTick )
+    {
+        /* Nothing to fire or cascade till now, skip the idle ticks. */
+        pWheel->currentTick = nowTick;
+    }
+}
+
+static void ArmTimerFd( TimerControllerWheel_t * pWheel )
+{
+    struct itimerspec its;
+    uint64_t nextTick = 0;
+    uint64_t wakeUpTimeNs;
+
+    if( pWheel->timerCount > 0 )
+    {
+        nextTick = GetNextWakeUpTick( pWheel );
+    }
+
+    if( nextTick != pWheel->armedTick )
+    {
+        memset( &its, 0, sizeof( its ) );
+        if( nextTick != 0 )
+        {
+            wakeUpTimeNs = pWheel->startTimeNs + nextTick * TIMER_CONTROLLER_WHEEL_TICK_NS;
+            its.it_value.tv_sec = wakeUpTimeNs / 1000000000ULL;
+            its.it_value.tv_nsec = wakeUpTimeNs % 1000000000ULL;
+        }
+
+        if( timerfd_settime( pWheel->timerFd, TFD_TIMER_ABSTIME, &its, NULL ) != 0 )
+        {
+            LogError( ( "Fail to arm timerfd, errno: %s", strerror( errno ) ) );
+        }
+        else
+        {
+            pWheel->armedTick = nextTick;
+        }
+    }
+}
+
+static void * TimerWheel_Task( void * pParameter )
+{
+    TimerControllerWheel_t * pWheel = ( TimerControllerWheel_t * ) pParameter;
+    uint64_t expirations;
+
+    for( ;; )
+    {
+        if( read( pWheel->timerFd, &expirations, sizeof( expirations ) ) != sizeof( expirations ) )
+        {
+            if( errno != EINTR )
+            {
+                LogError( ( "Fail to read timerfd, errno: %s", strerror( errno ) ) );
+            }
+            continue;
+        }
+
+        ( void ) pthread_mutex_lock( &pWheel->wheelMutex );
+
+        /* The timerfd is re-armed below, it's not armed for any tick till then. */
+        pWheel->armedTick = 0;
+        AdvanceWheel( pWheel,
+                      ( GetMonotonicTimeNs() - pWheel->startTimeNs ) / TIMER_CONTROLLER_WHEEL_TICK_NS );
+        ArmTimerFd( pWheel );
+
+        ( void ) pthread_mutex_unlock( &pWheel->wheelMutex );
+    }
+
+    return NULL;
+}
+
+static void InitTimerWheel( void )
+{
+    timerWheel.startTimeNs = GetMonotonicTimeNs();
+    timerWheel.timerFd = timerfd_create( CLOCK_MONOTONIC, TFD_CLOEXEC );
+    if( timerWheel.timerFd < 0 )
+    {
+        LogError( ( "Fail to create timerfd, errno: %s", strerror( errno ) ) );
+        timerWheelInitResult = TIMER_CONTROLLER_RESULT_FAIL_TIMER_CREATE;
+    }
+    else if( pthread_mutex_init( &timerWheel.wheelMutex, NULL ) != 0 )
+    {
+        LogError( ( "Fail to create timer wheel mutex" ) );
+        close( timerWheel.timerFd );
+        timerWheel.timerFd = -1;
+        timerWheelInitResult = TIMER_CONTROLLER_RESULT_FAIL_TIMER_CREATE;
+    }
+    else if( pthread_cond_init( &timerWheel.dispatchCond, NULL ) != 0 )
+    {
+        LogError( ( "Fail to create timer wheel condition variable" ) );
+        ( void ) pthread_mutex_destroy( &timerWheel.wheelMutex );
+        close( timerWheel.timerFd );
+        timerWheel.timerFd = -1;
+        timerWheelInitResult = TIMER_CONTROLLER_RESULT_FAIL_TIMER_CREATE;
+    }
+    else if( pthread_create( &timerWheel.dispatcherTid,
+                             NULL,
+                             TimerWheel_Task,
+                             &timerWheel ) != 0 )
+    {
+        LogError( ( "Fail to create timer dispatcher task" ) );
+        ( void ) pthread_cond_destroy( &timerWheel.dispatchCond );
+        ( void ) pthread_mutex_destroy( &timerWheel.wheelMutex );
+        close( timerWheel.timerFd );
+        timerWheel.timerFd = -1;
+        timerWheelInitResult = TIMER_CONTROLLER_RESULT_FAIL_TIMER_CREATE;
+    }
+    else
+    {
+        timerWheelInitResult = TIMER_CONTROLLER_RESULT_OK;
     }
 }
 
@@ -39,31 +352,26 @@ TimerControllerResult_t TimerController_Create( TimerHandler_t * pTimerHandler,
                                                 void * pUserContext )
 {
     TimerControllerResult_t ret = TIMER_CONTROLLER_RESULT_OK;
-    struct sigevent sigEvent;
 
     if( ( pTimerHandler == NULL ) || ( onTimerExpire == NULL ) )
     {
         ret = TIMER_CONTROLLER_RESULT_BAD_PARAMETER;
     }
 
+    if( ret == TIMER_CONTROLLER_RESULT_OK )
+    {
+        /* The wheel is created by the first timer and shared by all the others. */
+        ( void ) pthread_once( &timerWheelOnce,
+                               InitTimerWheel );
+        ret = timerWheelInitResult;
+    }
+
     if( ret == TIMER_CONTROLLER_RESULT_OK )
     {
         // Set timer handler
+        memset( pTimerHandler, 0, sizeof( TimerHandler_t ) );
         pTimerHandler->onTimerExpire = onTimerExpire;
         pTimerHandler->pUserContext = pUserContext;
-
-        // Set up the signal handler
-        memset( &sigEvent, 0, sizeof( sigEvent ) );
-        sigEvent.sigev_notify = SIGEV_THREAD;
-        sigEvent.sigev_notify_function = &generalTimerCallback;
-        sigEvent.sigev_value.sival_ptr = pTimerHandler;
-
-        // Create the timer
-        if( timer_create( CLOCK_REALTIME, &sigEvent, &pTimerHandler->timerId ) != 0 )
-        {
-            LogError( ( "Fail to create timer, errno: %s", strerror( errno ) ) );
-            ret = TIMER_CONTROLLER_RESULT_FAIL_TIMER_CREATE;
-        }
     }
 
     return ret;
@@ -74,27 +382,52 @@ TimerControllerResult_t TimerController_SetTimer( TimerHandler_t * pTimerHandler
                                                   uint32_t repeatTimeMs )
 {
     TimerControllerResult_t ret = TIMER_CONTROLLER_RESULT_OK;
-    struct itimerspec its;
+    uint64_t expireTimeNs;
 
     if( pTimerHandler == NULL )
     {
         ret = TIMER_CONTROLLER_RESULT_BAD_PARAMETER;
     }
+    else if( pthread_mutex_lock( &timerWheel.wheelMutex ) != 0 )
+    {
+        LogError( ( "Fail to take timer wheel mutex" ) );
+        ret = TIMER_CONTROLLER_RESULT_FAIL_TIMER_SET;
+    }
+    else
+    {
+        /* Empty else marker. */
+    }
 
     if( ret == TIMER_CONTROLLER_RESULT_OK )
     {
-        // Set the timer interval
-        its.it_value.tv_sec = initialTimeMs / 1000;
-        its.it_value.tv_nsec = ( initialTimeMs % 1000 ) * 1000000;
-        its.it_interval.tv_sec = repeatTimeMs / 1000;
-        its.it_interval.tv_nsec = ( repeatTimeMs % 1000 ) * 1000000;
+        if( pTimerHandler->isSet != 0U )
+        {
+            UnlinkTimer( pTimerHandler );
+            pTimerHandler->isSet = 0U;
+            timerWheel.timerCount--;
+        }
 
-        // Start the timer
-        if( timer_settime( pTimerHandler->timerId, 0, &its, NULL ) != 0 )
+        // Same as timer_settime(), zero initial time disarms the timer
+        if( initialTimeMs != 0U )
         {
-            LogError( ( "Fail to set timer, errno: %s", strerror( errno ) ) );
-            ret = TIMER_CONTROLLER_RESULT_FAIL_TIMER_SET;
+            if( timerWheel.timerCount == 0 )
+            {
+                /* The wheel stopped moving while it was empty, catch it up with the time. */
+                timerWheel.currentTick = ( GetMonotonicTimeNs() - timerWheel.startTimeNs ) / TIMER_CONTROLLER_WHEEL_TICK_NS;
+            }
+
+            /* Round up to the next tick, a timer never fires early. */
+            expireTimeNs = GetMonotonicTimeNs() - timerWheel.startTimeNs + ( uint64_t ) initialTimeMs * 1000000ULL;
+            pTimerHandler->expireTick = ( expireTimeNs + TIMER_CONTROLLER_WHEEL_TICK_NS - 1 ) / TIMER_CONTROLLER_WHEEL_TICK_NS;
+            pTimerHandler->repeatTimeMs = repeatTimeMs;
+            pTimerHandler->isSet = 1U;
+            timerWheel.timerCount++;
+            LinkTimer( &timerWheel, pTimerHandler );
         }
+
+        ArmTimerFd( &timerWheel );
+
+        ( void ) pthread_mutex_unlock( &timerWheel.wheelMutex );
     }
 
     return ret;
@@ -107,46 +440,62 @@ void TimerController_Reset( TimerHandler_t * pTimerHandler )
         // Cancel the timer
         if( TimerController_SetTimer( pTimerHandler, 0U, 0U ) != TIMER_CONTROLLER_RESULT_OK )
         {
-            LogError( ( "Fail to reset timer, errno: %s", strerror( errno ) ) );
+            LogError( ( "Fail to reset timer" ) );
         }
     }
 }
 
 void TimerController_Delete( TimerHandler_t * pTimerHandler )
 {
-    if( pTimerHandler != NULL )
+    if( pTimerHandler == NULL )
+    {
+        /* Nothing to delete. */
+    }
+    else if( pthread_mutex_lock( &timerWheel.wheelMutex ) != 0 )
+    {
+        LogError( ( "Fail to take timer wheel mutex" ) );
+    }
+    else
     {
-        // Delete the timer
-        if( timer_delete( pTimerHandler->timerId ) != 0 )
+        /* The caller frees the timer and its context next, wait for its callback to return.
+         * The callback deleting its own timer runs on the dispatcher, it'd wait for itself. */
+        while( ( timerWheel.pDispatchingTimer == pTimerHandler ) &&
+               ( pthread_equal( pthread_self(), timerWheel.dispatcherTid ) == 0 ) )
         {
-            LogError( ( "Fail to delete timer, errno: %s", strerror( errno ) ) );
+            ( void ) pthread_cond_wait( &timerWheel.dispatchCond,
+                                        &timerWheel.wheelMutex );
         }
+
+        /* Take it out after the wait, the callback may have set it again. */
+        if( pTimerHandler->isSet != 0U )
+        {
+            UnlinkTimer( pTimerHandler );
+            pTimerHandler->isSet = 0U;
+            timerWheel.timerCount--;
+            ArmTimerFd( &timerWheel );
+        }
+
+        ( void ) pthread_mutex_unlock( &timerWheel.wheelMutex );
     }
 }
 
 TimerControllerResult_t TimerController_IsTimerSet( TimerHandler_t * pTimerHandler )
 {
     TimerControllerResult_t ret = TIMER_CONTROLLER_RESULT_OK;
-    struct itimerspec its;
 
     if( pTimerHandler == NULL )
     {
         ret = TIMER_CONTROLLER_RESULT_BAD_PARAMETER;
     }
-
-    if( timer_gettime( pTimerHandler->timerId, &its ) != 0 )
+    else if( pthread_mutex_lock( &timerWheel.wheelMutex ) != 0 )
     {
-        LogError( ( "timer_gettime fail, errno: %s", strerror( errno ) ) );
+        LogError( ( "Fail to take timer wheel mutex" ) );
         ret = TIMER_CONTROLLER_RESULT_FAIL_GETTIME;
     }
-
-    if( ( its.it_value.tv_sec == 0 ) && ( its.it_value.tv_nsec == 0 ) )
-    {
-        ret = TIMER_CONTROLLER_RESULT_NOT_SET;
-    }
     else
     {
-        ret = TIMER_CONTROLLER_RESULT_SET;
+        ret = ( pTimerHandler->isSet != 0U ) ? TIMER_CONTROLLER_RESULT_SET : TIMER_CONTROLLER_RESULT_NOT_SET;
+        ( void ) pthread_mutex_unlock( &timerWheel.wheelMutex );
     }
 
     return ret;
@@ -43,11 +43,19 @@ typedef enum TimerControllerResult
 
 typedef void (* TimerControllerTimerExpireCallback)( void * pUserContext );
 
+/* All timers are kept in one hierarchical timing wheel and fired by one dispatcher thread. */
 typedef struct TimerHandler
 {
-    timer_t timerId;
     TimerControllerTimerExpireCallback onTimerExpire;
     void * pUserContext;
+
+    /* Wheel slot linkage, only accessed with the wheel locked. */
+    struct TimerHandler * pPrev;
+    struct TimerHandler * pNext;
+    struct TimerHandler ** ppSlot;
+    uint64_t expireTick;
+    uint32_t repeatTimeMs;
+    uint8_t isSet;
 } TimerHandler_t;
 
 TimerControllerResult_t TimerController_Create( TimerHandler_t * pTimerHandler,
@@ -57,6 +65,8 @@ TimerControllerResult_t TimerController_SetTimer( TimerHandler_t * pTimerHandler
                                                   uint32_t initialTimeMs,
                                                   uint32_t repeatTimeMs );
 void TimerController_Reset( TimerHandler_t * pTimerHandler );
+/* Stop the timer and wait for its callback if it's running, the timer and its context can be freed after it returns.
+ * The callback may delete its own timer, it doesn't wait then. */
 void TimerController_Delete( TimerHandler_t * pTimerHandler );
 TimerControllerResult_t TimerController_IsTimerSet( TimerHandler_t * pTimerHandler );
 
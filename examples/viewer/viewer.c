@@ -89,7 +89,9 @@ static int32_t OnMediaSinkHook( void * pCustom,
     PeerConnectionResult_t peerConnectionResult;
     Transceiver_t * pTransceiver = NULL;
     PeerConnectionFrame_t peerConnectionFrame;
-    int i;
+    uint32_t i;
+    uint32_t appSessionCount;
+    AppSession_t * pAppSession;
 
     if( ( pAppContext == NULL ) || ( pFrame == NULL ) )
     {
@@ -104,15 +106,18 @@ static int32_t OnMediaSinkHook( void * pCustom,
         peerConnectionFrame.pData = pFrame->pData;
         peerConnectionFrame.dataLength = pFrame->size;
 
-        for( i = 0; i < AWS_MAX_VIEWER_NUM; i++ )
+        appSessionCount = AppCommon_GetAppSessionCount( pAppContext );
+        for( i = 0; i < appSessionCount; i++ )
         {
+            pAppSession = pAppContext->ppAppSessions[ i ];
+
             if( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_VIDEO )
             {
-                pTransceiver = &pAppContext->appSessions[ i ].transceivers[ DEMO_TRANSCEIVER_MEDIA_INDEX_VIDEO ];
+                pTransceiver = &pAppSession->transceivers[ DEMO_TRANSCEIVER_MEDIA_INDEX_VIDEO ];
             }
             else if( pFrame->trackKind == TRANSCEIVER_TRACK_KIND_AUDIO )
             {
-                pTransceiver = &pAppContext->appSessions[ i ].transceivers[ DEMO_TRANSCEIVER_MEDIA_INDEX_AUDIO ];
+                pTransceiver = &pAppSession->transceivers[ DEMO_TRANSCEIVER_MEDIA_INDEX_AUDIO ];
             }
             else
             {
@@ -121,9 +126,9 @@ static int32_t OnMediaSinkHook( void * pCustom,
                 break;
             }
 
-            if( pAppContext->appSessions[ i ].peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
+            if( pAppSession->peerConnectionSession.state == PEER_CONNECTION_SESSION_STATE_CONNECTION_READY )
             {
-                peerConnectionResult = PeerConnection_WriteFrame( &pAppContext->appSessions[ i ].peerConnectionSession,
+                peerConnectionResult = PeerConnection_WriteFrame( &pAppSession->peerConnectionSession,
                                                                   pTransceiver,
                                                                   &peerConnectionFrame );
 
@@ -327,7 +332,9 @@ int main( void )
 
         ret = SendSdpOffer( &appContext );
 
-        while( appContext.appSessions[0].peerConnectionSession.state >= PEER_CONNECTION_SESSION_STATE_START )
+        /* The viewer only has the session of its SDP offer, at index 0 of the pool. */
+        while( ( AppCommon_GetAppSessionCount( &appContext ) > 0U ) &&
+               ( appContext.ppAppSessions[ 0 ]->peerConnectionSession.state >= PEER_CONNECTION_SESSION_STATE_START ) )
         {
             /* The session is still alive, keep processing. */
             sleep( 10 );